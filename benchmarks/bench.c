@@ -0,0 +1,230 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "bench.h"
+
+/**
+ * @brief Returns non-zero if the given benchmark should be run
+ * @param config Benchmark configuration
+ * @param name Name of the benchmark
+ * @return non-zero if enabled
+ */
+int bench_enabled(bench_config * config, const char * name)
+{
+    if (config->filter == NULL) return 1;
+    return (strstr(name, config->filter) != NULL);
+}
+
+/**
+ * @brief Writes the result of a measurement as a line of JSON
+ * @param config Benchmark configuration
+ * @param name Name of the benchmark
+ * @param size Problem size, whose meaning depends upon the benchmark
+ * @param threads Number of threads used
+ * @param iterations Number of operations performed
+ * @param elapsed Time taken in seconds
+ */
+void bench_report(bench_config * config, const char * name,
+                  int size, int threads,
+                  unsigned long long iterations, double elapsed)
+{
+    if ((iterations == 0) || (elapsed <= 0)) return;
+
+    fprintf(config->results,
+            "{\"benchmark\":\"%s\",\"size\":%d,\"threads\":%d,"
+            "\"iterations\":%llu,\"seconds\":%.6f,"
+            "\"us_per_op\":%.3f,\"ops_per_sec\":%.3f}\n",
+            name, size, threads, iterations, elapsed,
+            elapsed * 1.0e6 / iterations, iterations / elapsed);
+    fflush(config->results);
+}
+
+/**
+ * @brief Repeatedly calls a function until the minimum measurement
+ *        time has elapsed, then writes the result as a line of JSON
+ * @param config Benchmark configuration
+ * @param name Name of the benchmark
+ * @param size Problem size, whose meaning depends upon the benchmark
+ * @param threads Number of threads used
+ * @param function Function to be timed
+ * @param data Data passed to the function
+ */
+void bench_measure(bench_config * config, const char * name,
+                   int size, int threads,
+                   bench_function function, void * data)
+{
+    unsigned long long iterations = 0, batch = 1, i;
+    double start, elapsed = 0;
+
+    /* warm up caches and any lazily allocated buffers */
+    function(data);
+
+    start = deeplearn_stats_clock();
+    while (elapsed < config->min_seconds) {
+        for (i = 0; i < batch; i++) {
+            function(data);
+        }
+        iterations += batch;
+        elapsed = deeplearn_stats_clock() - start;
+        if (batch < (1ULL << 20)) batch *= 2;
+    }
+
+    bench_report(config, name, size, threads, iterations, elapsed);
+}
+
+/**
+ * @brief Measures a function with each of the configured thread counts
+ * @param config Benchmark configuration
+ * @param name Name of the benchmark
+ * @param size Problem size
+ * @param function Function to be timed
+ * @param data Data passed to the function
+ */
+void bench_threads(bench_config * config, const char * name, int size,
+                   bench_function function, void * data)
+{
+    int t, max_threads = omp_get_max_threads();
+
+    for (t = 0; t < config->no_of_thread_counts; t++) {
+        omp_set_num_threads(config->threads[t]);
+        bench_measure(config, name, size, config->threads[t],
+                      function, data);
+    }
+    omp_set_num_threads(max_threads);
+}
+
+/**
+ * @brief Parses a comma separated list of thread counts
+ * @param config Benchmark configuration
+ * @param list Comma separated list, eg. "1,2,4"
+ * @return zero on success
+ */
+static int bench_parse_threads(bench_config * config, char * list)
+{
+    char * str = list;
+    int threads;
+
+    config->no_of_thread_counts = 0;
+    while ((*str != 0) &&
+           (config->no_of_thread_counts < BENCH_MAX_THREAD_COUNTS)) {
+        threads = atoi(str);
+        if (threads < 1) return -1;
+        config->threads[config->no_of_thread_counts++] = threads;
+        while ((*str != 0) && (*str != ',')) str++;
+        if (*str == ',') str++;
+    }
+    if (config->no_of_thread_counts == 0) return -2;
+    return 0;
+}
+
+/**
+ * @brief Uses one thread and the maximum number of threads, together
+ *        with powers of two in between
+ * @param config Benchmark configuration
+ */
+static void bench_default_threads(bench_config * config)
+{
+    int threads, max_threads = omp_get_max_threads();
+
+    config->no_of_thread_counts = 0;
+    for (threads = 1; threads < max_threads; threads *= 2) {
+        if (config->no_of_thread_counts == BENCH_MAX_THREAD_COUNTS-1) break;
+        config->threads[config->no_of_thread_counts++] = threads;
+    }
+    config->threads[config->no_of_thread_counts++] = max_threads;
+}
+
+static void bench_usage()
+{
+    printf("Usage: bench [options]\n");
+    printf("  --quick              Fewer sizes and shorter measurements\n");
+    printf("  --seconds <t>        Minimum time for each measurement\n");
+    printf("  --threads <n,n,...>  Thread counts to measure\n");
+    printf("  --filter <name>      Only run benchmarks containing name\n");
+    printf("  --output <filename>  Write JSON lines to a file\n");
+}
+
+int main(int argc, char* argv[])
+{
+    bench_config config;
+    char * output_filename = NULL;
+    int i;
+
+    memset((void*)&config, '\0', sizeof(bench_config));
+    config.min_seconds = 0.5;
+    config.results = stdout;
+    bench_default_threads(&config);
+
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--help") == 0) ||
+            (strcmp(argv[i], "-h") == 0)) {
+            bench_usage();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--quick") == 0) {
+            config.quick = 1;
+            config.min_seconds = 0.1;
+        }
+        else if ((strcmp(argv[i], "--seconds") == 0) && (i+1 < argc)) {
+            config.min_seconds = atof(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "--threads") == 0) && (i+1 < argc)) {
+            if (bench_parse_threads(&config, argv[++i]) != 0) {
+                bench_usage();
+                return -1;
+            }
+        }
+        else if ((strcmp(argv[i], "--filter") == 0) && (i+1 < argc)) {
+            config.filter = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--output") == 0) && (i+1 < argc)) {
+            output_filename = argv[++i];
+        }
+        else {
+            bench_usage();
+            return -1;
+        }
+    }
+
+    if (output_filename != NULL) {
+        config.results = fopen(output_filename, "w");
+        if (!config.results) {
+            printf("Unable to write to %s\n", output_filename);
+            return -2;
+        }
+    }
+
+    bench_core(&config);
+    bench_training(&config);
+
+    if (output_filename != NULL) {
+        fclose(config.results);
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_BENCH_H
+#define DEEPLEARN_BENCH_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "globals.h"
+#include "backprop.h"
+#include "autocoder.h"
+#include "deeplearn.h"
+#include "deeplearndata.h"
+#include "deeplearn_features.h"
+#include "deeplearn_pooling.h"
+#include "deepconvnet.h"
+#include "deeplearn_stats.h"
+
+/* maximum number of thread counts which can be benchmarked */
+#define BENCH_MAX_THREAD_COUNTS 8
+
+/* directory containing the example data sets */
+#define BENCH_EXAMPLES_DIRECTORY "../examples/"
+
+struct bench_config {
+    /* minimum time over which each measurement is made */
+    double min_seconds;
+
+    /* fewer sizes and shorter measurements */
+    int quick;
+
+    /* thread counts to measure */
+    int threads[BENCH_MAX_THREAD_COUNTS];
+    int no_of_thread_counts;
+
+    /* if set then only benchmarks whose name contains this are run */
+    char * filter;
+
+    /* results are written as one line of JSON per measurement */
+    FILE * results;
+};
+typedef struct bench_config bench_config;
+
+typedef void (*bench_function)(void * data);
+
+int bench_enabled(bench_config * config, const char * name);
+void bench_report(bench_config * config, const char * name,
+                  int size, int threads,
+                  unsigned long long iterations, double elapsed);
+void bench_measure(bench_config * config, const char * name,
+                   int size, int threads,
+                   bench_function function, void * data);
+void bench_threads(bench_config * config, const char * name, int size,
+                   bench_function function, void * data);
+
+void bench_core(bench_config * config);
+void bench_training(bench_config * config);
+
+#endif
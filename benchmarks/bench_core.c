@@ -0,0 +1,341 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "bench.h"
+
+#define BENCH_TEMP_NETWORK DEEPLEARN_TEMP_DIRECTORY "libdeep_bench_net.bin"
+#define BENCH_TEMP_CSV     DEEPLEARN_TEMP_DIRECTORY "libdeep_bench.csv"
+
+typedef struct {
+    bp net;
+} bench_bp;
+
+typedef struct {
+    ac autocoder;
+} bench_ac;
+
+typedef struct {
+    int width, height, depth, patch_radius;
+    int across, down;
+    unsigned char * img;
+    float * layer0;
+    int layer0_units;
+    ac autocoder;
+} bench_conv;
+
+typedef struct {
+    int depth, across, down;
+    float * layer0, * layer1;
+} bench_pool;
+
+typedef struct {
+    char * filename;
+    int fields;
+} bench_csv;
+
+/**
+ * @brief Creates a network whose inputs and targets are set to
+ *        pseudo-random values
+ * @param b Benchmark data
+ * @param size Number of inputs and units within each hidden layer
+ * @return zero on success
+ */
+static int bench_bp_init(bench_bp * b, int size)
+{
+    unsigned int random_seed = 5627;
+    int i;
+
+    if (bp_init(&b->net, size, size, 2, 4, &random_seed) != 0) {
+        return -1;
+    }
+    for (i = 0; i < size; i++) {
+        bp_set_input(&b->net, i, 0.25f + (rand_num(&random_seed)%1000)/2000.0f);
+    }
+    for (i = 0; i < 4; i++) {
+        bp_set_output(&b->net, i, 0.25f + (i%2)*0.5f);
+    }
+    return 0;
+}
+
+static void bench_bp_feed_forward(void * data)
+{
+    bp_feed_forward(&((bench_bp*)data)->net);
+}
+
+static void bench_bp_update(void * data)
+{
+    bp_update(&((bench_bp*)data)->net, 0);
+}
+
+static void bench_bp_save(void * data)
+{
+    FILE * fp = fopen(BENCH_TEMP_NETWORK, "wb");
+
+    if (!fp) return;
+    bp_save(fp, &((bench_bp*)data)->net);
+    fclose(fp);
+}
+
+static void bench_bp_load(void * data)
+{
+    bp net;
+    unsigned int random_seed = 123;
+    FILE * fp = fopen(BENCH_TEMP_NETWORK, "rb");
+
+    (void)data;
+    if (!fp) return;
+    if (bp_load(fp, &net, &random_seed) == 0) {
+        bp_free(&net);
+    }
+    fclose(fp);
+}
+
+static void bench_autocoder_update(void * data)
+{
+    autocoder_update(&((bench_ac*)data)->autocoder);
+}
+
+static void bench_features_conv(void * data)
+{
+    bench_conv * b = (bench_conv*)data;
+
+    features_conv_img_to_flt(b->across, b->down, b->patch_radius,
+                             b->width, b->height, b->depth, b->img,
+                             b->layer0_units, b->layer0,
+                             &b->autocoder, 0);
+}
+
+static void bench_pooling(void * data)
+{
+    bench_pool * b = (bench_pool*)data;
+
+    pooling_from_flt_to_flt(b->depth, b->across, b->down, b->layer0,
+                            b->across/2, b->down/2, b->layer1);
+}
+
+static void bench_read_csv(void * data)
+{
+    bench_csv * b = (bench_csv*)data;
+    deeplearn learner;
+    int output_field_index[] = { 0 };
+    float error_threshold[] = { 1.0f, 1.0f, 1.0f };
+    unsigned int random_seed = 123;
+
+    output_field_index[0] = b->fields-1;
+    if (deeplearndata_read_csv(b->filename, &learner, 8, 2, 1,
+                               output_field_index, 0,
+                               error_threshold, &random_seed) > 0) {
+        deeplearn_free(&learner);
+    }
+}
+
+/**
+ * @brief Benchmarks feed forward, training, saving and loading of
+ *        backprop networks of increasing size
+ * @param config Benchmark configuration
+ */
+static void bench_backprop(bench_config * config)
+{
+    int sizes[] = { 16, 64, 256, 1024 };
+    int s, no_of_sizes = config->quick ? 2 : 4;
+    bench_bp b;
+
+    for (s = 0; s < no_of_sizes; s++) {
+        if (bench_bp_init(&b, sizes[s]) != 0) continue;
+
+        if (bench_enabled(config, "bp_feed_forward")) {
+            bench_threads(config, "bp_feed_forward", sizes[s],
+                          bench_bp_feed_forward, &b);
+        }
+        if (bench_enabled(config, "bp_update")) {
+            bench_threads(config, "bp_update", sizes[s],
+                          bench_bp_update, &b);
+        }
+        if (bench_enabled(config, "bp_save") ||
+            bench_enabled(config, "bp_load")) {
+            /* the load benchmark reads the saved network */
+            bench_measure(config, "bp_save", sizes[s], 1,
+                          bench_bp_save, &b);
+            bench_measure(config, "bp_load", sizes[s], 1,
+                          bench_bp_load, &b);
+        }
+        bp_free(&b.net);
+    }
+    remove(BENCH_TEMP_NETWORK);
+}
+
+/**
+ * @brief Benchmarks autocoder updates
+ * @param config Benchmark configuration
+ */
+static void bench_autocoder(bench_config * config)
+{
+    int sizes[] = { 64, 256, 1024 };
+    int i, s, no_of_sizes = config->quick ? 2 : 3;
+    unsigned int random_seed = 7391;
+    bench_ac b;
+
+    if (!bench_enabled(config, "autocoder_update")) return;
+
+    for (s = 0; s < no_of_sizes; s++) {
+        if (autocoder_init(&b.autocoder, sizes[s], sizes[s]/4,
+                           random_seed) != 0) {
+            continue;
+        }
+        for (i = 0; i < sizes[s]; i++) {
+            autocoder_set_input(&b.autocoder, i,
+                                0.25f + (rand_num(&random_seed)%1000)/2000.0f);
+        }
+        bench_threads(config, "autocoder_update", sizes[s],
+                      bench_autocoder_update, &b);
+        autocoder_free(&b.autocoder);
+    }
+}
+
+/**
+ * @brief Benchmarks convolution of colour images of increasing size
+ * @param config Benchmark configuration
+ */
+static void bench_convolution(bench_config * config)
+{
+    int sizes[] = { 64, 128, 256 };
+    int i, s, no_of_sizes = config->quick ? 2 : 3;
+    unsigned int random_seed = 4291;
+    int features = 16;
+    bench_conv b;
+
+    if (!bench_enabled(config, "features_conv_img_to_flt")) return;
+
+    for (s = 0; s < no_of_sizes; s++) {
+        b.width = b.height = sizes[s];
+        b.depth = 3;
+        b.patch_radius = 4;
+        b.across = b.width/b.patch_radius;
+        b.down = b.height/b.patch_radius;
+        b.layer0_units = b.across*b.down*features;
+        b.img = (unsigned char*)malloc(b.width*b.height*b.depth);
+        b.layer0 = (float*)malloc(b.layer0_units*sizeof(float));
+        if ((!b.img) || (!b.layer0) ||
+            (autocoder_init(&b.autocoder,
+                            b.patch_radius*b.patch_radius*4*b.depth,
+                            features, random_seed) != 0)) {
+            free(b.img);
+            free(b.layer0);
+            continue;
+        }
+        for (i = 0; i < b.width*b.height*b.depth; i++) {
+            b.img[i] = (unsigned char)(rand_num(&random_seed)%256);
+        }
+        bench_threads(config, "features_conv_img_to_flt", sizes[s],
+                      bench_features_conv, &b);
+        autocoder_free(&b.autocoder);
+        free(b.img);
+        free(b.layer0);
+    }
+}
+
+/**
+ * @brief Benchmarks pooling of feature layers of increasing size
+ * @param config Benchmark configuration
+ */
+static void bench_pool_layers(bench_config * config)
+{
+    int sizes[] = { 32, 64, 128 };
+    int i, s, no_of_sizes = config->quick ? 2 : 3;
+    unsigned int random_seed = 8121;
+    bench_pool b;
+
+    if (!bench_enabled(config, "pooling_from_flt_to_flt")) return;
+
+    for (s = 0; s < no_of_sizes; s++) {
+        b.depth = 16;
+        b.across = b.down = sizes[s];
+        b.layer0 = (float*)malloc(b.across*b.down*b.depth*sizeof(float));
+        b.layer1 = (float*)malloc((b.across/2)*(b.down/2)*b.depth*sizeof(float));
+        if ((!b.layer0) || (!b.layer1)) {
+            free(b.layer0);
+            free(b.layer1);
+            continue;
+        }
+        for (i = 0; i < b.across*b.down*b.depth; i++) {
+            b.layer0[i] = (rand_num(&random_seed)%1000)/1000.0f;
+        }
+        bench_threads(config, "pooling_from_flt_to_flt", sizes[s],
+                      bench_pooling, &b);
+        free(b.layer0);
+        free(b.layer1);
+    }
+}
+
+/**
+ * @brief Benchmarks loading of csv files with increasing numbers of rows
+ * @param config Benchmark configuration
+ */
+static void bench_csv_loading(bench_config * config)
+{
+    int sizes[] = { 1000, 10000, 100000 };
+    int r, f, s, no_of_sizes = config->quick ? 2 : 3;
+    unsigned int random_seed = 3319;
+    bench_csv b;
+    FILE * fp;
+
+    if (!bench_enabled(config, "deeplearndata_read_csv")) return;
+
+    b.filename = BENCH_TEMP_CSV;
+    b.fields = 10;
+    for (s = 0; s < no_of_sizes; s++) {
+        fp = fopen(b.filename, "w");
+        if (!fp) return;
+        for (r = 0; r < sizes[s]; r++) {
+            for (f = 0; f < b.fields; f++) {
+                fprintf(fp, "%s%.4f", (f > 0) ? "," : "",
+                        (rand_num(&random_seed)%100000)/100.0f);
+            }
+            fprintf(fp, "%s", "\n");
+        }
+        fclose(fp);
+
+        bench_threads(config, "deeplearndata_read_csv", sizes[s],
+                      bench_read_csv, &b);
+    }
+    remove(b.filename);
+}
+
+/**
+ * @brief Benchmarks the core kernels of the library
+ * @param config Benchmark configuration
+ */
+void bench_core(bench_config * config)
+{
+    bench_backprop(config);
+    bench_autocoder(config);
+    bench_convolution(config);
+    bench_pool_layers(config);
+    bench_csv_loading(config);
+}
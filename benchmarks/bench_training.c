@@ -0,0 +1,171 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "bench.h"
+
+/**
+ * @brief Loads a csv data set from the examples directory, in the same
+ *        way as the corresponding example program
+ * @param filename Name of the csv file
+ * @param learner Deep learner object
+ * @param hiddens Number of hidden units per layer
+ * @param output_field Index of the field used as the output
+ * @param classes Number of output classes, or zero for regression
+ * @param error_threshold Training error thresholds for each layer
+ * @return zero on success
+ */
+static int bench_load_csv(char * filename, deeplearn * learner,
+                          int hiddens, int output_field, int classes,
+                          float error_threshold[])
+{
+    int output_field_index[1];
+    unsigned int random_seed = 123;
+
+    output_field_index[0] = output_field;
+    if (deeplearndata_read_csv(filename, learner, hiddens, 3, 1,
+                               output_field_index, classes,
+                               error_threshold, &random_seed) <= 0) {
+        return -1;
+    }
+
+    /* don't spend time plotting graphs */
+    learner->history_plot_filename[0] = 0;
+    return 0;
+}
+
+/**
+ * @brief Times a number of epochs of training on an example data set,
+ *        starting from a newly created network for each thread count
+ * @param config Benchmark configuration
+ * @param name Name of the benchmark
+ * @param filename csv file within the examples directory
+ * @param hiddens Number of hidden units per layer
+ * @param output_field Index of the field used as the output
+ * @param classes Number of output classes, or zero for regression
+ * @param error_threshold Training error thresholds for each layer
+ * @param epochs Number of epochs to be timed
+ */
+static void bench_csv_epochs(bench_config * config, const char * name,
+                             char * filename, int hiddens,
+                             int output_field, int classes,
+                             float error_threshold[], int epochs)
+{
+    deeplearn learner;
+    int t, e, i, max_threads = omp_get_max_threads();
+    double start;
+
+    if (!bench_enabled(config, name)) return;
+
+    for (t = 0; t < config->no_of_thread_counts; t++) {
+        omp_set_num_threads(config->threads[t]);
+        if (bench_load_csv(filename, &learner, hiddens, output_field,
+                           classes, error_threshold) != 0) {
+            fprintf(stderr, "Unable to load %s\n", filename);
+            break;
+        }
+
+        start = deeplearn_stats_clock();
+        for (e = 0; e < epochs; e++) {
+            for (i = 0; i < learner.training_data_samples; i++) {
+                deeplearndata_training(&learner);
+            }
+        }
+        bench_report(config, name, learner.training_data_samples,
+                     config->threads[t], epochs,
+                     deeplearn_stats_clock() - start);
+        deeplearn_free(&learner);
+    }
+    omp_set_num_threads(max_threads);
+}
+
+/**
+ * @brief Times a number of epochs of training with the face
+ *        recognition images used by the facerec_conv example
+ * @param config Benchmark configuration
+ * @param epochs Number of epochs to be timed
+ */
+static void bench_facerec_conv_epochs(bench_config * config, int epochs)
+{
+    deepconvnet convnet;
+    float error_threshold[] = { 4.0, 15.0, 8.0, 8.0 };
+    unsigned int random_seed;
+    int t, e, i, training_images, max_threads = omp_get_max_threads();
+    double start;
+
+    if (!bench_enabled(config, "epoch_facerec_conv")) return;
+
+    for (t = 0; t < config->no_of_thread_counts; t++) {
+        omp_set_num_threads(config->threads[t]);
+        random_seed = 34217;
+        if ((deepconvnet_read_images(BENCH_EXAMPLES_DIRECTORY "facerec/images",
+                                     &convnet, 32, 32, 1, 8*8, 3, 2,
+                                     5*5, 25, error_threshold,
+                                     &random_seed) != 0) ||
+            (convnet.no_of_images == 0)) {
+            fprintf(stderr, "Unable to load the face images\n");
+            break;
+        }
+        deepconvnet_set_learning_rate(&convnet, 0.2f);
+        deepconvnet_set_dropouts(&convnet, 0.0f);
+        convnet.history_plot_filename[0] = 0;
+
+        training_images = convnet.no_of_images*8/10;
+        start = deeplearn_stats_clock();
+        for (e = 0; e < epochs; e++) {
+            for (i = 0; i < training_images; i++) {
+                deepconvnet_training(&convnet);
+            }
+        }
+        bench_report(config, "epoch_facerec_conv", training_images,
+                     config->threads[t], epochs,
+                     deeplearn_stats_clock() - start);
+        deepconvnet_free(&convnet);
+    }
+    omp_set_num_threads(max_threads);
+}
+
+/**
+ * @brief Benchmarks whole epochs of training on the example data sets.
+ *        Each measurement is an operation per epoch and the size is
+ *        the number of training samples.
+ * @param config Benchmark configuration
+ */
+void bench_training(bench_config * config)
+{
+    float iris_threshold[] = { 0.5f, 0.5f, 0.5f, 2.5f };
+    float wine_threshold[] = { 1.6f, 2.05f, 4.0f, 9.5f };
+
+    bench_csv_epochs(config, "epoch_iris",
+                     BENCH_EXAMPLES_DIRECTORY "iris/iris.data",
+                     4*4, 4, 3, iris_threshold, config->quick ? 5 : 50);
+    bench_csv_epochs(config, "epoch_wine",
+                     BENCH_EXAMPLES_DIRECTORY "wine/winequality-red.csv",
+                     10, 11, 0, wine_threshold, config->quick ? 2 : 10);
+    bench_facerec_conv_epochs(config, config->quick ? 5 : 50);
+}
@@ -55,6 +55,7 @@
 #include "libdeep/globals.h"
 #include "libdeep/deeplearn.h"
 #include "libdeep/deeplearndata.h"
+#include "libdeep/deeplearn_ingest.h"
 
 #define CLEAR(x) memset (&(x), 0, sizeof (x))
 
@@ -67,9 +68,12 @@ int no_of_inputs, no_of_hiddens, no_of_outputs;
 int hidden_layers = 3;
 float error_threshold[] = {0.1, 0.1, 0.1, 0.1};
 unsigned int random_seed = 526;
-unsigned int *img, *prev_img;
 unsigned int itteration = 0;
 
+/* passes frames from the capture loop to the learning thread */
+deeplearn_ingest ingest;
+deeplearn_ingest_yuyv_format frame_format;
+
 typedef enum
 {
     IO_METHOD_READ,
@@ -217,6 +221,10 @@ static void process_image(const void *p)
     size_t x;
     size_t y;
 
+    /* convert straight from the capture buffer into the network inputs,
+       before the buffer is returned to the device */
+    deeplearn_ingest_push(&ingest, p);
+
     for (y = 0; y < HEIGHT; y++)
         for (x = 0; x < WIDTH; x += 2)
             YUV422_to_RGB(buffer_sdl + (y * WIDTH + x) * 3,
@@ -327,51 +335,18 @@ static int read_frame(void)
     return 1;
 }
 
-static void learn(void)
+/* called on the learning thread after each update */
+static void learned(void * context, deeplearn * learner, unsigned long frame)
 {
-    int x, y, i, n;
-	int h = HEIGHT/SUBSAMPLING_FACTOR;
-	int w = WIDTH/SUBSAMPLING_FACTOR;
-	unsigned int * temp;
-	int diff = 0;
-
-	/* swap buffers */
-	temp = prev_img;
-	prev_img = img;
-	img = temp;
-
-	i = 0;
-	for (y = 0; y < h; y++) {
-		for (x = 0; x < w; x++, i++) {
-			n = (y*SUBSAMPLING_FACTOR)*WIDTH + (x*SUBSAMPLING_FACTOR);
-			img[i] =
-				buffer_sdl[n] + buffer_sdl[n+1] + buffer_sdl[n+2];
-
-			if (i < no_of_inputs) {
-				deeplearn_set_input(&learner, i, 0.25f + ((float)img[i]/(3*255*2)));
-			}
-
-			/* sum the total pixel change */
-			diff += abs((int)img[i] - (int)prev_img[i]);
-		}
-	}
-
-	/* average pixel change */
-	diff /= no_of_inputs;
-
-	/* only learn if there has been some change in the image */
-	if (diff > 5) {
-		deeplearn_update_continuous(&learner);
-	}
-
-	printf("learn %f %d\n", learner.BPerror, diff);
+	printf("learn %f frame %lu dropped %lu\n",
+		   learner->BPerror, frame, ingest.dropped);
 
     itteration++;
-	if (itteration > learner.history_plot_interval) {
+	if (itteration > learner->history_plot_interval) {
 		itteration = 0;
-		deeplearn_plot_history(&learner,
-							   learner.history_plot_filename,
-							   learner.history_plot_title,
+		deeplearn_plot_history(learner,
+							   learner->history_plot_filename,
+							   learner->history_plot_title,
 							   1024, 480);
 	}
 }
@@ -421,7 +396,6 @@ static void mainloop(void)
 
             /* EAGAIN - continue select loop. */
         }
-		learn();
     }
 }
 
@@ -931,8 +905,6 @@ int main(int argc, char **argv)
 
     SDL_SetEventFilter(sdl_filter);
 
-	img = (unsigned int*)malloc(WIDTH*HEIGHT);
-	prev_img = (unsigned int*)malloc(WIDTH*HEIGHT);
 	printf("%dx%d  %dx%d\n",
 		   (int)WIDTH,(int)HEIGHT,
 		   (int)(WIDTH/SUBSAMPLING_FACTOR),(int)(HEIGHT/SUBSAMPLING_FACTOR));
@@ -948,20 +920,36 @@ int main(int argc, char **argv)
                    &random_seed);
 
     deeplearn_set_learning_rate(&learner, 0.1f);
+
+    /* train the layers concurrently within the frame budget */
+    deeplearn_set_pipelined(&learner, 1);
     sprintf(learner.history_plot_title,"%s","Continuous learning of visual input");
     learner.history_plot_interval = 200;
 
+    /* learn on a separate thread, only from frames which have changed,
+       so that capture continues at the full frame rate */
+    frame_format.width = WIDTH;
+    frame_format.height = HEIGHT;
+    frame_format.subsampling = SUBSAMPLING_FACTOR;
+    if (deeplearn_ingest_init(&ingest, &learner, DEEPLEARN_INGEST_CAPACITY,
+                              DEEPLEARN_INGEST_LEARN,
+                              deeplearn_ingest_yuyv, &frame_format) != 0)
+        return 2;
+    deeplearn_ingest_set_learned(&ingest, learned, NULL);
+    deeplearn_ingest_set_min_change(&ingest, 5.0f/(3*255*2));
+    if (deeplearn_ingest_start(&ingest) != 0)
+        return 3;
+
     start_capturing();
     mainloop();
     stop_capturing();
+    deeplearn_ingest_free(&ingest);
 
     uninit_device();
     close_device();
 
     SDL_FreeSurface(data_sf);
     free(buffer_sdl);
-	free(img);
-	free(prev_img);
 
     exit(EXIT_SUCCESS);
 
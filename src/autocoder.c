@@ -42,49 +42,77 @@ int autocoder_init(ac * autocoder,
                    int no_of_hiddens,
                    unsigned int random_seed)
 {
+    size_t inputs_bytes = deeplearn_arena_bytes(no_of_inputs*sizeof(float));
+    size_t hiddens_bytes = deeplearn_arena_bytes(no_of_hiddens*sizeof(float));
+    size_t weights_bytes =
+        deeplearn_arena_bytes(no_of_hiddens*no_of_inputs*sizeof(float));
+
     autocoder->NoOfInputs = no_of_inputs;
     autocoder->NoOfHiddens = no_of_hiddens;
-    autocoder->inputs =
-        (float*)malloc(no_of_inputs*sizeof(float));
+
+    /* all arrays are taken from a single zeroed block */
+    if (deeplearn_arena_init(&autocoder->arena,
+                             3*inputs_bytes + 5*hiddens_bytes +
+                             2*weights_bytes +
+                             deeplearn_arena_bytes(no_of_hiddens*
+                                                   sizeof(int))) != 0) {
+        return -1;
+    }
+    autocoder->inputs = (float*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_inputs*sizeof(float));
     if (!autocoder->inputs) return -1;
-    autocoder->hiddens =
-        (float*)malloc(no_of_hiddens*sizeof(float));
+    autocoder->hiddens = (float*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_hiddens*sizeof(float));
     if (!autocoder->hiddens) return -2;
-    autocoder->bias =
-        (float*)malloc(no_of_hiddens*sizeof(float));
+    autocoder->bias = (float*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_hiddens*sizeof(float));
     if (!autocoder->bias) return -3;
-    autocoder->weights =
-        (float*)malloc(no_of_hiddens*no_of_inputs*sizeof(float));
+    autocoder->weights = (float*)
+        deeplearn_arena_alloc(&autocoder->arena,
+                              no_of_hiddens*no_of_inputs*sizeof(float));
     if (!autocoder->weights) return -4;
-    autocoder->lastWeightChange =
-        (float*)malloc(no_of_hiddens*no_of_inputs*sizeof(float));
+    autocoder->lastWeightChange = (float*)
+        deeplearn_arena_alloc(&autocoder->arena,
+                              no_of_hiddens*no_of_inputs*sizeof(float));
     if (!autocoder->lastWeightChange) return -5;
-    autocoder->outputs =
-        (float*)malloc(no_of_inputs*sizeof(float));
+    autocoder->outputs = (float*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_inputs*sizeof(float));
     if (!autocoder->outputs) return -6;
-    autocoder->bperr =
-        (float*)malloc(no_of_hiddens*sizeof(float));
+    autocoder->bperr = (float*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_hiddens*sizeof(float));
     if (!autocoder->bperr) return -7;
-    autocoder->lastBiasChange =
-        (float*)malloc(no_of_hiddens*sizeof(float));
+    autocoder->lastBiasChange = (float*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_hiddens*sizeof(float));
     if (!autocoder->lastBiasChange) return -8;
-    memset((void*)autocoder->inputs,'\0',no_of_inputs*sizeof(float));
-    memset((void*)autocoder->outputs,'\0',no_of_inputs*sizeof(float));
-    memset((void*)autocoder->hiddens,'\0',
-           no_of_hiddens*sizeof(float));
-    memset((void*)autocoder->lastWeightChange,'\0',
-           no_of_hiddens*no_of_inputs*sizeof(float));
-    memset((void*)autocoder->bperr,'\0',
-           autocoder->NoOfHiddens*sizeof(float));
-    memset((void*)autocoder->lastBiasChange,'\0',
-           autocoder->NoOfHiddens*sizeof(float));
+    autocoder->gradient = (float*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_inputs*sizeof(float));
+    if (!autocoder->gradient) return -9;
+    autocoder->dropout_mask = (float*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_hiddens*sizeof(float));
+    if (!autocoder->dropout_mask) return -10;
+    autocoder->active = (int*)
+        deeplearn_arena_alloc(&autocoder->arena, no_of_hiddens*sizeof(int));
+    if (!autocoder->active) return -11;
+    for (int h = 0; h < no_of_hiddens; h++) {
+        autocoder->dropout_mask[h] = 1;
+        autocoder->active[h] = h;
+    }
+    autocoder->NoOfActive = no_of_hiddens;
     autocoder->BPerror = AUTOCODER_UNKNOWN;
     autocoder->BPerrorAverage = AUTOCODER_UNKNOWN;
     autocoder->learningRate = 0.2f;
     autocoder->noise = 0;
+    autocoder->activation = AF_LOGISTIC;
     autocoder->random_seed = random_seed;
     autocoder->itterations = 0;
     autocoder->DropoutPercent = 0.01f;
+    autocoder->patch_batch = 0;
+    optimiser_init(&autocoder->optimiser);
+    autocoder->moment2 = NULL;
+    autocoder->bias_moment2 = NULL;
+    autocoder->allreduce = NULL;
+    autocoder->allreduce_data = NULL;
+    autocoder->shared_weights = 0;
 
     /* initial small random values */
     for (int h = 0; h < no_of_hiddens; h++) {
@@ -104,14 +132,190 @@ int autocoder_init(ac * autocoder,
  */
 void autocoder_free(ac * autocoder)
 {
-    free(autocoder->inputs);
-    free(autocoder->outputs);
-    free(autocoder->hiddens);
-    free(autocoder->bias);
-    free(autocoder->weights);
-    free(autocoder->lastWeightChange);
-    free(autocoder->bperr);
-    free(autocoder->lastBiasChange);
+    free(autocoder->moment2);
+    free(autocoder->bias_moment2);
+    autocoder->moment2 = NULL;
+    autocoder->bias_moment2 = NULL;
+    deeplearn_arena_free(&autocoder->arena);
+}
+
+/**
+ * @brief Returns the memory used by an autocoder, broken down into
+ *        weights, optimiser state and activations
+ * @param autocoder Autocoder object
+ * @param usage Returned memory footprint
+ */
+void autocoder_memory_usage(ac * autocoder, deeplearn_footprint * usage)
+{
+    size_t inputs = (size_t)autocoder->NoOfInputs;
+    size_t hiddens = (size_t)autocoder->NoOfHiddens;
+    size_t weights = inputs*hiddens*sizeof(float);
+    size_t arena = deeplearn_arena_allocated(&autocoder->arena);
+    size_t counted;
+
+    deeplearn_footprint_clear(usage);
+    if (arena == 0) {
+        usage->other = sizeof(ac);
+        return;
+    }
+
+    /* the weights within the arena are still allocated if the
+       autocoder shares the weights of another object */
+    usage->weights = weights + hiddens*sizeof(float);
+    usage->optimiser = weights + hiddens*sizeof(float);
+    if (autocoder->moment2 != NULL) {
+        usage->optimiser += weights + hiddens*sizeof(float);
+    }
+    usage->activations =
+        3*inputs*sizeof(float) + 3*hiddens*sizeof(float) +
+        hiddens*sizeof(int);
+
+    counted = 2*weights + 5*hiddens*sizeof(float) +
+        3*inputs*sizeof(float) + hiddens*sizeof(int);
+    usage->other = sizeof(ac);
+    if (arena > counted) {
+        usage->other += arena - counted;
+    }
+}
+
+/**
+ * @brief Allocates the second moments used by optimisers such as Adam
+ * @param autocoder Autocoder object
+ * @returns zero on success
+ */
+static int autocoder_moments_alloc(ac * autocoder)
+{
+    if (autocoder->moment2 != NULL) return 0;
+
+    autocoder->moment2 =
+        (float*)calloc(autocoder->NoOfHiddens*autocoder->NoOfInputs,
+                       sizeof(float));
+    autocoder->bias_moment2 =
+        (float*)calloc(autocoder->NoOfHiddens, sizeof(float));
+    if ((!autocoder->moment2) || (!autocoder->bias_moment2)) {
+        free(autocoder->moment2);
+        free(autocoder->bias_moment2);
+        autocoder->moment2 = NULL;
+        autocoder->bias_moment2 = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets the rule used to update the weights, such as
+ *        OPTIMISER_ADAM.  The weight changes are cleared, since their
+ *        meaning depends upon the rule.
+ * @param autocoder Autocoder object
+ * @param type Update rule
+ * @returns zero on success
+ */
+int autocoder_set_optimiser(ac * autocoder, int type)
+{
+    if (optimiser_set(&autocoder->optimiser, type) != 0) {
+        return -1;
+    }
+    memset((void*)autocoder->lastWeightChange, '\0',
+           autocoder->NoOfHiddens*autocoder->NoOfInputs*sizeof(float));
+    memset((void*)autocoder->lastBiasChange, '\0',
+           autocoder->NoOfHiddens*sizeof(float));
+
+    free(autocoder->moment2);
+    free(autocoder->bias_moment2);
+    autocoder->moment2 = NULL;
+    autocoder->bias_moment2 = NULL;
+    if (optimiser_second_moment(&autocoder->optimiser)) {
+        if (autocoder_moments_alloc(autocoder) != 0) {
+            return -2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Makes an independent copy of an autocoder by copying its arena.
+ *        If the weights are shared with another object then the copy
+ *        shares them too, until it is given its own with
+ *        autocoder_share_weights.
+ * @param dest Autocoder object to be created
+ * @param source Autocoder object to be copied
+ * @returns zero on success
+ */
+int autocoder_clone(ac * dest, ac * source)
+{
+    deeplearn_arena * to = &dest->arena;
+    deeplearn_arena * from = &source->arena;
+
+    *dest = *source;
+    if (deeplearn_arena_clone(to, from) != 0) {
+        return -1;
+    }
+    dest->inputs = (float*)deeplearn_arena_relocate(to, from, source->inputs);
+    dest->hiddens = (float*)deeplearn_arena_relocate(to, from, source->hiddens);
+    dest->outputs = (float*)deeplearn_arena_relocate(to, from, source->outputs);
+    dest->dropout_mask =
+        (float*)deeplearn_arena_relocate(to, from, source->dropout_mask);
+    dest->active = (int*)deeplearn_arena_relocate(to, from, source->active);
+    dest->weights = (float*)deeplearn_arena_relocate(to, from, source->weights);
+    dest->lastWeightChange =
+        (float*)deeplearn_arena_relocate(to, from, source->lastWeightChange);
+    dest->bias = (float*)deeplearn_arena_relocate(to, from, source->bias);
+    dest->lastBiasChange =
+        (float*)deeplearn_arena_relocate(to, from, source->lastBiasChange);
+    dest->bperr = (float*)deeplearn_arena_relocate(to, from, source->bperr);
+    dest->gradient = (float*)deeplearn_arena_relocate(to, from, source->gradient);
+
+    dest->moment2 = NULL;
+    dest->bias_moment2 = NULL;
+    if (source->moment2 != NULL) {
+        if (autocoder_moments_alloc(dest) != 0) {
+            autocoder_free(dest);
+            return -2;
+        }
+        memcpy((void*)dest->moment2, (void*)source->moment2,
+               dest->NoOfHiddens*dest->NoOfInputs*sizeof(float));
+        memcpy((void*)dest->bias_moment2, (void*)source->bias_moment2,
+               dest->NoOfHiddens*sizeof(float));
+    }
+    return 0;
+}
+
+/**
+ * @brief Makes the autocoder use a weight matrix belonging to another
+ *        object, such as a hidden layer of a backprop network with the
+ *        same row-major layout, so that training updates it in place.
+ *        The current weights are copied into the matrix, which
+ *        must outlive the autocoder.
+ * @param autocoder Autocoder object
+ * @param weights Matrix of NoOfHiddens x NoOfInputs weights
+ * @returns zero on success
+ */
+int autocoder_share_weights(ac * autocoder, float * weights)
+{
+    if (weights == 0) return -1;
+    if (weights == autocoder->weights) return 0;
+
+    memcpy((void*)weights, autocoder->weights,
+           autocoder->NoOfHiddens*autocoder->NoOfInputs*sizeof(float));
+    /* the previous weights stay within the arena until it is freed */
+    autocoder->weights = weights;
+    autocoder->shared_weights = 1;
+    return 0;
+}
+
+/**
+ * @brief Makes all hidden units active again after dropouts
+ * @param autocoder Autocoder object
+ */
+static void autocoder_clear_dropouts(ac * autocoder)
+{
+    if (autocoder->NoOfActive == autocoder->NoOfHiddens) return;
+
+    for (int h = 0; h < autocoder->NoOfHiddens; h++) {
+        autocoder->dropout_mask[h] = 1;
+        autocoder->active[h] = h;
+    }
+    autocoder->NoOfActive = autocoder->NoOfHiddens;
 }
 
 /**
@@ -122,31 +326,44 @@ void autocoder_free(ac * autocoder)
  */
 void autocoder_encode(ac * autocoder, float * encoded, unsigned char use_dropouts)
 {
-    for (int h = 0; h < autocoder->NoOfHiddens; h++) {
-        if (use_dropouts != 0) {
-            if (rand_num(&autocoder->random_seed)%10000 <
-                autocoder->DropoutPercent*100) {
-                autocoder->hiddens[h] = (int)AUTOCODER_DROPPED_OUT;
-                continue;
-            }
-        }
+    if ((use_dropouts != 0) && (autocoder->DropoutPercent > 0)) {
+        autocoder->NoOfActive =
+            rand_dropouts(&autocoder->random_seed,
+                          autocoder->DropoutPercent,
+                          autocoder->dropout_mask, autocoder->active,
+                          autocoder->NoOfHiddens);
+    }
+    else {
+        autocoder_clear_dropouts(autocoder);
+    }
+
+    /* dropped out units have zero output */
+    if (autocoder->NoOfActive < autocoder->NoOfHiddens) {
+        memset((void*)encoded,'\0',autocoder->NoOfHiddens*sizeof(float));
+    }
+
+    for (int a = 0; a < autocoder->NoOfActive; a++) {
+        int h = autocoder->active[a];
 
         /* weighted sum of inputs */
-        float adder = autocoder->bias[h];
-        for (int i = 0; i < autocoder->NoOfInputs; i++) {
-            adder +=
-                autocoder->weights[h*autocoder->NoOfInputs + i] *
-                autocoder->inputs[i];
-        }
+        float adder = autocoder->bias[h] +
+            kernel_dot(&autocoder->weights[h*autocoder->NoOfInputs],
+                       autocoder->inputs, autocoder->NoOfInputs);
 
         /* add some random noise */
         if (autocoder->noise > 0) {
             adder = ((1.0f - autocoder->noise) * adder) +
-                (autocoder->noise * ((rand_num(&autocoder->random_seed)%10000)/10000.0f));
+                (autocoder->noise *
+                 rand_uniform(autocoder->random_seed, (unsigned int)h));
         }
 
         /* activation function */
-        encoded[h] = 1.0f / (1.0f + exp(-adder));
+        encoded[h] = kernel_af(autocoder->activation, adder);
+    }
+
+    /* move the stream on so that the next noise is different */
+    if (autocoder->noise > 0) {
+        rand_num(&autocoder->random_seed);
     }
 }
 
@@ -157,27 +374,36 @@ void autocoder_encode(ac * autocoder, float * encoded, unsigned char use_dropout
  */
 void autocoder_decode(ac * autocoder, float * decoded)
 {
-    for (int i = 0; i < autocoder->NoOfInputs; i++) {
-        /* weighted sum of hidden inputs */
-        float adder = 0;
-        for (int h = 0; h < autocoder->NoOfHiddens; h++) {
-            if (autocoder->hiddens[h] == AUTOCODER_DROPPED_OUT)
-                continue;
-
-            adder +=
-                autocoder->weights[h*autocoder->NoOfInputs + i] *
-                autocoder->hiddens[h];
-        }
+    int tile, n = autocoder->NoOfInputs;
+    int tiles = (n + AUTOCODER_DECODE_TILE - 1) / AUTOCODER_DECODE_TILE;
 
-        /* add some random noise */
-        if (autocoder->noise > 0) {
-            adder = ((1.0f - autocoder->noise) * adder) +
-                (autocoder->noise * ((rand_num(&autocoder->random_seed)%10000)/10000.0f));
+    /* weighted sum of hidden inputs.  Each tile of outputs accumulates
+       the same part of every row of weights, so weights are read
+       sequentially and tiles can be decoded in parallel */
+#pragma omp parallel for num_threads(threads_count()) if (autocoder->NoOfActive*n >= AUTOCODER_PARALLEL_MIN_SAMPLE_WEIGHTS)
+    for (tile = 0; tile < tiles; tile++) {
+        int start = tile*AUTOCODER_DECODE_TILE;
+        int length = n - start;
+
+        if (length > AUTOCODER_DECODE_TILE) length = AUTOCODER_DECODE_TILE;
+        memset((void*)&decoded[start],'\0',length*sizeof(float));
+        for (int a = 0; a < autocoder->NoOfActive; a++) {
+            int h = autocoder->active[a];
+
+            kernel_axpy(&decoded[start], autocoder->hiddens[h],
+                        &autocoder->weights[h*n + start], length);
         }
+    }
 
-        /* activation function */
-        decoded[i] = 1.0f / (1.0f + exp(-adder));
+    /* add some random noise */
+    if (autocoder->noise > 0) {
+        rand_add_noise(autocoder->random_seed, 0, decoded,
+                       autocoder->NoOfInputs, autocoder->noise);
+        rand_num(&autocoder->random_seed);
     }
+
+    /* activation function */
+    kernel_af_vector(autocoder->activation, decoded, autocoder->NoOfInputs);
 }
 
 /**
@@ -191,31 +417,13 @@ void autocoder_feed_forward(ac * autocoder)
 }
 
 /**
- * @brief Back propogate the error
+ * @brief Updates the running average of the error after a training
+ *        itteration, where autocoder->BPerror is the current error
  * @param autocoder Autocoder object
+ * @param errorPercent Sum of absolute output errors
  */
-void autocoder_backprop(ac * autocoder)
+static void autocoder_update_error_average(ac * autocoder, float errorPercent)
 {
-    /* clear the backptop error for each hidden unit */
-    memset((void*)autocoder->bperr,'\0',autocoder->NoOfHiddens*sizeof(float));
-
-    /* backprop from outputs to hiddens */
-    autocoder->BPerror = 0;
-    float errorPercent = 0;
-    for (int i = 0; i < autocoder->NoOfInputs; i++) {
-        float BPerror = autocoder->inputs[i] - autocoder->outputs[i];
-        autocoder->BPerror += fabs(BPerror);
-        errorPercent += fabs(BPerror);
-        float afact = autocoder->outputs[i] * (1.0f - autocoder->outputs[i]);
-        for (int h = 0; h < autocoder->NoOfHiddens; h++) {
-            if (autocoder->hiddens[h] == AUTOCODER_DROPPED_OUT)
-                continue;
-
-            autocoder->bperr[h] +=
-                BPerror * afact * autocoder->weights[h*autocoder->NoOfInputs + i];
-        }
-    }
-
     /* error percentage assuming an encoding range
        of 0.25 -> 0.75 */
     errorPercent = errorPercent * 100 / (0.6f*autocoder->NoOfInputs);
@@ -241,48 +449,442 @@ void autocoder_backprop(ac * autocoder)
 }
 
 /**
- * @brief Adjusts weights and biases
+ * @brief Calculates the error gradient of each output unit
  * @param autocoder Autocoder object
+ * @returns Sum of absolute output errors
  */
-void autocoder_learn(ac * autocoder)
+static float autocoder_output_gradient(ac * autocoder)
 {
-    /* weights between outputs and hiddens */
-    float e = autocoder->learningRate / (1.0f + autocoder->NoOfHiddens);
+    float errorPercent = 0;
+
     for (int i = 0; i < autocoder->NoOfInputs; i++) {
-        float afact = autocoder->outputs[i] * (1.0f - autocoder->outputs[i]);
         float BPerror = autocoder->inputs[i] - autocoder->outputs[i];
-        float gradient = afact * BPerror;
-        for (int h = 0; h < autocoder->NoOfHiddens; h++) {
-            if (autocoder->hiddens[h] == AUTOCODER_DROPPED_OUT)
-                continue;
-
-            int n = h*autocoder->NoOfInputs + i;
-            autocoder->lastWeightChange[n] =
-                e * (autocoder->lastWeightChange[n] + 1) *
-                gradient * autocoder->hiddens[h];
-            autocoder->weights[n] += autocoder->lastWeightChange[n];
+        errorPercent += fabs(BPerror);
+        float afact = kernel_af_derivative(autocoder->activation,
+                                           autocoder->outputs[i]);
+        autocoder->gradient[i] = BPerror * afact;
+    }
+    return errorPercent;
+}
+
+/**
+ * @brief Back propogate the error
+ * @param autocoder Autocoder object
+ */
+void autocoder_backprop(ac * autocoder)
+{
+    /* clear the backptop error for each hidden unit */
+    memset((void*)autocoder->bperr,'\0',autocoder->NoOfHiddens*sizeof(float));
+
+    /* backprop from outputs to hiddens */
+    float errorPercent = autocoder_output_gradient(autocoder);
+    autocoder->BPerror = errorPercent;
+    for (int a = 0; a < autocoder->NoOfActive; a++) {
+        int h = autocoder->active[a];
+
+        autocoder->bperr[h] =
+            kernel_dot(autocoder->gradient,
+                       &autocoder->weights[h*autocoder->NoOfInputs],
+                       autocoder->NoOfInputs);
+    }
+
+    autocoder_update_error_average(autocoder, errorPercent);
+}
+
+/**
+ * @brief Adjusts the weights and biases of the active hidden units
+ *        using the output gradients.  Both the decoding and encoding
+ *        updates are applied to a row of weights before moving on to
+ *        the next, so that each row is only brought into cache once.
+ * @param autocoder Autocoder object
+ * @param backprop If non-zero then the back propogated error of each
+ *        hidden unit is also calculated, from the row of weights before
+ *        it is updated
+ */
+static void autocoder_learn_rows(ac * autocoder, int backprop)
+{
+    int a, n = autocoder->NoOfInputs;
+    float e_decode = autocoder->learningRate / (1.0f + autocoder->NoOfHiddens);
+    float e_encode = autocoder->learningRate / (1.0f + n);
+
+    optimiser_next_step(&autocoder->optimiser);
+
+#pragma omp parallel for num_threads(threads_count()) if (autocoder->NoOfActive*n >= AUTOCODER_PARALLEL_MIN_SAMPLE_WEIGHTS)
+    for (a = 0; a < autocoder->NoOfActive; a++) {
+        int h = autocoder->active[a];
+        float * weights = &autocoder->weights[h*n];
+        float * lastWeightChange = &autocoder->lastWeightChange[h*n];
+        float * moment2 = NULL, * bias_moment2 = NULL;
+
+        if (autocoder->moment2 != NULL) {
+            moment2 = &autocoder->moment2[h*n];
+            bias_moment2 = &autocoder->bias_moment2[h];
+        }
+
+        if (backprop != 0) {
+            autocoder->bperr[h] = kernel_dot(autocoder->gradient, weights, n);
         }
+
+        /* weights between outputs and hiddens */
+        optimiser_update(&autocoder->optimiser, weights, lastWeightChange,
+                         moment2, autocoder->gradient, e_decode,
+                         autocoder->hiddens[h], n, NULL, NULL);
+
+        /* weights between hiddens and inputs */
+        float afact = kernel_af_derivative(autocoder->activation,
+                                           autocoder->hiddens[h]);
+        float gradient = afact * autocoder->bperr[h];
+        autocoder->bias[h] +=
+            optimiser_bias(&autocoder->optimiser,
+                           &autocoder->lastBiasChange[h],
+                           bias_moment2, e_encode, gradient);
+        optimiser_update(&autocoder->optimiser, weights, lastWeightChange,
+                         moment2, autocoder->inputs, e_encode, gradient,
+                         n, NULL, NULL);
     }
+}
 
-    /* weights between hiddens and inputs */
-    e = autocoder->learningRate / (1.0f + autocoder->NoOfInputs);
+/**
+ * @brief Adjusts weights and biases
+ * @param autocoder Autocoder object
+ */
+void autocoder_learn(ac * autocoder)
+{
+    autocoder_output_gradient(autocoder);
+    autocoder_learn_rows(autocoder, 0);
+}
+
+/**
+ * @brief Encodes the given inputs without altering the state of the
+ *        autocoder. Dropouts and noise are not applied, so this may be
+ *        called concurrently from several threads.
+ * @param autocoder Autocoder object
+ * @param inputs Array of NoOfInputs input values
+ * @param encoded Array to store the encoded values
+ */
+void autocoder_encode_inputs(ac * autocoder, const float * inputs, float * encoded)
+{
     for (int h = 0; h < autocoder->NoOfHiddens; h++) {
-        if (autocoder->hiddens[h] == AUTOCODER_DROPPED_OUT)
+        encoded[h] = autocoder->bias[h] +
+            kernel_dot(&autocoder->weights[h*autocoder->NoOfInputs],
+                       inputs, autocoder->NoOfInputs);
+    }
+    kernel_af_vector(autocoder->activation, encoded, autocoder->NoOfHiddens);
+}
+
+/**
+ * @brief Feeds forward and back propogates a single sample of a batch
+ *        using the given buffers rather than those of the autocoder
+ * @param autocoder Autocoder object
+ * @param inputs Array of NoOfInputs input values
+ * @param hiddens Returned hidden unit values, which are zero for
+ *        any units which were dropped
+ * @param gradient Returned error gradient of each output unit
+ * @param hidden_gradient Returned error gradient of each hidden unit,
+ *        which is zero for any units which were dropped
+ * @param mask Returned dropout mask, one for active hidden units
+ *        and zero for dropped units
+ * @param active Buffer of NoOfHiddens indexes of the active units
+ * @param random_seed Random number generator seed for this sample
+ * @returns Sum of absolute output errors
+ */
+static float autocoder_batch_sample(ac * autocoder, const float * inputs,
+                                    float * hiddens, float * gradient,
+                                    float * hidden_gradient,
+                                    float * mask, int * active,
+                                    unsigned int * random_seed)
+{
+    int a, h, i, n = autocoder->NoOfInputs;
+    int no_of_active = autocoder->NoOfHiddens;
+    float adder, BPerror, error = 0;
+
+    if (autocoder->DropoutPercent > 0) {
+        no_of_active =
+            rand_dropouts(random_seed, autocoder->DropoutPercent,
+                          mask, active, autocoder->NoOfHiddens);
+    }
+    else {
+        for (h = 0; h < autocoder->NoOfHiddens; h++) {
+            mask[h] = 1;
+            active[h] = h;
+        }
+    }
+    memset((void*)hiddens,'\0',autocoder->NoOfHiddens*sizeof(float));
+    memset((void*)hidden_gradient,'\0',autocoder->NoOfHiddens*sizeof(float));
+
+    /* encode */
+    for (a = 0; a < no_of_active; a++) {
+        h = active[a];
+        adder = autocoder->bias[h] +
+            kernel_dot(&autocoder->weights[h*n], inputs, n);
+        if (autocoder->noise > 0) {
+            adder = ((1.0f - autocoder->noise) * adder) +
+                (autocoder->noise * rand_uniform(*random_seed, (unsigned int)h));
+        }
+        hiddens[h] = kernel_af(autocoder->activation, adder);
+    }
+
+    /* decode into the gradient buffer */
+    memset((void*)gradient,'\0',n*sizeof(float));
+    for (a = 0; a < no_of_active; a++) {
+        h = active[a];
+        kernel_axpy(gradient, hiddens[h], &autocoder->weights[h*n], n);
+    }
+    if (autocoder->noise > 0) {
+        rand_add_noise(*random_seed, (unsigned int)autocoder->NoOfHiddens,
+                       gradient, n, autocoder->noise);
+    }
+    for (i = 0; i < n; i++) {
+        float output = kernel_af(autocoder->activation, gradient[i]);
+
+        /* error gradient of the output */
+        BPerror = inputs[i] - output;
+        error += fabs(BPerror);
+        gradient[i] = BPerror *
+            kernel_af_derivative(autocoder->activation, output);
+    }
+
+    /* back propogate to the hidden units */
+    for (a = 0; a < no_of_active; a++) {
+        h = active[a];
+        hidden_gradient[h] =
+            kernel_af_derivative(autocoder->activation, hiddens[h]) *
+            kernel_dot(gradient, &autocoder->weights[h*n], n);
+    }
+    return error;
+}
+
+/**
+ * @brief Returns the number of values within the gradients of an
+ *        autocoder, as used by autocoder_batch_gradients and
+ *        autocoder_apply_gradients.  These are the decoding and then
+ *        encoding weight gradients, the bias gradients, the number of
+ *        samples for which each hidden unit was active, the sum of
+ *        the errors and the number of samples.
+ * @param autocoder Autocoder object
+ * @returns The number of gradient values
+ */
+int autocoder_gradients_length(ac * autocoder)
+{
+    return (2*autocoder->NoOfInputs + 2)*autocoder->NoOfHiddens + 2;
+}
+
+/**
+ * @brief Adds the gradients of a batch of samples to the given sums
+ *        without changing the weights of the autocoder.
+ *        Each sample is fed forward and back propogated in parallel.
+ *        Each sample has its own stream of random numbers, so the result
+ *        does not depend upon the number of threads.  Sums from
+ *        several parts of a larger batch, possibly computed on
+ *        different machines, may be added together and then applied
+ *        with autocoder_apply_gradients.
+ * @param autocoder Autocoder object
+ * @param inputs Input values, one row of NoOfInputs values per sample
+ * @param batch_size The number of samples
+ * @param first_sample Index of the first sample within the larger batch,
+ *        used to select the random number stream of each sample
+ * @param gradients Sums of the gradients, autocoder_gradients_length
+ *        in size
+ * @returns zero on success
+ */
+int autocoder_batch_gradients(ac * autocoder, float * inputs, int batch_size,
+                              int first_sample, float * gradients)
+{
+    int b, n = autocoder->NoOfInputs, no_of_hiddens = autocoder->NoOfHiddens;
+    int parallel = (batch_size*n*no_of_hiddens >= AUTOCODER_PARALLEL_MIN_WEIGHTS);
+    unsigned int seed = autocoder->random_seed;
+    float * hiddens, * gradient, * hidden_gradient, * errors;
+    float * masks;
+    int * active;
+    float * decode_sums = gradients;
+    float * encode_sums = &gradients[no_of_hiddens*n];
+    float * bias_sums = &gradients[2*no_of_hiddens*n];
+    float * samples_active = &bias_sums[no_of_hiddens];
+    float * stats = &samples_active[no_of_hiddens];
+
+    if (batch_size < 1) {
+        return -1;
+    }
+
+    hiddens = (float*)malloc(batch_size*no_of_hiddens*sizeof(float));
+    hidden_gradient = (float*)malloc(batch_size*no_of_hiddens*sizeof(float));
+    gradient = (float*)malloc(batch_size*n*sizeof(float));
+    errors = (float*)malloc(batch_size*sizeof(float));
+    masks = (float*)malloc(batch_size*no_of_hiddens*sizeof(float));
+    active = (int*)malloc(batch_size*no_of_hiddens*sizeof(int));
+    if ((!hiddens) || (!hidden_gradient) || (!gradient) ||
+        (!errors) || (!masks) || (!active)) {
+        free(hiddens);
+        free(hidden_gradient);
+        free(gradient);
+        free(errors);
+        free(masks);
+        free(active);
+        return -2;
+    }
+
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
+    for (b = 0; b < batch_size; b++) {
+        unsigned int sample_seed = rand_stream_seed(seed, first_sample + b);
+        errors[b] =
+            autocoder_batch_sample(autocoder, &inputs[b*n],
+                                   &hiddens[b*no_of_hiddens],
+                                   &gradient[b*n],
+                                   &hidden_gradient[b*no_of_hiddens],
+                                   &masks[b*no_of_hiddens],
+                                   &active[b*no_of_hiddens],
+                                   &sample_seed);
+    }
+
+    /* reduce the gradients over the batch for each hidden unit,
+       always summing the samples in the same order.  Dropped units
+       have zero values and gradients, so contribute nothing */
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
+    for (int h = 0; h < no_of_hiddens; h++) {
+        for (int s = 0; s < batch_size; s++) {
+            float g = hidden_gradient[s*no_of_hiddens + h];
+
+            /* weights between outputs and hiddens */
+            kernel_axpy(&decode_sums[h*n], hiddens[s*no_of_hiddens + h],
+                        &gradient[s*n], n);
+
+            /* weights between hiddens and inputs */
+            kernel_axpy(&encode_sums[h*n], g, &inputs[s*n], n);
+            bias_sums[h] += g;
+            samples_active[h] += masks[s*no_of_hiddens + h];
+        }
+    }
+
+    for (b = 0; b < batch_size; b++) {
+        stats[0] += errors[b];
+    }
+    stats[1] += batch_size;
+
+    free(hiddens);
+    free(hidden_gradient);
+    free(gradient);
+    free(errors);
+    free(masks);
+    free(active);
+    return 0;
+}
+
+/**
+ * @brief Applies the average of gradients summed by
+ *        autocoder_batch_gradients as a single update.  The running
+ *        average of the error is updated as if each sample had been
+ *        presented in turn.
+ * @param autocoder Autocoder object
+ * @param gradients Sums of the gradients, autocoder_gradients_length
+ *        in size
+ * @returns zero on success
+ */
+int autocoder_apply_gradients(ac * autocoder, float * gradients)
+{
+    int b, n = autocoder->NoOfInputs, no_of_hiddens = autocoder->NoOfHiddens;
+    int parallel = (n*no_of_hiddens >= AUTOCODER_PARALLEL_MIN_WEIGHTS);
+    float e_decode = autocoder->learningRate / (1.0f + no_of_hiddens);
+    float e_encode = autocoder->learningRate / (1.0f + n);
+    float * decode_sums = gradients;
+    float * encode_sums = &gradients[no_of_hiddens*n];
+    float * bias_sums = &gradients[2*no_of_hiddens*n];
+    float * samples_active = &bias_sums[no_of_hiddens];
+    float * stats = &samples_active[no_of_hiddens];
+    int batch_size = (int)stats[1];
+    float scale;
+
+    if (batch_size < 1) {
+        return -1;
+    }
+    scale = 1.0f / batch_size;
+
+    optimiser_next_step(&autocoder->optimiser);
+
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
+    for (int h = 0; h < no_of_hiddens; h++) {
+        float * moment2 = NULL, * bias_moment2 = NULL;
+
+        if (samples_active[h] == 0)
             continue;
 
-        float afact = autocoder->hiddens[h] * (1.0f - autocoder->hiddens[h]);
-        float BPerror = autocoder->bperr[h];
-        float gradient = afact * BPerror;
-        autocoder->lastBiasChange[h] = e * (autocoder->lastBiasChange[h] + 1.0f) * gradient;
-        autocoder->bias[h] += autocoder->lastBiasChange[h];
-        for (int i = 0; i < autocoder->NoOfInputs; i++) {
-            int n = h*autocoder->NoOfInputs + i;
-            autocoder->lastWeightChange[n] =
-                e * (autocoder->lastWeightChange[n] + 1) *
-                gradient * autocoder->inputs[i];
-            autocoder->weights[n] += autocoder->lastWeightChange[n];
+        if (autocoder->moment2 != NULL) {
+            moment2 = &autocoder->moment2[h*n];
+            bias_moment2 = &autocoder->bias_moment2[h];
         }
+
+        /* weights between outputs and hiddens */
+        optimiser_update(&autocoder->optimiser,
+                         &autocoder->weights[h*n],
+                         &autocoder->lastWeightChange[h*n], moment2,
+                         &decode_sums[h*n], e_decode, scale, n,
+                         NULL, NULL);
+
+        /* weights between hiddens and inputs */
+        autocoder->bias[h] +=
+            optimiser_bias(&autocoder->optimiser,
+                           &autocoder->lastBiasChange[h], bias_moment2,
+                           e_encode, bias_sums[h] * scale);
+        optimiser_update(&autocoder->optimiser,
+                         &autocoder->weights[h*n],
+                         &autocoder->lastWeightChange[h*n], moment2,
+                         &encode_sums[h*n], e_encode, scale, n,
+                         NULL, NULL);
+    }
+
+    /* each sample counts as a training itteration */
+    autocoder->BPerror = stats[0] * scale;
+    for (b = 0; b < batch_size; b++) {
+        autocoder_update_error_average(autocoder, autocoder->BPerror);
     }
+
+    /* advance the shared seed once per batch */
+    rand_num(&autocoder->random_seed);
+    return 0;
+}
+
+/**
+ * @brief Trains the autocoder on a batch of samples.
+ *        Each sample is fed forward and back propogated in parallel
+ *        and the averaged gradients are then applied as a single update.
+ *        Each sample has its own stream of random numbers, so the result
+ *        does not depend upon the number of threads.  If an allreduce
+ *        function has been set then the gradients are summed with those
+ *        of the other processes before being applied.
+ * @param autocoder Autocoder object
+ * @param inputs Input values, one row of NoOfInputs values per sample
+ * @param batch_size The number of samples
+ * @returns zero on success
+ */
+int autocoder_update_batch(ac * autocoder, float * inputs, int batch_size)
+{
+    int retval;
+    float * gradients;
+
+    if (batch_size < 1) {
+        return -1;
+    }
+
+    gradients = (float*)calloc(autocoder_gradients_length(autocoder),
+                               sizeof(float));
+    if (!gradients) {
+        return -2;
+    }
+
+    retval = autocoder_batch_gradients(autocoder, inputs, batch_size,
+                                       0, gradients);
+    if ((retval == 0) && (autocoder->allreduce != NULL)) {
+        if (autocoder->allreduce(gradients,
+                                 autocoder_gradients_length(autocoder),
+                                 autocoder->allreduce_data) != 0) {
+            retval = -3;
+        }
+    }
+    if (retval == 0) {
+        retval = autocoder_apply_gradients(autocoder, gradients);
+    }
+
+    free(gradients);
+    return retval;
 }
 
 /**
@@ -293,6 +895,10 @@ void autocoder_learn(ac * autocoder)
  */
 int autocoder_save(FILE * fp, ac * autocoder)
 {
+    if (bp_format_save(fp, AUTOCODER_FILE_MAGIC,
+                       AUTOCODER_FILE_VERSION) != 0) {
+        return -15;
+    }
     if (fwrite(&autocoder->NoOfInputs, sizeof(int), 1, fp) == 0) {
         return -1;
     }
@@ -330,6 +936,20 @@ int autocoder_save(FILE * fp, ac * autocoder)
     if (fwrite(&autocoder->itterations, sizeof(unsigned int), 1, fp) == 0) {
         return -11;
     }
+    if (fwrite(&autocoder->activation, sizeof(int), 1, fp) == 0) {
+        return -12;
+    }
+    if (optimiser_save(fp, &autocoder->optimiser) != 0) {
+        return -13;
+    }
+    if (optimiser_second_moment(&autocoder->optimiser)) {
+        if ((fwrite(autocoder->moment2, sizeof(float),
+                    autocoder->NoOfInputs*autocoder->NoOfHiddens, fp) == 0) ||
+            (fwrite(autocoder->bias_moment2, sizeof(float),
+                    autocoder->NoOfHiddens, fp) == 0)) {
+            return -14;
+        }
+    }
     return 0;
 }
 
@@ -345,7 +965,14 @@ int autocoder_load(FILE * fp, ac * autocoder, int initialise)
     int no_of_inputs = 0;
     int no_of_hiddens = 0;
     unsigned int random_seed = 0;
+    int version;
+    deeplearn_optimiser optimiser;
 
+    version = bp_format_load(fp, AUTOCODER_FILE_MAGIC,
+                             AUTOCODER_FILE_VERSION);
+    if (version < 0) {
+        return -16;
+    }
     if (fread(&no_of_inputs, sizeof(int), 1, fp) == 0) {
         return -1;
     }
@@ -399,6 +1026,35 @@ int autocoder_load(FILE * fp, ac * autocoder, int initialise)
     if (fread(&autocoder->itterations, sizeof(unsigned int), 1, fp) == 0) {
         return -12;
     }
+
+    /* older files keep the current activation function and optimiser */
+    if (version == 0) {
+        return 0;
+    }
+    if ((fread(&autocoder->activation, sizeof(int), 1, fp) == 0) ||
+        (autocoder->activation < 0) ||
+        (autocoder->activation >= AF_FUNCTIONS)) {
+        return -13;
+    }
+    if (optimiser_load(fp, &optimiser) != 0) {
+        return -14;
+    }
+    free(autocoder->moment2);
+    free(autocoder->bias_moment2);
+    autocoder->moment2 = NULL;
+    autocoder->bias_moment2 = NULL;
+    if (optimiser_second_moment(&optimiser)) {
+        size_t n = (size_t)autocoder->NoOfInputs*autocoder->NoOfHiddens;
+
+        if ((autocoder_moments_alloc(autocoder) != 0) ||
+            (fread(autocoder->moment2, sizeof(float), n, fp) != n) ||
+            (fread(autocoder->bias_moment2, sizeof(float),
+                   autocoder->NoOfHiddens, fp) !=
+             (size_t)autocoder->NoOfHiddens)) {
+            return -15;
+        }
+    }
+    autocoder->optimiser = optimiser;
     return 0;
 }
 
@@ -442,6 +1098,8 @@ float autocoder_get_hidden(ac * autocoder, int index)
  */
 void autocoder_set_hidden(ac * autocoder, int index, float value)
 {
+	/* a unit which has been given a value is no longer dropped out */
+	autocoder_clear_dropouts(autocoder);
 	autocoder->hiddens[index] = value;
 }
 
@@ -452,8 +1110,12 @@ void autocoder_set_hidden(ac * autocoder, int index, float value)
 void autocoder_update(ac * autocoder)
 {
 	autocoder_feed_forward(autocoder);
-	autocoder_backprop(autocoder);
-	autocoder_learn(autocoder);
+
+	/* back propogate and learn in a single pass over the weights */
+	memset((void*)autocoder->bperr,'\0',autocoder->NoOfHiddens*sizeof(float));
+	autocoder->BPerror = autocoder_output_gradient(autocoder);
+	autocoder_learn_rows(autocoder, 1);
+	autocoder_update_error_average(autocoder, autocoder->BPerror);
 }
 
 /**
@@ -505,6 +1167,9 @@ int autocoder_compare(ac * autocoder0, ac * autocoder1)
 			return -4;
 		}
 	}
+	if (autocoder0->activation != autocoder1->activation) {
+		return -5;
+	}
 	return 0;
 }
 
@@ -37,6 +37,32 @@
 #include "deeplearn_random.h"
 #include "deeplearn_images.h"
 #include "backprop_neuron.h"
+#include "deeplearn_kernels.h"
+#include "deeplearn_arena.h"
+#include "deeplearn_optimiser.h"
+#include "deeplearn_threads.h"
+
+/* minimum number of weight evaluations in a batch update
+   before samples are processed in parallel */
+#define AUTOCODER_PARALLEL_MIN_WEIGHTS 8192
+
+/* minimum number of weights before the rows of weights are updated in
+   parallel for a single sample */
+#define AUTOCODER_PARALLEL_MIN_SAMPLE_WEIGHTS 65536
+
+/* number of outputs decoded together, so that this part of the output
+   array stays in cache while every row of weights is applied to it */
+#define AUTOCODER_DECODE_TILE 1024
+
+/* identifier and version at the start of a saved autocoder.  Version 1
+   added the activation function and optimiser */
+#define AUTOCODER_FILE_MAGIC   "LIBDEEPA"
+#define AUTOCODER_FILE_VERSION 1
+
+/* Sums an array of values across processes, such as MPI_Allreduce
+   with MPI_SUM, so that every process ends up with the totals.
+   Returns zero on success */
+typedef int (*deeplearn_allreduce)(float * values, int length, void * data);
 
 struct autocode {
 	unsigned int random_seed;
@@ -52,19 +78,42 @@ struct autocode {
 	float * hiddens;
 	float * outputs;
 
+	/* dropouts of the hidden units.  The mask is one for active
+	   units and zero for units which have dropped out, and the
+	   indexes of the NoOfActive active units are listed in active */
+	float * dropout_mask;
+	int * active;
+	int NoOfActive;
+
 	/* weights. Note that these are symmetric.
 	   inputs -w-> hiddens <-w- outputs */
 	float * weights;
 
+	/* non-zero if the weights belong to another object, such as
+	   a hidden layer of a backprop network */
+	unsigned char shared_weights;
+
 	/* array used during learning */
 	float * lastWeightChange;
 
+	/* memory from which the arrays of the autocoder are taken */
+	deeplearn_arena arena;
+
 	/* biases of hidden units */
 	float * bias;
 	float * lastBiasChange;
 
+	/* rule used to update the weights, and the second moments of the
+	   weights and biases if the rule needs them, otherwise NULL */
+	deeplearn_optimiser optimiser;
+	float * moment2;
+	float * bias_moment2;
+
 	/* backprop error */
 	float * bperr;
+
+	/* error gradient of each output unit */
+	float * gradient;
 	float BPerror;
 	float BPerrorPercent;
 	float BPerrorAverage;
@@ -72,8 +121,21 @@ struct autocode {
 	float learningRate;
 	float noise;
 
+	/* activation function of the hidden and output units (AF_*) */
+	int activation;
+
 	/* training itterations */
 	unsigned int itterations;
+
+	/* if non-zero then feature learning accumulates the gradients of
+	   all image patches and applies them as a single batch update */
+	unsigned char patch_batch;
+
+	/* if set then the gradients of each batch update are summed across
+	   processes by this function before they are applied, so that
+	   several machines can train copies of the same autocoder */
+	deeplearn_allreduce allreduce;
+	void * allreduce_data;
 };
 typedef struct autocode ac;
 
@@ -82,6 +144,10 @@ int autocoder_init(ac * autocoder,
 				   int no_of_hiddens,
 				   unsigned int random_seed);
 void autocoder_free(ac * autocoder);
+void autocoder_memory_usage(ac * autocoder, deeplearn_footprint * usage);
+int autocoder_clone(ac * dest, ac * source);
+int autocoder_share_weights(ac * autocoder, float * weights);
+int autocoder_set_optimiser(ac * autocoder, int type);
 void autocoder_encode(ac * autocoder, float * encoded, unsigned char use_dropouts);
 void autocoder_decode(ac * autocoder, float * decoded);
 void autocoder_feed_forward(ac * autocoder);
@@ -94,6 +160,12 @@ void autocoder_set_inputs(ac * autocoder, float inputs[]);
 float autocoder_get_hidden(ac * autocoder, int index);
 void autocoder_set_hidden(ac * autocoder, int index, float value);
 void autocoder_update(ac * autocoder);
+void autocoder_encode_inputs(ac * autocoder, const float * inputs, float * encoded);
+int autocoder_update_batch(ac * autocoder, float * inputs, int batch_size);
+int autocoder_gradients_length(ac * autocoder);
+int autocoder_batch_gradients(ac * autocoder, float * inputs, int batch_size,
+                              int first_sample, float * gradients);
+int autocoder_apply_gradients(ac * autocoder, float * gradients);
 void autocoder_normalise_inputs(ac * autocoder);
 int autocoder_compare(ac * autocoder0, ac * autocoder1);
 int autocoder_plot_weights(ac * autocoder,
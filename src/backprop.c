@@ -47,6 +47,183 @@ int bp_hiddens_in_layer(bp * net, int layer)
     return net->NoOfHiddens - ((net->NoOfHiddens - net->NoOfOutputs)*layer/net->HiddenLayers);
 }
 
+/**
+* @brief Returns the number of bytes of arena needed by a layer
+* @param no_of_units The number of units within the layer
+* @param no_of_inputs The number of inputs to each unit
+* @returns Size in bytes
+*/
+static size_t bp_layer_arena_bytes(int no_of_units, int no_of_inputs)
+{
+    return deeplearn_arena_bytes(no_of_units*sizeof(bp_neuron)) +
+        2*deeplearn_arena_bytes(no_of_units*no_of_inputs*sizeof(float)) +
+        deeplearn_arena_bytes(no_of_units*no_of_inputs*sizeof(bp_neuron*)) +
+        3*deeplearn_arena_bytes(no_of_units*sizeof(float)) +
+        deeplearn_arena_bytes(no_of_units*sizeof(int));
+}
+
+/**
+* @brief Takes the packed storage for a layer from the network's arena
+*        and initialises its units so that their weights point into
+*        the layer's weight matrix
+* @param layer The layer to be initialised
+* @param arena Arena from which the arrays of the layer are taken
+* @param no_of_units The number of units within the layer
+* @param no_of_inputs The number of inputs to each unit
+* @param random_seed The random number generator seed
+* @returns zero on success
+*/
+static int bp_layer_init(bp_layer * layer, deeplearn_arena * arena,
+                         int no_of_units, int no_of_inputs,
+                         unsigned int * random_seed)
+{
+    int i;
+    bp_neuron ** inputs;
+
+    layer->NoOfUnits = no_of_units;
+    layer->NoOfInputs = no_of_inputs;
+
+    layer->units = (bp_neuron*)
+        deeplearn_arena_alloc(arena, no_of_units*sizeof(bp_neuron));
+    if (!layer->units) {
+        return -1;
+    }
+    layer->weights = (float*)
+        deeplearn_arena_alloc(arena, no_of_units*no_of_inputs*sizeof(float));
+    if (!layer->weights) {
+        return -2;
+    }
+    layer->lastWeightChange = (float*)
+        deeplearn_arena_alloc(arena, no_of_units*no_of_inputs*sizeof(float));
+    if (!layer->lastWeightChange) {
+        return -3;
+    }
+    layer->values = (float*)
+        deeplearn_arena_alloc(arena, no_of_units*sizeof(float));
+    if (!layer->values) {
+        return -4;
+    }
+    layer->BPerror = (float*)
+        deeplearn_arena_alloc(arena, no_of_units*sizeof(float));
+    if (!layer->BPerror) {
+        return -5;
+    }
+    layer->dropout_mask = (float*)
+        deeplearn_arena_alloc(arena, no_of_units*sizeof(float));
+    if (!layer->dropout_mask) {
+        return -6;
+    }
+    layer->active = (int*)
+        deeplearn_arena_alloc(arena, no_of_units*sizeof(int));
+    if (!layer->active) {
+        return -7;
+    }
+    for (i = 0; i < no_of_units; i++) {
+        layer->dropout_mask[i] = 1;
+        layer->active[i] = i;
+    }
+    layer->NoOfActive = no_of_units;
+
+    /* batch arrays are allocated when first needed */
+    layer->batch_capacity = 0;
+    layer->batch_values = 0;
+    layer->batch_BPerror = 0;
+    layer->weight_gradient = 0;
+    layer->bias_gradient = 0;
+    layer->moment2 = 0;
+    layer->bias_moment2 = 0;
+    layer->sparse = 0;
+    layer->quant = 0;
+
+    /* pointers to the input neurons of every unit */
+    inputs = (bp_neuron**)
+        deeplearn_arena_alloc(arena,
+                              no_of_units*no_of_inputs*sizeof(bp_neuron*));
+    if (!inputs) {
+        return -8;
+    }
+
+    for (i = 0; i < no_of_units; i++) {
+        if (bp_neuron_init_packed(&layer->units[i], no_of_inputs,
+                                  &layer->weights[i*no_of_inputs],
+                                  &layer->lastWeightChange[i*no_of_inputs],
+                                  &inputs[i*no_of_inputs],
+                                  random_seed) != 0) {
+            return -9;
+        }
+    }
+    return 0;
+}
+
+/**
+* @brief Deallocates the sparse connections of a layer, after which
+*        the dense weights are used
+* @param layer The layer whose sparse connections are to be freed
+*/
+static void bp_layer_sparse_free(bp_layer * layer)
+{
+    if (layer->sparse == 0) return;
+
+    free(layer->sparse->row_start);
+    free(layer->sparse->column);
+    free(layer->sparse->values);
+    free(layer->sparse);
+    layer->sparse = 0;
+}
+
+/**
+* @brief Deallocates the quantised weights of a layer
+* @param layer The layer whose quantised weights are to be freed
+*/
+static void bp_layer_quant_free(bp_layer * layer)
+{
+    if (layer->quant == 0) return;
+
+    free(layer->quant->weights);
+    free(layer->quant->scale);
+    free(layer->quant->row_sum);
+    free(layer->quant);
+    layer->quant = 0;
+}
+
+/**
+* @brief Deallocates the neutral input biases of a layer
+* @param layer The layer whose neutral input biases are to be freed
+*/
+static void bp_layer_neutral_free(bp_layer * layer)
+{
+    if (layer->neutral == 0) return;
+
+    free(layer->neutral->bias);
+    free(layer->neutral->changed);
+    free(layer->neutral->delta);
+    free(layer->neutral);
+    layer->neutral = 0;
+}
+
+/**
+* @brief Deallocates the storage of a layer which is not part of
+*        the network's arena
+* @param layer The layer to be freed
+*/
+static void bp_layer_free(bp_layer * layer)
+{
+    bp_layer_sparse_free(layer);
+    bp_layer_quant_free(layer);
+    bp_layer_neutral_free(layer);
+
+    /* the packed arrays belong to the network's arena, so only
+       the arrays allocated after construction are freed here */
+    free(layer->batch_values);
+    free(layer->batch_BPerror);
+    free(layer->weight_gradient);
+    free(layer->bias_gradient);
+    free(layer->moment2);
+    free(layer->bias_moment2);
+    layer->moment2 = 0;
+    layer->bias_moment2 = 0;
+}
+
 /**
 * @brief Initialise a backprop neural net
 * @param net Backprop neural net object
@@ -65,10 +242,15 @@ int bp_init(bp * net,
             unsigned int * random_seed)
 {
     int i, j, l;
-    bp_neuron * n;
+    size_t arena_bytes;
+    bp_layer * prev, * curr;
 
     net->learningRate = 0.2f;
     net->noise = 0.0f;
+    net->activation = AF_LOGISTIC;
+    net->inference_precision = KERNEL_FP32;
+    optimiser_init(&net->optimiser);
+    net->generation = device_weights_changed();
     net->random_seed = *random_seed;
     net->BPerror = DEEPLEARN_UNKNOWN_ERROR;
     net->BPerrorAverage = DEEPLEARN_UNKNOWN_ERROR;
@@ -77,88 +259,106 @@ int bp_init(bp * net,
     net->DropoutPercent = 20;
 
     net->NoOfInputs = no_of_inputs;
-    net->inputs = (bp_neuron**)malloc(no_of_inputs*sizeof(bp_neuron*));
+    net->NoOfHiddens = no_of_hiddens;
+    net->NoOfOutputs = no_of_outputs;
+    net->HiddenLayers = hidden_layers;
+
+    /* everything which the network holds is taken from one arena,
+       so work out how large it needs to be */
+    arena_bytes =
+        deeplearn_arena_bytes(no_of_inputs*sizeof(bp_neuron*)) +
+        deeplearn_arena_bytes(hidden_layers*sizeof(bp_neuron**)) +
+        deeplearn_arena_bytes(no_of_outputs*sizeof(bp_neuron*)) +
+        deeplearn_arena_bytes((hidden_layers+2)*sizeof(bp_layer)) +
+        bp_layer_arena_bytes(no_of_inputs, 1) +
+        bp_layer_arena_bytes(no_of_outputs,
+                             (hidden_layers > 0) ?
+                             bp_hiddens_in_layer(net,hidden_layers-1) :
+                             no_of_inputs);
+    for (l = 0; l < hidden_layers; l++) {
+        arena_bytes +=
+            deeplearn_arena_bytes(bp_hiddens_in_layer(net,l)*
+                                  sizeof(bp_neuron*)) +
+            bp_layer_arena_bytes(bp_hiddens_in_layer(net,l),
+                                 (l == 0) ? no_of_inputs :
+                                 bp_hiddens_in_layer(net,l-1));
+    }
+    if (deeplearn_arena_init(&net->arena, arena_bytes) != 0) {
+        return -1;
+    }
+
+    net->inputs = (bp_neuron**)
+        deeplearn_arena_alloc(&net->arena, no_of_inputs*sizeof(bp_neuron*));
     if (!net->inputs) {
         return -1;
     }
 
-    net->NoOfHiddens = no_of_hiddens;
-    net->NoOfOutputs = no_of_outputs;
-    net->HiddenLayers = hidden_layers;
-    net->hiddens =
-        (bp_neuron***)malloc(hidden_layers*sizeof(bp_neuron**));
+    net->hiddens = (bp_neuron***)
+        deeplearn_arena_alloc(&net->arena, hidden_layers*sizeof(bp_neuron**));
     if (!net->hiddens) {
         return -2;
     }
     for (l = 0; l < hidden_layers; l++) {
-        net->hiddens[l] =
-            (bp_neuron**)malloc(bp_hiddens_in_layer(net,l)*sizeof(bp_neuron*));
+        net->hiddens[l] = (bp_neuron**)
+            deeplearn_arena_alloc(&net->arena,
+                                  bp_hiddens_in_layer(net,l)*
+                                  sizeof(bp_neuron*));
         if (!net->hiddens[l]) {
             return -3;
         }
     }
 
-    net->outputs = (bp_neuron**)malloc(no_of_outputs*sizeof(bp_neuron*));
+    net->outputs = (bp_neuron**)
+        deeplearn_arena_alloc(&net->arena, no_of_outputs*sizeof(bp_neuron*));
     if (!net->outputs) {
         return -4;
     }
 
+    net->layer = (bp_layer*)
+        deeplearn_arena_alloc(&net->arena, (hidden_layers+2)*sizeof(bp_layer));
+    if (!net->layer) {
+        return -5;
+    }
+
     /* create inputs */
+    if (bp_layer_init(&net->layer[0], &net->arena,
+                      no_of_inputs, 1, random_seed) != 0) {
+        return -6;
+    }
     for (i = 0; i < net->NoOfInputs; i++) {
-        net->inputs[i] = (bp_neuron*)malloc(sizeof(struct bp_n));
-        if (!net->inputs[i]) {
-            return -5;
-        }
-        if (bp_neuron_init(net->inputs[i], 1, random_seed) != 0) {
-            return -6;
-        }
+        net->inputs[i] = &net->layer[0].units[i];
     }
 
     /* create hiddens */
     for (l = 0; l < hidden_layers; l++) {
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-            net->hiddens[l][i] =
-                (bp_neuron*)malloc(sizeof(bp_neuron));
-            if (!net->hiddens[l][i]) {
-                return -7;
-            }
-            n = net->hiddens[l][i];
-            if (l == 0) {
-                if (bp_neuron_init(n, no_of_inputs, random_seed) != 0) {
-                    return -8;
-                }
-                /* connect to input layer */
-                for (j = 0; j < net->NoOfInputs; j++) {
-                    bp_neuron_add_connection(n, j, net->inputs[j]);
-                }
-            }
-            else {
-                if (bp_neuron_init(n, bp_hiddens_in_layer(net,l-1), random_seed) != 0) {
-                    return -9;
-                }
-                /* connect to previous hidden layer */
-                for (j = 0; j < bp_hiddens_in_layer(net,l-1); j++) {
-                    bp_neuron_add_connection(n, j, net->hiddens[l-1][j]);
-                }
+        prev = &net->layer[l];
+        curr = &net->layer[l+1];
+        if (bp_layer_init(curr, &net->arena, bp_hiddens_in_layer(net,l),
+                          prev->NoOfUnits, random_seed) != 0) {
+            return -7;
+        }
+        for (i = 0; i < curr->NoOfUnits; i++) {
+            net->hiddens[l][i] = &curr->units[i];
+            /* connect to the previous layer */
+            for (j = 0; j < prev->NoOfUnits; j++) {
+                bp_neuron_add_connection(&curr->units[i], j,
+                                         &prev->units[j]);
             }
         }
     }
 
     /* create outputs */
+    prev = &net->layer[hidden_layers];
+    curr = &net->layer[hidden_layers+1];
+    if (bp_layer_init(curr, &net->arena, no_of_outputs,
+                      prev->NoOfUnits, random_seed) != 0) {
+        return -8;
+    }
     for (i = 0; i < net->NoOfOutputs; i++) {
-        net->outputs[i] = (bp_neuron*)malloc(sizeof(bp_neuron));
-        if (!net->outputs[i]) {
-            return -10;
-        }
-        n = net->outputs[i];
-        if (bp_neuron_init(n,
-                           bp_hiddens_in_layer(net,hidden_layers-1),
-                           random_seed) != 0) {
-            return -11;
-        }
-        for (j = 0; j < bp_hiddens_in_layer(net,hidden_layers-1); j++) {
-            bp_neuron_add_connection(n, j,
-                                     net->hiddens[hidden_layers-1][j]);
+        net->outputs[i] = &curr->units[i];
+        for (j = 0; j < prev->NoOfUnits; j++) {
+            bp_neuron_add_connection(&curr->units[i], j,
+                                     &prev->units[j]);
         }
     }
     return 0;
@@ -170,665 +370,3123 @@ int bp_init(bp * net,
 */
 void bp_free(bp * net)
 {
-    int l,i;
+    int l;
 
-    for (i = 0; i < net->NoOfInputs; i++) {
-        bp_neuron_free(net->inputs[i]);
-        free(net->inputs[i]);
-        net->inputs[i] = 0;
-    }
-    free(net->inputs);
-    for (l = 0; l < net->HiddenLayers; l++) {
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-            bp_neuron_free(net->hiddens[l][i]);
-            free(net->hiddens[l][i]);
-            net->hiddens[l][i] = 0;
-        }
-        free(net->hiddens[l]);
-        net->hiddens[l] = 0;
+    for (l = 0; l < net->HiddenLayers+2; l++) {
+        bp_layer_free(&net->layer[l]);
     }
-    free(net->hiddens);
 
-    for (i = 0; i < net->NoOfOutputs; i++) {
-        bp_neuron_free(net->outputs[i]);
-        free(net->outputs[i]);
-        net->outputs[i] = 0;
-    }
-    free(net->outputs);
+    /* the layers, units and weights are released together */
+    deeplearn_arena_free(&net->arena);
+    net->layer = 0;
+    net->inputs = 0;
+    net->hiddens = 0;
+    net->outputs = 0;
 }
 
 /**
-* @brief Propagates the current inputs through the layers of the network
-* @param net Backprop neural net object
+* @brief Adds the memory used by a layer to a footprint.  Arrays within
+*        the network's arena are added to their component, so that the
+*        remainder of the arena can be counted as other memory
+* @param layer The layer
+* @param usage Memory footprint which is increased
+* @returns The number of bytes of the network's arena which were counted
 */
-void bp_feed_forward(bp * net)
+static size_t bp_layer_memory_usage(bp_layer * layer,
+                                    deeplearn_footprint * usage)
 {
-    int i,l;
-    bp_neuron * n;
+    size_t units = (size_t)layer->NoOfUnits;
+    size_t weights = units*layer->NoOfInputs;
+    size_t counted;
+
+    /* within the arena.  Units hold the biases */
+    counted = units*sizeof(bp_neuron) + weights*sizeof(float);
+    usage->weights += counted;
+    usage->optimiser += weights*sizeof(float);
+    usage->activations += 3*units*sizeof(float) + units*sizeof(int);
+    counted += weights*sizeof(float) + 3*units*sizeof(float) +
+        units*sizeof(int);
+
+    /* allocated after construction */
+    usage->activations +=
+        2*(size_t)layer->batch_capacity*units*sizeof(float);
+    if (layer->weight_gradient) {
+        usage->optimiser += weights*sizeof(float);
+    }
+    if (layer->bias_gradient) {
+        usage->optimiser += units*sizeof(float);
+    }
+    if (layer->moment2) {
+        usage->optimiser += weights*sizeof(float);
+    }
+    if (layer->bias_moment2) {
+        usage->optimiser += units*sizeof(float);
+    }
+    if (layer->sparse) {
+        usage->weights += sizeof(bp_sparse) + (units+1)*sizeof(int) +
+            (size_t)(layer->sparse->nonzero+1)*(sizeof(int)+sizeof(float));
+    }
+    if (layer->quant) {
+        usage->weights += sizeof(bp_quant) + weights*sizeof(int8_t) +
+            units*(sizeof(float) + sizeof(int32_t));
+    }
+    if (layer->neutral) {
+        usage->weights += sizeof(bp_neutral) + units*sizeof(float);
+        usage->activations +=
+            (size_t)layer->NoOfInputs*(sizeof(int) + sizeof(float));
+    }
+    return counted;
+}
 
-    /* for each hidden layer */
-    for (l = 0; l < net->HiddenLayers; l++) {
-        /* For each unit within the layer */
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-            /* get the neuron object */
-            n = net->hiddens[l][i];
-            /* the neuron's activation function */
-            bp_neuron_feedForward(n, net->noise, &net->random_seed);
+/**
+* @brief Returns the memory used by a network, broken down into weights,
+*        optimiser state and activations
+* @param net Backprop neural net object
+* @param usage Returned memory footprint
+*/
+void bp_memory_usage(bp * net, deeplearn_footprint * usage)
+{
+    size_t arena = deeplearn_arena_allocated(&net->arena);
+    size_t counted = 0;
+    int l;
+
+    deeplearn_footprint_clear(usage);
+    if (net->layer) {
+        for (l = 0; l < net->HiddenLayers+2; l++) {
+            counted += bp_layer_memory_usage(&net->layer[l], usage);
         }
     }
 
-    /* for each unit in the output layer */
-    for (i = 0; i < net->NoOfOutputs; i++) {
-        /* get the neuron object */
-        n = net->outputs[i];
-        /* the neuron's activation function */
-        bp_neuron_feedForward(n, net->noise, &net->random_seed);
+    /* neuron pointers, layer structures and alignment */
+    usage->other += sizeof(bp);
+    if (arena > counted) {
+        usage->other += arena - counted;
     }
 }
 
 /**
-* @brief Propagates the current inputs through a given number of
-*        layers of the network
+* @brief Frees the mini-batch arrays and gradient sums of a network,
+*        which are allocated again by the next batch update
 * @param net Backprop neural net object
-* @param layers The number of layers to propagate through
 */
-void bp_feed_forward_layers(bp * net, int layers)
+void bp_trim_memory(bp * net)
 {
-    int i,l;
-    bp_neuron * n;
+    int l;
 
-    /* for each hidden layer */
-    for (l = 0; l < layers; l++) {
-        /* if this layer is a hidden layer */
-        if (l < net->HiddenLayers) {
-            /* For each unit within the layer */
-            for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-                /* get the neuron object */
-                n = net->hiddens[l][i];
-                /* the neuron's activation function */
-                bp_neuron_feedForward(n, net->noise, &net->random_seed);
-            }
-        }
-        else {
-            /* For each unit within the output layer */
-            for (i = 0; i < net->NoOfOutputs; i++) {
-                /* get the neuron object */
-                n = net->outputs[i];
-                /* the neuron's activation function */
-                bp_neuron_feedForward(n, net->noise, &net->random_seed);
-            }
-        }
+    if (!net->layer) return;
+
+    for (l = 0; l < net->HiddenLayers+2; l++) {
+        bp_layer * layer = &net->layer[l];
+
+        free(layer->batch_values);
+        free(layer->batch_BPerror);
+        free(layer->weight_gradient);
+        free(layer->bias_gradient);
+        layer->batch_values = 0;
+        layer->batch_BPerror = 0;
+        layer->weight_gradient = 0;
+        layer->bias_gradient = 0;
+        layer->batch_capacity = 0;
     }
 }
 
 /**
-* @brief back-propogate errors from the output layer towards the input layer
-* @param net Backprop neural net object
+* @brief Returns the equivalent within a cloned network of a pointer
+*        into the arena of the source network
+* @param dest Cloned network
+* @param source Network from which the clone was made
+* @param ptr Pointer to be moved
+* @returns The pointer within the arena of the cloned network
 */
-void bp_backprop(bp * net, int current_hidden_layer)
+static void * bp_relocate(bp * dest, bp * source, void * ptr)
 {
-    int i, l, neuron_count=0;
-    bp_neuron * n;
-    int start_hidden_layer = current_hidden_layer-1;
-    float errorPercent=0;
+    return deeplearn_arena_relocate(&dest->arena, &source->arena, ptr);
+}
 
-    /* clear all previous backprop errors */
-    for (i = 0; i < net->NoOfInputs; i++) {
-        /* get the neuron object */
-        n = net->inputs[i];
-        /* set the backprop error to zero */
-        n->BPerror = 0;
-    }
+/**
+* @brief Copies the sparse connections of a pruned layer
+* @param dest Layer to copy into
+* @param source Layer to copy from
+* @returns zero on success
+*/
+static int bp_layer_sparse_copy(bp_layer * dest, bp_layer * source)
+{
+    bp_sparse * sparse;
 
-    /* for every hidden layer */
-    if (start_hidden_layer < 0) {
-        start_hidden_layer = 0;
-    }
+    dest->sparse = 0;
+    if (source->sparse == 0) return 0;
 
-    for (l = start_hidden_layer; l < net->HiddenLayers; l++) {
-        /* For each unit within the layer */
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-            /* get the neuron object */
-            n = net->hiddens[l][i];
-            /* set the backprop error to zero */
-            n->BPerror = 0;
-        }
+    sparse = (bp_sparse*)malloc(sizeof(bp_sparse));
+    if (!sparse) {
+        return -1;
     }
-
-    /* now back-propogate the error from the output units */
-    net->BPerrorTotal = 0;
-    /* for every output unit */
-    for (i = 0; i < net->NoOfOutputs; i++, neuron_count++) {
-        /* get the neuron object */
-        n = net->outputs[i];
-        /* backpropogate the error */
-        bp_neuron_backprop(n);
-        /* update the total error which is used to assess
-            network performance */
-        net->BPerrorTotal += n->BPerror;
-        errorPercent += fabs(n->BPerror);
+    sparse->nonzero = source->sparse->nonzero;
+    sparse->row_start = (int*)malloc((dest->NoOfUnits+1)*sizeof(int));
+    sparse->column = (int*)malloc((sparse->nonzero+1)*sizeof(int));
+    sparse->values = (float*)malloc((sparse->nonzero+1)*sizeof(float));
+    dest->sparse = sparse;
+    if ((!sparse->row_start) || (!sparse->column) || (!sparse->values)) {
+        bp_layer_sparse_free(dest);
+        return -2;
     }
+    memcpy((void*)sparse->row_start, (void*)source->sparse->row_start,
+           (dest->NoOfUnits+1)*sizeof(int));
+    memcpy((void*)sparse->column, (void*)source->sparse->column,
+           (sparse->nonzero+1)*sizeof(int));
+    memcpy((void*)sparse->values, (void*)source->sparse->values,
+           (sparse->nonzero+1)*sizeof(float));
+    return 0;
+}
 
-    /* error percentage assuming an encoding range
-       of 0.25 -> 0.75 */
-    errorPercent = errorPercent * 100 / (0.5f*net->NoOfOutputs);
+/**
+* @brief Copies the quantised weights of a layer
+* @param dest Layer to copy into
+* @param source Layer to copy from
+* @returns zero on success
+*/
+static int bp_layer_quant_copy(bp_layer * dest, bp_layer * source)
+{
+    bp_quant * quant;
 
-    /* error on the output units */
-    net->BPerror = fabs(net->BPerrorTotal / net->NoOfOutputs);
+    dest->quant = 0;
+    if (source->quant == 0) return 0;
 
-    /* update the running average */
-    if (net->BPerrorAverage == DEEPLEARN_UNKNOWN_ERROR) {
-        net->BPerrorAverage = net->BPerror;
-        net->BPerrorPercent = errorPercent;
+    quant = (bp_quant*)malloc(sizeof(bp_quant));
+    if (!quant) {
+        return -1;
     }
-    else {
-        net->BPerrorAverage =
-            (net->BPerrorAverage*0.999f) +
-            (net->BPerror*0.001f);
-        net->BPerrorPercent =
-            (net->BPerrorPercent*0.999f) +
-            (errorPercent*0.001f);
+    *quant = *source->quant;
+    quant->weights =
+        (int8_t*)malloc(dest->NoOfUnits*dest->NoOfInputs*sizeof(int8_t));
+    quant->scale = (float*)malloc(dest->NoOfUnits*sizeof(float));
+    quant->row_sum = (int32_t*)malloc(dest->NoOfUnits*sizeof(int32_t));
+    dest->quant = quant;
+    if ((!quant->weights) || (!quant->scale) || (!quant->row_sum)) {
+        bp_layer_quant_free(dest);
+        return -2;
     }
+    memcpy((void*)quant->weights, (void*)source->quant->weights,
+           dest->NoOfUnits*dest->NoOfInputs*sizeof(int8_t));
+    memcpy((void*)quant->scale, (void*)source->quant->scale,
+           dest->NoOfUnits*sizeof(float));
+    memcpy((void*)quant->row_sum, (void*)source->quant->row_sum,
+           dest->NoOfUnits*sizeof(int32_t));
+    return 0;
+}
 
-    /* back-propogate through the hidden layers */
-    for (l = net->HiddenLayers-1; l >= start_hidden_layer; l--) {
-        /* for every unit in the hidden layer */
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++, neuron_count++) {
-            /* get the neuron object */
-            n = net->hiddens[l][i];
-            /* backpropogate the error */
-            bp_neuron_backprop(n);
-            /* update the total error which is used to assess
-                network performance */
-            net->BPerrorTotal += n->BPerror;
-        }
+/**
+* @brief Allocates the second moments of a layer, which are used by
+*        optimisers such as RMSProp and Adam
+* @param layer The layer
+* @returns zero on success
+*/
+static int bp_layer_moments_alloc(bp_layer * layer)
+{
+    if (layer->moment2 != 0) return 0;
+
+    layer->moment2 = (float*)calloc(layer->NoOfUnits*layer->NoOfInputs,
+                                    sizeof(float));
+    layer->bias_moment2 = (float*)calloc(layer->NoOfUnits, sizeof(float));
+    if ((!layer->moment2) || (!layer->bias_moment2)) {
+        free(layer->moment2);
+        free(layer->bias_moment2);
+        layer->moment2 = 0;
+        layer->bias_moment2 = 0;
+        return -1;
     }
+    return 0;
+}
 
-    /* overall average error */
-    net->BPerrorTotal =
-        fabs(net->BPerrorTotal / neuron_count);
+/**
+* @brief Copies the second moments of a layer
+* @param dest Layer to copy into
+* @param source Layer to copy from
+* @returns zero on success
+*/
+static int bp_layer_moments_copy(bp_layer * dest, bp_layer * source)
+{
+    dest->moment2 = 0;
+    dest->bias_moment2 = 0;
+    if (source->moment2 == 0) return 0;
 
-    /* increment the number of training itterations */
-    if (net->itterations < UINT_MAX) {
-        net->itterations++;
+    if (bp_layer_moments_alloc(dest) != 0) {
+        return -1;
     }
+    memcpy((void*)dest->moment2, (void*)source->moment2,
+           dest->NoOfUnits*dest->NoOfInputs*sizeof(float));
+    memcpy((void*)dest->bias_moment2, (void*)source->bias_moment2,
+           dest->NoOfUnits*sizeof(float));
+    return 0;
 }
 
 /**
- * @brief Reprojects the input layer from a given hidden layer neuron
- *        This is like feedforward in reverse, and allows you
- *        to visualise what a hidden layer neuron is representing
- * @param layer The hidden layer within which the neuron resides
- * @param neuron_index The hidden layer index of the neuron to be reprojected
- */
-void bp_reproject(bp * net, int layer, int neuron_index)
+* @brief Makes an independent copy of a network.  The arena of the
+*        source is copied as a single block and the pointers within
+*        it are then moved across to the copy, so that no units need
+*        to be created or connected again.
+* @param dest Backprop neural net object to be created
+* @param source Backprop neural net object to be copied
+* @returns zero on success
+*/
+int bp_clone(bp * dest, bp * source)
 {
-    int i, l;
-    bp_neuron * n;
+    int i, j, l;
 
-    /* clear all previous backprop errors */
-    for (i = 0; i < net->NoOfInputs; i++) {
-        /* get the neuron object */
-        n = net->inputs[i];
-        /* set the reprojection value to zero */
-        n->value_reprojected = 0;
+    *dest = *source;
+    if (deeplearn_arena_clone(&dest->arena, &source->arena) != 0) {
+        return -1;
     }
+    dest->generation = device_weights_changed();
 
-    /* for every hidden layer */
-    for (l = 0; l < layer; l++) {
-        /* For each unit within the layer */
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-            /* get the neuron object */
-            n = net->hiddens[l][i];
-            /* set the reprojection value to zero */
-            n->value_reprojected = 0;
+    dest->inputs = (bp_neuron**)bp_relocate(dest, source, source->inputs);
+    dest->hiddens = (bp_neuron***)bp_relocate(dest, source, source->hiddens);
+    dest->outputs = (bp_neuron**)bp_relocate(dest, source, source->outputs);
+    dest->layer = (bp_layer*)bp_relocate(dest, source, source->layer);
+
+    for (i = 0; i < dest->NoOfInputs; i++) {
+        dest->inputs[i] =
+            (bp_neuron*)bp_relocate(dest, source, source->inputs[i]);
+    }
+    for (l = 0; l < dest->HiddenLayers; l++) {
+        dest->hiddens[l] =
+            (bp_neuron**)bp_relocate(dest, source, source->hiddens[l]);
+        for (i = 0; i < bp_hiddens_in_layer(dest,l); i++) {
+            dest->hiddens[l][i] =
+                (bp_neuron*)bp_relocate(dest, source, source->hiddens[l][i]);
+        }
+    }
+    for (i = 0; i < dest->NoOfOutputs; i++) {
+        dest->outputs[i] =
+            (bp_neuron*)bp_relocate(dest, source, source->outputs[i]);
+    }
+
+    for (l = 0; l < dest->HiddenLayers+2; l++) {
+        bp_layer * layer = &dest->layer[l];
+
+        layer->units = (bp_neuron*)bp_relocate(dest, source, layer->units);
+        layer->weights = (float*)bp_relocate(dest, source, layer->weights);
+        layer->lastWeightChange =
+            (float*)bp_relocate(dest, source, layer->lastWeightChange);
+        layer->values = (float*)bp_relocate(dest, source, layer->values);
+        layer->BPerror = (float*)bp_relocate(dest, source, layer->BPerror);
+        layer->dropout_mask =
+            (float*)bp_relocate(dest, source, layer->dropout_mask);
+        layer->active = (int*)bp_relocate(dest, source, layer->active);
+
+        for (i = 0; i < layer->NoOfUnits; i++) {
+            bp_neuron * n = &layer->units[i];
+
+            n->weights = (float*)bp_relocate(dest, source, n->weights);
+            n->lastWeightChange =
+                (float*)bp_relocate(dest, source, n->lastWeightChange);
+            n->inputs = (bp_neuron**)bp_relocate(dest, source, n->inputs);
+            for (j = 0; j < n->NoOfInputs; j++) {
+                n->inputs[j] =
+                    (bp_neuron*)bp_relocate(dest, source, n->inputs[j]);
+            }
+        }
+
+        /* batch arrays are allocated again when first needed */
+        layer->batch_capacity = 0;
+        layer->batch_values = 0;
+        layer->batch_BPerror = 0;
+        layer->weight_gradient = 0;
+        layer->bias_gradient = 0;
+        layer->moment2 = 0;
+        layer->bias_moment2 = 0;
+        layer->sparse = 0;
+        layer->quant = 0;
+        layer->neutral = 0;
+    }
+
+    for (l = 0; l < dest->HiddenLayers+2; l++) {
+        if ((bp_layer_sparse_copy(&dest->layer[l], &source->layer[l]) != 0) ||
+            (bp_layer_quant_copy(&dest->layer[l], &source->layer[l]) != 0) ||
+            (bp_layer_moments_copy(&dest->layer[l], &source->layer[l]) != 0)) {
+            bp_free(dest);
+            return -2;
+        }
+    }
+
+    /* neutral input biases are folded again from the copied weights */
+    if (source->layer[1].neutral != 0) {
+        if (bp_set_neutral_inputs(dest, 1) != 0) {
+            bp_free(dest);
+            return -3;
+        }
+    }
+    return 0;
+}
+
+/**
+* @brief Records that the weights or biases of a network have changed,
+*        so that any copies of them held on a device, or calculated from
+*        them, are brought up to date before they are next used
+* @param net Backprop neural net object
+*/
+void bp_weights_changed(bp * net)
+{
+#pragma omp atomic write
+    net->generation = device_weights_changed();
+}
+
+/**
+* @brief Copies the weights, biases and training parameters of one
+*        network into another of the same shape, such as a clone of it.
+*        Pruned layers must have the same connections in both networks.
+* @param dest Backprop neural net object to be updated
+* @param source Backprop neural net object to be copied
+* @returns zero on success
+*/
+int bp_copy_weights(bp * dest, bp * source)
+{
+    int i, l;
+
+    if ((dest->HiddenLayers != source->HiddenLayers) ||
+        (dest->NoOfInputs != source->NoOfInputs) ||
+        (dest->NoOfOutputs != source->NoOfOutputs)) {
+        return -1;
+    }
+
+    bp_weights_changed(dest);
+    for (l = 1; l < dest->HiddenLayers+2; l++) {
+        bp_layer * to = &dest->layer[l];
+        bp_layer * from = &source->layer[l];
+
+        if ((to->NoOfUnits != from->NoOfUnits) ||
+            (to->NoOfInputs != from->NoOfInputs) ||
+            ((to->sparse == 0) != (from->sparse == 0))) {
+            return -2;
+        }
+        memcpy(to->weights, from->weights,
+               to->NoOfUnits*to->NoOfInputs*sizeof(float));
+        for (i = 0; i < to->NoOfUnits; i++) {
+            to->units[i].bias = from->units[i].bias;
+        }
+        to->frozen = from->frozen;
+        if (to->sparse != 0) {
+            if (to->sparse->nonzero != from->sparse->nonzero) {
+                return -3;
+            }
+            memcpy(to->sparse->values, from->sparse->values,
+                   to->sparse->nonzero*sizeof(float));
+        }
+    }
+
+    dest->learningRate = source->learningRate;
+    dest->DropoutPercent = source->DropoutPercent;
+    dest->noise = source->noise;
+    dest->activation = source->activation;
+    dest->random_seed = source->random_seed;
+    return 0;
+}
+
+/**
+* @brief Sets the activation function used by the hidden layers
+* @param net Backprop neural net object
+* @param function Activation function, such as AF_RELU
+* @return zero on success
+*/
+int bp_set_activation(bp * net, int function)
+{
+    if ((function < 0) || (function >= AF_FUNCTIONS)) {
+        return -1;
+    }
+    net->activation = function;
+    return 0;
+}
+
+/**
+* @brief Sets the rule used to update the weights, such as
+*        OPTIMISER_ADAM.  The weight changes are cleared, since their
+*        meaning depends upon the rule.
+* @param net Backprop neural net object
+* @param type Update rule
+* @return zero on success
+*/
+int bp_set_optimiser(bp * net, int type)
+{
+    int i, l;
+
+    if (optimiser_set(&net->optimiser, type) != 0) {
+        return -1;
+    }
+
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        bp_layer * layer = &net->layer[l];
+
+        memset(layer->lastWeightChange, '\0',
+               layer->NoOfUnits*layer->NoOfInputs*sizeof(float));
+        for (i = 0; i < layer->NoOfUnits; i++) {
+            layer->units[i].lastBiasChange = 0;
+        }
+
+        free(layer->moment2);
+        free(layer->bias_moment2);
+        layer->moment2 = 0;
+        layer->bias_moment2 = 0;
+        if (optimiser_second_moment(&net->optimiser)) {
+            if (bp_layer_moments_alloc(layer) != 0) {
+                return -2;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+* @brief Freezes or unfreezes a hidden layer.  Training leaves the
+*        weights of a frozen layer, and of every layer beneath it,
+*        unchanged, so that only the layers above are fine tuned.
+* @param net Backprop neural net object
+* @param layer Index of the hidden layer, where zero is the first
+* @param frozen Non-zero if the layer is to be frozen
+* @return zero on success
+*/
+int bp_freeze_layer(bp * net, int layer, int frozen)
+{
+    if ((layer < 0) || (layer >= net->HiddenLayers)) {
+        return -1;
+    }
+    net->layer[layer+1].frozen = (frozen != 0);
+    return 0;
+}
+
+/**
+* @brief Returns the number of hidden layers, counting from the input
+*        layer, which are not trained.  This is one more than the index
+*        of the highest frozen hidden layer.
+* @param net Backprop neural net object
+* @return The number of untrained hidden layers
+*/
+int bp_frozen_layers(bp * net)
+{
+    int l;
+
+    for (l = net->HiddenLayers; l > 0; l--) {
+        if (net->layer[l].frozen != 0) {
+            return l;
+        }
+    }
+    return 0;
+}
+
+/**
+* @brief Folds the contribution of neutral inputs into the biases of
+*        a layer for the current weights
+* @param layer The layer
+* @param generation Generation of the weights
+*/
+static void bp_layer_neutral_update(bp_layer * layer,
+                                    unsigned int generation)
+{
+    bp_neutral * neutral = layer->neutral;
+    int i;
+
+#pragma omp parallel for num_threads(threads_count()) schedule(static) if (layer->NoOfUnits*layer->NoOfInputs >= BP_PARALLEL_MIN_WEIGHTS)
+    for (i = 0; i < layer->NoOfUnits; i++) {
+        const float * w = &layer->weights[i*layer->NoOfInputs];
+        float sum = 0;
+        int j;
+
+        for (j = 0; j < layer->NoOfInputs; j++) {
+            sum += w[j];
+        }
+        neutral->bias[i] = layer->units[i].bias + (ENC_NEUTRAL*sum);
+    }
+    neutral->generation = generation;
+    neutral->seen = generation;
+}
+
+/**
+* @brief Enables or disables the folding of neutral inputs, such as
+*        the padding of text fields, into the biases of the first layer.
+*        When most inputs are neutral the first layer then only
+*        accumulates the weights of the inputs which are not.  The
+*        folded biases are calculated again after the weights change,
+*        by bp_infer or once training has stopped.
+* @param net Backprop neural net object
+* @param enabled Non-zero to fold neutral inputs into the biases
+* @return zero on success
+*/
+int bp_set_neutral_inputs(bp * net, unsigned char enabled)
+{
+    bp_layer * layer = &net->layer[1];
+    bp_neutral * neutral;
+
+    bp_layer_neutral_free(layer);
+    if (enabled == 0) return 0;
+
+    neutral = (bp_neutral*)malloc(sizeof(bp_neutral));
+    if (!neutral) {
+        return -1;
+    }
+    neutral->bias = (float*)malloc(layer->NoOfUnits*sizeof(float));
+    neutral->changed = (int*)malloc(layer->NoOfInputs*sizeof(int));
+    neutral->delta = (float*)malloc(layer->NoOfInputs*sizeof(float));
+    layer->neutral = neutral;
+    if ((!neutral->bias) || (!neutral->changed) || (!neutral->delta)) {
+        bp_layer_neutral_free(layer);
+        return -2;
+    }
+    bp_layer_neutral_update(layer, net->generation);
+    return 0;
+}
+
+/**
+* @brief Lists the inputs which differ from neutral, together with
+*        their differences, stopping once there are too many of them
+* @param in Input values
+* @param no_of_inputs The number of inputs
+* @param changed Returned indexes of the inputs which are not neutral
+* @param delta Returned differences of those inputs from neutral
+* @param max_changed The maximum number of inputs to be listed
+* @return The number of inputs listed, or -1 if there were too many
+*/
+static int bp_neutral_changed(const float * in, int no_of_inputs,
+                              int * changed, float * delta,
+                              int max_changed)
+{
+    int i, no_of_changed = 0;
+
+    for (i = 0; i < no_of_inputs; i++) {
+        if (in[i] == ENC_NEUTRAL) continue;
+        if (no_of_changed == max_changed) return -1;
+        changed[no_of_changed] = i;
+        delta[no_of_changed] = in[i] - ENC_NEUTRAL;
+        no_of_changed++;
+    }
+    return no_of_changed;
+}
+
+/**
+* @brief Returns the maximum number of inputs to a layer which may
+*        differ from neutral for the folded biases to be used
+* @param layer The layer
+* @return The maximum number of changed inputs
+*/
+static int bp_neutral_max_changed(bp_layer * layer)
+{
+    return (int)(layer->NoOfInputs*BP_NEUTRAL_MAX_CHANGED);
+}
+
+/**
+* @brief Returns whether the folded biases of a layer are up to date,
+*        and folds them again if necessary.  While training, the weights
+*        change at every step, so the biases are only folded again once
+*        the weights have stayed the same since the previous feed forward.
+* @param layer The layer
+* @param generation Generation of the weights of the network
+* @return Non-zero if the folded biases can be used
+*/
+static int bp_layer_neutral_ready(bp_layer * layer, unsigned int generation)
+{
+    bp_neutral * neutral = layer->neutral;
+
+    if (neutral == 0) return 0;
+
+    if (neutral->generation == generation) return 1;
+    if (neutral->seen != generation) {
+        neutral->seen = generation;
+        return 0;
+    }
+    bp_layer_neutral_update(layer, generation);
+    return 1;
+}
+
+/**
+* @brief Returns the first hidden layer whose weights are trained
+* @param net Backprop neural net object
+* @param current_hidden_layer The hidden layer currently being trained
+* @return Index of the first trained hidden layer, which may be
+*         HiddenLayers if only the output layer is trained
+*/
+static int bp_start_layer(bp * net, int current_hidden_layer)
+{
+    int start_hidden_layer = current_hidden_layer-1;
+    int frozen = bp_frozen_layers(net);
+
+    if (start_hidden_layer < frozen) {
+        start_hidden_layer = frozen;
+    }
+    if (start_hidden_layer < 0) {
+        start_hidden_layer = 0;
+    }
+    return start_hidden_layer;
+}
+
+/**
+* @brief Returns the layer beneath which errors are not back-propogated.
+*        When layers are frozen there is no need for errors within them,
+*        so back-propogation stops at the first trained hidden layer.
+* @param net Backprop neural net object
+* @param start_hidden_layer The first trained hidden layer
+* @return Index of the lowest layer which receives errors, where zero
+*         is the input layer
+*/
+static int bp_backprop_limit(bp * net, int start_hidden_layer)
+{
+    if (bp_frozen_layers(net) > 0) {
+        return start_hidden_layer+1;
+    }
+    return start_hidden_layer;
+}
+
+/**
+* @brief Returns the activation function used by a layer
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+* @return Activation function
+*/
+static int bp_layer_af(bp * net, int index)
+{
+    if (index == net->HiddenLayers+1) {
+        return AF_LOGISTIC;
+    }
+    return net->activation;
+}
+
+/**
+* @brief Copies the values of the units within a layer into the
+*        layer's contiguous value vector.  This is needed for the
+*        input layer, whose units may be set directly.
+* @param layer The layer to be updated
+*/
+static void bp_layer_gather_values(bp_layer * layer)
+{
+    int i;
+
+    for (i = 0; i < layer->NoOfUnits; i++) {
+        layer->values[i] = layer->units[i].value;
+    }
+}
+
+/**
+* @brief Weighted sum of the inputs to a unit, which only visits the
+*        live connections if the layer has been pruned
+* @param layer The layer containing the unit
+* @param index Index of the unit within the layer
+* @param in Values feeding into the layer
+* @returns The weighted sum, excluding the bias
+*/
+static float bp_layer_dot(bp_layer * layer, int index, const float * in)
+{
+    bp_sparse * sparse = layer->sparse;
+    int start;
+
+    if (sparse == 0) {
+        return kernel_dot(&layer->weights[index*layer->NoOfInputs],
+                          in, layer->NoOfInputs);
+    }
+    start = sparse->row_start[index];
+    return kernel_sparse_dot(&sparse->values[start], &sparse->column[start],
+                             in, sparse->row_start[index+1] - start);
+}
+
+/**
+* @brief Returns the range of elements which the current thread
+*        is responsible for when an array is split between threads
+* @param length Length of the array
+* @param start Returned index of the first element
+* @param end Returned index after the last element
+*/
+static void bp_thread_range(int length, int * start, int * end)
+{
+#ifdef _OPENMP
+    int threads = omp_get_num_threads();
+    int chunk = (length + threads - 1) / threads;
+
+    *start = omp_get_thread_num() * chunk;
+    *end = *start + chunk;
+    if (*start > length) *start = length;
+    if (*end > length) *end = length;
+#else
+    *start = 0;
+    *end = length;
+#endif
+}
+
+/**
+* @brief Feeds forward the values of the previous layer into
+*        the given layer
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+*/
+static void bp_layer_feed_forward(bp * net, int index)
+{
+    int i, no_of_changed = -1;
+    bp_layer * curr = &net->layer[index];
+    float * in = net->layer[index-1].values;
+    bp_neutral * neutral = curr->neutral;
+
+    /* when most inputs are neutral only the others are accumulated */
+    if (bp_layer_neutral_ready(curr, net->generation)) {
+        no_of_changed =
+            bp_neutral_changed(in, curr->NoOfInputs, neutral->changed,
+                               neutral->delta, bp_neutral_max_changed(curr));
+    }
+
+#pragma omp parallel num_threads(threads_count()) if (curr->NoOfActive*curr->NoOfInputs >= BP_PARALLEL_MIN_WEIGHTS)
+    {
+        int j, i;
+        float adder;
+        bp_neuron * n;
+
+        /* only the active units are evaluated.  Dropped out units
+           are set to zero by the mask after activation */
+#pragma omp for schedule(static)
+        for (j = 0; j < curr->NoOfActive; j++) {
+            i = curr->active[j];
+            n = &curr->units[i];
+
+            /* weighted sum of the previous layer plus the bias */
+            if (no_of_changed >= 0) {
+                adder = neutral->bias[i] +
+                    kernel_sparse_dot(neutral->delta, neutral->changed,
+                                      &curr->weights[i*curr->NoOfInputs],
+                                      no_of_changed);
+            }
+            else {
+                adder = n->bias + bp_layer_dot(curr, i, in);
+            }
+
+            /* add some random noise.  The noise depends only upon
+               the unit, so is the same for any number of threads */
+            if (net->noise > 0) {
+                adder = ((1.0f - net->noise) * adder) +
+                    (net->noise *
+                     rand_uniform(net->random_seed, (unsigned int)i));
+            }
+            curr->values[i] = adder;
+        }
+    }
+
+    /* activation function over the whole layer */
+    kernel_af_vector(bp_layer_af(net, index), curr->values, curr->NoOfUnits);
+    if (curr->NoOfActive < curr->NoOfUnits) {
+        for (i = 0; i < curr->NoOfUnits; i++) {
+            curr->values[i] *= curr->dropout_mask[i];
+        }
+    }
+    for (i = 0; i < curr->NoOfUnits; i++) {
+        curr->units[i].value = curr->values[i];
+    }
+
+    /* move the shared stream on so that the next layer gets
+       different noise */
+    if (net->noise > 0) {
+        rand_num(&net->random_seed);
+    }
+}
+
+/**
+* @brief Back-propogates the errors of the given layer into
+*        the previous layer.  Each thread accumulates errors into its
+*        own section of the previous layer, so there are no conflicting
+*        writes and the summation order doesn't depend on the number
+*        of threads.
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+*/
+static void bp_layer_backprop(bp * net, int index)
+{
+    int i, j, a;
+    bp_layer * curr = &net->layer[index];
+    bp_layer * prev = &net->layer[index-1];
+    bp_neuron * n;
+    int af = bp_layer_af(net, index);
+
+    /* errors accumulate on top of any existing errors
+       within the previous layer */
+    for (j = 0; j < prev->NoOfUnits; j++) {
+        prev->BPerror[j] = prev->units[j].BPerror;
+    }
+
+    /* errors on the active units */
+    for (a = 0; a < curr->NoOfActive; a++) {
+        i = curr->active[a];
+        n = &curr->units[i];
+
+        if (n->desiredValue > -1) {
+            /* output unit */
+            n->BPerror = n->desiredValue - n->value;
+        }
+        curr->BPerror[i] = n->BPerror;
+    }
+
+    if (curr->sparse != 0) {
+        /* only the live connections carry errors back */
+        bp_sparse * sparse = curr->sparse;
+
+        for (a = 0; a < curr->NoOfActive; a++) {
+            int k = curr->active[a];
+            int start = sparse->row_start[k];
+            float delta = curr->BPerror[k] *
+                kernel_af_derivative(af, curr->units[k].value);
+            kernel_sparse_axpy(prev->BPerror, delta,
+                               &sparse->values[start],
+                               &sparse->column[start],
+                               sparse->row_start[k+1] - start);
+        }
+    }
+    else {
+#pragma omp parallel num_threads(threads_count()) if (curr->NoOfActive*curr->NoOfInputs >= BP_PARALLEL_MIN_WEIGHTS)
+        {
+            int a, k, start, end;
+            float delta;
+
+            bp_thread_range(prev->NoOfUnits, &start, &end);
+
+            if (end > start) {
+                for (a = 0; a < curr->NoOfActive; a++) {
+                    k = curr->active[a];
+                    delta = curr->BPerror[k] *
+                        kernel_af_derivative(af, curr->units[k].value);
+                    kernel_axpy(&prev->BPerror[start], delta,
+                                &curr->weights[k*curr->NoOfInputs + start],
+                                end - start);
+                }
+            }
+        }
+    }
+
+    for (j = 0; j < prev->NoOfUnits; j++) {
+        prev->units[j].BPerror = prev->BPerror[j];
+    }
+}
+
+/**
+* @brief Adjusts the weights and bias of a unit using the optimiser of
+*        the network.  The gradient of weight j is gradient*x[j].
+* @param net Backprop neural net object
+* @param curr The layer containing the unit
+* @param i Index of the unit within the layer
+* @param x Inputs to the unit, or summed gradients of a batch
+* @param e Learning rate
+* @param gradient Gradient which the inputs are multiplied by
+* @param bias_gradient Gradient of the bias
+* @param min_weight Returned minimum weight
+* @param max_weight Returned maximum weight
+*/
+static void bp_unit_learn(bp * net, bp_layer * curr, int i,
+                          const float * x, float e,
+                          float gradient, float bias_gradient,
+                          float * min_weight, float * max_weight)
+{
+    bp_neuron * n = &curr->units[i];
+    float * w = &curr->weights[i*curr->NoOfInputs];
+    float * dw = &curr->lastWeightChange[i*curr->NoOfInputs];
+    float * moment2 = 0, * bias_moment2 = 0;
+
+    if (curr->moment2 != 0) {
+        moment2 = &curr->moment2[i*curr->NoOfInputs];
+        bias_moment2 = &curr->bias_moment2[i];
+    }
+
+    n->bias += optimiser_bias(&net->optimiser, &n->lastBiasChange,
+                              bias_moment2, e, bias_gradient);
+
+    if (curr->sparse != 0) {
+        bp_sparse * sparse = curr->sparse;
+        int start = sparse->row_start[i];
+        optimiser_sparse_update(&net->optimiser,
+                                &sparse->values[start],
+                                &sparse->column[start],
+                                w, dw, moment2, x, e, gradient,
+                                sparse->row_start[i+1] - start,
+                                min_weight, max_weight);
+    }
+    else {
+        optimiser_update(&net->optimiser, w, dw, moment2, x, e, gradient,
+                         curr->NoOfInputs, min_weight, max_weight);
+    }
+}
+
+/**
+* @brief Adjusts the weights and biases of the units within a layer
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+*/
+static void bp_layer_learn(bp * net, int index)
+{
+    int a;
+    bp_layer * curr = &net->layer[index];
+    float * in = net->layer[index-1].values;
+    float e = net->learningRate / (1.0f + curr->NoOfInputs);
+    int af = bp_layer_af(net, index);
+
+#pragma omp parallel for num_threads(threads_count()) schedule(static) if (curr->NoOfActive*curr->NoOfInputs >= BP_PARALLEL_MIN_WEIGHTS)
+    for (a = 0; a < curr->NoOfActive; a++) {
+        int i = curr->active[a];
+        bp_neuron * n = &curr->units[i];
+        float gradient;
+
+        gradient = kernel_af_derivative(af, n->value) * n->BPerror;
+        n->min_weight = 9999;
+        n->max_weight = -9999;
+        bp_unit_learn(net, curr, i, in, e, gradient, gradient,
+                      &n->min_weight, &n->max_weight);
+    }
+}
+
+/**
+* @brief Updates the running averages of the output error
+* @param net Backprop neural net object
+* @param errorPercent Output error as a percentage
+*/
+static void bp_update_error_average(bp * net, float errorPercent)
+{
+    if (net->BPerrorAverage == DEEPLEARN_UNKNOWN_ERROR) {
+        net->BPerrorAverage = net->BPerror;
+        net->BPerrorPercent = errorPercent;
+    }
+    else {
+        net->BPerrorAverage =
+            (net->BPerrorAverage*0.999f) +
+            (net->BPerror*0.001f);
+        net->BPerrorPercent =
+            (net->BPerrorPercent*0.999f) +
+            (errorPercent*0.001f);
+    }
+}
+
+/**
+* @brief Propagates the current inputs through the layers of the network
+* @param net Backprop neural net object
+*/
+void bp_feed_forward(bp * net)
+{
+    int l;
+    DEEPLEARN_STATS_START(start_time);
+
+    bp_layer_gather_values(&net->layer[0]);
+
+    /* for each hidden layer and then the output layer */
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        bp_layer_feed_forward(net, l);
+    }
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_FEED_FORWARD, 0);
+}
+
+/**
+* @brief Propagates the values of the previous layer into a single
+*        layer, so that a network can be evaluated one layer at a time
+*        after bp_feed_forward_layers
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+*/
+void bp_feed_forward_layer(bp * net, int index)
+{
+    if ((index < 1) || (index > net->HiddenLayers+1)) return;
+    bp_layer_feed_forward(net, index);
+}
+
+/**
+* @brief Propagates the current inputs through a given number of
+*        layers of the network
+* @param net Backprop neural net object
+* @param layers The number of layers to propagate through
+*/
+void bp_feed_forward_layers(bp * net, int layers)
+{
+    int l;
+
+    bp_layer_gather_values(&net->layer[0]);
+
+    for (l = 0; l < layers; l++) {
+        /* if this layer is a hidden layer */
+        if (l < net->HiddenLayers) {
+            bp_layer_feed_forward(net, l+1);
+        }
+        else {
+            /* the output layer */
+            bp_layer_feed_forward(net, net->HiddenLayers+1);
+        }
+    }
+}
+
+/**
+* @brief back-propogate errors from the output layer towards the input layer
+* @param net Backprop neural net object
+*/
+void bp_backprop(bp * net, int current_hidden_layer)
+{
+    int i, l, neuron_count=0;
+    bp_neuron * n;
+    int start_hidden_layer = bp_start_layer(net, current_hidden_layer);
+    float errorPercent=0;
+    DEEPLEARN_STATS_START(start_time);
+
+    /* clear all previous backprop errors */
+    for (i = 0; i < net->NoOfInputs; i++) {
+        /* get the neuron object */
+        n = net->inputs[i];
+        /* set the backprop error to zero */
+        n->BPerror = 0;
+    }
+
+    /* for every hidden layer */
+    for (l = start_hidden_layer; l < net->HiddenLayers; l++) {
+        /* For each unit within the layer */
+        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
+            /* get the neuron object */
+            n = net->hiddens[l][i];
+            /* set the backprop error to zero */
+            n->BPerror = 0;
+        }
+    }
+
+    /* now back-propogate the error from the output units */
+    bp_layer_backprop(net, net->HiddenLayers+1);
+
+    net->BPerrorTotal = 0;
+    /* for every output unit */
+    for (i = 0; i < net->NoOfOutputs; i++, neuron_count++) {
+        /* get the neuron object */
+        n = net->outputs[i];
+        /* update the total error which is used to assess
+            network performance */
+        net->BPerrorTotal += n->BPerror;
+        errorPercent += fabs(n->BPerror);
+    }
+
+    /* error percentage assuming an encoding range
+       of 0.25 -> 0.75 */
+    errorPercent = errorPercent * 100 / (0.5f*net->NoOfOutputs);
+
+    /* error on the output units */
+    net->BPerror = fabs(net->BPerrorTotal / net->NoOfOutputs);
+
+    /* update the running average */
+    bp_update_error_average(net, errorPercent);
+
+    /* back-propogate through the hidden layers, stopping at any
+       frozen layers */
+    for (l = net->HiddenLayers-1;
+         l >= bp_backprop_limit(net, start_hidden_layer); l--) {
+        bp_layer_backprop(net, l+1);
+
+        /* for every unit in the hidden layer */
+        for (i = 0; i < bp_hiddens_in_layer(net,l); i++, neuron_count++) {
+            /* update the total error which is used to assess
+                network performance */
+            net->BPerrorTotal += net->hiddens[l][i]->BPerror;
+        }
+    }
+
+    /* overall average error */
+    net->BPerrorTotal =
+        fabs(net->BPerrorTotal / neuron_count);
+
+    /* increment the number of training itterations */
+    if (net->itterations < UINT_MAX) {
+        net->itterations++;
+    }
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_BACKPROP, 0);
+}
+
+/**
+ * @brief Reprojects the input layer from a given hidden layer neuron
+ *        This is like feedforward in reverse, and allows you
+ *        to visualise what a hidden layer neuron is representing
+ * @param layer The hidden layer within which the neuron resides
+ * @param neuron_index The hidden layer index of the neuron to be reprojected
+ */
+void bp_reproject(bp * net, int layer, int neuron_index)
+{
+    int i, l;
+    bp_neuron * n;
+
+    /* clear all previous backprop errors */
+    for (i = 0; i < net->NoOfInputs; i++) {
+        /* get the neuron object */
+        n = net->inputs[i];
+        /* set the reprojection value to zero */
+        n->value_reprojected = 0;
+    }
+
+    /* for every hidden layer */
+    for (l = 0; l < layer; l++) {
+        /* For each unit within the layer */
+        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
+            /* get the neuron object */
+            n = net->hiddens[l][i];
+            /* set the reprojection value to zero */
+            n->value_reprojected = 0;
+        }
+    }
+
+    /* set the neuron active */
+    n = net->hiddens[layer][neuron_index];
+    n->value_reprojected = 0.75f;
+
+    bp_neuron_reproject(n);
+    if (layer > 0) {
+        /* apply the sigmoid function in the previous layer,
+           as with feedforward */
+        for (i = 0; i < bp_hiddens_in_layer(net,layer-1); i++) {
+            n->value_reprojected =
+                1.0f / (1.0f + exp(-(n->value_reprojected)));
+        }
+    }
+
+    /* reproject through the hidden layers */
+    for (l = layer-1; l > 0; l--) {
+        /* for every unit in the hidden layer */
+        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
+            /* get the neuron object */
+            n = net->hiddens[l][i];
+            /* backpropogate the error */
+            bp_neuron_reproject(n);
+        }
+        /* apply the sigmoid function in the previous layer,
+           as with feedforward */
+        for (i = 0; i < bp_hiddens_in_layer(net,l-1); i++) {
+            n->value_reprojected =
+                1.0f / (1.0f + exp(-(n->value_reprojected)));
+        }
+    }
+}
+
+/**
+* @brief Adjust connection weights and bias values
+* @param net Backprop neural net object
+*/
+void bp_learn(bp * net, int current_hidden_layer)
+{
+    int l;
+    int start_hidden_layer = bp_start_layer(net, current_hidden_layer);
+    DEEPLEARN_STATS_START(start_time);
+
+    /* the inputs may have been set since the last feed forward */
+    bp_layer_gather_values(&net->layer[0]);
+
+    /* for each hidden layer above any which are frozen */
+    optimiser_next_step(&net->optimiser);
+    bp_weights_changed(net);
+    for (l = start_hidden_layer; l < net->HiddenLayers; l++) {
+        bp_layer_learn(net, l+1);
+    }
+
+    /* the output layer */
+    bp_layer_learn(net, net->HiddenLayers+1);
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_LEARN, 0);
+}
+
+/**
+* @brief Set the value of an input
+* @param net Backprop neural net object
+* @param index The index number of the input unit
+* @param value The value to set the unit to in the range 0.0 to 1.0
+*/
+void bp_set_input(bp * net, int index, float value)
+{
+    /* get the neuron object */
+    bp_neuron * n  = net->inputs[index];
+    /* Set the value */
+    n->value = value;
+}
+
+/**
+* @brief Normalises the input values
+* @param net Backprop neural net object
+*/
+void bp_normalise_inputs(bp * net)
+{
+    float max = 0,  min = 1;
+    for (int i = 0; i < net->NoOfInputs; i++) {
+        if (net->inputs[i]->value > max) {
+            max = net->inputs[i]->value;
+        }
+        if (net->inputs[i]->value < min) {
+            min = net->inputs[i]->value;
+        }
+    }
+    float range = max - min;
+    if (range > 0.00001f) {
+        for (int i = 0; i < net->NoOfInputs; i++) {
+            net->inputs[i]->value =
+                0.25f + ((net->inputs[i]->value-min)*0.5f/range);
+        }
+    }
+}
+
+/**
+* @brief Sets the inputs to a text string
+* @param net Backprop neural net object
+* @param text The text string
+*/
+void bp_set_input_text(bp * net, char * text)
+{
+    enc_text_to_binary(text, net->inputs, net->NoOfInputs, 0, strlen(text));
+}
+
+/**
+* @brief Set the inputs of the network from a patch within an image.
+*        It is assumed that the image is mono (1 byte per pixel)
+* @param net Backprop neural net object
+* @param img Array storing the image
+* @param image_width Width of the image in pixels
+* @param image_height Height of the image in pixels
+* @param tx Top left x coordinate of the patch within the image
+* @param ty Top left y coordinate of the patch within the image
+*/
+void bp_inputs_from_image_patch(bp * net,
+                                unsigned char img[],
+                                int image_width, int image_height,
+                                int tx, int ty)
+{
+    int px,py,i=0,idx;
+
+    /* The patch size is calculated from the number of inputs
+        of the neural net.  It's assumed to be square. */
+    int patch_size = (int)sqrt(net->NoOfInputs);
+
+    /* make sure that the patch fits within the number of inputs */
+    assert(patch_size*patch_size <= net->NoOfInputs);
+
+    /* set the inputs from the patch */
+    for (py = ty; py < ty+patch_size; py++) {
+        if (py >= image_height) break;
+        for (px = tx; px < tx+patch_size; px++, i++) {
+            if (px >= image_width) break;
+            /* array index within the image */
+            idx = (py*image_width) + px;
+            /* set the input value within the range 0.25 to 0.75 */
+            bp_set_input(net, i, 0.25f + (img[idx]*0.5f/255.0f));
+        }
+    }
+}
+
+/**
+* @brief Set the inputs of the network from an image.
+*        It is assumed that the image is mono (1 byte per pixel)
+* @param net Backprop neural net object
+* @param img Array storing the image
+* @param image_width Width of the image in pixels
+* @param image_height Height of the image in pixels
+*/
+void bp_inputs_from_image(bp * net,
+                          unsigned char img[],
+                          int image_width, int image_height)
+{
+    int i=0;
+
+    /* check that the number of inputs is the same as the
+       number of pixels */
+    assert(net->NoOfInputs == image_width*image_height);
+
+    /* set the inputs */
+    for (i = 0; i < image_width*image_height; i++) {
+        /* set the input value within the range 0.25 to 0.75 */
+        bp_set_input(net, i, 0.25f + (img[i]*0.5f/255.0f));
+    }
+}
+
+/**
+* @brief Plots weight matrices within an image
+* @param net Backprop neural net object
+* @param filename Filename of the image to save as
+* @param image_width Width of the image in pixels
+* @param image_height Height of the image in pixels
+* @param input_image_width When displaying all inputs as an image this
+         is the number of inputs across.  Set this to zero for the
+         inputs image to be square.
+*/
+int bp_plot_weights(bp * net,
+                    char * filename,
+                    int image_width, int image_height,
+                    int input_image_width)
+{
+    int layer, neurons_x, neurons_y, ty, by, h, x, y, ix, iy;
+    int wx, wy, inputs_x, inputs_y, n, i, unit, no_of_neurons;
+    int no_of_weights,wdth;
+    float neuronx, neurony,dw;
+    bp_neuron ** neurons, * curr_neuron;
+    unsigned char * img;
+
+    /* allocate memory for the image */
+    img = (unsigned char*)malloc(image_width*image_height*3);
+    if (!img) {
+        return -1;
+    }
+
+    /* clear the image with a white background */
+    memset((void*)img,'\255',image_width*image_height*3);
+
+    /* dimension of the neurons matrix for each layer */
+    neurons_x = (int)sqrt(net->NoOfHiddens);
+    neurons_y = (net->NoOfHiddens/neurons_x);
+
+    /* dimensions of the weight matrix */
+    if (input_image_width <= 0) {
+        inputs_x = (int)sqrt(net->NoOfInputs);
+    }
+    else {
+        inputs_x = input_image_width;
+    }
+    inputs_y = (net->NoOfInputs/inputs_x);
+
+    no_of_weights = net->NoOfInputs;
+
+    /* plot the inputs */
+    ty = 0;
+    by = image_height/(net->HiddenLayers+3);
+    h = (by-ty)*95/100;
+    wdth = h;
+    if (wdth>=image_width) wdth=image_width;
+    for (y = 0; y < h; y++) {
+        iy = y*inputs_y/h;
+        for (x = 0; x < wdth; x++) {
+            ix = x*inputs_x/wdth;
+            unit = (iy*inputs_x) + ix;
+            if (unit < net->NoOfInputs) {
+                n = (y*image_width + x)*3;
+                img[n] = (unsigned char)(net->inputs[unit]->value*255);
+                img[n+1] = img[n];
+                img[n+2] = img[n];
+            }
+        }
+    }
+
+    for (layer = 0; layer < net->HiddenLayers+1; layer++) {
+
+        /* vertical top and bottom coordinates */
+        ty = (layer+1)*image_height/(net->HiddenLayers+3);
+        by = (layer+2)*image_height/(net->HiddenLayers+3);
+        h = (by-ty)*95/100;
+
+        /* number of patches across and down for the final layer */
+        if (layer == net->HiddenLayers) {
+            neurons_x = (int)sqrt(net->NoOfOutputs);
+            neurons_y = (net->NoOfOutputs/neurons_x);
+            neurons = net->outputs;
+            no_of_neurons = net->NoOfOutputs;
+        }
+        else {
+            neurons_x = (int)sqrt(bp_hiddens_in_layer(net,layer));
+            neurons_y = (bp_hiddens_in_layer(net,layer)/neurons_x);
+            neurons = net->hiddens[layer];
+            no_of_neurons = bp_hiddens_in_layer(net,layer);
+        }
+
+        /* for every pixel within the region */
+        for (y = ty; y < by; y++) {
+            neurony = (y-ty)*neurons_y/(float)h;
+            /* y coordinate within the weights */
+            wy = (neurony - (int)neurony)*inputs_y;
+            for (x = 0; x < image_width; x++) {
+                neuronx = x*neurons_x/(float)image_width;
+                /* x coordinate within the weights */
+                wx = (neuronx - (int)neuronx)*inputs_x;
+                /* coordinate within the image */
+                n = ((y * image_width) + x)*3;
+                /* weight index */
+                i = (wy*inputs_x) + wx;
+                if (i < no_of_weights) {
+                    /* neuron index */
+                    unit = ((int)neurony*neurons_x) + (int)neuronx;
+                    if (unit < no_of_neurons)  {
+                        curr_neuron = neurons[unit];
+                        dw = curr_neuron->max_weight -
+                            curr_neuron->min_weight;
+                        if (dw > 0.0001f) {
+                            img[n] =
+                                (int)((curr_neuron->weights[i] -
+                                       curr_neuron->min_weight)*255/dw);
+                            img[n+1] = img[n];
+                            img[n+2] = img[n];
+                        }
+                        else {
+                            img[n] =
+                                (int)(curr_neuron->weights[i]*255);
+                            img[n+1] = img[n];
+                            img[n+2] = img[n];
+                        }
+                    }
+                }
+            }
+        }
+        if (layer < net->HiddenLayers) {
+            /* dimensions of the weight matrix for the next layer */
+            inputs_x = (int)sqrt(bp_hiddens_in_layer(net,layer));
+            inputs_y = (bp_hiddens_in_layer(net,layer)/inputs_x);
+            no_of_weights = bp_hiddens_in_layer(net,layer);
+        }
+    }
+
+    ty = (net->HiddenLayers+2)*image_height/(net->HiddenLayers+3);
+    by = (net->HiddenLayers+3)*image_height/(net->HiddenLayers+3);
+    h = (by-ty)*95/100;
+
+    inputs_x = (int)sqrt(net->NoOfOutputs);
+    inputs_y = (net->NoOfOutputs/inputs_x);
+
+    wdth = h;
+    if (wdth >= image_width) wdth = image_width;
+    for (y = 0; y < h; y++) {
+        iy = y*inputs_y/h;
+        for (x = 0; x < wdth; x++) {
+            ix = x*inputs_x/wdth;
+            unit = (iy*inputs_x) + ix;
+            if (unit < net->NoOfOutputs) {
+                n = ((ty+y)*image_width + x)*3;
+                img[n] = (unsigned char)(net->outputs[unit]->value*255);
+                img[n+1] = img[n];
+                img[n+2] = img[n];
+            }
+        }
+    }
+
+    /* write the image to file */
+    deeplearn_write_png_file(filename,
+                             (unsigned int)image_width, (unsigned int)image_height,
+                             24, img);
+
+    /* free the image memory */
+    free(img);
+    return 0;
+}
+
+/**
+* @brief Returns the value of one of the input units
+* @param net Backprop neural net object
+* @param index Index of the input unit
+* @return value in the range 0.0 to 1.0
+*/
+float bp_get_input(bp * net, int index)
+{
+    return net->inputs[index]->value;
+}
+
+/**
+* @brief Sets the value of one of the output units
+* @param net Backprop neural net object
+* @param index Index of the output unit
+* @param value The value to set the output to in the range 0.0 to 1.0
+*/
+void bp_set_output(bp * net, int index, float value)
+{
+    net->outputs[index]->desiredValue = value;
+}
+
+/**
+* @brief Gets the value of one of the hidden units
+* @param net Backprop neural net object
+* @param layer Index number of the hidden layer
+* @param index Index of the unit within the given hidden layer
+* @return value in the range 0.0 to 1.0
+*/
+float bp_get_hidden(bp * net, int layer, int index)
+{
+    return net->hiddens[layer][index]->value;
+}
+
+/**
+* @brief Gets the value of one of the output units
+* @param net Backprop neural net object
+* @param index Index of the unit within the output layer
+* @return value in the range 0.0 to 1.0
+*/
+float bp_get_output(bp * net, int index)
+{
+    return net->outputs[index]->value;
+}
+
+/**
+* @brief Makes every unit of the hidden layers active again
+*        after dropouts
+* @param net Backprop neural net object
+*/
+static void bp_clear_dropouts(bp * net)
+{
+    int l, i;
+    bp_layer * curr;
+
+    for (l = 1; l <= net->HiddenLayers; l++) {
+        curr = &net->layer[l];
+
+        /* only layers with dropped units need to be reset */
+        if (curr->NoOfActive == curr->NoOfUnits) continue;
+
+        for (i = 0; i < curr->NoOfUnits; i++) {
+            curr->dropout_mask[i] = 1;
+            curr->active[i] = i;
+        }
+        curr->NoOfActive = curr->NoOfUnits;
+    }
+}
+
+/**
+* @brief Randomly selects units within each hidden layer which drop out,
+*        creating a mask and a compacted list of the active units
+* @param net Backprop neural net object
+*/
+static void bp_dropouts(bp * net)
+{
+    int l;
+    bp_layer * curr;
+
+    if (net->DropoutPercent==0) return;
+
+    for (l = 1; l <= net->HiddenLayers; l++) {
+        curr = &net->layer[l];
+        curr->NoOfActive =
+            rand_dropouts(&net->random_seed, net->DropoutPercent,
+                          curr->dropout_mask, curr->active,
+                          curr->NoOfUnits);
+    }
+}
+
+/**
+* @brief Update the neural net during training
+* @param net Backprop neural net object
+*/
+void bp_update(bp * net, int current_hidden_layer)
+{
+    bp_dropouts(net);
+    bp_feed_forward(net);
+    bp_backprop(net, current_hidden_layer);
+    bp_learn(net, current_hidden_layer);
+    bp_clear_dropouts(net);
+}
+
+/**
+* @brief Ensures that a layer has enough storage for a mini-batch
+* @param layer The layer
+* @param batch_size The number of samples in the batch
+* @returns zero on success
+*/
+static int bp_layer_batch_alloc(bp_layer * layer, int batch_size)
+{
+    float * values, * errors;
+
+    if (batch_size <= layer->batch_capacity) return 0;
+
+    DEEPLEARN_STATS_ALLOC(batch_size*layer->NoOfUnits*sizeof(float));
+    DEEPLEARN_STATS_ALLOC(batch_size*layer->NoOfUnits*sizeof(float));
+
+    values = (float*)realloc(layer->batch_values,
+                             batch_size*layer->NoOfUnits*sizeof(float));
+    if (!values) {
+        return -1;
+    }
+    layer->batch_values = values;
+
+    errors = (float*)realloc(layer->batch_BPerror,
+                             batch_size*layer->NoOfUnits*sizeof(float));
+    if (!errors) {
+        return -2;
+    }
+    layer->batch_BPerror = errors;
+
+    if (!layer->weight_gradient) {
+        layer->weight_gradient =
+            (float*)malloc(layer->NoOfUnits*layer->NoOfInputs*sizeof(float));
+        if (!layer->weight_gradient) {
+            return -3;
+        }
+        layer->bias_gradient =
+            (float*)malloc(layer->NoOfUnits*sizeof(float));
+        if (!layer->bias_gradient) {
+            return -4;
+        }
+    }
+
+    layer->batch_capacity = batch_size;
+    return 0;
+}
+
+/**
+* @brief Feeds forward a mini-batch from the previous layer into the
+*        given layer.  Each row of weights is reused for every sample
+*        in the batch before moving on to the next unit.
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+* @param batch_size The number of samples in the batch
+*/
+static void bp_layer_feed_forward_batch(bp * net, int index, int batch_size)
+{
+    int i, b;
+    bp_layer * curr = &net->layer[index];
+    bp_layer * prev = &net->layer[index-1];
+
+    if ((curr->sparse == 0) && (curr->NoOfActive == curr->NoOfUnits) &&
+        (net->noise <= 0)) {
+        /* with every unit active the weighted sums of the whole batch
+           are a matrix multiply, which may be evaluated on a device */
+        kernel_gemm_nt_weights(batch_size, curr->NoOfUnits,
+                               curr->NoOfInputs, prev->batch_values,
+                               curr->weights, net->generation,
+                               curr->batch_values);
+        for (b = 0; b < batch_size; b++) {
+            float * row = &curr->batch_values[b*curr->NoOfUnits];
+            for (i = 0; i < curr->NoOfUnits; i++) {
+                row[i] += curr->units[i].bias;
+            }
+        }
+    }
+    else {
+#pragma omp parallel num_threads(threads_count()) if (curr->NoOfActive*curr->NoOfInputs*batch_size >= BP_PARALLEL_MIN_WEIGHTS)
+        {
+            int j, i, b;
+            float * out, adder;
+            bp_neuron * n;
+
+            /* dropped out units are set to zero after activation */
+#pragma omp for schedule(static)
+            for (j = 0; j < curr->NoOfActive; j++) {
+                i = curr->active[j];
+                n = &curr->units[i];
+
+                for (b = 0; b < batch_size; b++) {
+                    out = &curr->batch_values[b*curr->NoOfUnits + i];
+                    adder = n->bias +
+                        bp_layer_dot(curr, i,
+                                     &prev->batch_values[b*prev->NoOfUnits]);
+
+                    /* add some random noise */
+                    if (net->noise > 0) {
+                        adder = ((1.0f - net->noise) * adder) +
+                            (net->noise *
+                             rand_uniform(net->random_seed,
+                                          (unsigned int)(b*curr->NoOfUnits + i)));
+                    }
+                    *out = adder;
+                }
+            }
+        }
+    }
+
+    /* activation function over the whole batch */
+    kernel_af_vector(bp_layer_af(net, index), curr->batch_values,
+                     batch_size*curr->NoOfUnits);
+    /* dropped out units were not evaluated, so their values may be
+       left over from an earlier batch or never have been written.
+       They are cleared rather than masked, since the multiplication
+       would preserve any NaN. */
+    if (curr->NoOfActive < curr->NoOfUnits) {
+        for (b = 0; b < batch_size; b++) {
+            float * row = &curr->batch_values[b*curr->NoOfUnits];
+            for (i = 0; i < curr->NoOfUnits; i++) {
+                if (curr->dropout_mask[i] == 0) {
+                    row[i] = 0;
+                }
+            }
+        }
+    }
+
+    if (net->noise > 0) {
+        rand_num(&net->random_seed);
+    }
+}
+
+/**
+* @brief Back-propogates the errors for a mini-batch from the given
+*        layer into the previous layer.  Samples are shared between
+*        threads, since each one has its own row of errors.
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+* @param batch_size The number of samples in the batch
+*/
+static void bp_layer_backprop_batch(bp * net, int index, int batch_size)
+{
+    int b;
+    bp_layer * curr = &net->layer[index];
+    bp_layer * prev = &net->layer[index-1];
+    int af = bp_layer_af(net, index);
+
+#pragma omp parallel for num_threads(threads_count()) schedule(static) if (curr->NoOfUnits*curr->NoOfInputs*batch_size >= BP_PARALLEL_MIN_WEIGHTS)
+    for (b = 0; b < batch_size; b++) {
+        int a, i, k;
+        float delta;
+
+        for (a = 0; a < curr->NoOfActive; a++) {
+            i = curr->active[a];
+            k = b*curr->NoOfUnits + i;
+            delta = curr->batch_BPerror[k] *
+                kernel_af_derivative(af, curr->batch_values[k]);
+            if (curr->sparse != 0) {
+                bp_sparse * sparse = curr->sparse;
+                int start = sparse->row_start[i];
+                kernel_sparse_axpy(&prev->batch_BPerror[b*prev->NoOfUnits],
+                                   delta, &sparse->values[start],
+                                   &sparse->column[start],
+                                   sparse->row_start[i+1] - start);
+            }
+            else {
+                kernel_axpy(&prev->batch_BPerror[b*prev->NoOfUnits],
+                            delta, &curr->weights[i*curr->NoOfInputs],
+                            curr->NoOfInputs);
+            }
+        }
+    }
+}
+
+/**
+* @brief Adds the gradients of a layer over a mini-batch to the given
+*        sums.  For a pruned layer only the live connections are summed.
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+* @param batch_size The number of samples in the batch
+* @param weight_gradient Sums of the weight gradients, one row of
+*        NoOfInputs values per unit
+* @param bias_gradient Sums of the bias gradients, one per unit
+*/
+static void bp_layer_gradients_batch(bp * net, int index, int batch_size,
+                                     float * weight_gradient,
+                                     float * bias_gradient)
+{
+    int a;
+    bp_layer * curr = &net->layer[index];
+    bp_layer * prev = &net->layer[index-1];
+    int af = bp_layer_af(net, index);
+
+#pragma omp parallel for num_threads(threads_count()) schedule(static) if (curr->NoOfActive*curr->NoOfInputs*batch_size >= BP_PARALLEL_MIN_WEIGHTS)
+    for (a = 0; a < curr->NoOfActive; a++) {
+        int b, k, c, i = curr->active[a];
+        float * g, * x, delta;
+        bp_sparse * sparse = curr->sparse;
+
+        g = &weight_gradient[i*curr->NoOfInputs];
+        for (b = 0; b < batch_size; b++) {
+            k = b*curr->NoOfUnits + i;
+            delta = curr->batch_BPerror[k] *
+                kernel_af_derivative(af, curr->batch_values[k]);
+            bias_gradient[i] += delta;
+            x = &prev->batch_values[b*prev->NoOfUnits];
+            if (sparse != 0) {
+                for (c = sparse->row_start[i];
+                     c < sparse->row_start[i+1]; c++) {
+                    g[sparse->column[c]] += delta * x[sparse->column[c]];
+                }
+            }
+            else {
+                kernel_axpy(g, delta, x, curr->NoOfInputs);
+            }
+        }
+    }
+}
+
+/**
+* @brief Applies the average of summed gradients to the weights and
+*        biases of the active units of a layer
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+* @param batch_size The number of samples which the sums are over
+* @param weight_gradient Sums of the weight gradients
+* @param bias_gradient Sums of the bias gradients
+*/
+static void bp_layer_apply_gradients(bp * net, int index, int batch_size,
+                                     float * weight_gradient,
+                                     float * bias_gradient)
+{
+    int a;
+    bp_layer * curr = &net->layer[index];
+    float e = net->learningRate / (1.0f + curr->NoOfInputs);
+
+#pragma omp parallel for num_threads(threads_count()) schedule(static) if (curr->NoOfActive*curr->NoOfInputs >= BP_PARALLEL_MIN_WEIGHTS)
+    for (a = 0; a < curr->NoOfActive; a++) {
+        int i = curr->active[a];
+        bp_neuron * n = &curr->units[i];
+
+        n->min_weight = 9999;
+        n->max_weight = -9999;
+        bp_unit_learn(net, curr, i, &weight_gradient[i*curr->NoOfInputs], e,
+                      1.0f / batch_size, bias_gradient[i] / batch_size,
+                      &n->min_weight, &n->max_weight);
+    }
+}
+
+/**
+* @brief Accumulates the gradients of a layer over a mini-batch and
+*        then applies a single update to its weights and biases
+* @param net Backprop neural net object
+* @param index Index of the layer, where zero is the input layer
+* @param batch_size The number of samples in the batch
+*/
+static void bp_layer_learn_batch(bp * net, int index, int batch_size)
+{
+    bp_layer * curr = &net->layer[index];
+
+    memset(curr->weight_gradient, '\0',
+           curr->NoOfUnits*curr->NoOfInputs*sizeof(float));
+    memset(curr->bias_gradient, '\0', curr->NoOfUnits*sizeof(float));
+
+    bp_layer_gradients_batch(net, index, batch_size,
+                             curr->weight_gradient, curr->bias_gradient);
+    bp_layer_apply_gradients(net, index, batch_size,
+                             curr->weight_gradient, curr->bias_gradient);
+}
+
+/**
+* @brief Feeds forward a mini-batch which has already been copied into
+*        the input layer, and back-propogates the errors of the outputs.
+*        Dropouts should already have been selected.
+* @param net Backprop neural net object
+* @param targets Desired output values for each sample
+* @param batch_size The number of samples in the batch
+* @param start_hidden_layer The first hidden layer being trained
+* @param error_sum Returned sum of the average output error of
+*        each sample
+* @param percent_sum Returned sum of the output error percentage of
+*        each sample
+* @param update_averages Non-zero if the running error averages and
+*        the number of itterations are updated after each sample
+*/
+static void bp_forward_backward_batch(bp * net, float * targets,
+                                      int batch_size, int start_hidden_layer,
+                                      float * error_sum, float * percent_sum,
+                                      int update_averages)
+{
+    int i, b, l;
+    int last = net->HiddenLayers+1;
+    bp_layer * outputs = &net->layer[last];
+    float error, total, errorPercent;
+
+    DEEPLEARN_STATS_START(feed_forward_time);
+    for (l = 1; l <= last; l++) {
+        bp_layer_feed_forward_batch(net, l, batch_size);
+    }
+    DEEPLEARN_STATS_STOP(feed_forward_time, DEEPLEARN_STATS_FEED_FORWARD, 0);
+
+    DEEPLEARN_STATS_START(backprop_time);
+
+    /* clear the errors on the input and hidden layers */
+    for (l = 0; l < last; l++) {
+        memset(net->layer[l].batch_BPerror, '\0',
+               batch_size*net->layer[l].NoOfUnits*sizeof(float));
+    }
+
+    /* errors on the output units */
+    *error_sum = 0;
+    *percent_sum = 0;
+    for (b = 0; b < batch_size; b++) {
+        total = 0;
+        errorPercent = 0;
+        for (i = 0; i < net->NoOfOutputs; i++) {
+            error = 0;
+            if (targets[b*net->NoOfOutputs + i] > -1) {
+                error = targets[b*net->NoOfOutputs + i] -
+                    outputs->batch_values[b*net->NoOfOutputs + i];
+            }
+            outputs->batch_BPerror[b*net->NoOfOutputs + i] = error;
+            total += error;
+            errorPercent += fabs(error);
+        }
+        errorPercent = errorPercent * 100 / (0.5f*net->NoOfOutputs);
+        *error_sum += fabs(total / net->NoOfOutputs);
+        *percent_sum += errorPercent;
+
+        if (update_averages) {
+            net->BPerrorTotal = total;
+            net->BPerror = fabs(total / net->NoOfOutputs);
+            bp_update_error_average(net, errorPercent);
+
+            /* increment the number of training itterations */
+            if (net->itterations < UINT_MAX) {
+                net->itterations++;
+            }
+        }
+    }
+
+    /* back-propogate through the hidden layers, stopping at any
+       frozen layers */
+    for (l = last; l > bp_backprop_limit(net, start_hidden_layer); l--) {
+        bp_layer_backprop_batch(net, l, batch_size);
+    }
+    DEEPLEARN_STATS_STOP(backprop_time, DEEPLEARN_STATS_BACKPROP, 0);
+}
+
+/**
+* @brief Returns the number of values within the gradients of a
+*        network, as used by bp_batch_gradients and bp_apply_gradients.
+*        The weight and then bias gradients of each layer are followed
+*        by BP_GRADIENT_STATS values which record the errors and the
+*        number of samples.
+* @param net Backprop neural net object
+* @returns The number of gradient values
+*/
+int bp_gradients_length(bp * net)
+{
+    int l, length = BP_GRADIENT_STATS;
+
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        length += net->layer[l].NoOfUnits*(net->layer[l].NoOfInputs + 1);
+    }
+    return length;
+}
+
+/**
+* @brief Adds the gradients of a mini-batch to the given sums without
+*        changing the weights or random seed of the network.  Sums from
+*        several networks of the same shape, such as replicas training
+*        on different parts of a batch, may be added together and then
+*        applied with bp_apply_gradients.
+* @param net Backprop neural net object
+* @param inputs Input values for each sample, one row of NoOfInputs
+*        values per sample
+* @param targets Desired output values for each sample, one row of
+*        NoOfOutputs values per sample
+* @param batch_size The number of samples in the batch
+* @param current_hidden_layer The hidden layer currently being trained
+* @param gradients Sums of the gradients, bp_gradients_length in size
+* @returns zero on success
+*/
+int bp_batch_gradients(bp * net, float * inputs, float * targets,
+                       int batch_size, int current_hidden_layer,
+                       float * gradients)
+{
+    int l, last = net->HiddenLayers+1;
+    int start_hidden_layer = bp_start_layer(net, current_hidden_layer);
+    unsigned int seed;
+    float error_sum, percent_sum, * g = gradients;
+
+    if (batch_size < 1) {
+        return -1;
+    }
+    for (l = 0; l <= last; l++) {
+        if (bp_layer_batch_alloc(&net->layer[l], batch_size) != 0) {
+            return -2;
+        }
+    }
+
+    memcpy(net->layer[0].batch_values, inputs,
+           batch_size*net->NoOfInputs*sizeof(float));
+
+    /* the random seed is left unchanged so that bp_apply_gradients
+       selects the same dropouts */
+    seed = net->random_seed;
+    bp_dropouts(net);
+    net->random_seed = seed;
+    bp_forward_backward_batch(net, targets, batch_size, start_hidden_layer,
+                              &error_sum, &percent_sum, 0);
+
+    DEEPLEARN_STATS_START(learn_time);
+    for (l = 1; l <= last; l++) {
+        bp_layer * curr = &net->layer[l];
+        float * bias_g = &g[curr->NoOfUnits*curr->NoOfInputs];
+
+        if (l > start_hidden_layer) {
+            bp_layer_gradients_batch(net, l, batch_size, g, bias_g);
+        }
+        g = &bias_g[curr->NoOfUnits];
+    }
+    DEEPLEARN_STATS_STOP(learn_time, DEEPLEARN_STATS_LEARN, 0);
+
+    g[0] += error_sum;
+    g[1] += percent_sum;
+    g[2] += batch_size;
+
+    bp_clear_dropouts(net);
+    return 0;
+}
+
+/**
+* @brief Applies the average of gradients summed by bp_batch_gradients,
+*        updating the running averages of the error as if each sample
+*        had been presented in turn.  Dropouts are selected in the same
+*        way as within bp_batch_gradients, so the random seed of the
+*        network should match that of the networks which summed the
+*        gradients.
+* @param net Backprop neural net object
+* @param gradients Sums of the gradients, bp_gradients_length in size
+* @param current_hidden_layer The hidden layer currently being trained
+* @returns zero on success
+*/
+int bp_apply_gradients(bp * net, float * gradients,
+                       int current_hidden_layer)
+{
+    int l, s, samples, last = net->HiddenLayers+1;
+    int start_hidden_layer = bp_start_layer(net, current_hidden_layer);
+    float * g = gradients, * stats;
+
+    stats = &gradients[bp_gradients_length(net) - BP_GRADIENT_STATS];
+    samples = (int)stats[2];
+    if (samples < 1) {
+        return -1;
+    }
+
+    bp_dropouts(net);
+    optimiser_next_step(&net->optimiser);
+    bp_weights_changed(net);
+
+    DEEPLEARN_STATS_START(learn_time);
+    for (l = 1; l <= last; l++) {
+        bp_layer * curr = &net->layer[l];
+        float * bias_g = &g[curr->NoOfUnits*curr->NoOfInputs];
+
+        if (l > start_hidden_layer) {
+            bp_layer_apply_gradients(net, l, samples, g, bias_g);
+        }
+        g = &bias_g[curr->NoOfUnits];
+    }
+    DEEPLEARN_STATS_STOP(learn_time, DEEPLEARN_STATS_LEARN, 0);
+
+    bp_clear_dropouts(net);
+
+    net->BPerror = stats[0] / samples;
+    for (s = 0; s < samples; s++) {
+        bp_update_error_average(net, stats[1] / samples);
+    }
+    if (net->itterations <= UINT_MAX - (unsigned int)samples) {
+        net->itterations += samples;
+    }
+    return 0;
+}
+
+/**
+* @brief Update the neural net using a mini-batch of training samples.
+*        The whole batch is fed forward, the gradients are accumulated
+*        and then a single weight update is applied.
+* @param net Backprop neural net object
+* @param inputs Input values for each sample, one row of NoOfInputs
+*        values per sample
+* @param targets Desired output values for each sample, one row of
+*        NoOfOutputs values per sample
+* @param batch_size The number of samples in the batch
+* @param current_hidden_layer The hidden layer currently being trained
+* @returns zero on success
+*/
+int bp_update_batch(bp * net, float * inputs, float * targets,
+                    int batch_size, int current_hidden_layer)
+{
+    int i, l, neuron_count;
+    int start_hidden_layer = bp_start_layer(net, current_hidden_layer);
+    int last = net->HiddenLayers+1;
+    bp_layer * curr, * outputs = &net->layer[last];
+    float error_sum, percent_sum, * row;
+
+    if (batch_size < 1) {
+        return -1;
+    }
+
+    for (l = 0; l <= last; l++) {
+        if (bp_layer_batch_alloc(&net->layer[l], batch_size) != 0) {
+            return -2;
         }
     }
 
-    /* set the neuron active */
-    n = net->hiddens[layer][neuron_index];
-    n->value_reprojected = 0.75f;
+    memcpy(net->layer[0].batch_values, inputs,
+           batch_size*net->NoOfInputs*sizeof(float));
 
-    bp_neuron_reproject(n);
-    if (layer > 0) {
-        /* apply the sigmoid function in the previous layer,
-           as with feedforward */
-        for (i = 0; i < bp_hiddens_in_layer(net,layer-1); i++) {
-            n->value_reprojected =
-                1.0f / (1.0f + exp(-(n->value_reprojected)));
-        }
+    bp_dropouts(net);
+    bp_forward_backward_batch(net, targets, batch_size, start_hidden_layer,
+                              &error_sum, &percent_sum, 1);
+
+    DEEPLEARN_STATS_START(learn_time);
+    optimiser_next_step(&net->optimiser);
+    bp_weights_changed(net);
+    for (l = start_hidden_layer+1; l <= last; l++) {
+        bp_layer_learn_batch(net, l, batch_size);
     }
+    DEEPLEARN_STATS_STOP(learn_time, DEEPLEARN_STATS_LEARN, 0);
 
-    /* reproject through the hidden layers */
-    for (l = layer-1; l > 0; l--) {
-        /* for every unit in the hidden layer */
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-            /* get the neuron object */
-            n = net->hiddens[l][i];
-            /* backpropogate the error */
-            bp_neuron_reproject(n);
-        }
-        /* apply the sigmoid function in the previous layer,
-           as with feedforward */
-        for (i = 0; i < bp_hiddens_in_layer(net,l-1); i++) {
-            n->value_reprojected =
-                1.0f / (1.0f + exp(-(n->value_reprojected)));
+    /* the network state is left as it was for the last
+       sample within the batch */
+    neuron_count = 0;
+    net->BPerrorTotal = 0;
+    for (l = 0; l <= last; l++) {
+        curr = &net->layer[l];
+        row = &curr->batch_values[(batch_size-1)*curr->NoOfUnits];
+        memcpy(curr->values, row, curr->NoOfUnits*sizeof(float));
+        row = &curr->batch_BPerror[(batch_size-1)*curr->NoOfUnits];
+        memcpy(curr->BPerror, row, curr->NoOfUnits*sizeof(float));
+        for (i = 0; i < curr->NoOfUnits; i++) {
+            curr->units[i].value = curr->values[i];
+            curr->units[i].BPerror = curr->BPerror[i];
+            if (l > start_hidden_layer) {
+                net->BPerrorTotal += curr->BPerror[i];
+                neuron_count++;
+            }
         }
     }
+    for (i = 0; i < net->NoOfOutputs; i++) {
+        outputs->units[i].desiredValue =
+            targets[(batch_size-1)*net->NoOfOutputs + i];
+    }
+    net->BPerrorTotal = fabs(net->BPerrorTotal / neuron_count);
+
+    bp_clear_dropouts(net);
+    return 0;
 }
 
 /**
-* @brief Adjust connection weights and bias values
+* @brief Creates the scratch space used by one thread when training
+*        a shared network asynchronously.  Each layer has its own
+*        values, errors and dropouts, held within a single arena.
+* @param ctx Training context
 * @param net Backprop neural net object
+* @param random_seed Seed used for the dropouts of this thread
+* @returns zero on success
 */
-void bp_learn(bp * net, int current_hidden_layer)
+static int bp_hogwild_init(bp_hogwild * ctx, bp * net,
+                           unsigned int random_seed)
 {
-    int i,l;
-    bp_neuron * n;
-    int start_hidden_layer = current_hidden_layer-1;
+    int l, i, layers = net->HiddenLayers+2;
+    size_t bytes = 4*deeplearn_arena_bytes(layers*sizeof(void*)) +
+        deeplearn_arena_bytes(layers*sizeof(int));
 
-    /* for each hidden layers */
-    if (start_hidden_layer < 0) {
-        start_hidden_layer = 0;
+    memset((void*)ctx, '\0', sizeof(bp_hogwild));
+    for (l = 0; l < layers; l++) {
+        bytes += 3*deeplearn_arena_bytes(net->layer[l].NoOfUnits*sizeof(float)) +
+            deeplearn_arena_bytes(net->layer[l].NoOfUnits*sizeof(int));
     }
-    for (l = start_hidden_layer; l < net->HiddenLayers; l++) {
-        /* for every unit in the hidden layer */
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-            /* get the neuron object */
-            n = net->hiddens[l][i];
-            /* adjust the weights for this neuron */
-            bp_neuron_learn(n,net->learningRate);
-        }
+    if (deeplearn_arena_init(&ctx->arena, bytes) != 0) {
+        return -1;
     }
 
-    /* for every unit in the output layer */
-    for (i = 0; i < net->NoOfOutputs; i++) {
-        /* get the neuron object */
-        n = net->outputs[i];
-        /* adjust the weights for this neuron */
-        bp_neuron_learn(n,net->learningRate);
+    ctx->values = (float**)deeplearn_arena_alloc(&ctx->arena,
+                                                 layers*sizeof(float*));
+    ctx->BPerror = (float**)deeplearn_arena_alloc(&ctx->arena,
+                                                  layers*sizeof(float*));
+    ctx->dropout_mask = (float**)deeplearn_arena_alloc(&ctx->arena,
+                                                       layers*sizeof(float*));
+    ctx->active = (int**)deeplearn_arena_alloc(&ctx->arena,
+                                               layers*sizeof(int*));
+    ctx->NoOfActive = (int*)deeplearn_arena_alloc(&ctx->arena,
+                                                  layers*sizeof(int));
+    for (l = 0; l < layers; l++) {
+        int units = net->layer[l].NoOfUnits;
+
+        ctx->values[l] =
+            (float*)deeplearn_arena_alloc(&ctx->arena, units*sizeof(float));
+        ctx->BPerror[l] =
+            (float*)deeplearn_arena_alloc(&ctx->arena, units*sizeof(float));
+        ctx->dropout_mask[l] =
+            (float*)deeplearn_arena_alloc(&ctx->arena, units*sizeof(float));
+        ctx->active[l] =
+            (int*)deeplearn_arena_alloc(&ctx->arena, units*sizeof(int));
+        for (i = 0; i < units; i++) {
+            ctx->dropout_mask[l][i] = 1;
+            ctx->active[l][i] = i;
+        }
+        ctx->NoOfActive[l] = units;
     }
+    ctx->random_seed = random_seed;
+    return 0;
 }
 
 /**
-* @brief Set the value of an input
-* @param net Backprop neural net object
-* @param index The index number of the input unit
-* @param value The value to set the unit to in the range 0.0 to 1.0
+* @brief Deallocates the scratch space of a training thread
+* @param ctx Training context
 */
-void bp_set_input(bp * net, int index, float value)
+static void bp_hogwild_free(bp_hogwild * ctx)
 {
-    /* get the neuron object */
-    bp_neuron * n  = net->inputs[index];
-    /* Set the value */
-    n->value = value;
+    deeplearn_arena_free(&ctx->arena);
+    memset((void*)ctx, '\0', sizeof(bp_hogwild));
 }
 
 /**
-* @brief Normalises the input values
+* @brief Trains a shared network on a single sample without taking any
+*        locks.  Activations and errors are kept within the thread's own
+*        context, while weights and biases are read and updated in place,
+*        so updates from other threads may be seen part way through.
+*        Noise is not added to the activations.
 * @param net Backprop neural net object
+* @param ctx Training context owned by the calling thread
+* @param inputs Input values of the sample
+* @param targets Desired output values of the sample
+* @param error Returned average error of the output units
+* @param errorPercent Returned error of the output units as a percentage
 */
-void bp_normalise_inputs(bp * net)
+static void bp_hogwild_sample(bp * net, bp_hogwild * ctx,
+                              const float * inputs, const float * targets,
+                              float * error, float * errorPercent)
 {
-    float max = 0,  min = 1;
-    for (int i = 0; i < net->NoOfInputs; i++) {
-        if (net->inputs[i]->value > max) {
-            max = net->inputs[i]->value;
+    int l, a, i, last = net->HiddenLayers+1;
+    int start_hidden_layer = bp_start_layer(net, 0);
+    float total = 0, percent = 0;
+
+    memcpy(ctx->values[0], inputs, net->NoOfInputs*sizeof(float));
+
+    /* dropouts within the hidden layers */
+    if (net->DropoutPercent > 0) {
+        for (l = 1; l < last; l++) {
+            ctx->NoOfActive[l] =
+                rand_dropouts(&ctx->random_seed, net->DropoutPercent,
+                              ctx->dropout_mask[l], ctx->active[l],
+                              net->layer[l].NoOfUnits);
         }
-        if (net->inputs[i]->value < min) {
-            min = net->inputs[i]->value;
+    }
+
+    /* feed forward */
+    for (l = 1; l <= last; l++) {
+        bp_layer * curr = &net->layer[l];
+        float * in = ctx->values[l-1], * out = ctx->values[l];
+
+        for (a = 0; a < ctx->NoOfActive[l]; a++) {
+            i = ctx->active[l][a];
+            out[i] = curr->units[i].bias + bp_layer_dot(curr, i, in);
+        }
+        kernel_af_vector(bp_layer_af(net, l), out, curr->NoOfUnits);
+        if (ctx->NoOfActive[l] < curr->NoOfUnits) {
+            for (i = 0; i < curr->NoOfUnits; i++) {
+                out[i] *= ctx->dropout_mask[l][i];
+            }
         }
     }
-    float range = max - min;
-    if (range > 0.00001f) {
-        for (int i = 0; i < net->NoOfInputs; i++) {
-            net->inputs[i]->value =
-                0.25f + ((net->inputs[i]->value-min)*0.5f/range);
+
+    /* errors on the output units */
+    for (i = 0; i < net->NoOfOutputs; i++) {
+        float e = 0;
+        if (targets[i] > -1) {
+            e = targets[i] - ctx->values[last][i];
+        }
+        ctx->BPerror[last][i] = e;
+        total += e;
+        percent += fabs(e);
+    }
+    *error = fabs(total / net->NoOfOutputs);
+    *errorPercent = percent * 100 / (0.5f*net->NoOfOutputs);
+
+    /* back-propogate through the hidden layers, stopping at any
+       frozen layers */
+    for (l = last; l > start_hidden_layer+1; l--) {
+        bp_layer * curr = &net->layer[l];
+        float * prev_error = ctx->BPerror[l-1];
+        int af = bp_layer_af(net, l);
+
+        memset(prev_error, '\0', net->layer[l-1].NoOfUnits*sizeof(float));
+        for (a = 0; a < ctx->NoOfActive[l]; a++) {
+            int k = ctx->active[l][a];
+            float delta = ctx->BPerror[l][k] *
+                kernel_af_derivative(af, ctx->values[l][k]);
+
+            if (curr->sparse != 0) {
+                int start = curr->sparse->row_start[k];
+                kernel_sparse_axpy(prev_error, delta,
+                                   &curr->sparse->values[start],
+                                   &curr->sparse->column[start],
+                                   curr->sparse->row_start[k+1] - start);
+            }
+            else {
+                kernel_axpy(prev_error, delta,
+                            &curr->weights[k*curr->NoOfInputs],
+                            curr->NoOfInputs);
+            }
+        }
+    }
+
+    /* adjust the shared weights and biases above any frozen layers */
+    for (l = start_hidden_layer+1; l <= last; l++) {
+        bp_layer * curr = &net->layer[l];
+        float * in = ctx->values[l-1];
+        float e = net->learningRate / (1.0f + curr->NoOfInputs);
+        int af = bp_layer_af(net, l);
+
+        for (a = 0; a < ctx->NoOfActive[l]; a++) {
+            float gradient, min_weight, max_weight;
+
+            i = ctx->active[l][a];
+            gradient = kernel_af_derivative(af, ctx->values[l][i]) *
+                ctx->BPerror[l][i];
+
+            /* the weight range is kept per thread, since it is only
+               used for plotting */
+            bp_unit_learn(net, curr, i, in, e, gradient, gradient,
+                          &min_weight, &max_weight);
         }
     }
 }
 
 /**
-* @brief Sets the inputs to a text string
+* @brief Trains the whole network on a set of samples using several
+*        threads which update the weights asynchronously without locks
+*        (Hogwild).  Each thread takes samples in turn and applies its
+*        own updates, which for wide networks with sparse inputs rarely
+*        touch the same weights, so training scales with the number of
+*        threads.  The result depends upon the timing of the threads.
+*        The step count of the optimiser advances once per call rather
+*        than once per sample, so that it is not shared between threads.
 * @param net Backprop neural net object
-* @param text The text string
+* @param inputs Input values, one row of NoOfInputs values per sample
+* @param targets Desired output values, one row of NoOfOutputs values
+*        per sample
+* @param no_of_samples The number of samples
+* @param no_of_threads The number of threads, or zero to use the
+*        number given by threads_count
+* @returns zero on success
 */
-void bp_set_input_text(bp * net, char * text)
+int bp_update_hogwild(bp * net, float * inputs, float * targets,
+                      int no_of_samples, int no_of_threads)
 {
-    enc_text_to_binary(text, net->inputs, net->NoOfInputs, 0, strlen(text));
+    int s, failed = 0;
+    float error_sum = 0, percent_sum = 0;
+    unsigned int seed = net->random_seed;
+    DEEPLEARN_STATS_START(start_time);
+
+    if ((no_of_samples < 1) || (no_of_threads < 0)) {
+        return -1;
+    }
+#ifdef _OPENMP
+    if (no_of_threads == 0) {
+        no_of_threads = threads_count();
+    }
+#else
+    no_of_threads = 1;
+#endif
+    optimiser_next_step(&net->optimiser);
+    bp_weights_changed(net);
+
+#pragma omp parallel num_threads(no_of_threads) if (no_of_samples > 1) reduction(+:failed,error_sum,percent_sum)
+    {
+        bp_hogwild ctx;
+        unsigned int thread_seed = seed;
+        int ready;
+
+#ifdef _OPENMP
+        thread_seed += 7919*(unsigned int)(omp_get_thread_num()+1);
+#endif
+        ready = (bp_hogwild_init(&ctx, net, thread_seed) == 0);
+        if (!ready) {
+            failed++;
+        }
+
+#pragma omp for schedule(dynamic, 8)
+        for (s = 0; s < no_of_samples; s++) {
+            float error, errorPercent;
+
+            if (!ready) continue;
+            bp_hogwild_sample(net, &ctx,
+                              &inputs[(size_t)s*net->NoOfInputs],
+                              &targets[(size_t)s*net->NoOfOutputs],
+                              &error, &errorPercent);
+            error_sum += error;
+            percent_sum += errorPercent;
+        }
+        if (ready) {
+            bp_hogwild_free(&ctx);
+        }
+    }
+
+    /* different dropouts next time */
+    rand_num(&net->random_seed);
+
+    if (failed != 0) {
+        return -2;
+    }
+
+    /* running averages as if the samples had been presented in turn */
+    net->BPerror = error_sum / no_of_samples;
+    for (s = 0; s < no_of_samples; s++) {
+        bp_update_error_average(net, percent_sum / no_of_samples);
+    }
+    if (net->itterations <= UINT_MAX - (unsigned int)no_of_samples) {
+        net->itterations += no_of_samples;
+    }
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_LEARN, 0);
+    return 0;
 }
 
 /**
-* @brief Set the inputs of the network from a patch within an image.
-*        It is assumed that the image is mono (1 byte per pixel)
+* @brief Creates an inference context which can be used to evaluate
+*        the given network, or any other network of the same shape
+* @param ctx Inference context
 * @param net Backprop neural net object
-* @param img Array storing the image
-* @param image_width Width of the image in pixels
-* @param image_height Height of the image in pixels
-* @param tx Top left x coordinate of the patch within the image
-* @param ty Top left y coordinate of the patch within the image
+* @param batch_capacity The maximum number of samples evaluated at once
+* @returns zero on success
 */
-void bp_inputs_from_image_patch(bp * net,
-                                unsigned char img[],
-                                int image_width, int image_height,
-                                int tx, int ty)
+int bp_inference_init(bp_inference * ctx, bp * net, int batch_capacity)
 {
-    int px,py,i=0,idx;
+    int l;
 
-    /* The patch size is calculated from the number of inputs
-        of the neural net.  It's assumed to be square. */
-    int patch_size = (int)sqrt(net->NoOfInputs);
+    if (batch_capacity < 1) {
+        return -1;
+    }
 
-    /* make sure that the patch fits within the number of inputs */
-    assert(patch_size*patch_size <= net->NoOfInputs);
+    ctx->batch_capacity = batch_capacity;
 
-    /* set the inputs from the patch */
-    for (py = ty; py < ty+patch_size; py++) {
-        if (py >= image_height) break;
-        for (px = tx; px < tx+patch_size; px++, i++) {
-            if (px >= image_width) break;
-            /* array index within the image */
-            idx = (py*image_width) + px;
-            /* set the input value within the range 0.25 to 0.75 */
-            bp_set_input(net, i, 0.25f + (img[idx]*0.5f/255.0f));
+    /* size of the largest layer */
+    ctx->layer_capacity = 0;
+    for (l = 0; l < net->HiddenLayers+2; l++) {
+        if (net->layer[l].NoOfUnits > ctx->layer_capacity) {
+            ctx->layer_capacity = net->layer[l].NoOfUnits;
+        }
+    }
+
+    ctx->inputs =
+        (float*)malloc(batch_capacity*net->NoOfInputs*sizeof(float));
+    if (!ctx->inputs) {
+        return -2;
+    }
+    ctx->values[0] =
+        (float*)malloc(batch_capacity*ctx->layer_capacity*sizeof(float));
+    if (!ctx->values[0]) {
+        return -3;
+    }
+    ctx->values[1] =
+        (float*)malloc(batch_capacity*ctx->layer_capacity*sizeof(float));
+    if (!ctx->values[1]) {
+        return -4;
+    }
+    ctx->quantised =
+        (uint8_t*)malloc(batch_capacity*ctx->layer_capacity*sizeof(uint8_t));
+    if (!ctx->quantised) {
+        return -5;
+    }
+    ctx->no_of_changed = 0;
+    ctx->changed = 0;
+    ctx->delta = 0;
+    if (net->layer[1].neutral != 0) {
+        ctx->no_of_changed = (int*)malloc(batch_capacity*sizeof(int));
+        ctx->changed =
+            (int*)malloc(batch_capacity*net->NoOfInputs*sizeof(int));
+        ctx->delta =
+            (float*)malloc(batch_capacity*net->NoOfInputs*sizeof(float));
+        if ((!ctx->no_of_changed) || (!ctx->changed) || (!ctx->delta)) {
+            return -6;
         }
     }
+    DEEPLEARN_STATS_ALLOC(batch_capacity*net->NoOfInputs*sizeof(float));
+    DEEPLEARN_STATS_ALLOC(batch_capacity*ctx->layer_capacity*sizeof(float));
+    DEEPLEARN_STATS_ALLOC(batch_capacity*ctx->layer_capacity*sizeof(float));
+    return 0;
 }
 
 /**
-* @brief Set the inputs of the network from an image.
-*        It is assumed that the image is mono (1 byte per pixel)
-* @param net Backprop neural net object
-* @param img Array storing the image
-* @param image_width Width of the image in pixels
-* @param image_height Height of the image in pixels
+* @brief Creates the replica of a network for a NUMA node.  This runs on
+*        the node, so that the copied weights are placed in its memory.
+* @param data Replicas being created
+* @param node Index of the node
+* @param worker Unused
 */
-void bp_inputs_from_image(bp * net,
-                          unsigned char img[],
-                          int image_width, int image_height)
+static void bp_replica_create(void * data, int node, int worker)
 {
-    int i=0;
+    bp_replicas * replicas = (bp_replicas*)data;
+    bp * replica = (bp*)malloc(sizeof(bp));
 
-    /* check that the number of inputs is the same as the
-       number of pixels */
-    assert(net->NoOfInputs == image_width*image_height);
+    (void)worker;
+    if (!replica) return;
+    if (bp_clone(replica, replicas->source) != 0) {
+        free(replica);
+        return;
+    }
+    replicas->replica[node] = replica;
+}
 
-    /* set the inputs */
-    for (i = 0; i < image_width*image_height; i++) {
-        /* set the input value within the range 0.25 to 0.75 */
-        bp_set_input(net, i, 0.25f + (img[i]*0.5f/255.0f));
+/**
+* @brief Makes a copy of a network on each NUMA node, so that threads
+*        evaluating the network read weights from local memory rather
+*        than across sockets.  If there is only one node then no copies
+*        are made.  The copies are not updated by training, so they
+*        should be created again after the weights change.
+* @param replicas Replicas object
+* @param net Backprop neural net object to be copied
+* @returns zero on success
+*/
+int bp_replicas_init(bp_replicas * replicas, bp * net)
+{
+    int nodes = threads_numa_nodes();
+
+    memset((void*)replicas, '\0', sizeof(bp_replicas));
+    if (nodes < 2) return 0;
+    if (nodes > THREADS_MAX_NODES) nodes = THREADS_MAX_NODES;
+
+    replicas->source = net;
+    for (int n = 0; n < nodes; n++) {
+        threads_on_node(n, bp_replica_create, (void*)replicas);
+        if (!replicas->replica[n]) {
+            bp_replicas_free(replicas);
+            return -1;
+        }
+        replicas->no_of_replicas++;
     }
+    return 0;
 }
 
 /**
-* @brief Plots weight matrices within an image
-* @param net Backprop neural net object
-* @param filename Filename of the image to save as
-* @param image_width Width of the image in pixels
-* @param image_height Height of the image in pixels
-* @param input_image_width When displaying all inputs as an image this
-         is the number of inputs across.  Set this to zero for the
-         inputs image to be square.
+* @brief Returns the copy of a network on the NUMA node of the calling
+*        thread, or the network itself if there are no copies
+* @param replicas Replicas object
+* @param net Backprop neural net object from which the copies were made
+* @returns Network to be used by the calling thread
 */
-int bp_plot_weights(bp * net,
-                    char * filename,
-                    int image_width, int image_height,
-                    int input_image_width)
+bp * bp_replicas_local(bp_replicas * replicas, bp * net)
 {
-    int layer, neurons_x, neurons_y, ty, by, h, x, y, ix, iy;
-    int wx, wy, inputs_x, inputs_y, n, i, unit, no_of_neurons;
-    int no_of_weights,wdth;
-    float neuronx, neurony,dw;
-    bp_neuron ** neurons, * curr_neuron;
-    unsigned char * img;
+    int node;
 
-    /* allocate memory for the image */
-    img = (unsigned char*)malloc(image_width*image_height*3);
-    if (!img) {
-        return -1;
+    if (replicas->no_of_replicas == 0) return net;
+
+    node = threads_numa_node();
+    if ((node < 0) || (node >= replicas->no_of_replicas)) return net;
+    return replicas->replica[node];
+}
+
+/**
+* @brief Deallocates the copies of a network
+* @param replicas Replicas object
+*/
+void bp_replicas_free(bp_replicas * replicas)
+{
+    for (int n = 0; n < THREADS_MAX_NODES; n++) {
+        if (replicas->replica[n]) {
+            bp_free(replicas->replica[n]);
+            free(replicas->replica[n]);
+        }
     }
+    memset((void*)replicas, '\0', sizeof(bp_replicas));
+}
 
-    /* clear the image with a white background */
-    memset((void*)img,'\255',image_width*image_height*3);
+/**
+* @brief Deallocates an inference context
+* @param ctx Inference context
+*/
+void bp_inference_free(bp_inference * ctx)
+{
+    free(ctx->inputs);
+    free(ctx->values[0]);
+    free(ctx->values[1]);
+    free(ctx->quantised);
+    free(ctx->no_of_changed);
+    free(ctx->changed);
+    free(ctx->delta);
+    ctx->inputs = 0;
+    ctx->values[0] = 0;
+    ctx->values[1] = 0;
+    ctx->quantised = 0;
+    ctx->no_of_changed = 0;
+    ctx->changed = 0;
+    ctx->delta = 0;
+    ctx->batch_capacity = 0;
+}
 
-    /* dimension of the neurons matrix for each layer */
-    neurons_x = (int)sqrt(net->NoOfHiddens);
-    neurons_y = (net->NoOfHiddens/neurons_x);
+/**
+* @brief Weighted sums of the first layer for a batch of samples using
+*        the folded biases of neutral inputs.  If the weights have
+*        changed since the biases were folded then they are folded
+*        again, by whichever thread gets there first.
+* @param layer The first layer
+* @param ctx Inference context
+* @param generation Generation of the weights of the network
+* @param in Input values, one row per sample
+* @param out Returned weighted sums, one row per sample
+* @param batch_size The number of samples
+* @returns zero if the weighted sums were calculated, or non-zero if
+*          they should be calculated from all of the inputs
+*/
+static int bp_infer_neutral(bp_layer * layer, bp_inference * ctx,
+                            unsigned int generation,
+                            const float * in, float * out, int batch_size)
+{
+    bp_neutral * neutral = layer->neutral;
+    int i, b, max_changed = bp_neutral_max_changed(layer);
 
-    /* dimensions of the weight matrix */
-    if (input_image_width <= 0) {
-        inputs_x = (int)sqrt(net->NoOfInputs);
+    if ((neutral == 0) || (ctx->changed == 0)) {
+        return -1;
     }
-    else {
-        inputs_x = input_image_width;
+#pragma omp critical (bp_neutral)
+    {
+        if (neutral->generation != generation) {
+            bp_layer_neutral_update(layer, generation);
+        }
     }
-    inputs_y = (net->NoOfInputs/inputs_x);
 
-    no_of_weights = net->NoOfInputs;
+    for (b = 0; b < batch_size; b++) {
+        ctx->no_of_changed[b] =
+            bp_neutral_changed(&in[b*layer->NoOfInputs], layer->NoOfInputs,
+                               &ctx->changed[b*layer->NoOfInputs],
+                               &ctx->delta[b*layer->NoOfInputs],
+                               max_changed);
+        if (ctx->no_of_changed[b] < 0) {
+            return -2;
+        }
+    }
 
-    /* plot the inputs */
-    ty = 0;
-    by = image_height/(net->HiddenLayers+3);
-    h = (by-ty)*95/100;
-    wdth = h;
-    if (wdth>=image_width) wdth=image_width;
-    for (y = 0; y < h; y++) {
-        iy = y*inputs_y/h;
-        for (x = 0; x < wdth; x++) {
-            ix = x*inputs_x/wdth;
-            unit = (iy*inputs_x) + ix;
-            if (unit < net->NoOfInputs) {
-                n = (y*image_width + x)*3;
-                img[n] = (unsigned char)(net->inputs[unit]->value*255);
-                img[n+1] = img[n];
-                img[n+2] = img[n];
-            }
+    for (i = 0; i < layer->NoOfUnits; i++) {
+        const float * w = &layer->weights[i*layer->NoOfInputs];
+        for (b = 0; b < batch_size; b++) {
+            out[b*layer->NoOfUnits + i] = neutral->bias[i] +
+                kernel_sparse_dot(&ctx->delta[b*layer->NoOfInputs],
+                                  &ctx->changed[b*layer->NoOfInputs],
+                                  w, ctx->no_of_changed[b]);
         }
     }
+    return 0;
+}
 
-    for (layer = 0; layer < net->HiddenLayers+1; layer++) {
+/**
+* @brief Evaluates a batch of samples without changing the state of
+*        the network.  Weights and biases are only read, and all
+*        activations are kept within the inference context, so many
+*        threads can use the same network at the same time.
+*        Noise and dropouts are not applied.
+* @param net Backprop neural net object
+* @param ctx Inference context, owned by the calling thread
+* @param inputs Input values, one row of NoOfInputs values per sample
+* @param outputs Returned output values, one row of NoOfOutputs
+*        values per sample
+* @param batch_size The number of samples
+* @returns zero on success
+*/
+int bp_infer(bp * net, bp_inference * ctx,
+             float * inputs, float * outputs, int batch_size)
+{
+    int i, b, l, prev_units, curr = 0;
+    float * in = inputs, * out;
+    bp_layer * layer;
 
-        /* vertical top and bottom coordinates */
-        ty = (layer+1)*image_height/(net->HiddenLayers+3);
-        by = (layer+2)*image_height/(net->HiddenLayers+3);
-        h = (by-ty)*95/100;
+    if ((batch_size < 1) || (batch_size > ctx->batch_capacity)) {
+        return -1;
+    }
 
-        /* number of patches across and down for the final layer */
-        if (layer == net->HiddenLayers) {
-            neurons_x = (int)sqrt(net->NoOfOutputs);
-            neurons_y = (net->NoOfOutputs/neurons_x);
-            neurons = net->outputs;
-            no_of_neurons = net->NoOfOutputs;
+    prev_units = net->NoOfInputs;
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        layer = &net->layer[l];
+        if (layer->NoOfUnits > ctx->layer_capacity) {
+            return -2;
+        }
+
+        /* the final layer goes straight into the outputs */
+        if (l == net->HiddenLayers+1) {
+            out = outputs;
         }
         else {
-            neurons_x = (int)sqrt(bp_hiddens_in_layer(net,layer));
-            neurons_y = (bp_hiddens_in_layer(net,layer)/neurons_x);
-            neurons = net->hiddens[layer];
-            no_of_neurons = bp_hiddens_in_layer(net,layer);
+            out = ctx->values[curr];
         }
 
-        /* for every pixel within the region */
-        for (y = ty; y < by; y++) {
-            neurony = (y-ty)*neurons_y/(float)h;
-            /* y coordinate within the weights */
-            wy = (neurony - (int)neurony)*inputs_y;
-            for (x = 0; x < image_width; x++) {
-                neuronx = x*neurons_x/(float)image_width;
-                /* x coordinate within the weights */
-                wx = (neuronx - (int)neuronx)*inputs_x;
-                /* coordinate within the image */
-                n = ((y * image_width) + x)*3;
-                /* weight index */
-                i = (wy*inputs_x) + wx;
-                if (i < no_of_weights) {
-                    /* neuron index */
-                    unit = ((int)neurony*neurons_x) + (int)neuronx;
-                    if (unit < no_of_neurons)  {
-                        curr_neuron = neurons[unit];
-                        dw = curr_neuron->max_weight -
-                            curr_neuron->min_weight;
-                        if (dw > 0.0001f) {
-                            img[n] =
-                                (int)((curr_neuron->weights[i] -
-                                       curr_neuron->min_weight)*255/dw);
-                            img[n+1] = img[n];
-                            img[n+2] = img[n];
-                        }
-                        else {
-                            img[n] =
-                                (int)(curr_neuron->weights[i]*255);
-                            img[n+1] = img[n];
-                            img[n+2] = img[n];
-                        }
-                    }
+        if ((net->inference_precision == KERNEL_INT8) &&
+            (layer->quant != 0)) {
+            bp_quant * quant = layer->quant;
+
+            /* integer dot products of the quantised inputs and weights,
+               which are then scaled back to floats */
+            kernel_quantise_u8(in, ctx->quantised, batch_size*prev_units,
+                               quant->input_scale, quant->input_zero);
+            for (i = 0; i < layer->NoOfUnits; i++) {
+                const int8_t * w = &quant->weights[i*layer->NoOfInputs];
+                float scale = quant->scale[i]*quant->input_scale;
+                int32_t offset = quant->input_zero*quant->row_sum[i];
+                for (b = 0; b < batch_size; b++) {
+                    out[b*layer->NoOfUnits + i] =
+                        layer->units[i].bias +
+                        scale*(float)(kernel_dot_u8i8(&ctx->quantised[b*prev_units],
+                                                      w, layer->NoOfInputs) -
+                                      offset);
                 }
             }
         }
-        if (layer < net->HiddenLayers) {
-            /* dimensions of the weight matrix for the next layer */
-            inputs_x = (int)sqrt(bp_hiddens_in_layer(net,layer));
-            inputs_y = (bp_hiddens_in_layer(net,layer)/inputs_x);
-            no_of_weights = bp_hiddens_in_layer(net,layer);
+        else if ((l == 1) &&
+                 (bp_infer_neutral(layer, ctx, net->generation,
+                                   in, out, batch_size) == 0)) {
+            /* only inputs which differ from neutral were accumulated */
+        }
+        else if (layer->sparse == 0) {
+            /* weighted sums of the whole batch as a matrix multiply,
+               which may be evaluated on a device */
+            kernel_gemm_nt_weights(batch_size, layer->NoOfUnits,
+                                   layer->NoOfInputs, in, layer->weights,
+                                   net->generation, out);
+            for (b = 0; b < batch_size; b++) {
+                for (i = 0; i < layer->NoOfUnits; i++) {
+                    out[b*layer->NoOfUnits + i] += layer->units[i].bias;
+                }
+            }
+        }
+        else {
+            for (i = 0; i < layer->NoOfUnits; i++) {
+                for (b = 0; b < batch_size; b++) {
+                    out[b*layer->NoOfUnits + i] =
+                        layer->units[i].bias +
+                        bp_layer_dot(layer, i, &in[b*prev_units]);
+                }
+            }
         }
+        kernel_af_vector(bp_layer_af(net, l), out,
+                         batch_size*layer->NoOfUnits);
+
+        in = out;
+        prev_units = layer->NoOfUnits;
+        curr = 1 - curr;
     }
+    return 0;
+}
 
-    ty = (net->HiddenLayers+2)*image_height/(net->HiddenLayers+3);
-    by = (net->HiddenLayers+3)*image_height/(net->HiddenLayers+3);
-    h = (by-ty)*95/100;
+/**
+* @brief Comparison of two floats used to sort weight magnitudes
+* @param a First value
+* @param b Second value
+* @returns negative, zero or positive as with strcmp
+*/
+static int bp_compare_magnitudes(const void * a, const void * b)
+{
+    float fa = *(const float*)a, fb = *(const float*)b;
 
-    inputs_x = (int)sqrt(net->NoOfOutputs);
-    inputs_y = (net->NoOfOutputs/inputs_x);
+    if (fa < fb) return -1;
+    if (fa > fb) return 1;
+    return 0;
+}
 
-    wdth = h;
-    if (wdth >= image_width) wdth = image_width;
-    for (y = 0; y < h; y++) {
-        iy = y*inputs_y/h;
-        for (x = 0; x < wdth; x++) {
-            ix = x*inputs_x/wdth;
-            unit = (iy*inputs_x) + ix;
-            if (unit < net->NoOfOutputs) {
-                n = ((ty+y)*image_width + x)*3;
-                img[n] = (unsigned char)(net->outputs[unit]->value*255);
-                img[n+1] = img[n];
-                img[n+2] = img[n];
-            }
-        }
+/**
+* @brief Builds the sparse connections of a layer from the non-zero
+*        dense weights, and updates the weight range of each unit to
+*        cover only its live connections
+* @param layer The layer
+* @returns zero on success
+*/
+static int bp_layer_sparse_build(bp_layer * layer)
+{
+    int i, j, k, nonzero = 0;
+    float * w;
+    bp_neuron * n;
+    bp_sparse * sparse;
+
+    for (i = 0; i < layer->NoOfUnits*layer->NoOfInputs; i++) {
+        if (layer->weights[i] != 0) nonzero++;
     }
 
-    /* write the image to file */
-    deeplearn_write_png_file(filename,
-                             (unsigned int)image_width, (unsigned int)image_height,
-                             24, img);
+    bp_layer_sparse_free(layer);
+    sparse = (bp_sparse*)malloc(sizeof(bp_sparse));
+    if (!sparse) {
+        return -1;
+    }
+    sparse->nonzero = nonzero;
+    sparse->row_start = (int*)malloc((layer->NoOfUnits+1)*sizeof(int));
+    sparse->column = (int*)malloc((nonzero+1)*sizeof(int));
+    sparse->values = (float*)malloc((nonzero+1)*sizeof(float));
+    layer->sparse = sparse;
+    if ((!sparse->row_start) || (!sparse->column) || (!sparse->values)) {
+        bp_layer_sparse_free(layer);
+        return -2;
+    }
 
-    /* free the image memory */
-    free(img);
+    k = 0;
+    for (i = 0; i < layer->NoOfUnits; i++) {
+        n = &layer->units[i];
+        w = &layer->weights[i*layer->NoOfInputs];
+        sparse->row_start[i] = k;
+        n->min_weight = 9999;
+        n->max_weight = -9999;
+        for (j = 0; j < layer->NoOfInputs; j++) {
+            if (w[j] == 0) continue;
+            sparse->column[k] = j;
+            sparse->values[k] = w[j];
+            if (w[j] < n->min_weight) n->min_weight = w[j];
+            if (w[j] > n->max_weight) n->max_weight = w[j];
+            k++;
+        }
+        if (k == sparse->row_start[i]) {
+            n->min_weight = 0;
+            n->max_weight = 0;
+        }
+    }
+    sparse->row_start[layer->NoOfUnits] = k;
+    DEEPLEARN_STATS_ALLOC((layer->NoOfUnits+1)*sizeof(int) +
+                          (nonzero+1)*(sizeof(int)+sizeof(float)));
     return 0;
 }
 
 /**
-* @brief Returns the value of one of the input units
+* @brief Prunes the connections of the hidden and output layers with
+*        the smallest weights, after which only the remaining live
+*        connections are visited when the network is evaluated or
+*        trained.  Weights which are already zero are always treated
+*        as pruned, so a fraction of zero restores the sparse form of
+*        a pruned network after it has been loaded, or after its dense
+*        weights have been trained by something else such as an
+*        autocoder.
 * @param net Backprop neural net object
-* @param index Index of the input unit
-* @return value in the range 0.0 to 1.0
+* @param fraction Fraction of the connections within each layer
+*        to be removed, in the range 0.0 -> 1.0
+* @returns zero on success
 */
-float bp_get_input(bp * net, int index)
+int bp_prune(bp * net, float fraction)
 {
-    return net->inputs[index]->value;
+    int l, i, n, retval = 0;
+    float threshold, * magnitude;
+    bp_layer * layer;
+
+    if ((fraction < 0) || (fraction >= 1)) {
+        return -1;
+    }
+
+    bp_weights_changed(net);
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        layer = &net->layer[l];
+        n = layer->NoOfUnits*layer->NoOfInputs;
+
+        if (fraction > 0) {
+            magnitude = (float*)malloc(n*sizeof(float));
+            if (!magnitude) {
+                return -2;
+            }
+            for (i = 0; i < n; i++) {
+                magnitude[i] = fabs(layer->weights[i]);
+            }
+            qsort(magnitude, n, sizeof(float), bp_compare_magnitudes);
+            threshold = magnitude[(int)(fraction*n)];
+            free(magnitude);
+
+            /* anything smaller than the threshold is removed */
+            for (i = 0; i < n; i++) {
+                if (fabs(layer->weights[i]) < threshold) {
+                    layer->weights[i] = 0;
+                    layer->lastWeightChange[i] = 0;
+                }
+            }
+        }
+
+        if (bp_layer_sparse_build(layer) != 0) {
+            retval = -3;
+        }
+    }
+    return retval;
 }
 
 /**
-* @brief Sets the value of one of the output units
+* @brief Returns a pruned network to dense weights.  Pruned
+*        connections keep a weight of zero, but may be trained again.
 * @param net Backprop neural net object
-* @param index Index of the output unit
-* @param value The value to set the output to in the range 0.0 to 1.0
 */
-void bp_set_output(bp * net, int index, float value)
+void bp_sparse_free(bp * net)
 {
-    net->outputs[index]->desiredValue = value;
+    int l;
+
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        bp_layer_sparse_free(&net->layer[l]);
+    }
 }
 
 /**
-* @brief Gets the value of one of the hidden units
+* @brief Returns the fraction of connections within the hidden and
+*        output layers which have been pruned
 * @param net Backprop neural net object
-* @param layer Index number of the hidden layer
-* @param index Index of the unit within the given hidden layer
-* @return value in the range 0.0 to 1.0
+* @returns Fraction of pruned connections in the range 0.0 -> 1.0
 */
-float bp_get_hidden(bp * net, int layer, int index)
+float bp_sparsity(bp * net)
 {
-    return net->hiddens[layer][index]->value;
+    int l;
+    double connections = 0, live = 0;
+    bp_layer * layer;
+
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        layer = &net->layer[l];
+        connections += layer->NoOfUnits*layer->NoOfInputs;
+        if (layer->sparse != 0) {
+            live += layer->sparse->nonzero;
+        }
+        else {
+            live += layer->NoOfUnits*layer->NoOfInputs;
+        }
+    }
+    if (connections == 0) return 0;
+    return (float)(1.0 - (live / connections));
 }
 
 /**
-* @brief Gets the value of one of the output units
+* @brief Feeds calibration samples through the network and records
+*        the range of the inputs to each layer
 * @param net Backprop neural net object
-* @param index Index of the unit within the output layer
-* @return value in the range 0.0 to 1.0
+* @param inputs Input unit values, one row of NoOfInputs per sample
+* @param samples The number of samples
+* @param minimum Returned minimum input value for each layer after
+*        the input layer
+* @param maximum Returned maximum input value for each layer after
+*        the input layer
+* @returns zero on success
 */
-float bp_get_output(bp * net, int index)
+static int bp_calibrate(bp * net, float * inputs, int samples,
+                        float * minimum, float * maximum)
 {
-    return net->outputs[index]->value;
+    int s, l, i, capacity = 0;
+    float * values[2], * in, * out;
+    bp_layer * layer;
+
+    for (l = 0; l < net->HiddenLayers+2; l++) {
+        if (net->layer[l].NoOfUnits > capacity) {
+            capacity = net->layer[l].NoOfUnits;
+        }
+    }
+    values[0] = (float*)malloc(capacity*sizeof(float));
+    values[1] = (float*)malloc(capacity*sizeof(float));
+    if ((!values[0]) || (!values[1])) {
+        free(values[0]);
+        free(values[1]);
+        return -1;
+    }
+
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        minimum[l-1] = 0;
+        maximum[l-1] = 0;
+    }
+
+    for (s = 0; s < samples; s++) {
+        in = &inputs[s*net->NoOfInputs];
+        for (l = 1; l < net->HiddenLayers+2; l++) {
+            layer = &net->layer[l];
+            out = values[l % 2];
+            for (i = 0; i < layer->NoOfInputs; i++) {
+                if (in[i] < minimum[l-1]) minimum[l-1] = in[i];
+                if (in[i] > maximum[l-1]) maximum[l-1] = in[i];
+            }
+            for (i = 0; i < layer->NoOfUnits; i++) {
+                out[i] = layer->units[i].bias + bp_layer_dot(layer, i, in);
+            }
+            kernel_af_vector(bp_layer_af(net, l), out, layer->NoOfUnits);
+            in = out;
+        }
+    }
+
+    free(values[0]);
+    free(values[1]);
+    return 0;
 }
 
 /**
-* @brief Exclusion flags indicate that a unit has temporarily dropped out.
-*        This clears the all the exclusion flags
-* @param net Backprop neural net object
+* @brief Quantises the weights of a layer to eight bits
+* @param layer The layer
+* @param granularity BP_QUANT_PER_LAYER or BP_QUANT_PER_UNIT
+* @param minimum Minimum value of the inputs to the layer
+* @param maximum Maximum value of the inputs to the layer
+* @returns zero on success
 */
-static void bp_clear_dropouts(bp * net)
+static int bp_layer_quantise(bp_layer * layer, int granularity,
+                             float minimum, float maximum)
 {
-    int l,i;
-
-    /* if no dropouts then don't continue */
-    if (net->DropoutPercent==0) return;
+    int i, j;
+    float magnitude, layer_magnitude = 0;
+    float * w;
+    bp_quant * quant;
+
+    bp_layer_quant_free(layer);
+    quant = (bp_quant*)malloc(sizeof(bp_quant));
+    if (!quant) {
+        return -1;
+    }
+    quant->weights =
+        (int8_t*)malloc(layer->NoOfUnits*layer->NoOfInputs*sizeof(int8_t));
+    quant->scale = (float*)malloc(layer->NoOfUnits*sizeof(float));
+    quant->row_sum = (int32_t*)malloc(layer->NoOfUnits*sizeof(int32_t));
+    layer->quant = quant;
+    if ((!quant->weights) || (!quant->scale) || (!quant->row_sum)) {
+        bp_layer_quant_free(layer);
+        return -2;
+    }
 
-    /* for every hidden layer */
-    for (l = 0; l < net->HiddenLayers; l++) {
-        /* for every unit in the layer */
-        for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
-            /* clear the excluded flag */
-            net->hiddens[l][i]->excluded = 0;
+    /* largest weight of each unit maps to +-127 */
+    for (i = 0; i < layer->NoOfUnits; i++) {
+        w = &layer->weights[i*layer->NoOfInputs];
+        magnitude = 0;
+        for (j = 0; j < layer->NoOfInputs; j++) {
+            if (fabs(w[j]) > magnitude) magnitude = fabs(w[j]);
+        }
+        quant->scale[i] = magnitude / 127.0f;
+        if (magnitude > layer_magnitude) layer_magnitude = magnitude;
+    }
+    for (i = 0; i < layer->NoOfUnits; i++) {
+        if (granularity == BP_QUANT_PER_LAYER) {
+            quant->scale[i] = layer_magnitude / 127.0f;
         }
+        if (quant->scale[i] <= 0) quant->scale[i] = 1;
+
+        quant->row_sum[i] =
+            kernel_quantise_s8(&layer->weights[i*layer->NoOfInputs],
+                               &quant->weights[i*layer->NoOfInputs],
+                               layer->NoOfInputs, quant->scale[i]);
     }
+    kernel_quantise_range(minimum, maximum,
+                          &quant->input_scale, &quant->input_zero);
+
+    DEEPLEARN_STATS_ALLOC(layer->NoOfUnits*layer->NoOfInputs*sizeof(int8_t) +
+                          layer->NoOfUnits*(sizeof(float)+sizeof(int32_t)));
+    return 0;
 }
 
 /**
-* @brief Randomly sets exclusion flags to cause units to drop out
+* @brief Quantises a trained network to eight bit weights, after which
+*        bp_infer uses integer dot products.  The range of the
+*        activations feeding into each layer is calibrated by
+*        evaluating the given samples.  If the network is trained
+*        further then it should be quantised again.
 * @param net Backprop neural net object
+* @param granularity BP_QUANT_PER_LAYER for a single weight scale
+*        within each layer, or BP_QUANT_PER_UNIT for a scale per unit
+* @param inputs Calibration input unit values, one row of NoOfInputs
+*        values per sample
+* @param samples The number of calibration samples
+* @returns zero on success
 */
-static void bp_dropouts(bp * net)
+int bp_quantise(bp * net, int granularity, float * inputs, int samples)
 {
-    int l,i,no_of_dropouts,hidden_units=0,n;
+    int l, retval = 0;
+    float * minimum, * maximum;
 
-    if (net->DropoutPercent==0) return;
+    if ((granularity != BP_QUANT_PER_LAYER) &&
+        (granularity != BP_QUANT_PER_UNIT)) {
+        return -1;
+    }
+    if ((inputs == 0) || (samples < 1)) {
+        return -1;
+    }
 
-    /* total number of hidden units */
-    for (l = 0; l < net->HiddenLayers; l++) {
-        hidden_units += bp_hiddens_in_layer(net,l);
+    minimum = (float*)malloc((net->HiddenLayers+1)*sizeof(float));
+    maximum = (float*)malloc((net->HiddenLayers+1)*sizeof(float));
+    if ((!minimum) || (!maximum) ||
+        (bp_calibrate(net, inputs, samples, minimum, maximum) != 0)) {
+        free(minimum);
+        free(maximum);
+        return -2;
     }
 
-    /* total number of dropouts */
-    no_of_dropouts = net->DropoutPercent*hidden_units/100;
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        if (bp_layer_quantise(&net->layer[l], granularity,
+                              minimum[l-1], maximum[l-1]) != 0) {
+            retval = -3;
+            break;
+        }
+    }
+    free(minimum);
+    free(maximum);
 
-    /* set the exclusion flags */
-    for (n = 0; n < no_of_dropouts; n++) {
-        l = rand_num(&net->random_seed)%net->HiddenLayers;
-        i = rand_num(&net->random_seed)%bp_hiddens_in_layer(net,l);
-        net->hiddens[l][i]->excluded = 1;
+    if (retval != 0) {
+        bp_quant_free(net);
+        return retval;
     }
+    net->inference_precision = KERNEL_INT8;
+    return 0;
 }
 
 /**
-* @brief Update the neural net during training
+* @brief Sets the precision of the weights used by bp_infer, so that
+*        a quantised network can be compared against the float weights
 * @param net Backprop neural net object
+* @param precision KERNEL_FP32, or KERNEL_INT8 if the network has
+*        been quantised
+* @returns zero on success
 */
-void bp_update(bp * net, int current_hidden_layer)
+int bp_set_inference_precision(bp * net, int precision)
 {
-    bp_dropouts(net);
-    bp_feed_forward(net);
-    bp_backprop(net, current_hidden_layer);
-    bp_learn(net, current_hidden_layer);
-    bp_clear_dropouts(net);
+    int l;
+
+    if (precision == KERNEL_FP32) {
+        net->inference_precision = precision;
+        return 0;
+    }
+    if (precision != KERNEL_INT8) {
+        return -1;
+    }
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        if (net->layer[l].quant == 0) {
+            return -2;
+        }
+    }
+    net->inference_precision = precision;
+    return 0;
+}
+
+/**
+* @brief Deallocates any quantised weights, after which bp_infer
+*        uses the float weights
+* @param net Backprop neural net object
+*/
+void bp_quant_free(bp * net)
+{
+    int l;
+
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        bp_layer_quant_free(&net->layer[l]);
+    }
+    net->inference_precision = KERNEL_FP32;
 }
 
 /**
@@ -839,6 +3497,9 @@ void bp_update(bp * net, int current_hidden_layer)
 */
 int bp_save(FILE * fp, bp * net)
 {
+    if (bp_format_save(fp, BP_FILE_MAGIC, BP_FILE_VERSION) != 0) {
+        return -14;
+    }
     if (fwrite(&net->itterations, sizeof(unsigned int), 1, fp) == 0) {
         return -1;
     }
@@ -866,6 +3527,9 @@ int bp_save(FILE * fp, bp * net)
     if (fwrite(&net->DropoutPercent, sizeof(float), 1, fp) == 0) {
         return -9;
     }
+    if (fwrite(&net->activation, sizeof(int), 1, fp) == 0) {
+        return -10;
+    }
 
     for (int l = 0; l < net->HiddenLayers; l++) {
         for (int i = 0; i < bp_hiddens_in_layer(net,l); i++) {
@@ -876,6 +3540,30 @@ int bp_save(FILE * fp, bp * net)
         bp_neuron_save(fp,net->outputs[i]);
     }
 
+    /* the update rule, followed by any second moments */
+    if (optimiser_save(fp, &net->optimiser) != 0) {
+        return -11;
+    }
+    if (optimiser_second_moment(&net->optimiser)) {
+        for (int l = 1; l < net->HiddenLayers+2; l++) {
+            bp_layer * layer = &net->layer[l];
+
+            if ((fwrite(layer->moment2, sizeof(float),
+                        layer->NoOfUnits*layer->NoOfInputs, fp) == 0) ||
+                (fwrite(layer->bias_moment2, sizeof(float),
+                        layer->NoOfUnits, fp) == 0)) {
+                return -12;
+            }
+        }
+    }
+
+    /* which layers are frozen */
+    for (int l = 1; l < net->HiddenLayers+2; l++) {
+        if (fwrite(&net->layer[l].frozen, sizeof(unsigned char), 1, fp) == 0) {
+            return -13;
+        }
+    }
+
     return 0;
 }
 
@@ -894,8 +3582,15 @@ int bp_load(FILE * fp, bp * net,
     int hidden_layers=0;
     float learning_rate=0, noise=0, BPerrorAverage=0;
     float DropoutPercent=0;
+    int activation=AF_LOGISTIC;
     unsigned int itterations=0;
+    int version;
+    deeplearn_optimiser optimiser;
 
+    version = bp_format_load(fp, BP_FILE_MAGIC, BP_FILE_VERSION);
+    if (version < 0) {
+        return -17;
+    }
     retval = fread(&itterations, sizeof(unsigned int), 1, fp);
     if (retval == 0) {
         return -1;
@@ -932,23 +3627,59 @@ int bp_load(FILE * fp, bp * net,
     if (retval == 0) {
         return -9;
     }
+    if (version > 0) {
+        retval = fread(&activation, sizeof(int), 1, fp);
+        if ((retval == 0) || (activation < 0) ||
+            (activation >= AF_FUNCTIONS)) {
+            return -10;
+        }
+    }
 
     if (bp_init(net, no_of_inputs, no_of_hiddens,
                 hidden_layers, no_of_outputs,
                 random_seed) != 0) {
-        return -10;
+        return -11;
     }
 
     for (l = 0; l < net->HiddenLayers; l++) {
         for (i = 0; i < bp_hiddens_in_layer(net,l); i++) {
             if (bp_neuron_load(fp,net->hiddens[l][i]) != 0) {
-                return -11;
+                return -12;
             }
         }
     }
     for (i = 0; i < net->NoOfOutputs; i++) {
         if (bp_neuron_load(fp,net->outputs[i]) != 0) {
-            return -12;
+            return -13;
+        }
+    }
+
+    /* older files have the default optimiser and no frozen layers */
+    if (version > 0) {
+        if (optimiser_load(fp, &optimiser) != 0) {
+            return -14;
+        }
+        if (optimiser_second_moment(&optimiser)) {
+            for (l = 1; l < net->HiddenLayers+2; l++) {
+                bp_layer * layer = &net->layer[l];
+                size_t n = (size_t)layer->NoOfUnits*layer->NoOfInputs;
+
+                if ((bp_layer_moments_alloc(layer) != 0) ||
+                    (fread(layer->moment2, sizeof(float), n, fp) != n) ||
+                    (fread(layer->bias_moment2, sizeof(float),
+                           layer->NoOfUnits, fp) !=
+                     (size_t)layer->NoOfUnits)) {
+                    return -15;
+                }
+            }
+        }
+        net->optimiser = optimiser;
+
+        for (l = 1; l < net->HiddenLayers+2; l++) {
+            if (fread(&net->layer[l].frozen, sizeof(unsigned char),
+                      1, fp) == 0) {
+                return -16;
+            }
         }
     }
 
@@ -959,6 +3690,8 @@ int bp_load(FILE * fp, bp * net,
     net->BPerrorTotal = BPerrorAverage;
     net->itterations = itterations;
     net->DropoutPercent = DropoutPercent;
+    net->activation = activation;
+    bp_weights_changed(net);
 
     return 0;
 }
@@ -1012,6 +3745,14 @@ int bp_compare(bp * net1, bp * net2)
     if (net1->DropoutPercent!= net2->DropoutPercent) {
         return -10;
     }
+    if (net1->activation != net2->activation) {
+        return -11;
+    }
+    for (l = 1; l < net1->HiddenLayers+2; l++) {
+        if (net1->layer[l].frozen != net2->layer[l].frozen) {
+            return -12;
+        }
+    }
     return 1;
 }
 
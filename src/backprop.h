@@ -37,7 +37,171 @@
 #include "deeplearn_random.h"
 #include "deeplearn_images.h"
 #include "backprop_neuron.h"
+#include "deeplearn_kernels.h"
+#include "deeplearn_device.h"
 #include "encoding.h"
+#include "deeplearn_stats.h"
+#include "deeplearn_arena.h"
+#include "deeplearn_optimiser.h"
+#include "deeplearn_threads.h"
+
+/* layers with at least this many weights are evaluated in parallel */
+#define BP_PARALLEL_MIN_WEIGHTS 8192
+
+/* number of values after the layer gradients used by bp_batch_gradients
+   to record the error sum, error percentage sum and number of samples */
+#define BP_GRADIENT_STATS 3
+
+/* identifier and version at the start of a saved network.  Version 1
+   added the activation function, optimiser and frozen layers, which
+   take their defaults when loading older files */
+#define BP_FILE_MAGIC   "LIBDEEPB"
+#define BP_FILE_VERSION 1
+
+/* Live connections of a pruned layer in compressed sparse row form.
+   The live weights of unit i are values[row_start[i]] up to
+   values[row_start[i+1]-1], and column gives the index of the input
+   which feeds each of them.  The dense weights of the layer are kept
+   in step, with pruned connections set to zero */
+struct bp_sparse {
+    int nonzero;
+    int * row_start;
+    int * column;
+    float * values;
+};
+typedef struct bp_sparse bp_sparse;
+
+/* granularity of the scales used to quantise weights */
+#define BP_QUANT_PER_LAYER  0
+#define BP_QUANT_PER_UNIT   1
+
+/* Weights of a layer quantised to eight bits for inference.  Weight j
+   of unit i is approximately weights[i*NoOfInputs + j]*scale[i].
+   The inputs to the layer are quantised to unsigned eight bit values,
+   each input being approximately (q - input_zero)*input_scale, and
+   row_sum is the sum of each row of weights so that the zero point
+   can be taken out of the integer dot products */
+struct bp_quant {
+    int8_t * weights;
+    float * scale;
+    int32_t * row_sum;
+    float input_scale;
+    int input_zero;
+};
+typedef struct bp_quant bp_quant;
+
+/* inputs which differ from neutral are accumulated on their own only
+   when no more than this fraction of the inputs to a layer do */
+#define BP_NEUTRAL_MAX_CHANGED 0.25f
+
+/* Contribution of inputs equal to ENC_NEUTRAL, such as the padding of
+   text fields, folded into the biases of the first layer.  The weighted
+   sum of a unit is then bias[i] plus the weighted differences from
+   neutral of the few inputs which are not neutral.  The biases belong to
+   one generation of the weights of the network, and seen is the
+   generation at the previous feed forward.  changed and
+   delta list the inputs which differ from neutral */
+struct bp_neutral {
+    float * bias;
+    unsigned int generation;
+    unsigned int seen;
+    int * changed;
+    float * delta;
+};
+typedef struct bp_neutral bp_neutral;
+
+/* A layer of units stored contiguously.  The weights form a
+   row-major matrix with one row of NoOfInputs weights per unit,
+   and the activations and errors of the layer are held in
+   contiguous vectors so that the inner loops of training run
+   over packed arrays rather than following neuron pointers */
+struct bp_layer {
+    int NoOfUnits;
+    int NoOfInputs;
+    bp_neuron * units;
+    float * weights;
+    float * lastWeightChange;
+    float * values;
+    float * BPerror;
+
+    /* dropouts.  The mask is one for active units and zero for
+       units which have dropped out, and the indexes of the
+       NoOfActive active units are listed in active */
+    float * dropout_mask;
+    int * active;
+    int NoOfActive;
+
+    /* values and errors for each sample within a mini-batch,
+       stored one row per sample, together with the gradients
+       accumulated over the batch */
+    int batch_capacity;
+    float * batch_values;
+    float * batch_BPerror;
+    float * weight_gradient;
+    float * bias_gradient;
+
+    /* second moments of the weights and biases when the optimiser
+       needs them, otherwise NULL */
+    float * moment2;
+    float * bias_moment2;
+
+    /* live connections if the layer has been pruned, otherwise NULL */
+    bp_sparse * sparse;
+
+    /* eight bit weights if the layer has been quantised, otherwise NULL */
+    bp_quant * quant;
+
+    /* neutral inputs folded into the biases of the first layer,
+       otherwise NULL */
+    bp_neutral * neutral;
+
+    /* non-zero if training leaves the weights of the layer unchanged */
+    unsigned char frozen;
+};
+typedef struct bp_layer bp_layer;
+
+/* Scratch space used to evaluate a network without modifying it.
+   The network can be shared between threads as long as each thread
+   has its own inference context */
+struct bp_inference {
+    int batch_capacity;
+    int layer_capacity;
+    float * inputs;
+    float * values[2];
+
+    /* inputs of a layer quantised to eight bits */
+    uint8_t * quantised;
+
+    /* inputs of each sample which differ from neutral, if the
+       network has neutral inputs, otherwise NULL */
+    int * no_of_changed;
+    int * changed;
+    float * delta;
+};
+typedef struct bp_inference bp_inference;
+
+/* Copies of a network, one within the memory of each NUMA node, so
+   that inference threads read weights from local memory */
+struct bp_replicas {
+    int no_of_replicas;
+    struct backprop * source;
+    struct backprop * replica[THREADS_MAX_NODES];
+};
+typedef struct bp_replicas bp_replicas;
+
+/* Scratch space of a thread training a shared network asynchronously.
+   Each thread has its own activations, errors and dropouts, while the
+   weights of the network are updated in place without locks */
+struct bp_hogwild {
+    float ** values;
+    float ** BPerror;
+    float ** dropout_mask;
+    int ** active;
+    int * NoOfActive;
+    unsigned int random_seed;
+    deeplearn_arena arena;
+};
+typedef struct bp_hogwild bp_hogwild;
 
 struct backprop {
     int NoOfInputs,NoOfHiddens,NoOfOutputs;
@@ -46,6 +210,13 @@ struct backprop {
     bp_neuron ** inputs;
     bp_neuron *** hiddens;
     bp_neuron ** outputs;
+
+    /* input layer, followed by the hidden layers and then the
+       output layer */
+    bp_layer * layer;
+
+    /* memory holding the layers, units and weights */
+    deeplearn_arena arena;
     float BPerrorTotal;
     float BPerror, BPerrorAverage;
     float BPerrorPercent;
@@ -53,6 +224,22 @@ struct backprop {
     float noise;
     unsigned int random_seed;
     unsigned int itterations;
+
+    /* activation function of the hidden layers, such as AF_RELU.
+       The output layer always uses the logistic function, since
+       outputs are encoded within the range 0.25 -> 0.75 */
+    int activation;
+
+    /* precision of the weights used by bp_infer, which is KERNEL_FP32
+       unless the network has been quantised to KERNEL_INT8 */
+    int inference_precision;
+
+    /* rule used to update the weights, such as OPTIMISER_ADAM */
+    deeplearn_optimiser optimiser;
+
+    /* generation of the weights and biases from device_weights_changed,
+       which changes whenever they are updated, loaded or copied */
+    unsigned int generation;
 };
 typedef struct backprop bp;
 
@@ -63,8 +250,19 @@ int bp_init(bp * net,
             int no_of_outputs,
             unsigned int * random_seed);
 void bp_free(bp * net);
+void bp_memory_usage(bp * net, deeplearn_footprint * usage);
+void bp_trim_memory(bp * net);
+int bp_clone(bp * dest, bp * source);
+void bp_weights_changed(bp * net);
+int bp_copy_weights(bp * dest, bp * source);
+int bp_set_activation(bp * net, int function);
+int bp_set_optimiser(bp * net, int type);
+int bp_freeze_layer(bp * net, int layer, int frozen);
+int bp_frozen_layers(bp * net);
+int bp_set_neutral_inputs(bp * net, unsigned char enabled);
 void bp_feed_forward(bp * net);
 void bp_feed_forward_layers(bp * net, int layers);
+void bp_feed_forward_layer(bp * net, int index);
 void bp_backprop(bp * net, int current_hidden_layer);
 void bp_learn(bp * net, int current_hidden_layer);
 void bp_set_input_text(bp * net, char * text);
@@ -73,6 +271,23 @@ void bp_set_output(bp * net, int index, float value);
 float bp_get_hidden(bp * net, int layer, int index);
 float bp_get_output(bp * net, int index);
 void bp_update(bp * net, int current_hidden_layer);
+int bp_update_batch(bp * net, float * inputs, float * targets,
+                    int batch_size, int current_hidden_layer);
+int bp_update_hogwild(bp * net, float * inputs, float * targets,
+                      int no_of_samples, int no_of_threads);
+int bp_gradients_length(bp * net);
+int bp_batch_gradients(bp * net, float * inputs, float * targets,
+                       int batch_size, int current_hidden_layer,
+                       float * gradients);
+int bp_apply_gradients(bp * net, float * gradients,
+                       int current_hidden_layer);
+int bp_inference_init(bp_inference * ctx, bp * net, int batch_capacity);
+void bp_inference_free(bp_inference * ctx);
+int bp_replicas_init(bp_replicas * replicas, bp * net);
+bp * bp_replicas_local(bp_replicas * replicas, bp * net);
+void bp_replicas_free(bp_replicas * replicas);
+int bp_infer(bp * net, bp_inference * ctx,
+             float * inputs, float * outputs, int batch_size);
 int bp_save(FILE * fp, bp * net);
 int bp_load(FILE * fp, bp * net,
             unsigned int * random_seed);
@@ -94,6 +309,12 @@ int bp_classifications_to_numbers(int no_of_instances,
                                   char ** instance_classification,
                                   int * numbers);
 int bp_hiddens_in_layer(bp * net, int layer);
+int bp_prune(bp * net, float fraction);
+void bp_sparse_free(bp * net);
+float bp_sparsity(bp * net);
+int bp_quantise(bp * net, int granularity, float * inputs, int samples);
+int bp_set_inference_precision(bp * net, int precision);
+void bp_quant_free(bp * net);
 void bp_reproject(bp * net, int layer, int neuron_index);
 void bp_normalise_inputs(bp * net);
 float bp_get_input(bp * net, int index);
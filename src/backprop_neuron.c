@@ -90,44 +90,80 @@ void bp_neuron_copy(bp_neuron * source,
 }
 
 /**
-* @brief Initialises the neuron
+* @brief Initialises a neuron whose weights are stored externally,
+*        for example within the weight matrix of a layer
 * @param n Backprop neuron object
 * @param no_of_inputs The number of input connections
+* @param weights Array of no_of_inputs weights
+* @param lastWeightChange Array of no_of_inputs previous weight changes
+* @param inputs Array of no_of_inputs pointers to input neurons
 * @param random_seed Random number generator seed
+* @returns zero on success
 */
-int bp_neuron_init(bp_neuron * n,
-                   int no_of_inputs,
-                   unsigned int * random_seed)
+int bp_neuron_init_packed(bp_neuron * n,
+                          int no_of_inputs,
+                          float * weights,
+                          float * lastWeightChange,
+                          struct bp_n ** inputs,
+                          unsigned int * random_seed)
 {
     /* should have more than zero inpyts */
     assert(no_of_inputs > 0);
 
     n->NoOfInputs = no_of_inputs;
-
-    /* create some weights */
-    n->weights = (float*)malloc(no_of_inputs*sizeof(float));
-    if (!n->weights) {
-        return -1;
-    }
-    n->lastWeightChange = (float*)malloc(no_of_inputs*sizeof(float));
-    if (!n->lastWeightChange) {
-        return -2;
-    }
+    n->weights = weights;
+    n->lastWeightChange = lastWeightChange;
 
     bp_neuron_init_weights(n, random_seed);
     n->desiredValue = -1;
     n->value = 0;
     n->value_reprojected = 0;
     n->BPerror = 0;
-    n->excluded = 0;
 
     /* pointers to input neurons */
-    n->inputs = (struct bp_n **)malloc(no_of_inputs*
-                                       sizeof(struct bp_n *));
-    if (!n->inputs) {
+    n->inputs = inputs;
+    memset(n->inputs,'\0',no_of_inputs*sizeof(struct bp_n *));
+    return 0;
+}
+
+/**
+* @brief Initialises the neuron
+* @param n Backprop neuron object
+* @param no_of_inputs The number of input connections
+* @param random_seed Random number generator seed
+*/
+int bp_neuron_init(bp_neuron * n,
+                   int no_of_inputs,
+                   unsigned int * random_seed)
+{
+    float * weights, * lastWeightChange;
+    struct bp_n ** inputs;
+
+    /* should have more than zero inpyts */
+    assert(no_of_inputs > 0);
+
+    /* create some weights */
+    weights = (float*)malloc(no_of_inputs*sizeof(float));
+    if (!weights) {
+        return -1;
+    }
+    lastWeightChange = (float*)malloc(no_of_inputs*sizeof(float));
+    if (!lastWeightChange) {
+        free(weights);
+        return -2;
+    }
+    inputs = (struct bp_n **)malloc(no_of_inputs*sizeof(struct bp_n *));
+    if (!inputs) {
+        free(weights);
+        free(lastWeightChange);
         return -3;
     }
-    memset(n->inputs,'\0',no_of_inputs*sizeof(struct bp_n *));
+
+    if (bp_neuron_init_packed(n, no_of_inputs,
+                              weights, lastWeightChange, inputs,
+                              random_seed) != 0) {
+        return -4;
+    }
     return 0;
 }
 
@@ -156,25 +192,29 @@ int bp_neuron_compare(bp_neuron * n1, bp_neuron * n2)
     return 1;
 }
 
+/**
+* @brief Detaches a neuron whose weights and input pointers are stored
+*        externally.  The arrays themselves are not freed.
+* @param n Backprop neuron object
+*/
+void bp_neuron_free_packed(bp_neuron * n)
+{
+    n->inputs = 0;
+    n->weights = 0;
+    n->lastWeightChange = 0;
+}
+
 /**
 * @brief Deallocates memory for a neuron
 * @param n Backprop neuron object
 */
 void bp_neuron_free(bp_neuron * n)
 {
-    int i;
-
-    /* free the weights */
     free(n->weights);
     free(n->lastWeightChange);
-
-    /* clear the pointers to input neurons */
-    for (i = 0; i < n->NoOfInputs; i++) {
-        n->inputs[i]=0;
-    }
-
-    /* free the inputs */
     free(n->inputs);
+
+    bp_neuron_free_packed(n);
 }
 
 /**
@@ -213,12 +253,6 @@ void bp_neuron_feedForward(bp_neuron * n,
     float adder;
     int i;
 
-    /* if the neuron has dropped out then set its output to zero */
-    if (n->excluded > 0) {
-        n->value = 0;
-        return;
-    }
-
     /* Sum with initial bias */
     adder = n->bias;
 
@@ -249,9 +283,6 @@ void bp_neuron_backprop(bp_neuron * n)
     bp_neuron * nrn;
     float afact;
 
-    /* if the neuron has dropped out then don't continue */
-    if (n->excluded > 0) return;
-
     if (n->desiredValue > -1) {
         /* output unit */
         n->BPerror = n->desiredValue - n->value;
@@ -299,8 +330,6 @@ void bp_neuron_learn(bp_neuron * n,
     int i;
     float afact,e,gradient;
 
-    if (n->excluded > 0) return;
-
     e = learningRate / (1.0f + n->NoOfInputs);
     afact = af(n->value);
     gradient = afact * n->BPerror;
@@ -468,7 +497,60 @@ int bp_neuron_load(FILE * fp, bp_neuron * n)
 
     n->value = 0;
     n->BPerror = 0;
-    n->excluded = 0;
 
     return 0;
 }
+
+/**
+* @brief Writes the identifier and version which begin a saved object
+* @param fp File pointer
+* @param magic Eight character identifier of the type of object
+* @param version Version of the format
+* @return zero value on success
+*/
+int bp_format_save(FILE * fp, const char * magic, int version)
+{
+    if (fwrite(magic, sizeof(char), 8, fp) != 8) {
+        return -1;
+    }
+    if (fwrite(&version, sizeof(int), 1, fp) == 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+* @brief Reads the identifier and version which begin a saved object.
+*        Files saved before the format was versioned begin directly
+*        with their data, in which case nothing is consumed and
+*        version zero is returned.
+* @param fp File pointer
+* @param magic Eight character identifier of the type of object
+* @param latest The most recent version of the format
+* @return version of the format, or negative on error
+*/
+int bp_format_load(FILE * fp, const char * magic, int latest)
+{
+    char identifier[8];
+    int version = 0;
+
+    if (fread(identifier, sizeof(char), 8, fp) != 8) {
+        return -1;
+    }
+    if (memcmp(identifier, magic, 8) != 0) {
+        /* another kind of object, since identifiers only differ
+           in their last character */
+        if (memcmp(identifier, magic, 7) == 0) {
+            return -2;
+        }
+        if (fseek(fp, -8L, SEEK_CUR) != 0) {
+            return -3;
+        }
+        return 0;
+    }
+    if ((fread(&version, sizeof(int), 1, fp) == 0) ||
+        (version < 1) || (version > latest)) {
+        return -4;
+    }
+    return version;
+}
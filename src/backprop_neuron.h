@@ -50,7 +50,6 @@ struct bp_n {
     float bias;
     float lastBiasChange;
     float BPerror;
-    int excluded;
 
     float value;
     float value_reprojected;
@@ -61,6 +60,12 @@ typedef struct bp_n bp_neuron;
 int bp_neuron_init(bp_neuron * n,
                    int no_of_inputs,
                    unsigned int * random_seed);
+int bp_neuron_init_packed(bp_neuron * n,
+                          int no_of_inputs,
+                          float * weights,
+                          float * lastWeightChange,
+                          struct bp_n ** inputs,
+                          unsigned int * random_seed);
 void bp_neuron_add_connection(bp_neuron * dest,
                               int index, bp_neuron * source);
 void bp_neuron_feedForward(bp_neuron * n,
@@ -70,10 +75,13 @@ void bp_neuron_backprop(bp_neuron * n);
 void bp_neuron_learn(bp_neuron * n,
                      float learningRate);
 void bp_neuron_free(bp_neuron * n);
+void bp_neuron_free_packed(bp_neuron * n);
 void bp_neuron_copy(bp_neuron * source,
                     bp_neuron * dest);
 int bp_neuron_save(FILE * fp, bp_neuron * n);
 int bp_neuron_load(FILE * fp, bp_neuron * n);
+int bp_format_save(FILE * fp, const char * magic, int version);
+int bp_format_load(FILE * fp, const char * magic, int latest);
 int bp_neuron_compare(bp_neuron * n1, bp_neuron * n2);
 void bp_neuron_fix_weights(bp_neuron * n);
 void bp_neuron_reproject(bp_neuron * n);
@@ -36,6 +36,14 @@
 
 #include "deepconvnet.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define CONV_CACHE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 /**
  * @brief Initialise a deep convnet
  * @param no_of_convolutions Number of layers in the convolution
@@ -96,6 +104,7 @@ int deepconvnet_init(int no_of_convolutions,
     convnet->images = NULL;
     convnet->classifications = NULL;
     convnet->classification_number = NULL;
+    convnet->image_cache = NULL;
 
     /* clear history */
     convnet->history_index = 0;
@@ -107,11 +116,18 @@ int deepconvnet_init(int no_of_convolutions,
     convnet->training_ctr = 0;
     convnet->history_plot_interval = 30;
     sprintf(convnet->history_plot_filename,"%s","training.png");
+    convnet->history_plotter = NULL;
     sprintf(convnet->history_plot_title,"%s","Training History");
 
     convnet->current_layer = 0;
     convnet->training_set_index = NULL;
     convnet->test_set_index = NULL;
+    convnet->training_images = 0;
+    convnet->test_images = 0;
+    deeplearn_epoch_init(&convnet->epoch, 0);
+    memset((void*)&convnet->prefetch, '\0', sizeof(deeplearn_prefetch));
+    memset((void*)&convnet->conv_cache, '\0', sizeof(deepconvnet_conv_cache));
+    convnet->stream = NULL;
     return 0;
 }
 
@@ -132,12 +148,25 @@ int deepconvnet_is_training(deepconvnet * convnet)
  */
 void deepconvnet_free(deepconvnet * convnet)
 {
+    /* the worker uses the convolution and the images */
+    deeplearn_prefetch_free(&convnet->prefetch);
+    deepconvnet_set_conv_cache(convnet, 0, NULL);
+
     conv_free(convnet->convolution);
     free(convnet->convolution);
 
     deeplearn_free(convnet->learner);
     free(convnet->learner);
 
+    if (convnet->image_cache != NULL) {
+        /* images and labels belong to the cache */
+        free(convnet->images);
+        deeplearn_image_cache_close(convnet->image_cache);
+        free(convnet->image_cache);
+        convnet->image_cache = NULL;
+        convnet->no_of_images = 0;
+    }
+
     if (convnet->no_of_images > 0) {
         for (int i = 0; i < convnet->no_of_images; i++) {
             if (convnet->images[i] != NULL) {
@@ -160,6 +189,135 @@ void deepconvnet_free(deepconvnet * convnet)
     }
 }
 
+/**
+ * @brief Returns the memory used by a deep convnet, including its
+ *        convolution layers, deep learner, images and caches.  Images
+ *        and convolution outputs within memory mapped files are not
+ *        counted.
+ * @param convnet Deep convnet object
+ * @param usage Returned memory footprint
+ */
+void deepconvnet_memory_usage(deepconvnet * convnet,
+                              deeplearn_footprint * usage)
+{
+    deeplearn_footprint part;
+    deepconvnet_conv_cache * cache = &convnet->conv_cache;
+    size_t bytes = 0;
+
+    deeplearn_footprint_clear(usage);
+    usage->history = sizeof(convnet->history) +
+        sizeof(convnet->history_plot_filename) +
+        sizeof(convnet->history_plot_title);
+    usage->other = sizeof(deepconvnet) - usage->history;
+
+    if (convnet->convolution != NULL) {
+        conv_memory_usage(convnet->convolution, &part);
+        deeplearn_footprint_add(usage, &part);
+    }
+    if (convnet->learner != NULL) {
+        deeplearn_memory_usage(convnet->learner, &part);
+        deeplearn_footprint_add(usage, &part);
+    }
+
+    /* images */
+    if (convnet->image_cache != NULL) {
+        bytes += sizeof(deeplearn_image_cache) +
+            (size_t)convnet->no_of_images*
+            (sizeof(unsigned char*) + sizeof(int) + sizeof(char*));
+        if (convnet->image_cache->mapped == 0) {
+            bytes += convnet->image_cache->size;
+        }
+    }
+    else if ((convnet->no_of_images > 0) && (convnet->images != NULL)) {
+        size_t pixels = (size_t)convnet->convolution->inputs_across*
+            convnet->convolution->inputs_down;
+
+        bytes += (size_t)convnet->no_of_images*
+            (sizeof(unsigned char*) + sizeof(int) + sizeof(char*));
+        for (int i = 0; i < convnet->no_of_images; i++) {
+            if (convnet->images[i] != NULL) {
+                bytes += pixels;
+            }
+            if (convnet->classifications[i] != NULL) {
+                bytes += strlen(convnet->classifications[i]) + 1;
+            }
+        }
+    }
+    if (convnet->training_set_index != NULL) {
+        bytes += (size_t)convnet->no_of_images*sizeof(int);
+    }
+    if (convnet->test_set_index != NULL) {
+        bytes += (size_t)convnet->no_of_images*sizeof(int);
+    }
+
+    /* convolution outputs */
+    bytes += deeplearn_prefetch_allocated(&convnet->prefetch);
+    if ((cache->allocation != NULL) && (cache->mapped == 0)) {
+        if (cache->size > 0) {
+            bytes += cache->size;
+        }
+        else {
+            bytes += (size_t)cache->no_of_images*cache->no_of_outputs*
+                sizeof(float);
+        }
+    }
+    usage->datasets += bytes;
+}
+
+/**
+ * @brief Frees buffers of a deep convnet which are only needed to speed
+ *        up training, and which are built again when next needed
+ * @param convnet Deep convnet object
+ */
+void deepconvnet_trim_memory(deepconvnet * convnet)
+{
+    if (convnet->learner != NULL) {
+        deeplearn_trim_memory(convnet->learner);
+    }
+}
+
+/**
+ * @brief Makes an independent copy of a deep convnet, for example as a
+ *        replica for serving on another thread.  The images, training
+ *        and test sets and caches stay with the source.
+ * @param dest Deep convnet object to be created
+ * @param source Deep convnet object to be copied
+ * @returns zero on success
+ */
+int deepconvnet_clone(deepconvnet * dest, deepconvnet * source)
+{
+    *dest = *source;
+
+    dest->no_of_images = 0;
+    dest->images = NULL;
+    dest->classifications = NULL;
+    dest->classification_number = NULL;
+    dest->image_cache = NULL;
+    dest->training_set_index = NULL;
+    dest->test_set_index = NULL;
+    dest->training_images = 0;
+    dest->test_images = 0;
+    dest->history_plotter = NULL;
+    dest->stream = NULL;
+    memset((void*)&dest->prefetch, '\0', sizeof(deeplearn_prefetch));
+    memset((void*)&dest->conv_cache, '\0', sizeof(deepconvnet_conv_cache));
+
+    dest->convolution = (deeplearn_conv*)malloc(sizeof(deeplearn_conv));
+    if (!dest->convolution) return -1;
+    if (conv_clone(dest->convolution, source->convolution) != 0) {
+        free(dest->convolution);
+        return -2;
+    }
+
+    dest->learner = (deeplearn*)malloc(sizeof(deeplearn));
+    if (!dest->learner) return -3;
+    if (deeplearn_clone(dest->learner, source->learner) != 0) {
+        free(dest->learner);
+        return -4;
+    }
+    return 0;
+}
+
 /**
  * @brief Update the learning history
  * @param convnet Deep convnet object
@@ -221,6 +379,8 @@ int deepconvnet_save(FILE * fp, deepconvnet * convnet)
 int deepconvnet_load(FILE * fp, deepconvnet * convnet,
                      unsigned int * random_seed)
 {
+    /* cached outputs belong to the previous convolution layers */
+    convnet->conv_cache.valid = 0;
     if (conv_load(fp, convnet->convolution) != 0) return -1;
     if (deeplearn_load(fp, convnet->learner, random_seed) != 0) {
         return -2;
@@ -292,7 +452,18 @@ static void deepconvnet_update_training_plot(deepconvnet * convnet)
     if (convnet->history_plot_interval > 0) {
         if (convnet->training_ctr > convnet->history_plot_interval) {
             if (strlen(convnet->history_plot_filename) > 0) {
-                deepconvnet_plot_history(convnet, 1024, 480);
+                if (convnet->history_plotter != NULL) {
+                    deeplearn_history_plotter_post(convnet->history_plotter,
+                                                   convnet->history,
+                                                   convnet->history_index,
+                                                   convnet->history_step,
+                                                   convnet->history_plot_filename,
+                                                   convnet->history_plot_title,
+                                                   1024, 480);
+                }
+                else {
+                    deepconvnet_plot_history(convnet, 1024, 480);
+                }
             }
             convnet->training_ctr = 0;
         }
@@ -324,7 +495,9 @@ int deepconvnet_update_img(deepconvnet * convnet, unsigned char img[],
                            int class_number)
 {
     unsigned char use_dropouts = 0;
+    DEEPLEARN_STATS_START(start_time);
 
+    deeplearn_prefetch_drain(&convnet->prefetch);
     if (deepconvnet_is_training(convnet)) use_dropouts = 1;
 
     if (conv_img(img, convnet->convolution, use_dropouts) != 0) {
@@ -333,6 +506,8 @@ int deepconvnet_update_img(deepconvnet * convnet, unsigned char img[],
 
     if (convnet->convolution->training_complete == 0) {
         deepconvnet_update(convnet);
+        DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_UPDATE_IMAGE, 0);
+        DEEPLEARN_STATS_IMAGES(1);
         return 0;
     }
 
@@ -352,6 +527,8 @@ int deepconvnet_update_img(deepconvnet * convnet, unsigned char img[],
         /* feed forward only */
         deeplearn_feed_forward(convnet->learner);
     }
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_UPDATE_IMAGE, 0);
+    DEEPLEARN_STATS_IMAGES(1);
     return 0;
 }
 
@@ -365,6 +542,7 @@ int deepconvnet_test_img(deepconvnet * convnet, unsigned char img[])
 {
     const unsigned char use_dropouts = 0;
 
+    deeplearn_prefetch_drain(&convnet->prefetch);
     if (conv_img(img, convnet->convolution, use_dropouts) != 0) {
         return -1;
     }
@@ -422,250 +600,1815 @@ int deepconvnet_get_class(deepconvnet * convnet)
 }
 
 /**
- * @brief Sets the learning rate
- * @param convnet Deep convnet object
- * @param rate the learning rate in the range 0.0 to 1.0
+ * @brief Loads a convnet saved with deepconvnet_save for classification
+ *        only. The deep layers are read as a frozen model, so their
+ *        momentum terms, pretraining autocoders and training history
+ *        are never allocated.
+ * @param fp File pointer
+ * @param convnet Returned convnet, freed with deepconvnet_model_free
+ * @returns zero on success
  */
-void deepconvnet_set_learning_rate(deepconvnet * convnet, float rate)
+int deepconvnet_model_load(FILE * fp, deepconvnet_model * convnet)
 {
-    conv_set_learning_rate(convnet->convolution, rate);
-    deeplearn_set_learning_rate(convnet->learner, rate);
+    int conv_outputs;
+
+    memset((void*)convnet, '\0', sizeof(deepconvnet_model));
+
+    convnet->convolution =
+        (deeplearn_conv*)malloc(sizeof(deeplearn_conv));
+    if (!convnet->convolution) {
+        return -1;
+    }
+    memset((void*)convnet->convolution, '\0', sizeof(deeplearn_conv));
+    if (conv_load(fp, convnet->convolution) != 0) {
+        free(convnet->convolution);
+        convnet->convolution = NULL;
+        return -2;
+    }
+
+    if (model_load_deeplearn(fp, &convnet->model) != 0) {
+        deepconvnet_model_free(convnet);
+        return -3;
+    }
+
+    /* convolution outputs are used directly as unit values, and
+       classes are the output unit with the largest value */
+    convnet->model.input_range = NULL;
+    convnet->model.output_range = NULL;
+
+    conv_outputs =
+        conv_output_width(convnet->convolution) *
+        conv_output_height(convnet->convolution) *
+        conv_layer_features(convnet->convolution,
+                            convnet->convolution->no_of_layers-1);
+    if (convnet->model.network->NoOfInputs != conv_outputs) {
+        deepconvnet_model_free(convnet);
+        return -4;
+    }
+
+    if (model_inference_init(&convnet->model, &convnet->ctx, 1) != 0) {
+        deepconvnet_model_free(convnet);
+        return -5;
+    }
+    convnet->outputs =
+        (float*)malloc(convnet->model.network->NoOfOutputs*sizeof(float));
+    if (!convnet->outputs) {
+        deepconvnet_model_free(convnet);
+        return -6;
+    }
+    memset((void*)convnet->outputs, '\0',
+           convnet->model.network->NoOfOutputs*sizeof(float));
+    return 0;
 }
 
 /**
- * @brief Sets the percentage of units which drop out during training
- * @param convnet Deep convnet object
- * @param dropout_percent Percentage of units which drop out in the range 0 to 100
+ * @brief Frees a convnet loaded with deepconvnet_model_load
+ * @param convnet Convnet object
  */
-void deepconvnet_set_dropouts(deepconvnet * convnet, float dropout_percent)
+void deepconvnet_model_free(deepconvnet_model * convnet)
 {
-    conv_set_dropouts(convnet->convolution, dropout_percent);
-    deeplearn_set_dropouts(convnet->learner, dropout_percent);
+    if (convnet->convolution) {
+        conv_free(convnet->convolution);
+        free(convnet->convolution);
+    }
+    if (convnet->model.network) {
+        bp_inference_free(&convnet->ctx);
+        model_close(&convnet->model);
+    }
+    free(convnet->outputs);
+    memset((void*)convnet, '\0', sizeof(deepconvnet_model));
 }
 
 /**
- * @brief Uses gnuplot to plot the training error for the given learner
- * @param convnet Deep convnet object
- * @param filename Filename for the image to save as
- * @param title Title of the graph
- * @param image_width Width of the image in pixels
- * @param image_height Height of the image in pixels
- * @return zero on success
+ * @brief Classifies an image using a convnet loaded for inference
+ * @param convnet Convnet object
+ * @param img Image to be classified
+ * @returns zero on success
  */
-int deepconvnet_plot_history(deepconvnet * convnet,
-                             int image_width, int image_height)
+int deepconvnet_model_test_img(deepconvnet_model * convnet,
+                               unsigned char img[])
 {
-    int index,retval=0;
-    FILE * fp;
-    char data_filename[256];
-    char plot_filename[256];
-    char command_str[256];
-    float value;
-    float max_value = 0.01f;
-
-    sprintf(data_filename,"%s%s",DEEPLEARN_TEMP_DIRECTORY,
-            "libdeep_data.dat");
-    sprintf(plot_filename,"%s%s",DEEPLEARN_TEMP_DIRECTORY,
-            "libdeep_data.plot");
-
-    /* save the data */
-    fp = fopen(data_filename,"w");
-    if (!fp) return -1;
-    for (index = 0; index < convnet->history_index; index++) {
-        value = convnet->history[index];
-        fprintf(fp,"%d    %.10f\n",
-                index*convnet->history_step,value);
-        /* record the maximum error value */
-        if (value > max_value) {
-            max_value = value;
+    const unsigned char use_dropouts = 0;
+    int i;
+
+    if (conv_img(img, convnet->convolution, use_dropouts) != 0) {
+        return -1;
+    }
+    for (i = 0; i < convnet->model.network->NoOfInputs; i++) {
+        convnet->ctx.inputs[i] = get_conv_output(convnet->convolution, i);
+    }
+    if (model_infer(&convnet->model, &convnet->ctx, convnet->ctx.inputs,
+                    convnet->outputs, 1) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns an output unit value for the most recent image
+ * @param convnet Convnet object
+ * @param index Index of the output unit
+ * @returns output unit value
+ */
+float deepconvnet_model_get_output(deepconvnet_model * convnet, int index)
+{
+    return convnet->outputs[index];
+}
+
+/**
+ * @brief Returns the class of the most recent image
+ * @param convnet Convnet object
+ * @returns class number
+ */
+int deepconvnet_model_get_class(deepconvnet_model * convnet)
+{
+    int i, class = -9999;
+    float max = -1;
+
+    for (i = 0; i < convnet->model.network->NoOfOutputs; i++) {
+        if (convnet->outputs[i] > max) {
+            max = convnet->outputs[i];
+            class = i;
         }
     }
-    fclose(fp);
+    return class;
+}
 
-    /* create a plot file */
-    fp = fopen(plot_filename,"w");
-    if (!fp) return -1;
-    fprintf(fp,"%s","reset\n");
-    fprintf(fp,"set title \"%s\"\n",convnet->history_plot_title);
-    fprintf(fp,"set xrange [0:%d]\n",
-            convnet->history_index * convnet->history_step);
-    fprintf(fp,"set yrange [0:%f]\n", max_value*102/100);
-    fprintf(fp,"%s","set lmargin 9\n");
-    fprintf(fp,"%s","set rmargin 2\n");
-    fprintf(fp,"%s","set xlabel \"Time Step\"\n");
-    fprintf(fp,"%s","set ylabel \"Training Error Percent\"\n");
-
-    fprintf(fp,"%s","set grid\n");
-    fprintf(fp,"%s","set key right top\n");
-
-    fprintf(fp,"set terminal png size %d,%d\n",
-            image_width, image_height);
-    fprintf(fp,"set output \"%s\"\n", convnet->history_plot_filename);
-    fprintf(fp,"plot \"%s\" using 1:2 notitle with lines\n",
-            data_filename);
-    fclose(fp);
+/**
+ * @brief Creates a set of heads sharing one convolution trunk. The trunk
+ *        is a copy of the convolution layers of the given convnet, and
+ *        its deep learner becomes the first head.
+ * @param heads Returned heads object, freed with deepconvnet_heads_free
+ * @param convnet Deep convnet object providing the trunk
+ * @returns zero on success
+ */
+int deepconvnet_heads_init(deepconvnet_heads * heads, deepconvnet * convnet)
+{
+    memset((void*)heads, '\0', sizeof(deepconvnet_heads));
 
-    /* run gnuplot using the created files */
-    sprintf(command_str,"gnuplot %s", plot_filename);
-    retval = system(command_str); /* I assume this is synchronous */
+    /* the convolution is in use by the prefetch worker */
+    deeplearn_prefetch_drain(&convnet->prefetch);
 
-    /* remove temporary files */
-    sprintf(command_str,"rm %s %s", data_filename, plot_filename);
-    retval = system(command_str);
+    heads->convolution = (deeplearn_conv*)malloc(sizeof(deeplearn_conv));
+    if (!heads->convolution) {
+        return -1;
+    }
+    if (conv_clone(heads->convolution, convnet->convolution) != 0) {
+        free(heads->convolution);
+        heads->convolution = NULL;
+        return -2;
+    }
 
-    return retval;
+    if (deepconvnet_heads_add(heads, convnet) != 0) {
+        deepconvnet_heads_free(heads);
+        return -3;
+    }
+    return 0;
 }
 
 /**
- * @brief Performs training
- * @param convnet Deep convnet object
+ * @brief Frees memory for a set of heads
+ * @param heads Heads object
  */
-int deepconvnet_training(deepconvnet * convnet)
+void deepconvnet_heads_free(deepconvnet_heads * heads)
 {
-    if (convnet->learner->training_complete != 0) return 0;
-    if (convnet->no_of_images == 0) return 0;
-    if (convnet->classification_number == NULL) return -1;
+    for (int i = 0; i < heads->no_of_heads; i++) {
+        deeplearn_free(heads->head[i]);
+        free(heads->head[i]);
+    }
+    if (heads->convolution) {
+        conv_free(heads->convolution);
+        free(heads->convolution);
+    }
+    memset((void*)heads, '\0', sizeof(deepconvnet_heads));
+}
 
-    /* pick an image at random */
-    int training_images = convnet->no_of_images*8/10;
-    int index0 =
-        rand_num(&convnet->learner->net->random_seed)%training_images;
-    int index = convnet->training_set_index[index0];
-    unsigned char * img = convnet->images[index];
-    if (deepconvnet_update_img(convnet, img,
-                               convnet->classification_number[index]) != 0) {
+/**
+ * @brief Appends a deep learner to the heads, taking ownership of it
+ * @param heads Heads object
+ * @param learner Deep learner whose inputs are the trunk outputs
+ * @returns index of the new head, or a negative value on error
+ */
+static int deepconvnet_heads_append(deepconvnet_heads * heads,
+                                    deeplearn * learner)
+{
+    if (learner->net->NoOfInputs != conv_outputs(heads->convolution)) {
+        return -1;
+    }
+    heads->head[heads->no_of_heads] = learner;
+    return heads->no_of_heads++;
+}
+
+/**
+ * @brief Adds a copy of the deep learner of a convnet as a new head.
+ *        The convolution layers of the convnet should be the same as
+ *        the trunk, or close to it, since the head is given the outputs
+ *        of the trunk rather than of its own convolution layers.
+ * @param heads Heads object
+ * @param convnet Deep convnet object whose deep learner is copied
+ * @returns index of the new head, or a negative value on error
+ */
+int deepconvnet_heads_add(deepconvnet_heads * heads, deepconvnet * convnet)
+{
+    deeplearn_conv * trunk = heads->convolution;
+    deeplearn_conv * conv = convnet->convolution;
+    deeplearn * learner;
+    int index;
+
+    if (heads->no_of_heads >= DEEPCONVNET_MAX_HEADS) return -1;
+    if ((conv->inputs_across != trunk->inputs_across) ||
+        (conv->inputs_down != trunk->inputs_down) ||
+        (conv->inputs_depth != trunk->inputs_depth)) {
         return -2;
     }
 
-    return 0;
+    learner = (deeplearn*)malloc(sizeof(deeplearn));
+    if (!learner) return -3;
+    if (deeplearn_clone(learner, convnet->learner) != 0) {
+        free(learner);
+        return -4;
+    }
+
+    index = deepconvnet_heads_append(heads, learner);
+    if (index < 0) {
+        deeplearn_free(learner);
+        free(learner);
+        return -5;
+    }
+    return index;
 }
 
 /**
- * @brief Returns performance on the test set
- * @param convnet Deep convnet object
- * @return Percentage of correct classifications or a negative number on error
+ * @brief Adds a new untrained head whose inputs are the trunk outputs
+ * @param heads Heads object
+ * @param no_of_deep_layers Number of layers in the deep learner
+ * @param no_of_outputs Number of outputs of the deep learner
+ * @param error_threshold Array containing learning thresholds (percent
+ *        error) for each layer of the deep learner
+ * @param random_seed Random number generator seed
+ * @returns index of the new head, or a negative value on error
  */
-float deepconvnet_get_performance(deepconvnet * convnet)
+int deepconvnet_heads_add_learner(deepconvnet_heads * heads,
+                                  int no_of_deep_layers,
+                                  int no_of_outputs,
+                                  float error_threshold[],
+                                  unsigned int * random_seed)
 {
-    float performance = 0;
-    int ctr = 0;
-    int test_images = convnet->no_of_images*2/10;
+    deeplearn * learner;
+    int index;
 
-    if (convnet->no_of_images == 0) return -1;
-    if (convnet->classification_number == NULL) return -2;
+    if (heads->no_of_heads >= DEEPCONVNET_MAX_HEADS) return -1;
 
-    for (int i = 0; i < test_images; i++) {
-        int index = convnet->test_set_index[i];
-        unsigned char * img = convnet->images[index];
-        deepconvnet_update_img(convnet, img, -1);
-        if (deeplearn_get_class(convnet->learner) ==
-            convnet->classification_number[index]) {
-            performance += 100.0f;
-        }
-        ctr++;
+    learner = (deeplearn*)malloc(sizeof(deeplearn));
+    if (!learner) return -2;
+    if (deeplearn_init(learner,
+                       conv_outputs(heads->convolution),
+                       conv_outputs(heads->convolution)*8/10,
+                       no_of_deep_layers,
+                       no_of_outputs,
+                       error_threshold,
+                       random_seed) != 0) {
+        free(learner);
+        return -3;
     }
-    if (ctr > 0) {
-        performance /= ctr;
+
+    index = deepconvnet_heads_append(heads, learner);
+    if (index < 0) {
+        deeplearn_free(learner);
+        free(learner);
+        return -4;
     }
-    return performance;
+    return index;
 }
 
 /**
- * @brief Creates training and test arrays which contain randomly ordered
- *        indexes to the main images array. This tries to ensure that there
- *        is no bias depending on the sequences of inputs during training.
- * @param convnet Deep convnet object
+ * @brief Training update for every head using a single convolution of
+ *        the image. Until the trunk is trained the image only trains
+ *        the convolution layers.
+ * @param heads Heads object
+ * @param img Array containing input image
+ * @param class_number Desired class number for each head, or a negative
+ *        value if a head is not to learn from this image
+ * @returns zero on success
  */
-int deepconvnet_create_training_test_sets(deepconvnet * convnet)
+int deepconvnet_heads_update_img(deepconvnet_heads * heads,
+                                 unsigned char img[],
+                                 int class_number[])
 {
-    int i, j;
+    unsigned char use_dropouts = 0;
+    int i;
 
-    /* create arrays to store randomly ordered array indexes
-       for training and test sets */
-    int training_images = convnet->no_of_images*8/10;
-    convnet->training_set_index =
-        (int*)malloc((training_images+1)*sizeof(int));
-    if (!convnet->training_set_index) return -1;
-    i = 0;
-    while (i < training_images) {
-        int index =
-            rand_num(&convnet->learner->net->random_seed)%convnet->no_of_images;
-        for (j = 0; j < i; j++) {
-            if (convnet->training_set_index[j] == index) {
-                break;
-            }
-        }
-        if (j == i) {
-            convnet->training_set_index[i] = index;
-            i++;
-        }
+    if (heads->convolution->training_complete == 0) use_dropouts = 1;
+    for (i = 0; i < heads->no_of_heads; i++) {
+        if (heads->head[i]->training_complete == 0) use_dropouts = 1;
     }
-    int test_images = 0;
-    convnet->test_set_index =
-        (int*)malloc((convnet->no_of_images - training_images+1)*sizeof(int));
-    if (!convnet->test_set_index) return -2;
-    for (i = 0; i < convnet->no_of_images; i++) {
-        for (j = 0; j < training_images; j++) {
-            if (convnet->training_set_index[j] == i) {
-                break;
+
+    if (conv_img(img, heads->convolution, use_dropouts) != 0) {
+        return -1;
+    }
+    if (heads->convolution->training_complete == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < heads->no_of_heads; i++) {
+        deeplearn * learner = heads->head[i];
+
+        if (deepconvnet_set_inputs_conv(learner, heads->convolution) != 0) {
+            return -2;
+        }
+        if ((learner->training_complete == 0) && (class_number[i] >= 0)) {
+            if (deeplearn_training_last_layer(learner)) {
+                deeplearn_set_class(learner, class_number[i]);
             }
+            deeplearn_update(learner);
         }
-        if (j == training_images) {
-            convnet->test_set_index[test_images++] = i;
+        else {
+            deeplearn_feed_forward(learner);
         }
     }
     return 0;
 }
 
-
 /**
- * @brief Reads images from a given directory and creates a deep convnet
- * @param directory Directory containing png images
- * @param convnet Deep convnet object
- * @param image_width Image width
- * @param image_height Image height
- * @param no_of_convolutions The number of convolution layers
- * @param max_features_per_convolution Number of features learned at
- *        each convolution layer
- * @param no_of_deep_layers Number of layers for the deep learner
- * @param no_of_outputs Number of output units
- * @param output_classes The number of output classes if the output in the
- *        data set is a single integer value
- * @param error_threshold Training error thresholds for each hidden layer
- * @param random_seed Random number seed
- * @return zero on success
+ * @brief Classifies an image with every head using a single convolution
+ *        of the image
+ * @param heads Heads object
+ * @param img Array containing input image
+ * @returns zero on success
  */
-int deepconvnet_read_images(char * directory,
-                            deepconvnet * convnet,
-                            int image_width, int image_height,
-                            int no_of_convolutions,
-                            int max_features_per_convolution,
-                            int reduction_factor,
-                            int no_of_deep_layers,
-                            int no_of_outputs,
-                            int output_classes,
-                            float error_threshold[],
-                            unsigned int * random_seed)
+int deepconvnet_heads_test_img(deepconvnet_heads * heads, unsigned char img[])
 {
-    if (deepconvnet_init(no_of_convolutions,
-                         no_of_deep_layers,
-                         image_width, image_height, 3,
-                         max_features_per_convolution,
-                         reduction_factor,
-                         no_of_outputs, convnet,
-                         error_threshold,
-                         random_seed) != 0) {
+    const unsigned char use_dropouts = 0;
+
+    if (conv_img(img, heads->convolution, use_dropouts) != 0) {
         return -1;
     }
+    for (int i = 0; i < heads->no_of_heads; i++) {
+        if (deepconvnet_set_inputs_conv(heads->head[i],
+                                        heads->convolution) != 0) {
+            return -2;
+        }
+        deeplearn_feed_forward(heads->head[i]);
+    }
+    return 0;
+}
 
-    convnet->no_of_images =
-        deeplearn_load_training_images(directory, &convnet->images,
-                                       &convnet->classifications,
-                                       &convnet->classification_number,
-                                       image_width, image_height);
-    if (convnet->no_of_images <= 0) {
-        return -2;
+/**
+ * @brief Returns an output unit value of a head for the most recent image
+ * @param heads Heads object
+ * @param head Index of the head
+ * @param index Index of the output unit
+ * @returns output unit value
+ */
+float deepconvnet_heads_get_output(deepconvnet_heads * heads,
+                                   int head, int index)
+{
+    return deeplearn_get_output(heads->head[head], index);
+}
+
+/**
+ * @brief Returns the class given by a head for the most recent image
+ * @param heads Heads object
+ * @param head Index of the head
+ * @returns class number
+ */
+int deepconvnet_heads_get_class(deepconvnet_heads * heads, int head)
+{
+    return deeplearn_get_class(heads->head[head]);
+}
+
+/**
+ * @brief Sets the learning rate
+ * @param convnet Deep convnet object
+ * @param rate the learning rate in the range 0.0 to 1.0
+ */
+void deepconvnet_set_learning_rate(deepconvnet * convnet, float rate)
+{
+    conv_set_learning_rate(convnet->convolution, rate);
+    deeplearn_set_learning_rate(convnet->learner, rate);
+}
+
+/**
+ * @brief Sets the percentage of units which drop out during training
+ * @param convnet Deep convnet object
+ * @param dropout_percent Percentage of units which drop out in the range 0 to 100
+ */
+void deepconvnet_set_dropouts(deepconvnet * convnet, float dropout_percent)
+{
+    conv_set_dropouts(convnet->convolution, dropout_percent);
+    deeplearn_set_dropouts(convnet->learner, dropout_percent);
+}
+
+/**
+ * @brief Sets the rule used to update the weights of the convolution
+ *        layers and of the deep learner, such as OPTIMISER_ADAM
+ * @param convnet Deep convnet object
+ * @param type One of the OPTIMISER_* update rules
+ * @returns zero on success
+ */
+int deepconvnet_set_optimiser(deepconvnet * convnet, int type)
+{
+    if (conv_set_optimiser(convnet->convolution, type) != 0) {
+        return -1;
+    }
+    if (deeplearn_set_optimiser(convnet->learner, type) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Uses gnuplot to plot the training error for the given learner
+ * @param convnet Deep convnet object
+ * @param filename Filename for the image to save as
+ * @param title Title of the graph
+ * @param image_width Width of the image in pixels
+ * @param image_height Height of the image in pixels
+ * @return zero on success
+ */
+int deepconvnet_plot_history(deepconvnet * convnet,
+                             int image_width, int image_height)
+{
+    deeplearn_history_snapshot snapshot;
+
+    memcpy((void*)snapshot.history, convnet->history,
+           convnet->history_index*sizeof(float));
+    snapshot.history_index = convnet->history_index;
+    snapshot.history_step = convnet->history_step;
+    snprintf(snapshot.filename, sizeof(snapshot.filename), "%s",
+             convnet->history_plot_filename);
+    snprintf(snapshot.title, sizeof(snapshot.title), "%s",
+             convnet->history_plot_title);
+    snapshot.image_width = image_width;
+    snapshot.image_height = image_height;
+    return deeplearn_history_plot(&snapshot, "libdeep_data");
+}
+
+/**
+ * @brief Sets a plotter which renders training history graphs on a
+ *        background thread. The plotter is owned by the caller.
+ * @param convnet Deep convnet object
+ * @param plotter History plotter, or NULL to plot synchronously
+ */
+void deepconvnet_set_history_plotter(deepconvnet * convnet,
+                                     deeplearn_history_plotter * plotter)
+{
+    convnet->history_plotter = plotter;
+}
+
+/**
+ * @brief Computes the convolution outputs for an image within the
+ *        prefetch queue. This is called on the worker thread, which is
+ *        the only user of the convolution while images are pending.
+ * @param context Deep convnet object
+ * @param slot The slot containing the image index
+ * @return zero on success
+ */
+static int deepconvnet_prefetch_conv(void * context,
+                                     deeplearn_prefetch_slot * slot)
+{
+    deepconvnet * convnet = (deepconvnet*)context;
+    deeplearn_conv * conv = convnet->convolution;
+    unsigned char * img = convnet->images[slot->index];
+
+    if (img == NULL) {
+        return -1;
+    }
+
+    /* images are only prefetched while training */
+    if (conv_img(img, conv, 1) != 0) {
+        return -2;
+    }
+    memcpy((void*)slot->inputs, conv->layer[conv->no_of_layers-1].pooling,
+           convnet->prefetch.no_of_inputs*sizeof(float));
+    return 0;
+}
+
+/**
+ * @brief Enables computing of convolution outputs on a worker thread,
+ *        ahead of the training steps of the deep learner, once the
+ *        convolution layers have been trained. The convolution buffers
+ *        are shared, so a single worker prepares the images.
+ * @param convnet Deep convnet object
+ * @param capacity The maximum number of images prepared ahead, or zero
+ *        to disable prefetching
+ * @return zero on success
+ */
+int deepconvnet_set_prefetch(deepconvnet * convnet, int capacity)
+{
+    deeplearn_conv * conv = convnet->convolution;
+    int no_of_inputs = convnet->learner->net->NoOfInputs;
+
+    deeplearn_prefetch_free(&convnet->prefetch);
+    if (capacity == 0) return 0;
+
+    if (no_of_inputs !=
+        conv_output_width(conv) * conv_output_height(conv) *
+        conv_layer_features(conv, conv->no_of_layers-1)) {
+        return -1;
+    }
+    if (deeplearn_prefetch_init(&convnet->prefetch, capacity, 1,
+                                no_of_inputs, 0,
+                                deepconvnet_prefetch_conv,
+                                (void*)convnet) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Trains the deep learner on the convolution outputs for an image
+ * @param convnet Deep convnet object
+ * @param features Convolution outputs for the image
+ * @param class_number Desired class number
+ */
+static void deepconvnet_learn_features(deepconvnet * convnet,
+                                       const float * features,
+                                       int class_number)
+{
+    deeplearn * learner = convnet->learner;
+
+    for (int i = 0; i < learner->net->NoOfInputs; i++) {
+        deeplearn_set_input(learner, i, features[i]);
+    }
+    if (deeplearn_training_last_layer(learner)) {
+        deepconvnet_set_class(convnet, class_number);
+    }
+    deeplearn_update(learner);
+    deepconvnet_update(convnet);
+}
+
+/**
+ * @brief Unmaps or frees the cached convolution outputs, keeping the
+ *        settings of the cache
+ * @param convnet Deep convnet object
+ */
+static void deepconvnet_conv_cache_release(deepconvnet * convnet)
+{
+    deepconvnet_conv_cache * cache = &convnet->conv_cache;
+
+#ifdef CONV_CACHE_MMAP
+    if ((cache->mapped != 0) && (cache->data)) {
+        munmap(cache->data, cache->size);
+    }
+#endif
+    free(cache->allocation);
+    cache->valid = 0;
+    cache->no_of_images = 0;
+    cache->no_of_outputs = 0;
+    cache->outputs = NULL;
+    cache->data = NULL;
+    cache->size = 0;
+    cache->mapped = 0;
+    cache->allocation = NULL;
+}
+
+/**
+ * @brief Returns the cached convolution outputs for an image
+ * @param convnet Deep convnet object
+ * @param index Array index of the image
+ * @return Convolution outputs, NoOfInputs of the deep learner in length
+ */
+static const float * deepconvnet_conv_cache_get(deepconvnet * convnet,
+                                                int index)
+{
+    deepconvnet_conv_cache * cache = &convnet->conv_cache;
+
+    return &cache->outputs[(size_t)index*cache->no_of_outputs];
+}
+
+/**
+ * @brief Computes the convolution outputs for an image. Images which
+ *        could not be decoded have outputs of zero.
+ * @param convnet Deep convnet object
+ * @param index Array index of the image
+ * @param outputs Returned convolution outputs
+ * @return zero on success
+ */
+static int deepconvnet_conv_cache_image(deepconvnet * convnet, int index,
+                                        float * outputs)
+{
+    deeplearn_conv * conv = convnet->convolution;
+    int no_of_outputs = convnet->learner->net->NoOfInputs;
+
+    if (convnet->images[index] == NULL) {
+        memset((void*)outputs, '\0', no_of_outputs*sizeof(float));
+        return 0;
+    }
+
+    /* the outputs are fixed, so dropouts are not used */
+    if (conv_img(convnet->images[index], conv, 0) != 0) {
+        return -1;
+    }
+    memcpy((void*)outputs, conv->layer[conv->no_of_layers-1].pooling,
+           no_of_outputs*sizeof(float));
+    return 0;
+}
+
+/**
+ * @brief Writes the convolution outputs for every image to a cache file
+ * @param convnet Deep convnet object
+ * @param filename Filename of the cache
+ * @return zero on success
+ */
+static int deepconvnet_conv_cache_write(deepconvnet * convnet,
+                                        char * filename)
+{
+    deepconvnet_conv_cache_header header;
+    int no_of_outputs = convnet->learner->net->NoOfInputs;
+    unsigned char padding[DEEPCONVNET_CONV_CACHE_ALIGNMENT];
+    int retval = 0;
+    float * outputs;
+    FILE * fp;
+
+    outputs = (float*)malloc(no_of_outputs*sizeof(float));
+    if (!outputs) {
+        return -1;
+    }
+    fp = fopen(filename, "wb");
+    if (!fp) {
+        free(outputs);
+        return -2;
+    }
+
+    memset((void*)&header, '\0', sizeof(deepconvnet_conv_cache_header));
+    memcpy((void*)header.magic, DEEPCONVNET_CONV_CACHE_MAGIC, 8);
+    header.version = DEEPCONVNET_CONV_CACHE_VERSION;
+    header.no_of_images = (uint32_t)convnet->no_of_images;
+    header.no_of_outputs = (uint32_t)no_of_outputs;
+    header.outputs_offset = DEEPCONVNET_CONV_CACHE_ALIGNMENT;
+    memset((void*)padding, '\0', sizeof(padding));
+    if ((fwrite(&header, sizeof(header), 1, fp) != 1) ||
+        (fwrite(padding, 1, DEEPCONVNET_CONV_CACHE_ALIGNMENT - sizeof(header),
+                fp) != DEEPCONVNET_CONV_CACHE_ALIGNMENT - sizeof(header))) {
+        retval = -3;
+    }
+
+    for (int i = 0; (i < convnet->no_of_images) && (retval == 0); i++) {
+        if (deepconvnet_conv_cache_image(convnet, i, outputs) != 0) {
+            retval = -4;
+        }
+        else if (fwrite(outputs, sizeof(float), no_of_outputs, fp) !=
+                 (size_t)no_of_outputs) {
+            retval = -3;
+        }
+    }
+
+    if (fclose(fp) != 0) {
+        retval = -3;
+    }
+    free(outputs);
+    return retval;
+}
+
+/**
+ * @brief Opens a convolution output cache file, which is memory mapped
+ *        where possible so that the outputs are paged in as they are used
+ * @param convnet Deep convnet object
+ * @param filename Filename of the cache
+ * @return zero on success
+ */
+static int deepconvnet_conv_cache_open(deepconvnet * convnet,
+                                       char * filename)
+{
+    deepconvnet_conv_cache * cache = &convnet->conv_cache;
+    deepconvnet_conv_cache_header * header;
+    int no_of_outputs = convnet->learner->net->NoOfInputs;
+
+#ifdef CONV_CACHE_MMAP
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+        close(fd);
+        return -2;
+    }
+    cache->size = (size_t)st.st_size;
+    cache->data = mmap(NULL, cache->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (cache->data == MAP_FAILED) {
+        cache->data = NULL;
+        return -2;
+    }
+    cache->mapped = 1;
+#else
+    long size;
+    FILE * fp = fopen(filename, "rb");
+    if (!fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return -2;
+    }
+    cache->size = (size_t)size;
+    cache->allocation = malloc(cache->size);
+    if (!cache->allocation) {
+        fclose(fp);
+        return -2;
+    }
+    cache->data = cache->allocation;
+    if (fread(cache->data, 1, cache->size, fp) != cache->size) {
+        fclose(fp);
+        return -2;
+    }
+    fclose(fp);
+#endif
+
+    header = (deepconvnet_conv_cache_header*)cache->data;
+    if ((cache->size < sizeof(deepconvnet_conv_cache_header)) ||
+        (memcmp(header->magic, DEEPCONVNET_CONV_CACHE_MAGIC, 8) != 0) ||
+        (header->version != DEEPCONVNET_CONV_CACHE_VERSION) ||
+        (header->no_of_images != (uint32_t)convnet->no_of_images) ||
+        (header->no_of_outputs != (uint32_t)no_of_outputs) ||
+        (header->outputs_offset +
+         (uint64_t)convnet->no_of_images*no_of_outputs*sizeof(float) >
+         cache->size)) {
+        return -3;
+    }
+    cache->outputs =
+        (const float*)((unsigned char*)cache->data + header->outputs_offset);
+    return 0;
+}
+
+/**
+ * @brief Enables or disables caching of the convolution outputs for
+ *        each image. Once the convolution layers have been trained the
+ *        outputs are computed once, and the deep layers are then trained
+ *        and evaluated from the cache rather than convolving the same
+ *        images again.
+ * @param convnet Deep convnet object
+ * @param enabled Non-zero to cache convolution outputs
+ * @param filename If not NULL then the outputs are written to this file
+ *        and memory mapped, otherwise they are held in memory
+ * @return zero on success
+ */
+int deepconvnet_set_conv_cache(deepconvnet * convnet, unsigned char enabled,
+                               char * filename)
+{
+    deepconvnet_conv_cache * cache = &convnet->conv_cache;
+
+    deepconvnet_conv_cache_release(convnet);
+    cache->enabled = 0;
+    cache->filename[0] = 0;
+    if (enabled == 0) return 0;
+
+    if (filename != NULL) {
+        if (strlen(filename) >= sizeof(cache->filename)) return -1;
+        strcpy(cache->filename, filename);
+    }
+    cache->enabled = 1;
+    return 0;
+}
+
+/**
+ * @brief Computes the convolution outputs for every image. This is done
+ *        automatically by deepconvnet_training once the convolution
+ *        layers have been trained, and may be called again if the
+ *        images change.
+ * @param convnet Deep convnet object
+ * @return zero on success
+ */
+int deepconvnet_conv_cache_build(deepconvnet * convnet)
+{
+    deepconvnet_conv_cache * cache = &convnet->conv_cache;
+    deeplearn_conv * conv = convnet->convolution;
+    int no_of_outputs = convnet->learner->net->NoOfInputs;
+    float * outputs;
+
+    deepconvnet_conv_cache_release(convnet);
+    if (conv->training_complete == 0) return -1;
+    if (no_of_outputs !=
+        conv_output_width(conv) * conv_output_height(conv) *
+        conv_layer_features(conv, conv->no_of_layers-1)) {
+        return -2;
+    }
+
+    /* the convolution is in use by the prefetch worker */
+    deeplearn_prefetch_drain(&convnet->prefetch);
+
+    if (cache->filename[0] != 0) {
+        if ((deepconvnet_conv_cache_write(convnet, cache->filename) != 0) ||
+            (deepconvnet_conv_cache_open(convnet, cache->filename) != 0)) {
+            deepconvnet_conv_cache_release(convnet);
+            return -3;
+        }
+    }
+    else {
+        outputs = (float*)malloc((size_t)convnet->no_of_images*no_of_outputs*
+                                 sizeof(float));
+        if (!outputs) return -4;
+        DEEPLEARN_STATS_ALLOC((size_t)convnet->no_of_images*no_of_outputs*
+                              sizeof(float));
+        cache->allocation = (void*)outputs;
+        cache->outputs = outputs;
+        for (int i = 0; i < convnet->no_of_images; i++) {
+            if (deepconvnet_conv_cache_image(convnet, i,
+                                             &outputs[(size_t)i*no_of_outputs]) != 0) {
+                deepconvnet_conv_cache_release(convnet);
+                return -5;
+            }
+        }
+    }
+
+    cache->no_of_images = convnet->no_of_images;
+    cache->no_of_outputs = no_of_outputs;
+    cache->valid = 1;
+    return 0;
+}
+
+/**
+ * @brief Picks the next training image, either at random or the next
+ *        within the current epoch
+ * @param convnet Deep convnet object
+ * @param position Returned position of the image within the training set
+ * @return Array index of the image
+ */
+static int deepconvnet_next_image(deepconvnet * convnet, int * position)
+{
+    if (convnet->epoch.enabled != 0) {
+        /* the next image within the current epoch */
+        if (deeplearn_epoch_start(&convnet->epoch, convnet->current_layer + 1,
+                                  convnet->training_images) != 0) {
+            deepconvnet_shuffle_training(convnet);
+        }
+        *position = deeplearn_epoch_take(&convnet->epoch,
+                                         convnet->training_images, 1);
+    }
+    else {
+        /* pick an image at random */
+        *position =
+            rand_num(&convnet->learner->net->random_seed)%
+            convnet->training_images;
+    }
+    return convnet->training_set_index[*position];
+}
+
+/**
+ * @brief Performs a training step of the deep learner using convolution
+ *        outputs computed by the prefetch worker. The queue is kept full
+ *        of requests for the images which follow, and images requested
+ *        for a different training phase are discarded.
+ * @param convnet Deep convnet object
+ * @return zero on success
+ */
+static int deepconvnet_prefetch_training(deepconvnet * convnet)
+{
+    deeplearn_prefetch_slot * slot;
+    int phase = convnet->current_layer + 1;
+    DEEPLEARN_STATS_START(start_time);
+
+    do {
+        /* request the images which follow */
+        while ((slot = deeplearn_prefetch_request(&convnet->prefetch)) != NULL) {
+            slot->index = deepconvnet_next_image(convnet, &slot->position);
+            slot->tag = phase;
+            deeplearn_prefetch_submit(&convnet->prefetch);
+        }
+
+        slot = deeplearn_prefetch_next(&convnet->prefetch);
+        if (slot == NULL) return -1;
+        if (slot->retval != 0) {
+            deeplearn_prefetch_release(&convnet->prefetch);
+            return -2;
+        }
+        if (slot->tag != phase) {
+            deeplearn_prefetch_release(&convnet->prefetch);
+            slot = NULL;
+        }
+    } while (slot == NULL);
+
+    deepconvnet_learn_features(convnet, slot->inputs,
+                               convnet->classification_number[slot->index]);
+
+    /* the epoch position runs ahead by the images which are pending */
+    if (convnet->epoch.enabled != 0) {
+        deeplearn_epoch_record(&convnet->epoch, convnet->BPerror, 1);
+        if (slot->position == convnet->training_images - 1) {
+            deeplearn_epoch_complete(&convnet->epoch);
+        }
+    }
+    deeplearn_prefetch_release(&convnet->prefetch);
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_UPDATE_IMAGE, 0);
+    DEEPLEARN_STATS_IMAGES(1);
+    return 0;
+}
+
+/**
+ * @brief Trains on the next image from a stream
+ * @param convnet Deep convnet object
+ * @returns zero on success
+ */
+static int deepconvnet_stream_training(deepconvnet * convnet)
+{
+    deeplearn_stream * stream = convnet->stream;
+
+    if (deeplearn_stream_next(stream) < 0) {
+        return -5;
+    }
+    if (deepconvnet_update_img(convnet,
+                               deeplearn_stream_image(stream, stream->current),
+                               stream->batch.classification_number[stream->current]) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Trains from a stream of images, such as a set which is too large
+ *        to be held in memory, rather than from the loaded images.
+ *        Performance is still measured on any loaded test images.
+ * @param convnet Deep convnet object
+ * @param stream Stream of images, or NULL to train on the loaded images
+ * @returns zero on success
+ */
+int deepconvnet_set_stream(deepconvnet * convnet, deeplearn_stream * stream)
+{
+    deeplearn_conv * conv = convnet->convolution;
+
+    if ((stream != NULL) &&
+        (stream->batch.image_size !=
+         conv->inputs_across*conv->inputs_down*conv->inputs_depth)) {
+        return -1;
+    }
+    convnet->stream = stream;
+    return 0;
+}
+
+/**
+ * @brief Performs training
+ * @param convnet Deep convnet object
+ */
+int deepconvnet_training(deepconvnet * convnet)
+{
+    if (convnet->learner->training_complete != 0) return 0;
+    if (convnet->stream != NULL) return deepconvnet_stream_training(convnet);
+    if (convnet->no_of_images == 0) return 0;
+    if (convnet->classification_number == NULL) return -1;
+
+    if (convnet->training_images <= 0) return -3;
+
+    if ((convnet->conv_cache.enabled != 0) &&
+        (convnet->convolution->training_complete != 0)) {
+        if ((convnet->conv_cache.valid == 0) ||
+            (convnet->conv_cache.no_of_images != convnet->no_of_images)) {
+            if (deepconvnet_conv_cache_build(convnet) != 0) {
+                return -4;
+            }
+        }
+        int position;
+        int index = deepconvnet_next_image(convnet, &position);
+        deepconvnet_learn_features(convnet,
+                                   deepconvnet_conv_cache_get(convnet, index),
+                                   convnet->classification_number[index]);
+        if (convnet->epoch.enabled != 0) {
+            deeplearn_epoch_update(&convnet->epoch, convnet->BPerror, 1,
+                                   convnet->training_images);
+        }
+        return 0;
+    }
+
+    if ((convnet->prefetch.capacity > 0) &&
+        (convnet->convolution->training_complete != 0)) {
+        if (deepconvnet_prefetch_training(convnet) != 0) {
+            return -2;
+        }
+        return 0;
+    }
+
+    int index0;
+    int index = deepconvnet_next_image(convnet, &index0);
+    unsigned char * img = convnet->images[index];
+    if (deepconvnet_update_img(convnet, img,
+                               convnet->classification_number[index]) != 0) {
+        return -2;
+    }
+
+    if (convnet->epoch.enabled != 0) {
+        deeplearn_epoch_update(&convnet->epoch, convnet->BPerror, 1,
+                               convnet->training_images);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Classifies a chunk of images whose convolution outputs have
+ *        already been computed. Batches within the chunk are fed forward
+ *        in parallel, each thread having its own inference context.
+ * @param convnet Deep convnet object
+ * @param images The number of images within the chunk
+ * @param features Convolution outputs, one row per image
+ * @param classes Returned class number of each image
+ * @return zero on success
+ */
+static int deepconvnet_classify_chunk(deepconvnet * convnet, int images,
+                                      float * features, int * classes)
+{
+    bp * net = convnet->learner->net;
+    int batches = (images + DEEPCONVNET_PERFORMANCE_BATCH - 1) /
+        DEEPCONVNET_PERFORMANCE_BATCH;
+    int failed = 0;
+
+#pragma omp parallel num_threads(threads_count()) if (batches > 1) reduction(+:failed)
+    {
+        bp_inference ctx;
+        float * outputs =
+            (float*)malloc(DEEPCONVNET_PERFORMANCE_BATCH*net->NoOfOutputs*
+                           sizeof(float));
+        int ready = ((outputs != 0) &&
+                     (bp_inference_init(&ctx, net,
+                                        DEEPCONVNET_PERFORMANCE_BATCH) == 0));
+
+#pragma omp for schedule(static)
+        for (int b = 0; b < batches; b++) {
+            int start = b*DEEPCONVNET_PERFORMANCE_BATCH;
+            int batch_size = images - start;
+            if (batch_size > DEEPCONVNET_PERFORMANCE_BATCH) {
+                batch_size = DEEPCONVNET_PERFORMANCE_BATCH;
+            }
+            if ((ready == 0) ||
+                (bp_infer(net, &ctx, &features[start*net->NoOfInputs],
+                          outputs, batch_size) != 0)) {
+                failed++;
+                continue;
+            }
+
+            /* the class is the most active output, as with
+               deeplearn_get_class */
+            for (int i = 0; i < batch_size; i++) {
+                int class = -9999;
+                float max = -1;
+                for (int j = 0; j < net->NoOfOutputs; j++) {
+                    if (outputs[i*net->NoOfOutputs + j] > max) {
+                        max = outputs[i*net->NoOfOutputs + j];
+                        class = j;
+                    }
+                }
+                classes[start+i] = class;
+            }
+        }
+
+        if (ready != 0) {
+            bp_inference_free(&ctx);
+        }
+        free(outputs);
+    }
+
+    return (failed > 0) ? -1 : 0;
+}
+
+/**
+ * @brief Returns performance on the given test images. Once the
+ *        convolution layers are trained the images are evaluated without
+ *        any further learning, with the fully connected layers fed
+ *        forward in parallel batches. Before then each image also
+ *        trains the current convolution layer, as with
+ *        deepconvnet_update_img.
+ * @param convnet Deep convnet object
+ * @param index Array index numbers of the test images
+ * @param images The number of test images
+ * @return Percentage of correct classifications or a negative number on error
+ */
+static float deepconvnet_performance(deepconvnet * convnet,
+                                     int * index, int images)
+{
+    float performance = 0;
+    int i, c, chunk, ctr = 0;
+    int classes[DEEPCONVNET_PERFORMANCE_CHUNK];
+    int no_of_inputs = convnet->learner->net->NoOfInputs;
+    deeplearn_conv * conv = convnet->convolution;
+    float * features;
+
+    if (images < 1) {
+        return 0;
+    }
+
+    /* the convolution is in use by the prefetch worker */
+    deeplearn_prefetch_drain(&convnet->prefetch);
+
+    if (conv->training_complete == 0) {
+        for (i = 0; i < images; i++) {
+            unsigned char * img = convnet->images[index[i]];
+            deepconvnet_update_img(convnet, img, -1);
+            if (deeplearn_get_class(convnet->learner) ==
+                convnet->classification_number[index[i]]) {
+                performance += 100.0f;
+            }
+            ctr++;
+        }
+        return performance / ctr;
+    }
+
+    if (no_of_inputs !=
+        conv_output_width(conv) * conv_output_height(conv) *
+        conv_layer_features(conv, conv->no_of_layers-1)) {
+        return -3;
+    }
+
+    features = (float*)malloc(DEEPCONVNET_PERFORMANCE_CHUNK*no_of_inputs*
+                              sizeof(float));
+    if (!features) {
+        return -4;
+    }
+    DEEPLEARN_STATS_ALLOC(DEEPCONVNET_PERFORMANCE_CHUNK*no_of_inputs*
+                          sizeof(float));
+
+    for (c = 0; c < images; c += DEEPCONVNET_PERFORMANCE_CHUNK) {
+        chunk = images - c;
+        if (chunk > DEEPCONVNET_PERFORMANCE_CHUNK) {
+            chunk = DEEPCONVNET_PERFORMANCE_CHUNK;
+        }
+
+        /* the convolution is itself parallel, so images are taken
+           one at a time */
+        for (i = 0; i < chunk; i++) {
+            if (convnet->conv_cache.valid != 0) {
+                memcpy((void*)&features[i*no_of_inputs],
+                       deepconvnet_conv_cache_get(convnet, index[c+i]),
+                       no_of_inputs*sizeof(float));
+                continue;
+            }
+            if (conv_img(convnet->images[index[c+i]], conv, 0) != 0) {
+                free(features);
+                return -5;
+            }
+            memcpy((void*)&features[i*no_of_inputs],
+                   conv->layer[conv->no_of_layers-1].pooling,
+                   no_of_inputs*sizeof(float));
+        }
+
+        if (deepconvnet_classify_chunk(convnet, chunk,
+                                       features, classes) != 0) {
+            free(features);
+            return -6;
+        }
+        for (i = 0; i < chunk; i++) {
+            if (classes[i] == convnet->classification_number[index[c+i]]) {
+                ctr++;
+            }
+        }
+    }
+    free(features);
+
+    return ctr * 100.0f / images;
+}
+
+/**
+ * @brief Returns performance on a random subset of the test set, giving
+ *        a cheaper estimate for use while training is in progress
+ * @param convnet Deep convnet object
+ * @param subset_size The number of test images to evaluate. If this is
+ *        zero or not less than the size of the test set then all test
+ *        images are used
+ * @param random_seed Random number seed used to pick the subset
+ * @return Percentage of correct classifications or a negative number on error
+ */
+float deepconvnet_get_performance_subset(deepconvnet * convnet,
+                                         int subset_size,
+                                         unsigned int * random_seed)
+{
+    int i, j, swap;
+    int test_images = convnet->test_images;
+    int * index;
+    float performance;
+
+    if (convnet->no_of_images == 0) return -1;
+    if (convnet->classification_number == NULL) return -2;
+    if (test_images <= 0) return -3;
+
+    if ((subset_size <= 0) || (subset_size > test_images)) {
+        subset_size = test_images;
+    }
+    if (subset_size == test_images) {
+        return deepconvnet_performance(convnet, convnet->test_set_index,
+                                       test_images);
+    }
+
+    index = (int*)malloc(test_images*sizeof(int));
+    if (!index) {
+        return -4;
+    }
+    memcpy((void*)index, convnet->test_set_index, test_images*sizeof(int));
+    for (i = 0; i < subset_size; i++) {
+        j = i + (int)(rand_num(random_seed)%(test_images - i));
+        swap = index[i];
+        index[i] = index[j];
+        index[j] = swap;
+    }
+    performance = deepconvnet_performance(convnet, index, subset_size);
+    free(index);
+    return performance;
+}
+
+/**
+ * @brief Returns performance on the test set
+ * @param convnet Deep convnet object
+ * @return Percentage of correct classifications or a negative number on error
+ */
+float deepconvnet_get_performance(deepconvnet * convnet)
+{
+    return deepconvnet_get_performance_subset(convnet, 0, NULL);
+}
+
+/**
+ * @brief Returns the dimensions of the class map produced when scanning
+ *        an image with deepconvnet_scan_img
+ * @param convnet Deep convnet object
+ * @param img_width Width of the image to be scanned
+ * @param img_height Height of the image to be scanned
+ * @param stride Step in pixels between successive windows
+ * @param map_width Returned width of the class map
+ * @param map_height Returned height of the class map
+ * @return zero on success
+ */
+int deepconvnet_scan_size(deepconvnet * convnet,
+                          int img_width, int img_height, int stride,
+                          int * map_width, int * map_height)
+{
+    deeplearn_conv * conv = convnet->convolution;
+
+    if (stride < 1) return -1;
+    if ((img_width < conv->inputs_across) ||
+        (img_height < conv->inputs_down)) {
+        return -2;
+    }
+
+    *map_width = (img_width - conv->inputs_across) / stride + 1;
+    *map_height = (img_height - conv->inputs_down) / stride + 1;
+    return 0;
+}
+
+/**
+ * @brief Classifies every window of an image which is larger than the
+ *        input layer, giving a dense class map. Windows the size of the
+ *        input layer are taken at the given stride, each including its
+ *        whole receptive field, so that every class is the same as
+ *        deepconvnet_test_img would give for that part of the image.
+ *        Windows are evaluated in chunks, so the memory used does not
+ *        depend upon the image size, and the fully connected layers of
+ *        each chunk are fed forward in parallel batches.
+ * @param convnet Deep convnet object whose convolution layers are trained
+ * @param img Image with the same depth as the input layer
+ * @param img_width Width of the image
+ * @param img_height Height of the image
+ * @param stride Step in pixels between successive windows
+ * @param class_map Returned class number for each window, with the
+ *        dimensions given by deepconvnet_scan_size. The window for
+ *        map position x,y has its top left corner at x*stride,y*stride
+ * @return zero on success
+ */
+int deepconvnet_scan_img(deepconvnet * convnet, unsigned char img[],
+                         int img_width, int img_height, int stride,
+                         int class_map[])
+{
+    int i, c, chunk, map_width, map_height, windows;
+    int no_of_inputs = convnet->learner->net->NoOfInputs;
+    deeplearn_conv * conv = convnet->convolution;
+    int row_bytes = conv->inputs_across*conv->inputs_depth;
+    unsigned char * window;
+    float * features;
+
+    if (conv->training_complete == 0) return -1;
+    if (deepconvnet_scan_size(convnet, img_width, img_height, stride,
+                              &map_width, &map_height) != 0) {
+        return -2;
+    }
+    if (no_of_inputs !=
+        conv_output_width(conv) * conv_output_height(conv) *
+        conv_layer_features(conv, conv->no_of_layers-1)) {
+        return -3;
+    }
+
+    /* the convolution is in use by the prefetch worker */
+    deeplearn_prefetch_drain(&convnet->prefetch);
+
+    window = (unsigned char*)malloc(row_bytes*conv->inputs_down);
+    if (!window) {
+        return -4;
+    }
+    features = (float*)malloc(DEEPCONVNET_PERFORMANCE_CHUNK*no_of_inputs*
+                              sizeof(float));
+    if (!features) {
+        free(window);
+        return -5;
+    }
+    DEEPLEARN_STATS_ALLOC(row_bytes*conv->inputs_down +
+                          DEEPCONVNET_PERFORMANCE_CHUNK*no_of_inputs*
+                          sizeof(float));
+
+    windows = map_width*map_height;
+    for (c = 0; c < windows; c += DEEPCONVNET_PERFORMANCE_CHUNK) {
+        chunk = windows - c;
+        if (chunk > DEEPCONVNET_PERFORMANCE_CHUNK) {
+            chunk = DEEPCONVNET_PERFORMANCE_CHUNK;
+        }
+
+        /* the convolution is itself parallel, so windows are taken
+           one at a time */
+        for (i = 0; i < chunk; i++) {
+            int tx = ((c+i) % map_width)*stride;
+            int ty = ((c+i) / map_width)*stride;
+
+            for (int y = 0; y < conv->inputs_down; y++) {
+                memcpy((void*)&window[y*row_bytes],
+                       (void*)&img[((ty+y)*img_width + tx)*conv->inputs_depth],
+                       row_bytes);
+            }
+            if (conv_img(window, conv, 0) != 0) {
+                free(features);
+                free(window);
+                return -6;
+            }
+            memcpy((void*)&features[i*no_of_inputs],
+                   conv->layer[conv->no_of_layers-1].pooling,
+                   no_of_inputs*sizeof(float));
+        }
+
+        if (deepconvnet_classify_chunk(convnet, chunk, features,
+                                       &class_map[c]) != 0) {
+            free(features);
+            free(window);
+            return -7;
+        }
+    }
+    free(features);
+    free(window);
+    return 0;
+}
+
+/**
+ * @brief Computes the convolution outputs of a number of images with the
+ *        layers working as a pipeline.  At each step layer k processes
+ *        image i while layer k-1 processes image i+1, each layer on its
+ *        own thread, so that with several layers the images pass through
+ *        the stack concurrently.  Each layer has its own working arrays,
+ *        with two pooling arrays so that the next layer can read one
+ *        image while the next image is written.
+ * @param convnet Deep convnet object whose convolution layers are trained
+ * @param images Array of images with the dimensions of the input layer
+ * @param no_of_images The number of images
+ * @param features Returned convolution outputs, one row per image
+ * @return zero on success
+ */
+static int deepconvnet_conv_pipeline(deepconvnet * convnet,
+                                     unsigned char ** images,
+                                     int no_of_images, float * features)
+{
+    deeplearn_conv * conv = convnet->convolution;
+    int layers = conv->no_of_layers;
+    int no_of_inputs = convnet->learner->net->NoOfInputs;
+    int steps = no_of_images + layers - 1;
+    int failed = 0;
+    float * convolution[PREPROCESS_MAX_LAYERS];
+    float * pooling[PREPROCESS_MAX_LAYERS][2];
+
+    memset((void*)convolution, '\0', sizeof(convolution));
+    memset((void*)pooling, '\0', sizeof(pooling));
+    for (int k = 0; k < layers; k++) {
+        int pooling_units = conv_pooling_units(k, conv);
+
+        convolution[k] =
+            (float*)malloc(convolution_layer_units(k, conv)*sizeof(float));
+        if (!convolution[k]) {
+            failed = 1;
+            break;
+        }
+        /* the last layer writes directly to the features */
+        if (k == layers-1) break;
+        pooling[k][0] = (float*)malloc(pooling_units*sizeof(float));
+        pooling[k][1] = (float*)malloc(pooling_units*sizeof(float));
+        if ((!pooling[k][0]) || (!pooling[k][1])) {
+            failed = 1;
+            break;
+        }
+    }
+
+    if (failed == 0) {
+#pragma omp parallel num_threads(threads_count()) if (layers > 1) reduction(+:failed)
+        for (int step = 0; step < steps; step++) {
+#pragma omp for schedule(static)
+            for (int k = 0; k < layers; k++) {
+                int i = step - k;
+                float * inputs, * outputs;
+
+                if ((i < 0) || (i >= no_of_images)) continue;
+
+                inputs = (k > 0) ? pooling[k-1][i%2] : NULL;
+                outputs = (k < layers-1) ? pooling[k][i%2] :
+                    &features[i*no_of_inputs];
+                if (conv_layer_infer(conv, k, (k == 0) ? images[i] : NULL,
+                                     inputs, convolution[k],
+                                     outputs) != 0) {
+                    failed++;
+                }
+            }
+        }
+    }
+
+    for (int k = 0; k < layers; k++) {
+        free(convolution[k]);
+        free(pooling[k][0]);
+        free(pooling[k][1]);
+    }
+    return (failed > 0) ? -1 : 0;
+}
+
+/**
+ * @brief Classifies a batch of images without any learning.  The images
+ *        stream through the convolution layers as a pipeline, and the
+ *        fully connected layers are then fed forward in parallel batches,
+ *        giving the same classes as deepconvnet_test_img followed by
+ *        deepconvnet_get_class but with a higher throughput.
+ * @param convnet Deep convnet object whose convolution layers are trained
+ * @param images Array of images with the dimensions of the input layer
+ * @param no_of_images The number of images
+ * @param classes Returned class number of each image
+ * @return zero on success
+ */
+int deepconvnet_classify_batch(deepconvnet * convnet,
+                               unsigned char ** images, int no_of_images,
+                               int classes[])
+{
+    int c, chunk;
+    int no_of_inputs = convnet->learner->net->NoOfInputs;
+    deeplearn_conv * conv = convnet->convolution;
+    float * features;
+
+    if (conv->training_complete == 0) return -1;
+    if (no_of_images < 1) return 0;
+    if (no_of_inputs !=
+        conv_output_width(conv) * conv_output_height(conv) *
+        conv_layer_features(conv, conv->no_of_layers-1)) {
+        return -2;
+    }
+
+    /* the convolution is in use by the prefetch worker */
+    deeplearn_prefetch_drain(&convnet->prefetch);
+
+    features = (float*)malloc(DEEPCONVNET_PERFORMANCE_CHUNK*no_of_inputs*
+                              sizeof(float));
+    if (!features) {
+        return -3;
+    }
+    DEEPLEARN_STATS_ALLOC(DEEPCONVNET_PERFORMANCE_CHUNK*no_of_inputs*
+                          sizeof(float));
+
+    for (c = 0; c < no_of_images; c += DEEPCONVNET_PERFORMANCE_CHUNK) {
+        chunk = no_of_images - c;
+        if (chunk > DEEPCONVNET_PERFORMANCE_CHUNK) {
+            chunk = DEEPCONVNET_PERFORMANCE_CHUNK;
+        }
+        if (deepconvnet_conv_pipeline(convnet, &images[c], chunk,
+                                      features) != 0) {
+            free(features);
+            return -4;
+        }
+        if (deepconvnet_classify_chunk(convnet, chunk, features,
+                                       &classes[c]) != 0) {
+            free(features);
+            return -5;
+        }
+    }
+    free(features);
+    return 0;
+}
+
+/**
+ * @brief Quantises a trained convnet for inference with eight bit
+ *        integer dot products.  The convolution layers switch to
+ *        CONV_BACKEND_INT8 and the fully connected layers are quantised
+ *        using the convolution outputs of test images for calibration.
+ *        Subsequent calls to deepconvnet_get_performance then report
+ *        the quantised performance.
+ * @param convnet Deep convnet object whose convolution layers are trained
+ * @param granularity BP_QUANT_PER_LAYER or BP_QUANT_PER_UNIT
+ * @param calibration_images The maximum number of test images used for
+ *        calibration, or zero to use all of them
+ * @return zero on success
+ */
+int deepconvnet_quantise(deepconvnet * convnet, int granularity,
+                         int calibration_images)
+{
+    int i, retval, no_of_inputs = convnet->learner->net->NoOfInputs;
+    deeplearn_conv * conv = convnet->convolution;
+    float * features;
+
+    if (conv->training_complete == 0) return -1;
+    if (convnet->test_images <= 0) return -2;
+    if ((calibration_images <= 0) ||
+        (calibration_images > convnet->test_images)) {
+        calibration_images = convnet->test_images;
+    }
+
+    deeplearn_prefetch_drain(&convnet->prefetch);
+    if (conv_set_backend(conv, CONV_BACKEND_INT8) != 0) return -3;
+
+    features = (float*)malloc(calibration_images*no_of_inputs*sizeof(float));
+    if (!features) {
+        return -4;
+    }
+    for (i = 0; i < calibration_images; i++) {
+        int index = convnet->test_set_index[i];
+        if (convnet->conv_cache.valid != 0) {
+            memcpy((void*)&features[i*no_of_inputs],
+                   deepconvnet_conv_cache_get(convnet, index),
+                   no_of_inputs*sizeof(float));
+            continue;
+        }
+        if (conv_img(convnet->images[index], conv, 0) != 0) {
+            free(features);
+            return -5;
+        }
+        memcpy((void*)&features[i*no_of_inputs],
+               conv->layer[conv->no_of_layers-1].pooling,
+               no_of_inputs*sizeof(float));
+    }
+
+    retval = bp_quantise(convnet->learner->net, granularity, features,
+                         calibration_images);
+    free(features);
+    if (retval != 0) {
+        return -6;
+    }
+    return 0;
+}
+
+/**
+ * @brief Allocates the training and test set index arrays
+ * @param convnet Deep convnet object
+ * @return zero on success
+ */
+static int deepconvnet_alloc_sets(deepconvnet * convnet)
+{
+    if (convnet->no_of_images <= 0) return -1;
+
+    free(convnet->training_set_index);
+    free(convnet->test_set_index);
+    deeplearn_prefetch_drain(&convnet->prefetch);
+    convnet->training_images = 0;
+    convnet->test_images = 0;
+    convnet->epoch.position = 0;
+    convnet->training_set_index =
+        (int*)malloc(convnet->no_of_images*sizeof(int));
+    convnet->test_set_index =
+        (int*)malloc(convnet->no_of_images*sizeof(int));
+    if ((!convnet->training_set_index) || (!convnet->test_set_index)) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the class numbers used to stratify a split
+ * @param convnet Deep convnet object
+ * @param method Split method DEEPLEARN_SPLIT_*
+ * @return Array of class numbers, or NULL if the split is not stratified
+ */
+static int * deepconvnet_split_classes(deepconvnet * convnet, int method)
+{
+    if (method != DEEPLEARN_SPLIT_STRATIFIED) return NULL;
+    return convnet->classification_number;
+}
+
+/**
+ * @brief Divides the images into training and test sets which contain
+ *        randomly ordered indexes to the main images array
+ * @param convnet Deep convnet object
+ * @param test_percentage Percentage of images used for testing
+ * @param method Split method DEEPLEARN_SPLIT_*. If stratified then each
+ *        class appears in the same proportion within both sets
+ * @return zero on success
+ */
+int deepconvnet_split(deepconvnet * convnet, int test_percentage, int method)
+{
+    if ((method < 0) || (method >= DEEPLEARN_SPLIT_METHODS)) return -3;
+    if (deepconvnet_alloc_sets(convnet) != 0) return -1;
+
+    if (deeplearn_split(convnet->no_of_images,
+                        deepconvnet_split_classes(convnet, method),
+                        test_percentage,
+                        &convnet->learner->net->random_seed,
+                        convnet->training_set_index,
+                        &convnet->training_images,
+                        convnet->test_set_index,
+                        &convnet->test_images) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Divides the images into folds for cross validation, with the
+ *        given fold becoming the test set
+ * @param convnet Deep convnet object
+ * @param folds The number of folds
+ * @param fold Index of the fold used for testing
+ * @param method Split method DEEPLEARN_SPLIT_*
+ * @param random_seed Random number seed, which should be the same for
+ *        every fold
+ * @return zero on success
+ */
+int deepconvnet_split_kfold(deepconvnet * convnet, int folds, int fold,
+                            int method, unsigned int random_seed)
+{
+    if ((method < 0) || (method >= DEEPLEARN_SPLIT_METHODS)) return -3;
+    if (deepconvnet_alloc_sets(convnet) != 0) return -1;
+
+    if (deeplearn_split_kfold(convnet->no_of_images,
+                              deepconvnet_split_classes(convnet, method),
+                              folds, fold, random_seed,
+                              convnet->training_set_index,
+                              &convnet->training_images,
+                              convnet->test_set_index,
+                              &convnet->test_images) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reorders the training set, typically at the start of each epoch
+ * @param convnet Deep convnet object
+ */
+void deepconvnet_shuffle_training(deepconvnet * convnet)
+{
+    deeplearn_split_shuffle(convnet->training_set_index,
+                            convnet->training_images,
+                            &convnet->learner->net->random_seed);
+}
+
+/**
+ * @brief Enables or disables epoch based training. When enabled, images
+ *        are taken in order from the training set, which is shuffled at
+ *        the start of each epoch, rather than being picked at random.
+ * @param convnet Deep convnet object
+ * @param enabled Non-zero to train in epochs
+ */
+void deepconvnet_set_epochs(deepconvnet * convnet, unsigned char enabled)
+{
+    deeplearn_epoch_init(&convnet->epoch, enabled);
+}
+
+/**
+ * @brief Returns the number of completed training epochs
+ * @param convnet Deep convnet object
+ * @return The number of epochs
+ */
+unsigned int deepconvnet_get_epochs(deepconvnet * convnet)
+{
+    return convnet->epoch.epochs;
+}
+
+/**
+ * @brief Returns the average training error over the last completed epoch
+ * @param convnet Deep convnet object
+ * @return Training error, or DEEPLEARN_UNKNOWN_ERROR if no epoch has
+ *         been completed
+ */
+float deepconvnet_get_epoch_error(deepconvnet * convnet)
+{
+    return convnet->epoch.error;
+}
+
+/**
+ * @brief Creates training and test arrays which contain randomly ordered
+ *        indexes to the main images array. This tries to ensure that there
+ *        is no bias depending on the sequences of inputs during training.
+ * @param convnet Deep convnet object
+ */
+int deepconvnet_create_training_test_sets(deepconvnet * convnet)
+{
+    return deepconvnet_split(convnet, 20, DEEPLEARN_SPLIT_STRATIFIED);
+}
+
+/**
+ * @brief Reads images from a given directory and creates a deep convnet
+ * @param directory Directory containing png images
+ * @param convnet Deep convnet object
+ * @param image_width Image width
+ * @param image_height Image height
+ * @param no_of_convolutions The number of convolution layers
+ * @param max_features_per_convolution Number of features learned at
+ *        each convolution layer
+ * @param no_of_deep_layers Number of layers for the deep learner
+ * @param no_of_outputs Number of output units
+ * @param output_classes The number of output classes if the output in the
+ *        data set is a single integer value
+ * @param error_threshold Training error thresholds for each hidden layer
+ * @param random_seed Random number seed
+ * @return zero on success
+ */
+int deepconvnet_read_images(char * directory,
+                            deepconvnet * convnet,
+                            int image_width, int image_height,
+                            int no_of_convolutions,
+                            int max_features_per_convolution,
+                            int reduction_factor,
+                            int no_of_deep_layers,
+                            int no_of_outputs,
+                            int output_classes,
+                            float error_threshold[],
+                            unsigned int * random_seed)
+{
+    if (deepconvnet_init(no_of_convolutions,
+                         no_of_deep_layers,
+                         image_width, image_height, 3,
+                         max_features_per_convolution,
+                         reduction_factor,
+                         no_of_outputs, convnet,
+                         error_threshold,
+                         random_seed) != 0) {
+        return -1;
+    }
+
+    convnet->no_of_images =
+        deeplearn_load_training_images(directory, &convnet->images,
+                                       &convnet->classifications,
+                                       &convnet->classification_number,
+                                       image_width, image_height);
+    if (convnet->no_of_images <= 0) {
+        return -2;
+    }
+
+    if (deepconvnet_create_training_test_sets(convnet) != 0) {
+        return -3;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Initialises a deep convnet whose training images are read from
+ *        an image cache created with deeplearn_image_cache_create.
+ *        The cache is memory mapped, so images are only paged in when
+ *        they are used.
+ * @param cache_filename Filename of the image cache
+ * @param convnet Deep convnet object
+ * @param no_of_convolutions The number of convolution layers
+ * @param max_features_per_convolution Number of features learned at
+ *        each convolution layer
+ * @param reduction_factor Reduction factor for successive convolution layers
+ * @param no_of_deep_layers Number of layers for the deep learner
+ * @param no_of_outputs Number of output units
+ * @param output_classes The number of output classes if the output in the
+ *        data set is a single integer value
+ * @param error_threshold Training error thresholds for each hidden layer
+ * @param random_seed Random number seed
+ * @return zero on success
+ */
+int deepconvnet_read_image_cache(char * cache_filename,
+                                 deepconvnet * convnet,
+                                 int no_of_convolutions,
+                                 int max_features_per_convolution,
+                                 int reduction_factor,
+                                 int no_of_deep_layers,
+                                 int no_of_outputs,
+                                 int output_classes,
+                                 float error_threshold[],
+                                 unsigned int * random_seed)
+{
+    deeplearn_image_cache * cache;
+
+    cache = (deeplearn_image_cache*)malloc(sizeof(deeplearn_image_cache));
+    if (!cache) {
+        return -1;
+    }
+    if (deeplearn_image_cache_open(cache_filename, cache) != 0) {
+        free(cache);
+        return -2;
+    }
+
+    if (deepconvnet_init(no_of_convolutions,
+                         no_of_deep_layers,
+                         cache->width, cache->height, 3,
+                         max_features_per_convolution,
+                         reduction_factor,
+                         no_of_outputs, convnet,
+                         error_threshold,
+                         random_seed) != 0) {
+        deeplearn_image_cache_close(cache);
+        free(cache);
+        return -1;
+    }
+
+    convnet->image_cache = cache;
+    convnet->images =
+        (unsigned char**)malloc(cache->no_of_images*sizeof(unsigned char*));
+    if (!convnet->images) {
+        return -2;
+    }
+    for (int i = 0; i < cache->no_of_images; i++) {
+        convnet->images[i] = deeplearn_image_cache_get(cache, i);
     }
+    convnet->classifications = cache->classifications;
+    convnet->classification_number = cache->classification_number;
+    convnet->no_of_images = cache->no_of_images;
 
     if (deepconvnet_create_training_test_sets(convnet) != 0) {
         return -3;
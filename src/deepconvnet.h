@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <stdint.h>
 #include <omp.h>
 #include "globals.h"
 #include "deeplearn_random.h"
@@ -43,6 +44,51 @@
 #include "deeplearn_features.h"
 #include "deeplearn_pooling.h"
 #include "deeplearn_conv.h"
+#include "deeplearn_split.h"
+#include "deeplearn_model.h"
+
+/* images evaluated via the convolution layers before their fully
+   connected layers are fed forward in parallel batches */
+#define DEEPCONVNET_PERFORMANCE_CHUNK 256
+#define DEEPCONVNET_PERFORMANCE_BATCH 32
+
+/* maximum number of deep learners sharing a convolution trunk */
+#define DEEPCONVNET_MAX_HEADS 16
+
+/* file format of the convolution output cache */
+#define DEEPCONVNET_CONV_CACHE_MAGIC     "LIBDEEPC"
+#define DEEPCONVNET_CONV_CACHE_VERSION   1
+#define DEEPCONVNET_CONV_CACHE_ALIGNMENT 64
+
+/* Header at the start of a convolution output cache file. The outputs
+   follow at the given offset, one row of floats per image. */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t no_of_images;
+	uint32_t no_of_outputs;
+	uint32_t reserved;
+	uint64_t outputs_offset;
+} deepconvnet_conv_cache_header;
+
+/* Convolution outputs for every image, computed once the convolution
+   layers have been trained so that the deep layers can be trained
+   without convolving the same images again. The outputs are held in
+   memory, or within a memory mapped file if a filename is given. */
+typedef struct {
+	unsigned char enabled;
+	unsigned char valid;
+	char filename[256];
+	int no_of_images;
+	int no_of_outputs;
+	const float * outputs;
+
+	/* the file contents if it is mapped, and any allocated memory */
+	void * data;
+	size_t size;
+	int mapped;
+	void * allocation;
+} deepconvnet_conv_cache;
 
 typedef struct {
 	/* convolution layers */
@@ -62,11 +108,17 @@ typedef struct {
 	char ** classifications;
 	int * classification_number;
 
+	/* if set then the images are held within a memory mapped cache */
+	deeplearn_image_cache * image_cache;
+
 	unsigned int training_ctr;
 	unsigned int history_plot_interval;
 	char history_plot_filename[256];
 	char history_plot_title[256];
 
+	/* if set then graphs are plotted on a background thread */
+	deeplearn_history_plotter * history_plotter;
+
 	/* current backprop error */
 	float BPerror;
 
@@ -76,8 +128,49 @@ typedef struct {
 	/* array index numbers for training and test set */
 	int * training_set_index;
 	int * test_set_index;
+	int training_images;
+	int test_images;
+
+	/* sequential sampling of the training set in epochs */
+	deeplearn_epoch epoch;
+
+	/* convolution outputs computed ahead of the learner once the
+	   convolution layers are trained */
+	deeplearn_prefetch prefetch;
+
+	/* convolution outputs for each image once the convolution layers
+	   are trained */
+	deepconvnet_conv_cache conv_cache;
+
+	/* optional source of training images used instead of the images */
+	deeplearn_stream * stream;
 } deepconvnet;
 
+/* A trained convnet loaded only for classification. The deep layers
+   are held as a frozen model without momentum terms, pretraining
+   autocoders or training history. */
+typedef struct {
+	/* convolution layers */
+	deeplearn_conv * convolution;
+
+	/* weights of the deep layers after convolution */
+	deeplearn_model model;
+	bp_inference ctx;
+
+	/* output unit values of the most recent image */
+	float * outputs;
+} deepconvnet_model;
+
+/* Deep learners sharing one set of convolution layers, so that an
+   image is convolved once however many heads classify it. */
+typedef struct {
+	/* convolution layers common to every head */
+	deeplearn_conv * convolution;
+
+	int no_of_heads;
+	deeplearn * head[DEEPCONVNET_MAX_HEADS];
+} deepconvnet_heads;
+
 int deepconvnet_init(int no_of_convolutions,
 					 int no_of_deep_layers,
 					 int inputs_across,
@@ -90,6 +183,10 @@ int deepconvnet_init(int no_of_convolutions,
 					 float error_threshold[],
 					 unsigned int * random_seed);
 void deepconvnet_free(deepconvnet * convnet);
+void deepconvnet_memory_usage(deepconvnet * convnet,
+							  deeplearn_footprint * usage);
+void deepconvnet_trim_memory(deepconvnet * convnet);
+int deepconvnet_clone(deepconvnet * dest, deepconvnet * source);
 int deepconvnet_save(FILE * fp, deepconvnet * convnet);
 int deepconvnet_load(FILE * fp, deepconvnet * convnet,
 					 unsigned int * random_seed);
@@ -97,6 +194,7 @@ int deepconvnet_update_img(deepconvnet * convnet, unsigned char img[], int class
 int deepconvnet_test_img(deepconvnet * convnet, unsigned char img[]);
 void deepconvnet_set_learning_rate(deepconvnet * convnet, float rate);
 void deepconvnet_set_dropouts(deepconvnet * convnet, float dropout_percent);
+int deepconvnet_set_optimiser(deepconvnet * convnet, int type);
 int deepconvnet_read_images(char * directory,
 							deepconvnet * convnet,
 							int image_width, int image_height,
@@ -108,10 +206,49 @@ int deepconvnet_read_images(char * directory,
 							int output_classes,
 							float error_threshold[],
 							unsigned int * random_seed);
+int deepconvnet_read_image_cache(char * cache_filename,
+								 deepconvnet * convnet,
+								 int no_of_convolutions,
+								 int max_features_per_convolution,
+								 int reduction_factor,
+								 int no_of_deep_layers,
+								 int no_of_outputs,
+								 int output_classes,
+								 float error_threshold[],
+								 unsigned int * random_seed);
+int deepconvnet_create_training_test_sets(deepconvnet * convnet);
+int deepconvnet_split(deepconvnet * convnet, int test_percentage, int method);
+int deepconvnet_split_kfold(deepconvnet * convnet, int folds, int fold,
+							int method, unsigned int random_seed);
+void deepconvnet_shuffle_training(deepconvnet * convnet);
+void deepconvnet_set_epochs(deepconvnet * convnet, unsigned char enabled);
+unsigned int deepconvnet_get_epochs(deepconvnet * convnet);
+float deepconvnet_get_epoch_error(deepconvnet * convnet);
+int deepconvnet_set_prefetch(deepconvnet * convnet, int capacity);
+int deepconvnet_set_conv_cache(deepconvnet * convnet, unsigned char enabled,
+							   char * filename);
+int deepconvnet_conv_cache_build(deepconvnet * convnet);
 int deepconvnet_training(deepconvnet * convnet);
+int deepconvnet_set_stream(deepconvnet * convnet, deeplearn_stream * stream);
 int deepconvnet_plot_history(deepconvnet * convnet,
 							 int image_width, int image_height);
+void deepconvnet_set_history_plotter(deepconvnet * convnet,
+									 deeplearn_history_plotter * plotter);
 float deepconvnet_get_performance(deepconvnet * convnet);
+int deepconvnet_scan_size(deepconvnet * convnet,
+						  int img_width, int img_height, int stride,
+						  int * map_width, int * map_height);
+int deepconvnet_scan_img(deepconvnet * convnet, unsigned char img[],
+						 int img_width, int img_height, int stride,
+						 int class_map[]);
+int deepconvnet_classify_batch(deepconvnet * convnet,
+							   unsigned char ** images, int no_of_images,
+							   int classes[]);
+int deepconvnet_quantise(deepconvnet * convnet, int granularity,
+						 int calibration_images);
+float deepconvnet_get_performance_subset(deepconvnet * convnet,
+										 int subset_size,
+										 unsigned int * random_seed);
 void deepconvnet_set_output(deepconvnet * convnet, int index, float value);
 float deepconvnet_get_output(deepconvnet * convnet, int index);
 void deepconvnet_set_class(deepconvnet * convnet, int class_number);
@@ -122,5 +259,26 @@ int deepconvnet_plot_features(deepconvnet * convnet,
 							  int img_width, int img_height);
 void deepconvnet_set_learning_rate(deepconvnet * convnet, float rate);
 int deepconvnet_is_training(deepconvnet * convnet);
+int deepconvnet_model_load(FILE * fp, deepconvnet_model * convnet);
+void deepconvnet_model_free(deepconvnet_model * convnet);
+int deepconvnet_model_test_img(deepconvnet_model * convnet,
+							   unsigned char img[]);
+float deepconvnet_model_get_output(deepconvnet_model * convnet, int index);
+int deepconvnet_model_get_class(deepconvnet_model * convnet);
+int deepconvnet_heads_init(deepconvnet_heads * heads, deepconvnet * convnet);
+void deepconvnet_heads_free(deepconvnet_heads * heads);
+int deepconvnet_heads_add(deepconvnet_heads * heads, deepconvnet * convnet);
+int deepconvnet_heads_add_learner(deepconvnet_heads * heads,
+								  int no_of_deep_layers,
+								  int no_of_outputs,
+								  float error_threshold[],
+								  unsigned int * random_seed);
+int deepconvnet_heads_update_img(deepconvnet_heads * heads,
+								 unsigned char img[],
+								 int class_number[]);
+int deepconvnet_heads_test_img(deepconvnet_heads * heads, unsigned char img[]);
+float deepconvnet_heads_get_output(deepconvnet_heads * heads,
+								   int head, int index);
+int deepconvnet_heads_get_class(deepconvnet_heads * heads, int head);
 
 #endif
@@ -28,6 +28,7 @@
 */
 
 #include "deeplearn.h"
+#include "deeplearndata.h"
 
 /**
  * @brief Returns a training error threshold for the given layer
@@ -54,13 +55,14 @@ void deeplearn_set_error_threshold(deeplearn * learner, int index, float value)
 /**
  * @brief Update the learning history
  * @param learner Deep learner object
+ * @returns non-zero if an entry was added to the history
  */
-static void deeplearn_update_history(deeplearn * learner)
+static int deeplearn_update_history(deeplearn * learner)
 {
     int i;
     float error_value;
 
-    if (learner->history_step == 0) return;
+    if (learner->history_step == 0) return 0;
 
     learner->history_ctr++;
     if (learner->history_ctr >= learner->history_step) {
@@ -81,7 +83,93 @@ static void deeplearn_update_history(deeplearn * learner)
             learner->history_index /= 2;
             learner->history_step *= 2;
         }
+        return 1;
     }
+    return 0;
+}
+
+/**
+ * @brief Makes the autocoder of each hidden layer train the weights of
+ *        that layer in place, so that nothing needs to be copied once
+ *        a layer has been pretrained. Layers which were already
+ *        pretrained keep the weights of the network.
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+static int deeplearn_share_weights(deeplearn * learner)
+{
+    for (int i = 0; i < learner->net->HiddenLayers; i++) {
+        ac * autocoder = learner->autocoder[i];
+        bp_layer * layer = &learner->net->layer[i+1];
+
+        if ((autocoder->NoOfHiddens != layer->NoOfUnits) ||
+            (autocoder->NoOfInputs != layer->NoOfInputs)) {
+            return -1;
+        }
+        if (i < learner->current_hidden_layer) {
+            memcpy((void*)autocoder->weights, layer->weights,
+                   layer->NoOfUnits*layer->NoOfInputs*sizeof(float));
+        }
+        if (autocoder_share_weights(autocoder, layer->weights) != 0) {
+            return -2;
+        }
+    }
+    bp_weights_changed(learner->net);
+    return 0;
+}
+
+/**
+ * @brief Takes the network, autocoders, ranges and error thresholds of
+ *        a learner from a single arena
+ * @param learner Deep learner object
+ * @param no_of_inputs The number of input units
+ * @param hidden_layers The number of hidden layers
+ * @param no_of_outputs The number of output units
+ * @returns zero on success
+ */
+static int deeplearn_model_arena_init(deeplearn * learner,
+                                      int no_of_inputs,
+                                      int hidden_layers,
+                                      int no_of_outputs)
+{
+    size_t arena_bytes =
+        2*deeplearn_arena_bytes(no_of_inputs*sizeof(float)) +
+        2*deeplearn_arena_bytes(no_of_outputs*sizeof(float)) +
+        deeplearn_arena_bytes((hidden_layers+1)*sizeof(float)) +
+        deeplearn_arena_bytes(sizeof(bp)) +
+        deeplearn_arena_bytes(hidden_layers*sizeof(ac*)) +
+        hidden_layers*deeplearn_arena_bytes(sizeof(ac));
+    deeplearn_arena * arena = &learner->model_arena;
+
+    if (deeplearn_arena_init(arena, arena_bytes) != 0) {
+        return -1;
+    }
+    learner->input_range_min = (float*)
+        deeplearn_arena_alloc(arena, no_of_inputs*sizeof(float));
+    learner->input_range_max = (float*)
+        deeplearn_arena_alloc(arena, no_of_inputs*sizeof(float));
+    learner->output_range_min = (float*)
+        deeplearn_arena_alloc(arena, no_of_outputs*sizeof(float));
+    learner->output_range_max = (float*)
+        deeplearn_arena_alloc(arena, no_of_outputs*sizeof(float));
+    learner->error_threshold = (float*)
+        deeplearn_arena_alloc(arena, (hidden_layers+1)*sizeof(float));
+    learner->net = (bp*)deeplearn_arena_alloc(arena, sizeof(bp));
+    learner->autocoder = (ac**)
+        deeplearn_arena_alloc(arena, hidden_layers*sizeof(ac*));
+    if ((!learner->input_range_min) || (!learner->input_range_max) ||
+        (!learner->output_range_min) || (!learner->output_range_max) ||
+        (!learner->error_threshold) || (!learner->net) ||
+        ((hidden_layers > 0) && (!learner->autocoder))) {
+        return -2;
+    }
+    for (int i = 0; i < hidden_layers; i++) {
+        learner->autocoder[i] = (ac*)deeplearn_arena_alloc(arena, sizeof(ac));
+        if (!learner->autocoder[i]) {
+            return -3;
+        }
+    }
+    return 0;
 }
 
 /**
@@ -126,6 +214,17 @@ int deeplearn_init(deeplearn * learner,
     learner->indexed_test_data = 0;
     learner->indexed_test_data_samples = 0;
 
+    memset((void*)&learner->arena, '\0', sizeof(deeplearndata_arena));
+    memset((void*)&learner->cache, '\0', sizeof(deeplearn_sample_cache));
+    memset((void*)&learner->prefetch, '\0', sizeof(deeplearn_sample_prefetch));
+    memset((void*)&learner->activations, '\0',
+           sizeof(deeplearn_activation_cache));
+    learner->activations.layer = -1;
+    memset((void*)&learner->pipeline, '\0', sizeof(deeplearn_pipeline));
+    memset((void*)&learner->replicas, '\0', sizeof(bp_replicas));
+    memset((void*)&learner->exits, '\0', sizeof(deeplearn_exits));
+    deeplearn_epoch_init(&learner->epoch, 0);
+
     learner->no_of_input_fields = 0;
     learner->field_length = 0;
 
@@ -133,23 +232,17 @@ int deeplearn_init(deeplearn * learner,
     learner->history_plot_interval = 100000;
     sprintf(learner->history_plot_filename,"%s","training.png");
     sprintf(learner->history_plot_title,"%s","Training History");
-
-    learner->input_range_min = (float*)malloc(no_of_inputs*sizeof(float));
-    if (!learner->input_range_min) {
+    learner->history_plotter = 0;
+    schedule_init(&learner->schedule);
+    learner->stream = 0;
+    learner->early_stop = 0;
+    learner->early_stop_data = 0;
+
+    /* the network, autocoders and ranges are held in one arena */
+    if (deeplearn_model_arena_init(learner, no_of_inputs,
+                                   hidden_layers, no_of_outputs) != 0) {
         return -1;
     }
-    learner->input_range_max = (float*)malloc(no_of_inputs*sizeof(float));
-    if (!learner->input_range_max) {
-        return -2;
-    }
-    learner->output_range_min = (float*)malloc(no_of_outputs*sizeof(float));
-    if (!learner->output_range_min) {
-        return -3;
-    }
-    learner->output_range_max = (float*)malloc(no_of_outputs*sizeof(float));
-    if (!learner->output_range_max) {
-        return -4;
-    }
 
     for (i = 0; i < no_of_inputs; i++) {
         learner->input_range_min[i] = 99999;
@@ -163,12 +256,7 @@ int deeplearn_init(deeplearn * learner,
     /* has not been trained */
     learner->training_complete = 0;
 
-    /* create the error thresholds for each layer */
-    learner->error_threshold =
-        (float*)malloc((hidden_layers+1)*sizeof(float));
-    if (!learner->error_threshold) {
-        return -5;
-    }
+    /* set the error thresholds for each layer */
     memcpy((void*)learner->error_threshold,
            (void*)error_threshold,
            (hidden_layers+1)*sizeof(float));
@@ -184,12 +272,6 @@ int deeplearn_init(deeplearn * learner,
     /* set the current layer being trained */
     learner->current_hidden_layer = 0;
 
-    /* create the network */
-    learner->net = (bp*)malloc(sizeof(bp));
-    if (!learner->net) {
-        return -6;
-    }
-
     /* initialise the network */
     if (bp_init(learner->net,
                 no_of_inputs, no_of_hiddens,
@@ -199,15 +281,7 @@ int deeplearn_init(deeplearn * learner,
     }
 
     /* create the autocoder */
-    learner->autocoder = (ac**)malloc(sizeof(ac*)*hidden_layers);
-    if (!learner->autocoder) {
-        return -8;
-    }
     for (i = 0; i < hidden_layers; i++) {
-        learner->autocoder[i] = (ac*)malloc(sizeof(ac));
-        if (!learner->autocoder[i]) {
-            return -9;
-        }
         if (i == 0) {
             /* if this is the first hidden layer then number of inputs
                for the autocoder is the same as the number of
@@ -229,10 +303,176 @@ int deeplearn_init(deeplearn * learner,
 
     }
 
+    /* the autocoders train the hidden layers in place */
+    if (deeplearn_share_weights(learner) != 0) {
+        return -12;
+    }
+
     learner->BPerror = DEEPLEARN_UNKNOWN_ERROR;
     return 0;
 }
 
+/**
+ * @brief Creates an untrained learner with the same input fields, output
+ *        fields and ranges as another, but with a different number of
+ *        hidden units and layers, so that samples encoded for one are
+ *        valid for the other.  Every hidden layer uses the pretraining
+ *        error threshold of the first layer of the source, and the final
+ *        threshold is that of the source.
+ * @param learner Deep learner object to be created
+ * @param source Deep learner object whose fields are copied
+ * @param no_of_hiddens The number of units in each hidden layer
+ * @param hidden_layers The number of hidden layers
+ * @param random_seed Random number generator seed
+ * @returns zero on success
+ */
+int deeplearn_init_like(deeplearn * learner, deeplearn * source,
+                        int no_of_hiddens, int hidden_layers,
+                        unsigned int * random_seed)
+{
+    int no_of_inputs = source->net->NoOfInputs;
+    int no_of_outputs = source->net->NoOfOutputs;
+    float * error_threshold;
+    int i;
+
+    if ((no_of_hiddens < 1) || (hidden_layers < 1)) {
+        return -1;
+    }
+
+    error_threshold = (float*)malloc((hidden_layers+1)*sizeof(float));
+    if (!error_threshold) {
+        return -2;
+    }
+    for (i = 0; i < hidden_layers; i++) {
+        error_threshold[i] = source->error_threshold[0];
+    }
+    error_threshold[hidden_layers] =
+        source->error_threshold[source->net->HiddenLayers];
+
+    if (deeplearn_init(learner, no_of_inputs, no_of_hiddens, hidden_layers,
+                       no_of_outputs, error_threshold, random_seed) != 0) {
+        free(error_threshold);
+        return -3;
+    }
+    free(error_threshold);
+
+    if (source->field_length != 0) {
+        learner->field_length =
+            (int*)malloc(source->no_of_input_fields*sizeof(int));
+        if (!learner->field_length) {
+            deeplearn_free(learner);
+            return -4;
+        }
+        memcpy((void*)learner->field_length, (void*)source->field_length,
+               source->no_of_input_fields*sizeof(int));
+        learner->no_of_input_fields = source->no_of_input_fields;
+    }
+    memcpy((void*)learner->input_range_min, (void*)source->input_range_min,
+           no_of_inputs*sizeof(float));
+    memcpy((void*)learner->input_range_max, (void*)source->input_range_max,
+           no_of_inputs*sizeof(float));
+    memcpy((void*)learner->output_range_min, (void*)source->output_range_min,
+           no_of_outputs*sizeof(float));
+    memcpy((void*)learner->output_range_max, (void*)source->output_range_max,
+           no_of_outputs*sizeof(float));
+    return 0;
+}
+
+/**
+ * @brief Makes an independent copy of a deep learner, for example as a
+ *        replica for serving on another thread or to keep the best
+ *        network found so far during training.  The arenas of the
+ *        model are copied as blocks rather than creating the network
+ *        again.  Training and test data, caches and any history
+ *        plotter stay with the source.
+ * @param dest Deep learner object to be created
+ * @param source Deep learner object to be copied
+ * @returns zero on success
+ */
+int deeplearn_clone(deeplearn * dest, deeplearn * source)
+{
+    deeplearn_arena * to = &dest->model_arena;
+    deeplearn_arena * from = &source->model_arena;
+    int i;
+
+    *dest = *source;
+
+    /* no training/test data */
+    dest->data = 0;
+    dest->data_samples = 0;
+    dest->indexed_data = 0;
+    dest->indexed_data_samples = 0;
+    dest->training_data = 0;
+    dest->training_data_samples = 0;
+    dest->indexed_training_data = 0;
+    dest->indexed_training_data_samples = 0;
+    dest->training_data_labeled = 0;
+    dest->training_data_labeled_samples = 0;
+    dest->indexed_training_data_labeled = 0;
+    dest->indexed_training_data_labeled_samples = 0;
+    dest->test_data = 0;
+    dest->test_data_samples = 0;
+    dest->indexed_test_data = 0;
+    dest->indexed_test_data_samples = 0;
+    memset((void*)&dest->arena, '\0', sizeof(deeplearndata_arena));
+    memset((void*)&dest->cache, '\0', sizeof(deeplearn_sample_cache));
+    memset((void*)&dest->prefetch, '\0', sizeof(deeplearn_sample_prefetch));
+    memset((void*)&dest->activations, '\0',
+           sizeof(deeplearn_activation_cache));
+    dest->activations.layer = -1;
+    memset((void*)&dest->pipeline, '\0', sizeof(deeplearn_pipeline));
+    memset((void*)&dest->replicas, '\0', sizeof(bp_replicas));
+    memset((void*)&dest->exits, '\0', sizeof(deeplearn_exits));
+    dest->history_plotter = 0;
+    dest->stream = 0;
+
+    dest->field_length = 0;
+    if (source->field_length != 0) {
+        dest->field_length =
+            (int*)malloc(source->no_of_input_fields*sizeof(int));
+        if (!dest->field_length) {
+            return -1;
+        }
+        memcpy((void*)dest->field_length, (void*)source->field_length,
+               source->no_of_input_fields*sizeof(int));
+    }
+
+    if (deeplearn_arena_clone(to, from) != 0) {
+        free(dest->field_length);
+        return -2;
+    }
+    dest->input_range_min =
+        (float*)deeplearn_arena_relocate(to, from, source->input_range_min);
+    dest->input_range_max =
+        (float*)deeplearn_arena_relocate(to, from, source->input_range_max);
+    dest->output_range_min =
+        (float*)deeplearn_arena_relocate(to, from, source->output_range_min);
+    dest->output_range_max =
+        (float*)deeplearn_arena_relocate(to, from, source->output_range_max);
+    dest->error_threshold =
+        (float*)deeplearn_arena_relocate(to, from, source->error_threshold);
+    dest->net = (bp*)deeplearn_arena_relocate(to, from, source->net);
+    dest->autocoder = (ac**)deeplearn_arena_relocate(to, from, source->autocoder);
+
+    if (bp_clone(dest->net, source->net) != 0) {
+        return -3;
+    }
+    for (i = 0; i < source->net->HiddenLayers; i++) {
+        dest->autocoder[i] =
+            (ac*)deeplearn_arena_relocate(to, from, source->autocoder[i]);
+        if (autocoder_clone(dest->autocoder[i], source->autocoder[i]) != 0) {
+            return -4;
+        }
+
+        /* the autocoders train the hidden layers of the copy in place */
+        dest->autocoder[i]->weights = dest->net->layer[i+1].weights;
+    }
+    if (exits_clone(&dest->exits, &source->exits) != 0) {
+        return -5;
+    }
+    return 0;
+}
+
 /**
  * @brief Feeds the input values through the network towards the outputs
  * @param learner Deep learner object
@@ -242,6 +482,21 @@ void deeplearn_feed_forward(deeplearn * learner)
     bp_feed_forward(learner->net);
 }
 
+/**
+ * @brief Feeds the input values through the network, stopping at the
+ *        first hidden layer whose classifier head is confident enough.
+ *        The outputs are then those of the head, so deeplearn_get_class
+ *        and deeplearn_get_outputs may be used as usual.  If no heads
+ *        have been enabled the whole network is evaluated.
+ * @param learner Deep learner object
+ * @returns The hidden layer at which evaluation stopped, or the number
+ *          of hidden layers if the whole network was evaluated
+ */
+int deeplearn_feed_forward_exit(deeplearn * learner)
+{
+    return exits_feed_forward(&learner->exits, learner->net);
+}
+
 /**
  * @brief Returns true if currently training the final layer
  * @param learner Deep learner object
@@ -254,20 +509,26 @@ int deeplearn_training_last_layer(deeplearn * learner)
 }
 
 /**
- * @brief Copy autocoder hidden units to a hidden layer of the deep learner
+ * @brief Copy autocoder hidden units to a hidden layer of the deep learner.
+ *        When the autocoder shares the weights of the layer only the
+ *        biases need to be copied.
  * @param learner Deep learner object
  * @param hidden_layer Index of the layer to be copied
  */
 void copy_autocoder_to_hidden_layer(deeplearn * learner, int hidden_layer)
 {
     ac * autocoder = learner->autocoder[hidden_layer];
+    bp_layer * layer = &learner->net->layer[hidden_layer+1];
+
+    bp_weights_changed(learner->net);
+
     /* for each unit on the hidden layer */
-    for (int i = 0; i < bp_hiddens_in_layer(learner->net,hidden_layer); i++) {
-        bp_neuron * nrn  = learner->net->hiddens[hidden_layer][i];
-        nrn->bias = autocoder->bias[i];
-        memcpy((void*)nrn->weights,
-               &autocoder->weights[i*autocoder->NoOfInputs],
-               autocoder->NoOfInputs*sizeof(float));
+    for (int i = 0; i < layer->NoOfUnits; i++) {
+        layer->units[i].bias = autocoder->bias[i];
+    }
+    if (autocoder->weights != layer->weights) {
+        memcpy((void*)layer->weights, autocoder->weights,
+               layer->NoOfUnits*layer->NoOfInputs*sizeof(float));
     }
 }
 
@@ -279,33 +540,82 @@ void copy_autocoder_to_hidden_layer(deeplearn * learner, int hidden_layer)
  */
 void deeplearn_pretrain(bp * net, ac * autocoder, int current_layer)
 {
+    DEEPLEARN_STATS_START(start_time);
+
+    /* the values of the layer below, which is the input layer
+       for the first autocoder, are the inputs of the autocoder */
     bp_feed_forward_layers(net, current_layer);
-    if (current_layer > 0) {
-        /* copy the hidden unit values to the inputs
-           of the autocoder */
-        for (int i = 0; i < bp_hiddens_in_layer(net,current_layer-1); i++) {
-            float hidden_value = bp_get_hidden(net, current_layer-1, i);
-            autocoder_set_input(autocoder, i, hidden_value);
-        }
+    autocoder_set_inputs(autocoder, net->layer[current_layer].values);
+    autocoder_update(autocoder);
+    if (autocoder->shared_weights != 0) {
+        bp_weights_changed(net);
     }
-    else {
-        /* copy the input unit values to the inputs
-           of the autocoder */
-        for (int i = 0; i < net->NoOfInputs; i++) {
-            autocoder_set_input(autocoder, i,
-                                bp_get_input(net, i));
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_PRETRAIN, current_layer);
+}
+
+/**
+ * @brief Updates the learning rate schedule after a training step and
+ *        checks whether training should stop early.  A plateau while
+ *        pretraining ends the pretraining of the current layer, in the
+ *        same way as reaching its error threshold, whereas a plateau of
+ *        the whole network completes training.
+ * @param learner Deep learner object
+ * @param history_added Non-zero if an entry was just added to the
+ *        training history
+ */
+static void deeplearn_update_schedule(deeplearn * learner,
+                                      int history_added)
+{
+    deeplearn_schedule * schedule = &learner->schedule;
+    int current_layer = learner->current_hidden_layer;
+
+    if (learner->training_complete == 1) return;
+
+    if (schedule_next_step(schedule) != SCHEDULE_RUNNING) {
+        learner->training_complete = 1;
+        return;
+    }
+
+    if ((history_added != 0) &&
+        (learner->BPerror != DEEPLEARN_UNKNOWN_ERROR)) {
+        if (schedule_plateau(schedule, learner->BPerror) !=
+            SCHEDULE_RUNNING) {
+            if (current_layer < learner->net->HiddenLayers) {
+                copy_autocoder_to_hidden_layer(learner, current_layer);
+                learner->current_hidden_layer++;
+                learner->BPerror = DEEPLEARN_UNKNOWN_ERROR;
+                schedule->stopped = SCHEDULE_RUNNING;
+                schedule_reset_plateau(schedule);
+            }
+            else {
+                learner->training_complete = 1;
+                return;
+            }
+        }
+
+        if ((learner->early_stop != 0) &&
+            (learner->early_stop(learner, learner->early_stop_data) != 0)) {
+            schedule->stopped = SCHEDULE_CALLBACK;
+            learner->training_complete = 1;
+            return;
         }
     }
-    autocoder_update(autocoder);
+
+    if (schedule->enabled != 0) {
+        deeplearn_set_learning_rate(learner,
+                                    schedule_learning_rate(schedule));
+    }
 }
 
 /**
- * @brief Performs training initially using autocoders
- *        for each hidden
- *        layer and eventually for the entire network.
+ * @brief Performs a training step, with the autocoder inputs optionally
+ *        taken from cached outputs of the layer below
  * @param learner Deep learner object
+ * @param activations Outputs of the hidden layer below the one being
+ *        pretrained, or NULL to feed the current inputs forward
  */
-void deeplearn_update(deeplearn * learner)
+static void deeplearn_update_step(deeplearn * learner,
+                                  const float * activations)
 {
     float minimum_error_percent = 0;
     int current_layer = learner->current_hidden_layer;
@@ -313,6 +623,8 @@ void deeplearn_update(deeplearn * learner)
     /* only continue if training is not complete */
     if (learner->training_complete == 1) return;
 
+    DEEPLEARN_STATS_START(start_time);
+
     /* get the maximum backprop error after which a layer
        will be considered to have been trained */
     minimum_error_percent =
@@ -329,9 +641,22 @@ void deeplearn_update(deeplearn * learner)
     if (current_layer < learner->net->HiddenLayers) {
 
         /* train the autocoder for this layer */
-        deeplearn_pretrain(learner->net,
-                           learner->autocoder[current_layer],
-                           current_layer);
+        if ((activations != 0) && (current_layer > 0)) {
+            DEEPLEARN_STATS_START(pretrain_time);
+            autocoder_set_inputs(learner->autocoder[current_layer],
+                                 (float*)activations);
+            autocoder_update(learner->autocoder[current_layer]);
+            if (learner->autocoder[current_layer]->shared_weights != 0) {
+                bp_weights_changed(learner->net);
+            }
+            DEEPLEARN_STATS_STOP(pretrain_time, DEEPLEARN_STATS_PRETRAIN,
+                                 current_layer);
+        }
+        else {
+            deeplearn_pretrain(learner->net,
+                               learner->autocoder[current_layer],
+                               current_layer);
+        }
 
         /* update the backprop error value from the autocoder */
         learner->BPerror =
@@ -348,6 +673,7 @@ void deeplearn_update(deeplearn * learner)
 
             /* advance to the next hidden layer */
             learner->current_hidden_layer++;
+            schedule_reset_plateau(&learner->schedule);
 
             /* reset the error value */
             learner->BPerror = DEEPLEARN_UNKNOWN_ERROR;
@@ -355,6 +681,7 @@ void deeplearn_update(deeplearn * learner)
     }
     else {
         bp_update(learner->net,0);
+        exits_learn(&learner->exits, learner->net);
 
         /* update the backprop error value */
         learner->BPerror = learner->net->BPerrorPercent;
@@ -366,143 +693,599 @@ void deeplearn_update(deeplearn * learner)
     }
 
     /* record the history of error values */
-    deeplearn_update_history(learner);
+    deeplearn_update_schedule(learner, deeplearn_update_history(learner));
 
     /* increment the number of itterations */
     if (learner->net->itterations < UINT_MAX) {
         learner->net->itterations++;
     }
+
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_UPDATE, 0);
+    DEEPLEARN_STATS_SAMPLES(1);
 }
 
 /**
- * @brief Perform continuous unsupervised learning
- * @param learner deep learner object
+ * @brief Performs training initially using autocoders
+ *        for each hidden
+ *        layer and eventually for the entire network.
+ * @param learner Deep learner object
  */
-void deeplearn_update_continuous(deeplearn * learner)
+void deeplearn_update(deeplearn * learner)
 {
-    int i;
-
-    learner->BPerror = 0;
-
-    for (i = 0; i < learner->net->HiddenLayers; i++) {
-        /* train the autocoder for this layer */
-        deeplearn_pretrain(learner->net, learner->autocoder[i], i);
-
-        /* update the backprop error value */
-        learner->BPerror += learner->autocoder[i]->BPerrorPercent;
+    deeplearn_update_step(learner, 0);
+}
 
-        copy_autocoder_to_hidden_layer(learner, i);
+/**
+ * @brief Performs a pretraining step using the cached outputs of the
+ *        frozen layer below the one being pretrained, rather than
+ *        feeding the current inputs forward through the lower layers
+ * @param learner Deep learner object
+ * @param activations Outputs of the hidden layer below the current one,
+ *        as held within the activation cache
+ */
+void deeplearn_update_activations(deeplearn * learner,
+                                  const float * activations)
+{
+    if (deeplearn_activations_current(learner) == 0) {
+        activations = 0;
     }
-
-    learner->BPerror /= learner->net->HiddenLayers;
-
-    /* record the history of error values */
-    deeplearn_update_history(learner);
+    deeplearn_update_step(learner, activations);
 }
 
 /**
- * @brief Deallocates memory for the given deep learner object
+ * @brief Performs training using a mini-batch of samples.  During
+ *        pretraining the samples are presented to the autocoder one
+ *        at a time.  When training the whole network the batch is fed
+ *        forward together and a single weight update is applied.
  * @param learner Deep learner object
+ * @param samples Array of pointers to the samples within the batch
+ * @param no_of_samples The number of samples within the batch
+ * @returns zero on success
  */
-void deeplearn_free(deeplearn * learner)
+int deeplearn_update_batch(deeplearn * learner,
+                           deeplearndata ** samples, int no_of_samples)
 {
-    /* clear any data */
-    deeplearndata * sample = learner->data;
-    deeplearndata * prev_sample;
-    int i;
+    int i, b;
+    float * inputs, * targets;
+    bp * net = learner->net;
 
-    free(learner->input_range_min);
-    free(learner->input_range_max);
-    free(learner->output_range_min);
-    free(learner->output_range_max);
-    if (learner->field_length != 0) {
-        free(learner->field_length);
+    /* only continue if training is not complete */
+    if (learner->training_complete == 1) return 0;
+
+    if (no_of_samples < 1) {
+        return -1;
     }
 
-    while (sample != 0) {
-        prev_sample = sample;
-        sample = (deeplearndata *)sample->next;
-        if (prev_sample != 0) {
-            if (prev_sample->inputs_text != 0) {
-                /* clear any input text strings */
-                for (i = 0; i < learner->no_of_input_fields; i++) {
-                    if (prev_sample->inputs_text[i] != 0) {
-                        free(prev_sample->inputs_text[i]);
-                    }
-                }
-                free(prev_sample->inputs_text);
+    /* If there is only a single hidden layer */
+    if ((learner->current_hidden_layer == 0) &&
+        (net->HiddenLayers == 1)) {
+        learner->current_hidden_layer = 1;
+    }
+
+    /* pretraining of autocoders */
+    if (learner->current_hidden_layer < net->HiddenLayers) {
+        for (b = 0; b < no_of_samples; b++) {
+            if ((samples[b]->activations != 0) &&
+                (deeplearn_activations_current(learner) != 0)) {
+                deeplearn_update_activations(learner, samples[b]->activations);
+            }
+            else {
+                deeplearn_set_inputs(learner, samples[b]);
+                deeplearn_update(learner);
+            }
+
+            /* the remaining samples may not be labeled, so don't
+               carry on into training of the final layer */
+            if (learner->current_hidden_layer >= net->HiddenLayers) {
+                break;
             }
-            /* clear numerical fields */
-            free(prev_sample->inputs);
-            free(prev_sample->outputs);
-            free(prev_sample);
         }
+        return 0;
     }
 
-    /* free training samples */
-    deeplearndata_meta * training_sample = learner->training_data;
-    deeplearndata_meta * prev_training_sample;
-    while (training_sample != 0) {
-        prev_training_sample = training_sample;
-        training_sample = (deeplearndata_meta *)training_sample->next;
-        free(prev_training_sample);
+    inputs = (float*)malloc(no_of_samples*net->NoOfInputs*sizeof(float));
+    if (!inputs) {
+        return -2;
     }
-
-    /* free labeled training samples */
-    deeplearndata_meta * training_sample_labeled = learner->training_data_labeled;
-    deeplearndata_meta * prev_training_sample_labeled;
-    while (training_sample_labeled != 0) {
-        prev_training_sample_labeled = training_sample_labeled;
-        training_sample_labeled = (deeplearndata_meta *)training_sample_labeled->next;
-        free(prev_training_sample_labeled);
+    targets = (float*)malloc(no_of_samples*net->NoOfOutputs*sizeof(float));
+    if (!targets) {
+        free(inputs);
+        return -3;
     }
+    DEEPLEARN_STATS_ALLOC(no_of_samples*net->NoOfInputs*sizeof(float));
+    DEEPLEARN_STATS_ALLOC(no_of_samples*net->NoOfOutputs*sizeof(float));
 
-    /* free test samples */
-    deeplearndata_meta * test_sample = learner->test_data;
-    deeplearndata_meta * prev_test_sample;
-    while (test_sample != 0) {
-        prev_test_sample = test_sample;
-        test_sample = (deeplearndata_meta *)test_sample->next;
-        free(prev_test_sample);
+    /* normalise the samples into the batch */
+    for (b = 0; b < no_of_samples; b++) {
+        deeplearn_set_inputs(learner, samples[b]);
+        deeplearn_set_outputs(learner, samples[b]);
+        for (i = 0; i < net->NoOfInputs; i++) {
+            inputs[b*net->NoOfInputs + i] = net->inputs[i]->value;
+        }
+        for (i = 0; i < net->NoOfOutputs; i++) {
+            targets[b*net->NoOfOutputs + i] = net->outputs[i]->desiredValue;
+        }
     }
 
-    /* free the error thresholds */
-    free(learner->error_threshold);
-
-    /* free the autocoder */
-    for (int i = 0; i < learner->net->HiddenLayers; i++) {
-        autocoder_free(learner->autocoder[i]);
-        free(learner->autocoder[i]);
-        learner->autocoder[i] = 0;
+    if (deeplearn_update_batch_values(learner, inputs, targets,
+                                      no_of_samples) != 0) {
+        free(inputs);
+        free(targets);
+        return -4;
     }
-    free(learner->autocoder);
-
-    /* free the learner */
-    bp_free(learner->net);
-    free(learner->net);
+    free(inputs);
+    free(targets);
+    return 0;
 }
 
 /**
- * @brief Sets the value of an input to the network
+ * @brief Performs training using a mini-batch of input and target
+ *        values which have already been normalised into the range
+ *        0.0 to 1.0.  During pretraining the samples are presented to
+ *        the autocoder one at a time.  When training the whole network
+ *        the batch is fed forward together and a single weight update
+ *        is applied.
  * @param learner Deep learner object
- * @param index Index number of the input unit
- * @param value Value to set the input unit to in the range 0.0 to 1.0
+ * @param inputs Input values, one row of NoOfInputs values per sample
+ * @param targets Desired output values, one row of NoOfOutputs values
+ *        per sample
+ * @param batch_size The number of samples within the batch
+ * @returns zero on success
  */
-void deeplearn_set_input(deeplearn * learner, int index, float value)
+int deeplearn_update_batch_values(deeplearn * learner,
+                                  float * inputs, float * targets,
+                                  int batch_size)
 {
-    bp_set_input(learner->net, index, value);
-}
+    int i, b;
+    bp * net = learner->net;
 
-/**
- * @brief Sets the inputs to a text string
- *        Note that this sets the entire inputs, not a field
- * @param learner Deep learner object
- * @param text The text string
- */
-void deeplearn_set_input_text(deeplearn * learner, char * text)
-{
-    bp_set_input_text(learner->net, text);
-}
+    /* only continue if training is not complete */
+    if (learner->training_complete == 1) return 0;
+
+    if (batch_size < 1) {
+        return -1;
+    }
+
+    /* If there is only a single hidden layer */
+    if ((learner->current_hidden_layer == 0) &&
+        (net->HiddenLayers == 1)) {
+        learner->current_hidden_layer = 1;
+    }
+
+    /* pretraining of autocoders */
+    if (learner->current_hidden_layer < net->HiddenLayers) {
+        for (b = 0; b < batch_size; b++) {
+            for (i = 0; i < net->NoOfInputs; i++) {
+                bp_set_input(net, i, inputs[b*net->NoOfInputs + i]);
+            }
+            deeplearn_update(learner);
+            if (learner->current_hidden_layer >= net->HiddenLayers) {
+                break;
+            }
+        }
+        return 0;
+    }
+
+    DEEPLEARN_STATS_START(start_time);
+
+    if (bp_update_batch(net, inputs, targets, batch_size, 0) != 0) {
+        return -2;
+    }
+    exits_learn_batch(&learner->exits, net, targets, batch_size);
+
+    /* update the backprop error value */
+    learner->BPerror = net->BPerrorPercent;
+
+    /* set the training completed flag */
+    if (learner->BPerror <
+        learner->error_threshold[learner->current_hidden_layer]) {
+        learner->training_complete = 1;
+    }
+
+    /* record the history of error values */
+    deeplearn_update_schedule(learner, deeplearn_update_history(learner));
+
+    /* increment the number of itterations */
+    if (net->itterations <= UINT_MAX - batch_size) {
+        net->itterations += batch_size;
+    }
+
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_UPDATE, 0);
+    DEEPLEARN_STATS_SAMPLES(batch_size);
+    return 0;
+}
+
+/**
+ * @brief Performs training on a set of input and target values which
+ *        have already been normalised, using several threads which
+ *        update the shared weights without locks. During pretraining
+ *        the samples are presented to the autocoder one at a time, as
+ *        with deeplearn_update_batch_values.  Classifier heads added
+ *        with deeplearn_exits_enable are trained from the hidden layer
+ *        values of each batch, which the threads do not keep, so this
+ *        is not available while they are enabled.
+ * @param learner Deep learner object
+ * @param inputs Input values, one row of NoOfInputs values per sample
+ * @param targets Desired output values, one row of NoOfOutputs values
+ *        per sample
+ * @param no_of_samples The number of samples
+ * @param no_of_threads The number of threads, or zero to use the
+ *        number given by threads_count
+ * @returns zero on success
+ */
+int deeplearn_update_hogwild(deeplearn * learner,
+                             float * inputs, float * targets,
+                             int no_of_samples, int no_of_threads)
+{
+    bp * net = learner->net;
+
+    /* only continue if training is not complete */
+    if (learner->training_complete == 1) return 0;
+
+    if (no_of_samples < 1) {
+        return -1;
+    }
+    if (learner->exits.no_of_heads > 0) {
+        return -3;
+    }
+
+    /* If there is only a single hidden layer */
+    if ((learner->current_hidden_layer == 0) &&
+        (net->HiddenLayers == 1)) {
+        learner->current_hidden_layer = 1;
+    }
+
+    /* autocoders are pretrained one sample at a time */
+    if (learner->current_hidden_layer < net->HiddenLayers) {
+        return deeplearn_update_batch_values(learner, inputs, targets,
+                                             no_of_samples);
+    }
+
+    DEEPLEARN_STATS_START(start_time);
+
+    if (bp_update_hogwild(net, inputs, targets,
+                          no_of_samples, no_of_threads) != 0) {
+        return -2;
+    }
+
+    /* update the backprop error value */
+    learner->BPerror = net->BPerrorPercent;
+
+    /* set the training completed flag */
+    if (learner->BPerror <
+        learner->error_threshold[learner->current_hidden_layer]) {
+        learner->training_complete = 1;
+    }
+
+    /* record the history of error values */
+    deeplearn_update_schedule(learner, deeplearn_update_history(learner));
+
+    /* increment the number of itterations */
+    if (net->itterations <= UINT_MAX - no_of_samples) {
+        net->itterations += no_of_samples;
+    }
+
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_UPDATE, 0);
+    DEEPLEARN_STATS_SAMPLES(no_of_samples);
+    return 0;
+}
+
+/**
+ * @brief Applies gradients summed by bp_batch_gradients over one or
+ *        more parts of a mini-batch to the final training stage of the
+ *        learner, such as those combined from several replicas
+ * @param learner Deep learner object
+ * @param gradients Sums of the gradients, bp_gradients_length in size
+ * @returns zero on success
+ */
+int deeplearn_apply_gradients(deeplearn * learner, float * gradients)
+{
+    bp * net = learner->net;
+    int samples;
+
+    /* only continue if training is not complete */
+    if (learner->training_complete == 1) return 0;
+
+    samples = (int)gradients[bp_gradients_length(net) - BP_GRADIENT_STATS + 2];
+
+    DEEPLEARN_STATS_START(start_time);
+
+    if (bp_apply_gradients(net, gradients,
+                           learner->current_hidden_layer) != 0) {
+        return -1;
+    }
+
+    /* update the backprop error value */
+    learner->BPerror = net->BPerrorPercent;
+
+    /* set the training completed flag */
+    if (learner->BPerror <
+        learner->error_threshold[learner->current_hidden_layer]) {
+        learner->training_complete = 1;
+    }
+
+    /* record the history of error values */
+    deeplearn_update_schedule(learner, deeplearn_update_history(learner));
+
+    /* increment the number of itterations */
+    if (net->itterations <= UINT_MAX - samples) {
+        net->itterations += samples;
+    }
+
+    DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_UPDATE, 0);
+    DEEPLEARN_STATS_SAMPLES(samples);
+    return 0;
+}
+
+/**
+ * @brief Performs one step of pipelined continuous learning, in which
+ *        every autocoder trains concurrently. The first layer trains on
+ *        the current inputs and each later layer on the encodings which
+ *        the layer below produced during the previous step, so a layer
+ *        begins training once the pipeline has filled up to it
+ * @param learner deep learner object
+ */
+static void deeplearn_update_pipelined(deeplearn * learner)
+{
+    deeplearn_pipeline * pipeline = &learner->pipeline;
+    bp * net = learner->net;
+    int layers = net->HiddenLayers;
+    int active = 0;
+    int i;
+
+    /* set the inputs of each autocoder before any of them are
+       updated, so that the layers are independent of each other */
+    for (i = 0; i < net->NoOfInputs; i++) {
+        autocoder_set_input(learner->autocoder[0], i, bp_get_input(net, i));
+    }
+    for (i = 1; i < layers; i++) {
+        if (pipeline->updates < (unsigned int)i) break;
+        autocoder_set_inputs(learner->autocoder[i],
+                             pipeline->encodings[i-1]);
+    }
+    active = i;
+
+#pragma omp parallel for num_threads(threads_count()) schedule(dynamic)
+    for (i = 0; i < active; i++) {
+        ac * autocoder = learner->autocoder[i];
+
+        DEEPLEARN_STATS_START(start_time);
+        autocoder_update(autocoder);
+        DEEPLEARN_STATS_STOP(start_time, DEEPLEARN_STATS_PRETRAIN, i);
+
+        copy_autocoder_to_hidden_layer(learner, i);
+
+        /* encodings for the next layer to train on, without dropouts */
+        if (i < layers - 1) {
+            autocoder_encode_inputs(autocoder, autocoder->inputs,
+                                    pipeline->encodings[i]);
+        }
+    }
+
+    learner->BPerror = 0;
+    for (i = 0; i < active; i++) {
+        learner->BPerror += learner->autocoder[i]->BPerrorPercent;
+    }
+    learner->BPerror /= active;
+
+    if (pipeline->updates < UINT_MAX) {
+        pipeline->updates++;
+    }
+
+    /* record the history of error values */
+    deeplearn_update_history(learner);
+}
+
+/**
+ * @brief Enables or disables pipelined continuous learning
+ * @param learner deep learner object
+ * @param enabled Non-zero to enable pipelining
+ * @returns zero on success
+ */
+int deeplearn_set_pipelined(deeplearn * learner, unsigned char enabled)
+{
+    deeplearn_pipeline * pipeline = &learner->pipeline;
+    int layers = learner->net->HiddenLayers;
+    int i;
+
+    if (enabled == pipeline->enabled) return 0;
+
+    if (enabled == 0) {
+        for (i = 0; i < layers; i++) {
+            free(pipeline->encodings[i]);
+        }
+        free(pipeline->encodings);
+        memset((void*)pipeline, '\0', sizeof(deeplearn_pipeline));
+        return 0;
+    }
+
+    pipeline->encodings = (float**)malloc(layers*sizeof(float*));
+    if (!pipeline->encodings) return -1;
+    for (i = 0; i < layers; i++) {
+        pipeline->encodings[i] =
+            (float*)calloc(learner->autocoder[i]->NoOfHiddens, sizeof(float));
+        if (!pipeline->encodings[i]) {
+            while (i > 0) free(pipeline->encodings[--i]);
+            free(pipeline->encodings);
+            pipeline->encodings = 0;
+            return -2;
+        }
+    }
+    pipeline->updates = 0;
+    pipeline->enabled = 1;
+    return 0;
+}
+
+/**
+ * @brief Perform continuous unsupervised learning
+ * @param learner deep learner object
+ */
+void deeplearn_update_continuous(deeplearn * learner)
+{
+    int i;
+
+    if (learner->pipeline.enabled) {
+        deeplearn_update_pipelined(learner);
+        return;
+    }
+
+    learner->BPerror = 0;
+
+    for (i = 0; i < learner->net->HiddenLayers; i++) {
+        /* train the autocoder for this layer */
+        deeplearn_pretrain(learner->net, learner->autocoder[i], i);
+
+        /* update the backprop error value */
+        learner->BPerror += learner->autocoder[i]->BPerrorPercent;
+
+        copy_autocoder_to_hidden_layer(learner, i);
+    }
+
+    learner->BPerror /= learner->net->HiddenLayers;
+
+    /* record the history of error values */
+    deeplearn_update_history(learner);
+}
+
+/**
+ * @brief Deallocates memory for the given deep learner object
+ * @param learner Deep learner object
+ */
+void deeplearn_free(deeplearn * learner)
+{
+    /* clear any data */
+    deeplearndata * sample = learner->data;
+    deeplearndata * prev_sample;
+    int i;
+
+    /* the workers read the samples, so they stop first */
+    deeplearn_set_prefetch(learner, 0, 0);
+    deeplearn_cache_disable(learner);
+    deeplearn_activations_disable(learner);
+
+    deeplearn_set_pipelined(learner, 0);
+    bp_replicas_free(&learner->replicas);
+    exits_free(&learner->exits);
+
+    if (learner->field_length != 0) {
+        free(learner->field_length);
+    }
+
+    if (learner->arena.sample != 0) {
+        /* samples within an arena are freed as a whole */
+        deeplearndata_arena_free(&learner->arena);
+        sample = 0;
+    }
+
+    while (sample != 0) {
+        prev_sample = sample;
+        sample = (deeplearndata *)sample->next;
+        if (prev_sample != 0) {
+            if (prev_sample->inputs_text != 0) {
+                /* clear any input text strings */
+                for (i = 0; i < learner->no_of_input_fields; i++) {
+                    if (prev_sample->inputs_text[i] != 0) {
+                        free(prev_sample->inputs_text[i]);
+                    }
+                }
+                free(prev_sample->inputs_text);
+            }
+            /* clear numerical fields */
+            free(prev_sample->inputs);
+            free(prev_sample->outputs);
+            free(prev_sample);
+        }
+    }
+
+    /* free training samples */
+    deeplearndata_meta * training_sample = learner->training_data;
+    deeplearndata_meta * prev_training_sample;
+    while (training_sample != 0) {
+        prev_training_sample = training_sample;
+        training_sample = (deeplearndata_meta *)training_sample->next;
+        free(prev_training_sample);
+    }
+
+    /* free labeled training samples */
+    deeplearndata_meta * training_sample_labeled = learner->training_data_labeled;
+    deeplearndata_meta * prev_training_sample_labeled;
+    while (training_sample_labeled != 0) {
+        prev_training_sample_labeled = training_sample_labeled;
+        training_sample_labeled = (deeplearndata_meta *)training_sample_labeled->next;
+        free(prev_training_sample_labeled);
+    }
+
+    /* free test samples */
+    deeplearndata_meta * test_sample = learner->test_data;
+    deeplearndata_meta * prev_test_sample;
+    while (test_sample != 0) {
+        prev_test_sample = test_sample;
+        test_sample = (deeplearndata_meta *)test_sample->next;
+        free(prev_test_sample);
+    }
+
+    /* free the autocoder */
+    for (int i = 0; i < learner->net->HiddenLayers; i++) {
+        autocoder_free(learner->autocoder[i]);
+    }
+
+    /* free the learner */
+    bp_free(learner->net);
+
+    /* the network, autocoders, ranges and error thresholds */
+    deeplearn_arena_free(&learner->model_arena);
+    learner->net = 0;
+    learner->autocoder = 0;
+}
+
+/**
+ * @brief Sets the value of an input to the network
+ * @param learner Deep learner object
+ * @param index Index number of the input unit
+ * @param value Value to set the input unit to in the range 0.0 to 1.0
+ */
+void deeplearn_set_input(deeplearn * learner, int index, float value)
+{
+    bp_set_input(learner->net, index, value);
+}
+
+/**
+ * @brief Sets the inputs to a text string
+ *        Note that this sets the entire inputs, not a field
+ * @param learner Deep learner object
+ * @param text The text string
+ */
+void deeplearn_set_input_text(deeplearn * learner, char * text)
+{
+    bp_set_input_text(learner->net, text);
+}
+
+/**
+ * @brief Returns whether the sample cache may be used, which is the case
+ *        if it has been built using the current field ranges
+ * @param learner Deep learner object
+ * @returns non-zero if the cache is current
+ */
+static int deeplearn_cache_current(deeplearn * learner)
+{
+    deeplearn_sample_cache * cache = &learner->cache;
+
+    if (cache->valid == 0) {
+        return 0;
+    }
+    if ((memcmp(cache->input_range_min, learner->input_range_min,
+                cache->no_of_input_fields*sizeof(float)) != 0) ||
+        (memcmp(cache->input_range_max, learner->input_range_max,
+                cache->no_of_input_fields*sizeof(float)) != 0) ||
+        (memcmp(cache->output_range_min, learner->output_range_min,
+                cache->no_of_outputs*sizeof(float)) != 0) ||
+        (memcmp(cache->output_range_max, learner->output_range_max,
+                cache->no_of_outputs*sizeof(float)) != 0)) {
+        cache->valid = 0;
+        return 0;
+    }
+    return 1;
+}
 
 /**
  * @brief Sets inputs from the given data sample.
@@ -515,6 +1298,15 @@ void deeplearn_set_inputs(deeplearn * learner, deeplearndata * sample)
     float value, range, normalised;
     int pos = 0;
 
+    if ((sample->encoded_inputs != 0) && (deeplearn_cache_current(learner))) {
+        for (int i = 0; i < learner->net->NoOfInputs; i++) {
+            if (learner->cache.input_set[i] != 0) {
+                learner->net->inputs[i]->value = sample->encoded_inputs[i];
+            }
+        }
+        return;
+    }
+
     for (int i = 0; i < learner->no_of_input_fields; i++) {
         if (learner->field_length[i] > 0) {
             /* text value */
@@ -525,34 +1317,118 @@ void deeplearn_set_inputs(deeplearn * learner, deeplearndata * sample)
             pos += learner->field_length[i];
         }
         else {
-            /* numerical */
-            value = sample->inputs[i];
-            range = learner->input_range_max[i] - learner->input_range_min[i];
-            if (range > 0) {
-                normalised = (((value - learner->input_range_min[i])/range)*0.5) + 0.25;
-                deeplearn_set_input(learner, pos, normalised);
-            }
-            pos++;
+            /* numerical */
+            value = sample->inputs[i];
+            range = learner->input_range_max[i] - learner->input_range_min[i];
+            if (range > 0) {
+                normalised = (((value - learner->input_range_min[i])/range)*0.5) + 0.25;
+                deeplearn_set_input(learner, pos, normalised);
+            }
+            pos++;
+        }
+    }
+}
+
+/**
+ * @brief Encodes the inputs of a data sample into a vector of input unit
+ *        values, in the same way as deeplearn_set_inputs but without
+ *        changing the state of the learner, so that samples may be
+ *        encoded on several threads at once. Units which
+ *        deeplearn_set_inputs would leave unchanged take their current
+ *        values.
+ * @param learner Deep learner object
+ * @param sample The data sample
+ * @param encoded Returned input unit values, NoOfInputs in length
+ */
+void deeplearn_encode_inputs(deeplearn * learner, deeplearndata * sample,
+                             float * encoded)
+{
+    float value, range;
+    int i, pos = 0;
+
+    for (i = 0; i < learner->net->NoOfInputs; i++) {
+        encoded[i] = learner->net->inputs[i]->value;
+    }
+
+    for (i = 0; i < learner->no_of_input_fields; i++) {
+        if (learner->field_length[i] > 0) {
+            /* text value */
+            enc_text_to_floats(sample->inputs_text[i], encoded,
+                               learner->net->NoOfInputs,
+                               pos, learner->field_length[i]/CHAR_BITS);
+            pos += learner->field_length[i];
+        }
+        else {
+            /* numerical */
+            value = sample->inputs[i];
+            range = learner->input_range_max[i] - learner->input_range_min[i];
+            if (range > 0) {
+                encoded[pos] =
+                    (((value - learner->input_range_min[i])/range)*0.5) + 0.25;
+            }
+            pos++;
+        }
+    }
+}
+
+/**
+ * @brief Sets a numeric value for the given input field
+ * @param learner Deep learner object
+ * @param fieldindex Index number of the input field.
+ *        This is not necessarily the same as the input index
+ * @param value Value to set the input unit to in the range 0.0 to 1.0
+ * @returns zero on success
+ */
+int deeplearn_set_input_field(deeplearn * learner, int fieldindex, float value)
+{
+    int i, pos=0;
+
+    if (learner->no_of_input_fields == 0) {
+        /* No fields are defined
+           Assume you meant fieldindex to be the input index */
+        bp_set_input(learner->net, fieldindex, value);
+        return -1;
+    }
+
+    if (learner->field_length == 0) {
+        /* no field length array defined */
+        return -2;
+    }
+
+    if (learner->field_length[fieldindex] > 0) {
+        /* this is a text field */
+        return -3;
+    }
+
+    /* get the offset (first input unit index) of the input field */
+    for (i = 0; i < fieldindex; i++) {
+        if (learner->field_length[i] == 0) {
+            pos++;
+        }
+        else {
+            pos += learner->field_length[i];
         }
     }
+
+    /* set the value */
+    bp_set_input(learner->net, pos, value);
+    return 0;
 }
 
 /**
- * @brief Sets a numeric value for the given input field
+ * @brief Sets a text value for the given input field
  * @param learner Deep learner object
  * @param fieldindex Index number of the input field.
  *        This is not necessarily the same as the input index
- * @param value Value to set the input unit to in the range 0.0 to 1.0
+ * @param text Text value for the field
  * @returns zero on success
  */
-int deeplearn_set_input_field(deeplearn * learner, int fieldindex, float value)
+int deeplearn_set_input_field_text(deeplearn * learner, int fieldindex, char * text)
 {
     int i, pos=0;
 
     if (learner->no_of_input_fields == 0) {
-        /* No fields are defined
-           Assume you meant fieldindex to be the input index */
-        bp_set_input(learner->net, fieldindex, value);
+        /* No fields are defined */
         return -1;
     }
 
@@ -561,7 +1437,7 @@ int deeplearn_set_input_field(deeplearn * learner, int fieldindex, float value)
         return -2;
     }
 
-    if (learner->field_length[fieldindex] > 0) {
+    if (learner->field_length[fieldindex] == 0) {
         /* this is a text field */
         return -3;
     }
@@ -575,102 +1451,749 @@ int deeplearn_set_input_field(deeplearn * learner, int fieldindex, float value)
             pos += learner->field_length[i];
         }
     }
-
-    /* set the value */
-    bp_set_input(learner->net, pos, value);
+
+    /* set the value */
+    enc_text_to_binary(text,
+                       learner->net->inputs,
+                       learner->net->NoOfInputs, pos,
+                       learner->field_length[fieldindex]/CHAR_BITS);
+    return 0;
+}
+
+/**
+ * @brief Sets the value of an output unit
+ * @param learner Deep learner object
+ * @param index Index number of the output unit
+ * @param value Value to set the output unit to in the range 0.0 to 1.0
+ */
+void deeplearn_set_output(deeplearn * learner, int index, float value)
+{
+    bp_set_output(learner->net, index, value);
+}
+
+/**
+ * @brief Sets outputs from the given data sample.
+ *        The sample can contain arbitrary floating point values, so these
+ *        need to be normalised into a 0.25-0.75 range
+ * @param learner Deep learner object
+ * @param sample The data sample from which to obtain the output values
+ */
+void deeplearn_set_outputs(deeplearn * learner, deeplearndata * sample)
+{
+    if ((sample->encoded_outputs != 0) && (deeplearn_cache_current(learner))) {
+        for (int i = 0; i < learner->net->NoOfOutputs; i++) {
+            if (learner->cache.output_set[i] != 0) {
+                learner->net->outputs[i]->desiredValue =
+                    sample->encoded_outputs[i];
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < learner->net->NoOfOutputs; i++) {
+        float value = sample->outputs[i];
+        float range = learner->output_range_max[i] - learner->output_range_min[i];
+        if (range > 0) {
+            float normalised = (((value - learner->output_range_min[i])/range)*0.5) + 0.25;
+            deeplearn_set_output(learner, i, normalised);
+        }
+    }
+}
+
+/**
+ * @brief Encodes the outputs of a data sample into a vector of desired
+ *        output unit values, in the same way as deeplearn_set_outputs
+ *        but without changing the state of the learner, so that samples
+ *        may be encoded on several threads at once
+ * @param learner Deep learner object
+ * @param sample The data sample
+ * @param encoded Returned desired output values, NoOfOutputs in length
+ */
+void deeplearn_encode_outputs(deeplearn * learner, deeplearndata * sample,
+                              float * encoded)
+{
+    float value, range;
+    int i;
+
+    for (i = 0; i < learner->net->NoOfOutputs; i++) {
+        encoded[i] = learner->net->outputs[i]->desiredValue;
+        value = sample->outputs[i];
+        range = learner->output_range_max[i] - learner->output_range_min[i];
+        if (range > 0) {
+            encoded[i] =
+                (((value - learner->output_range_min[i])/range)*0.5) + 0.25;
+        }
+    }
+}
+
+/**
+ * @brief Returns the values of outputs within their normal range
+ * @param learner Deep learner object
+ * @param outputs The returned output values
+ */
+void deeplearn_get_outputs(deeplearn * learner, float * outputs)
+{
+    for (int i = 0; i < learner->net->NoOfOutputs; i++) {
+        float value = deeplearn_get_output(learner, i);
+        float range = learner->output_range_max[i] - learner->output_range_min[i];
+        if (range > 0) {
+            outputs[i] =
+                (((value - 0.25f)/0.5f)*range) + learner->output_range_min[i];
+        }
+    }
+}
+
+/**
+ * @brief Finds the units which are set from a data sample. Units which
+ *        deeplearn_set_inputs and deeplearn_set_outputs leave untouched,
+ *        because the field has no range, are not set.
+ * @param learner Deep learner object
+ * @param input_set Returned flags, NoOfInputs in length
+ * @param output_set Returned flags, NoOfOutputs in length
+ */
+static void deeplearn_encoded_units(deeplearn * learner,
+                                    unsigned char * input_set,
+                                    unsigned char * output_set)
+{
+    int i, pos = 0;
+
+    memset((void*)input_set, 0, learner->net->NoOfInputs);
+    for (i = 0; i < learner->no_of_input_fields; i++) {
+        if (learner->field_length[i] > 0) {
+            memset((void*)&input_set[pos], 1, learner->field_length[i]);
+            pos += learner->field_length[i];
+        }
+        else {
+            if (learner->input_range_max[i] - learner->input_range_min[i] > 0) {
+                input_set[pos] = 1;
+            }
+            pos++;
+        }
+    }
+    for (i = 0; i < learner->net->NoOfOutputs; i++) {
+        output_set[i] =
+            (learner->output_range_max[i] - learner->output_range_min[i] > 0);
+    }
+}
+
+/**
+ * @brief Frees the arrays used by the sample cache, keeping its
+ *        enabled state
+ * @param learner Deep learner object
+ */
+static void deeplearn_cache_release(deeplearn * learner)
+{
+    deeplearn_sample_cache * cache = &learner->cache;
+    deeplearndata * sample = learner->data;
+
+    while (sample != 0) {
+        sample->encoded_inputs = 0;
+        sample->encoded_outputs = 0;
+        sample = (deeplearndata*)sample->next;
+    }
+    free(cache->inputs);
+    free(cache->outputs);
+    free(cache->input_set);
+    free(cache->output_set);
+    free(cache->input_range_min);
+    free(cache->input_range_max);
+    free(cache->output_range_min);
+    free(cache->output_range_max);
+    cache->inputs = 0;
+    cache->outputs = 0;
+    cache->input_set = 0;
+    cache->output_set = 0;
+    cache->input_range_min = 0;
+    cache->input_range_max = 0;
+    cache->output_range_min = 0;
+    cache->output_range_max = 0;
+    cache->samples = 0;
+    cache->valid = 0;
+}
+
+/**
+ * @brief Encodes every data sample into the sample cache using the
+ *        current field ranges
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+static int deeplearn_cache_build(deeplearn * learner)
+{
+    deeplearn_sample_cache * cache = &learner->cache;
+    bp * net = learner->net;
+    deeplearndata * sample;
+    int i, s, fields = learner->no_of_input_fields;
+
+    deeplearn_cache_release(learner);
+    if (learner->data_samples < 1) {
+        return 0;
+    }
+
+    cache->samples = learner->data_samples;
+    cache->no_of_input_fields = fields;
+    cache->no_of_outputs = net->NoOfOutputs;
+    cache->inputs =
+        (float*)malloc(cache->samples*net->NoOfInputs*sizeof(float));
+    cache->outputs =
+        (float*)malloc(cache->samples*net->NoOfOutputs*sizeof(float));
+    cache->input_set = (unsigned char*)malloc(net->NoOfInputs);
+    cache->output_set = (unsigned char*)malloc(net->NoOfOutputs);
+    cache->input_range_min = (float*)malloc((fields+1)*sizeof(float));
+    cache->input_range_max = (float*)malloc((fields+1)*sizeof(float));
+    cache->output_range_min =
+        (float*)malloc(net->NoOfOutputs*sizeof(float));
+    cache->output_range_max =
+        (float*)malloc(net->NoOfOutputs*sizeof(float));
+    if ((!cache->inputs) || (!cache->outputs) ||
+        (!cache->input_set) || (!cache->output_set) ||
+        (!cache->input_range_min) || (!cache->input_range_max) ||
+        (!cache->output_range_min) || (!cache->output_range_max)) {
+        deeplearn_cache_release(learner);
+        return -1;
+    }
+    memcpy((void*)cache->input_range_min, learner->input_range_min,
+           fields*sizeof(float));
+    memcpy((void*)cache->input_range_max, learner->input_range_max,
+           fields*sizeof(float));
+    memcpy((void*)cache->output_range_min, learner->output_range_min,
+           net->NoOfOutputs*sizeof(float));
+    memcpy((void*)cache->output_range_max, learner->output_range_max,
+           net->NoOfOutputs*sizeof(float));
+
+    deeplearn_encoded_units(learner, cache->input_set, cache->output_set);
+
+    /* encode each sample via the network units */
+    sample = learner->data;
+    for (s = 0; s < cache->samples; s++, sample = (deeplearndata*)sample->next) {
+        float * inputs = &cache->inputs[s*net->NoOfInputs];
+        float * outputs = &cache->outputs[s*net->NoOfOutputs];
+
+        deeplearn_set_inputs(learner, sample);
+        deeplearn_set_outputs(learner, sample);
+        for (i = 0; i < net->NoOfInputs; i++) {
+            inputs[i] = net->inputs[i]->value;
+        }
+        for (i = 0; i < net->NoOfOutputs; i++) {
+            outputs[i] = net->outputs[i]->desiredValue;
+        }
+        sample->encoded_inputs = inputs;
+        sample->encoded_outputs = outputs;
+    }
+    cache->valid = 1;
+    return 0;
+}
+
+/**
+ * @brief Enables a cache of encoded data samples, so that training and
+ *        testing do not need to normalise and encode each sample again.
+ *        The cache is rebuilt by deeplearn_cache_update when the field
+ *        ranges or the number of samples change.
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+int deeplearn_cache_enable(deeplearn * learner)
+{
+    learner->cache.enabled = 1;
+    if (deeplearn_cache_build(learner) != 0) {
+        learner->cache.enabled = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Disables the sample cache and frees its memory
+ * @param learner Deep learner object
+ */
+void deeplearn_cache_disable(deeplearn * learner)
+{
+    deeplearn_cache_release(learner);
+    learner->cache.enabled = 0;
+}
+
+/**
+ * @brief Marks the sample cache as stale. This is only needed if samples
+ *        are altered in place, since range changes are detected.
+ * @param learner Deep learner object
+ */
+void deeplearn_cache_invalidate(deeplearn * learner)
+{
+    learner->cache.valid = 0;
+}
+
+/**
+ * @brief Rebuilds the sample cache if it is enabled and stale
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+int deeplearn_cache_update(deeplearn * learner)
+{
+    if (learner->cache.enabled == 0) {
+        return 0;
+    }
+    if ((learner->cache.samples == learner->data_samples) &&
+        (deeplearn_cache_current(learner))) {
+        return 0;
+    }
+    return deeplearn_cache_build(learner);
+}
+
+/**
+ * @brief Enables caching of the outputs of frozen hidden layers during
+ *        pretraining. Each time a hidden layer has been pretrained its
+ *        outputs are computed once for every training sample, and
+ *        pretraining of the next layer reads them from the cache.
+ * @param learner Deep learner object
+ */
+void deeplearn_activations_enable(deeplearn * learner)
+{
+    learner->activations.enabled = 1;
+}
+
+/**
+ * @brief Frees the cached layer outputs, keeping the enabled state.
+ *        They are computed again when the next hidden layer has been
+ *        pretrained.
+ * @param learner Deep learner object
+ */
+void deeplearn_activations_release(deeplearn * learner)
+{
+    deeplearn_activation_cache * cache = &learner->activations;
+    deeplearndata * sample = learner->data;
+
+    while (sample != 0) {
+        sample->activations = 0;
+        sample = (deeplearndata*)sample->next;
+    }
+    free(cache->values);
+    cache->values = 0;
+    cache->layer = -1;
+    cache->samples = 0;
+    cache->width = 0;
+}
+
+/**
+ * @brief Disables the activation cache and frees its memory
+ * @param learner Deep learner object
+ */
+void deeplearn_activations_disable(deeplearn * learner)
+{
+    deeplearn_activations_release(learner);
+    learner->activations.enabled = 0;
+}
+
+/**
+ * @brief Returns whether the activation cache holds the outputs of the
+ *        layer below the hidden layer currently being pretrained
+ * @param learner Deep learner object
+ * @returns non-zero if the cache may be used
+ */
+int deeplearn_activations_current(deeplearn * learner)
+{
+    deeplearn_activation_cache * cache = &learner->activations;
+
+    return ((cache->enabled != 0) && (cache->layer >= 0) &&
+            (cache->layer == learner->current_hidden_layer - 1) &&
+            (learner->current_hidden_layer < learner->net->HiddenLayers));
+}
+
+/**
+ * @brief Returns the memory used by a deep learner, broken down into
+ *        weights, optimiser state, activations, data sets and history
+ * @param learner Deep learner object
+ * @param usage Returned memory footprint
+ */
+void deeplearn_memory_usage(deeplearn * learner, deeplearn_footprint * usage)
+{
+    deeplearn_footprint part;
+    size_t arena = deeplearn_arena_allocated(&learner->model_arena);
+    size_t counted = sizeof(bp);
+    int i;
+
+    deeplearn_footprint_clear(usage);
+    usage->history = sizeof(learner->history) +
+        sizeof(learner->history_plot_filename) +
+        sizeof(learner->history_plot_title);
+    usage->other = sizeof(deeplearn) - usage->history;
+    if (learner->net == 0) return;
+
+    /* the network and autocoders are within the model arena */
+    bp_memory_usage(learner->net, &part);
+    deeplearn_footprint_add(usage, &part);
+    for (i = 0; i < learner->net->HiddenLayers; i++) {
+        autocoder_memory_usage(learner->autocoder[i], &part);
+        deeplearn_footprint_add(usage, &part);
+        counted += sizeof(ac);
+    }
+
+    /* ranges, error thresholds and alignment */
+    if (arena > counted) {
+        usage->other += arena - counted;
+    }
+
+    for (i = 0; i < learner->replicas.no_of_replicas; i++) {
+        bp_memory_usage(learner->replicas.replica[i], &part);
+        deeplearn_footprint_add(usage, &part);
+    }
+    exits_memory_usage(&learner->exits, &part);
+    deeplearn_footprint_add(usage, &part);
+
+    deeplearndata_memory_usage(learner, &part);
+    deeplearn_footprint_add(usage, &part);
+
+    usage->activations += (size_t)learner->activations.samples*
+        learner->activations.width*sizeof(float);
+    if (learner->pipeline.encodings != 0) {
+        usage->activations +=
+            (size_t)learner->net->HiddenLayers*sizeof(float*);
+        for (i = 0; i < learner->net->HiddenLayers; i++) {
+            usage->activations +=
+                (size_t)learner->autocoder[i]->NoOfHiddens*sizeof(float);
+        }
+    }
+}
+
+/**
+ * @brief Frees buffers which are only needed to speed up training, so
+ *        that a learner uses less memory while it is being served or
+ *        kept idle.  The mini-batch arrays of the network and the sample
+ *        and activation caches are built again when next needed.
+ * @param learner Deep learner object
+ */
+void deeplearn_trim_memory(deeplearn * learner)
+{
+    if (learner->net == 0) return;
+
+    bp_trim_memory(learner->net);
+    deeplearn_cache_release(learner);
+    deeplearn_activations_release(learner);
+}
+
+/**
+ * @brief Encodes a training sample within the prefetch queue. This is
+ *        called on the worker threads, so it only reads the sample and
+ *        the field ranges copied by deeplearn_update_prefetch.
+ *        Units which deeplearn_set_inputs would leave unchanged are
+ *        not written.
+ * @param context Deep learner object
+ * @param slot The slot containing the sample
+ * @returns zero on success
+ */
+static int deeplearn_prefetch_encode(void * context,
+                                     deeplearn_prefetch_slot * slot)
+{
+    deeplearn * learner = (deeplearn*)context;
+    deeplearn_sample_prefetch * prefetch = &learner->prefetch;
+    deeplearndata * sample = (deeplearndata*)slot->sample;
+    int i, pos = 0;
+
+    if (sample == 0) {
+        return -1;
+    }
+
+    for (i = 0; i < prefetch->no_of_input_fields; i++) {
+        if (learner->field_length[i] > 0) {
+            /* text value */
+            enc_text_to_floats(sample->inputs_text[i], slot->inputs,
+                               learner->net->NoOfInputs,
+                               pos, learner->field_length[i]/CHAR_BITS);
+            pos += learner->field_length[i];
+        }
+        else {
+            /* numerical */
+            float range =
+                prefetch->input_range_max[i] - prefetch->input_range_min[i];
+            if (range > 0) {
+                slot->inputs[pos] =
+                    (((sample->inputs[i] - prefetch->input_range_min[i])/
+                      range)*0.5) + 0.25;
+            }
+            pos++;
+        }
+    }
+
+    for (i = 0; i < prefetch->no_of_outputs; i++) {
+        float range =
+            prefetch->output_range_max[i] - prefetch->output_range_min[i];
+        if (range > 0) {
+            slot->targets[i] =
+                (((sample->outputs[i] - prefetch->output_range_min[i])/
+                  range)*0.5) + 0.25;
+        }
+    }
     return 0;
 }
 
 /**
- * @brief Sets a text value for the given input field
+ * @brief Frees the arrays used to encode prefetched samples
  * @param learner Deep learner object
- * @param fieldindex Index number of the input field.
- *        This is not necessarily the same as the input index
- * @param text Text value for the field
+ */
+static void deeplearn_sample_prefetch_free(deeplearn * learner)
+{
+    deeplearn_sample_prefetch * prefetch = &learner->prefetch;
+
+    deeplearn_prefetch_free(&prefetch->queue);
+    free(prefetch->input_set);
+    free(prefetch->output_set);
+    free(prefetch->input_range_min);
+    free(prefetch->input_range_max);
+    free(prefetch->output_range_min);
+    free(prefetch->output_range_max);
+    memset((void*)prefetch, '\0', sizeof(deeplearn_sample_prefetch));
+}
+
+/**
+ * @brief Copies the current field ranges, and the units which they set,
+ *        for use by the prefetch workers
+ * @param learner Deep learner object
+ */
+static void deeplearn_prefetch_ranges(deeplearn * learner)
+{
+    deeplearn_sample_prefetch * prefetch = &learner->prefetch;
+    int fields = prefetch->no_of_input_fields;
+
+    memcpy((void*)prefetch->input_range_min, learner->input_range_min,
+           fields*sizeof(float));
+    memcpy((void*)prefetch->input_range_max, learner->input_range_max,
+           fields*sizeof(float));
+    memcpy((void*)prefetch->output_range_min, learner->output_range_min,
+           prefetch->no_of_outputs*sizeof(float));
+    memcpy((void*)prefetch->output_range_max, learner->output_range_max,
+           prefetch->no_of_outputs*sizeof(float));
+    deeplearn_encoded_units(learner, prefetch->input_set,
+                            prefetch->output_set);
+}
+
+/**
+ * @brief Enables encoding of training samples on worker threads, ahead
+ *        of the training steps of deeplearndata_training. Samples are
+ *        taken from the queue in the order in which they were picked,
+ *        so training is repeatable whatever the number of threads.
+ *        Samples should not be added while the queue is enabled.
+ * @param learner Deep learner object
+ * @param capacity The maximum number of samples encoded ahead, or zero
+ *        to disable prefetching
+ * @param no_of_threads The number of worker threads
  * @returns zero on success
  */
-int deeplearn_set_input_field_text(deeplearn * learner, int fieldindex, char * text)
+int deeplearn_set_prefetch(deeplearn * learner, int capacity,
+                           int no_of_threads)
 {
-    int i, pos=0;
+    deeplearn_sample_prefetch * prefetch = &learner->prefetch;
+    bp * net = learner->net;
+    int fields = learner->no_of_input_fields;
 
-    if (learner->no_of_input_fields == 0) {
-        /* No fields are defined */
+    deeplearn_sample_prefetch_free(learner);
+    if (capacity == 0) {
+        return 0;
+    }
+    if ((capacity < 0) || (no_of_threads < 0)) {
         return -1;
     }
 
-    if (learner->field_length == 0) {
-        /* no field length array defined */
+    prefetch->input_set = (unsigned char*)malloc(net->NoOfInputs);
+    prefetch->output_set = (unsigned char*)malloc(net->NoOfOutputs);
+    prefetch->input_range_min = (float*)malloc((fields+1)*sizeof(float));
+    prefetch->input_range_max = (float*)malloc((fields+1)*sizeof(float));
+    prefetch->output_range_min =
+        (float*)malloc(net->NoOfOutputs*sizeof(float));
+    prefetch->output_range_max =
+        (float*)malloc(net->NoOfOutputs*sizeof(float));
+    if ((!prefetch->input_set) || (!prefetch->output_set) ||
+        (!prefetch->input_range_min) || (!prefetch->input_range_max) ||
+        (!prefetch->output_range_min) || (!prefetch->output_range_max)) {
+        deeplearn_sample_prefetch_free(learner);
         return -2;
     }
+    prefetch->no_of_input_fields = fields;
+    prefetch->no_of_outputs = net->NoOfOutputs;
 
-    if (learner->field_length[fieldindex] == 0) {
-        /* this is a text field */
+    if (deeplearn_prefetch_init(&prefetch->queue, capacity, no_of_threads,
+                                net->NoOfInputs, net->NoOfOutputs,
+                                deeplearn_prefetch_encode,
+                                (void*)learner) != 0) {
+        deeplearn_sample_prefetch_free(learner);
         return -3;
     }
+    prefetch->enabled = 1;
+    deeplearn_prefetch_ranges(learner);
+    return 0;
+}
 
-    /* get the offset (first input unit index) of the input field */
-    for (i = 0; i < fieldindex; i++) {
-        if (learner->field_length[i] == 0) {
-            pos++;
-        }
-        else {
-            pos += learner->field_length[i];
-        }
-    }
+/**
+ * @brief Copies the field ranges used to encode prefetched samples if
+ *        they have changed. Samples which are pending are encoded using
+ *        the previous ranges, so they are discarded.
+ * @param learner Deep learner object
+ * @returns Non-zero if pending samples were discarded
+ */
+int deeplearn_update_prefetch(deeplearn * learner)
+{
+    deeplearn_sample_prefetch * prefetch = &learner->prefetch;
+    int fields = prefetch->no_of_input_fields;
+
+    if (prefetch->enabled == 0) {
+        return 0;
+    }
+    if ((memcmp(prefetch->input_range_min, learner->input_range_min,
+                fields*sizeof(float)) == 0) &&
+        (memcmp(prefetch->input_range_max, learner->input_range_max,
+                fields*sizeof(float)) == 0) &&
+        (memcmp(prefetch->output_range_min, learner->output_range_min,
+                prefetch->no_of_outputs*sizeof(float)) == 0) &&
+        (memcmp(prefetch->output_range_max, learner->output_range_max,
+                prefetch->no_of_outputs*sizeof(float)) == 0)) {
+        return 0;
+    }
+
+    /* the workers are idle once the queue is drained */
+    deeplearn_prefetch_drain(&prefetch->queue);
+    deeplearn_prefetch_ranges(learner);
+    return 1;
+}
 
-    /* set the value */
-    enc_text_to_binary(text,
-                       learner->net->inputs,
-                       learner->net->NoOfInputs, pos,
-                       learner->field_length[fieldindex]/CHAR_BITS);
-    return 0;
+/**
+ * @brief Creates an inference context for use with deeplearn_infer.
+ *        Each thread which evaluates the learner needs its own context.
+ * @param learner Deep learner object
+ * @param ctx Inference context
+ * @param batch_capacity The maximum number of samples evaluated at once
+ * @returns zero on success
+ */
+int deeplearn_inference_init(deeplearn * learner, bp_inference * ctx,
+                             int batch_capacity)
+{
+    return bp_inference_init(ctx, learner->net, batch_capacity);
 }
 
 /**
- * @brief Sets the value of an output unit
+ * @brief Enables or disables copies of the network on each NUMA node,
+ *        which are used by deeplearn_infer so that threads read weights
+ *        from the memory of their own node.  The copies are not changed
+ *        by training, so this should be called again to refresh them
+ *        after the weights change.
  * @param learner Deep learner object
- * @param index Index number of the output unit
- * @param value Value to set the output unit to in the range 0.0 to 1.0
+ * @param enabled Non-zero to make copies of the network
+ * @returns zero on success
  */
-void deeplearn_set_output(deeplearn * learner, int index, float value)
+int deeplearn_set_replicas(deeplearn * learner, unsigned char enabled)
 {
-    bp_set_output(learner->net, index, value);
+    bp_replicas_free(&learner->replicas);
+    if (enabled == 0) return 0;
+    return bp_replicas_init(&learner->replicas, learner->net);
 }
 
 /**
- * @brief Sets outputs from the given data sample.
- *        The sample can contain arbitrary floating point values, so these
- *        need to be normalised into a 0.25-0.75 range
+ * @brief Enables or disables the folding of neutral inputs into the
+ *        biases of the first hidden layer, so that the padding of text
+ *        fields is skipped when the network is fed forward
  * @param learner Deep learner object
- * @param sample The data sample from which to obtain the output values
+ * @param enabled Non-zero to fold neutral inputs into the biases
+ * @returns zero on success
  */
-void deeplearn_set_outputs(deeplearn * learner, deeplearndata * sample)
+int deeplearn_set_neutral_inputs(deeplearn * learner, unsigned char enabled)
 {
-    for (int i = 0; i < learner->net->NoOfOutputs; i++) {
-        float value = sample->outputs[i];
-        float range = learner->output_range_max[i] - learner->output_range_min[i];
-        if (range > 0) {
-            float normalised = (((value - learner->output_range_min[i])/range)*0.5) + 0.25;
-            deeplearn_set_output(learner, i, normalised);
-        }
-    }
+    return bp_set_neutral_inputs(learner->net, enabled);
 }
 
 /**
- * @brief Returns the values of outputs within their normal range
+ * @brief Adds classifier heads to the intermediate hidden layers, which
+ *        are then trained alongside the output layer during the final
+ *        stage of training and used by deeplearn_feed_forward_exit.
+ *        Any existing heads are replaced, and are saved with the
+ *        learner.  Hogwild training is not available while heads are
+ *        enabled.
  * @param learner Deep learner object
- * @param outputs The returned output values
+ * @param threshold Confidence at which evaluation stops, as described
+ *        for exits_confidence
+ * @returns zero on success
  */
-void deeplearn_get_outputs(deeplearn * learner, float * outputs)
+int deeplearn_exits_enable(deeplearn * learner, float threshold)
 {
-    for (int i = 0; i < learner->net->NoOfOutputs; i++) {
-        float value = deeplearn_get_output(learner, i);
-        float range = learner->output_range_max[i] - learner->output_range_min[i];
-        if (range > 0) {
-            outputs[i] =
-                (((value - 0.25f)/0.5f)*range) + learner->output_range_min[i];
+    exits_free(&learner->exits);
+    return exits_init(&learner->exits, learner->net, threshold,
+                      &learner->net->random_seed);
+}
+
+/**
+ * @brief Removes any classifier heads
+ * @param learner Deep learner object
+ */
+void deeplearn_exits_disable(deeplearn * learner)
+{
+    exits_free(&learner->exits);
+}
+
+/**
+ * @brief Evaluates a batch of numeric samples without changing the state
+ *        of the learner, so that it may be shared between threads.
+ *        Input fields are normalised in the same way as by
+ *        deeplearn_set_inputs and outputs are returned within their
+ *        normal range, as with deeplearn_get_outputs.
+ *        If no input fields have been defined then the inputs are taken
+ *        to be input unit values in the range 0.0 to 1.0.
+ * @param learner Deep learner object
+ * @param ctx Inference context owned by the calling thread
+ * @param inputs Input field values, one row per sample
+ * @param outputs Returned output values, one row of NoOfOutputs values
+ *        per sample
+ * @param batch_size The number of samples
+ * @returns zero on success
+ */
+int deeplearn_infer(deeplearn * learner, bp_inference * ctx,
+                    float * inputs, float * outputs, int batch_size)
+{
+    int i, b, no_of_inputs = learner->net->NoOfInputs;
+    int no_of_outputs = learner->net->NoOfOutputs;
+    float value, range;
+
+    if ((batch_size < 1) || (batch_size > ctx->batch_capacity)) {
+        return -1;
+    }
+
+    if (learner->no_of_input_fields == 0) {
+        memcpy(ctx->inputs, inputs,
+               batch_size*no_of_inputs*sizeof(float));
+    }
+    else {
+        /* text fields need to be encoded with deeplearn_set_inputs */
+        for (i = 0; i < learner->no_of_input_fields; i++) {
+            if (learner->field_length[i] > 0) {
+                return -2;
+            }
+        }
+
+        /* normalise into the range 0.25-0.75 */
+        for (b = 0; b < batch_size; b++) {
+            for (i = 0; i < no_of_inputs; i++) {
+                value = inputs[b*no_of_inputs + i];
+                range = learner->input_range_max[i] -
+                    learner->input_range_min[i];
+                if (range > 0) {
+                    value = (((value - learner->input_range_min[i])/range)*0.5) + 0.25;
+                }
+                ctx->inputs[b*no_of_inputs + i] = value;
+            }
+        }
+    }
+
+    if (bp_infer(bp_replicas_local(&learner->replicas, learner->net),
+                 ctx, ctx->inputs, outputs, batch_size) != 0) {
+        return -3;
+    }
+
+    /* return outputs to their normal range */
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_outputs; i++) {
+            range = learner->output_range_max[i] - learner->output_range_min[i];
+            if (range > 0) {
+                outputs[b*no_of_outputs + i] =
+                    (((outputs[b*no_of_outputs + i] - 0.25f)/0.5f)*range) +
+                    learner->output_range_min[i];
+            }
         }
     }
+    return 0;
 }
 
 /**
@@ -728,6 +2251,10 @@ void deeplearn_set_class(deeplearn * learner, int class)
  */
 int deeplearn_save(FILE * fp, deeplearn * learner)
 {
+    if (bp_format_save(fp, DEEPLEARN_FILE_MAGIC,
+                       DEEPLEARN_FILE_VERSION) != 0) {
+        return -18;
+    }
     if (fwrite(&learner->training_complete, sizeof(int), 1, fp) == 0) {
         return -1;
     }
@@ -790,9 +2317,16 @@ int deeplearn_save(FILE * fp, deeplearn * learner)
     if (fwrite(&learner->history_step, sizeof(int), 1, fp) == 0) {
         return -16;
     }
-    if (fwrite(learner->history, sizeof(float),
-               learner->history_index, fp) == 0) {
-        return -17;
+    if (learner->history_index > 0) {
+        if (fwrite(learner->history, sizeof(float),
+                   learner->history_index, fp) == 0) {
+            return -17;
+        }
+    }
+
+    /* save any classifier heads */
+    if (exits_save(fp, &learner->exits, learner->net) != 0) {
+        return -19;
     }
 
     return 0;
@@ -808,6 +2342,9 @@ int deeplearn_save(FILE * fp, deeplearn * learner)
 int deeplearn_load(FILE * fp, deeplearn * learner,
                    unsigned int * random_seed)
 {
+    bp net;
+    int version;
+
     /* no training/test data yet */
     learner->data = 0;
     learner->data_samples = 0;
@@ -817,7 +2354,26 @@ int deeplearn_load(FILE * fp, deeplearn * learner,
     learner->training_data_labeled_samples = 0;
     learner->test_data = 0;
     learner->test_data_samples = 0;
-
+    memset((void*)&learner->arena, '\0', sizeof(deeplearndata_arena));
+    memset((void*)&learner->cache, '\0', sizeof(deeplearn_sample_cache));
+    memset((void*)&learner->prefetch, '\0', sizeof(deeplearn_sample_prefetch));
+    memset((void*)&learner->activations, '\0',
+           sizeof(deeplearn_activation_cache));
+    learner->activations.layer = -1;
+    memset((void*)&learner->pipeline, '\0', sizeof(deeplearn_pipeline));
+    memset((void*)&learner->replicas, '\0', sizeof(bp_replicas));
+    memset((void*)&learner->exits, '\0', sizeof(deeplearn_exits));
+    learner->history_plotter = 0;
+    schedule_init(&learner->schedule);
+    learner->stream = 0;
+    learner->early_stop = 0;
+    learner->early_stop_data = 0;
+
+    version = bp_format_load(fp, DEEPLEARN_FILE_MAGIC,
+                             DEEPLEARN_FILE_VERSION);
+    if (version < 0) {
+        return -23;
+    }
     if (fread(&learner->training_complete, sizeof(int), 1, fp) == 0) {
         return -1;
     }
@@ -841,48 +2397,35 @@ int deeplearn_load(FILE * fp, deeplearn * learner,
         }
     }
 
-    learner->net = (bp*)malloc(sizeof(bp));
-    if (bp_load(fp, learner->net, random_seed) != 0) {
+    if (bp_load(fp, &net, random_seed) != 0) {
         return -7;
     }
 
-    learner->autocoder = (ac**)malloc(sizeof(ac*)*learner->net->HiddenLayers);
-    if (!learner->autocoder) {
+    /* now that the dimensions are known the network can be moved
+       into the learner's arena */
+    if (deeplearn_model_arena_init(learner, net.NoOfInputs,
+                                   net.HiddenLayers, net.NoOfOutputs) != 0) {
+        bp_free(&net);
         return -8;
     }
+    *learner->net = net;
+
     for (int i = 0; i < learner->net->HiddenLayers; i++) {
-        learner->autocoder[i] = (ac*)malloc(sizeof(ac));
         if (autocoder_load(fp, learner->autocoder[i], 1) != 0) {
             return -9;
         }
     }
+    if (deeplearn_share_weights(learner) != 0) {
+        return -9;
+    }
 
     /* load error thresholds */
-    learner->error_threshold =
-        (float*)malloc((learner->net->HiddenLayers+1)*
-                       sizeof(float));
     if (fread(learner->error_threshold, sizeof(float),
               learner->net->HiddenLayers+1, fp) == 0) {
         return -10;
     }
 
     /* load ranges */
-    learner->input_range_min = (float*)malloc(learner->net->NoOfInputs*sizeof(float));
-    if (!learner->input_range_min) {
-        return -15;
-    }
-    learner->input_range_max = (float*)malloc(learner->net->NoOfInputs*sizeof(float));
-    if (!learner->input_range_max) {
-        return -16;
-    }
-    learner->output_range_min = (float*)malloc(learner->net->NoOfOutputs*sizeof(float));
-    if (!learner->output_range_min) {
-        return -17;
-    }
-    learner->output_range_max = (float*)malloc(learner->net->NoOfOutputs*sizeof(float));
-    if (!learner->output_range_max) {
-        return -18;
-    }
     if (fread(learner->input_range_min, sizeof(float), learner->net->NoOfInputs, fp) == 0) {
         return -19;
     }
@@ -906,9 +2449,17 @@ int deeplearn_load(FILE * fp, deeplearn * learner,
     if (fread(&learner->history_step, sizeof(int), 1, fp) == 0) {
         return -13;
     }
-    if (fread(learner->history, sizeof(float),
-              learner->history_index, fp) == 0) {
-        return -14;
+    if (learner->history_index > 0) {
+        if (fread(learner->history, sizeof(float),
+                  learner->history_index, fp) == 0) {
+            return -14;
+        }
+    }
+
+    /* older files have no classifier heads */
+    if ((version > 0) &&
+        (exits_load(fp, &learner->exits, learner->net, random_seed) != 0)) {
+        return -24;
     }
 
     return 0;
@@ -1003,65 +2554,56 @@ int deeplearn_plot_history(deeplearn * learner,
                            char * filename, char * title,
                            int image_width, int image_height)
 {
-    int index,retval=0;
-    FILE * fp;
-    char data_filename[256];
-    char plot_filename[256];
-    char command_str[256];
-    float value;
-    float max_value = 0.01f;
-
-    sprintf(data_filename,"%s%s",DEEPLEARN_TEMP_DIRECTORY,
-            "libdeep_data.dat");
-    sprintf(plot_filename,"%s%s",DEEPLEARN_TEMP_DIRECTORY,
-            "libdeep_data.plot");
-
-    /* save the data */
-    fp = fopen(data_filename,"w");
-    if (!fp) return -1;
-    for (index = 0; index < learner->history_index; index++) {
-        value = learner->history[index];
-        fprintf(fp,"%d    %.10f\n",
-                index*learner->history_step,value);
-        /* record the maximum error value */
-        if (value > max_value) {
-            max_value = value;
-        }
-    }
-    fclose(fp);
-
-    /* create a plot file */
-    fp = fopen(plot_filename,"w");
-    if (!fp) return -1;
-    fprintf(fp,"%s","reset\n");
-    fprintf(fp,"set title \"%s\"\n",title);
-    fprintf(fp,"set xrange [0:%d]\n",
-            learner->history_index*learner->history_step);
-    fprintf(fp,"set yrange [0:%f]\n",max_value*102/100);
-    fprintf(fp,"%s","set lmargin 9\n");
-    fprintf(fp,"%s","set rmargin 2\n");
-    fprintf(fp,"%s","set xlabel \"Time Step\"\n");
-    fprintf(fp,"%s","set ylabel \"Training Error Percent\"\n");
-
-    fprintf(fp,"%s","set grid\n");
-    fprintf(fp,"%s","set key right top\n");
-
-    fprintf(fp,"set terminal png size %d,%d\n",
-            image_width, image_height);
-    fprintf(fp,"set output \"%s\"\n", filename);
-    fprintf(fp,"plot \"%s\" using 1:2 notitle with lines\n",
-            data_filename);
-    fclose(fp);
-
-    /* run gnuplot using the created files */
-    sprintf(command_str,"gnuplot %s", plot_filename);
-    retval = system(command_str); /* I assume this is synchronous */
+    deeplearn_history_snapshot snapshot;
+
+    memcpy((void*)snapshot.history, learner->history,
+           learner->history_index*sizeof(float));
+    snapshot.history_index = learner->history_index;
+    snapshot.history_step = learner->history_step;
+    snprintf(snapshot.filename, sizeof(snapshot.filename), "%s", filename);
+    snprintf(snapshot.title, sizeof(snapshot.title), "%s", title);
+    snapshot.image_width = image_width;
+    snapshot.image_height = image_height;
+    return deeplearn_history_plot(&snapshot, "libdeep_data");
+}
 
-    /* remove temporary files */
-    sprintf(command_str,"rm %s %s", data_filename,plot_filename);
-    retval = system(command_str);
+/**
+ * @brief Sets a plotter which renders training history graphs on a
+ *        background thread, so that training does not wait for them.
+ *        The plotter is owned by the caller.
+ * @param learner Deep learner object
+ * @param plotter History plotter, or NULL to plot synchronously
+ */
+void deeplearn_set_history_plotter(deeplearn * learner,
+                                   deeplearn_history_plotter * plotter)
+{
+    learner->history_plotter = plotter;
+}
 
-    return retval;
+/**
+ * @brief Plots the training history to the learner's history plot
+ *        filename, using the background plotter if one has been set
+ * @param learner Deep learner object
+ * @param image_width Width of the image in pixels
+ * @param image_height Height of the image in pixels
+ * @return zero on success
+ */
+int deeplearn_plot_training_history(deeplearn * learner,
+                                    int image_width, int image_height)
+{
+    if (learner->history_plotter != 0) {
+        return deeplearn_history_plotter_post(learner->history_plotter,
+                                              learner->history,
+                                              learner->history_index,
+                                              learner->history_step,
+                                              learner->history_plot_filename,
+                                              learner->history_plot_title,
+                                              image_width, image_height);
+    }
+    return deeplearn_plot_history(learner,
+                                  learner->history_plot_filename,
+                                  learner->history_plot_title,
+                                  image_width, image_height);
 }
 
 /**
@@ -1084,44 +2626,291 @@ void deeplearn_inputs_from_image_patch(deeplearn * learner,
 }
 
 /**
- * @brief Updates the input units from an image
+ * @brief Updates the input units from an image
+ * @param learner Deep learner object
+ * @param img Image buffer (1 byte per pixel)
+ * @param image_width Width of the image in pixels
+ * @param image_height Height of the image in pixels
+ */
+void deeplearn_inputs_from_image(deeplearn * learner,
+                                 unsigned char * img,
+                                 int image_width, int image_height)
+{
+    bp_inputs_from_image(learner->net, img, image_width, image_height);
+}
+
+/**
+ * @brief Sets the learning rate
+ * @param learner Deep learner object
+ * @param rate the learning rate in the range 0.0 to 1.0
+ */
+void deeplearn_set_learning_rate(deeplearn * learner, float rate)
+{
+    learner->net->learningRate = rate;
+
+    for (int i = 0; i < learner->net->HiddenLayers; i++) {
+        learner->autocoder[i]->learningRate = rate;
+    }
+}
+
+/**
+ * @brief Sets a schedule for the learning rate, which is applied to
+ *        the network and to the autocoders after each update
+ * @param learner Deep learner object
+ * @param type Schedule type, such as SCHEDULE_COSINE
+ * @param base_rate Learning rate at the start of the schedule
+ * @param min_rate The lowest learning rate allowed
+ * @param period Updates between steps of SCHEDULE_STEP, or the length
+ *        of each cycle of SCHEDULE_COSINE
+ * @param gamma Multiplier applied at each step of SCHEDULE_STEP
+ * @returns zero on success
+ */
+int deeplearn_set_schedule(deeplearn * learner, int type,
+                           float base_rate, float min_rate,
+                           unsigned int period, float gamma)
+{
+    if (schedule_set(&learner->schedule, type, base_rate, min_rate,
+                     period, gamma) != 0) {
+        return -1;
+    }
+    deeplearn_set_learning_rate(learner,
+                                schedule_learning_rate(&learner->schedule));
+    return 0;
+}
+
+/**
+ * @brief Sets the number of updates over which the learning rate rises
+ *        to its starting value.  If no schedule has been set then the
+ *        current learning rate is kept constant after the warmup.
+ * @param learner Deep learner object
+ * @param updates Number of warmup updates
+ */
+void deeplearn_set_warmup(deeplearn * learner, unsigned int updates)
+{
+    if (learner->schedule.enabled == 0) {
+        schedule_set(&learner->schedule, SCHEDULE_CONSTANT,
+                     learner->net->learningRate, 0, 0, 1);
+    }
+    schedule_set_warmup(&learner->schedule, updates);
+    deeplearn_set_learning_rate(learner,
+                                schedule_learning_rate(&learner->schedule));
+}
+
+/**
+ * @brief Enables detection of a plateau in the training error, which is
+ *        checked each time an entry is added to the training history.
+ *        On a plateau the learning rate is multiplied by the given
+ *        factor, and once max_reductions plateaus have occurred the
+ *        current layer is considered to have been trained.
+ * @param learner Deep learner object
+ * @param patience Number of history entries without improvement which
+ *        count as a plateau, or zero to disable
+ * @param min_delta The smallest decrease in the error percentage which
+ *        counts as an improvement
+ * @param factor Multiplier in the range 0 to 1 applied to the learning
+ *        rate on each plateau
+ * @param max_reductions Number of plateaus after which a layer is
+ *        considered to have been trained
+ * @returns zero on success
+ */
+int deeplearn_set_plateau(deeplearn * learner,
+                          unsigned int patience, float min_delta,
+                          float factor, unsigned int max_reductions)
+{
+    if (schedule_set_plateau(&learner->schedule, patience, min_delta,
+                             factor, max_reductions) != 0) {
+        return -1;
+    }
+    if ((learner->schedule.enabled == 0) && (factor < 1)) {
+        schedule_set(&learner->schedule, SCHEDULE_CONSTANT,
+                     learner->net->learningRate, 0, 0, 1);
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets the maximum number of updates, after which training is
+ *        considered to be complete even if the error thresholds have
+ *        not been reached
+ * @param learner Deep learner object
+ * @param updates Maximum number of updates, or zero for no limit
+ */
+void deeplearn_set_max_updates(deeplearn * learner, unsigned int updates)
+{
+    learner->schedule.max_updates = updates;
+}
+
+/**
+ * @brief Sets a function which is called each time an entry is added to
+ *        the training history, and which returns non-zero if training
+ *        should stop
+ * @param learner Deep learner object
+ * @param callback Early stopping function, or NULL for none
+ * @param data Data passed to the function
+ */
+void deeplearn_set_early_stop(deeplearn * learner,
+                              deeplearn_early_stop callback, void * data)
+{
+    learner->early_stop = callback;
+    learner->early_stop_data = data;
+}
+
+/**
+ * @brief Sets the percentage of units which drop out during training
+ * @param learner Deep learner object
+ * @param dropout_percent Percentage of units which drop out in the range 0 to 100
+ */
+void deeplearn_set_dropouts(deeplearn * learner, float dropout_percent)
+{
+    learner->net->DropoutPercent = dropout_percent;
+
+    for (int i = 0; i < learner->net->HiddenLayers; i++) {
+        learner->autocoder[i]->DropoutPercent = dropout_percent;
+    }
+}
+
+/**
+ * @brief Sets the activation function of the hidden units of the
+ *        network and of the autocoders used for pretraining.
+ *        The output units always use the logistic function.
+ * @param learner Deep learner object
+ * @param function One of the AF_* activation functions
+ * @returns zero on success
+ */
+int deeplearn_set_activation(deeplearn * learner, int function)
+{
+    if (bp_set_activation(learner->net, function) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < learner->net->HiddenLayers; i++) {
+        learner->autocoder[i]->activation = function;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets the rule used to update the weights of the network and of
+ *        the autocoders used for pretraining, such as OPTIMISER_ADAM
  * @param learner Deep learner object
- * @param img Image buffer (1 byte per pixel)
- * @param image_width Width of the image in pixels
- * @param image_height Height of the image in pixels
+ * @param type One of the OPTIMISER_* update rules
+ * @returns zero on success
  */
-void deeplearn_inputs_from_image(deeplearn * learner,
-                                 unsigned char * img,
-                                 int image_width, int image_height)
+int deeplearn_set_optimiser(deeplearn * learner, int type)
 {
-    bp_inputs_from_image(learner->net, img, image_width, image_height);
+    if (bp_set_optimiser(learner->net, type) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < learner->net->HiddenLayers; i++) {
+        if (autocoder_set_optimiser(learner->autocoder[i], type) != 0) {
+            return -2;
+        }
+    }
+    return 0;
 }
 
 /**
- * @brief Sets the learning rate
+ * @brief Freezes the given number of hidden layers, counting from the
+ *        input layer, and unfreezes the rest, so that further training
+ *        only adjusts the layers above.  Frozen layers are taken to have
+ *        been trained already, so they are not pretrained again.
  * @param learner Deep learner object
- * @param rate the learning rate in the range 0.0 to 1.0
+ * @param layers The number of hidden layers to freeze, or zero to
+ *        train the whole network
+ * @returns zero on success
  */
-void deeplearn_set_learning_rate(deeplearn * learner, float rate)
+int deeplearn_freeze_layers(deeplearn * learner, int layers)
 {
-    learner->net->learningRate = rate;
+    if ((layers < 0) || (layers > learner->net->HiddenLayers)) {
+        return -1;
+    }
 
     for (int i = 0; i < learner->net->HiddenLayers; i++) {
-        learner->autocoder[i]->learningRate = rate;
+        bp_freeze_layer(learner->net, i, i < layers);
+    }
+    if (learner->current_hidden_layer < layers) {
+        learner->current_hidden_layer = layers;
     }
+    return 0;
 }
 
 /**
- * @brief Sets the percentage of units which drop out during training
- * @param learner Deep learner object
- * @param dropout_percent Percentage of units which drop out in the range 0 to 100
+ * @brief Writes the hidden unit activation function of an exported
+ *        C program
+ * @param fp File pointer
+ * @param function One of the AF_* activation functions
+ * @param declaration Declaration of the function, such as "float af(float x)"
  */
-void deeplearn_set_dropouts(deeplearn * learner, float dropout_percent)
+static void deeplearn_export_c_af(FILE * fp, int function,
+                                  const char * declaration)
 {
-    learner->net->DropoutPercent = dropout_percent;
+    fprintf(fp, "/* Activation function of the hidden units (%s) */\n",
+            kernel_af_name(function));
+    fprintf(fp, "%s\n", declaration);
+    fprintf(fp, "%s", "{\n");
+    switch(function) {
+    case AF_FAST_LOGISTIC: {
+        fprintf(fp, "%s", "  float z = x * 0.5f;\n");
+        fprintf(fp, "%s", "  if (z > 3.0f) z = 3.0f;\n");
+        fprintf(fp, "%s", "  if (z < -3.0f) z = -3.0f;\n");
+        fprintf(fp, "%s", "  return 0.5f + 0.5f*(z*(27.0f + z*z)/(27.0f + 9.0f*z*z));\n");
+        break;
+    }
+    case AF_TANH: {
+        fprintf(fp, "%s", "  return tanhf(x);\n");
+        break;
+    }
+    case AF_RELU: {
+        fprintf(fp, "%s", "  return x > 0 ? x : 0;\n");
+        break;
+    }
+    case AF_LEAKY_RELU: {
+        fprintf(fp, "  return x > 0 ? x : %.10ff*x;\n", AF_LEAKY_RELU_SLOPE);
+        break;
+    }
+    default: {
+        fprintf(fp, "%s", "  return 1.0f / (1.0f + expf(-x));\n");
+        break;
+    }
+    }
+    fprintf(fp, "%s", "}\n\n");
+}
 
-    for (int i = 0; i < learner->net->HiddenLayers; i++) {
-        learner->autocoder[i]->DropoutPercent = dropout_percent;
+/**
+ * @brief Writes the hidden unit activation function of an exported
+ *        python class, which applies to a whole array at once
+ * @param fp File pointer
+ * @param function One of the AF_* activation functions
+ */
+static void deeplearn_export_python_af(FILE * fp, int function)
+{
+    fprintf(fp, "  # Activation function of the hidden units (%s)\n",
+            kernel_af_name(function));
+    fprintf(fp, "%s", "  def af(this, x):\n");
+    switch(function) {
+    case AF_FAST_LOGISTIC: {
+        fprintf(fp, "%s", "    z = np.clip(x * 0.5, -3.0, 3.0)\n");
+        fprintf(fp, "%s", "    return 0.5 + 0.5*(z*(27.0 + z*z)/(27.0 + 9.0*z*z))\n\n");
+        break;
+    }
+    case AF_TANH: {
+        fprintf(fp, "%s", "    return np.tanh(x)\n\n");
+        break;
+    }
+    case AF_RELU: {
+        fprintf(fp, "%s", "    return np.maximum(x, 0.0)\n\n");
+        break;
+    }
+    case AF_LEAKY_RELU: {
+        fprintf(fp, "    return np.where(x > 0, x, %.10f*x)\n\n",
+                AF_LEAKY_RELU_SLOPE);
+        break;
+    }
+    default: {
+        fprintf(fp, "%s", "    return 1.0 / (1.0 + np.exp(-x))\n\n");
+        break;
+    }
     }
 }
 
@@ -1323,6 +3112,8 @@ static int deeplearn_export_c(deeplearn * learner, char * filename)
         fprintf(fp, "%s", "}\n\n");
     }
 
+    deeplearn_export_c_af(fp, learner->net->activation, "float af(float x)");
+
     fprintf(fp, "%s", "int main(int argc, char* argv[])\n");
     fprintf(fp, "%s", "{\n");
 
@@ -1380,7 +3171,7 @@ static int deeplearn_export_c(deeplearn * learner, char * filename)
     fprintf(fp, "%s", "    for (j = 0; j < no_of_inputs; j++) {\n");
     fprintf(fp, "%s", "      sum += hidden_layer_0_weights[i*no_of_inputs+j]*network_inputs[j];\n");
     fprintf(fp, "%s", "    }\n");
-    fprintf(fp, "%s", "    hiddens[i] = 1.0f / (1.0f + exp(-sum));\n");
+    fprintf(fp, "%s", "    hiddens[i] = af(sum);\n");
     fprintf(fp, "%s", "  }\n");
     fprintf(fp, "%s", "  for (i = 0; i < no_of_hiddens; i++) {\n");
     fprintf(fp, "%s", "    prev_hiddens[i] = hiddens[i];\n");
@@ -1392,7 +3183,7 @@ static int deeplearn_export_c(deeplearn * learner, char * filename)
         fprintf(fp, "    for (j = 0; j < %d; j++) {\n",bp_hiddens_in_layer(learner->net,i-1));
         fprintf(fp, "      sum += hidden_layer_%d_weights[i*%d+j]*prev_hiddens[j];\n",i,bp_hiddens_in_layer(learner->net,i-1));
         fprintf(fp, "%s", "    }\n");
-        fprintf(fp, "%s", "    hiddens[i] = 1.0f / (1.0f + exp(-sum));\n");
+        fprintf(fp, "%s", "    hiddens[i] = af(sum);\n");
         fprintf(fp, "%s", "  }\n");
         fprintf(fp, "  for (i = 0; i < %d; i++) {\n",bp_hiddens_in_layer(learner->net,i));
         fprintf(fp, "%s", "    prev_hiddens[i] = hiddens[i];\n");
@@ -1425,265 +3216,492 @@ static int deeplearn_export_c(deeplearn * learner, char * filename)
 }
 
 /**
- * @brief Exports a trained network as a standalone python class
+ * @brief Writes a constant, aligned array of floats within an exported
+ *        C library.  Values are written with enough digits to be
+ *        reproduced exactly.
+ * @param fp File pointer
+ * @param name Name of the array
+ * @param values The values to be written
+ * @param n Number of values
+ */
+static void deeplearn_export_library_array(FILE * fp, const char * name,
+                                           float * values, int n)
+{
+    fprintf(fp, "static const float %s[%d] PREDICT_ALIGNED = {", name, n);
+    for (int i = 0; i < n; i++) {
+        if (i % 4 == 0) {
+            fprintf(fp, "%s", "\n ");
+        }
+        fprintf(fp, " %.9ef", values[i]);
+        if (i < n-1) {
+            fprintf(fp, ",");
+        }
+    }
+    fprintf(fp, "%s", "\n};\n\n");
+}
+
+/**
+ * @brief Exports a trained network as C source for embedding within
+ *        another program.  Rather than a main function this produces
+ *        predict(in, out) and predict_batch(in, out, batch_size), which
+ *        take the same inputs and return the same outputs as
+ *        deeplearn_infer.  The generated functions are reentrant and
+ *        don't allocate memory, and all array sizes are constants so
+ *        that the compiler is able to unroll and vectorise the loops.
+ *        Learners with text input fields can't be exported this way.
  * @param learner Deep learner object
- * @param filename The python source file to be produced
+ * @param filename The C source file to be produced
  * @returns zero on success
  */
-static int deeplearn_export_python(deeplearn * learner, char * filename)
+int deeplearn_export_library(deeplearn * learner, char * filename)
 {
     FILE * fp;
-    int i, j, k, no_of_weights;
-
-    fp = fopen(filename,"w");
-    if (!fp) {
-        return -1;
+    int i, l, max_units = 0;
+    bp * net = learner->net;
+    bp_layer * layer;
+    char name[64];
+    float range;
+    float * scale, * offset;
+
+    for (i = 0; i < learner->no_of_input_fields; i++) {
+        if (learner->field_length[i] > 0) {
+            return -2;
+        }
     }
 
-    fprintf(fp, "%s", "#!/usr/bin/python\n\n");
-    fprintf(fp, "%s", "import sys\n");
-    fprintf(fp, "%s", "import math\n\n");
+    for (l = 0; l < net->HiddenLayers+2; l++) {
+        if (net->layer[l].NoOfUnits > max_units) {
+            max_units = net->layer[l].NoOfUnits;
+        }
+    }
 
-    fprintf(fp,"%s\n\n","class NeuralNet:");
+    /* normalisation of the inputs and outputs as a scale and offset */
+    i = (net->NoOfInputs > net->NoOfOutputs) ?
+        net->NoOfInputs : net->NoOfOutputs;
+    scale = (float*)malloc(i*sizeof(float));
+    offset = (float*)malloc(i*sizeof(float));
+    if ((!scale) || (!offset)) {
+        free(scale);
+        free(offset);
+        return -3;
+    }
 
-    if (learner->no_of_input_fields > 0) {
-        fprintf(fp, "  no_of_input_fields = %d\n",
-                learner->no_of_input_fields);
+    fp = fopen(filename,"w");
+    if (!fp) {
+        free(scale);
+        free(offset);
+        return -1;
     }
-    fprintf(fp, "  no_of_inputs = %d\n",
-            learner->net->NoOfInputs);
-    fprintf(fp, "  no_of_hiddens = %d\n",
-            learner->net->NoOfHiddens);
-    fprintf(fp, "  no_of_outputs = %d\n",
-            learner->net->NoOfOutputs);
-    fprintf(fp, "  hidden_layers = %d\n\n",
-            learner->net->HiddenLayers);
 
-    /* field lengths */
-    if (learner->field_length != 0) {
+    fprintf(fp, "%s", "/* Neural network exported from libdeep.\n");
+    fprintf(fp, "%s", "   predict evaluates one sample and predict_batch evaluates rows\n");
+    fprintf(fp, "%s", "   of samples.  Neither allocates memory or has any state, so they\n");
+    fprintf(fp, "%s", "   may be called from any number of threads at once. */\n\n");
+    fprintf(fp, "%s", "#include <math.h>\n\n");
+
+    fprintf(fp, "#define PREDICT_INPUTS    %d\n", net->NoOfInputs);
+    fprintf(fp, "#define PREDICT_OUTPUTS   %d\n", net->NoOfOutputs);
+    fprintf(fp, "#define PREDICT_MAX_UNITS %d\n", max_units);
+    fprintf(fp, "%s", "#define PREDICT_BLOCK     8\n\n");
+    fprintf(fp, "%s", "#if defined(__GNUC__)\n");
+    fprintf(fp, "%s", "#define PREDICT_ALIGNED __attribute__((aligned(32)))\n");
+    fprintf(fp, "%s", "#else\n");
+    fprintf(fp, "%s", "#define PREDICT_ALIGNED\n");
+    fprintf(fp, "%s", "#endif\n\n");
+
+    for (i = 0; i < net->NoOfInputs; i++) {
+        scale[i] = 1;
+        offset[i] = 0;
         if (learner->no_of_input_fields > 0) {
-            fprintf(fp, "%s", "  field_length = [");
-            for (i = 0; i < learner->no_of_input_fields; i++) {
-                fprintf(fp, "%d", learner->field_length[i]);
-                if (i < learner->no_of_input_fields-1) {
-                    fprintf(fp, ",");
-                }
+            range = learner->input_range_max[i] - learner->input_range_min[i];
+            if (range > 0) {
+                scale[i] = 0.5f / range;
+                offset[i] = 0.25f - (learner->input_range_min[i]*scale[i]);
             }
-            fprintf(fp, "%s", "]\n\n");
         }
     }
-
-    /* ranges */
-    fprintf(fp, "%s", "  input_range_min = [");
-    for (i = 0; i < learner->net->NoOfInputs; i++) {
-        fprintf(fp, "%.10f", learner->input_range_min[i]);
-        if (i < learner->net->NoOfInputs-1) {
-            fprintf(fp, ",");
+    deeplearn_export_library_array(fp, "predict_input_scale",
+                                   scale, net->NoOfInputs);
+    deeplearn_export_library_array(fp, "predict_input_offset",
+                                   offset, net->NoOfInputs);
+
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        layer = &net->layer[l];
+        sprintf(name, "predict_layer_%d_weights", l-1);
+        deeplearn_export_library_array(fp, name, layer->weights,
+                                       layer->NoOfUnits*layer->NoOfInputs);
+        for (i = 0; i < layer->NoOfUnits; i++) {
+            scale[i] = layer->units[i].bias;
         }
+        sprintf(name, "predict_layer_%d_bias", l-1);
+        deeplearn_export_library_array(fp, name, scale, layer->NoOfUnits);
     }
-    fprintf(fp, "%s", "]\n\n");
-    fprintf(fp, "%s", "  input_range_max = [");
-    for (i = 0; i < learner->net->NoOfInputs; i++) {
-        fprintf(fp, "%.10f", learner->input_range_max[i]);
-        if (i < learner->net->NoOfInputs-1) {
-            fprintf(fp, ",");
+
+    for (i = 0; i < net->NoOfOutputs; i++) {
+        scale[i] = 1;
+        offset[i] = 0;
+        range = learner->output_range_max[i] - learner->output_range_min[i];
+        if (range > 0) {
+            scale[i] = range / 0.5f;
+            offset[i] = learner->output_range_min[i] - (0.25f*scale[i]);
         }
     }
-    fprintf(fp, "%s", "]\n\n");
-    fprintf(fp, "%s", "  output_range_min = [");
-    for (i = 0; i < learner->net->NoOfOutputs; i++) {
-        fprintf(fp, "%.10f", learner->output_range_min[i]);
-        if (i < learner->net->NoOfOutputs-1) {
-            fprintf(fp, ",");
-        }
+    deeplearn_export_library_array(fp, "predict_output_scale",
+                                   scale, net->NoOfOutputs);
+    deeplearn_export_library_array(fp, "predict_output_offset",
+                                   offset, net->NoOfOutputs);
+    free(scale);
+    free(offset);
+
+    deeplearn_export_c_af(fp, net->activation,
+                          "static inline float predict_af(float x)");
+
+    fprintf(fp, "%s", "/* Activation function of the output units */\n");
+    fprintf(fp, "%s", "static inline float predict_logistic(float x)\n");
+    fprintf(fp, "%s", "{\n");
+    fprintf(fp, "%s", "  return 1.0f / (1.0f + expf(-x));\n");
+    fprintf(fp, "%s", "}\n\n");
+
+    fprintf(fp, "%s", "/* Dot product accumulated in eight independent partial sums so\n");
+    fprintf(fp, "%s", "   that it vectorises without relaxing floating point rules */\n");
+    fprintf(fp, "%s", "static inline float predict_dot(const float * restrict w,\n");
+    fprintf(fp, "%s", "                               const float * restrict x, int n)\n");
+    fprintf(fp, "%s", "{\n");
+    fprintf(fp, "%s", "  float acc[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };\n");
+    fprintf(fp, "%s", "  int j = 0, k;\n\n");
+    fprintf(fp, "%s", "  for (; j + 8 <= n; j += 8) {\n");
+    fprintf(fp, "%s", "    for (k = 0; k < 8; k++) {\n");
+    fprintf(fp, "%s", "      acc[k] += w[j+k]*x[j+k];\n");
+    fprintf(fp, "%s", "    }\n");
+    fprintf(fp, "%s", "  }\n");
+    fprintf(fp, "%s", "  for (; j < n; j++) {\n");
+    fprintf(fp, "%s", "    acc[0] += w[j]*x[j];\n");
+    fprintf(fp, "%s", "  }\n");
+    fprintf(fp, "%s", "  return ((acc[0] + acc[4]) + (acc[1] + acc[5])) +\n");
+    fprintf(fp, "%s", "    ((acc[2] + acc[6]) + (acc[3] + acc[7]));\n");
+    fprintf(fp, "%s", "}\n\n");
+
+    /* one function per layer, with the sizes as constants */
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        layer = &net->layer[l];
+        fprintf(fp, "static inline void predict_layer_%d(const float * restrict in,\n", l-1);
+        fprintf(fp, "%s", "                                   float * restrict out, int rows)\n");
+        fprintf(fp, "%s", "{\n");
+        fprintf(fp, "%s", "  int r, i;\n\n");
+        fprintf(fp, "%s", "  for (r = 0; r < rows; r++) {\n");
+        fprintf(fp, "    for (i = 0; i < %d; i++) {\n", layer->NoOfUnits);
+        fprintf(fp, "      out[r*%d + i] =\n", layer->NoOfUnits);
+        fprintf(fp, "        %s(predict_layer_%d_bias[i] +\n",
+                (l < net->HiddenLayers+1) ? "predict_af" : "predict_logistic",
+                l-1);
+        fprintf(fp, "                    predict_dot(&predict_layer_%d_weights[i*%d],\n",
+                l-1, layer->NoOfInputs);
+        fprintf(fp, "                                &in[r*%d], %d));\n",
+                layer->NoOfInputs, layer->NoOfInputs);
+        fprintf(fp, "%s", "    }\n");
+        fprintf(fp, "%s", "  }\n");
+        fprintf(fp, "%s", "}\n\n");
     }
-    fprintf(fp, "%s", "]\n\n");
-    fprintf(fp, "%s", "  output_range_max = [");
-    for (i = 0; i < learner->net->NoOfOutputs; i++) {
-        fprintf(fp, "%.10f", learner->output_range_max[i]);
-        if (i < learner->net->NoOfOutputs-1) {
+
+    fprintf(fp, "%s", "/* Evaluates up to PREDICT_BLOCK rows, one layer at a time so that\n");
+    fprintf(fp, "%s", "   the weights of each layer are reused by every row */\n");
+    fprintf(fp, "%s", "static void predict_block(const float * restrict in,\n");
+    fprintf(fp, "%s", "                          float * restrict out, int rows)\n");
+    fprintf(fp, "%s", "{\n");
+    fprintf(fp, "%s", "  float a[PREDICT_BLOCK*PREDICT_MAX_UNITS] PREDICT_ALIGNED;\n");
+    fprintf(fp, "%s", "  float b[PREDICT_BLOCK*PREDICT_MAX_UNITS] PREDICT_ALIGNED;\n");
+    fprintf(fp, "%s", "  int r, i;\n\n");
+    fprintf(fp, "%s", "  /* normalise the inputs */\n");
+    fprintf(fp, "%s", "  for (r = 0; r < rows; r++) {\n");
+    fprintf(fp, "%s", "    for (i = 0; i < PREDICT_INPUTS; i++) {\n");
+    fprintf(fp, "%s", "      a[r*PREDICT_INPUTS + i] =\n");
+    fprintf(fp, "%s", "        in[r*PREDICT_INPUTS + i]*predict_input_scale[i] +\n");
+    fprintf(fp, "%s", "        predict_input_offset[i];\n");
+    fprintf(fp, "%s", "    }\n");
+    fprintf(fp, "%s", "  }\n\n");
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        fprintf(fp, "  predict_layer_%d(%s, %s, rows);\n", l-1,
+                (l % 2 == 1) ? "a" : "b", (l % 2 == 1) ? "b" : "a");
+    }
+    fprintf(fp, "%s", "\n  /* return the outputs to their original range */\n");
+    fprintf(fp, "%s", "  for (r = 0; r < rows; r++) {\n");
+    fprintf(fp, "%s", "    for (i = 0; i < PREDICT_OUTPUTS; i++) {\n");
+    fprintf(fp, "%s", "      out[r*PREDICT_OUTPUTS + i] =\n");
+    fprintf(fp, "        %s[r*PREDICT_OUTPUTS + i]*predict_output_scale[i] +\n",
+            ((net->HiddenLayers+1) % 2 == 1) ? "b" : "a");
+    fprintf(fp, "%s", "        predict_output_offset[i];\n");
+    fprintf(fp, "%s", "    }\n");
+    fprintf(fp, "%s", "  }\n");
+    fprintf(fp, "%s", "}\n\n");
+
+    fprintf(fp, "%s", "/* Evaluates one sample of PREDICT_INPUTS values, returning\n");
+    fprintf(fp, "%s", "   PREDICT_OUTPUTS values */\n");
+    fprintf(fp, "%s", "void predict(const float * restrict in, float * restrict out)\n");
+    fprintf(fp, "%s", "{\n");
+    fprintf(fp, "%s", "  predict_block(in, out, 1);\n");
+    fprintf(fp, "%s", "}\n\n");
+
+    fprintf(fp, "%s", "/* Evaluates a batch of samples stored one row per sample */\n");
+    fprintf(fp, "%s", "void predict_batch(const float * restrict in, float * restrict out,\n");
+    fprintf(fp, "%s", "                   int batch_size)\n");
+    fprintf(fp, "%s", "{\n");
+    fprintf(fp, "%s", "  int r, rows;\n\n");
+    fprintf(fp, "%s", "  for (r = 0; r < batch_size; r += PREDICT_BLOCK) {\n");
+    fprintf(fp, "%s", "    rows = batch_size - r;\n");
+    fprintf(fp, "%s", "    if (rows > PREDICT_BLOCK) rows = PREDICT_BLOCK;\n");
+    fprintf(fp, "%s", "    predict_block(&in[r*PREDICT_INPUTS], &out[r*PREDICT_OUTPUTS], rows);\n");
+    fprintf(fp, "%s", "  }\n");
+    fprintf(fp, "%s", "}\n");
+
+    fclose(fp);
+    return 0;
+}
+
+/**
+ * @brief Writes an array of floats as a NumPy array within an exported
+ *        python class
+ * @param fp File pointer
+ * @param name Name of the array
+ * @param values The values to be written
+ * @param rows Number of rows, or zero for a one dimensional array
+ * @param cols Number of columns
+ */
+static void deeplearn_export_python_array(FILE * fp, const char * name,
+                                          float * values, int rows, int cols)
+{
+    int n = (rows > 0) ? rows*cols : cols;
+
+    fprintf(fp, "  %s = np.array([", name);
+    for (int i = 0; i < n; i++) {
+        if (i % 4 == 0) {
+            fprintf(fp, "%s", "\n   ");
+        }
+        fprintf(fp, " %.9e", values[i]);
+        if (i < n-1) {
             fprintf(fp, ",");
         }
     }
-    fprintf(fp, "]\n\n");
+    if (rows > 0) {
+        fprintf(fp, "], dtype=np.float32).reshape(%d, %d)\n\n", rows, cols);
+    }
+    else {
+        fprintf(fp, "%s", "], dtype=np.float32)\n\n");
+    }
+}
 
-    /* hidden unit weights */
-    for (i = 0; i < learner->net->HiddenLayers; i++) {
-        fprintf(fp,
-                "  hidden_layer_%d_weights = [", i);
-        if (i == 0) {
-            no_of_weights = learner->net->NoOfInputs;
-        }
-        else {
-            no_of_weights = bp_hiddens_in_layer(learner->net, i-1);
+/**
+ * @brief Exports a trained network as a standalone python class.
+ *        Weights are stored as NumPy arrays and the predict method
+ *        evaluates a two dimensional batch of rows with one matrix
+ *        product per layer.  Inputs and outputs are the same as for
+ *        deeplearn_infer, and text fields are encoded as they are by
+ *        deeplearn_set_inputs.
+ * @param learner Deep learner object
+ * @param filename The python source file to be produced
+ * @returns zero on success
+ */
+static int deeplearn_export_python(deeplearn * learner, char * filename)
+{
+    FILE * fp;
+    int i, l, text_fields = 0;
+    bp * net = learner->net;
+    bp_layer * layer;
+    char name[64];
+    float range;
+    float * scale, * offset;
+
+    for (i = 0; i < learner->no_of_input_fields; i++) {
+        if (learner->field_length[i] > 0) {
+            text_fields = 1;
         }
-        for (j = 0; j < bp_hiddens_in_layer(learner->net, i); j++) {
-            for (k = 0; k < no_of_weights; k++) {
-                fprintf(fp, "%.10f",
-                        learner->net->hiddens[i][j]->weights[k]);
-                if (!((j == bp_hiddens_in_layer(learner->net, i)-1) &&
-                      (k == no_of_weights-1))) {
-                    fprintf(fp, ",");
-                }
-            }
+    }
+
+    i = (net->NoOfInputs > net->NoOfOutputs) ?
+        net->NoOfInputs : net->NoOfOutputs;
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        if (net->layer[l].NoOfUnits > i) {
+            i = net->layer[l].NoOfUnits;
         }
-        fprintf(fp, "]\n\n");
+    }
+    scale = (float*)malloc(i*sizeof(float));
+    offset = (float*)malloc(i*sizeof(float));
+    if ((!scale) || (!offset)) {
+        free(scale);
+        free(offset);
+        return -2;
     }
 
-    /* hidden unit biases */
-    for (i = 0; i < learner->net->HiddenLayers; i++) {
-        fprintf(fp,
-                "  hidden_layer_%d_bias = [", i);
-        for (j = 0; j < bp_hiddens_in_layer(learner->net, i); j++) {
-            fprintf(fp,"%.10f",learner->net->hiddens[i][j]->bias);
-            if (j < bp_hiddens_in_layer(learner->net, i)-1) {
+    fp = fopen(filename,"w");
+    if (!fp) {
+        free(scale);
+        free(offset);
+        return -1;
+    }
+
+    fprintf(fp, "%s", "#!/usr/bin/python\n\n");
+    fprintf(fp, "%s", "import sys\n");
+    fprintf(fp, "%s", "import numpy as np\n\n\n");
+
+    fprintf(fp,"%s\n\n","class NeuralNet:");
+
+    if (learner->no_of_input_fields > 0) {
+        fprintf(fp, "  no_of_input_fields = %d\n",
+                learner->no_of_input_fields);
+    }
+    fprintf(fp, "  no_of_inputs = %d\n", net->NoOfInputs);
+    fprintf(fp, "  no_of_hiddens = %d\n", net->NoOfHiddens);
+    fprintf(fp, "  no_of_outputs = %d\n", net->NoOfOutputs);
+    fprintf(fp, "  hidden_layers = %d\n\n", net->HiddenLayers);
+
+    /* field lengths */
+    if (learner->no_of_input_fields > 0) {
+        fprintf(fp, "%s", "  field_length = [");
+        for (i = 0; i < learner->no_of_input_fields; i++) {
+            fprintf(fp, "%d", learner->field_length[i]);
+            if (i < learner->no_of_input_fields-1) {
                 fprintf(fp, ",");
             }
         }
-        fprintf(fp, "]\n\n");
+        fprintf(fp, "%s", "]\n\n");
     }
 
-    /* output unit weights */
-    fprintf(fp,
-            "  output_layer_weights = [");
-    for (i = 0; i < learner->net->NoOfOutputs; i++) {
-        for (j = 0; j < bp_hiddens_in_layer(learner->net, learner->net->HiddenLayers-1); j++) {
-            fprintf(fp, "%.10f",
-                    learner->net->outputs[i]->weights[j]);
-            if (!((i == learner->net->NoOfOutputs-1) &&
-                  (j == bp_hiddens_in_layer(learner->net, learner->net->HiddenLayers-1)-1))) {
-                fprintf(fp, ",");
+    /* normalisation of numeric inputs as a scale and offset */
+    for (i = 0; i < net->NoOfInputs; i++) {
+        scale[i] = 1;
+        offset[i] = 0;
+        if (learner->no_of_input_fields > 0) {
+            range = learner->input_range_max[i] - learner->input_range_min[i];
+            if (range > 0) {
+                scale[i] = 0.5f / range;
+                offset[i] = 0.25f - (learner->input_range_min[i]*scale[i]);
             }
         }
     }
-    fprintf(fp, "]\n\n");
-
-    /* output unit biases */
-    fprintf(fp, "%s",
-            "  output_layer_bias = [");
-    for (i = 0; i < learner->net->NoOfOutputs; i++) {
-        fprintf(fp, "%.10f",
-                learner->net->outputs[i]->bias);
-        if (i < learner->net->NoOfOutputs-1) {
-            fprintf(fp, ",");
+    deeplearn_export_python_array(fp, "input_scale", scale, 0,
+                                  net->NoOfInputs);
+    deeplearn_export_python_array(fp, "input_offset", offset, 0,
+                                  net->NoOfInputs);
+
+    /* weight matrices, stored transposed so that a batch of rows can be
+       multiplied by them directly */
+    for (l = 1; l < net->HiddenLayers+2; l++) {
+        layer = &net->layer[l];
+        sprintf(name, "layer_%d_weights", l-1);
+        deeplearn_export_python_array(fp, name, layer->weights,
+                                      layer->NoOfUnits, layer->NoOfInputs);
+        fprintf(fp, "  layer_%d_weights = layer_%d_weights.T.copy()\n\n",
+                l-1, l-1);
+        for (i = 0; i < layer->NoOfUnits; i++) {
+            scale[i] = layer->units[i].bias;
         }
+        sprintf(name, "layer_%d_bias", l-1);
+        deeplearn_export_python_array(fp, name, scale, 0, layer->NoOfUnits);
     }
-    fprintf(fp, "%s", "]\n\n\n");
 
-    if (learner->no_of_input_fields > 0) {
-        fprintf(fp, "%s", "  # Encode some text into the input units\n");
-        fprintf(fp, "%s", "  def encode_text(this, text,inputs,no_of_inputs,");
-        fprintf(fp, "%s", "  offset, max_field_length_chars):\n");
-
-        fprintf(fp, "%s", "    pos = offset\n");
-        fprintf(fp, "%s", "    max_chars = len(text)\n\n");
-
-        fprintf(fp, "    if max_chars > (no_of_inputs-offset)/%d:\n", (int)CHAR_BITS);
-        fprintf(fp, "      max_chars = ((no_of_inputs-offset)/%d)\n\n", (int)CHAR_BITS);
+    for (i = 0; i < net->NoOfOutputs; i++) {
+        scale[i] = 1;
+        offset[i] = 0;
+        range = learner->output_range_max[i] - learner->output_range_min[i];
+        if (range > 0) {
+            scale[i] = range / 0.5f;
+            offset[i] = learner->output_range_min[i] - (0.25f*scale[i]);
+        }
+    }
+    deeplearn_export_python_array(fp, "output_scale", scale, 0,
+                                  net->NoOfOutputs);
+    deeplearn_export_python_array(fp, "output_offset", offset, 0,
+                                  net->NoOfOutputs);
+    free(scale);
+    free(offset);
 
-        fprintf(fp, "%s", "    if max_chars > max_field_length_chars:\n");
-        fprintf(fp, "%s", "      max_chars = max_field_length_chars\n\n");
+    fprintf(fp, "%s", "  weights = [");
+    for (l = 0; l < net->HiddenLayers+1; l++) {
+        fprintf(fp, "layer_%d_weights%s", l,
+                (l < net->HiddenLayers) ? ", " : "]\n");
+    }
+    fprintf(fp, "%s", "  bias = [");
+    for (l = 0; l < net->HiddenLayers+1; l++) {
+        fprintf(fp, "layer_%d_bias%s", l,
+                (l < net->HiddenLayers) ? ", " : "]\n\n");
+    }
 
-        fprintf(fp, "%s", "    # for each character in the string\n");
-        fprintf(fp, "%s", "    for i in range(max_chars):\n");
-        fprintf(fp, "%s", "      # set the bits for this character\n");
-        fprintf(fp,       "      for bit in range(%d):\n", (int)CHAR_BITS);
-        fprintf(fp, "%s", "        if ord(text[i]) & (1 << bit):\n");
-        fprintf(fp, "%s", "          inputs.append(0.75)\n");
+    if (text_fields != 0) {
+        fprintf(fp, "%s", "  # Encode some text into the input units\n");
+        fprintf(fp, "%s", "  def encode_text(this, text, network_inputs, offset,\n");
+        fprintf(fp, "%s", "                  max_field_length_chars):\n");
+        fprintf(fp, "%s", "    # the bits of each character, then neutral values\n");
+        fprintf(fp,       "    field = np.full(max_field_length_chars*%d, 0.5, dtype=np.float32)\n",
+                (int)CHAR_BITS);
+        fprintf(fp, "%s", "    chars = np.frombuffer(text.encode('latin-1', 'replace')[:max_field_length_chars],\n");
+        fprintf(fp, "%s", "                          dtype=np.uint8)\n");
+        fprintf(fp,       "    bits = (chars[:, np.newaxis] >> np.arange(%d)) & 1\n",
+                (int)CHAR_BITS);
+        fprintf(fp, "%s", "    field[:bits.size] = np.where(bits.ravel() == 1, 0.75, 0.25)\n");
+        fprintf(fp, "%s", "    end = min(offset + field.size, this.no_of_inputs)\n");
+        fprintf(fp, "%s", "    network_inputs[offset:end] = field[:end - offset]\n\n");
+
+        fprintf(fp, "%s", "  # Encode rows of field values into input unit values\n");
+        fprintf(fp, "%s", "  def encode(this, rows):\n");
+        fprintf(fp, "%s", "    network_inputs = np.zeros((len(rows), this.no_of_inputs), dtype=np.float32)\n");
+        fprintf(fp, "%s", "    for r, row in enumerate(rows):\n");
+        fprintf(fp, "%s", "      pos = 0\n");
+        fprintf(fp, "%s", "      for i in range(this.no_of_input_fields):\n");
+        fprintf(fp, "%s", "        if this.field_length[i] == 0:\n");
+        fprintf(fp, "%s", "          network_inputs[r, pos] = float(row[i])*this.input_scale[i] + this.input_offset[i]\n");
+        fprintf(fp, "%s", "          pos = pos + 1\n");
         fprintf(fp, "%s", "        else:\n");
-        fprintf(fp, "%s", "          inputs.append(0.25)\n");
-        fprintf(fp, "%s", "        pos = pos + 1\n\n");
-
-        fprintf(fp, "%s", "    # set the remaining inputs within the field to neutral\n");
-        fprintf(fp, "%s", "    i = max_chars\n");
-        fprintf(fp, "%s", "    while i < max_field_length_chars:\n");
-        fprintf(fp,       "      for bit in range (%d):\n", (int)CHAR_BITS);
-        fprintf(fp, "%s", "        if pos >= no_of_inputs:\n");
-        fprintf(fp, "%s", "          i = max_field_length_chars\n");
-        fprintf(fp, "%s", "          break\n");
-        fprintf(fp, "%s", "        inputs.append(0.5)\n");
-        fprintf(fp, "%s", "        pos = pos + 1\n");
-        fprintf(fp, "%s", "      i = i + 1\n\n");
+        fprintf(fp, "%s", "          this.encode_text(str(row[i]), network_inputs[r], pos,\n");
+        fprintf(fp,       "                           this.field_length[i] // %d)\n",
+                (int)CHAR_BITS);
+        fprintf(fp, "%s", "          pos = pos + this.field_length[i]\n");
+        fprintf(fp, "%s", "    return network_inputs\n\n");
     }
+    else {
+        fprintf(fp, "%s", "  # Encode rows of numeric values into input unit values\n");
+        fprintf(fp, "%s", "  def encode(this, rows):\n");
+        fprintf(fp, "%s", "    network_inputs = np.asarray(rows, dtype=np.float32)\n");
+        fprintf(fp, "%s", "    if network_inputs.ndim == 1:\n");
+        fprintf(fp, "%s", "      network_inputs = network_inputs.reshape(1, -1)\n");
+        fprintf(fp, "%s", "    return network_inputs*this.input_scale + this.input_offset\n\n");
+    }
+
+    deeplearn_export_python_af(fp, net->activation);
+
+    fprintf(fp, "%s", "  # Evaluate a two dimensional batch of rows, returning one row\n");
+    fprintf(fp, "%s", "  # of output values for each\n");
+    fprintf(fp, "%s", "  def predict(this, rows):\n");
+    fprintf(fp, "%s", "    x = this.encode(rows)\n");
+    fprintf(fp, "%s", "    for layer in range(this.hidden_layers):\n");
+    fprintf(fp, "%s", "      x = this.af(x.dot(this.weights[layer]) + this.bias[layer])\n");
+    fprintf(fp, "%s", "    x = x.dot(this.weights[-1]) + this.bias[-1]\n");
+    fprintf(fp, "%s", "    x = 1.0 / (1.0 + np.exp(-x))\n\n");
+    fprintf(fp, "%s", "    # Convert outputs from 0.25 - 0.75 back to their original range\n");
+    fprintf(fp, "%s", "    return x*this.output_scale + this.output_offset\n\n");
 
+    fprintf(fp, "%s", "  # Evaluate a single sample, returning the output values as a list\n");
     fprintf(fp, "%s", "  def update(this, inputs):\n");
-
-    if (learner->no_of_input_fields > 0) {
-        fprintf(fp, "%s", "    pos = 0\n");
-    }
-    fprintf(fp, "%s", "    network_inputs = []\n");
-    fprintf(fp, "%s", "    prev_hiddens = []\n");
-    fprintf(fp, "%s", "    hiddens = []\n");
-    fprintf(fp, "%s", "    outputs = []\n\n");
     if (learner->no_of_input_fields == 0) {
-        fprintf(fp, "    if len(inputs) < %d:\n", learner->net->NoOfInputs);
+        fprintf(fp, "%s", "    if len(inputs) < this.no_of_inputs:\n");
+        fprintf(fp, "%s", "      return []\n");
+        fprintf(fp, "%s", "    row = [float(value) for value in inputs[:this.no_of_inputs]]\n");
     }
-    else {
-        fprintf(fp, "    if len(inputs) < %d:\n", learner->no_of_input_fields);
-    }
-    fprintf(fp, "%s", "        return []\n\n");
-
-    if (learner->no_of_input_fields == 0) {
-        fprintf(fp, "%s", "    # Normalise inputs into a 0.25 - 0.75 range\n");
-        fprintf(fp, "%s", "    for i in range (this.no_of_inputs):\n");
-        fprintf(fp, "%s", "      network_inputs.append(0.25 + ((float(inputs[i]) - this.input_range_min[i])*0.5/(this.input_range_max[i] - this.input_range_min[i])))\n");
-        fprintf(fp, "%s", "      if network_inputs[i] < 0.25:\n");
-        fprintf(fp, "%s", "        network_inputs[i] = 0.25\n");
-        fprintf(fp, "%s", "      if network_inputs[i] > 0.75:\n");
-        fprintf(fp, "%s", "        network_inputs[i] = 0.75\n");
+    else if (text_fields == 0) {
+        fprintf(fp, "%s", "    if len(inputs) < this.no_of_input_fields:\n");
+        fprintf(fp, "%s", "      return []\n");
+        fprintf(fp, "%s", "    row = [float(value) for value in inputs[:this.no_of_input_fields]]\n");
     }
     else {
-        fprintf(fp, "%s", "    for i in range(this.no_of_input_fields):\n");
-        fprintf(fp, "%s", "      if this.field_length[i] == 0:\n");
-        fprintf(fp, "%s", "        # Normalise numeric inputs into a 0.25 - 0.75 range\n");
-        fprintf(fp, "%s", "        network_inputs.append(0.25 + ((float(inputs[i]) - this.input_range_min[i])*0.5/(this.input_range_max[i] - this.input_range_min[i])))\n");
-        fprintf(fp, "%s", "        if network_inputs[pos] < 0.25:\n");
-        fprintf(fp, "%s", "          network_inputs[pos] = 0.25\n");
-        fprintf(fp, "%s", "        if network_inputs[pos] > 0.75:\n");
-        fprintf(fp, "%s", "          network_inputs[pos] = 0.75\n\n");
-        fprintf(fp, "%s", "        pos = pos + 1\n");
-        fprintf(fp, "%s", "      else:\n");
-        fprintf(fp, "%s", "        # text value\n");
-        fprintf(fp, "%s", "        this.encode_text(inputs[i], network_inputs, this.no_of_inputs,");
-        fprintf(fp,       "pos, this.field_length[i]/%d)\n", (int)CHAR_BITS);
-        fprintf(fp, "%s", "        pos = pos + this.field_length[i]\n\n");
-    }
-
-    fprintf(fp, "%s", "    # Hidden layer 0\n");
-    fprintf(fp, "%s", "    for i in range(this.no_of_hiddens):\n");
-    fprintf(fp, "%s", "      adder = this.hidden_layer_0_bias[i]\n");
-    fprintf(fp, "%s", "      for j in range(this.no_of_inputs):\n");
-    fprintf(fp, "%s", "        adder = adder + this.hidden_layer_0_weights[i*this.no_of_inputs+j]*network_inputs[j]\n");
-    fprintf(fp, "%s", "      hiddens.append(1.0 / (1.0 + math.exp(-adder)))\n");
-    fprintf(fp, "%s", "    for i in range(this.no_of_hiddens):\n");
-    fprintf(fp, "%s", "      prev_hiddens.append(hiddens[i])\n\n");
-    for (i = 1; i < learner->net->HiddenLayers; i++) {
-        fprintf(fp, "    # Hidden layer %d\n", i);
-        fprintf(fp, "    for i in range(%d):\n", bp_hiddens_in_layer(learner->net,i));
-        fprintf(fp, "      adder = this.hidden_layer_%d_bias[i]\n",i);
-        fprintf(fp, "      for j in range(%d):\n",bp_hiddens_in_layer(learner->net,i-1));
-        fprintf(fp, "        adder = adder + this.hidden_layer_%d_weights[i*%d+j]*prev_hiddens[j]\n",i,bp_hiddens_in_layer(learner->net,i-1));
-        fprintf(fp, "%s", "      hiddens[i] = 1.0 / (1.0 + math.exp(-adder))\n");
-        fprintf(fp, "    for i in range(%d):\n",bp_hiddens_in_layer(learner->net,i));
-        fprintf(fp, "%s", "      prev_hiddens[i] = hiddens[i]\n\n");
-    }
-    fprintf(fp, "%s", "    # Output layer\n");
-    fprintf(fp, "%s", "    for i in range(this.no_of_outputs):\n");
-    fprintf(fp, "%s", "      adder = this.output_layer_bias[i]\n");
-    fprintf(fp, "      for j in range(%d):\n",bp_hiddens_in_layer(learner->net,learner->net->HiddenLayers-1));
-    fprintf(fp, "        adder = adder + this.output_layer_weights[i*%d+j]*prev_hiddens[j]\n",bp_hiddens_in_layer(learner->net,learner->net->HiddenLayers-1));
-    fprintf(fp, "%s", "      outputs.append(1.0 / (1.0 + math.exp(-adder)))\n\n");
-    fprintf(fp, "%s", "    # Convert outputs from 0.25 - 0.75 back to their original range\n");
-    fprintf(fp, "%s", "    for i in range(this.no_of_outputs):\n");
-    fprintf(fp, "%s", "      outputs[i] = this.output_range_min[i] + ((outputs[i]-0.25)*(this.output_range_max[i] - this.output_range_min[i])/0.5)\n\n");
-
-    fprintf(fp, "%s", "    # Return the output unit values as a list\n");
-    fprintf(fp, "%s", "    return outputs\n\n\n");
+        fprintf(fp, "%s", "    if len(inputs) < this.no_of_input_fields:\n");
+        fprintf(fp, "%s", "      return []\n");
+        fprintf(fp, "%s", "    row = inputs[:this.no_of_input_fields]\n");
+    }
+    fprintf(fp, "%s", "    return [float(value) for value in this.predict([row])[0]]\n\n\n");
 
-    fprintf(fp, "%s", "# Create an instance of the class\n");
-    fprintf(fp, "%s", "net = NeuralNet()\n\n");
-    fprintf(fp, "%s", "# Use the commandline arguments as input values\n");
-    fprintf(fp, "%s", "print net.update(sys.argv[1:])\n");
+    fprintf(fp, "%s", "if __name__ == '__main__':\n");
+    fprintf(fp, "%s", "  # Create an instance of the class\n");
+    fprintf(fp, "%s", "  net = NeuralNet()\n\n");
+    fprintf(fp, "%s", "  # Use the commandline arguments as input values\n");
+    fprintf(fp, "%s", "  print(net.update(sys.argv[1:]))\n");
     fclose(fp);
     return 0;
 }
@@ -38,6 +38,17 @@
 #include "autocoder.h"
 #include "encoding.h"
 #include "deeplearn_conv.h"
+#include "deeplearn_history.h"
+#include "deeplearn_split.h"
+#include "deeplearn_prefetch.h"
+#include "deeplearn_schedule.h"
+#include "deeplearn_stream.h"
+#include "deeplearn_exits.h"
+
+/* identifier and version at the start of a saved deep learner.
+   Version 1 added the classifier heads of deeplearn_exits_enable */
+#define DEEPLEARN_FILE_MAGIC   "LIBDEEPL"
+#define DEEPLEARN_FILE_VERSION 1
 
 struct deeplearndata {
     float * inputs;
@@ -45,6 +56,11 @@ struct deeplearndata {
     float * outputs;
     unsigned int flags;
     unsigned int labeled;
+    /* encoded network inputs and targets within the sample cache */
+    float * encoded_inputs;
+    float * encoded_outputs;
+    /* outputs of the last trained hidden layer within the activation cache */
+    float * activations;
     struct deeplearndata * prev;
     struct deeplearndata * next;
 };
@@ -57,6 +73,123 @@ struct deeplearndata_meta {
 };
 typedef struct deeplearndata_meta deeplearndata_meta;
 
+/* Contiguous storage for data samples. Inputs and outputs for all
+   samples are held within two aligned float arrays, and the training,
+   labeled training and test sets are index vectors into the samples.
+   The sample headers are linked in order so that the data can still be
+   walked as a list. */
+struct deeplearndata_arena {
+    int capacity;
+    int samples;
+    int no_of_input_fields;
+    int no_of_outputs;
+    float * inputs;
+    float * outputs;
+    void * inputs_allocation;
+    void * outputs_allocation;
+    deeplearndata * sample;
+
+    /* text fields packed into fixed width slots, once the field
+       lengths are known */
+    char * text;
+    char ** text_fields;
+    int text_row;
+
+    int * training;
+    int training_samples;
+    int * training_labeled;
+    int training_labeled_samples;
+    int * test;
+    int test_samples;
+
+    /* if loaded from a dataset file then the inputs, outputs and text
+       lie within its mapping rather than being allocated */
+    void * mapping;
+    size_t mapping_size;
+    int mapped;
+};
+typedef struct deeplearndata_arena deeplearndata_arena;
+
+/* Network input and target vectors for every data sample, encoded once
+   so that training steps can copy them rather than normalising each
+   field and encoding text again. The ranges used for encoding are kept
+   so that the cache can be detected as stale if they change. */
+struct deeplearn_sample_cache {
+    unsigned char enabled;
+    unsigned char valid;
+    int samples;
+    int no_of_input_fields;
+    int no_of_outputs;
+    float * inputs;
+    float * outputs;
+
+    /* non-zero for units which are set from a sample */
+    unsigned char * input_set;
+    unsigned char * output_set;
+
+    float * input_range_min;
+    float * input_range_max;
+    float * output_range_min;
+    float * output_range_max;
+};
+typedef struct deeplearn_sample_cache deeplearn_sample_cache;
+
+/* Training samples encoded ahead of the learner by worker threads. The
+   field ranges are copied when the queue is filled, so that the workers
+   never read ranges which the learner thread may change. */
+struct deeplearn_sample_prefetch {
+    unsigned char enabled;
+    deeplearn_prefetch queue;
+    int no_of_input_fields;
+    int no_of_outputs;
+
+    /* non-zero for units which are set from a sample */
+    unsigned char * input_set;
+    unsigned char * output_set;
+
+    float * input_range_min;
+    float * input_range_max;
+    float * output_range_min;
+    float * output_range_max;
+};
+typedef struct deeplearn_sample_prefetch deeplearn_sample_prefetch;
+
+/* Outputs of the frozen hidden layers for every training sample. Once a
+   hidden layer has been pretrained its outputs are computed for each
+   training sample, so that pretraining of the next layer does not need
+   to feed each sample forward through the layers below. */
+struct deeplearn_activation_cache {
+    unsigned char enabled;
+
+    /* hidden layer whose outputs are cached, or -1 if none */
+    int layer;
+    int samples;
+    int width;
+    float * values;
+};
+typedef struct deeplearn_activation_cache deeplearn_activation_cache;
+
+/* Pipelined continuous learning.  The autocoder for each hidden layer
+   trains concurrently with the others, with layer k consuming the
+   encodings produced by layer k-1 during the previous update */
+struct deeplearn_pipeline {
+    unsigned char enabled;
+
+    /* number of pipelined updates, used to know which layers have
+       received encodings from the layer below */
+    unsigned int updates;
+
+    /* latest encodings produced by each hidden layer */
+    float ** encodings;
+};
+typedef struct deeplearn_pipeline deeplearn_pipeline;
+
+struct deepl;
+
+/* called whenever an entry is added to the training history, returning
+   non-zero if training should stop */
+typedef int (*deeplearn_early_stop)(struct deepl * learner, void * data);
+
 struct deepl {
     bp * net;
     ac ** autocoder;
@@ -88,6 +221,38 @@ struct deepl {
     deeplearndata_meta ** indexed_test_data;
     int indexed_test_data_samples;
 
+    /* used instead of the lists above when samples are in an arena */
+    deeplearndata_arena arena;
+
+    /* memory holding the network, autocoders, ranges and error
+       thresholds, so that the model is freed in one step */
+    deeplearn_arena model_arena;
+
+    /* optional cache of encoded samples */
+    deeplearn_sample_cache cache;
+
+    /* optional encoding of training samples on worker threads */
+    deeplearn_sample_prefetch prefetch;
+
+    /* optional cache of frozen layer outputs used during pretraining */
+    deeplearn_activation_cache activations;
+
+    /* optional pipelined training of the autocoders */
+    deeplearn_pipeline pipeline;
+
+    /* optional copies of the network on each NUMA node for inference */
+    bp_replicas replicas;
+
+    /* optional classifier heads on the hidden layers, so that inference
+       can stop early for easy samples */
+    deeplearn_exits exits;
+
+    /* sequential sampling of the training set in epochs */
+    deeplearn_epoch epoch;
+
+    /* optional source of training samples used instead of the data set */
+    deeplearn_stream * stream;
+
     float * input_range_min;
     float * input_range_max;
     float * output_range_min;
@@ -98,8 +263,18 @@ struct deepl {
     char history_plot_filename[256];
     char history_plot_title[256];
 
+    /* if set then graphs are plotted on a background thread */
+    deeplearn_history_plotter * history_plotter;
+
     float history[DEEPLEARN_HISTORY_SIZE];
     int history_index, history_ctr, history_step;
+
+    /* learning rate schedule, plateau detection and update limit */
+    deeplearn_schedule schedule;
+
+    /* optional test of whether training should stop early */
+    deeplearn_early_stop early_stop;
+    void * early_stop_data;
 };
 typedef struct deepl deeplearn;
 
@@ -111,16 +286,57 @@ int deeplearn_init(deeplearn * learner,
                    float error_threshold[],
                    unsigned int * random_seed);
 void deeplearn_feed_forward(deeplearn * learner);
+int deeplearn_feed_forward_exit(deeplearn * learner);
 void deeplearn_update(deeplearn * learner);
+void deeplearn_update_activations(deeplearn * learner,
+                                  const float * activations);
+int deeplearn_update_batch(deeplearn * learner,
+                           deeplearndata ** samples, int no_of_samples);
+int deeplearn_update_batch_values(deeplearn * learner,
+                                  float * inputs, float * targets,
+                                  int batch_size);
+int deeplearn_update_hogwild(deeplearn * learner,
+                             float * inputs, float * targets,
+                             int no_of_samples, int no_of_threads);
+int deeplearn_apply_gradients(deeplearn * learner, float * gradients);
 void deeplearn_free(deeplearn * learner);
+int deeplearn_init_like(deeplearn * learner, deeplearn * source,
+                        int no_of_hiddens, int hidden_layers,
+                        unsigned int * random_seed);
+int deeplearn_clone(deeplearn * dest, deeplearn * source);
 void deeplearn_set_input_text(deeplearn * learner, char * text);
 void deeplearn_set_input(deeplearn * learner, int index, float value);
 int deeplearn_set_input_field(deeplearn * learner, int fieldindex, float value);
 int deeplearn_set_input_field_text(deeplearn * learner, int fieldindex, char * text);
 void deeplearn_set_inputs(deeplearn * learner, deeplearndata * sample);
+void deeplearn_encode_inputs(deeplearn * learner, deeplearndata * sample,
+                             float * encoded);
 void deeplearn_set_output(deeplearn * learner, int index, float value);
 void deeplearn_set_outputs(deeplearn * learner, deeplearndata * sample);
+void deeplearn_encode_outputs(deeplearn * learner, deeplearndata * sample,
+                              float * encoded);
 void deeplearn_get_outputs(deeplearn * learner, float * outputs);
+int deeplearn_cache_enable(deeplearn * learner);
+void deeplearn_cache_disable(deeplearn * learner);
+void deeplearn_cache_invalidate(deeplearn * learner);
+int deeplearn_cache_update(deeplearn * learner);
+int deeplearn_set_prefetch(deeplearn * learner, int capacity,
+                           int no_of_threads);
+int deeplearn_update_prefetch(deeplearn * learner);
+void deeplearn_activations_enable(deeplearn * learner);
+void deeplearn_activations_disable(deeplearn * learner);
+void deeplearn_activations_release(deeplearn * learner);
+int deeplearn_activations_current(deeplearn * learner);
+void deeplearn_memory_usage(deeplearn * learner, deeplearn_footprint * usage);
+void deeplearn_trim_memory(deeplearn * learner);
+int deeplearn_inference_init(deeplearn * learner, bp_inference * ctx,
+                             int batch_capacity);
+int deeplearn_set_replicas(deeplearn * learner, unsigned char enabled);
+int deeplearn_set_neutral_inputs(deeplearn * learner, unsigned char enabled);
+int deeplearn_exits_enable(deeplearn * learner, float threshold);
+void deeplearn_exits_disable(deeplearn * learner);
+int deeplearn_infer(deeplearn * learner, bp_inference * ctx,
+                    float * inputs, float * outputs, int batch_size);
 float deeplearn_get_output(deeplearn * learner, int index);
 int deeplearn_get_class(deeplearn * learner);
 void deeplearn_set_class(deeplearn * learner, int class);
@@ -132,6 +348,10 @@ int deeplearn_compare(deeplearn * learner1,
 int deeplearn_plot_history(deeplearn * learner,
                            char * filename, char * title,
                            int image_width, int image_height);
+void deeplearn_set_history_plotter(deeplearn * learner,
+                                   deeplearn_history_plotter * plotter);
+int deeplearn_plot_training_history(deeplearn * learner,
+                                    int image_width, int image_height);
 void deeplearn_inputs_from_image_patch(deeplearn * learner,
                                        unsigned char * img,
                                        int image_width, int image_height,
@@ -141,10 +361,25 @@ void deeplearn_inputs_from_image(deeplearn * learner,
                                  int image_width, int image_height);
 void deeplearn_set_learning_rate(deeplearn * learner, float rate);
 void deeplearn_set_dropouts(deeplearn * learner, float dropout_percent);
+int deeplearn_set_activation(deeplearn * learner, int function);
+int deeplearn_set_optimiser(deeplearn * learner, int type);
+int deeplearn_freeze_layers(deeplearn * learner, int layers);
 int deeplearn_export(deeplearn * learner, char * filename);
+int deeplearn_export_library(deeplearn * learner, char * filename);
 float deeplearn_get_error_threshold(deeplearn * learner, int index);
 void deeplearn_set_error_threshold(deeplearn * learner, int index, float value);
+int deeplearn_set_schedule(deeplearn * learner, int type,
+                           float base_rate, float min_rate,
+                           unsigned int period, float gamma);
+void deeplearn_set_warmup(deeplearn * learner, unsigned int updates);
+int deeplearn_set_plateau(deeplearn * learner,
+                          unsigned int patience, float min_delta,
+                          float factor, unsigned int max_reductions);
+void deeplearn_set_max_updates(deeplearn * learner, unsigned int updates);
+void deeplearn_set_early_stop(deeplearn * learner,
+                              deeplearn_early_stop callback, void * data);
 void deeplearn_update_continuous(deeplearn * learner);
+int deeplearn_set_pipelined(deeplearn * learner, unsigned char enabled);
 int deeplearn_training_last_layer(deeplearn * learner);
 void copy_autocoder_to_hidden_layer(deeplearn * learner, int hidden_layer);
 void deeplearn_pretrain(bp * net, ac * autocoder, int current_layer);
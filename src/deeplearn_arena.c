@@ -0,0 +1,149 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_arena.h"
+
+/**
+ * @brief Returns the number of bytes which an array takes up within
+ *        an arena, including the padding needed to align the next array
+ * @param bytes Size of the array in bytes
+ * @returns Size of the array rounded up to the arena alignment
+ */
+size_t deeplearn_arena_bytes(size_t bytes)
+{
+    return (bytes + DEEPLEARN_ARENA_ALIGNMENT - 1) &
+        ~((size_t)DEEPLEARN_ARENA_ALIGNMENT - 1);
+}
+
+/**
+ * @brief Allocates the block of memory for an arena
+ * @param arena Arena object
+ * @param size Total size in bytes, being the sum of deeplearn_arena_bytes
+ *        for each of the arrays to be allocated
+ * @returns zero on success
+ */
+int deeplearn_arena_init(deeplearn_arena * arena, size_t size)
+{
+    arena->size = 0;
+    arena->used = 0;
+    arena->block = 0;
+    arena->allocation = calloc(1, size + DEEPLEARN_ARENA_ALIGNMENT);
+    if (!arena->allocation) {
+        return -1;
+    }
+    arena->block =
+        (char*)(((uintptr_t)arena->allocation + DEEPLEARN_ARENA_ALIGNMENT - 1) &
+                ~((uintptr_t)DEEPLEARN_ARENA_ALIGNMENT - 1));
+    arena->size = size;
+    return 0;
+}
+
+/**
+ * @brief Takes an aligned array from an arena
+ * @param arena Arena object
+ * @param bytes Size of the array in bytes
+ * @returns The array, or NULL if the arena does not have enough space
+ */
+void * deeplearn_arena_alloc(deeplearn_arena * arena, size_t bytes)
+{
+    size_t length = deeplearn_arena_bytes(bytes);
+    void * ptr;
+
+    if ((arena->block == 0) || (length > arena->size - arena->used)) {
+        return NULL;
+    }
+    ptr = (void*)&arena->block[arena->used];
+    arena->used += length;
+    return ptr;
+}
+
+/**
+ * @brief Makes a copy of an arena and everything taken from it so far.
+ *        Pointers held within the copy still refer to the source until
+ *        they are moved with deeplearn_arena_relocate.
+ * @param dest Arena to be created
+ * @param source Arena to be copied
+ * @returns zero on success
+ */
+int deeplearn_arena_clone(deeplearn_arena * dest, deeplearn_arena * source)
+{
+    if (deeplearn_arena_init(dest, source->size) != 0) {
+        return -1;
+    }
+    memcpy((void*)dest->block, (void*)source->block, source->used);
+    dest->used = source->used;
+    return 0;
+}
+
+/**
+ * @brief Returns the equivalent within a cloned arena of a pointer into
+ *        the source arena.  Pointers to memory outside of the source
+ *        arena are returned unchanged.
+ * @param dest Cloned arena
+ * @param source Arena from which the clone was made
+ * @param ptr Pointer to be moved
+ * @returns The pointer within the cloned arena
+ */
+void * deeplearn_arena_relocate(deeplearn_arena * dest,
+                                deeplearn_arena * source,
+                                void * ptr)
+{
+    char * p = (char*)ptr;
+
+    if ((p == 0) || (source->block == 0) ||
+        (p < source->block) || (p >= source->block + source->size)) {
+        return ptr;
+    }
+    return (void*)&dest->block[p - source->block];
+}
+
+/**
+ * @brief Returns the number of bytes allocated for an arena, including
+ *        the padding used to align its block
+ * @param arena Arena object
+ * @returns Allocated bytes, or zero if the arena is not allocated
+ */
+size_t deeplearn_arena_allocated(deeplearn_arena * arena)
+{
+    if (!arena->allocation) return 0;
+    return arena->size + DEEPLEARN_ARENA_ALIGNMENT;
+}
+
+/**
+ * @brief Frees an arena together with every array taken from it
+ * @param arena Arena object
+ */
+void deeplearn_arena_free(deeplearn_arena * arena)
+{
+    free(arena->allocation);
+    arena->allocation = 0;
+    arena->block = 0;
+    arena->size = 0;
+    arena->used = 0;
+}
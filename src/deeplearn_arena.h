@@ -0,0 +1,64 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_ARENA_H
+#define DEEPLEARN_ARENA_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "deeplearn_footprint.h"
+
+/* alignment in bytes of each array carved from an arena */
+#define DEEPLEARN_ARENA_ALIGNMENT 64
+
+/* A single block of memory from which the arrays of a network are
+   taken in order.  The size of the block is worked out before
+   construction using deeplearn_arena_bytes, so that creating a model
+   is one allocation and freeing it is one free, rather than one for
+   every unit.  Memory within the block starts out as zero. */
+typedef struct {
+    void * allocation;
+    char * block;
+    size_t size;
+    size_t used;
+} deeplearn_arena;
+
+size_t deeplearn_arena_bytes(size_t bytes);
+int deeplearn_arena_init(deeplearn_arena * arena, size_t size);
+void * deeplearn_arena_alloc(deeplearn_arena * arena, size_t bytes);
+int deeplearn_arena_clone(deeplearn_arena * dest, deeplearn_arena * source);
+void * deeplearn_arena_relocate(deeplearn_arena * dest,
+                                deeplearn_arena * source,
+                                void * ptr);
+size_t deeplearn_arena_allocated(deeplearn_arena * arena);
+void deeplearn_arena_free(deeplearn_arena * arena);
+
+#endif
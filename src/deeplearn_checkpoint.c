@@ -0,0 +1,622 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <unistd.h>
+#include "deeplearn_checkpoint.h"
+#include "lodepng.h"
+
+/* thread state of a checkpointer */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    unsigned char stop;
+    unsigned char busy;
+} deeplearn_checkpoint_worker;
+
+/**
+ * @brief Groups the bytes of each 32 bit value together, so that the
+ *        similar sign and exponent bytes of weights sit next to each
+ *        other and compress well
+ * @param in Bytes to be shuffled
+ * @param out Returned shuffled bytes
+ * @param size The number of bytes
+ */
+static void checkpoint_shuffle(const unsigned char * in,
+                               unsigned char * out, size_t size)
+{
+    size_t i, words = size/4;
+    int b;
+
+    for (b = 0; b < 4; b++) {
+        for (i = 0; i < words; i++) {
+            out[b*words + i] = in[i*4 + b];
+        }
+    }
+    memcpy(&out[words*4], &in[words*4], size - words*4);
+}
+
+/**
+ * @brief Reverses checkpoint_shuffle
+ * @param in Shuffled bytes
+ * @param out Returned bytes in their original order
+ * @param size The number of bytes
+ */
+static void checkpoint_unshuffle(const unsigned char * in,
+                                 unsigned char * out, size_t size)
+{
+    size_t i, words = size/4;
+    int b;
+
+    for (b = 0; b < 4; b++) {
+        for (i = 0; i < words; i++) {
+            out[i*4 + b] = in[b*words + i];
+        }
+    }
+    memcpy(&out[words*4], &in[words*4], size - words*4);
+}
+
+/**
+ * @brief Frees the copies held by a snapshot
+ * @param snapshot Checkpoint snapshot
+ */
+static void checkpoint_snapshot_free(deeplearn_checkpoint_snapshot * snapshot)
+{
+    if (snapshot->convolution) {
+        conv_free(snapshot->convolution);
+        free(snapshot->convolution);
+        snapshot->convolution = NULL;
+    }
+    if (snapshot->learner) {
+        deeplearn_free(snapshot->learner);
+        free(snapshot->learner);
+        snapshot->learner = NULL;
+    }
+}
+
+/**
+ * @brief Saves a snapshot into memory in the usual file format, so that
+ *        it can be compressed and written with a single call
+ * @param snapshot Checkpoint snapshot
+ * @param data Returned saved bytes, which should be freed by the caller
+ * @param size Returned number of bytes
+ * @return zero on success
+ */
+static int checkpoint_serialise(deeplearn_checkpoint_snapshot * snapshot,
+                                char ** data, size_t * size)
+{
+    int retval = 0;
+    FILE * fp;
+
+    *data = NULL;
+    *size = 0;
+    fp = open_memstream(data, size);
+    if (!fp) {
+        return -1;
+    }
+    if (snapshot->convolution) {
+        if (conv_save(fp, snapshot->convolution) != 0) {
+            retval = -2;
+        }
+    }
+    if ((retval == 0) && (deeplearn_save(fp, snapshot->learner) != 0)) {
+        retval = -3;
+    }
+    fclose(fp);
+    if (retval != 0) {
+        free(*data);
+        *data = NULL;
+    }
+    return retval;
+}
+
+/**
+ * @brief Writes a snapshot to its file
+ * @param snapshot Checkpoint snapshot
+ * @param flags DEEPLEARN_CHECKPOINT_COMPRESS or zero
+ * @param header Returned file header
+ * @return zero on success
+ */
+static int checkpoint_write(deeplearn_checkpoint_snapshot * snapshot,
+                            unsigned int flags,
+                            deeplearn_checkpoint_header * header)
+{
+    char * data;
+    unsigned char * shuffled, * compressed = NULL, * stored;
+    size_t size, compressed_size = 0;
+    char temp_filename[300];
+    int retval = 0;
+    FILE * fp;
+
+    if (checkpoint_serialise(snapshot, &data, &size) != 0) {
+        return -1;
+    }
+
+    memset((void*)header, '\0', sizeof(deeplearn_checkpoint_header));
+    memcpy(header->magic, DEEPLEARN_CHECKPOINT_MAGIC, 8);
+    header->version = DEEPLEARN_CHECKPOINT_VERSION;
+    header->type = snapshot->type;
+    header->flags = flags;
+    header->raw_size = size;
+    header->stored_size = size;
+    stored = (unsigned char*)data;
+
+    if (flags & DEEPLEARN_CHECKPOINT_COMPRESS) {
+        shuffled = (unsigned char*)malloc(size);
+        if (!shuffled) {
+            free(data);
+            return -2;
+        }
+        checkpoint_shuffle((unsigned char*)data, shuffled, size);
+        if (lodepng_zlib_compress(&compressed, &compressed_size,
+                                  shuffled, size,
+                                  &lodepng_default_compress_settings) != 0) {
+            free(shuffled);
+            free(compressed);
+            free(data);
+            return -3;
+        }
+        free(shuffled);
+        header->stored_size = compressed_size;
+        stored = compressed;
+    }
+
+    /* write under a temporary name, then rename once it is complete */
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp",
+             snapshot->filename);
+    fp = fopen(temp_filename, "wb");
+    if (!fp) {
+        retval = -4;
+    }
+    else {
+        if ((fwrite(header, sizeof(deeplearn_checkpoint_header), 1, fp) != 1) ||
+            (fwrite(stored, 1, header->stored_size, fp) !=
+             header->stored_size) ||
+            (fflush(fp) != 0) ||
+            (fsync(fileno(fp)) != 0)) {
+            retval = -5;
+        }
+        fclose(fp);
+        if (retval == 0) {
+            if (rename(temp_filename, snapshot->filename) != 0) {
+                retval = -6;
+            }
+        }
+        if (retval != 0) {
+            remove(temp_filename);
+        }
+    }
+
+    free(compressed);
+    free(data);
+    return retval;
+}
+
+/**
+ * @brief Worker thread which writes snapshots as they are posted
+ * @param arg The checkpointer
+ * @return NULL
+ */
+static void * deeplearn_checkpoint_worker_run(void * arg)
+{
+    deeplearn_checkpointer * checkpointer = (deeplearn_checkpointer*)arg;
+    deeplearn_checkpoint_worker * worker =
+        (deeplearn_checkpoint_worker*)checkpointer->worker;
+    deeplearn_checkpoint_snapshot snapshot;
+    deeplearn_checkpoint_header header;
+    int retval;
+
+    pthread_mutex_lock(&worker->lock);
+    while (1) {
+        while ((checkpointer->pending == 0) && (worker->stop == 0)) {
+            pthread_cond_wait(&worker->wake, &worker->lock);
+        }
+        if (checkpointer->pending == 0) {
+            /* stopped with nothing left to write */
+            break;
+        }
+
+        /* take ownership so that training can continue to post */
+        snapshot = checkpointer->queue[checkpointer->head];
+        memset((void*)&checkpointer->queue[checkpointer->head], '\0',
+               sizeof(deeplearn_checkpoint_snapshot));
+        checkpointer->head =
+            (checkpointer->head + 1) % DEEPLEARN_CHECKPOINT_QUEUE;
+        checkpointer->pending--;
+        worker->busy = 1;
+        pthread_mutex_unlock(&worker->lock);
+
+        retval = checkpoint_write(&snapshot, checkpointer->flags, &header);
+        checkpoint_snapshot_free(&snapshot);
+
+        pthread_mutex_lock(&worker->lock);
+        worker->busy = 0;
+        if (retval == 0) {
+            checkpointer->written++;
+            checkpointer->raw_size = header.raw_size;
+            checkpointer->stored_size = header.stored_size;
+        }
+        else {
+            checkpointer->failed++;
+        }
+        if (checkpointer->pending == 0) {
+            pthread_cond_broadcast(&worker->idle);
+        }
+    }
+    pthread_cond_broadcast(&worker->idle);
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+
+/**
+ * @brief Starts a checkpointer which writes checkpoints on a
+ *        background thread
+ * @param checkpointer Checkpointer object
+ * @param flags DEEPLEARN_CHECKPOINT_COMPRESS to compress checkpoints,
+ *        or zero
+ * @return zero on success
+ */
+int deeplearn_checkpointer_init(deeplearn_checkpointer * checkpointer,
+                                unsigned int flags)
+{
+    deeplearn_checkpoint_worker * worker;
+
+    memset((void*)checkpointer, '\0', sizeof(deeplearn_checkpointer));
+    checkpointer->flags = flags;
+
+    worker =
+        (deeplearn_checkpoint_worker*)malloc(sizeof(deeplearn_checkpoint_worker));
+    if (!worker) {
+        return -1;
+    }
+    memset((void*)worker, '\0', sizeof(deeplearn_checkpoint_worker));
+    if (pthread_mutex_init(&worker->lock, NULL) != 0) {
+        free(worker);
+        return -2;
+    }
+    pthread_cond_init(&worker->wake, NULL);
+    pthread_cond_init(&worker->idle, NULL);
+    checkpointer->worker = worker;
+
+    if (pthread_create(&worker->thread, NULL,
+                       deeplearn_checkpoint_worker_run, checkpointer) != 0) {
+        pthread_cond_destroy(&worker->wake);
+        pthread_cond_destroy(&worker->idle);
+        pthread_mutex_destroy(&worker->lock);
+        free(worker);
+        checkpointer->worker = NULL;
+        return -3;
+    }
+    return 0;
+}
+
+/**
+ * @brief Adds a snapshot to the queue
+ * @param checkpointer Checkpointer object
+ * @param snapshot Snapshot, whose copies then belong to the checkpointer
+ * @return zero if queued or 1 if a pending snapshot was replaced
+ */
+static int checkpoint_queue(deeplearn_checkpointer * checkpointer,
+                            deeplearn_checkpoint_snapshot * snapshot)
+{
+    deeplearn_checkpoint_worker * worker =
+        (deeplearn_checkpoint_worker*)checkpointer->worker;
+    deeplearn_checkpoint_snapshot replaced;
+    int retval = 0;
+
+    memset((void*)&replaced, '\0', sizeof(deeplearn_checkpoint_snapshot));
+
+    pthread_mutex_lock(&worker->lock);
+    if (checkpointer->pending == DEEPLEARN_CHECKPOINT_QUEUE) {
+        /* replace the oldest pending snapshot */
+        replaced = checkpointer->queue[checkpointer->head];
+        checkpointer->head =
+            (checkpointer->head + 1) % DEEPLEARN_CHECKPOINT_QUEUE;
+        checkpointer->pending--;
+        checkpointer->dropped++;
+        retval = 1;
+    }
+    checkpointer->queue[(checkpointer->head + checkpointer->pending) %
+                        DEEPLEARN_CHECKPOINT_QUEUE] = *snapshot;
+    checkpointer->pending++;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+
+    /* freed outside of the lock */
+    checkpoint_snapshot_free(&replaced);
+    return retval;
+}
+
+/**
+ * @brief Queues a copy of a deep learner to be saved.
+ *        This only waits for the learner to be cloned, not for writing.
+ * @param checkpointer Checkpointer object
+ * @param learner Deep learner object
+ * @param filename Filename of the checkpoint
+ * @return zero if queued, 1 if a pending snapshot was replaced or a
+ *         negative value on error
+ */
+int deeplearn_checkpointer_post(deeplearn_checkpointer * checkpointer,
+                                deeplearn * learner, char * filename)
+{
+    deeplearn_checkpoint_snapshot snapshot;
+
+    if (checkpointer->worker == NULL) {
+        return -1;
+    }
+
+    memset((void*)&snapshot, '\0', sizeof(deeplearn_checkpoint_snapshot));
+    snapshot.type = DEEPLEARN_CHECKPOINT_LEARNER;
+    snprintf(snapshot.filename, sizeof(snapshot.filename), "%s", filename);
+
+    snapshot.learner = (deeplearn*)malloc(sizeof(deeplearn));
+    if (!snapshot.learner) {
+        return -2;
+    }
+    if (deeplearn_clone(snapshot.learner, learner) != 0) {
+        free(snapshot.learner);
+        return -3;
+    }
+    return checkpoint_queue(checkpointer, &snapshot);
+}
+
+/**
+ * @brief Queues a copy of a deep convnet to be saved.
+ *        Only the convolution layers and the deep learner are copied,
+ *        since those are what deepconvnet_save writes.
+ * @param checkpointer Checkpointer object
+ * @param convnet Deep convnet object
+ * @param filename Filename of the checkpoint
+ * @return zero if queued, 1 if a pending snapshot was replaced or a
+ *         negative value on error
+ */
+int deeplearn_checkpointer_post_convnet(deeplearn_checkpointer * checkpointer,
+                                        deepconvnet * convnet,
+                                        char * filename)
+{
+    deeplearn_checkpoint_snapshot snapshot;
+
+    if (checkpointer->worker == NULL) {
+        return -1;
+    }
+
+    memset((void*)&snapshot, '\0', sizeof(deeplearn_checkpoint_snapshot));
+    snapshot.type = DEEPLEARN_CHECKPOINT_CONVNET;
+    snprintf(snapshot.filename, sizeof(snapshot.filename), "%s", filename);
+
+    snapshot.convolution = (deeplearn_conv*)malloc(sizeof(deeplearn_conv));
+    if (!snapshot.convolution) {
+        return -2;
+    }
+    if (conv_clone(snapshot.convolution, convnet->convolution) != 0) {
+        free(snapshot.convolution);
+        return -3;
+    }
+
+    snapshot.learner = (deeplearn*)malloc(sizeof(deeplearn));
+    if (!snapshot.learner) {
+        checkpoint_snapshot_free(&snapshot);
+        return -4;
+    }
+    if (deeplearn_clone(snapshot.learner, convnet->learner) != 0) {
+        free(snapshot.learner);
+        snapshot.learner = NULL;
+        checkpoint_snapshot_free(&snapshot);
+        return -5;
+    }
+    return checkpoint_queue(checkpointer, &snapshot);
+}
+
+/**
+ * @brief Waits until all queued checkpoints have been written
+ * @param checkpointer Checkpointer object
+ */
+void deeplearn_checkpointer_flush(deeplearn_checkpointer * checkpointer)
+{
+    deeplearn_checkpoint_worker * worker =
+        (deeplearn_checkpoint_worker*)checkpointer->worker;
+
+    if (worker == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&worker->lock);
+    while ((checkpointer->pending > 0) || (worker->busy != 0)) {
+        pthread_cond_wait(&worker->idle, &worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+}
+
+/**
+ * @brief Writes any remaining checkpoints and stops the worker thread
+ * @param checkpointer Checkpointer object
+ */
+void deeplearn_checkpointer_free(deeplearn_checkpointer * checkpointer)
+{
+    deeplearn_checkpoint_worker * worker =
+        (deeplearn_checkpoint_worker*)checkpointer->worker;
+
+    if (worker == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&worker->lock);
+    worker->stop = 1;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->thread, NULL);
+
+    pthread_cond_destroy(&worker->wake);
+    pthread_cond_destroy(&worker->idle);
+    pthread_mutex_destroy(&worker->lock);
+    free(worker);
+    checkpointer->worker = NULL;
+}
+
+/**
+ * @brief Reads the saved bytes from a checkpoint file, decompressing
+ *        them if needed
+ * @param filename Filename of the checkpoint
+ * @param type The expected type of checkpoint
+ * @param data Returned saved bytes, which should be freed by the caller
+ * @param size Returned number of bytes
+ * @return zero on success
+ */
+static int checkpoint_read(char * filename, int type,
+                           unsigned char ** data, size_t * size)
+{
+    deeplearn_checkpoint_header header;
+    unsigned char * stored, * inflated = NULL;
+    size_t inflated_size = 0;
+    LodePNGDecompressSettings settings;
+    FILE * fp;
+
+    *data = NULL;
+    *size = 0;
+
+    fp = fopen(filename, "rb");
+    if (!fp) {
+        return -1;
+    }
+    if ((fread(&header, sizeof(deeplearn_checkpoint_header), 1, fp) != 1) ||
+        (memcmp(header.magic, DEEPLEARN_CHECKPOINT_MAGIC, 8) != 0) ||
+        (header.version != DEEPLEARN_CHECKPOINT_VERSION) ||
+        (header.type != (uint32_t)type) ||
+        (header.stored_size == 0)) {
+        fclose(fp);
+        return -2;
+    }
+
+    stored = (unsigned char*)malloc(header.stored_size);
+    if (!stored) {
+        fclose(fp);
+        return -3;
+    }
+    if (fread(stored, 1, header.stored_size, fp) != header.stored_size) {
+        free(stored);
+        fclose(fp);
+        return -4;
+    }
+    fclose(fp);
+
+    if (!(header.flags & DEEPLEARN_CHECKPOINT_COMPRESS)) {
+        *data = stored;
+        *size = header.stored_size;
+        return 0;
+    }
+
+    lodepng_decompress_settings_init(&settings);
+    if ((lodepng_zlib_decompress(&inflated, &inflated_size,
+                                 stored, header.stored_size,
+                                 &settings) != 0) ||
+        (inflated_size != header.raw_size)) {
+        free(inflated);
+        free(stored);
+        return -5;
+    }
+    free(stored);
+
+    *data = (unsigned char*)malloc(inflated_size);
+    if (!*data) {
+        free(inflated);
+        return -6;
+    }
+    checkpoint_unshuffle(inflated, *data, inflated_size);
+    free(inflated);
+    *size = inflated_size;
+    return 0;
+}
+
+/**
+ * @brief Loads a deep learner from a checkpoint, in the same way as
+ *        deeplearn_load
+ * @param filename Filename of the checkpoint
+ * @param learner Deep learner object
+ * @param random_seed Random number generator seed
+ * @return zero on success
+ */
+int deeplearn_checkpoint_load(char * filename, deeplearn * learner,
+                              unsigned int * random_seed)
+{
+    unsigned char * data;
+    size_t size;
+    int retval = 0;
+    FILE * fp;
+
+    if (checkpoint_read(filename, DEEPLEARN_CHECKPOINT_LEARNER,
+                        &data, &size) != 0) {
+        return -1;
+    }
+    fp = fmemopen(data, size, "rb");
+    if (!fp) {
+        free(data);
+        return -2;
+    }
+    if (deeplearn_load(fp, learner, random_seed) != 0) {
+        retval = -3;
+    }
+    fclose(fp);
+    free(data);
+    return retval;
+}
+
+/**
+ * @brief Loads a deep convnet from a checkpoint, in the same way as
+ *        deepconvnet_load
+ * @param filename Filename of the checkpoint
+ * @param convnet Deep convnet object
+ * @param random_seed Random number generator seed
+ * @return zero on success
+ */
+int deepconvnet_checkpoint_load(char * filename, deepconvnet * convnet,
+                                unsigned int * random_seed)
+{
+    unsigned char * data;
+    size_t size;
+    int retval = 0;
+    FILE * fp;
+
+    if (checkpoint_read(filename, DEEPLEARN_CHECKPOINT_CONVNET,
+                        &data, &size) != 0) {
+        return -1;
+    }
+    fp = fmemopen(data, size, "rb");
+    if (!fp) {
+        free(data);
+        return -2;
+    }
+    if (deepconvnet_load(fp, convnet, random_seed) != 0) {
+        retval = -3;
+    }
+    fclose(fp);
+    free(data);
+    return retval;
+}
@@ -0,0 +1,116 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_CHECKPOINT_H
+#define DEEPLEARN_CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "globals.h"
+#include "deeplearn.h"
+#include "deepconvnet.h"
+
+/* number of snapshots which can wait to be written */
+#define DEEPLEARN_CHECKPOINT_QUEUE 2
+
+/* file format of a checkpoint */
+#define DEEPLEARN_CHECKPOINT_MAGIC   "LIBDEEPK"
+#define DEEPLEARN_CHECKPOINT_VERSION 1
+
+/* the saved bytes are deflated after byte shuffling */
+#define DEEPLEARN_CHECKPOINT_COMPRESS 1
+
+/* types of object which may be checkpointed */
+#define DEEPLEARN_CHECKPOINT_LEARNER 0
+#define DEEPLEARN_CHECKPOINT_CONVNET 1
+
+/* Header at the start of a checkpoint file. The output of deeplearn_save
+   or deepconvnet_save follows, possibly compressed. */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t type;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t raw_size;
+    uint64_t stored_size;
+} deeplearn_checkpoint_header;
+
+/* A copy of a learner or convnet waiting to be written */
+typedef struct {
+    int type;
+    deeplearn * learner;
+    deeplearn_conv * convolution;
+    char filename[256];
+} deeplearn_checkpoint_snapshot;
+
+/* Writes checkpoints on a background worker thread. Posting a checkpoint
+   only clones the model, so training continues while it is serialised,
+   compressed and written. Each file is written under a temporary name
+   and then renamed, so that a checkpoint is either complete or absent.
+   If the queue fills up then the oldest pending snapshot is replaced. */
+typedef struct {
+    deeplearn_checkpoint_snapshot queue[DEEPLEARN_CHECKPOINT_QUEUE];
+    int head, pending;
+
+    /* DEEPLEARN_CHECKPOINT_COMPRESS or zero */
+    unsigned int flags;
+
+    /* snapshots replaced before they were written */
+    unsigned int dropped;
+
+    /* checkpoints which have been written, and those which failed */
+    unsigned int written;
+    unsigned int failed;
+
+    /* size of the most recent checkpoint before and after compression */
+    uint64_t raw_size;
+    uint64_t stored_size;
+
+    /* thread state, which is private to deeplearn_checkpoint.c */
+    void * worker;
+} deeplearn_checkpointer;
+
+int deeplearn_checkpointer_init(deeplearn_checkpointer * checkpointer,
+                                unsigned int flags);
+int deeplearn_checkpointer_post(deeplearn_checkpointer * checkpointer,
+                                deeplearn * learner, char * filename);
+int deeplearn_checkpointer_post_convnet(deeplearn_checkpointer * checkpointer,
+                                        deepconvnet * convnet,
+                                        char * filename);
+void deeplearn_checkpointer_flush(deeplearn_checkpointer * checkpointer);
+void deeplearn_checkpointer_free(deeplearn_checkpointer * checkpointer);
+int deeplearn_checkpoint_load(char * filename, deeplearn * learner,
+                              unsigned int * random_seed);
+int deepconvnet_checkpoint_load(char * filename, deepconvnet * convnet,
+                                unsigned int * random_seed);
+
+#endif
@@ -58,6 +58,9 @@ int conv_init(int no_of_layers,
 {
     int across = inputs_across;
     int down = inputs_down;
+    int max_convolution_units = 0, max_pooling_units = 0;
+    int pooling_units[PREPROCESS_MAX_LAYERS];
+    size_t arena_bytes = 0;
 
     if (no_of_layers >= PREPROCESS_MAX_LAYERS) {
         return -1;
@@ -74,6 +77,7 @@ int conv_init(int no_of_layers,
     conv->history_index = 0;
     conv->history_step = 1;
     conv->history_plot_interval = 1;
+    schedule_init(&conv->schedule);
     sprintf(conv->history_plot_filename,"%s","training_conv.png");
     sprintf(conv->history_plot_title,"%s",
             "Convolutional Training History");
@@ -85,12 +89,15 @@ int conv_init(int no_of_layers,
     memcpy((void*)conv->error_threshold,
            (void*)error_threshold, no_of_layers*sizeof(float));
     conv->enable_learning = 0;
+    conv->backend = CONV_BACKEND_PATCHES;
     conv->no_of_layers = no_of_layers;
     conv->inputs_across = inputs_across;
     conv->inputs_down = inputs_down;
     conv->inputs_depth = inputs_depth;
     conv->max_features = max_features;
 
+    /* work out the dimensions of each layer, and from them the size
+       of the arena holding the convolution and pooling arrays */
     for (int i = 0; i < no_of_layers; i++) {
         /* reduce the array dimensions */
         across /= reduction_factor;
@@ -101,8 +108,39 @@ int conv_init(int no_of_layers,
         conv->layer[i].units_across = across;
         conv->layer[i].units_down = down;
         conv->layer[i].pooling_factor = pooling_factor;
-        conv->layer[i].convolution =
-            (float*)malloc(sizeof(float)*across*down*conv_layer_features(conv, i));
+
+        /* reduce the dimensions by the pooling factor */
+        across /= pooling_factor;
+        down /= pooling_factor;
+        if (across < 4) across = 4;
+        if (down < 4) down = 4;
+        pooling_units[i] = across*down*conv_layer_features(conv, i);
+
+        arena_bytes +=
+            deeplearn_arena_bytes(sizeof(float)*
+                                  convolution_layer_units(i, conv)) +
+            deeplearn_arena_bytes(sizeof(ac)) +
+            deeplearn_arena_bytes(sizeof(float)*pooling_units[i]) +
+            deeplearn_arena_bytes(sizeof(int)*pooling_units[i]);
+
+        if (pooling_units[i] > max_pooling_units) {
+            max_pooling_units = pooling_units[i];
+        }
+        if (convolution_layer_units(i, conv) > max_convolution_units) {
+            max_convolution_units = convolution_layer_units(i, conv);
+        }
+    }
+    arena_bytes +=
+        deeplearn_arena_bytes(sizeof(float)*max_convolution_units) +
+        deeplearn_arena_bytes(sizeof(float)*max_pooling_units);
+    if (deeplearn_arena_init(&conv->arena, arena_bytes) != 0) {
+        return -2;
+    }
+
+    for (int i = 0; i < no_of_layers; i++) {
+        conv->layer[i].convolution = (float*)
+            deeplearn_arena_alloc(&conv->arena, sizeof(float)*
+                                  convolution_layer_units(i, conv));
         if (!conv->layer[i].convolution) return -2;
 
         /* ensure that the random seed is different for each
@@ -110,7 +148,9 @@ int conv_init(int no_of_layers,
         rand_num(random_seed);
 
         /* create an autocoder for feature learning on this layer */
-        conv->layer[i].autocoder = (ac*)malloc(sizeof(ac));
+        conv->layer[i].autocoder = (ac*)
+            deeplearn_arena_alloc(&conv->arena, sizeof(ac));
+        if (!conv->layer[i].autocoder) return -3;
 
         int depth = conv_layer_features(conv, i);
         if (i == 0) {
@@ -133,18 +173,29 @@ int conv_init(int no_of_layers,
             return -3;
         }
 
-        /* reduce the dimensions by the pooling factor */
-        across /= pooling_factor;
-        down /= pooling_factor;
-        if (across < 4) across = 4;
-        if (down < 4) down = 4;
-
         /* create a pooling array */
-        conv->layer[i].pooling =
-            (float*)malloc(sizeof(float)*across*down*
-                           conv_layer_features(conv, i));
+        conv->layer[i].pooling = (float*)
+            deeplearn_arena_alloc(&conv->arena,
+                                  sizeof(float)*pooling_units[i]);
         if (!conv->layer[i].pooling) return -4;
+
+        conv->layer[i].pooling_argmax = (int*)
+            deeplearn_arena_alloc(&conv->arena,
+                                  sizeof(int)*pooling_units[i]);
+        if (!conv->layer[i].pooling_argmax) return -5;
+        for (int j = 0; j < pooling_units[i]; j++) {
+            conv->layer[i].pooling_argmax[j] = -1;
+        }
     }
+
+    conv->deconv_convolution = (float*)
+        deeplearn_arena_alloc(&conv->arena,
+                              sizeof(float)*max_convolution_units);
+    if (!conv->deconv_convolution) return -6;
+    conv->deconv_pooling = (float*)
+        deeplearn_arena_alloc(&conv->arena,
+                              sizeof(float)*max_pooling_units);
+    if (!conv->deconv_pooling) return -7;
     return 0;
 }
 
@@ -155,11 +206,110 @@ int conv_init(int no_of_layers,
 void conv_free(deeplearn_conv * conv)
 {
     for (int i = 0; i < conv->no_of_layers; i++) {
-        free(conv->layer[i].convolution);
-        free(conv->layer[i].pooling);
         autocoder_free(conv->layer[i].autocoder);
-        free(conv->layer[i].autocoder);
     }
+    deeplearn_arena_free(&conv->arena);
+}
+
+/**
+ * @brief Returns the memory used by a preprocessing pipeline, broken
+ *        down into the weights and optimiser state of the autocoders,
+ *        the convolution and pooling arrays and the training history
+ * @param conv Preprocessing object
+ * @param usage Returned memory footprint
+ */
+void conv_memory_usage(deeplearn_conv * conv, deeplearn_footprint * usage)
+{
+    deeplearn_footprint part;
+    size_t arena = deeplearn_arena_allocated(&conv->arena);
+    size_t counted = 0, bytes;
+    int max_convolution_units = 0, max_pooling_units = 0;
+
+    deeplearn_footprint_clear(usage);
+    usage->history = sizeof(conv->history) +
+        sizeof(conv->history_plot_filename) +
+        sizeof(conv->history_plot_title);
+    usage->other = sizeof(deeplearn_conv) - usage->history;
+    if (arena == 0) return;
+
+    for (int i = 0; i < conv->no_of_layers; i++) {
+        int across = conv->layer[i].units_across /
+            conv->layer[i].pooling_factor;
+        int down = conv->layer[i].units_down /
+            conv->layer[i].pooling_factor;
+        int pooling_units;
+
+        if (across < 4) across = 4;
+        if (down < 4) down = 4;
+        pooling_units = across*down*conv_layer_features(conv, i);
+
+        bytes = sizeof(float)*convolution_layer_units(i, conv) +
+            (sizeof(float) + sizeof(int))*pooling_units;
+        usage->activations += bytes;
+        counted += bytes + sizeof(ac);
+
+        autocoder_memory_usage(conv->layer[i].autocoder, &part);
+        deeplearn_footprint_add(usage, &part);
+
+        if (convolution_layer_units(i, conv) > max_convolution_units) {
+            max_convolution_units = convolution_layer_units(i, conv);
+        }
+        if (pooling_units > max_pooling_units) {
+            max_pooling_units = pooling_units;
+        }
+    }
+
+    /* deconvolution arrays */
+    bytes = sizeof(float)*(max_convolution_units + max_pooling_units);
+    usage->activations += bytes;
+    counted += bytes;
+
+    if (arena > counted) {
+        usage->other += arena - counted;
+    }
+}
+
+/**
+ * @brief Makes an independent copy of a preprocessing pipeline by
+ *        copying the arena which holds its layers
+ * @param dest Preprocessing object to be created
+ * @param source Preprocessing object to be copied
+ * @returns zero on success
+ */
+int conv_clone(deeplearn_conv * dest, deeplearn_conv * source)
+{
+    deeplearn_arena * to = &dest->arena;
+    deeplearn_arena * from = &source->arena;
+
+    *dest = *source;
+    if (deeplearn_arena_clone(to, from) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < dest->no_of_layers; i++) {
+        deeplearn_conv_layer * layer = &dest->layer[i];
+
+        layer->convolution =
+            (float*)deeplearn_arena_relocate(to, from, layer->convolution);
+        layer->pooling =
+            (float*)deeplearn_arena_relocate(to, from, layer->pooling);
+        layer->pooling_argmax =
+            (int*)deeplearn_arena_relocate(to, from, layer->pooling_argmax);
+        layer->autocoder =
+            (ac*)deeplearn_arena_relocate(to, from, layer->autocoder);
+        if (autocoder_clone(layer->autocoder,
+                            source->layer[i].autocoder) != 0) {
+            for (int j = 0; j < i; j++) {
+                autocoder_free(dest->layer[j].autocoder);
+            }
+            deeplearn_arena_free(to);
+            return -2;
+        }
+    }
+    dest->deconv_convolution =
+        (float*)deeplearn_arena_relocate(to, from, source->deconv_convolution);
+    dest->deconv_pooling =
+        (float*)deeplearn_arena_relocate(to, from, source->deconv_pooling);
+    return 0;
 }
 
 /**
@@ -177,13 +327,14 @@ int conv_layer_features(deeplearn_conv * conv, int layer_index)
 /**
  * @brief Update the learning history
  * @param conv Preprocessing object
+ * @returns non-zero if an entry was added to the history
  */
-static void conv_update_history(deeplearn_conv * conv)
+static int conv_update_history(deeplearn_conv * conv)
 {
     int i;
     float error_value;
 
-    if (conv->history_step == 0) return;
+    if (conv->history_step == 0) return 0;
 
     conv->history_ctr++;
     if (conv->history_ctr >= conv->history_step) {
@@ -212,7 +363,9 @@ static void conv_update_history(deeplearn_conv * conv)
             conv->history_index /= 2;
             conv->history_step *= 2;
         }
+        return 1;
     }
+    return 0;
 }
 
 /**
@@ -337,15 +490,102 @@ int convolution_layer_units(int layer_index,
         conv_layer_features(conv, layer_index);
 }
 
+/**
+ * @brief Returns the number of units in the pooling array of a layer
+ * @param layer_index Index number of the convolution layer
+ * @param conv Preprocessing object
+ * @return Number of units after pooling
+ */
+int conv_pooling_units(int layer_index,
+                       deeplearn_conv * conv)
+{
+    return conv_layer_width(layer_index, conv, AFTER_POOLING)*
+        conv_layer_height(layer_index, conv, AFTER_POOLING)*
+        conv_layer_features(conv, layer_index);
+}
+
+/**
+ * @brief Convolves the inputs of a layer with its learned features.
+ *        Where no dropouts or noise are applied the backend of the
+ *        convolution object is used, otherwise patches are encoded
+ *        one at a time.
+ * @param conv Convolution object
+ * @param layer_index Index of the convolution layer
+ * @param img Input image, or NULL if the input is a float array
+ * @param inputs Input floats, or NULL if the input is an image
+ * @param width Width of the inputs
+ * @param height Height of the inputs
+ * @param depth Depth of the inputs
+ * @param convolution Returned feature responses
+ * @param use_dropouts Non-zero if dropouts are to be used
+ * @return zero on success
+ */
+static int conv_features(deeplearn_conv * conv, int layer_index,
+                         unsigned char img[], float inputs[],
+                         int width, int height, int depth,
+                         float convolution[], unsigned char use_dropouts)
+{
+    int samples_across = conv_layer_width(layer_index,conv,BEFORE_POOLING);
+    int samples_down = conv_layer_height(layer_index,conv,BEFORE_POOLING);
+    int patch_radius = conv_patch_radius(layer_index, conv);
+    int units = convolution_layer_units(layer_index, conv);
+    ac * autocoder = conv->layer[layer_index].autocoder;
+
+    if ((conv->backend != CONV_BACKEND_PATCHES) && (use_dropouts == 0) &&
+        (autocoder->noise <= 0)) {
+        if (img && (conv->backend == CONV_BACKEND_INT8)) {
+            return features_conv_img_to_flt_int8(samples_across, samples_down,
+                                                 patch_radius,
+                                                 width, height, depth, img,
+                                                 units, convolution,
+                                                 autocoder);
+        }
+        if (img) {
+            return features_conv_img_to_flt_gemm(samples_across, samples_down,
+                                                 patch_radius,
+                                                 width, height, depth, img,
+                                                 units, convolution,
+                                                 autocoder);
+        }
+        if (conv->backend == CONV_BACKEND_INT8) {
+            return features_conv_flt_to_flt_int8(samples_across, samples_down,
+                                                 patch_radius,
+                                                 width, height, depth, inputs,
+                                                 units, convolution,
+                                                 autocoder);
+        }
+        return features_conv_flt_to_flt_gemm(samples_across, samples_down,
+                                             patch_radius,
+                                             width, height, depth, inputs,
+                                             units, convolution,
+                                             autocoder);
+    }
+    if (img) {
+        return features_conv_img_to_flt(samples_across, samples_down,
+                                        patch_radius,
+                                        width, height, depth, img,
+                                        units, convolution,
+                                        autocoder, use_dropouts);
+    }
+    return features_conv_flt_to_flt(samples_across, samples_down,
+                                    patch_radius,
+                                    width, height, depth, inputs,
+                                    units, convolution,
+                                    autocoder, use_dropouts);
+}
+
 /**
  * @brief Convolution between the input image and the first layer
- * @param img Input image
+ * @param img Input image, or NULL if the input is a float plane
+ * @param img_flt Input image as normalised floats, or NULL if the
+ *        input is an image
  * @param conv Preprocessing object
  * @param BPerror Returned total backprop error from feature learning
  * @param use_dropouts Non-zero if dropouts are to be used
  * @return zero on success
  */
 static int conv_img_initial(unsigned char img[],
+                            float img_flt[],
                             deeplearn_conv * conv,
                             float * BPerror,
                             unsigned char use_dropouts)
@@ -356,16 +596,30 @@ static int conv_img_initial(unsigned char img[],
 
     if (conv->enable_learning != 0) {
         /* do feature learning */
-        retval =
-            features_learn_from_img(conv_layer_width(0,conv,BEFORE_POOLING),
-                                    conv_layer_height(0,conv,BEFORE_POOLING),
-                                    patch_radius,
-                                    conv->inputs_across,
-                                    conv->inputs_down,
-                                    conv->inputs_depth, img,
-                                    convolution_layer_units(0, conv),
-                                    conv->layer[0].autocoder,
-                                    &currBPerror);
+        if (img) {
+            retval =
+                features_learn_from_img(conv_layer_width(0,conv,BEFORE_POOLING),
+                                        conv_layer_height(0,conv,BEFORE_POOLING),
+                                        patch_radius,
+                                        conv->inputs_across,
+                                        conv->inputs_down,
+                                        conv->inputs_depth, img,
+                                        convolution_layer_units(0, conv),
+                                        conv->layer[0].autocoder,
+                                        &currBPerror);
+        }
+        else {
+            retval =
+                features_learn_from_flt(conv_layer_width(0,conv,BEFORE_POOLING),
+                                        conv_layer_height(0,conv,BEFORE_POOLING),
+                                        patch_radius,
+                                        conv->inputs_across,
+                                        conv->inputs_down,
+                                        conv->inputs_depth, img_flt,
+                                        convolution_layer_units(0, conv),
+                                        conv->layer[0].autocoder,
+                                        &currBPerror);
+        }
 
         if (retval != 0) {
             return -1;
@@ -374,18 +628,10 @@ static int conv_img_initial(unsigned char img[],
     }
 
     /* do the convolution for this layer */
-    retval =
-        features_conv_img_to_flt(conv_layer_width(0,conv,BEFORE_POOLING),
-                                 conv_layer_height(0,conv,BEFORE_POOLING),
-                                 patch_radius,
-                                 conv->inputs_across,
-                                 conv->inputs_down,
-                                 conv->inputs_depth, img,
-                                 convolution_layer_units(0,conv),
-                                 conv->layer[0].convolution,
-                                 conv->layer[0].autocoder,
-                                 use_dropouts);
-    if (retval != 0) {
+    if (conv_features(conv, 0, img, img_flt,
+                      conv->inputs_across, conv->inputs_down,
+                      conv->inputs_depth,
+                      conv->layer[0].convolution, use_dropouts) != 0) {
         return -2;
     }
     return 0;
@@ -432,19 +678,13 @@ static int conv_subsequent(deeplearn_conv * conv,
         use_dropouts = 1;
     }
     /* do the convolution for this layer */
-    retval =
-        features_conv_flt_to_flt(conv_layer_width(layer_index,conv,BEFORE_POOLING),
-                                 conv_layer_height(layer_index,conv,BEFORE_POOLING),
-                                 patch_radius,
-                                 conv_layer_width(layer_index-1,conv,AFTER_POOLING),
-                                 conv_layer_height(layer_index-1,conv,AFTER_POOLING),
-                                 conv_layer_features(conv, layer_index),
-                                 conv->layer[layer_index-1].pooling,
-                                 convolution_layer_units(layer_index,conv),
-                                 conv->layer[layer_index].convolution,
-                                 conv->layer[layer_index].autocoder,
-                                 use_dropouts);
-    if (retval != 0) {
+    if (conv_features(conv, layer_index, NULL,
+                      conv->layer[layer_index-1].pooling,
+                      conv_layer_width(layer_index-1,conv,AFTER_POOLING),
+                      conv_layer_height(layer_index-1,conv,AFTER_POOLING),
+                      conv_layer_features(conv, layer_index),
+                      conv->layer[layer_index].convolution,
+                      use_dropouts) != 0) {
         return -5;
     }
     return 0;
@@ -499,6 +739,8 @@ void conv_update_training_error(int layer_index,
                                 float BPerror,
                                 deeplearn_conv * conv)
 {
+    int plateau;
+
     if (conv->training_complete != 0) {
         return;
     }
@@ -518,20 +760,35 @@ void conv_update_training_error(int layer_index,
         (conv->BPerror*0.99f) + (BPerror*0.01f);
 
     /* record the history of error values */
-    conv_update_history(conv);
+    plateau = conv_update_history(conv) &&
+        (schedule_plateau(&conv->schedule, conv->BPerror) !=
+         SCHEDULE_RUNNING);
 
     /* increment the number of itterations */
     if (conv->itterations < UINT_MAX) {
         conv->itterations++;
     }
 
-    /* has the training for this layer been completed? */
-    if (conv->BPerror <
-        conv->error_threshold[layer_index]) {
+    /* stop once the maximum number of updates is reached */
+    if (schedule_next_step(&conv->schedule) != SCHEDULE_RUNNING) {
+        conv->training_complete = 1;
+        return;
+    }
+    if (conv->schedule.enabled != 0) {
+        conv_set_learning_rate(conv,
+                               schedule_learning_rate(&conv->schedule));
+    }
+
+    /* has the training for this layer been completed,
+       or has its error stopped improving? */
+    if ((conv->BPerror <
+         conv->error_threshold[layer_index]) || (plateau != 0)) {
 
         /* reset the error and move to the next layer */
         conv->BPerror = -1;
         conv->current_layer++;
+        conv->schedule.stopped = SCHEDULE_RUNNING;
+        schedule_reset_plateau(&conv->schedule);
 
         /* if this is the final layer */
         if (conv->current_layer >=
@@ -543,10 +800,13 @@ void conv_update_training_error(int layer_index,
 
 /**
  * @brief Performs deconvolution to an image as a series of
- *        deconvolutions and unpoolings
+ *        unpoolings and deconvolutions, beginning from the pooled
+ *        outputs of the given layer as left by the last convolution.
+ *        The activations of the layers are not changed, so this may be
+ *        repeated from different layers after a single convolution.
  * @param start_layer the convolution layer to beging from
  * @param conv Convolution object
- * @param img Input image which is the output 
+ * @param img Input image which is the output
  * @returns zero on success
  */
 int deconv_img(int start_layer,
@@ -554,63 +814,101 @@ int deconv_img(int start_layer,
                unsigned char img[])
 {
     int max_layer = get_max_layer(conv);
-    int img_width = conv->inputs_across;
-    int img_height = conv->inputs_down;
-    int img_depth = conv->inputs_depth;
+    float * pooled;
+    int retval;
 
     if (start_layer > max_layer-1) start_layer = max_layer-1;
-    
-    for (int layer_index = start_layer; layer_index > 0; layer_index--) {
-        /* unpool the current layer */
-        unpooling_from_flt_to_flt(conv_layer_features(conv, layer_index),
-                                  conv_layer_width(layer_index,
-                                                   conv, AFTER_POOLING),
-                                  conv_layer_height(layer_index,
-                                                    conv, AFTER_POOLING),
-                                  conv->layer[layer_index].pooling,
-                                  conv_layer_width(layer_index,
-                                                   conv, BEFORE_POOLING),
-                                  conv_layer_height(layer_index,
-                                                    conv, BEFORE_POOLING),
-                                  conv->layer[layer_index].convolution);
+    if (start_layer < 0) return -1;
+
+    pooled = conv->layer[start_layer].pooling;
+    for (int layer_index = start_layer; layer_index >= 0; layer_index--) {
+        int features = conv_layer_features(conv, layer_index);
+
+        /* unpool the current layer, routing values back to the maxima
+           of the last convolution if there has been one */
+        if (conv->layer[layer_index].pooling_argmax[0] >= 0) {
+            retval =
+                unpooling_argmax_from_flt_to_flt(features,
+                                                 conv_layer_width(layer_index,
+                                                                  conv, AFTER_POOLING),
+                                                 conv_layer_height(layer_index,
+                                                                   conv, AFTER_POOLING),
+                                                 pooled,
+                                                 conv->layer[layer_index].pooling_argmax,
+                                                 conv_layer_width(layer_index,
+                                                                  conv, BEFORE_POOLING),
+                                                 conv_layer_height(layer_index,
+                                                                   conv, BEFORE_POOLING),
+                                                 conv->deconv_convolution);
+        }
+        else {
+            retval =
+                unpooling_from_flt_to_flt(features,
+                                          conv_layer_width(layer_index,
+                                                           conv, AFTER_POOLING),
+                                          conv_layer_height(layer_index,
+                                                            conv, AFTER_POOLING),
+                                          pooled,
+                                          conv_layer_width(layer_index,
+                                                           conv, BEFORE_POOLING),
+                                          conv_layer_height(layer_index,
+                                                            conv, BEFORE_POOLING),
+                                          conv->deconv_convolution);
+        }
+        if (retval != 0) return -2;
+
+        if (layer_index == 0) break;
 
         /* deconvolve from the current layer to the pooling of the
-           previous layer */
-        features_deconv_flt_to_flt(
-            conv_layer_width(layer_index, conv, BEFORE_POOLING),
-            conv_layer_height(layer_index, conv, BEFORE_POOLING),
-            conv_patch_radius(layer_index, conv),
-            conv_layer_width(layer_index-1, conv, AFTER_POOLING),
-            conv_layer_height(layer_index-1, conv, AFTER_POOLING),
-            conv_layer_features(conv, layer_index),
-            conv->layer[layer_index-1].pooling,
-            convolution_layer_units(layer_index-1, conv),
-            conv->layer[layer_index].convolution,
-            conv->layer[layer_index-1].autocoder);
+           previous layer.  As within conv_subsequent the pooling of the
+           previous layer is read with the depth of the current layer,
+           so any remaining values are zero */
+        memset((void*)conv->deconv_pooling, '\0',
+               conv_layer_width(layer_index-1, conv, AFTER_POOLING)*
+               conv_layer_height(layer_index-1, conv, AFTER_POOLING)*
+               conv_layer_features(conv, layer_index-1)*sizeof(float));
+        retval =
+            features_deconv_flt_to_flt(conv_layer_width(layer_index, conv, BEFORE_POOLING),
+                                       conv_layer_height(layer_index, conv, BEFORE_POOLING),
+                                       conv_patch_radius(layer_index, conv),
+                                       conv_layer_width(layer_index-1, conv, AFTER_POOLING),
+                                       conv_layer_height(layer_index-1, conv, AFTER_POOLING),
+                                       features,
+                                       conv->deconv_pooling,
+                                       convolution_layer_units(layer_index, conv),
+                                       conv->deconv_convolution,
+                                       conv->layer[layer_index].autocoder);
+        if (retval != 0) return -3;
+        pooled = conv->deconv_pooling;
     }
 
     /* convert from the first layer back to the starting image */
-    features_deconv_img_to_flt(conv_layer_width(0, conv, BEFORE_POOLING),
-                               conv_layer_height(0, conv, BEFORE_POOLING),
-                               conv_patch_radius(0, conv),
-                               img_width, img_height, img_depth, img,
-                               convolution_layer_units(0, conv),
-                               conv->layer[0].convolution,
-                               conv->layer[0].autocoder);
+    retval =
+        features_deconv_img_to_flt(conv_layer_width(0, conv, BEFORE_POOLING),
+                                   conv_layer_height(0, conv, BEFORE_POOLING),
+                                   conv_patch_radius(0, conv),
+                                   conv->inputs_across, conv->inputs_down,
+                                   conv->inputs_depth, img,
+                                   convolution_layer_units(0, conv),
+                                   conv->deconv_convolution,
+                                   conv->layer[0].autocoder);
+    if (retval != 0) return -4;
     return 0;
 }
 
 /**
- * @brief Performs convolution on an image as a series of
- *        convolutions and poolings
- * @param img Input image
+ * @brief Performs convolution on either an image or a float plane as a
+ *        series of convolutions and poolings
+ * @param img Input image, or NULL
+ * @param img_flt Input as normalised floats, or NULL
  * @param conv Convolution object
  * @param use_dropouts Non-zero if dropouts are to be used
  * @returns zero on success
  */
-int conv_img(unsigned char img[],
-             deeplearn_conv * conv,
-             unsigned char use_dropouts)
+static int conv_input(unsigned char img[],
+                      float img_flt[],
+                      deeplearn_conv * conv,
+                      unsigned char use_dropouts)
 {
     int retval = -1;
     int max_layer = get_max_layer(conv);
@@ -619,9 +917,11 @@ int conv_img(unsigned char img[],
     for (int i = 0; i < max_layer; i++) {
         conv_enable_learning(i, conv);
 
+        DEEPLEARN_STATS_START(conv_time);
         BPerror = 0;
         if (i == 0) {
-            retval = conv_img_initial(img, conv, &BPerror, use_dropouts);
+            retval = conv_img_initial(img, img_flt, conv, &BPerror,
+                                      use_dropouts);
         }
         else {
             retval = conv_subsequent(conv, i, &BPerror);
@@ -629,21 +929,109 @@ int conv_img(unsigned char img[],
         if (retval != 0) {
             return retval;
         }
+        DEEPLEARN_STATS_STOP(conv_time, DEEPLEARN_STATS_CONVOLUTION, i);
 
         conv_update_training_error(i, BPerror, conv);
 
         /* pooling */
+        DEEPLEARN_STATS_START(pool_time);
         retval =
-            pooling_from_flt_to_flt(conv_layer_features(conv, i),
-                                    conv_layer_width(i,conv,BEFORE_POOLING),
-                                    conv_layer_height(i,conv,BEFORE_POOLING),
-                                    conv->layer[i].convolution,
-                                    conv_layer_width(i,conv,AFTER_POOLING),
-                                    conv_layer_height(i,conv,AFTER_POOLING),
-                                    conv->layer[i].pooling);
+            pooling_from_flt_to_flt_argmax(conv_layer_features(conv, i),
+                                           conv_layer_width(i,conv,BEFORE_POOLING),
+                                           conv_layer_height(i,conv,BEFORE_POOLING),
+                                           conv->layer[i].convolution,
+                                           conv_layer_width(i,conv,AFTER_POOLING),
+                                           conv_layer_height(i,conv,AFTER_POOLING),
+                                           conv->layer[i].pooling,
+                                           conv->layer[i].pooling_argmax);
         if (retval != 0) {
             return -6;
         }
+        DEEPLEARN_STATS_STOP(pool_time, DEEPLEARN_STATS_POOLING, i);
+    }
+    return 0;
+}
+
+/**
+ * @brief Performs convolution on an image as a series of
+ *        convolutions and poolings
+ * @param img Input image
+ * @param conv Convolution object
+ * @param use_dropouts Non-zero if dropouts are to be used
+ * @returns zero on success
+ */
+int conv_img(unsigned char img[],
+             deeplearn_conv * conv,
+             unsigned char use_dropouts)
+{
+    return conv_input(img, NULL, conv, use_dropouts);
+}
+
+/**
+ * @brief Performs convolution on an image which has already been
+ *        converted to normalised floats, for example by
+ *        deeplearn_resample_to_flt, as a series of convolutions and poolings
+ * @param img_flt Input image with values as given by PIXEL_TO_FLOAT
+ * @param conv Convolution object
+ * @param use_dropouts Non-zero if dropouts are to be used
+ * @returns zero on success
+ */
+int conv_img_flt(float img_flt[],
+                 deeplearn_conv * conv,
+                 unsigned char use_dropouts)
+{
+    return conv_input(NULL, img_flt, conv, use_dropouts);
+}
+
+/**
+ * @brief Computes the convolution and pooling of a single trained layer
+ *        into the given arrays rather than those of the layer, without
+ *        learning, dropouts or recording the pooling positions.  The
+ *        arrays of the convolution object are not changed, so different
+ *        layers may be computed concurrently for different images.
+ * @param conv Convolution object
+ * @param layer_index Index of the convolution layer
+ * @param img Input image for the first layer, or NULL
+ * @param inputs Input floats for the first layer if no image is given,
+ *        or the pooling output of the previous layer
+ * @param convolution Array of convolution_layer_units values
+ * @param pooling Returned pooling output of the layer
+ * @returns zero on success
+ */
+int conv_layer_infer(deeplearn_conv * conv, int layer_index,
+                     unsigned char img[], float inputs[],
+                     float convolution[], float pooling[])
+{
+    int retval;
+
+    if ((layer_index < 0) || (layer_index >= conv->no_of_layers)) {
+        return -1;
+    }
+
+    if (layer_index == 0) {
+        retval = conv_features(conv, 0, img, inputs,
+                               conv->inputs_across, conv->inputs_down,
+                               conv->inputs_depth, convolution, 0);
+    }
+    else {
+        retval = conv_features(conv, layer_index, NULL, inputs,
+                               conv_layer_width(layer_index-1,conv,AFTER_POOLING),
+                               conv_layer_height(layer_index-1,conv,AFTER_POOLING),
+                               conv_layer_features(conv, layer_index),
+                               convolution, 0);
+    }
+    if (retval != 0) {
+        return -2;
+    }
+
+    if (pooling_from_flt_to_flt(conv_layer_features(conv, layer_index),
+                                conv_layer_width(layer_index,conv,BEFORE_POOLING),
+                                conv_layer_height(layer_index,conv,BEFORE_POOLING),
+                                convolution,
+                                conv_layer_width(layer_index,conv,AFTER_POOLING),
+                                conv_layer_height(layer_index,conv,AFTER_POOLING),
+                                pooling) != 0) {
+        return -3;
     }
     return 0;
 }
@@ -918,6 +1306,110 @@ void conv_set_dropouts(deeplearn_conv * conv, float dropout_percent)
     }
 }
 
+/**
+ * @brief Sets the rule used to update the weights during feature learning
+ * @param conv Convolution object
+ * @param type One of the OPTIMISER_* update rules
+ * @returns zero on success
+ */
+int conv_set_optimiser(deeplearn_conv * conv, int type)
+{
+    for (int i = 0; i < conv->no_of_layers; i++) {
+        if (autocoder_set_optimiser(conv->layer[i].autocoder, type) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets a schedule for the learning rate of feature learning
+ * @param conv Convolution object
+ * @param type Schedule type, such as SCHEDULE_COSINE
+ * @param base_rate Learning rate at the start of the schedule
+ * @param min_rate The lowest learning rate allowed
+ * @param period Updates between steps of SCHEDULE_STEP, or the length
+ *        of each cycle of SCHEDULE_COSINE
+ * @param gamma Multiplier applied at each step of SCHEDULE_STEP
+ * @returns zero on success
+ */
+int conv_set_schedule(deeplearn_conv * conv, int type,
+                      float base_rate, float min_rate,
+                      unsigned int period, float gamma)
+{
+    if (schedule_set(&conv->schedule, type, base_rate, min_rate,
+                     period, gamma) != 0) {
+        return -1;
+    }
+    conv_set_learning_rate(conv, schedule_learning_rate(&conv->schedule));
+    return 0;
+}
+
+/**
+ * @brief Enables detection of a plateau in the training error of the
+ *        current layer.  Once max_reductions plateaus have occurred the
+ *        layer is considered to have been trained, as if its error
+ *        threshold had been reached.
+ * @param conv Convolution object
+ * @param patience Number of history entries without improvement which
+ *        count as a plateau, or zero to disable
+ * @param min_delta The smallest decrease in error which counts as an
+ *        improvement
+ * @param factor Multiplier in the range 0 to 1 applied to the learning
+ *        rate on each plateau
+ * @param max_reductions Number of plateaus after which a layer is
+ *        considered to have been trained
+ * @returns zero on success
+ */
+int conv_set_plateau(deeplearn_conv * conv,
+                     unsigned int patience, float min_delta,
+                     float factor, unsigned int max_reductions)
+{
+    if (schedule_set_plateau(&conv->schedule, patience, min_delta,
+                             factor, max_reductions) != 0) {
+        return -1;
+    }
+    if ((conv->schedule.enabled == 0) && (factor < 1)) {
+        schedule_set(&conv->schedule, SCHEDULE_CONSTANT,
+                     conv->layer[0].autocoder->learningRate, 0, 0, 1);
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets the maximum number of updates, after which feature
+ *        learning is considered to be complete
+ * @param conv Convolution object
+ * @param updates Maximum number of updates, or zero for no limit
+ */
+void conv_set_max_updates(deeplearn_conv * conv, unsigned int updates)
+{
+    conv->schedule.max_updates = updates;
+}
+
+/**
+ * @brief Sets the backend used to compute feature responses.
+ *        CONV_BACKEND_GEMM lays out all patches of a layer as one matrix
+ *        and uses a single matrix multiply.  CONV_BACKEND_INT8 does the
+ *        same using eight bit integer dot products, with weights and
+ *        patches quantised as they are used.  These are only used when
+ *        no dropouts or noise are applied, otherwise patches are
+ *        evaluated one at a time at full precision.
+ * @param conv Convolution object
+ * @param backend CONV_BACKEND_PATCHES, CONV_BACKEND_GEMM or CONV_BACKEND_INT8
+ * @returns zero on success
+ */
+int conv_set_backend(deeplearn_conv * conv, int backend)
+{
+    if ((backend != CONV_BACKEND_PATCHES) &&
+        (backend != CONV_BACKEND_GEMM) &&
+        (backend != CONV_BACKEND_INT8)) {
+        return -1;
+    }
+    conv->backend = (unsigned char)backend;
+    return 0;
+}
+
 /**
  * @brief Plots the features learned by an autocoder at the given layer
  * @param conv Convolution object
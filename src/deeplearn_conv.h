@@ -43,18 +43,27 @@
 #include "deeplearn.h"
 #include "deeplearn_features.h"
 #include "deeplearn_pooling.h"
+#include "deeplearn_schedule.h"
 
 #define PREPROCESS_MAX_LAYERS 100
 
+/* ways of computing feature responses when no learning takes place */
+#define CONV_BACKEND_PATCHES 0
+#define CONV_BACKEND_GEMM    1
+#define CONV_BACKEND_INT8    2
+
 /* Each convolution layer has an autocoder to learn features
    from the previous layer and a pooling array to max pool the results.
-   Units accress and down give the receptive field dimensions. */
+   Units accress and down give the receptive field dimensions.
+   pooling_argmax records which convolution value was the maximum for
+   each pooling value, or -1 before anything has been pooled. */
 typedef struct {
 	ac * autocoder;
 	int units_across, units_down;
 	float * convolution;
 	int pooling_factor;
 	float * pooling;
+	int * pooling_argmax;
 } deeplearn_conv_layer;
 
 typedef struct {
@@ -78,9 +87,21 @@ typedef struct {
 	int no_of_layers;
 	unsigned char enable_learning;
 
+	/* backend used to compute feature responses */
+	unsigned char backend;
+
 	/* array storing layers */
 	deeplearn_conv_layer layer[PREPROCESS_MAX_LAYERS];
 
+	/* working arrays for deconvolution, large enough for the
+	   convolution and pooling arrays of any layer, so that the
+	   activations of the layers are not overwritten */
+	float * deconv_convolution;
+	float * deconv_pooling;
+
+	/* memory holding the arrays of every layer */
+	deeplearn_arena arena;
+
 	/* keep track of training progress */
 	int current_layer;
 
@@ -103,6 +124,9 @@ typedef struct {
 
 	float history[DEEPLEARN_HISTORY_SIZE];
 	int history_index, history_ctr, history_step;
+
+	/* learning rate schedule, plateau detection and update limit */
+	deeplearn_schedule schedule;
 } deeplearn_conv;
 
 int conv_patch_radius(int layer_index,
@@ -115,6 +139,8 @@ int conv_layer_height(int layer_index,
 					  int after_pooling);
 int convolution_layer_units(int layer_index,
 							deeplearn_conv * conv);
+int conv_pooling_units(int layer_index,
+					   deeplearn_conv * conv);
 int conv_init(int no_of_layers,
 			  int inputs_across,
 			  int inputs_down,
@@ -127,9 +153,17 @@ int conv_init(int no_of_layers,
 			  unsigned int * random_seed);
 
 void conv_free(deeplearn_conv * conv);
+void conv_memory_usage(deeplearn_conv * conv, deeplearn_footprint * usage);
+int conv_clone(deeplearn_conv * dest, deeplearn_conv * source);
 int conv_img(unsigned char img[],
 			 deeplearn_conv * conv,
 			 unsigned char use_dropouts);
+int conv_img_flt(float img_flt[],
+				 deeplearn_conv * conv,
+				 unsigned char use_dropouts);
+int conv_layer_infer(deeplearn_conv * conv, int layer_index,
+					 unsigned char img[], float inputs[],
+					 float convolution[], float pooling[]);
 int deconv_img(int start_layer,
 			   deeplearn_conv * conv,
 			   unsigned char img[]);
@@ -144,6 +178,15 @@ float get_conv_output(deeplearn_conv * conv, int index);
 int conv_outputs(deeplearn_conv * conv);
 void conv_set_learning_rate(deeplearn_conv * conv, float rate);
 void conv_set_dropouts(deeplearn_conv * conv, float dropout_percent);
+int conv_set_optimiser(deeplearn_conv * conv, int type);
+int conv_set_schedule(deeplearn_conv * conv, int type,
+					  float base_rate, float min_rate,
+					  unsigned int period, float gamma);
+int conv_set_plateau(deeplearn_conv * conv,
+					 unsigned int patience, float min_delta,
+					 float factor, unsigned int max_reductions);
+void conv_set_max_updates(deeplearn_conv * conv, unsigned int updates);
+int conv_set_backend(deeplearn_conv * conv, int backend);
 int conv_plot_features(deeplearn_conv * conv, int layer_index,
 					   unsigned char img[],
 					   int img_width, int img_height);
@@ -0,0 +1,655 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_device.h"
+
+#ifdef DEEPLEARN_OPENCL
+#define CL_TARGET_OPENCL_VERSION 120
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+#endif
+
+/* A weight matrix copied to the device.  The copy stays valid while
+   the generation given by the owner of the weights stays the same, so
+   that weights which are only being used for inference are transferred
+   once rather than for every matrix multiply */
+struct device_resident {
+    const float * host;
+    size_t size;
+    unsigned int generation;
+    unsigned int last_used;
+
+    /* a copy of the weights in memory for DEVICE_HOST,
+       or a cl_mem object for DEVICE_OPENCL */
+    void * buffer;
+};
+typedef struct device_resident device_resident;
+
+/* the currently selected device */
+static int device_type = DEVICE_NONE;
+static double device_gemm_min = DEVICE_GEMM_MIN;
+
+/* the most recent generation given to weights which have changed */
+static unsigned int device_generation = 0;
+
+static unsigned int device_clock = 0;
+static unsigned int device_uploads = 0;
+static device_resident device_weights[DEVICE_MAX_RESIDENT];
+
+#ifdef DEEPLEARN_OPENCL
+static cl_context device_context = 0;
+static cl_command_queue device_queue = 0;
+static cl_program device_program = 0;
+static cl_kernel device_kernel = 0;
+
+/* inputs and outputs of the matrix multiply, which grow as needed */
+static cl_mem device_a = 0, device_c = 0;
+static size_t device_a_size = 0, device_c_size = 0;
+
+#define DEVICE_STRING(x) #x
+#define DEVICE_VALUE(x) DEVICE_STRING(x)
+
+/* C = A.B^T, with square tiles of A and B held in local memory */
+static const char * device_source =
+    "#define TILE " DEVICE_VALUE(DEVICE_OPENCL_TILE) "\n"
+    "__kernel void gemm_nt(const int m, const int n, const int k,\n"
+    "                      __global const float * a,\n"
+    "                      __global const float * b,\n"
+    "                      __global float * c)\n"
+    "{\n"
+    "    __local float ta[TILE][TILE];\n"
+    "    __local float tb[TILE][TILE];\n"
+    "    const int lj = get_local_id(0), li = get_local_id(1);\n"
+    "    const int j = get_group_id(0)*TILE + lj;\n"
+    "    const int i = get_group_id(1)*TILE + li;\n"
+    "    const int jb = get_group_id(0)*TILE + li;\n"
+    "    float sum = 0;\n"
+    "    for (int p0 = 0; p0 < k; p0 += TILE) {\n"
+    "        ta[li][lj] = ((i < m) && (p0+lj < k)) ? a[i*k + p0+lj] : 0;\n"
+    "        tb[li][lj] = ((jb < n) && (p0+lj < k)) ? b[jb*k + p0+lj] : 0;\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "        for (int p = 0; p < TILE; p++) {\n"
+    "            sum += ta[li][p]*tb[lj][p];\n"
+    "        }\n"
+    "        barrier(CLK_LOCAL_MEM_FENCE);\n"
+    "    }\n"
+    "    if ((i < m) && (j < n)) c[i*n + j] = sum;\n"
+    "}\n";
+
+/**
+ * @brief Releases the OpenCL context and everything created within it
+ */
+static void device_opencl_free(void)
+{
+    if (device_a) clReleaseMemObject(device_a);
+    if (device_c) clReleaseMemObject(device_c);
+    if (device_kernel) clReleaseKernel(device_kernel);
+    if (device_program) clReleaseProgram(device_program);
+    if (device_queue) clReleaseCommandQueue(device_queue);
+    if (device_context) clReleaseContext(device_context);
+    device_a = 0;
+    device_c = 0;
+    device_a_size = 0;
+    device_c_size = 0;
+    device_kernel = 0;
+    device_program = 0;
+    device_queue = 0;
+    device_context = 0;
+}
+
+/**
+ * @brief Returns the first OpenCL device, preferring GPUs
+ * @param id Returned device
+ * @returns zero on success
+ */
+static int device_opencl_find(cl_device_id * id)
+{
+    cl_platform_id platform[8];
+    cl_uint platforms = 0, devices = 0;
+
+    if ((clGetPlatformIDs(8, platform, &platforms) != CL_SUCCESS) ||
+        (platforms == 0)) {
+        return -1;
+    }
+    if (platforms > 8) platforms = 8;
+
+    for (cl_uint p = 0; p < platforms; p++) {
+        if ((clGetDeviceIDs(platform[p], CL_DEVICE_TYPE_GPU, 1, id,
+                            &devices) == CL_SUCCESS) && (devices > 0)) {
+            return 0;
+        }
+    }
+    for (cl_uint p = 0; p < platforms; p++) {
+        if ((clGetDeviceIDs(platform[p], CL_DEVICE_TYPE_ALL, 1, id,
+                            &devices) == CL_SUCCESS) && (devices > 0)) {
+            return 0;
+        }
+    }
+    return -2;
+}
+
+/**
+ * @brief Creates an OpenCL context and builds the matrix multiply
+ * @returns zero on success
+ */
+static int device_opencl_init(void)
+{
+    cl_device_id id;
+    cl_int err;
+
+    if (device_context) return 0;
+    if (device_opencl_find(&id) != 0) return -1;
+
+    device_context = clCreateContext(NULL, 1, &id, NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+        device_context = 0;
+        return -2;
+    }
+    device_queue = clCreateCommandQueue(device_context, id, 0, &err);
+    if (err != CL_SUCCESS) {
+        device_queue = 0;
+        device_opencl_free();
+        return -3;
+    }
+    device_program =
+        clCreateProgramWithSource(device_context, 1, &device_source,
+                                  NULL, &err);
+    if (err != CL_SUCCESS) {
+        device_program = 0;
+        device_opencl_free();
+        return -4;
+    }
+    if (clBuildProgram(device_program, 1, &id, NULL, NULL, NULL) !=
+        CL_SUCCESS) {
+        device_opencl_free();
+        return -5;
+    }
+    device_kernel = clCreateKernel(device_program, "gemm_nt", &err);
+    if (err != CL_SUCCESS) {
+        device_kernel = 0;
+        device_opencl_free();
+        return -6;
+    }
+    return 0;
+}
+
+/**
+ * @brief Ensures that a buffer on the device is at least the given size
+ * @param buffer The buffer
+ * @param capacity Current size of the buffer in bytes
+ * @param size Required size in bytes
+ * @param flags Access flags for the buffer
+ * @returns zero on success
+ */
+static int device_opencl_reserve(cl_mem * buffer, size_t * capacity,
+                                 size_t size, cl_mem_flags flags)
+{
+    cl_int err;
+
+    if (size <= *capacity) return 0;
+    if (*buffer) clReleaseMemObject(*buffer);
+    *capacity = 0;
+    *buffer = clCreateBuffer(device_context, flags, size, NULL, &err);
+    if (err != CL_SUCCESS) {
+        *buffer = 0;
+        return -1;
+    }
+    *capacity = size;
+    return 0;
+}
+
+/**
+ * @brief Matrix multiply on an OpenCL device, C = A.B^T
+ * @param m Number of rows of A and C
+ * @param n Number of rows of B and columns of C
+ * @param k Number of columns of A and B
+ * @param a First matrix of m x k values
+ * @param b Second matrix of n x k values already on the device
+ * @param c Returned matrix of m x n values
+ * @returns zero on success
+ */
+static int device_opencl_gemm_nt(int m, int n, int k,
+                                 const float * a, cl_mem b, float * c)
+{
+    size_t local[2] = { DEVICE_OPENCL_TILE, DEVICE_OPENCL_TILE };
+    size_t global[2];
+
+    if (device_opencl_reserve(&device_a, &device_a_size,
+                              (size_t)m*k*sizeof(float),
+                              CL_MEM_READ_ONLY) != 0) {
+        return -1;
+    }
+    if (device_opencl_reserve(&device_c, &device_c_size,
+                              (size_t)m*n*sizeof(float),
+                              CL_MEM_WRITE_ONLY) != 0) {
+        return -2;
+    }
+    if (clEnqueueWriteBuffer(device_queue, device_a, CL_FALSE, 0,
+                             (size_t)m*k*sizeof(float), a,
+                             0, NULL, NULL) != CL_SUCCESS) {
+        return -3;
+    }
+
+    clSetKernelArg(device_kernel, 0, sizeof(int), &m);
+    clSetKernelArg(device_kernel, 1, sizeof(int), &n);
+    clSetKernelArg(device_kernel, 2, sizeof(int), &k);
+    clSetKernelArg(device_kernel, 3, sizeof(cl_mem), &device_a);
+    clSetKernelArg(device_kernel, 4, sizeof(cl_mem), &b);
+    clSetKernelArg(device_kernel, 5, sizeof(cl_mem), &device_c);
+
+    global[0] = ((n + DEVICE_OPENCL_TILE - 1) / DEVICE_OPENCL_TILE) *
+        DEVICE_OPENCL_TILE;
+    global[1] = ((m + DEVICE_OPENCL_TILE - 1) / DEVICE_OPENCL_TILE) *
+        DEVICE_OPENCL_TILE;
+    if (clEnqueueNDRangeKernel(device_queue, device_kernel, 2, NULL,
+                               global, local, 0, NULL, NULL) != CL_SUCCESS) {
+        return -4;
+    }
+    if (clEnqueueReadBuffer(device_queue, device_c, CL_TRUE, 0,
+                            (size_t)m*n*sizeof(float), c,
+                            0, NULL, NULL) != CL_SUCCESS) {
+        return -5;
+    }
+    return 0;
+}
+#endif
+
+/**
+ * @brief Matrix multiply using the host copy of the weights, C = A.B^T.
+ *        This behaves as a device would, so that the handling of
+ *        resident weights can be checked without one.
+ * @param m Number of rows of A and C
+ * @param n Number of rows of B and columns of C
+ * @param k Number of columns of A and B
+ * @param a First matrix of m x k values
+ * @param b Second matrix of n x k values
+ * @param c Returned matrix of m x n values
+ */
+static void device_host_gemm_nt(int m, int n, int k,
+                                const float * a, const float * b, float * c)
+{
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            float sum = 0;
+            for (int p = 0; p < k; p++) {
+                sum += a[i*k + p] * b[j*k + p];
+            }
+            c[i*n + j] = sum;
+        }
+    }
+}
+
+/**
+ * @brief Frees the device copy of a weight matrix
+ * @param resident The resident weights
+ */
+static void device_resident_free(device_resident * resident)
+{
+    if (resident->buffer) {
+#ifdef DEEPLEARN_OPENCL
+        if (device_type == DEVICE_OPENCL) {
+            clReleaseMemObject((cl_mem)resident->buffer);
+        }
+        else {
+            free(resident->buffer);
+        }
+#else
+        free(resident->buffer);
+#endif
+    }
+    memset((void*)resident, '\0', sizeof(device_resident));
+}
+
+/**
+ * @brief Copies a weight matrix to the device
+ * @param host The weights
+ * @param size Size of the weights in bytes
+ * @returns The device buffer, or NULL on failure
+ */
+static void * device_upload(const float * host, size_t size)
+{
+    void * buffer = NULL;
+
+#ifdef DEEPLEARN_OPENCL
+    if (device_type == DEVICE_OPENCL) {
+        cl_int err;
+        cl_mem mem = clCreateBuffer(device_context,
+                                    CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    size, (void*)host, &err);
+        return (err == CL_SUCCESS) ? (void*)mem : NULL;
+    }
+#endif
+    buffer = malloc(size);
+    if (buffer) {
+        memcpy(buffer, (const void*)host, size);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Returns the device copy of a weight matrix, copying the weights
+ *        only if they are not already on the device or have changed.
+ *        The least recently used matrix is replaced when there is no
+ *        room for another.
+ * @param host The weights
+ * @param size Size of the weights in bytes
+ * @param generation Generation of the weights from device_weights_changed
+ * @returns The resident weights, or NULL on failure
+ */
+static device_resident * device_resident_get(const float * host, size_t size,
+                                             unsigned int generation)
+{
+    device_resident * resident = NULL;
+    int i;
+
+    device_clock++;
+    for (i = 0; i < DEVICE_MAX_RESIDENT; i++) {
+        if ((device_weights[i].host == host) &&
+            (device_weights[i].size == size)) {
+            if (device_weights[i].generation == generation) {
+                device_weights[i].last_used = device_clock;
+                return &device_weights[i];
+            }
+            resident = &device_weights[i];
+            break;
+        }
+    }
+
+    if (resident == NULL) {
+        resident = &device_weights[0];
+        for (i = 0; i < DEVICE_MAX_RESIDENT; i++) {
+            if (device_weights[i].buffer == NULL) {
+                resident = &device_weights[i];
+                break;
+            }
+            if (device_weights[i].last_used < resident->last_used) {
+                resident = &device_weights[i];
+            }
+        }
+    }
+
+    device_resident_free(resident);
+    resident->buffer = device_upload(host, size);
+    if (resident->buffer == NULL) {
+        return NULL;
+    }
+    resident->host = host;
+    resident->size = size;
+    resident->generation = generation;
+    resident->last_used = device_clock;
+    device_uploads++;
+    return resident;
+}
+
+/**
+ * @brief Frees every weight matrix held on the device
+ */
+static void device_resident_clear(void)
+{
+    for (int i = 0; i < DEVICE_MAX_RESIDENT; i++) {
+        device_resident_free(&device_weights[i]);
+    }
+}
+
+/**
+ * @brief Selects the device used for large matrix multiplies.  Weights
+ *        already on the previous device are released.
+ * @param type DEVICE_NONE to use the CPU kernels only, DEVICE_HOST to
+ *        emulate a device in memory, or DEVICE_OPENCL which is only
+ *        available if compiled with DEEPLEARN_OPENCL
+ * @returns zero on success
+ */
+int device_select(int type)
+{
+    int retval = 0;
+
+#pragma omp critical (deeplearn_device)
+    {
+        if (type != device_type) {
+            device_resident_clear();
+#ifdef DEEPLEARN_OPENCL
+            device_opencl_free();
+#endif
+            device_type = DEVICE_NONE;
+
+            switch(type) {
+            case DEVICE_NONE: break;
+            case DEVICE_HOST: {
+                device_type = DEVICE_HOST;
+                break;
+            }
+            case DEVICE_OPENCL: {
+#ifdef DEEPLEARN_OPENCL
+                if (device_opencl_init() == 0) {
+                    device_type = DEVICE_OPENCL;
+                }
+                else {
+                    retval = -2;
+                }
+#else
+                retval = -2;
+#endif
+                break;
+            }
+            default: {
+                retval = -1;
+                break;
+            }
+            }
+        }
+    }
+    return retval;
+}
+
+/**
+ * @brief Returns the currently selected device
+ * @returns Device, such as DEVICE_OPENCL
+ */
+int device_get_type(void)
+{
+    return device_type;
+}
+
+/**
+ * @brief Returns whether the given device can be selected
+ * @param type Device, such as DEVICE_OPENCL
+ * @returns non-zero if the device is available
+ */
+int device_available(int type)
+{
+    switch(type) {
+    case DEVICE_NONE: return 1;
+    case DEVICE_HOST: return 1;
+    case DEVICE_OPENCL: {
+#ifdef DEEPLEARN_OPENCL
+        cl_device_id id;
+        return (device_opencl_find(&id) == 0);
+#else
+        return 0;
+#endif
+    }
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns a human readable name for a device
+ * @param type Device, such as DEVICE_OPENCL
+ * @returns Name of the device
+ */
+const char * device_name(int type)
+{
+    switch(type) {
+    case DEVICE_NONE: return "none";
+    case DEVICE_HOST: return "host";
+    case DEVICE_OPENCL: return "opencl";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Sets the minimum size of matrix multiply which is moved to
+ *        the device
+ * @param multiplies Minimum number of multiplies, m*n*k
+ */
+void device_set_gemm_min(double multiplies)
+{
+    device_gemm_min = multiplies;
+}
+
+/**
+ * @brief Returns a new generation for a set of weights which have
+ *        changed.  The owner of the weights keeps this and passes it to
+ *        device_gemm_nt, so that the weights are copied to the device
+ *        again before they are next used, while the copies of other
+ *        weights stay on the device.  Every call gives a different
+ *        non-zero value, so weights allocated where others were freed
+ *        are never mistaken for them.
+ * @returns The generation of the changed weights
+ */
+unsigned int device_weights_changed(void)
+{
+    unsigned int generation;
+
+#pragma omp atomic capture
+    generation = ++device_generation;
+
+    if (generation == 0) {
+#pragma omp atomic capture
+        generation = ++device_generation;
+    }
+    return generation;
+}
+
+/**
+ * @brief Matrix multiply with the second matrix transposed, C = A.B^T,
+ *        evaluated on the selected device.  B is a matrix of weights,
+ *        which stays on the device until its generation changes.
+ * @param m Number of rows of A and C
+ * @param n Number of rows of B and columns of C
+ * @param k Number of columns of A and B
+ * @param a First matrix of m x k values
+ * @param b Second matrix of n x k weights
+ * @param generation Generation of the weights from device_weights_changed,
+ *        or zero if B is not tracked and is only copied for this product
+ * @param c Returned matrix of m x n values
+ * @returns zero if the product was evaluated on the device, or non-zero
+ *          if it should be evaluated by the CPU kernels instead
+ */
+int device_gemm_nt(int m, int n, int k,
+                   const float * a, const float * b,
+                   unsigned int generation, float * c)
+{
+    int retval = 0;
+
+    if ((device_type == DEVICE_NONE) ||
+        ((double)m*n*k < device_gemm_min)) {
+        return -1;
+    }
+
+#pragma omp critical (deeplearn_device)
+    {
+        device_resident temporary, * resident = NULL;
+
+        /* untracked weights are copied for this product only */
+        memset((void*)&temporary, '\0', sizeof(device_resident));
+        if (generation != 0) {
+            resident = device_resident_get(b, (size_t)n*k*sizeof(float),
+                                           generation);
+        }
+        else {
+            temporary.buffer = device_upload(b, (size_t)n*k*sizeof(float));
+            if (temporary.buffer != NULL) {
+                resident = &temporary;
+                device_uploads++;
+            }
+        }
+
+        if (resident == NULL) {
+            retval = -2;
+        }
+        else if (device_type == DEVICE_HOST) {
+            device_host_gemm_nt(m, n, k, a,
+                                (const float*)resident->buffer, c);
+        }
+#ifdef DEEPLEARN_OPENCL
+        else if (device_opencl_gemm_nt(m, n, k, a,
+                                       (cl_mem)resident->buffer, c) != 0) {
+            retval = -3;
+        }
+#else
+        else {
+            retval = -3;
+        }
+#endif
+        device_resident_free(&temporary);
+    }
+    return retval;
+}
+
+/**
+ * @brief Returns the number of times that weights have been copied to
+ *        the device
+ * @returns number of uploads
+ */
+unsigned int device_weight_uploads(void)
+{
+    return device_uploads;
+}
+
+/**
+ * @brief Returns the memory used by weights held on the device
+ * @returns size in bytes
+ */
+size_t device_resident_bytes(void)
+{
+    size_t bytes = 0;
+
+#pragma omp critical (deeplearn_device)
+    {
+        for (int i = 0; i < DEVICE_MAX_RESIDENT; i++) {
+            if (device_weights[i].buffer) {
+                bytes += device_weights[i].size;
+            }
+        }
+    }
+    return bytes;
+}
+
+/**
+ * @brief Frees everything held on the device and returns to using the
+ *        CPU kernels only
+ */
+void device_release(void)
+{
+    device_select(DEVICE_NONE);
+}
@@ -0,0 +1,67 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_DEVICE_H
+#define DEEPLEARN_DEVICE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/* devices on which matrix multiplies may be evaluated */
+#define DEVICE_NONE    0
+#define DEVICE_HOST    1
+#define DEVICE_OPENCL  2
+
+/* maximum number of weight matrices held on the device at once */
+#define DEVICE_MAX_RESIDENT 64
+
+/* default minimum number of multiplies before a matrix multiply is
+   moved to the device, below which the transfers cost more than
+   they save */
+#define DEVICE_GEMM_MIN 262144
+
+/* size of the square tiles used by the OpenCL matrix multiply */
+#define DEVICE_OPENCL_TILE 16
+
+int device_select(int type);
+int device_get_type(void);
+int device_available(int type);
+const char * device_name(int type);
+void device_set_gemm_min(double multiplies);
+unsigned int device_weights_changed(void);
+int device_gemm_nt(int m, int n, int k,
+                   const float * a, const float * b,
+                   unsigned int generation, float * c);
+unsigned int device_weight_uploads(void);
+size_t device_resident_bytes(void);
+void device_release(void);
+
+#endif
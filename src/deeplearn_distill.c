@@ -0,0 +1,405 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_distill.h"
+
+/**
+ * @brief Allocates the inputs and targets of a set of soft targets
+ * @param distill Distillation object
+ * @param no_of_inputs The number of input units
+ * @param no_of_outputs The number of output units
+ * @param samples The number of samples
+ * @returns zero on success
+ */
+static int deeplearn_distill_alloc(deeplearn_distill * distill,
+                                   int no_of_inputs, int no_of_outputs,
+                                   int samples)
+{
+    memset((void*)distill, '\0', sizeof(deeplearn_distill));
+    distill->inputs =
+        (float*)malloc((size_t)samples*no_of_inputs*sizeof(float));
+    distill->targets =
+        (float*)malloc((size_t)samples*no_of_outputs*sizeof(float));
+    if ((!distill->inputs) || (!distill->targets)) {
+        deeplearn_distill_free(distill);
+        return -1;
+    }
+    distill->no_of_inputs = no_of_inputs;
+    distill->no_of_outputs = no_of_outputs;
+    distill->samples = samples;
+    return 0;
+}
+
+/**
+ * @brief Moves the soft targets of a sample towards its label
+ * @param targets Soft targets of the sample
+ * @param label Encoded desired outputs of the sample
+ * @param no_of_outputs The number of output units
+ * @param label_weight Fraction of the target taken from the label
+ */
+static void deeplearn_distill_blend(float * targets, const float * label,
+                                    int no_of_outputs, float label_weight)
+{
+    for (int i = 0; i < no_of_outputs; i++) {
+        targets[i] = ((1.0f - label_weight)*targets[i]) +
+            (label_weight*label[i]);
+    }
+}
+
+/**
+ * @brief Collects soft targets from a trained deep learner for every
+ *        sample within its training set, labeled or not.  The training
+ *        set should have been created beforehand.  The teacher is fed
+ *        forward in batches without changing its state.
+ * @param distill Distillation object
+ * @param teacher Trained deep learner
+ * @param label_weight Fraction of the target of each labeled sample
+ *        taken from its label rather than from the teacher, in the
+ *        range 0.0 to 1.0
+ * @returns zero on success
+ */
+int deeplearn_distill_init(deeplearn_distill * distill, deeplearn * teacher,
+                           float label_weight)
+{
+    int no_of_inputs = teacher->net->NoOfInputs;
+    int no_of_outputs = teacher->net->NoOfOutputs;
+    int samples = teacher->indexed_training_data_samples;
+    float * label;
+    bp_inference ctx;
+
+    memset((void*)distill, '\0', sizeof(deeplearn_distill));
+    if ((label_weight < 0) || (label_weight > 1)) {
+        return -1;
+    }
+    if (samples < 1) {
+        return -2;
+    }
+    if (deeplearn_distill_alloc(distill, no_of_inputs, no_of_outputs,
+                                samples) != 0) {
+        return -3;
+    }
+    for (int s = 0; s < samples; s++) {
+        deeplearndata * sample = deeplearndata_get_training(teacher, s);
+        if (sample == NULL) {
+            deeplearn_distill_free(distill);
+            return -4;
+        }
+        deeplearn_encode_inputs(teacher, sample,
+                                &distill->inputs[s*no_of_inputs]);
+    }
+
+    /* soft targets are the outputs of the teacher */
+    if (bp_inference_init(&ctx, teacher->net, DEEPLEARN_DISTILL_BATCH) != 0) {
+        deeplearn_distill_free(distill);
+        return -5;
+    }
+    for (int start = 0; start < samples; start += DEEPLEARN_DISTILL_BATCH) {
+        int batch_size = samples - start;
+        if (batch_size > DEEPLEARN_DISTILL_BATCH) {
+            batch_size = DEEPLEARN_DISTILL_BATCH;
+        }
+        if (bp_infer(teacher->net, &ctx,
+                     &distill->inputs[start*no_of_inputs],
+                     &distill->targets[start*no_of_outputs],
+                     batch_size) != 0) {
+            bp_inference_free(&ctx);
+            deeplearn_distill_free(distill);
+            return -6;
+        }
+    }
+    bp_inference_free(&ctx);
+
+    /* labeled samples may also learn from their labels */
+    label = (float*)malloc(no_of_outputs*sizeof(float));
+    if (!label) {
+        deeplearn_distill_free(distill);
+        return -7;
+    }
+    for (int s = 0; s < samples; s++) {
+        deeplearndata * sample = deeplearndata_get_training(teacher, s);
+
+        if (sample->labeled == 0) continue;
+        distill->labeled++;
+        if (label_weight > 0) {
+            deeplearn_encode_outputs(teacher, sample, label);
+            deeplearn_distill_blend(&distill->targets[s*no_of_outputs],
+                                    label, no_of_outputs, label_weight);
+        }
+    }
+    free(label);
+    return 0;
+}
+
+/**
+ * @brief Collects soft targets from a trained convnet for every image
+ *        within its training set.  The inputs are the outputs of the
+ *        convolution layers, so that a smaller deep learner can be
+ *        trained to take the place of the deep learner of the convnet
+ *        with deeplearn_distill_convnet.
+ * @param distill Distillation object
+ * @param teacher Trained deep convnet
+ * @param label_weight Fraction of the target of each image with a known
+ *        class taken from its class rather than from the teacher, in
+ *        the range 0.0 to 1.0
+ * @returns zero on success
+ */
+int deeplearn_distill_init_convnet(deeplearn_distill * distill,
+                                   deepconvnet * teacher,
+                                   float label_weight)
+{
+    bp * net = teacher->learner->net;
+    int no_of_inputs = net->NoOfInputs;
+    int no_of_outputs = net->NoOfOutputs;
+    int samples = teacher->training_images;
+    bp_layer * inputs = &net->layer[0];
+    bp_layer * outputs = &net->layer[net->HiddenLayers+1];
+    float * label;
+
+    memset((void*)distill, '\0', sizeof(deeplearn_distill));
+    if ((label_weight < 0) || (label_weight > 1)) {
+        return -1;
+    }
+    if ((samples < 1) || (teacher->training_set_index == NULL)) {
+        return -2;
+    }
+    if (teacher->convolution->training_complete == 0) {
+        return -3;
+    }
+    if (deeplearn_distill_alloc(distill, no_of_inputs, no_of_outputs,
+                                samples) != 0) {
+        return -4;
+    }
+    label = (float*)malloc(no_of_outputs*sizeof(float));
+    if (!label) {
+        deeplearn_distill_free(distill);
+        return -5;
+    }
+
+    for (int s = 0; s < samples; s++) {
+        int index = teacher->training_set_index[s];
+        float * targets = &distill->targets[s*no_of_outputs];
+        int class_number = -1;
+
+        if (deepconvnet_test_img(teacher, teacher->images[index]) != 0) {
+            free(label);
+            deeplearn_distill_free(distill);
+            return -6;
+        }
+        memcpy((void*)&distill->inputs[s*no_of_inputs],
+               (void*)inputs->values, no_of_inputs*sizeof(float));
+        memcpy((void*)targets, (void*)outputs->values,
+               no_of_outputs*sizeof(float));
+
+        if (teacher->classification_number != NULL) {
+            class_number = teacher->classification_number[index];
+        }
+        if ((class_number < 0) || (class_number >= no_of_outputs)) {
+            continue;
+        }
+        distill->labeled++;
+        if (label_weight > 0) {
+            for (int i = 0; i < no_of_outputs; i++) {
+                label[i] = (i == class_number) ? 0.75f : 0.25f;
+            }
+            deeplearn_distill_blend(targets, label, no_of_outputs,
+                                    label_weight);
+        }
+    }
+    free(label);
+    return 0;
+}
+
+/**
+ * @brief Trains a student on randomly chosen samples and their soft
+ *        targets, in mini-batches.  Pretraining of the student's hidden
+ *        layers takes place first, as with any other deep learner.
+ * @param distill Distillation object
+ * @param student Deep learner with the same inputs and outputs as
+ *        the teacher
+ * @param samples The number of samples to train on
+ * @param batch_size The number of samples within each batch
+ * @param random_seed Random number generator seed
+ * @returns zero on success
+ */
+int deeplearn_distill_train(deeplearn_distill * distill, deeplearn * student,
+                            int samples, int batch_size,
+                            unsigned int * random_seed)
+{
+    int no_of_inputs = distill->no_of_inputs;
+    int no_of_outputs = distill->no_of_outputs;
+    float * inputs, * targets;
+    int retval = 0;
+
+    if ((samples < 1) || (batch_size < 1) || (distill->samples < 1)) {
+        return -1;
+    }
+    if ((student->net->NoOfInputs != no_of_inputs) ||
+        (student->net->NoOfOutputs != no_of_outputs)) {
+        return -2;
+    }
+
+    inputs = (float*)malloc(batch_size*no_of_inputs*sizeof(float));
+    targets = (float*)malloc(batch_size*no_of_outputs*sizeof(float));
+    if ((!inputs) || (!targets)) {
+        free(inputs);
+        free(targets);
+        return -3;
+    }
+
+    for (int trained = 0; trained < samples; trained += batch_size) {
+        int size = samples - trained;
+        if (size > batch_size) {
+            size = batch_size;
+        }
+        for (int b = 0; b < size; b++) {
+            int s = (int)(rand_num(random_seed) % distill->samples);
+            memcpy((void*)&inputs[b*no_of_inputs],
+                   (void*)&distill->inputs[s*no_of_inputs],
+                   no_of_inputs*sizeof(float));
+            memcpy((void*)&targets[b*no_of_outputs],
+                   (void*)&distill->targets[s*no_of_outputs],
+                   no_of_outputs*sizeof(float));
+        }
+        if (deeplearn_update_batch_values(student, inputs, targets,
+                                          size) != 0) {
+            retval = -4;
+            break;
+        }
+    }
+    free(inputs);
+    free(targets);
+    return retval;
+}
+
+/**
+ * @brief Returns how closely a student follows the soft targets, as the
+ *        root mean square difference between its outputs and the targets
+ *        as a percentage of the output range
+ * @param distill Distillation object
+ * @param student Deep learner being trained
+ * @returns The error, or a negative value on failure
+ */
+float deeplearn_distill_error(deeplearn_distill * distill,
+                              deeplearn * student)
+{
+    bp * net = student->net;
+    int no_of_outputs = distill->no_of_outputs;
+    float * outputs;
+    double total = 0;
+    bp_inference ctx;
+
+    if ((distill->samples < 1) ||
+        (net->NoOfInputs != distill->no_of_inputs) ||
+        (net->NoOfOutputs != no_of_outputs)) {
+        return -1;
+    }
+    outputs = (float*)malloc(DEEPLEARN_DISTILL_BATCH*no_of_outputs*
+                             sizeof(float));
+    if (!outputs) {
+        return -2;
+    }
+    if (bp_inference_init(&ctx, net, DEEPLEARN_DISTILL_BATCH) != 0) {
+        free(outputs);
+        return -3;
+    }
+
+    for (int start = 0; start < distill->samples;
+         start += DEEPLEARN_DISTILL_BATCH) {
+        int batch_size = distill->samples - start;
+        if (batch_size > DEEPLEARN_DISTILL_BATCH) {
+            batch_size = DEEPLEARN_DISTILL_BATCH;
+        }
+        if (bp_infer(net, &ctx, &distill->inputs[start*distill->no_of_inputs],
+                     outputs, batch_size) != 0) {
+            bp_inference_free(&ctx);
+            free(outputs);
+            return -4;
+        }
+        for (int i = 0; i < batch_size*no_of_outputs; i++) {
+            double diff = outputs[i] -
+                distill->targets[start*no_of_outputs + i];
+            total += diff*diff;
+        }
+    }
+    bp_inference_free(&ctx);
+    free(outputs);
+
+    /* encoded values span the range 0.25-0.75 */
+    return (float)(sqrt(total / ((double)distill->samples*no_of_outputs)) *
+                   100.0 / 0.5);
+}
+
+/**
+ * @brief Creates a convnet with the convolution layers of a teacher and
+ *        a distilled deep learner in place of its own
+ * @param student Deep convnet object to be created
+ * @param teacher Deep convnet whose convolution layers are copied
+ * @param learner Deep learner trained with soft targets collected by
+ *        deeplearn_distill_init_convnet
+ * @returns zero on success
+ */
+int deeplearn_distill_convnet(deepconvnet * student, deepconvnet * teacher,
+                              deeplearn * learner)
+{
+    deeplearn * copy;
+
+    if ((learner->net->NoOfInputs != teacher->learner->net->NoOfInputs) ||
+        (learner->net->NoOfOutputs != teacher->learner->net->NoOfOutputs)) {
+        return -1;
+    }
+
+    copy = (deeplearn*)malloc(sizeof(deeplearn));
+    if (!copy) {
+        return -2;
+    }
+    if (deeplearn_clone(copy, learner) != 0) {
+        free(copy);
+        return -3;
+    }
+    if (deepconvnet_clone(student, teacher) != 0) {
+        deeplearn_free(copy);
+        free(copy);
+        return -4;
+    }
+    deeplearn_free(student->learner);
+    free(student->learner);
+    student->learner = copy;
+    return 0;
+}
+
+/**
+ * @brief Deallocates the inputs and soft targets
+ * @param distill Distillation object
+ */
+void deeplearn_distill_free(deeplearn_distill * distill)
+{
+    free(distill->inputs);
+    free(distill->targets);
+    memset((void*)distill, '\0', sizeof(deeplearn_distill));
+}
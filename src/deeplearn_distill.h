@@ -0,0 +1,83 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_DISTILL_H
+#define DEEPLEARN_DISTILL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "globals.h"
+#include "deeplearn_random.h"
+#include "backprop.h"
+#include "deeplearn.h"
+#include "deeplearndata.h"
+#include "deepconvnet.h"
+
+/* number of samples fed forward together when evaluating a teacher
+   or a student */
+#define DEEPLEARN_DISTILL_BATCH 64
+
+/* Soft targets from a trained teacher for every training sample, used
+   to train a smaller student.  The teacher is evaluated once for each
+   sample and its outputs kept, so that the student can be trained for
+   any number of samples without running the teacher again.  Unlabeled
+   samples are included, since their targets come from the teacher,
+   while the targets of labeled samples may be blended with the label.
+   Inputs and targets are encoded as unit values, so the student should
+   share the fields and ranges of the teacher, as created by
+   deeplearn_init_like. */
+typedef struct {
+    int no_of_inputs, no_of_outputs;
+    int samples;
+
+    /* the number of samples whose targets include a label */
+    int labeled;
+
+    /* encoded inputs and soft targets, one row per sample */
+    float * inputs;
+    float * targets;
+} deeplearn_distill;
+
+int deeplearn_distill_init(deeplearn_distill * distill, deeplearn * teacher,
+                           float label_weight);
+int deeplearn_distill_init_convnet(deeplearn_distill * distill,
+                                   deepconvnet * teacher,
+                                   float label_weight);
+int deeplearn_distill_train(deeplearn_distill * distill, deeplearn * student,
+                            int samples, int batch_size,
+                            unsigned int * random_seed);
+float deeplearn_distill_error(deeplearn_distill * distill,
+                              deeplearn * student);
+int deeplearn_distill_convnet(deepconvnet * student, deepconvnet * teacher,
+                              deeplearn * learner);
+void deeplearn_distill_free(deeplearn_distill * distill);
+
+#endif
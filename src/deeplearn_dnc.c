@@ -45,23 +45,21 @@
 static int deeplearn_dnc_init_memory(deeplearn_dnc * learner, int memory_size,
                                      int memory_width)
 {
-    int i;
-
     learner->memory.size =
         (unsigned int)((memory_size/
                        DEEPLEARNDNC_USAGE_BLOCK_SIZE)*
                        DEEPLEARNDNC_USAGE_BLOCK_SIZE);
     learner->memory.width = (unsigned int)memory_width;
+
+    /* all memory vectors within one matrix */
     learner->memory.address =
-        (float**)malloc(learner->memory.size * sizeof(float*));
+        (float*)malloc((size_t)learner->memory.size *
+                       learner->memory.width * sizeof(float));
     if (learner->memory.address == NULL) return 1;
 
-    /* allocate memory vectors */
-    for (i = 0; i < learner->memory.size; i++) {
-        learner->memory.address[i] =
-            (float*)malloc(learner->memory.width * sizeof(float));
-        if (learner->memory.address[i] == NULL) return 2;
-    }
+    learner->memory.inverse_length =
+        (float*)malloc(learner->memory.size * sizeof(float));
+    if (learner->memory.inverse_length == NULL) return 2;
     return 0;
 }
 
@@ -71,42 +69,54 @@ static int deeplearn_dnc_init_memory(deeplearn_dnc * learner, int memory_size,
  */
 static void deeplearn_dnc_free_memory(deeplearn_dnc * learner)
 {
-    int i;
-
-    for (i = 0; i < learner->memory.size; i++) {
-        free(learner->memory.address[i]);
-    }
     free(learner->memory.address);
+    free(learner->memory.inverse_length);
 }
 
 /**
- * @brief Allocates the memory usage and temporal matrix of the neural computer
+ * @brief Allocates the memory usage and temporal linkage of the neural computer
  * @param learner The DNC object
  * @returns zero on success
  */
 static int deeplearn_dnc_init_memory_usage(deeplearn_dnc * learner)
 {
-    /* The memory usage array is downsampled by the block size */
-    int i, memory_usage_size = learner->memory.size / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    /* The memory size is a whole number of usage blocks */
+    int i, blocks = learner->memory.size / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int links = blocks * DEEPLEARNDNC_LINKS;
 
     /* memory usage */
     learner->memory.usage =
-        (float*)malloc(memory_usage_size * sizeof(float));
-    if (learner->memory.usage == NULL) return 1;
+        (float*)malloc(learner->memory.size * sizeof(float));
+    learner->memory.block_usage = (float*)malloc(blocks * sizeof(float));
+    learner->memory.usage_heap = (int*)malloc(blocks * sizeof(int));
+    learner->memory.heap_position = (int*)malloc(blocks * sizeof(int));
+    if ((learner->memory.usage == NULL) ||
+        (learner->memory.block_usage == NULL) ||
+        (learner->memory.usage_heap == NULL) ||
+        (learner->memory.heap_position == NULL)) {
+        return 1;
+    }
 
-    /* temporal matrix of memory usage. This encodes which address was used
+    /* temporal linkage of memory usage. This encodes which address was used
        after which previous address for each read and write head */
     for (i = 0; i < DEEPLEARNDNC_READ_HEADS + DEEPLEARNDNC_WRITE_HEADS; i++) {
-        learner->memory.usage_temporal[i] =
-            (float*)malloc(memory_usage_size * memory_usage_size * sizeof(float));
-        if (learner->memory.usage_temporal[i] == NULL) return 2;
+        deeplearn_dnc_links * temporal = &learner->memory.usage_temporal[i];
+
+        temporal->next = (int*)malloc(links * sizeof(int));
+        temporal->next_strength = (float*)malloc(links * sizeof(float));
+        temporal->prev = (int*)malloc(links * sizeof(int));
+        temporal->prev_strength = (float*)malloc(links * sizeof(float));
+        if ((temporal->next == NULL) || (temporal->next_strength == NULL) ||
+            (temporal->prev == NULL) || (temporal->prev_strength == NULL)) {
+            return 2;
+        }
     }
 
     return 0;
 }
 
 /**
- * @brief Deallocates memory usage and temporal matrix of the neural computer
+ * @brief Deallocates memory usage and temporal linkage of the neural computer
  * @param learner The DNC object
  */
 static void deeplearn_dnc_free_memory_usage(deeplearn_dnc * learner)
@@ -114,8 +124,15 @@ static void deeplearn_dnc_free_memory_usage(deeplearn_dnc * learner)
     int i;
 
     free(learner->memory.usage);
-    for (i = 0; i < DEEPLEARNDNC_READ_HEADS + DEEPLEARNDNC_WRITE_HEADS; i++)
-        free(learner->memory.usage_temporal[i]);
+    free(learner->memory.block_usage);
+    free(learner->memory.usage_heap);
+    free(learner->memory.heap_position);
+    for (i = 0; i < DEEPLEARNDNC_READ_HEADS + DEEPLEARNDNC_WRITE_HEADS; i++) {
+        free(learner->memory.usage_temporal[i].next);
+        free(learner->memory.usage_temporal[i].next_strength);
+        free(learner->memory.usage_temporal[i].prev);
+        free(learner->memory.usage_temporal[i].prev_strength);
+    }
 }
 
 /**
@@ -127,9 +144,24 @@ static int deeplearn_dnc_init_heads(deeplearn_dnc * learner)
 {
     int i;
 
+    for (i = 0; i < DEEPLEARNDNC_READ_HEADS; i++) {
+        learner->read_head[i].sparse_index = NULL;
+        learner->read_head[i].sparse_weighting = NULL;
+        learner->read_head[i].sparse_count = 0;
+    }
+    for (i = 0; i < DEEPLEARNDNC_WRITE_HEADS; i++) {
+        learner->write_head[i].sparse_index = NULL;
+        learner->write_head[i].sparse_weighting = NULL;
+        learner->write_head[i].sparse_count = 0;
+    }
+
     for (i = 0; i < DEEPLEARNDNC_READ_HEADS; i++) {
         learner->read_head[i].key = (float*)malloc(learner->memory.width * sizeof(float));
         if (learner->read_head[i].key == NULL) return 1;
+        learner->read_head[i].weighting = (float*)malloc(learner->memory.size * sizeof(float));
+        if (learner->read_head[i].weighting == NULL) return 5;
+        learner->read_head[i].read = (float*)malloc(learner->memory.width * sizeof(float));
+        if (learner->read_head[i].read == NULL) return 6;
     }
 
     for (i = 0; i < DEEPLEARNDNC_WRITE_HEADS; i++) {
@@ -139,6 +171,8 @@ static int deeplearn_dnc_init_heads(deeplearn_dnc * learner)
         if (learner->write_head[i].erase == NULL) return 3;
         learner->write_head[i].key = (float*)malloc(learner->memory.width * sizeof(float));
         if (learner->write_head[i].key == NULL) return 4;
+        learner->write_head[i].weighting = (float*)malloc(learner->memory.size * sizeof(float));
+        if (learner->write_head[i].weighting == NULL) return 7;
     }
 
     return 0;
@@ -154,12 +188,15 @@ static void deeplearn_dnc_free_heads(deeplearn_dnc * learner)
 
     for (i = 0; i < DEEPLEARNDNC_READ_HEADS; i++) {
         free(learner->read_head[i].key);
+        free(learner->read_head[i].weighting);
+        free(learner->read_head[i].read);
     }
 
     for (i = 0; i < DEEPLEARNDNC_WRITE_HEADS; i++) {
         free(learner->write_head[i].write);
         free(learner->write_head[i].erase);
         free(learner->write_head[i].key);
+        free(learner->write_head[i].weighting);
     }
 }
 
@@ -198,6 +235,9 @@ int deeplearn_dnc_init(deeplearn_dnc * learner,
 
     learner->no_of_inputs = no_of_inputs;
     learner->no_of_outputs = no_of_outputs;
+    learner->random_seed = *random_seed;
+    learner->sparse_k = 0;
+    memset((void*)&learner->index, '\0', sizeof(deeplearn_dnc_index));
 
     learner->controller = (deeplearn*)malloc(sizeof(deeplearn));
     if (learner->controller==NULL) return 1000;
@@ -220,6 +260,7 @@ int deeplearn_dnc_init(deeplearn_dnc * learner,
                             random_seed);
     if (retval != 0) return 5000 + retval;
 
+    deeplearn_dnc_clear_memory(learner);
     return 0;
 }
 
@@ -231,6 +272,7 @@ void deeplearn_dnc_feed_forward(deeplearn_dnc * learner)
 {
     deeplearn_dnc_update_read_heads(learner);
     deeplearn_feed_forward(learner->controller);
+    deeplearn_dnc_update_write_heads(learner);
 }
 
 /**
@@ -239,7 +281,226 @@ void deeplearn_dnc_feed_forward(deeplearn_dnc * learner)
  */
 void deeplearn_dnc_update(deeplearn_dnc * learner)
 {
+    deeplearn_dnc_update_read_heads(learner);
     deeplearn_update(learner->controller);
+    deeplearn_dnc_update_write_heads(learner);
+}
+
+/**
+ * @brief Exchanges the memory and heads of the DNC object with those
+ *        of a sequence state.  Swapping a second time restores them.
+ * @param learner The DNC object
+ * @param state Sequence state
+ */
+static void deeplearn_dnc_swap_state(deeplearn_dnc * learner,
+                                     deeplearn_dnc_state * state)
+{
+    deeplearn_dnc_state current;
+
+    current.memory = learner->memory;
+    memcpy((void*)current.read_head, (void*)learner->read_head,
+           sizeof(learner->read_head));
+    memcpy((void*)current.write_head, (void*)learner->write_head,
+           sizeof(learner->write_head));
+    current.index = learner->index;
+
+    learner->memory = state->memory;
+    memcpy((void*)learner->read_head, (void*)state->read_head,
+           sizeof(learner->read_head));
+    memcpy((void*)learner->write_head, (void*)state->write_head,
+           sizeof(learner->write_head));
+    learner->index = state->index;
+
+    *state = current;
+}
+
+/**
+ * @brief Deallocates the memory and heads of a sequence state
+ * @param learner The DNC object
+ * @param state Sequence state
+ */
+static void deeplearn_dnc_free_state(deeplearn_dnc * learner,
+                                     deeplearn_dnc_state * state)
+{
+    int sparse_k = learner->sparse_k;
+
+    deeplearn_dnc_swap_state(learner, state);
+    deeplearn_dnc_set_sparse(learner, 0);
+    deeplearn_dnc_free_memory(learner);
+    deeplearn_dnc_free_memory_usage(learner);
+    deeplearn_dnc_free_heads(learner);
+    deeplearn_dnc_swap_state(learner, state);
+    learner->sparse_k = sparse_k;
+}
+
+/**
+ * @brief Allocates the memory and heads of a sequence state, with the
+ *        same dimensions and addressing mode as the DNC object, and
+ *        clears the memory
+ * @param learner The DNC object
+ * @param state Sequence state
+ * @returns zero on success
+ */
+static int deeplearn_dnc_init_state(deeplearn_dnc * learner,
+                                    deeplearn_dnc_state * state)
+{
+    int sparse_k = learner->sparse_k;
+    int size = (int)learner->memory.size;
+    int width = (int)learner->memory.width;
+    int retval;
+
+    memset((void*)state, '\0', sizeof(deeplearn_dnc_state));
+    deeplearn_dnc_swap_state(learner, state);
+
+    retval = deeplearn_dnc_init_memory(learner, size, width);
+    if (retval == 0) {
+        retval = deeplearn_dnc_init_memory_usage(learner);
+    }
+    if (retval == 0) {
+        retval = deeplearn_dnc_init_heads(learner);
+    }
+    learner->sparse_k = 0;
+    if ((retval == 0) && (sparse_k > 0)) {
+        retval = deeplearn_dnc_set_sparse(learner, sparse_k);
+    }
+    if (retval == 0) {
+        deeplearn_dnc_clear_memory(learner);
+    }
+
+    deeplearn_dnc_swap_state(learner, state);
+    learner->sparse_k = sparse_k;
+    if (retval != 0) {
+        deeplearn_dnc_free_state(learner, state);
+    }
+    return retval;
+}
+
+/**
+ * @brief Trains on a batch of independent sequences.  Each sequence has
+ *        its own memory, which is cleared at the start, and at each
+ *        timestep the controller is evaluated and updated for the whole
+ *        batch as one mini-batch.  The memory of the DNC object itself
+ *        is left unchanged.
+ * @param learner The DNC object
+ * @param inputs Input values in the range 0.0 to 1.0, ordered by
+ *        sequence, then timestep, then input
+ * @param targets Desired output values in the range 0.0 to 1.0, ordered
+ *        by sequence, then timestep, then output
+ * @param no_of_sequences The number of sequences within the batch
+ * @param sequence_length The number of timesteps within each sequence
+ * @returns zero on success
+ */
+int deeplearn_dnc_update_sequences(deeplearn_dnc * learner,
+                                   float * inputs, float * targets,
+                                   int no_of_sequences,
+                                   int sequence_length)
+{
+    bp * net = learner->controller->net;
+    int controller_inputs = net->NoOfInputs;
+    int controller_outputs = net->NoOfOutputs;
+    deeplearn_dnc_state * state;
+    bp_inference ctx;
+    float * batch_inputs, * batch_outputs, * batch_targets;
+    int s, t, i, retval = 0;
+
+    if ((no_of_sequences < 1) || (sequence_length < 1)) return -1;
+
+    state = (deeplearn_dnc_state*)malloc(no_of_sequences*sizeof(deeplearn_dnc_state));
+    batch_inputs = (float*)malloc(no_of_sequences*controller_inputs*sizeof(float));
+    batch_outputs = (float*)malloc(no_of_sequences*controller_outputs*sizeof(float));
+    batch_targets = (float*)malloc(no_of_sequences*controller_outputs*sizeof(float));
+    if ((state == NULL) || (batch_inputs == NULL) || (batch_outputs == NULL) ||
+        (batch_targets == NULL) ||
+        (bp_inference_init(&ctx, net, no_of_sequences) != 0)) {
+        free(state);
+        free(batch_inputs);
+        free(batch_outputs);
+        free(batch_targets);
+        return -2;
+    }
+
+    /* before the first timestep the memory interface is neutral */
+    for (i = 0; i < no_of_sequences*controller_outputs; i++) {
+        batch_outputs[i] = 0.5f;
+    }
+    for (s = 0; s < no_of_sequences; s++) {
+        if (deeplearn_dnc_init_state(learner, &state[s]) != 0) {
+            while (--s >= 0) {
+                deeplearn_dnc_free_state(learner, &state[s]);
+            }
+            retval = -3;
+            break;
+        }
+    }
+
+    for (t = 0; (t < sequence_length) && (retval == 0); t++) {
+        /* read from the memory of each sequence, using the interface
+           which the controller output for it on the previous timestep */
+        for (s = 0; s < no_of_sequences; s++) {
+            float * step_inputs =
+                &inputs[((size_t)s*sequence_length + t)*learner->no_of_inputs];
+            float * row = &batch_inputs[s*controller_inputs];
+
+            deeplearn_dnc_swap_state(learner, &state[s]);
+            for (i = 0; i < controller_outputs; i++) {
+                net->outputs[i]->value = batch_outputs[s*controller_outputs + i];
+            }
+            for (i = 0; i < learner->no_of_inputs; i++) {
+                deeplearn_set_input(learner->controller, i, step_inputs[i]);
+            }
+            deeplearn_dnc_update_read_heads(learner);
+            for (i = 0; i < controller_inputs; i++) {
+                row[i] = net->inputs[i]->value;
+            }
+            deeplearn_dnc_swap_state(learner, &state[s]);
+        }
+
+        /* the controller for the whole batch */
+        if (bp_infer(net, &ctx, batch_inputs, batch_outputs,
+                     no_of_sequences) != 0) {
+            retval = -4;
+            break;
+        }
+
+        /* write to the memory of each sequence.  The memory interface
+           has no target values, so its outputs are their own targets */
+        for (s = 0; s < no_of_sequences; s++) {
+            float * step_targets =
+                &targets[((size_t)s*sequence_length + t)*learner->no_of_outputs];
+            float * row = &batch_outputs[s*controller_outputs];
+            float * target = &batch_targets[s*controller_outputs];
+
+            deeplearn_dnc_swap_state(learner, &state[s]);
+            for (i = 0; i < controller_outputs; i++) {
+                net->outputs[i]->value = row[i];
+                target[i] = row[i];
+            }
+            deeplearn_dnc_update_write_heads(learner);
+            deeplearn_dnc_swap_state(learner, &state[s]);
+
+            for (i = 0; i < learner->no_of_outputs; i++) {
+                target[i] = step_targets[i];
+            }
+        }
+
+        if (deeplearn_update_batch_values(learner->controller,
+                                          batch_inputs, batch_targets,
+                                          no_of_sequences) != 0) {
+            retval = -5;
+        }
+    }
+
+    if (retval != -3) {
+        for (s = 0; s < no_of_sequences; s++) {
+            deeplearn_dnc_free_state(learner, &state[s]);
+        }
+    }
+    bp_inference_free(&ctx);
+    free(state);
+    free(batch_inputs);
+    free(batch_outputs);
+    free(batch_targets);
+    return retval;
 }
 
 /**
@@ -248,12 +509,75 @@ void deeplearn_dnc_update(deeplearn_dnc * learner)
  */
 void deeplearn_dnc_free(deeplearn_dnc * learner)
 {
+    deeplearn_dnc_set_sparse(learner, 0);
     deeplearn_dnc_free_memory(learner);
     deeplearn_dnc_free_memory_usage(learner);
     deeplearn_dnc_free_heads(learner);
 
     /* free controller */
     deeplearn_free(learner->controller);
+    free(learner->controller);
+}
+
+/**
+ * @brief Returns the memory used by a neural computer.  The memory
+ *        matrix, its usage and linkage, the heads and the sparse index
+ *        are counted as activations, together with the breakdown of the
+ *        controller.
+ * @param learner The DNC object
+ * @param usage Returned memory footprint
+ */
+void deeplearn_dnc_memory_usage(deeplearn_dnc * learner,
+                                deeplearn_footprint * usage)
+{
+    size_t size = (size_t)learner->memory.size;
+    size_t width = (size_t)learner->memory.width;
+    size_t blocks = size / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    size_t links = blocks * DEEPLEARNDNC_LINKS;
+    size_t k = (size_t)learner->sparse_k;
+    size_t bytes, hashes;
+
+    deeplearn_footprint_clear(usage);
+    if (learner->controller != NULL) {
+        deeplearn_memory_usage(learner->controller, usage);
+    }
+    usage->other += sizeof(deeplearn_dnc);
+
+    /* memory, usage and temporal linkage */
+    bytes = size*width*sizeof(float) + 2*size*sizeof(float) +
+        blocks*(sizeof(float) + 2*sizeof(int)) +
+        (DEEPLEARNDNC_READ_HEADS + DEEPLEARNDNC_WRITE_HEADS)*
+        links*2*(sizeof(int) + sizeof(float));
+
+    /* heads */
+    bytes += DEEPLEARNDNC_READ_HEADS*(2*width + size)*sizeof(float) +
+        DEEPLEARNDNC_WRITE_HEADS*(3*width + size)*sizeof(float);
+
+    if (k > 0) {
+        /* addresses selected by each head and the hashed index */
+        hashes = DEEPLEARNDNC_LSH_TABLES*DEEPLEARNDNC_LSH_BITS;
+        bytes += DEEPLEARNDNC_READ_HEADS*
+            (k + 2*DEEPLEARNDNC_LINKS*DEEPLEARNDNC_USAGE_BLOCK_SIZE)*
+            (sizeof(int) + sizeof(float)) +
+            DEEPLEARNDNC_WRITE_HEADS*(k + 1)*(sizeof(int) + sizeof(float)) +
+            hashes*(width + 1)*sizeof(float) +
+            (DEEPLEARNDNC_LSH_TABLES << DEEPLEARNDNC_LSH_BITS)*sizeof(int) +
+            3*DEEPLEARNDNC_LSH_TABLES*size*sizeof(int) +
+            size*sizeof(unsigned int);
+    }
+    usage->activations += bytes;
+}
+
+/**
+ * @brief Frees buffers of the controller which are only needed to speed
+ *        up training, and which are built again when next needed
+ * @param learner The DNC object
+ */
+void deeplearn_dnc_trim_memory(deeplearn_dnc * learner)
+{
+    if (learner->controller != NULL) {
+        deeplearn_trim_memory(learner->controller);
+    }
 }
 
 /**
@@ -540,40 +864,972 @@ int deeplearn_dnc_training_last_layer(deeplearn_dnc * learner)
     return deeplearn_training_last_layer(learner->controller);
 }
 
+/**
+ * @brief Removes all temporal links of a head
+ * @param learner DNC object
+ * @param temporal Temporal linkage of the head
+ */
+static void deeplearn_dnc_clear_links(deeplearn_dnc * learner,
+                                      deeplearn_dnc_links * temporal)
+{
+    int i, links =
+        (learner->memory.size / DEEPLEARNDNC_USAGE_BLOCK_SIZE) *
+        DEEPLEARNDNC_LINKS;
+
+    for (i = 0; i < links; i++) {
+        temporal->next[i] = -1;
+        temporal->next_strength[i] = 0;
+        temporal->prev[i] = -1;
+        temporal->prev_strength[i] = 0;
+    }
+    temporal->last_block = -1;
+}
+
+/**
+ * @brief Empties the sparse mode index of memory addresses
+ * @param learner DNC object
+ */
+static void deeplearn_dnc_index_clear(deeplearn_dnc * learner)
+{
+    deeplearn_dnc_index * index = &learner->index;
+    int i;
+
+    for (i = 0; i < (DEEPLEARNDNC_LSH_TABLES << DEEPLEARNDNC_LSH_BITS); i++) {
+        index->bucket[i] = -1;
+    }
+    for (i = 0; i < DEEPLEARNDNC_LSH_TABLES*(int)learner->memory.size; i++) {
+        index->row_bucket[i] = -1;
+    }
+    memset((void*)index->visited, '\0',
+           learner->memory.size * sizeof(unsigned int));
+    index->visit = 0;
+}
+
 /**
  * @brief Clears the memory of the neural computer
  * @param learner DNC object
  */
 void deeplearn_dnc_clear_memory(deeplearn_dnc * learner)
 {
-    int i, memory_usage_size = learner->memory.size / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int i, blocks = learner->memory.size / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
 
     /* clear all address vectors */
-    for (i = 0; i < learner->memory.size; i++)
-        memset((void*)learner->memory.address[i], '\0',
-               learner->memory.width * sizeof(float));
+    memset((void*)learner->memory.address, '\0',
+           (size_t)learner->memory.size * learner->memory.width * sizeof(float));
+    memset((void*)learner->memory.inverse_length, '\0',
+           learner->memory.size * sizeof(float));
 
-    /* clear the memory usage */
+    /* clear the memory usage.  All blocks are equally unused, so any
+       order is a valid heap */
     memset((void*)learner->memory.usage, '\0',
-           memory_usage_size * sizeof(float*));
+           learner->memory.size * sizeof(float));
+    for (i = 0; i < blocks; i++) {
+        learner->memory.block_usage[i] = 0;
+        learner->memory.usage_heap[i] = i;
+        learner->memory.heap_position[i] = i;
+    }
+
+    /* clear the temporal linkage */
+    for (i = 0; i < DEEPLEARNDNC_READ_HEADS + DEEPLEARNDNC_WRITE_HEADS; i++) {
+        deeplearn_dnc_clear_links(learner, &learner->memory.usage_temporal[i]);
+    }
 
-    /* clear the temporal matrix */
-    memset((void*)learner->memory.usage_temporal, '\0',
-           memory_usage_size * memory_usage_size * sizeof(float*));
+    /* nothing has been read yet */
+    for (i = 0; i < DEEPLEARNDNC_READ_HEADS; i++) {
+        memset((void*)learner->read_head[i].read, '\0',
+               learner->memory.width * sizeof(float));
+    }
+
+    if (learner->sparse_k > 0) {
+        deeplearn_dnc_index_clear(learner);
+    }
 }
 
 /**
- * @brief Updates the read heads of the neural computer
+ * @brief Updates the reciprocal length of a memory address after
+ *        it has been written
+ * @param learner DNC object
+ * @param index Index of the memory address
+ */
+static void deeplearn_dnc_update_length(deeplearn_dnc * learner, int index)
+{
+    float * row = &learner->memory.address[(size_t)index*learner->memory.width];
+    float length = sqrtf(kernel_dot(row, row, learner->memory.width));
+
+    learner->memory.inverse_length[index] = (length > 0) ? 1.0f / length : 0;
+}
+
+/**
+ * @brief Swaps two entries within the usage heap
+ * @param memory Memory of the neural computer
+ * @param i Position of the first entry
+ * @param j Position of the second entry
+ */
+static void deeplearn_dnc_heap_swap(deeplearn_dnc_memory * memory,
+                                    int i, int j)
+{
+    int block = memory->usage_heap[i];
+
+    memory->usage_heap[i] = memory->usage_heap[j];
+    memory->usage_heap[j] = block;
+    memory->heap_position[memory->usage_heap[i]] = i;
+    memory->heap_position[memory->usage_heap[j]] = j;
+}
+
+/**
+ * @brief Sets the usage of a memory address, updating the minimum usage
+ *        of its block and the position of the block within the heap
+ * @param learner DNC object
+ * @param address Index of the memory address
+ * @param value New usage in the range 0.0 to 1.0
+ */
+static void deeplearn_dnc_set_usage(deeplearn_dnc * learner, int address,
+                                    float value)
+{
+    deeplearn_dnc_memory * memory = &learner->memory;
+    int blocks = memory->size / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int block = address / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int start = block * DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int end = start + DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int i, child;
+    float minimum;
+
+    memory->usage[address] = value;
+
+    minimum = memory->usage[start];
+    for (i = start + 1; i < end; i++) {
+        if (memory->usage[i] < minimum) minimum = memory->usage[i];
+    }
+    if (minimum == memory->block_usage[block]) return;
+    memory->block_usage[block] = minimum;
+
+    /* sift up */
+    i = memory->heap_position[block];
+    while ((i > 0) &&
+           (memory->block_usage[memory->usage_heap[(i-1)/2]] > minimum)) {
+        deeplearn_dnc_heap_swap(memory, i, (i-1)/2);
+        i = (i-1)/2;
+    }
+
+    /* sift down */
+    while ((child = i*2 + 1) < blocks) {
+        if ((child + 1 < blocks) &&
+            (memory->block_usage[memory->usage_heap[child+1]] <
+             memory->block_usage[memory->usage_heap[child]])) {
+            child++;
+        }
+        if (memory->block_usage[memory->usage_heap[child]] >= minimum) break;
+        deeplearn_dnc_heap_swap(memory, i, child);
+        i = child;
+    }
+}
+
+/**
+ * @brief Returns the least used memory address, which is the one that
+ *        write heads allocate to
+ * @param learner DNC object
+ * @returns Index of the memory address
+ */
+int deeplearn_dnc_least_used(deeplearn_dnc * learner)
+{
+    deeplearn_dnc_memory * memory = &learner->memory;
+    int start = memory->usage_heap[0] * DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int end = start + DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int i, best = start;
+
+    for (i = start + 1; i < end; i++) {
+        if (memory->usage[i] < memory->usage[best]) best = i;
+    }
+    return best;
+}
+
+/**
+ * @brief Releases part of the usage of a memory address after it has
+ *        been read
+ * @param learner DNC object
+ * @param address Index of the memory address
+ * @param weight Weight with which the address was read
+ */
+void deeplearn_dnc_free_usage(deeplearn_dnc * learner, int address,
+                              float weight)
+{
+    float usage = learner->memory.usage[address];
+
+    if ((weight <= 0) || (usage == 0)) return;
+    deeplearn_dnc_set_usage(learner, address,
+                            usage*(1.0f - DEEPLEARNDNC_FREE_RATE*weight));
+}
+
+/**
+ * @brief Returns the bucket of a vector within one of the hash tables
+ *        of the sparse mode index
+ * @param projection Projections of the vector onto every hyperplane
+ * @param table Index of the hash table
+ * @returns Bucket index within the table
+ */
+static int deeplearn_dnc_index_hash(float * projection, int table)
+{
+    int bit, hash = 0;
+
+    for (bit = 0; bit < DEEPLEARNDNC_LSH_BITS; bit++) {
+        if (projection[table*DEEPLEARNDNC_LSH_BITS + bit] > 0) {
+            hash |= 1 << bit;
+        }
+    }
+    return (table << DEEPLEARNDNC_LSH_BITS) + hash;
+}
+
+/**
+ * @brief Removes a memory address from the sparse mode index
+ * @param learner DNC object
+ * @param row Index of the memory address
+ */
+static void deeplearn_dnc_index_remove(deeplearn_dnc * learner, int row)
+{
+    deeplearn_dnc_index * index = &learner->index;
+    int size = (int)learner->memory.size;
+
+    for (int t = 0; t < DEEPLEARNDNC_LSH_TABLES; t++) {
+        int i = t*size + row;
+
+        if (index->row_bucket[i] < 0) continue;
+        if (index->prev[i] >= 0) {
+            index->next[t*size + index->prev[i]] = index->next[i];
+        }
+        else {
+            index->bucket[index->row_bucket[i]] = index->next[i];
+        }
+        if (index->next[i] >= 0) {
+            index->prev[t*size + index->next[i]] = index->prev[i];
+        }
+        index->row_bucket[i] = -1;
+    }
+}
+
+/**
+ * @brief Adds a memory address to the sparse mode index, or moves it to
+ *        its new buckets after it has been written.  Addresses of zero
+ *        length are removed from the index.
+ * @param learner DNC object
+ * @param row Index of the memory address
+ */
+static void deeplearn_dnc_index_update(deeplearn_dnc * learner, int row)
+{
+    deeplearn_dnc_index * index = &learner->index;
+    int size = (int)learner->memory.size;
+    int width = (int)learner->memory.width;
+
+    if (learner->memory.inverse_length[row] == 0) {
+        deeplearn_dnc_index_remove(learner, row);
+        return;
+    }
+
+    kernel_gemv(DEEPLEARNDNC_LSH_TABLES*DEEPLEARNDNC_LSH_BITS, width,
+                index->hyperplanes,
+                &learner->memory.address[(size_t)row*width],
+                index->projection);
+
+    for (int t = 0; t < DEEPLEARNDNC_LSH_TABLES; t++) {
+        int i = t*size + row;
+        int bucket = deeplearn_dnc_index_hash(index->projection, t);
+
+        if (index->row_bucket[i] == bucket) continue;
+
+        /* unlink from the previous bucket */
+        if (index->row_bucket[i] >= 0) {
+            if (index->prev[i] >= 0) {
+                index->next[t*size + index->prev[i]] = index->next[i];
+            }
+            else {
+                index->bucket[index->row_bucket[i]] = index->next[i];
+            }
+            if (index->next[i] >= 0) {
+                index->prev[t*size + index->next[i]] = index->prev[i];
+            }
+        }
+
+        /* add to the front of the new bucket */
+        index->prev[i] = -1;
+        index->next[i] = index->bucket[bucket];
+        if (index->bucket[bucket] >= 0) {
+            index->prev[t*size + index->bucket[bucket]] = row;
+        }
+        index->bucket[bucket] = row;
+        index->row_bucket[i] = bucket;
+    }
+}
+
+/**
+ * @brief Content based addressing.  Returns a weighting over the memory
+ *        addresses given by a softmax of the cosine similarity between
+ *        the key and each address.  The dot products of the key with
+ *        every address are a single matrix-vector product.
+ * @param learner DNC object
+ * @param key Key vector of memory.width values
+ * @param strength Sharpness of the weighting, such as
+ *        DEEPLEARNDNC_KEY_STRENGTH
+ * @param weighting Returned weighting of memory.size values, which sums
+ *        to one
+ */
+void deeplearn_dnc_content_weighting(deeplearn_dnc * learner, float * key,
+                                     float strength, float * weighting)
+{
+    int i, size = (int)learner->memory.size;
+    int parallel = ((double)size*learner->memory.width >=
+                    DEEPLEARNDNC_PARALLEL_MIN);
+    float key_length = sqrtf(kernel_dot(key, key, learner->memory.width));
+    float scale, maximum = -1, total = 0;
+
+    if (size == 0) return;
+
+    kernel_gemv(size, (int)learner->memory.width,
+                learner->memory.address, key, weighting);
+
+    /* cosine similarity, then a softmax */
+    scale = (key_length > 0) ? strength / key_length : 0;
+#pragma omp parallel for num_threads(threads_count()) reduction(max:maximum) if (parallel)
+    for (i = 0; i < size; i++) {
+        weighting[i] *= scale*learner->memory.inverse_length[i];
+        if (weighting[i] > maximum) maximum = weighting[i];
+    }
+#pragma omp parallel for num_threads(threads_count()) reduction(+:total) if (parallel)
+    for (i = 0; i < size; i++) {
+        weighting[i] = expf(weighting[i] - maximum);
+        total += weighting[i];
+    }
+    scale = 1.0f / total;
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
+    for (i = 0; i < size; i++) {
+        weighting[i] *= scale;
+    }
+}
+
+/**
+ * @brief Inserts an address into a list of the best matching addresses,
+ *        which is kept in descending order of similarity
+ * @param k Maximum length of the list
+ * @param n Current length of the list
+ * @param index Indexes of the addresses within the list
+ * @param similarity Similarities of the addresses within the list
+ * @param row Index of the address to be inserted
+ * @param value Similarity of the address to be inserted
+ * @returns The new length of the list
+ */
+static int deeplearn_dnc_top_k(int k, int n, int * index, float * similarity,
+                               int row, float value)
+{
+    int i;
+
+    if ((n == k) && (value <= similarity[n-1])) return n;
+    if (n < k) n++;
+    for (i = n-1; (i > 0) && (similarity[i-1] < value); i--) {
+        index[i] = index[i-1];
+        similarity[i] = similarity[i-1];
+    }
+    index[i] = row;
+    similarity[i] = value;
+    return n;
+}
+
+/**
+ * @brief Content based addressing in sparse mode.  Candidate addresses
+ *        are those which share a hash bucket with the key in any of the
+ *        index tables, and only the sparse_k most similar of these are
+ *        returned, with a softmax of their cosine similarity as weights.
+ * @param learner DNC object, which must be in sparse mode
+ * @param key Key vector of memory.width values
+ * @param strength Sharpness of the weighting, such as
+ *        DEEPLEARNDNC_KEY_STRENGTH
+ * @param index Returned indexes of up to sparse_k addresses
+ * @param weighting Returned weights of the addresses, which sum to one
+ * @returns The number of addresses returned
+ */
+int deeplearn_dnc_content_weighting_sparse(deeplearn_dnc * learner,
+                                           float * key, float strength,
+                                           int * index, float * weighting)
+{
+    deeplearn_dnc_index * lsh = &learner->index;
+    int size = (int)learner->memory.size;
+    int width = (int)learner->memory.width;
+    int k = learner->sparse_k, n = 0, i, row;
+    float key_length = sqrtf(kernel_dot(key, key, width));
+    float scale, total = 0;
+
+    if (k <= 0) return 0;
+
+    /* stamps which mark addresses already examined by this query */
+    lsh->visit++;
+    if (lsh->visit == 0) {
+        memset((void*)lsh->visited, '\0', size*sizeof(unsigned int));
+        lsh->visit = 1;
+    }
+
+    kernel_gemv(DEEPLEARNDNC_LSH_TABLES*DEEPLEARNDNC_LSH_BITS, width,
+                lsh->hyperplanes, key, lsh->projection);
+    scale = (key_length > 0) ? 1.0f / key_length : 0;
+
+    for (int t = 0; t < DEEPLEARNDNC_LSH_TABLES; t++) {
+        int candidates = 0;
+
+        row = lsh->bucket[deeplearn_dnc_index_hash(lsh->projection, t)];
+        while ((row >= 0) && (candidates < DEEPLEARNDNC_LSH_CANDIDATES)) {
+            if (lsh->visited[row] != lsh->visit) {
+                lsh->visited[row] = lsh->visit;
+                n = deeplearn_dnc_top_k(k, n, index, weighting, row,
+                                        kernel_dot(&learner->memory.address[(size_t)row*width],
+                                                   key, width) *
+                                        scale*learner->memory.inverse_length[row]);
+                candidates++;
+            }
+            row = lsh->next[t*size + row];
+        }
+    }
+
+    /* softmax, where the first entry has the greatest similarity */
+    for (i = n-1; i >= 0; i--) {
+        weighting[i] = expf((weighting[i] - weighting[0])*strength);
+        total += weighting[i];
+    }
+    for (i = 0; i < n; i++) {
+        weighting[i] /= total;
+    }
+    return n;
+}
+
+/**
+ * @brief Reads from memory, returning the sum of the memory addresses
+ *        multiplied by the given weighting
+ * @param learner DNC object
+ * @param weighting Weighting of memory.size values
+ * @param read Returned vector of memory.width values
+ */
+void deeplearn_dnc_read_memory(deeplearn_dnc * learner, float * weighting,
+                               float * read)
+{
+    int width = (int)learner->memory.width;
+
+    memset((void*)read, '\0', width*sizeof(float));
+    for (int i = 0; i < (int)learner->memory.size; i++) {
+        if (weighting[i] != 0) {
+            kernel_axpy(read, weighting[i],
+                        &learner->memory.address[(size_t)i*width], width);
+        }
+    }
+}
+
+/**
+ * @brief Reads from a list of memory addresses, returning the sum of
+ *        the addresses multiplied by their weights
+ * @param learner DNC object
+ * @param n Number of addresses
+ * @param index Indexes of the addresses
+ * @param weighting Weights of the addresses
+ * @param read Returned vector of memory.width values
+ */
+void deeplearn_dnc_read_memory_sparse(deeplearn_dnc * learner, int n,
+                                      int * index, float * weighting,
+                                      float * read)
+{
+    int width = (int)learner->memory.width;
+
+    memset((void*)read, '\0', width*sizeof(float));
+    for (int i = 0; i < n; i++) {
+        kernel_axpy(read, weighting[i],
+                    &learner->memory.address[(size_t)index[i]*width], width);
+    }
+}
+
+/**
+ * @brief Writes to memory.  Each address is partly erased and then has
+ *        the write vector added, in proportion to its weighting, and
+ *        its usage increases by the same proportion
+ * @param learner DNC object
+ * @param weighting Weighting of memory.size values
+ * @param write Vector of memory.width values to be written
+ * @param erase Vector of memory.width values in the range 0.0 to 1.0
+ */
+void deeplearn_dnc_write_memory(deeplearn_dnc * learner, float * weighting,
+                                float * write, float * erase)
+{
+    int i, size = (int)learner->memory.size;
+    int width = (int)learner->memory.width;
+
+#pragma omp parallel for num_threads(threads_count()) if ((double)size*width >= DEEPLEARNDNC_PARALLEL_MIN)
+    for (i = 0; i < size; i++) {
+        float * row = &learner->memory.address[(size_t)i*width];
+
+        if (weighting[i] == 0) continue;
+        for (int j = 0; j < width; j++) {
+            row[j] = row[j]*(1.0f - weighting[i]*erase[j]) +
+                weighting[i]*write[j];
+        }
+        deeplearn_dnc_update_length(learner, i);
+    }
+
+    for (i = 0; i < size; i++) {
+        if (weighting[i] == 0) continue;
+        deeplearn_dnc_set_usage(learner, i,
+                                learner->memory.usage[i] +
+                                (1.0f - learner->memory.usage[i])*weighting[i]);
+        if (learner->sparse_k > 0) {
+            deeplearn_dnc_index_update(learner, i);
+        }
+    }
+}
+
+/**
+ * @brief Writes to a list of memory addresses.  Each address is partly
+ *        erased and then has the write vector added, in proportion to
+ *        its weight, and its usage and entry within the index are
+ *        updated.
+ * @param learner DNC object
+ * @param n Number of addresses
+ * @param index Indexes of the addresses
+ * @param weighting Weights of the addresses
+ * @param write Vector of memory.width values to be written
+ * @param erase Vector of memory.width values in the range 0.0 to 1.0
+ */
+void deeplearn_dnc_write_memory_sparse(deeplearn_dnc * learner, int n,
+                                       int * index, float * weighting,
+                                       float * write, float * erase)
+{
+    int width = (int)learner->memory.width;
+
+    for (int i = 0; i < n; i++) {
+        float * row = &learner->memory.address[(size_t)index[i]*width];
+
+        for (int j = 0; j < width; j++) {
+            row[j] = row[j]*(1.0f - weighting[i]*erase[j]) +
+                weighting[i]*write[j];
+        }
+        deeplearn_dnc_update_length(learner, index[i]);
+        deeplearn_dnc_set_usage(learner, index[i],
+                                learner->memory.usage[index[i]] +
+                                (1.0f - learner->memory.usage[index[i]])*weighting[i]);
+        if (learner->sparse_k > 0) {
+            deeplearn_dnc_index_update(learner, index[i]);
+        }
+    }
+}
+
+/**
+ * @brief Strengthens the link to a block within the links of another
+ *        block, weakening the others
+ * @param link Links of the block
+ * @param strength Strengths of the links
+ * @param block The linked block
+ */
+static void deeplearn_dnc_strengthen_link(int * link, float * strength,
+                                          int block)
+{
+    int i, weakest = 0, found = -1;
+
+    for (i = 0; i < DEEPLEARNDNC_LINKS; i++) {
+        strength[i] *= 1.0f - DEEPLEARNDNC_LINK_RATE;
+        if (link[i] == block) found = i;
+        if (strength[i] < strength[weakest]) weakest = i;
+    }
+    if (found < 0) {
+        found = weakest;
+        link[found] = block;
+        strength[found] = 0;
+    }
+    strength[found] += DEEPLEARNDNC_LINK_RATE;
+}
+
+/**
+ * @brief Updates the temporal linkage of a head after it has addressed
+ *        memory, linking the block which it previously addressed most
+ *        strongly to the one it now addresses most strongly
+ * @param temporal Temporal linkage of the head
+ * @param address The address with the greatest weight
+ */
+static void deeplearn_dnc_update_links(deeplearn_dnc_links * temporal,
+                                       int address)
+{
+    int block = address / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    int last = temporal->last_block;
+    if ((last >= 0) && (last != block)) {
+        deeplearn_dnc_strengthen_link(&temporal->next[last*DEEPLEARNDNC_LINKS],
+                                      &temporal->next_strength[last*DEEPLEARNDNC_LINKS],
+                                      block);
+        deeplearn_dnc_strengthen_link(&temporal->prev[block*DEEPLEARNDNC_LINKS],
+                                      &temporal->prev_strength[block*DEEPLEARNDNC_LINKS],
+                                      last);
+    }
+    temporal->last_block = block;
+}
+
+/**
+ * @brief Returns the addresses which follow or precede a block within
+ *        the temporal linkage, with weights which sum to the given total
+ * @param temporal Temporal linkage to be followed
+ * @param block The block from which links are followed
+ * @param direction DEEPLEARNDNC_MODE_FORWARD or DEEPLEARNDNC_MODE_BACKWARD
+ * @param total Sum of the returned weights
+ * @param index Returned indexes of the addresses
+ * @param weighting Returned weights of the addresses
+ * @returns The number of addresses, of at most
+ *          DEEPLEARNDNC_LINKS*DEEPLEARNDNC_USAGE_BLOCK_SIZE
+ */
+static int deeplearn_dnc_temporal_weighting(deeplearn_dnc_links * temporal,
+                                            int block, int direction,
+                                            float total, int * index,
+                                            float * weighting)
+{
+    int i, j, n = 0;
+    int * link;
+    float * strength, sum = 0;
+
+    if (block < 0) return 0;
+
+    if (direction == DEEPLEARNDNC_MODE_FORWARD) {
+        link = &temporal->next[block*DEEPLEARNDNC_LINKS];
+        strength = &temporal->next_strength[block*DEEPLEARNDNC_LINKS];
+    }
+    else {
+        link = &temporal->prev[block*DEEPLEARNDNC_LINKS];
+        strength = &temporal->prev_strength[block*DEEPLEARNDNC_LINKS];
+    }
+
+    for (i = 0; i < DEEPLEARNDNC_LINKS; i++) {
+        if (link[i] >= 0) sum += strength[i];
+    }
+    if (sum <= 0) return 0;
+
+    for (i = 0; i < DEEPLEARNDNC_LINKS; i++) {
+        if ((link[i] < 0) || (strength[i] <= 0)) continue;
+        for (j = 0; j < DEEPLEARNDNC_USAGE_BLOCK_SIZE; j++, n++) {
+            index[n] = link[i]*DEEPLEARNDNC_USAGE_BLOCK_SIZE + j;
+            weighting[n] =
+                total*strength[i] / (sum*DEEPLEARNDNC_USAGE_BLOCK_SIZE);
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Switches sparse mode on or off.  In sparse mode each head
+ *        addresses only the k best matching addresses found through an
+ *        approximate nearest neighbour index, together with any
+ *        temporally linked addresses, so that the cost of each step
+ *        doesn't grow with the size of the memory.
+ * @param learner DNC object
+ * @param k Number of addresses selected by content, or zero to address
+ *        all of the memory
+ * @returns zero on success
+ */
+int deeplearn_dnc_set_sparse(deeplearn_dnc * learner, int k)
+{
+    deeplearn_dnc_index * index = &learner->index;
+    int size = (int)learner->memory.size;
+    int capacity, h, i;
+
+    if ((k < 0) || (k > size)) return -1;
+
+    /* deallocate */
+    for (h = 0; h < DEEPLEARNDNC_READ_HEADS; h++) {
+        free(learner->read_head[h].sparse_index);
+        free(learner->read_head[h].sparse_weighting);
+        learner->read_head[h].sparse_index = NULL;
+        learner->read_head[h].sparse_weighting = NULL;
+        learner->read_head[h].sparse_count = 0;
+    }
+    for (h = 0; h < DEEPLEARNDNC_WRITE_HEADS; h++) {
+        free(learner->write_head[h].sparse_index);
+        free(learner->write_head[h].sparse_weighting);
+        learner->write_head[h].sparse_index = NULL;
+        learner->write_head[h].sparse_weighting = NULL;
+        learner->write_head[h].sparse_count = 0;
+    }
+    free(index->hyperplanes);
+    free(index->projection);
+    free(index->bucket);
+    free(index->next);
+    free(index->prev);
+    free(index->row_bucket);
+    free(index->visited);
+    memset((void*)index, '\0', sizeof(deeplearn_dnc_index));
+    learner->sparse_k = 0;
+
+    if (k == 0) return 0;
+
+    /* content addresses followed by forward and backward links, or by
+       the allocated address for write heads */
+    capacity = k + (2*DEEPLEARNDNC_LINKS*DEEPLEARNDNC_USAGE_BLOCK_SIZE);
+    for (h = 0; h < DEEPLEARNDNC_READ_HEADS; h++) {
+        learner->read_head[h].sparse_index = (int*)malloc(capacity*sizeof(int));
+        learner->read_head[h].sparse_weighting = (float*)malloc(capacity*sizeof(float));
+        if ((learner->read_head[h].sparse_index == NULL) ||
+            (learner->read_head[h].sparse_weighting == NULL)) {
+            deeplearn_dnc_set_sparse(learner, 0);
+            return -2;
+        }
+    }
+    for (h = 0; h < DEEPLEARNDNC_WRITE_HEADS; h++) {
+        learner->write_head[h].sparse_index = (int*)malloc((k+1)*sizeof(int));
+        learner->write_head[h].sparse_weighting = (float*)malloc((k+1)*sizeof(float));
+        if ((learner->write_head[h].sparse_index == NULL) ||
+            (learner->write_head[h].sparse_weighting == NULL)) {
+            deeplearn_dnc_set_sparse(learner, 0);
+            return -2;
+        }
+    }
+
+    i = DEEPLEARNDNC_LSH_TABLES*DEEPLEARNDNC_LSH_BITS;
+    index->hyperplanes =
+        (float*)malloc(i*learner->memory.width*sizeof(float));
+    index->projection = (float*)malloc(i*sizeof(float));
+    index->bucket =
+        (int*)malloc((DEEPLEARNDNC_LSH_TABLES << DEEPLEARNDNC_LSH_BITS)*sizeof(int));
+    index->next = (int*)malloc(DEEPLEARNDNC_LSH_TABLES*size*sizeof(int));
+    index->prev = (int*)malloc(DEEPLEARNDNC_LSH_TABLES*size*sizeof(int));
+    index->row_bucket = (int*)malloc(DEEPLEARNDNC_LSH_TABLES*size*sizeof(int));
+    index->visited = (unsigned int*)malloc(size*sizeof(unsigned int));
+    if ((index->hyperplanes == NULL) || (index->projection == NULL) ||
+        (index->bucket == NULL) || (index->next == NULL) ||
+        (index->prev == NULL) || (index->row_bucket == NULL) ||
+        (index->visited == NULL)) {
+        deeplearn_dnc_set_sparse(learner, 0);
+        return -3;
+    }
+
+    /* random hyperplanes through the origin */
+    rand_fill_uniform(rand_stream_seed(learner->random_seed, 1), 0,
+                      index->hyperplanes, i*learner->memory.width);
+    for (i = 0; i < DEEPLEARNDNC_LSH_TABLES*DEEPLEARNDNC_LSH_BITS*(int)learner->memory.width; i++) {
+        index->hyperplanes[i] -= 0.5f;
+    }
+
+    /* index the existing content */
+    learner->sparse_k = k;
+    deeplearn_dnc_index_clear(learner);
+    for (i = 0; i < size; i++) {
+        if (learner->memory.inverse_length[i] > 0) {
+            deeplearn_dnc_index_update(learner, i);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns a controller output as a memory value in the range
+ *        -1.0 to 1.0
+ * @param learner DNC object
+ * @param index Index of the output within the memory interface which
+ *        follows the outputs of the DNC
+ * @returns Memory value
+ */
+static float deeplearn_dnc_interface(deeplearn_dnc * learner, int index)
+{
+    float value =
+        (deeplearn_get_output(learner->controller,
+                              learner->no_of_outputs + index) - 0.5f)*4.0f;
+
+    if (value < -1) return -1;
+    if (value > 1) return 1;
+    return value;
+}
+
+/**
+ * @brief Returns the index of the largest value within an array
+ * @param values Array of values
+ * @param n Length of the array
+ * @returns Index of the largest value
+ */
+static int deeplearn_dnc_argmax(float * values, int n)
+{
+    int i, best = 0;
+
+    for (i = 1; i < n; i++) {
+        if (values[i] > values[best]) best = i;
+    }
+    return best;
+}
+
+/**
+ * @brief Updates the read heads of the neural computer.  Keys emitted
+ *        by the controller on the previous step select addresses by
+ *        content, and read modes mix these with the addresses written
+ *        before or after those the head last read.  The vectors read
+ *        become inputs to the controller, and the addresses read
+ *        release some of their usage.
  * @param learner DNC object
  */
 void deeplearn_dnc_update_read_heads(deeplearn_dnc * learner)
 {
+    int width = (int)learner->memory.width;
+    int offset = width*DEEPLEARNDNC_WRITE_HEADS;
+    deeplearn_dnc_links * written =
+        &learner->memory.usage_temporal[DEEPLEARNDNC_READ_HEADS];
+    int links_index[DEEPLEARNDNC_LINKS*DEEPLEARNDNC_USAGE_BLOCK_SIZE];
+    float links_weighting[DEEPLEARNDNC_LINKS*DEEPLEARNDNC_USAGE_BLOCK_SIZE];
+
+    for (int h = 0; h < DEEPLEARNDNC_READ_HEADS; h++) {
+        deeplearn_dnc_read_head * head = &learner->read_head[h];
+        deeplearn_dnc_links * temporal = &learner->memory.usage_temporal[h];
+        float mode[3], total = 0, content;
+        int i, m, n, top;
+
+        for (i = 0; i < width; i++) {
+            head->key[i] =
+                deeplearn_dnc_interface(learner, offset + h*(width+3) + i);
+        }
+        for (m = 0; m < 3; m++) {
+            mode[m] = deeplearn_get_output(learner->controller,
+                                           learner->no_of_outputs + offset +
+                                           h*(width+3) + width + m);
+            if (mode[m] < 0) mode[m] = 0;
+            total += mode[m];
+        }
+        head->mode = (char)deeplearn_dnc_argmax(mode, 3);
+
+        /* modes without any temporal links add to the content mode */
+        content = 1;
+        if (total > 0) {
+            for (m = 0; m < 3; m += 2) {
+                mode[m] /= total;
+                if (deeplearn_dnc_temporal_weighting(written, temporal->last_block,
+                                                     m, mode[m], links_index,
+                                                     links_weighting) > 0) {
+                    content -= mode[m];
+                }
+                else {
+                    mode[m] = 0;
+                }
+            }
+        }
+        else {
+            mode[DEEPLEARNDNC_MODE_BACKWARD] = 0;
+            mode[DEEPLEARNDNC_MODE_FORWARD] = 0;
+        }
+
+        if (learner->sparse_k > 0) {
+            n = deeplearn_dnc_content_weighting_sparse(learner, head->key,
+                                                       DEEPLEARNDNC_KEY_STRENGTH,
+                                                       head->sparse_index,
+                                                       head->sparse_weighting);
+            for (i = 0; i < n; i++) {
+                head->sparse_weighting[i] *= content;
+            }
+            for (m = 0; m < 3; m += 2) {
+                if (mode[m] <= 0) continue;
+                n += deeplearn_dnc_temporal_weighting(written, temporal->last_block,
+                                                      m, mode[m],
+                                                      &head->sparse_index[n],
+                                                      &head->sparse_weighting[n]);
+            }
+            head->sparse_count = n;
+            deeplearn_dnc_read_memory_sparse(learner, n, head->sparse_index,
+                                             head->sparse_weighting, head->read);
+            for (i = 0; i < n; i++) {
+                deeplearn_dnc_free_usage(learner, head->sparse_index[i],
+                                         head->sparse_weighting[i]);
+            }
+            top = (n > 0) ?
+                head->sparse_index[deeplearn_dnc_argmax(head->sparse_weighting, n)] : -1;
+        }
+        else {
+            deeplearn_dnc_content_weighting(learner, head->key,
+                                            DEEPLEARNDNC_KEY_STRENGTH,
+                                            head->weighting);
+            for (i = 0; i < (int)learner->memory.size; i++) {
+                head->weighting[i] *= content;
+            }
+            for (m = 0; m < 3; m += 2) {
+                if (mode[m] <= 0) continue;
+                n = deeplearn_dnc_temporal_weighting(written, temporal->last_block,
+                                                     m, mode[m], links_index,
+                                                     links_weighting);
+                for (i = 0; i < n; i++) {
+                    head->weighting[links_index[i]] += links_weighting[i];
+                }
+            }
+            deeplearn_dnc_read_memory(learner, head->weighting, head->read);
+            for (i = 0; i < (int)learner->memory.size; i++) {
+                deeplearn_dnc_free_usage(learner, i, head->weighting[i]);
+            }
+            top = deeplearn_dnc_argmax(head->weighting, (int)learner->memory.size);
+        }
+        if (top >= 0) {
+            deeplearn_dnc_update_links(temporal, top);
+        }
+
+        /* read vectors are inputs within the range 0.25 to 0.75 */
+        for (i = 0; i < width; i++) {
+            deeplearn_set_input(learner->controller,
+                                learner->no_of_inputs + h*width + i,
+                                0.5f + (head->read[i]*0.25f));
+        }
+    }
 }
 
 /**
- * @brief Updates the write heads of the neural computer
+ * @brief Updates the write heads of the neural computer.  The write
+ *        vector emitted by the controller is also used as the key, so
+ *        that it replaces the addresses with the most similar content.
+ *        Part of each write goes to the least used address instead,
+ *        and this share shrinks as the memory fills up.
  * @param learner DNC object
  */
 void deeplearn_dnc_update_write_heads(deeplearn_dnc * learner)
 {
+    int width = (int)learner->memory.width;
+
+    for (int h = 0; h < DEEPLEARNDNC_WRITE_HEADS; h++) {
+        deeplearn_dnc_write_head * head = &learner->write_head[h];
+        deeplearn_dnc_links * temporal =
+            &learner->memory.usage_temporal[DEEPLEARNDNC_READ_HEADS + h];
+        int i, n, top, allocated = deeplearn_dnc_least_used(learner);
+        float gate = DEEPLEARNDNC_ALLOCATION_GATE *
+            (1.0f - learner->memory.usage[allocated]);
+
+        for (i = 0; i < width; i++) {
+            head->write[i] = deeplearn_dnc_interface(learner, h*width + i);
+            head->key[i] = head->write[i];
+            head->erase[i] = 1;
+        }
+
+        if (learner->sparse_k > 0) {
+            n = deeplearn_dnc_content_weighting_sparse(learner, head->key,
+                                                       DEEPLEARNDNC_KEY_STRENGTH,
+                                                       head->sparse_index,
+                                                       head->sparse_weighting);
+
+            /* with no content to match everything is allocated */
+            if (n == 0) gate = 1;
+            for (i = 0; i < n; i++) {
+                head->sparse_weighting[i] *= 1.0f - gate;
+                if (head->sparse_index[i] == allocated) break;
+            }
+            if (i < n) {
+                head->sparse_weighting[i] += gate;
+                for (i++; i < n; i++) {
+                    head->sparse_weighting[i] *= 1.0f - gate;
+                }
+            }
+            else {
+                head->sparse_index[n] = allocated;
+                head->sparse_weighting[n++] = gate;
+            }
+            head->sparse_count = n;
+            deeplearn_dnc_write_memory_sparse(learner, n, head->sparse_index,
+                                              head->sparse_weighting,
+                                              head->write, head->erase);
+            top = head->sparse_index[deeplearn_dnc_argmax(head->sparse_weighting, n)];
+        }
+        else {
+            deeplearn_dnc_content_weighting(learner, head->key,
+                                            DEEPLEARNDNC_KEY_STRENGTH,
+                                            head->weighting);
+            for (i = 0; i < (int)learner->memory.size; i++) {
+                head->weighting[i] *= 1.0f - gate;
+            }
+            head->weighting[allocated] += gate;
+            deeplearn_dnc_write_memory(learner, head->weighting,
+                                       head->write, head->erase);
+            top = deeplearn_dnc_argmax(head->weighting, (int)learner->memory.size);
+        }
+        deeplearn_dnc_update_links(temporal, top);
+    }
 }
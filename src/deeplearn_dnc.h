@@ -41,6 +41,37 @@
 
 #define DEEPLEARNDNC_USAGE_BLOCK_SIZE 4
 
+/* fraction of the weight with which an address is read that is
+   released from its usage, and the largest share of each write which
+   goes to the least used address rather than to matching content */
+#define DEEPLEARNDNC_FREE_RATE        0.1f
+#define DEEPLEARNDNC_ALLOCATION_GATE  0.5f
+
+/* sharpness of the softmax over the cosine similarity between a key
+   and each memory address */
+#define DEEPLEARNDNC_KEY_STRENGTH     10.0f
+
+/* minimum number of memory values before addresses are updated in
+   parallel */
+#define DEEPLEARNDNC_PARALLEL_MIN     65536
+
+/* read modes, in the order in which the controller outputs them */
+#define DEEPLEARNDNC_MODE_BACKWARD    0
+#define DEEPLEARNDNC_MODE_CONTENT     1
+#define DEEPLEARNDNC_MODE_FORWARD     2
+
+/* number of blocks linked to and from each usage block within the
+   temporal linkage of a head, and the rate at which links strengthen */
+#define DEEPLEARNDNC_LINKS            4
+#define DEEPLEARNDNC_LINK_RATE        0.5f
+
+/* random hyperplane hashing used to find candidate addresses in sparse
+   mode.  At most DEEPLEARNDNC_LSH_CANDIDATES addresses are examined
+   within the bucket of each table */
+#define DEEPLEARNDNC_LSH_TABLES       4
+#define DEEPLEARNDNC_LSH_BITS         8
+#define DEEPLEARNDNC_LSH_CANDIDATES   512
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -51,18 +82,70 @@
 #include "deeplearndata.h"
 #include "deeplearn.h"
 
+/* The memory is a single size x width matrix with one row per address.
+   The reciprocal length of each row is kept current as rows are written
+   so that the cosine similarity of a key with every address can be
+   found with one matrix-vector product */
+/* Temporal linkage of a head at the resolution of usage blocks.  Each
+   block keeps only its DEEPLEARNDNC_LINKS strongest successors and
+   predecessors, so the linkage grows linearly with the memory size.
+   Unused links have a block index of -1 */
+struct deepl_dnc_links {
+    int * next;
+    float * next_strength;
+    int * prev;
+    float * prev_strength;
+    int last_block;
+};
+typedef struct deepl_dnc_links deeplearn_dnc_links;
+
+/* Approximate nearest neighbour index over the memory addresses, used
+   in sparse mode.  Each table hashes an address by which side of a set
+   of random hyperplanes it lies on, and addresses within a bucket are
+   chained together so that they can be moved when rewritten.  Addresses
+   which have zero length are not indexed */
+struct deepl_dnc_index {
+    float * hyperplanes;
+    float * projection;
+    int * bucket;
+    int * next;
+    int * prev;
+    int * row_bucket;
+    unsigned int * visited;
+    unsigned int visit;
+};
+typedef struct deepl_dnc_index deeplearn_dnc_index;
+
 struct deepl_dnc_memory {
     unsigned int size;
     unsigned int width;
-    float ** address;
+    float * address;
+    float * inverse_length;
+
+    /* Usage of each address in the range 0.0 to 1.0, and the minimum
+       usage within each block.  Blocks are kept in a binary min-heap
+       on their minimum usage, so that the least used address is found
+       without scanning the memory and a change of usage costs
+       O(log n) */
     float * usage;
-    float * usage_temporal[DEEPLEARNDNC_READ_HEADS + DEEPLEARNDNC_WRITE_HEADS];
+    float * block_usage;
+    int * usage_heap;
+    int * heap_position;
+    deeplearn_dnc_links usage_temporal[DEEPLEARNDNC_READ_HEADS + DEEPLEARNDNC_WRITE_HEADS];
 };
 typedef struct deepl_dnc_memory deeplearn_dnc_memory;
 
+/* Each head has a weighting over the memory addresses, and read heads
+   also hold the vector which was last read.  In sparse mode the weighting
+   is instead a short list of addresses and their weights */
 struct deepl_dnc_read_head {
     float * key;
+    float * weighting;
+    float * read;
     char mode;
+    int * sparse_index;
+    float * sparse_weighting;
+    int sparse_count;
 };
 typedef struct deepl_dnc_read_head deeplearn_dnc_read_head;
 
@@ -70,15 +153,35 @@ struct deepl_dnc_write_head {
     float * write;
     float * erase;
     float * key;
+    float * weighting;
+    int * sparse_index;
+    float * sparse_weighting;
+    int sparse_count;
 };
 typedef struct deepl_dnc_write_head deeplearn_dnc_write_head;
 
+/* Memory and heads of one sequence within a batch of sequences, which
+   are swapped in to the DNC object while that sequence is processed */
+struct deepl_dnc_state {
+    deeplearn_dnc_memory memory;
+    deeplearn_dnc_read_head read_head[DEEPLEARNDNC_READ_HEADS];
+    deeplearn_dnc_write_head write_head[DEEPLEARNDNC_WRITE_HEADS];
+    deeplearn_dnc_index index;
+};
+typedef struct deepl_dnc_state deeplearn_dnc_state;
+
 struct deepl_dnc {
     int no_of_inputs, no_of_outputs;
     deeplearn * controller;
     deeplearn_dnc_memory memory;
     deeplearn_dnc_read_head read_head[DEEPLEARNDNC_READ_HEADS];
     deeplearn_dnc_write_head write_head[DEEPLEARNDNC_WRITE_HEADS];
+    unsigned int random_seed;
+
+    /* number of addresses selected by content for each head in sparse
+       mode, or zero if heads address all of the memory */
+    int sparse_k;
+    deeplearn_dnc_index index;
 };
 typedef struct deepl_dnc deeplearn_dnc;
 
@@ -92,7 +195,14 @@ int deeplearn_dnc_init(deeplearn_dnc * learner,
                        unsigned int * random_seed);
 void deeplearn_dnc_feed_forward(deeplearn_dnc * learner);
 void deeplearn_dnc_update(deeplearn_dnc * learner);
+int deeplearn_dnc_update_sequences(deeplearn_dnc * learner,
+                                   float * inputs, float * targets,
+                                   int no_of_sequences,
+                                   int sequence_length);
 void deeplearn_dnc_free(deeplearn_dnc * learner);
+void deeplearn_dnc_memory_usage(deeplearn_dnc * learner,
+                                deeplearn_footprint * usage);
+void deeplearn_dnc_trim_memory(deeplearn_dnc * learner);
 void deeplearn_dnc_set_input_text(deeplearn_dnc * learner, char * text);
 void deeplearn_dnc_set_input(deeplearn_dnc * learner, int index, float value);
 int deeplearn_dnc_set_input_field(deeplearn_dnc * learner, int fieldindex, float value);
@@ -126,6 +236,26 @@ float deeplearn_dnc_get_error_threshold(deeplearn_dnc * learner, int index);
 void deeplearn_dnc_set_error_threshold(deeplearn_dnc * learner, int index, float value);
 void deeplearn_dnc_update_continuous(deeplearn_dnc * learner);
 int deeplearn_dnc_training_last_layer(deeplearn_dnc * learner);
+void deeplearn_dnc_clear_memory(deeplearn_dnc * learner);
+void deeplearn_dnc_content_weighting(deeplearn_dnc * learner, float * key,
+                                     float strength, float * weighting);
+void deeplearn_dnc_read_memory(deeplearn_dnc * learner, float * weighting,
+                               float * read);
+void deeplearn_dnc_write_memory(deeplearn_dnc * learner, float * weighting,
+                                float * write, float * erase);
+int deeplearn_dnc_set_sparse(deeplearn_dnc * learner, int k);
+int deeplearn_dnc_content_weighting_sparse(deeplearn_dnc * learner,
+                                           float * key, float strength,
+                                           int * index, float * weighting);
+void deeplearn_dnc_read_memory_sparse(deeplearn_dnc * learner, int n,
+                                      int * index, float * weighting,
+                                      float * read);
+void deeplearn_dnc_write_memory_sparse(deeplearn_dnc * learner, int n,
+                                       int * index, float * weighting,
+                                       float * write, float * erase);
+int deeplearn_dnc_least_used(deeplearn_dnc * learner);
+void deeplearn_dnc_free_usage(deeplearn_dnc * learner, int address,
+                              float weight);
 void deeplearn_dnc_update_read_heads(deeplearn_dnc * learner);
 void deeplearn_dnc_update_write_heads(deeplearn_dnc * learner);
 
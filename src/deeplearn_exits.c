@@ -0,0 +1,432 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_exits.h"
+
+/**
+ * @brief Creates classifier heads on the intermediate hidden layers of
+ *        a network, with small random weights
+ * @param exits Early exit heads
+ * @param net Backprop neural net object
+ * @param threshold Confidence at which evaluation stops
+ * @param random_seed Random number generator seed
+ * @returns zero on success
+ */
+int exits_init(deeplearn_exits * exits, bp * net, float threshold,
+               unsigned int * random_seed)
+{
+    int h, i, no_of_heads = net->HiddenLayers-1;
+    int no_of_outputs = net->NoOfOutputs;
+    size_t bytes;
+
+    memset((void*)exits, '\0', sizeof(deeplearn_exits));
+    if ((no_of_heads < 1) || (threshold <= 0)) {
+        return -1;
+    }
+
+    bytes = 2*deeplearn_arena_bytes(no_of_heads*sizeof(float*)) +
+        2*deeplearn_arena_bytes(no_of_outputs*sizeof(float)) +
+        deeplearn_arena_bytes((no_of_heads+1)*sizeof(unsigned int));
+    for (h = 0; h < no_of_heads; h++) {
+        bytes += deeplearn_arena_bytes(no_of_outputs*
+                                       net->layer[h+1].NoOfUnits*
+                                       sizeof(float)) +
+            deeplearn_arena_bytes(no_of_outputs*sizeof(float));
+    }
+    if (deeplearn_arena_init(&exits->arena, bytes) != 0) {
+        return -2;
+    }
+
+    exits->weights =
+        (float**)deeplearn_arena_alloc(&exits->arena,
+                                       no_of_heads*sizeof(float*));
+    exits->bias =
+        (float**)deeplearn_arena_alloc(&exits->arena,
+                                       no_of_heads*sizeof(float*));
+    exits->outputs =
+        (float*)deeplearn_arena_alloc(&exits->arena,
+                                      no_of_outputs*sizeof(float));
+    exits->targets =
+        (float*)deeplearn_arena_alloc(&exits->arena,
+                                      no_of_outputs*sizeof(float));
+    exits->exits =
+        (unsigned int*)deeplearn_arena_alloc(&exits->arena,
+                                             (no_of_heads+1)*
+                                             sizeof(unsigned int));
+    for (h = 0; h < no_of_heads; h++) {
+        int weights = no_of_outputs*net->layer[h+1].NoOfUnits;
+
+        exits->weights[h] =
+            (float*)deeplearn_arena_alloc(&exits->arena,
+                                          weights*sizeof(float));
+        exits->bias[h] =
+            (float*)deeplearn_arena_alloc(&exits->arena,
+                                          no_of_outputs*sizeof(float));
+        for (i = 0; i < weights; i++) {
+            exits->weights[h][i] = rand_initial_weight(random_seed);
+        }
+        for (i = 0; i < no_of_outputs; i++) {
+            exits->bias[h][i] = rand_initial_weight(random_seed);
+        }
+    }
+
+    exits->no_of_heads = no_of_heads;
+    exits->no_of_outputs = no_of_outputs;
+    exits->threshold = threshold;
+    exits->last_exit = net->HiddenLayers;
+    return 0;
+}
+
+/**
+ * @brief Deallocates the classifier heads
+ * @param exits Early exit heads
+ */
+void exits_free(deeplearn_exits * exits)
+{
+    deeplearn_arena_free(&exits->arena);
+    memset((void*)exits, '\0', sizeof(deeplearn_exits));
+}
+
+/**
+ * @brief Makes an independent copy of the classifier heads
+ * @param dest Early exit heads to be created
+ * @param source Early exit heads to be copied
+ * @returns zero on success
+ */
+int exits_clone(deeplearn_exits * dest, deeplearn_exits * source)
+{
+    deeplearn_arena * to = &dest->arena;
+    deeplearn_arena * from = &source->arena;
+
+    *dest = *source;
+    if (source->no_of_heads == 0) {
+        return 0;
+    }
+    if (deeplearn_arena_clone(to, from) != 0) {
+        memset((void*)dest, '\0', sizeof(deeplearn_exits));
+        return -1;
+    }
+
+    dest->weights = (float**)deeplearn_arena_relocate(to, from,
+                                                      source->weights);
+    dest->bias = (float**)deeplearn_arena_relocate(to, from, source->bias);
+    dest->outputs = (float*)deeplearn_arena_relocate(to, from,
+                                                     source->outputs);
+    dest->targets = (float*)deeplearn_arena_relocate(to, from,
+                                                     source->targets);
+    dest->exits = (unsigned int*)deeplearn_arena_relocate(to, from,
+                                                          source->exits);
+    for (int h = 0; h < source->no_of_heads; h++) {
+        dest->weights[h] =
+            (float*)deeplearn_arena_relocate(to, from, source->weights[h]);
+        dest->bias[h] =
+            (float*)deeplearn_arena_relocate(to, from, source->bias[h]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Saves the classifier heads, or only their number if there
+ *        are none
+ * @param fp File pointer
+ * @param exits Early exit heads
+ * @param net Backprop neural net object which the heads belong to
+ * @returns zero on success
+ */
+int exits_save(FILE * fp, deeplearn_exits * exits, bp * net)
+{
+    if (fwrite(&exits->no_of_heads, sizeof(int), 1, fp) == 0) {
+        return -1;
+    }
+    if (exits->no_of_heads == 0) {
+        return 0;
+    }
+    if (fwrite(&exits->threshold, sizeof(float), 1, fp) == 0) {
+        return -2;
+    }
+    for (int h = 0; h < exits->no_of_heads; h++) {
+        size_t weights = (size_t)exits->no_of_outputs*
+            net->layer[h+1].NoOfUnits;
+
+        if ((fwrite(exits->weights[h], sizeof(float), weights, fp) !=
+             weights) ||
+            (fwrite(exits->bias[h], sizeof(float), exits->no_of_outputs,
+                    fp) != (size_t)exits->no_of_outputs)) {
+            return -3;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Loads classifier heads saved with exits_save.  Any existing
+ *        heads are replaced.
+ * @param fp File pointer
+ * @param exits Early exit heads
+ * @param net Backprop neural net object which the heads belong to
+ * @param random_seed Random number generator seed
+ * @returns zero on success
+ */
+int exits_load(FILE * fp, deeplearn_exits * exits, bp * net,
+               unsigned int * random_seed)
+{
+    int no_of_heads = 0;
+    float threshold = 0;
+
+    exits_free(exits);
+    if (fread(&no_of_heads, sizeof(int), 1, fp) == 0) {
+        return -1;
+    }
+    if (no_of_heads == 0) {
+        return 0;
+    }
+    if ((no_of_heads != net->HiddenLayers-1) ||
+        (fread(&threshold, sizeof(float), 1, fp) == 0)) {
+        return -2;
+    }
+    if (exits_init(exits, net, threshold, random_seed) != 0) {
+        return -3;
+    }
+    for (int h = 0; h < no_of_heads; h++) {
+        size_t weights = (size_t)exits->no_of_outputs*
+            net->layer[h+1].NoOfUnits;
+
+        if ((fread(exits->weights[h], sizeof(float), weights, fp) !=
+             weights) ||
+            (fread(exits->bias[h], sizeof(float), exits->no_of_outputs,
+                   fp) != (size_t)exits->no_of_outputs)) {
+            exits_free(exits);
+            return -4;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the memory used by the classifier heads
+ * @param exits Early exit heads
+ * @param usage Returned memory footprint
+ */
+void exits_memory_usage(deeplearn_exits * exits, deeplearn_footprint * usage)
+{
+    size_t allocated = deeplearn_arena_allocated(&exits->arena);
+    size_t other = 2*exits->no_of_heads*sizeof(float*) +
+        (exits->no_of_heads+1)*sizeof(unsigned int);
+    size_t activations = 2*exits->no_of_outputs*sizeof(float);
+
+    deeplearn_footprint_clear(usage);
+    if (allocated == 0) return;
+    usage->activations = activations;
+    usage->other = other;
+    usage->weights = allocated - other - activations;
+}
+
+/**
+ * @brief Returns the confidence of a set of outputs within the range
+ *        0.25 to 0.75.  This is the margin between the two largest
+ *        outputs as a fraction of the range or, for a single output,
+ *        its distance from the middle of the range as a fraction of
+ *        half the range.
+ * @param outputs Output values
+ * @param no_of_outputs The number of outputs
+ * @returns Confidence, where one or more is certain
+ */
+float exits_confidence(const float * outputs, int no_of_outputs)
+{
+    float first = -1, second = -1;
+
+    if (no_of_outputs == 1) {
+        return fabs(outputs[0] - 0.5f) / 0.25f;
+    }
+    for (int i = 0; i < no_of_outputs; i++) {
+        if (outputs[i] > first) {
+            second = first;
+            first = outputs[i];
+        }
+        else if (outputs[i] > second) {
+            second = outputs[i];
+        }
+    }
+    return (first - second) / 0.5f;
+}
+
+/**
+ * @brief Evaluates a head, leaving the result in the outputs array
+ * @param exits Early exit heads
+ * @param head Index of the head, which is also the hidden layer it
+ *        is attached to
+ * @param in Values of the hidden layer
+ * @param no_of_inputs The number of units within the hidden layer
+ */
+static void exits_head_feed_forward(deeplearn_exits * exits, int head,
+                                    const float * in, int no_of_inputs)
+{
+    for (int i = 0; i < exits->no_of_outputs; i++) {
+        exits->outputs[i] = exits->bias[head][i] +
+            kernel_dot(&exits->weights[head][i*no_of_inputs], in,
+                       no_of_inputs);
+    }
+    kernel_af_vector(AF_LOGISTIC, exits->outputs, exits->no_of_outputs);
+}
+
+/**
+ * @brief Adjusts the weights of a head towards the given targets
+ * @param exits Early exit heads
+ * @param head Index of the head
+ * @param in Values of the hidden layer
+ * @param no_of_inputs The number of units within the hidden layer
+ * @param targets Desired outputs, with values of -1 or less not trained
+ * @param learning_rate Learning rate of the network
+ */
+static void exits_head_learn(deeplearn_exits * exits, int head,
+                             const float * in, int no_of_inputs,
+                             const float * targets, float learning_rate)
+{
+    float e = learning_rate / (1.0f + no_of_inputs);
+
+    exits_head_feed_forward(exits, head, in, no_of_inputs);
+    for (int i = 0; i < exits->no_of_outputs; i++) {
+        float gradient;
+
+        if (targets[i] <= -1) continue;
+        gradient = (targets[i] - exits->outputs[i]) *
+            kernel_af_derivative(AF_LOGISTIC, exits->outputs[i]);
+        kernel_axpy(&exits->weights[head][i*no_of_inputs], e*gradient,
+                    in, no_of_inputs);
+        exits->bias[head][i] += e*gradient;
+    }
+}
+
+/**
+ * @brief Trains each head on the current hidden layer values and
+ *        desired outputs of the network, such as after bp_update
+ * @param exits Early exit heads
+ * @param net Backprop neural net object
+ */
+void exits_learn(deeplearn_exits * exits, bp * net)
+{
+    bp_layer * outputs = &net->layer[net->HiddenLayers+1];
+
+    if (exits->no_of_heads == 0) return;
+
+    for (int i = 0; i < exits->no_of_outputs; i++) {
+        exits->targets[i] = outputs->units[i].desiredValue;
+    }
+    for (int h = 0; h < exits->no_of_heads; h++) {
+        bp_layer * layer = &net->layer[h+1];
+
+        exits_head_learn(exits, h, layer->values, layer->NoOfUnits,
+                         exits->targets, net->learningRate);
+    }
+}
+
+/**
+ * @brief Trains each head on the hidden layer values of every sample
+ *        within the last mini-batch, such as after bp_update_batch
+ * @param exits Early exit heads
+ * @param net Backprop neural net object
+ * @param targets Desired output values, one row per sample
+ * @param batch_size The number of samples within the batch
+ */
+void exits_learn_batch(deeplearn_exits * exits, bp * net,
+                       const float * targets, int batch_size)
+{
+    for (int h = 0; h < exits->no_of_heads; h++) {
+        bp_layer * layer = &net->layer[h+1];
+
+        if (layer->batch_capacity < batch_size) return;
+        for (int b = 0; b < batch_size; b++) {
+            exits_head_learn(exits, h,
+                             &layer->batch_values[b*layer->NoOfUnits],
+                             layer->NoOfUnits,
+                             &targets[b*exits->no_of_outputs],
+                             net->learningRate);
+        }
+    }
+}
+
+/**
+ * @brief Feeds the current inputs forward one hidden layer at a time,
+ *        stopping at the first head whose confidence reaches the
+ *        threshold.  The outputs of the network are then those of the
+ *        head, so that bp_get_output and classification work as usual.
+ * @param exits Early exit heads
+ * @param net Backprop neural net object
+ * @returns The hidden layer at which evaluation stopped, or the number
+ *          of hidden layers if the whole network was evaluated
+ */
+int exits_feed_forward(deeplearn_exits * exits, bp * net)
+{
+    int h, last = net->HiddenLayers+1;
+    bp_layer * outputs = &net->layer[last];
+
+    if (exits->no_of_heads == 0) {
+        bp_feed_forward(net);
+        return net->HiddenLayers;
+    }
+
+    bp_feed_forward_layers(net, 1);
+    for (h = 0; h < exits->no_of_heads; h++) {
+        bp_layer * layer = &net->layer[h+1];
+
+        if (h > 0) {
+            bp_feed_forward_layer(net, h+1);
+        }
+        exits_head_feed_forward(exits, h, layer->values, layer->NoOfUnits);
+        if (exits_confidence(exits->outputs, exits->no_of_outputs) >=
+            exits->threshold) {
+            for (int i = 0; i < outputs->NoOfUnits; i++) {
+                outputs->values[i] = exits->outputs[i];
+                outputs->units[i].value = exits->outputs[i];
+            }
+            exits->exits[h]++;
+            exits->last_exit = h;
+            return h;
+        }
+    }
+
+    /* the remaining hidden layers and the output layer */
+    for (h = exits->no_of_heads+1; h <= last; h++) {
+        bp_feed_forward_layer(net, h);
+    }
+    exits->exits[exits->no_of_heads]++;
+    exits->last_exit = net->HiddenLayers;
+    return net->HiddenLayers;
+}
+
+/**
+ * @brief Clears the counts of where samples exited
+ * @param exits Early exit heads
+ */
+void exits_reset(deeplearn_exits * exits)
+{
+    if (exits->no_of_heads == 0) return;
+    memset((void*)exits->exits, '\0',
+           (exits->no_of_heads+1)*sizeof(unsigned int));
+}
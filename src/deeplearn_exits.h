@@ -0,0 +1,96 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_EXITS_H
+#define DEEPLEARN_EXITS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "globals.h"
+#include "deeplearn_random.h"
+#include "deeplearn_arena.h"
+#include "deeplearn_footprint.h"
+#include "deeplearn_kernels.h"
+#include "backprop.h"
+
+/* Classifier heads on the intermediate hidden layers of a network.
+   Each head is a single logistic layer from the units of one hidden
+   layer to the outputs, trained alongside the output layer without
+   changing the network.  During inference the hidden layers are
+   evaluated in turn, stopping at the first head which is confident
+   enough, so that easy samples only need part of the network.
+   There is a head on every hidden layer except the last. */
+typedef struct {
+    int no_of_heads;
+    int no_of_outputs;
+
+    /* confidence at which evaluation stops.  This is the margin between
+       the two largest outputs of a head as a fraction of the output
+       range, or for a single output its distance from the middle of
+       the range as a fraction of half the range */
+    float threshold;
+
+    /* weights of each head, one row per output, and its biases */
+    float ** weights;
+    float ** bias;
+
+    /* outputs of the most recently evaluated head, and the desired
+       outputs while training */
+    float * outputs;
+    float * targets;
+
+    /* the number of samples which exited at each head, followed by
+       the number which needed the whole network */
+    unsigned int * exits;
+
+    /* hidden layer at which the last sample exited, or the number of
+       hidden layers if it needed the whole network */
+    int last_exit;
+
+    deeplearn_arena arena;
+} deeplearn_exits;
+
+int exits_init(deeplearn_exits * exits, bp * net, float threshold,
+               unsigned int * random_seed);
+void exits_free(deeplearn_exits * exits);
+int exits_clone(deeplearn_exits * dest, deeplearn_exits * source);
+int exits_save(FILE * fp, deeplearn_exits * exits, bp * net);
+int exits_load(FILE * fp, deeplearn_exits * exits, bp * net,
+               unsigned int * random_seed);
+void exits_memory_usage(deeplearn_exits * exits, deeplearn_footprint * usage);
+float exits_confidence(const float * outputs, int no_of_outputs);
+void exits_learn(deeplearn_exits * exits, bp * net);
+void exits_learn_batch(deeplearn_exits * exits, bp * net,
+                       const float * targets, int batch_size);
+int exits_feed_forward(deeplearn_exits * exits, bp * net);
+void exits_reset(deeplearn_exits * exits);
+
+#endif
@@ -29,47 +29,106 @@
 
 #include "deeplearn_features.h"
 
+/* Declares patch scanners for a patch radius and depth known at compile
+   time, so that the loop along each row of the patch can be unrolled.
+   Each row of a patch is contiguous within the inputs. */
+#define FEATURES_SCAN_KERNELS(RADIUS, DEPTH)                            \
+static void scan_img_patch_##RADIUS##_##DEPTH(unsigned char img[],     \
+                                              int img_width,           \
+                                              int tx, int ty,          \
+                                              float patch[])           \
+{                                                                       \
+    for (int y = 0; y < 2*(RADIUS); y++) {                              \
+        const unsigned char * row =                                     \
+            &img[(((ty+y)*img_width) + tx) * (DEPTH)];                  \
+        for (int i = 0; i < 2*(RADIUS)*(DEPTH); i++) {                  \
+            patch[i] = PIXEL_TO_FLOAT(row[i]);                          \
+        }                                                               \
+        patch += 2*(RADIUS)*(DEPTH);                                    \
+    }                                                                   \
+}                                                                       \
+static void scan_floats_patch_##RADIUS##_##DEPTH(float inputs_floats[], \
+                                                 int inputs_width,      \
+                                                 int tx, int ty,        \
+                                                 float patch[])         \
+{                                                                       \
+    for (int y = 0; y < 2*(RADIUS); y++) {                              \
+        const float * row =                                             \
+            &inputs_floats[(((ty+y)*inputs_width) + tx) * (DEPTH)];     \
+        for (int i = 0; i < 2*(RADIUS)*(DEPTH); i++) {                  \
+            patch[i] = row[i];                                          \
+        }                                                               \
+        patch += 2*(RADIUS)*(DEPTH);                                    \
+    }                                                                   \
+}
+
+#define FEATURES_SCAN_RADIUS(RADIUS) \
+    FEATURES_SCAN_KERNELS(RADIUS, 1) \
+    FEATURES_SCAN_KERNELS(RADIUS, 3)
+
+FEATURES_SCAN_RADIUS(1)
+FEATURES_SCAN_RADIUS(2)
+FEATURES_SCAN_RADIUS(3)
+FEATURES_SCAN_RADIUS(4)
+FEATURES_SCAN_RADIUS(5)
+FEATURES_SCAN_RADIUS(6)
+FEATURES_SCAN_RADIUS(7)
+FEATURES_SCAN_RADIUS(8)
+
+typedef void (*features_img_scanner)(unsigned char *, int, int, int, float *);
+typedef void (*features_floats_scanner)(float *, int, int, int, float *);
+
+/* specialised scanners indexed by patch radius - 1, for depths of
+   one and three */
+static const features_img_scanner
+features_img_scanners[FEATURES_SCAN_MAX_RADIUS][2] = {
+    { scan_img_patch_1_1, scan_img_patch_1_3 },
+    { scan_img_patch_2_1, scan_img_patch_2_3 },
+    { scan_img_patch_3_1, scan_img_patch_3_3 },
+    { scan_img_patch_4_1, scan_img_patch_4_3 },
+    { scan_img_patch_5_1, scan_img_patch_5_3 },
+    { scan_img_patch_6_1, scan_img_patch_6_3 },
+    { scan_img_patch_7_1, scan_img_patch_7_3 },
+    { scan_img_patch_8_1, scan_img_patch_8_3 }
+};
+static const features_floats_scanner
+features_floats_scanners[FEATURES_SCAN_MAX_RADIUS][2] = {
+    { scan_floats_patch_1_1, scan_floats_patch_1_3 },
+    { scan_floats_patch_2_1, scan_floats_patch_2_3 },
+    { scan_floats_patch_3_1, scan_floats_patch_3_3 },
+    { scan_floats_patch_4_1, scan_floats_patch_4_3 },
+    { scan_floats_patch_5_1, scan_floats_patch_5_3 },
+    { scan_floats_patch_6_1, scan_floats_patch_6_3 },
+    { scan_floats_patch_7_1, scan_floats_patch_7_3 },
+    { scan_floats_patch_8_1, scan_floats_patch_8_3 }
+};
+
 /**
- * @brief Scans an image patch and transfers the values to an autocoder
- * @param img image array
- * @param img_width Width of the image
- * @param img_depth Depth of the image, typically bytes per pixel
+ * @brief Returns the index of the specialised scanner for a patch
+ * @param depth Depth of the inputs
  * @param tx Top left coordinate of the patch
  * @param ty Top coordinate of the patch
  * @param bx Bottom right coordinate of the patch
  * @param by Bottom coordinate of the patch
- * @param feature_autocoder Autocoder object
- * @return zero on success
+ * @param radius Returned radius of the patch
+ * @return index for the depth within the scanner tables, or -1 if the
+ *         patch has no specialised scanner
  */
-static int scan_img_patch(unsigned char img[],
-                          int img_width, int img_depth,
-                          int tx, int ty, int bx, int by,
-                          ac * feature_autocoder)
+static int features_scanner_index(int depth,
+                                  int tx, int ty, int bx, int by,
+                                  int * radius)
 {
-    int index_feature_input = 0;
-    for (int y = ty; y < by; y++) {
-        for (int x = tx; x < bx; x++) {
-            int index_img =
-                ((y*img_width) + x) * img_depth;
-            for (int d = 0; d < img_depth; d++) {
-                /* convert from 8 bit to a neuron value */
-                autocoder_set_input(feature_autocoder,
-                                    index_feature_input++,
-                                    PIXEL_TO_FLOAT(img[index_img+d]));
-            }
-        }
-    }
-
-    /* check that the patch size is the same as the autocoder inputs */
-    if (index_feature_input != feature_autocoder->NoOfInputs) {
-        return -1;
-    }
-    return 0;
+    if (((bx - tx) != (by - ty)) || ((bx - tx) % 2 != 0)) return -1;
+    *radius = (bx - tx) / 2;
+    if ((*radius < 1) || (*radius > FEATURES_SCAN_MAX_RADIUS)) return -1;
+    if (depth == 1) return 0;
+    if (depth == 3) return 1;
+    return -1;
 }
 
 /**
- * @brief Create an image patch from autocoder hidden units.
- *        Note that the image array should initially be cleared
+ * @brief Scans an image patch and transfers the values to an autocoder.
+ *        Common patch geometries use specialised scanners.
  * @param img image array
  * @param img_width Width of the image
  * @param img_depth Depth of the image, typically bytes per pixel
@@ -77,36 +136,45 @@ static int scan_img_patch(unsigned char img[],
  * @param ty Top coordinate of the patch
  * @param bx Bottom right coordinate of the patch
  * @param by Bottom coordinate of the patch
- * @param feature_autocoder Autocoder object
+ * @param patch Array to store the patch values, typically the inputs
+ *        of an autocoder
+ * @param patch_size The expected number of values within the patch
  * @return zero on success
  */
-static int create_img_patch(float img[],
-                            int img_width, int img_depth,
-                            int tx, int ty, int bx, int by,
-                            ac * feature_autocoder)
+static int scan_img_patch(unsigned char img[],
+                          int img_width, int img_depth,
+                          int tx, int ty, int bx, int by,
+                          float patch[], int patch_size)
 {
-    int i;
-    float f;
-    
-    for (i = 0; i < feature_autocoder->NoOfHiddens; i++) {
-        f = autocoder_get_hidden(feature_autocoder, i);
-        for (int y = ty; y < by; y++) {
-            for (int x = tx; x < bx; x++) {
-                int index_img =
-                    ((y*img_width) + x) * img_depth;
-                for (int d = 0; d < img_depth; d++) {
-                    img[index_img+d] +=
-                        f * feature_autocoder->weights[index_img+d];                    
-                }
-            }
-        }       
+    int radius = 0;
+    int row_length = (bx - tx) * img_depth;
+    int index = features_scanner_index(img_depth, tx, ty, bx, by, &radius);
+
+    /* check that the patch size is the same as the autocoder inputs */
+    if ((by - ty) * row_length != patch_size) {
+        return -1;
+    }
+
+    if (index >= 0) {
+        features_img_scanners[radius-1][index](img, img_width,
+                                               tx, ty, patch);
+        return 0;
+    }
+
+    for (int y = ty; y < by; y++) {
+        const unsigned char * row = &img[((y*img_width) + tx) * img_depth];
+        for (int i = 0; i < row_length; i++) {
+            /* convert from 8 bit to a neuron value */
+            patch[i] = PIXEL_TO_FLOAT(row[i]);
+        }
+        patch += row_length;
     }
     return 0;
 }
 
 /**
  * @brief Scans a patch within a 2D array of floats and transfers the values
- *        to an autocoder
+ *        to an autocoder. Common patch geometries use specialised scanners.
  * @param inputs_floats inputs array
  * @param inputs_width Width of the floats array
  * @param inputs_depth Depth of the floats array
@@ -114,36 +182,41 @@ static int create_img_patch(float img[],
  * @param ty Top coordinate of the patch
  * @param bx Bottom right coordinate of the patch
  * @param by Bottom coordinate of the patch
- * @param feature_autocoder Autocoder object
+ * @param patch Array to store the patch values, typically the inputs
+ *        of an autocoder
+ * @param patch_size The expected number of values within the patch
  * @return zero on success
  */
 static int scan_floats_patch(float inputs_floats[],
                              int inputs_width, int inputs_depth,
                              int tx, int ty, int bx, int by,
-                             ac * feature_autocoder)
+                             float patch[], int patch_size)
 {
-    int index_feature_input = 0;
-    for (int y = ty; y < by; y++) {
-        for (int x = tx; x < bx; x++) {
-            int index_inputs =
-                ((y*inputs_width) + x) * inputs_depth;
-
-            /* depth typically corresponds to colour channels
-               in the initial layer, or feature responses in
-               subsequent layers */
-            for (int d = 0; d < inputs_depth; d++) {
-                /* set the inputs of the autocoder */
-                autocoder_set_input(feature_autocoder,
-                                    index_feature_input++,
-                                    inputs_floats[index_inputs+d]);
-            }
-        }
-    }
+    int radius = 0;
+    int row_length = (bx - tx) * inputs_depth;
+    int index = features_scanner_index(inputs_depth, tx, ty, bx, by, &radius);
 
-/* check that the patch size is the same as the autocoder inputs */
-    if (index_feature_input != feature_autocoder->NoOfInputs) {
+    /* check that the patch size is the same as the autocoder inputs */
+    if ((by - ty) * row_length != patch_size) {
         return -1;
     }
+
+    if (index >= 0) {
+        features_floats_scanners[radius-1][index](inputs_floats,
+                                                  inputs_width,
+                                                  tx, ty, patch);
+        return 0;
+    }
+
+    /* depth typically corresponds to colour channels in the initial
+       layer, or feature responses in subsequent layers, and each row
+       of the patch is contiguous for any depth */
+    for (int y = ty; y < by; y++) {
+        memcpy((void*)patch,
+               (void*)&inputs_floats[((y*inputs_width) + tx) * inputs_depth],
+               row_length*sizeof(float));
+        patch += row_length;
+    }
     return 0;
 }
 
@@ -185,6 +258,386 @@ int features_patch_coords(int x, int y,
     return 0;
 }
 
+/**
+ * @brief Scans a patch from either an image or an array of floats
+ * @param img image array, or NULL if scanning floats
+ * @param inputs_floats inputs array, or NULL if scanning an image
+ * @param width Width of the image or floats array
+ * @param depth Depth of the image or floats array
+ * @param tx Top left coordinate of the patch
+ * @param ty Top coordinate of the patch
+ * @param bx Bottom right coordinate of the patch
+ * @param by Bottom coordinate of the patch
+ * @param patch Array to store the patch values
+ * @param patch_size The expected number of values within the patch
+ * @return zero on success
+ */
+static int scan_patch(unsigned char img[], float inputs_floats[],
+                      int width, int depth,
+                      int tx, int ty, int bx, int by,
+                      float patch[], int patch_size)
+{
+    if (img) {
+        return scan_img_patch(img, width, depth,
+                              tx, ty, bx, by, patch, patch_size);
+    }
+    return scan_floats_patch(inputs_floats, width, depth,
+                             tx, ty, bx, by, patch, patch_size);
+}
+
+/**
+ * @brief Returns the number of threads which may evaluate patches
+ * @return maximum number of threads
+ */
+static int features_max_threads()
+{
+    return threads_count();
+}
+
+/**
+ * @brief Returns the index of the calling thread
+ * @return thread number
+ */
+static int features_thread_num()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Learns features from all patches as a single batch update,
+ *        with patches being scanned and evaluated in parallel.
+ *        This is used when the patch_batch flag of the autocoder is set.
+ * @param samples_across The number of units across in the second layer
+ * @param samples_down The number of units down in the second layer
+ * @param patch_radius The radius of the patch within the inputs
+ * @param width Width of the inputs
+ * @param height Height of the inputs
+ * @param depth Depth of the inputs
+ * @param img image array, or NULL if learning from floats
+ * @param inputs_floats inputs array, or NULL if learning from an image
+ * @param feature_autocoder An autocoder used for feature learning
+ * @param BPerror Returned total learning error
+ * @returns zero on success
+ */
+static int features_learn_patches(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int width, int height, int depth,
+                                  unsigned char img[],
+                                  float inputs_floats[],
+                                  ac * feature_autocoder,
+                                  float * BPerror)
+{
+    int no_of_patches = 0, retval = 0;
+    int patch_size = feature_autocoder->NoOfInputs;
+    int * coords;
+    float * patches;
+
+    coords = (int*)malloc(samples_across*samples_down*4*sizeof(int));
+    if (!coords) {
+        return -5;
+    }
+
+    /* the patches which lie within the inputs */
+    for (int fy = 0; fy < samples_down; fy++) {
+        for (int fx = 0; fx < samples_across; fx++) {
+            int * c = &coords[no_of_patches*4];
+            if (features_patch_coords(fx, fy,
+                                      samples_across, samples_down,
+                                      patch_radius, width, height,
+                                      &c[0], &c[1], &c[2], &c[3]) == 0) {
+                no_of_patches++;
+            }
+        }
+    }
+
+    if (no_of_patches == 0) {
+        free(coords);
+        return 0;
+    }
+
+    patches = (float*)malloc(no_of_patches*patch_size*sizeof(float));
+    if (!patches) {
+        free(coords);
+        return -5;
+    }
+
+#pragma omp parallel for num_threads(threads_count()) reduction(min:retval) if (no_of_patches*patch_size*feature_autocoder->NoOfHiddens >= AUTOCODER_PARALLEL_MIN_WEIGHTS)
+    for (int p = 0; p < no_of_patches; p++) {
+        int * c = &coords[p*4];
+        if (scan_patch(img, inputs_floats, width, depth,
+                       c[0], c[1], c[2], c[3],
+                       &patches[p*patch_size], patch_size) != 0) {
+            retval = -4;
+        }
+    }
+
+    if (retval == 0) {
+        if (autocoder_update_batch(feature_autocoder,
+                                   patches, no_of_patches) != 0) {
+            retval = -5;
+        }
+        else {
+            *BPerror = feature_autocoder->BPerror * no_of_patches;
+        }
+    }
+
+    free(patches);
+    free(coords);
+    return retval;
+}
+
+/**
+ * @brief Convolves the inputs with learned features, evaluating patches
+ *        in parallel with each thread having its own patch buffer.
+ *        No dropouts or noise are applied, so the result is the same
+ *        as for serial evaluation.
+ * @param samples_across The number of units across in the output array
+ * @param samples_down The number of units down in the output array
+ * @param patch_radius The radius of the patch within the inputs
+ * @param width Width of the inputs
+ * @param height Height of the inputs
+ * @param depth Depth of the inputs
+ * @param img image array, or NULL if convolving floats
+ * @param inputs_floats inputs array, or NULL if convolving an image
+ * @param layer Output array of feature responses
+ * @param feature_autocoder An autocoder containing learned features
+ * @returns zero on success
+ */
+static int features_conv_patches(int samples_across,
+                                 int samples_down,
+                                 int patch_radius,
+                                 int width, int height, int depth,
+                                 unsigned char img[],
+                                 float inputs_floats[],
+                                 float layer[],
+                                 ac * feature_autocoder)
+{
+    int retval = 0;
+    int patch_size = feature_autocoder->NoOfInputs;
+    int no_of_learned_features = feature_autocoder->NoOfHiddens;
+    int no_of_patches = samples_across*samples_down;
+    float * patches;
+
+    patches = (float*)malloc(features_max_threads()*patch_size*sizeof(float));
+    if (!patches) {
+        return -5;
+    }
+
+#pragma omp parallel for num_threads(threads_count()) reduction(min:retval) if (no_of_patches*patch_size*no_of_learned_features >= AUTOCODER_PARALLEL_MIN_WEIGHTS)
+    for (int p = 0; p < no_of_patches; p++) {
+        int fx = p % samples_across;
+        int fy = p / samples_across;
+        int tx=0, ty=0, bx=0, by=0;
+        float * patch = &patches[features_thread_num()*patch_size];
+        float * encoded = &layer[p*no_of_learned_features];
+
+        if (features_patch_coords(fx, fy,
+                                  samples_across, samples_down,
+                                  patch_radius, width, height,
+                                  &tx, &ty, &bx, &by) != 0) {
+            memset((void*)encoded, '\0', no_of_learned_features*sizeof(float));
+            continue;
+        }
+
+        if (scan_patch(img, inputs_floats, width, depth,
+                       tx, ty, bx, by, patch, patch_size) != 0) {
+            retval = -4;
+            continue;
+        }
+
+        autocoder_encode_inputs(feature_autocoder, patch, encoded);
+    }
+
+    free(patches);
+    return retval;
+}
+
+/**
+ * @brief Multiplies patches by feature weights using eight bit integer
+ *        dot products.  The weights of each feature are quantised with
+ *        their own scale and each patch is quantised using its own
+ *        range, so no calibration is needed.
+ * @param no_of_patches The number of patches
+ * @param no_of_features The number of learned features
+ * @param patch_size The number of values within each patch
+ * @param patches Patches, one row per patch
+ * @param weights Feature weights, one row per feature
+ * @param layer Returned weighted sums, one row per patch
+ * @param parallel Non-zero if patches may be evaluated in parallel
+ * @returns zero on success
+ */
+static int features_gemm_int8(int no_of_patches, int no_of_features,
+                              int patch_size, float patches[],
+                              float weights[], float layer[],
+                              int parallel)
+{
+    int8_t * weights_int8;
+    uint8_t * patches_int8;
+    float * scale;
+    int32_t * row_sum;
+
+    weights_int8 =
+        (int8_t*)malloc(no_of_features*patch_size*sizeof(int8_t));
+    patches_int8 =
+        (uint8_t*)malloc(no_of_patches*patch_size*sizeof(uint8_t));
+    scale = (float*)malloc(no_of_features*sizeof(float));
+    row_sum = (int32_t*)malloc(no_of_features*sizeof(int32_t));
+    if ((!weights_int8) || (!patches_int8) || (!scale) || (!row_sum)) {
+        free(weights_int8);
+        free(patches_int8);
+        free(scale);
+        free(row_sum);
+        return -5;
+    }
+
+    for (int h = 0; h < no_of_features; h++) {
+        float * w = &weights[h*patch_size];
+        float magnitude = 0;
+        for (int i = 0; i < patch_size; i++) {
+            if (fabs(w[i]) > magnitude) magnitude = fabs(w[i]);
+        }
+        scale[h] = (magnitude > 0) ? magnitude / 127.0f : 1;
+        row_sum[h] = kernel_quantise_s8(w, &weights_int8[h*patch_size],
+                                        patch_size, scale[h]);
+    }
+
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
+    for (int p = 0; p < no_of_patches; p++) {
+        float * patch = &patches[p*patch_size];
+        uint8_t * patch_int8 = &patches_int8[p*patch_size];
+        float * encoded = &layer[p*no_of_features];
+        float minimum = 0, maximum = 0, patch_scale;
+        int zero;
+
+        for (int i = 0; i < patch_size; i++) {
+            if (patch[i] < minimum) minimum = patch[i];
+            if (patch[i] > maximum) maximum = patch[i];
+        }
+        kernel_quantise_range(minimum, maximum, &patch_scale, &zero);
+        kernel_quantise_u8(patch, patch_int8, patch_size, patch_scale, zero);
+        for (int h = 0; h < no_of_features; h++) {
+            encoded[h] = patch_scale*scale[h]*
+                (float)(kernel_dot_u8i8(patch_int8,
+                                        &weights_int8[h*patch_size],
+                                        patch_size) - zero*row_sum[h]);
+        }
+    }
+
+    free(weights_int8);
+    free(patches_int8);
+    free(scale);
+    free(row_sum);
+    return 0;
+}
+
+/**
+ * @brief Convolves the inputs with learned features by laying out every
+ *        patch as a row of one matrix (im2col) and then computing all
+ *        feature responses with a single matrix multiply.
+ *        No dropouts or noise are applied.
+ * @param samples_across The number of units across in the output array
+ * @param samples_down The number of units down in the output array
+ * @param patch_radius The radius of the patch within the inputs
+ * @param width Width of the inputs
+ * @param height Height of the inputs
+ * @param depth Depth of the inputs
+ * @param img image array, or NULL if convolving floats
+ * @param inputs_floats inputs array, or NULL if convolving an image
+ * @param layer Output array of feature responses
+ * @param feature_autocoder An autocoder containing learned features
+ * @param precision KERNEL_FP32, or KERNEL_INT8 for eight bit dot products
+ * @returns zero on success
+ */
+static int features_conv_gemm(int samples_across,
+                              int samples_down,
+                              int patch_radius,
+                              int width, int height, int depth,
+                              unsigned char img[],
+                              float inputs_floats[],
+                              float layer[],
+                              ac * feature_autocoder,
+                              int precision)
+{
+    int retval = 0;
+    int patch_size = feature_autocoder->NoOfInputs;
+    int no_of_learned_features = feature_autocoder->NoOfHiddens;
+    int no_of_patches = samples_across*samples_down;
+    int parallel = (no_of_patches*patch_size >= AUTOCODER_PARALLEL_MIN_WEIGHTS);
+    unsigned char * valid;
+    float * patches;
+
+    patches = (float*)malloc(no_of_patches*patch_size*sizeof(float));
+    if (!patches) {
+        return -5;
+    }
+    valid = (unsigned char*)malloc(no_of_patches*sizeof(unsigned char));
+    if (!valid) {
+        free(patches);
+        return -5;
+    }
+
+    /* one row for each patch */
+#pragma omp parallel for num_threads(threads_count()) reduction(min:retval) if (parallel)
+    for (int p = 0; p < no_of_patches; p++) {
+        int tx=0, ty=0, bx=0, by=0;
+        float * patch = &patches[p*patch_size];
+
+        valid[p] = 0;
+        if (features_patch_coords(p % samples_across, p / samples_across,
+                                  samples_across, samples_down,
+                                  patch_radius, width, height,
+                                  &tx, &ty, &bx, &by) != 0) {
+            memset((void*)patch, '\0', patch_size*sizeof(float));
+            continue;
+        }
+        if (scan_patch(img, inputs_floats, width, depth,
+                       tx, ty, bx, by, patch, patch_size) != 0) {
+            retval = -4;
+            continue;
+        }
+        valid[p] = 1;
+    }
+
+    if ((retval == 0) && (precision == KERNEL_INT8)) {
+        retval = features_gemm_int8(no_of_patches, no_of_learned_features,
+                                    patch_size, patches,
+                                    feature_autocoder->weights, layer,
+                                    parallel);
+    }
+    else if (retval == 0) {
+        /* weighted sums for every patch and feature */
+        kernel_gemm_nt(no_of_patches, no_of_learned_features, patch_size,
+                       patches, feature_autocoder->weights, layer);
+    }
+
+    if (retval == 0) {
+        /* add biases and apply the activation function */
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
+        for (int p = 0; p < no_of_patches; p++) {
+            float * encoded = &layer[p*no_of_learned_features];
+            if (valid[p] == 0) {
+                memset((void*)encoded, '\0',
+                       no_of_learned_features*sizeof(float));
+                continue;
+            }
+            for (int h = 0; h < no_of_learned_features; h++) {
+                encoded[h] += feature_autocoder->bias[h];
+            }
+            kernel_af_vector(feature_autocoder->activation, encoded,
+                             no_of_learned_features);
+        }
+    }
+
+    free(valid);
+    free(patches);
+    return retval;
+}
+
 /**
  * @brief Learn a feature set between an input image and a neuron layer
  * @param samples_across The number of units across in the second layer
@@ -229,6 +682,18 @@ int features_learn_from_img(int samples_across,
         return -2;
     }
 
+    if (feature_autocoder->patch_batch != 0) {
+        if (features_learn_patches(samples_across, samples_down,
+                                   patch_radius,
+                                   img_width, img_height, img_depth,
+                                   img, NULL,
+                                   feature_autocoder, BPerror) != 0) {
+            return -4;
+        }
+        *BPerror = *BPerror / (samples_across*samples_down);
+        return 0;
+    }
+
     /* for each patch */
     for (int fy = 0; fy < samples_down; fy++) {
         for (int fx = 0; fx < samples_across; fx++) {
@@ -246,7 +711,8 @@ int features_learn_from_img(int samples_across,
             /* scan the patch into the feature autocoder inputs */
             if (scan_img_patch(img, img_width, img_depth,
                                tx, ty, bx, by,
-                               feature_autocoder) != 0) {
+                               feature_autocoder->inputs,
+                               feature_autocoder->NoOfInputs) != 0) {
                 return -4;
             }
 
@@ -303,6 +769,18 @@ int features_learn_from_flt(int samples_across,
         return -2;
     }
 
+    if (feature_autocoder->patch_batch != 0) {
+        if (features_learn_patches(samples_across, samples_down,
+                                   patch_radius,
+                                   inputs_width, inputs_height, inputs_depth,
+                                   NULL, inputs_floats,
+                                   feature_autocoder, BPerror) != 0) {
+            return -4;
+        }
+        *BPerror = *BPerror / (samples_across*samples_down);
+        return 0;
+    }
+
     /* for each patch */
     for (int fy = 0; fy < samples_down; fy++) {
         for (int fx = 0; fx < samples_across; fx++) {
@@ -321,7 +799,8 @@ int features_learn_from_flt(int samples_across,
             if (scan_floats_patch(inputs_floats,
                                   inputs_width, inputs_depth,
                                   tx, ty, bx, by,
-                                  feature_autocoder) != 0) {
+                                  feature_autocoder->inputs,
+                                  feature_autocoder->NoOfInputs) != 0) {
                 return -4;
             }
 
@@ -393,7 +872,8 @@ int features_conv_img_to_neurons(int samples_across,
             if (scan_img_patch(img,
                                img_width, img_depth,
                                tx, ty, bx, by,
-                               feature_autocoder) != 0) {
+                               feature_autocoder->inputs,
+                               feature_autocoder->NoOfInputs) != 0) {
                 return -4;
             }
 
@@ -456,6 +936,15 @@ int features_conv_img_to_flt(int samples_across,
         return -2;
     }
 
+    /* without dropouts or noise each patch may be encoded independently */
+    if ((use_dropouts == 0) && (feature_autocoder->noise <= 0)) {
+        return features_conv_patches(samples_across, samples_down,
+                                     patch_radius,
+                                     img_width, img_height, img_depth,
+                                     img, NULL, layer0,
+                                     feature_autocoder);
+    }
+
     /* for each input image sample */
     for (int fy = 0; fy < samples_down; fy++) {
         for (int fx = 0; fx < samples_across; fx++) {
@@ -482,7 +971,8 @@ int features_conv_img_to_flt(int samples_across,
                feature responses */
             if (scan_img_patch(img, img_width, img_depth,
                                tx, ty, bx, by,
-                               feature_autocoder) != 0) {
+                               feature_autocoder->inputs,
+                               feature_autocoder->NoOfInputs) != 0) {
                 return -4;
             }
 
@@ -494,9 +984,37 @@ int features_conv_img_to_flt(int samples_across,
     return 0;
 }
 
+/**
+ * @brief Returns the range of patches along one axis which lie entirely
+ *        within the input layer, as positioned by features_patch_coords
+ * @param samples Number of samples along the axis
+ * @param patch_radius The radius of the patch within the input layer
+ * @param size Size of the input layer along the axis
+ * @param first Returned first sample whose patch lies within the layer
+ * @param last Returned sample after the last one
+ */
+static void features_valid_samples(int samples, int patch_radius, int size,
+                                   int * first, int * last)
+{
+    int s;
+
+    for (s = 0; s < samples; s++) {
+        if (s * size / samples - patch_radius >= 0) break;
+    }
+    *first = s;
+    for (; s < samples; s++) {
+        if (s * size / samples + patch_radius >= size) break;
+    }
+    *last = s;
+}
+
 /**
  * @brief Deconvolve a float image with learned features and output
- *        the results to an array of floats
+ *        the results to an array of floats.  Each value of the image is
+ *        the average reconstruction of the patches which overlap it,
+ *        with each patch being the learned features weighted by their
+ *        responses.  Rows of the image are gathered independently, so
+ *        they are reconstructed in parallel.
  * @param samples_across The number of units across in the array of floats
  *        (sampling grid resolution)
  * @param samples_down The number of units down in the array of floats
@@ -512,19 +1030,26 @@ int features_conv_img_to_flt(int samples_across,
  * @returns zero on success
  */
 int features_deconv_flt_to_flt(int samples_across,
-							   int samples_down,
-							   int patch_radius,
-							   int img_width,
-							   int img_height,
-							   int img_depth,
-							   float img[],
-							   int layer_units,
-							   float layer[],
-							   ac * feature_autocoder)
-{	
+                               int samples_down,
+                               int patch_radius,
+                               int img_width,
+                               int img_height,
+                               int img_depth,
+                               float img[],
+                               int layer_units,
+                               float layer[],
+                               ac * feature_autocoder)
+{
     int no_of_learned_features = feature_autocoder->NoOfHiddens;
+    int patch_values = patch_radius*2*img_depth;
+    int first_x, last_x, first_y, last_y, y;
+
+    if (samples_across * samples_down * no_of_learned_features !=
+        layer_units) {
+        /* across*down doesn't equal the layer units */
+        return -1;
+    }
 
-    
     if (feature_autocoder->NoOfInputs !=
         patch_radius*patch_radius*4*img_depth) {
         /* the patch size doesn't match the feature
@@ -532,46 +1057,62 @@ int features_deconv_flt_to_flt(int samples_across,
         return -2;
     }
 
-    /* clear the original image */
-    memset((void*)img, '\0', img_width*img_height*img_depth*sizeof(float));
-    
-    /* for each input image sample */
-    for (int fy = 0; fy < samples_down; fy++) {
-        for (int fx = 0; fx < samples_across; fx++) {   
-            /* starting position in the first layer,
-               where the depth is the number of encoded features */
-            int index_layer =
-                (fy * samples_across + fx) *
-                no_of_learned_features;
-
-            /* coordinates of the patch in the input image */
-            int tx=0, ty=0, bx=0, by=0;
-            if (features_patch_coords(fx, fy,
-                                      samples_across, samples_down,
-                                      patch_radius,
-                                      img_width, img_height,
-                                      &tx, &ty, &bx, &by) != 0) {
-                /* set the hidden unit values from the previous player */
-                for (int f = 0; f < no_of_learned_features; f++) {
-                    autocoder_set_hidden(feature_autocoder, f,
-                                         layer[index_layer+f]);
+    features_valid_samples(samples_across, patch_radius, img_width,
+                           &first_x, &last_x);
+    features_valid_samples(samples_down, patch_radius, img_height,
+                           &first_y, &last_y);
+
+#pragma omp parallel for num_threads(threads_count()) if (samples_across*samples_down*no_of_learned_features*feature_autocoder->NoOfInputs >= AUTOCODER_PARALLEL_MIN_WEIGHTS)
+    for (y = 0; y < img_height; y++) {
+        float * row = &img[y*img_width*img_depth];
+        int rows_overlapping = 0;
+
+        memset((void*)row, '\0', img_width*img_depth*sizeof(float));
+
+        for (int fy = first_y; fy < last_y; fy++) {
+            int ty = fy * img_height / samples_down - patch_radius;
+
+            if ((y < ty) || (y >= ty + patch_radius*2)) continue;
+            rows_overlapping++;
+
+            /* the row of each patch which overlaps this image row */
+            int patch_row = (y - ty)*patch_values;
+            for (int fx = first_x; fx < last_x; fx++) {
+                int tx = fx * img_width / samples_across - patch_radius;
+                float * response =
+                    &layer[(fy*samples_across + fx)*no_of_learned_features];
+
+                for (int h = 0; h < no_of_learned_features; h++) {
+                    if (response[h] == 0) continue;
+                    kernel_axpy(&row[tx*img_depth], response[h],
+                                &feature_autocoder->weights[h*feature_autocoder->NoOfInputs +
+                                                            patch_row],
+                                patch_values);
                 }
-                continue;
             }
+        }
+        if (rows_overlapping == 0) continue;
 
-            /* create the patch from the autocoder hidden units */
-            if (create_img_patch(img, img_width, img_depth,
-                                 tx, ty, bx, by,
-                                 feature_autocoder) != 0) {
-                return -4;
+        /* average over the overlapping patches */
+        for (int x = 0; x < img_width; x++) {
+            int overlapping = 0;
+
+            for (int fx = first_x; fx < last_x; fx++) {
+                int tx = fx * img_width / samples_across - patch_radius;
+                if ((x >= tx) && (x < tx + patch_radius*2)) overlapping++;
+            }
+            if (overlapping == 0) continue;
+
+            float scale = 1.0f / (overlapping*rows_overlapping);
+            for (int d = 0; d < img_depth; d++) {
+                row[x*img_depth + d] *= scale;
             }
         }
     }
-    
+
     return 0;
 }
 
-
 /**
  * @brief Deconvolve an image with learned features and output
  *        the results to an array of floats
@@ -613,10 +1154,9 @@ int features_deconv_img_to_flt(int samples_across,
     /* create a temporary floats image */
     float * deconv_img =
         (float*)malloc(img_width*img_height*img_depth*sizeof(float));
-    memset((void*)deconv_img, '\0', img_width*img_height*img_depth*sizeof(float));
-
-    /* clear the original image */
-    memset((void*)img, '\0', img_width*img_height*img_depth*sizeof(unsigned char));
+    if (!deconv_img) {
+        return -3;
+    }
 
     retval =
         features_deconv_flt_to_flt(samples_across,
@@ -633,14 +1173,18 @@ int features_deconv_img_to_flt(int samples_across,
         return retval;
     }
 
+    /* the inverse of PIXEL_TO_FLOAT */
     for (i = 0; i < img_width*img_height*img_depth; i++) {
-        if ((deconv_img[i] > 0) && (deconv_img[i] <= 255)) {
-            img[i] = (unsigned char)deconv_img[i];
+        float pixel = (deconv_img[i] - 0.25f)*2*255.0f;
+
+        if (pixel <= 0) {
+            img[i] = 0;
+        }
+        else if (pixel >= 255) {
+            img[i] = 255;
         }
         else {
-            if (deconv_img[i] > 255) {
-                img[i] = 255;
-            }           
+            img[i] = (unsigned char)pixel;
         }
     }
     
@@ -690,6 +1234,16 @@ int features_conv_flt_to_flt(int samples_across,
         return -2;
     }
 
+    /* without dropouts or noise each patch may be encoded independently */
+    if ((use_dropouts == 0) && (feature_autocoder->noise <= 0)) {
+        return features_conv_patches(samples_across, samples_down,
+                                     patch_radius,
+                                     floats_width, floats_height,
+                                     floats_depth,
+                                     NULL, layer0, layer1,
+                                     feature_autocoder);
+    }
+
     for (int fy = 0; fy < samples_down; fy++) {
         for (int fx = 0; fx < samples_across; fx++) {
             int index_layer1 =
@@ -710,7 +1264,8 @@ int features_conv_flt_to_flt(int samples_across,
             if (scan_floats_patch(layer0,
                                   floats_width, floats_depth,
                                   tx, ty, bx, by,
-                                  feature_autocoder) != 0) {
+                                  feature_autocoder->inputs,
+                                  feature_autocoder->NoOfInputs) != 0) {
                 return -4;
             }
 
@@ -721,6 +1276,186 @@ int features_conv_flt_to_flt(int samples_across,
     return 0;
 }
 
+/**
+ * @brief Convolve an image with learned features and output the results
+ *        to an array of floats, using a single matrix multiply for all
+ *        patches. Dropouts and noise are not applied.
+ * @param samples_across The number of units across in the array of floats
+ *        (sampling grid resolution)
+ * @param samples_down The number of units down in the array of floats
+ *        (sampling grid resolution)
+ * @param patch_radius The radius of the patch within the float array
+ * @param img_width Width of the image
+ * @param img_height Height of the image
+ * @param img_depth Depth of the image (mono=1, RGB=3)
+ * @param img Image buffer
+ * @param layer0_units Number of units in the float array
+ * @param layer0 float array
+ * @param feature_autocoder An autocoder containing learned features
+ * @returns zero on success
+ */
+int features_conv_img_to_flt_gemm(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int img_width,
+                                  int img_height,
+                                  int img_depth,
+                                  unsigned char img[],
+                                  int layer0_units,
+                                  float layer0[],
+                                  ac * feature_autocoder)
+{
+    if (samples_across * samples_down * feature_autocoder->NoOfHiddens !=
+        layer0_units) {
+        /* across*down doesn't equal the second layer units */
+        return -1;
+    }
+
+    if (feature_autocoder->NoOfInputs !=
+        patch_radius*patch_radius*4*img_depth) {
+        /* the patch size doesn't match the feature
+           learner inputs */
+        return -2;
+    }
+
+    return features_conv_gemm(samples_across, samples_down, patch_radius,
+                              img_width, img_height, img_depth,
+                              img, NULL, layer0, feature_autocoder,
+                              KERNEL_FP32);
+}
+
+/**
+ * @brief Convolve an image with learned features and output the results
+ *        to an array of floats, using eight bit integer dot products.
+ *        Dropouts and noise are not applied.
+ * @param samples_across The number of units across in the array of floats
+ *        (sampling grid resolution)
+ * @param samples_down The number of units down in the array of floats
+ *        (sampling grid resolution)
+ * @param patch_radius The radius of the patch within the float array
+ * @param img_width Width of the image
+ * @param img_height Height of the image
+ * @param img_depth Depth of the image (mono=1, RGB=3)
+ * @param img Image buffer
+ * @param layer0_units Number of units in the float array
+ * @param layer0 float array
+ * @param feature_autocoder An autocoder containing learned features
+ * @returns zero on success
+ */
+int features_conv_img_to_flt_int8(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int img_width,
+                                  int img_height,
+                                  int img_depth,
+                                  unsigned char img[],
+                                  int layer0_units,
+                                  float layer0[],
+                                  ac * feature_autocoder)
+{
+    if (samples_across * samples_down * feature_autocoder->NoOfHiddens !=
+        layer0_units) {
+        return -1;
+    }
+
+    if (feature_autocoder->NoOfInputs !=
+        patch_radius*patch_radius*4*img_depth) {
+        return -2;
+    }
+
+    return features_conv_gemm(samples_across, samples_down, patch_radius,
+                              img_width, img_height, img_depth,
+                              img, NULL, layer0, feature_autocoder,
+                              KERNEL_INT8);
+}
+
+/**
+ * @brief Convolve a first array of floats to a second one, using a single
+ *        matrix multiply for all patches. Dropouts and noise are not applied.
+ * @param samples_across The number of units across in the second array of floats (sampling grid resolution)
+ * @param samples_down The number of units down in the second array of floats (sampling grid resolution)
+ * @param patch_radius The radius of the patch within the first float array
+ * @param floats_width Width of the image
+ * @param floats_height Height of the image
+ * @param floats_depth Depth of the image (mono=1, RGB=3)
+ * @param layer0 First array of floats
+ * @param layer1_units Number of units in the second float array
+ * @param layer1 Second float array
+ * @param feature_autocoder An autocoder containing learned features
+ * @returns zero on success
+ */
+int features_conv_flt_to_flt_gemm(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int floats_width,
+                                  int floats_height,
+                                  int floats_depth,
+                                  float layer0[],
+                                  int layer1_units,
+                                  float layer1[],
+                                  ac * feature_autocoder)
+{
+    if (samples_across * samples_down * feature_autocoder->NoOfHiddens !=
+        layer1_units) {
+        /* across*down doesn't equal the second layer units */
+        return -1;
+    }
+
+    if (feature_autocoder->NoOfInputs !=
+        patch_radius*patch_radius*4*floats_depth) {
+        /* the patch size doesn't match the feature
+           learner inputs */
+        return -2;
+    }
+
+    return features_conv_gemm(samples_across, samples_down, patch_radius,
+                              floats_width, floats_height, floats_depth,
+                              NULL, layer0, layer1, feature_autocoder,
+                              KERNEL_FP32);
+}
+
+/**
+ * @brief Convolve a first array of floats to a second one, using eight
+ *        bit integer dot products. Dropouts and noise are not applied.
+ * @param samples_across The number of units across in the second array of floats (sampling grid resolution)
+ * @param samples_down The number of units down in the second array of floats (sampling grid resolution)
+ * @param patch_radius The radius of the patch within the first float array
+ * @param floats_width Width of the image
+ * @param floats_height Height of the image
+ * @param floats_depth Depth of the image (mono=1, RGB=3)
+ * @param layer0 First array of floats
+ * @param layer1_units Number of units in the second float array
+ * @param layer1 Second float array
+ * @param feature_autocoder An autocoder containing learned features
+ * @returns zero on success
+ */
+int features_conv_flt_to_flt_int8(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int floats_width,
+                                  int floats_height,
+                                  int floats_depth,
+                                  float layer0[],
+                                  int layer1_units,
+                                  float layer1[],
+                                  ac * feature_autocoder)
+{
+    if (samples_across * samples_down * feature_autocoder->NoOfHiddens !=
+        layer1_units) {
+        return -1;
+    }
+
+    if (feature_autocoder->NoOfInputs !=
+        patch_radius*patch_radius*4*floats_depth) {
+        return -2;
+    }
+
+    return features_conv_gemm(samples_across, samples_down, patch_radius,
+                              floats_width, floats_height, floats_depth,
+                              NULL, layer0, layer1, feature_autocoder,
+                              KERNEL_INT8);
+}
+
 /**
  * @brief Convolve an array of floats to the input layer of a neural net
  * @param samples_across The number of units across in the layer of neurons
@@ -777,7 +1512,8 @@ int features_conv_floats_to_neurons(int samples_across,
             if (scan_floats_patch(layer0,
                                   floats_width, floats_depth,
                                   tx, ty, bx, by,
-                                  feature_autocoder) != 0) {
+                                  feature_autocoder->inputs,
+                                  feature_autocoder->NoOfInputs) != 0) {
                 return -4;
             }
 
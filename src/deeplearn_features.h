@@ -41,6 +41,9 @@
 #include "backprop.h"
 #include "autocoder.h"
 
+/* largest patch radius with specialised patch scanners */
+#define FEATURES_SCAN_MAX_RADIUS 8
+
 /* learning of features */
 int features_patch_coords(int x, int y,
                           int samples_across,
@@ -106,6 +109,50 @@ int features_conv_flt_to_flt(int samples_across,
                              ac * feature_autocoder,
                              unsigned char use_dropouts);
 
+int features_conv_img_to_flt_gemm(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int img_width,
+                                  int img_height,
+                                  int img_depth,
+                                  unsigned char img[],
+                                  int layer0_units,
+                                  float layer0[],
+                                  ac * feature_autocoder);
+
+int features_conv_flt_to_flt_gemm(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int floats_width,
+                                  int floats_height,
+                                  int floats_depth,
+                                  float layer0[],
+                                  int layer1_units,
+                                  float layer1[],
+                                  ac * feature_autocoder);
+
+int features_conv_img_to_flt_int8(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int img_width,
+                                  int img_height,
+                                  int img_depth,
+                                  unsigned char img[],
+                                  int layer0_units,
+                                  float layer0[],
+                                  ac * feature_autocoder);
+
+int features_conv_flt_to_flt_int8(int samples_across,
+                                  int samples_down,
+                                  int patch_radius,
+                                  int floats_width,
+                                  int floats_height,
+                                  int floats_depth,
+                                  float layer0[],
+                                  int layer1_units,
+                                  float layer1[],
+                                  ac * feature_autocoder);
+
 int features_conv_floats_to_neurons(int samples_across,
                                     int samples_down,
                                     int patch_radius,
@@ -0,0 +1,93 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_footprint.h"
+
+/**
+ * @brief Sets every component of a memory footprint to zero
+ * @param usage Memory footprint
+ */
+void deeplearn_footprint_clear(deeplearn_footprint * usage)
+{
+    usage->weights = 0;
+    usage->optimiser = 0;
+    usage->activations = 0;
+    usage->datasets = 0;
+    usage->history = 0;
+    usage->other = 0;
+}
+
+/**
+ * @brief Adds the memory footprint of a part of an object to the
+ *        footprint of the whole
+ * @param usage Memory footprint which is increased
+ * @param part Memory footprint of the part
+ */
+void deeplearn_footprint_add(deeplearn_footprint * usage,
+                             deeplearn_footprint * part)
+{
+    usage->weights += part->weights;
+    usage->optimiser += part->optimiser;
+    usage->activations += part->activations;
+    usage->datasets += part->datasets;
+    usage->history += part->history;
+    usage->other += part->other;
+}
+
+/**
+ * @brief Returns the total number of bytes within a memory footprint
+ * @param usage Memory footprint
+ * @returns Total bytes
+ */
+size_t deeplearn_footprint_total(deeplearn_footprint * usage)
+{
+    return usage->weights + usage->optimiser + usage->activations +
+        usage->datasets + usage->history + usage->other;
+}
+
+/**
+ * @brief Prints a memory footprint in kilobytes, one component per line
+ * @param fp File to print to, such as stdout
+ * @param usage Memory footprint
+ * @returns zero on success
+ */
+int deeplearn_footprint_print(FILE * fp, deeplearn_footprint * usage)
+{
+    if (fp == NULL) return -1;
+
+    fprintf(fp, "Weights:     %10.1f KB\n", usage->weights/1024.0);
+    fprintf(fp, "Optimiser:   %10.1f KB\n", usage->optimiser/1024.0);
+    fprintf(fp, "Activations: %10.1f KB\n", usage->activations/1024.0);
+    fprintf(fp, "Datasets:    %10.1f KB\n", usage->datasets/1024.0);
+    fprintf(fp, "History:     %10.1f KB\n", usage->history/1024.0);
+    fprintf(fp, "Other:       %10.1f KB\n", usage->other/1024.0);
+    fprintf(fp, "Total:       %10.1f KB\n",
+            deeplearn_footprint_total(usage)/1024.0);
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_FOOTPRINT_H
+#define DEEPLEARN_FOOTPRINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Bytes of memory held by an object, broken down by what they are used
+   for.  Each object includes its own structure, so that inline arrays
+   such as the training history are counted, and memory which belongs
+   to another object, such as a memory mapped file or shared weights,
+   is not counted. */
+typedef struct {
+    /* weights and biases, including sparse and quantised copies */
+    size_t weights;
+
+    /* previous weight changes, second moments and gradient sums */
+    size_t optimiser;
+
+    /* unit values, errors, dropouts and other working arrays */
+    size_t activations;
+
+    /* data samples, images, their indexes and caches */
+    size_t datasets;
+
+    /* training history and plotting settings */
+    size_t history;
+
+    /* structures, pointer arrays and alignment padding */
+    size_t other;
+} deeplearn_footprint;
+
+void deeplearn_footprint_clear(deeplearn_footprint * usage);
+void deeplearn_footprint_add(deeplearn_footprint * usage,
+                             deeplearn_footprint * part);
+size_t deeplearn_footprint_total(deeplearn_footprint * usage);
+int deeplearn_footprint_print(FILE * fp, deeplearn_footprint * usage);
+
+#endif
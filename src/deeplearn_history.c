@@ -0,0 +1,320 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include "deeplearn_history.h"
+
+/* used to give each plotter its own temporary files */
+static unsigned int history_plotter_count = 0;
+
+/* thread state of a plotter */
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    unsigned char stop;
+    unsigned char busy;
+} deeplearn_history_worker;
+
+/**
+ * @brief Uses gnuplot to plot the training error within a history snapshot
+ * @param snapshot History snapshot
+ * @param temp_name Name used for the temporary data and plot files
+ * @return zero on success
+ */
+int deeplearn_history_plot(deeplearn_history_snapshot * snapshot,
+                           char * temp_name)
+{
+    int index,retval=0;
+    FILE * fp;
+    char data_filename[256];
+    char plot_filename[256];
+    char command_str[600];
+    float value;
+    float max_value = 0.01f;
+
+    sprintf(data_filename,"%s%s.dat",DEEPLEARN_TEMP_DIRECTORY,temp_name);
+    sprintf(plot_filename,"%s%s.plot",DEEPLEARN_TEMP_DIRECTORY,temp_name);
+
+    /* save the data */
+    fp = fopen(data_filename,"w");
+    if (!fp) return -1;
+    for (index = 0; index < snapshot->history_index; index++) {
+        value = snapshot->history[index];
+        fprintf(fp,"%d    %.10f\n",
+                index*snapshot->history_step,value);
+        /* record the maximum error value */
+        if (value > max_value) {
+            max_value = value;
+        }
+    }
+    fclose(fp);
+
+    /* create a plot file */
+    fp = fopen(plot_filename,"w");
+    if (!fp) return -1;
+    fprintf(fp,"%s","reset\n");
+    fprintf(fp,"set title \"%s\"\n",snapshot->title);
+    fprintf(fp,"set xrange [0:%d]\n",
+            snapshot->history_index*snapshot->history_step);
+    fprintf(fp,"set yrange [0:%f]\n",max_value*102/100);
+    fprintf(fp,"%s","set lmargin 9\n");
+    fprintf(fp,"%s","set rmargin 2\n");
+    fprintf(fp,"%s","set xlabel \"Time Step\"\n");
+    fprintf(fp,"%s","set ylabel \"Training Error Percent\"\n");
+
+    fprintf(fp,"%s","set grid\n");
+    fprintf(fp,"%s","set key right top\n");
+
+    fprintf(fp,"set terminal png size %d,%d\n",
+            snapshot->image_width, snapshot->image_height);
+    fprintf(fp,"set output \"%s\"\n", snapshot->filename);
+    fprintf(fp,"plot \"%s\" using 1:2 notitle with lines\n",
+            data_filename);
+    fclose(fp);
+
+    /* run gnuplot using the created files */
+    sprintf(command_str,"gnuplot %s", plot_filename);
+    retval = system(command_str); /* I assume this is synchronous */
+
+    /* remove temporary files */
+    sprintf(command_str,"rm %s %s", data_filename,plot_filename);
+    retval = system(command_str);
+
+    return retval;
+}
+
+/**
+ * @brief Worker thread which renders snapshots as they are posted
+ * @param arg The plotter
+ * @return NULL
+ */
+static void * deeplearn_history_worker_run(void * arg)
+{
+    deeplearn_history_plotter * plotter = (deeplearn_history_plotter*)arg;
+    deeplearn_history_worker * worker =
+        (deeplearn_history_worker*)plotter->worker;
+    deeplearn_history_snapshot * snapshot;
+    char temp_name[64];
+
+    snapshot =
+        (deeplearn_history_snapshot*)malloc(sizeof(deeplearn_history_snapshot));
+    sprintf(temp_name, "libdeep_data_%u", plotter->id);
+
+    pthread_mutex_lock(&worker->lock);
+    while (1) {
+        while ((plotter->pending == 0) && (worker->stop == 0)) {
+            pthread_cond_wait(&worker->wake, &worker->lock);
+        }
+        if (plotter->pending == 0) {
+            /* stopped with nothing left to render */
+            break;
+        }
+
+        /* take a copy so that training can continue to post snapshots */
+        if (snapshot) {
+            memcpy((void*)snapshot, &plotter->queue[plotter->head],
+                   sizeof(deeplearn_history_snapshot));
+        }
+        plotter->head = (plotter->head + 1) % DEEPLEARN_HISTORY_QUEUE;
+        plotter->pending--;
+        worker->busy = 1;
+        pthread_mutex_unlock(&worker->lock);
+
+        if (snapshot) {
+            if (plotter->renderer != NULL) {
+                plotter->renderer(snapshot, plotter->renderer_data);
+            }
+            else {
+                deeplearn_history_plot(snapshot, temp_name);
+            }
+        }
+
+        pthread_mutex_lock(&worker->lock);
+        worker->busy = 0;
+        plotter->rendered++;
+        if (plotter->pending == 0) {
+            pthread_cond_broadcast(&worker->idle);
+        }
+    }
+    pthread_cond_broadcast(&worker->idle);
+    pthread_mutex_unlock(&worker->lock);
+
+    free(snapshot);
+    return NULL;
+}
+
+/**
+ * @brief Starts a plotter which renders training history on a
+ *        background thread
+ * @param plotter History plotter
+ * @param renderer Function used to render each snapshot, or NULL
+ *        to plot with gnuplot
+ * @param renderer_data Data passed to the renderer
+ * @return zero on success
+ */
+int deeplearn_history_plotter_init(deeplearn_history_plotter * plotter,
+                                   deeplearn_history_renderer renderer,
+                                   void * renderer_data)
+{
+    deeplearn_history_worker * worker;
+
+    memset((void*)plotter, '\0', sizeof(deeplearn_history_plotter));
+    plotter->renderer = renderer;
+    plotter->renderer_data = renderer_data;
+    plotter->id = history_plotter_count++;
+
+    worker =
+        (deeplearn_history_worker*)malloc(sizeof(deeplearn_history_worker));
+    if (!worker) {
+        return -1;
+    }
+    memset((void*)worker, '\0', sizeof(deeplearn_history_worker));
+    if (pthread_mutex_init(&worker->lock, NULL) != 0) {
+        free(worker);
+        return -2;
+    }
+    pthread_cond_init(&worker->wake, NULL);
+    pthread_cond_init(&worker->idle, NULL);
+    plotter->worker = worker;
+
+    if (pthread_create(&worker->thread, NULL,
+                       deeplearn_history_worker_run, plotter) != 0) {
+        pthread_cond_destroy(&worker->wake);
+        pthread_cond_destroy(&worker->idle);
+        pthread_mutex_destroy(&worker->lock);
+        free(worker);
+        plotter->worker = NULL;
+        return -3;
+    }
+    return 0;
+}
+
+/**
+ * @brief Queues a copy of the training history to be plotted.
+ *        This only waits for the queue to be updated, not for plotting.
+ * @param plotter History plotter
+ * @param history Array of training error values
+ * @param history_index The number of values within the history
+ * @param history_step Number of time steps between history values
+ * @param filename Filename of the image to be plotted
+ * @param title Title of the graph
+ * @param image_width Width of the image in pixels
+ * @param image_height Height of the image in pixels
+ * @return zero if queued, 1 if a pending snapshot was replaced or a
+ *         negative value on error
+ */
+int deeplearn_history_plotter_post(deeplearn_history_plotter * plotter,
+                                   float history[],
+                                   int history_index, int history_step,
+                                   char * filename, char * title,
+                                   int image_width, int image_height)
+{
+    deeplearn_history_worker * worker =
+        (deeplearn_history_worker*)plotter->worker;
+    deeplearn_history_snapshot * snapshot;
+    int retval = 0;
+
+    if (worker == NULL) {
+        return -1;
+    }
+    if ((history_index < 0) || (history_index > DEEPLEARN_HISTORY_SIZE)) {
+        return -2;
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    if (plotter->pending == DEEPLEARN_HISTORY_QUEUE) {
+        /* replace the oldest pending snapshot */
+        plotter->head = (plotter->head + 1) % DEEPLEARN_HISTORY_QUEUE;
+        plotter->pending--;
+        plotter->dropped++;
+        retval = 1;
+    }
+    snapshot =
+        &plotter->queue[(plotter->head + plotter->pending) %
+                        DEEPLEARN_HISTORY_QUEUE];
+    memcpy((void*)snapshot->history, history, history_index*sizeof(float));
+    snapshot->history_index = history_index;
+    snapshot->history_step = history_step;
+    snprintf(snapshot->filename, sizeof(snapshot->filename), "%s", filename);
+    snprintf(snapshot->title, sizeof(snapshot->title), "%s", title);
+    snapshot->image_width = image_width;
+    snapshot->image_height = image_height;
+    plotter->pending++;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    return retval;
+}
+
+/**
+ * @brief Waits until all queued snapshots have been rendered
+ * @param plotter History plotter
+ */
+void deeplearn_history_plotter_flush(deeplearn_history_plotter * plotter)
+{
+    deeplearn_history_worker * worker =
+        (deeplearn_history_worker*)plotter->worker;
+
+    if (worker == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&worker->lock);
+    while ((plotter->pending > 0) || (worker->busy != 0)) {
+        pthread_cond_wait(&worker->idle, &worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+}
+
+/**
+ * @brief Renders any remaining snapshots and stops the worker thread
+ * @param plotter History plotter
+ */
+void deeplearn_history_plotter_free(deeplearn_history_plotter * plotter)
+{
+    deeplearn_history_worker * worker =
+        (deeplearn_history_worker*)plotter->worker;
+
+    if (worker == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&worker->lock);
+    worker->stop = 1;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->thread, NULL);
+
+    pthread_cond_destroy(&worker->wake);
+    pthread_cond_destroy(&worker->idle);
+    pthread_mutex_destroy(&worker->lock);
+    free(worker);
+    plotter->worker = NULL;
+}
@@ -0,0 +1,95 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_HISTORY_H
+#define DEEPLEARN_HISTORY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+/* number of pending snapshots which can be queued for plotting */
+#define DEEPLEARN_HISTORY_QUEUE 4
+
+/* A copy of the training history at a point in time, together with
+   the details of the graph to be plotted from it */
+struct deeplearn_history_snapshot {
+    float history[DEEPLEARN_HISTORY_SIZE];
+    int history_index;
+    int history_step;
+    char filename[256];
+    char title[256];
+    int image_width, image_height;
+};
+typedef struct deeplearn_history_snapshot deeplearn_history_snapshot;
+
+/* renders a snapshot, returning zero on success */
+typedef int (*deeplearn_history_renderer)(deeplearn_history_snapshot * snapshot,
+                                          void * data);
+
+/* Renders history snapshots on a background worker thread, so that
+   training does not wait for graphs to be plotted. Snapshots are held
+   within a ring buffer and if it fills up then the oldest pending
+   snapshot is replaced, since only the latest state is of interest. */
+struct deeplearn_history_plotter {
+    deeplearn_history_snapshot queue[DEEPLEARN_HISTORY_QUEUE];
+    int head, pending;
+
+    /* snapshots replaced before they were rendered */
+    unsigned int dropped;
+
+    /* snapshots which have been rendered */
+    unsigned int rendered;
+
+    deeplearn_history_renderer renderer;
+    void * renderer_data;
+
+    /* temporary files used by gnuplot are unique to each plotter */
+    unsigned int id;
+
+    /* thread state, which is private to deeplearn_history.c */
+    void * worker;
+};
+typedef struct deeplearn_history_plotter deeplearn_history_plotter;
+
+int deeplearn_history_plot(deeplearn_history_snapshot * snapshot,
+                           char * temp_name);
+int deeplearn_history_plotter_init(deeplearn_history_plotter * plotter,
+                                   deeplearn_history_renderer renderer,
+                                   void * renderer_data);
+int deeplearn_history_plotter_post(deeplearn_history_plotter * plotter,
+                                   float history[],
+                                   int history_index, int history_step,
+                                   char * filename, char * title,
+                                   int image_width, int image_height);
+void deeplearn_history_plotter_flush(deeplearn_history_plotter * plotter);
+void deeplearn_history_plotter_free(deeplearn_history_plotter * plotter);
+
+#endif
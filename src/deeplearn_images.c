@@ -29,6 +29,13 @@
 
 #include "deeplearn_images.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define IMAGE_CACHE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
 /**
  * @brief Converts a float image to one which can be displayed
  *        The float image is assumed to contain normalised values
@@ -48,7 +55,10 @@ void deeplearn_float_to_img(float float_img[],
                             int img_depth_bits)
 {
     int img_depth_bytes = img_depth_bits/8;
-    
+    int parallel =
+        (img_width*img_height*img_depth_bytes >= DEEPLEARN_IMAGES_PARALLEL_MIN);
+
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
     for (int i = 0; i < img_width*img_height; i++) {
         for (int j = 0; j < img_depth_bytes; j++) {
             int k = j*float_img_depth/img_depth_bytes;
@@ -185,16 +195,19 @@ void deeplearn_downsample_colour_to_mono(unsigned char img[],
                                          int downsampled_width,
                                          int downsampled_height)
 {
-    int x,y,n2,xx,yy,n=0;
+    int parallel =
+        (downsampled_width*downsampled_height >= DEEPLEARN_IMAGES_PARALLEL_MIN);
 
-    for (y = 0; y < downsampled_height; y++) {
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
+    for (int y = 0; y < downsampled_height; y++) {
         /* y coordinate in the original image */
-        yy = y * height / downsampled_height;
-        for (x = 0; x < downsampled_width; x++, n++) {
+        int yy = y * height / downsampled_height;
+        int n = y * downsampled_width;
+        for (int x = 0; x < downsampled_width; x++, n++) {
             /* x coordinate in the original image */
-            xx = x * width / downsampled_width;
+            int xx = x * width / downsampled_width;
             /* index within the original image */
-            n2 = ((yy*width) + xx)*3;
+            int n2 = ((yy*width) + xx)*3;
             /* update downsampled image */
             downsampled[n] = (img[n2]+img[n2+1]+img[n2+2])/3;
         }
@@ -216,12 +229,16 @@ void deeplearn_downsample_colour(unsigned char img[],
                                  int downsampled_width,
                                  int downsampled_height)
 {
-    int x,y,n2,xx,yy,n=0;
+    int parallel =
+        (downsampled_width*downsampled_height*3 >=
+         DEEPLEARN_IMAGES_PARALLEL_MIN);
 
-    for (y = 0; y < downsampled_height; y++) {
+#pragma omp parallel for num_threads(threads_count()) if (parallel)
+    for (int y = 0; y < downsampled_height; y++) {
         /* y coordinate in the original image */
-        yy = y * height / downsampled_height;
-        for (x = 0; x < downsampled_width; x++, n+=3) {
+        int yy = y * height / downsampled_height;
+        int xx, n2, n = y * downsampled_width * 3;
+        for (int x = 0; x < downsampled_width; x++, n+=3) {
             /* x coordinate in the original image */
             xx = x * width / downsampled_width;
             /* index within the original image */
@@ -234,10 +251,399 @@ void deeplearn_downsample_colour(unsigned char img[],
     }
 }
 
+/**
+ * @brief Precomputes the source columns used for each resampled column
+ * @param width Width of the original image in pixels
+ * @param resampled_width Width of the resampled image in pixels
+ * @param method Resampling method DEEPLEARN_RESAMPLE_*
+ * @param x0 Returned first source column
+ * @param x1 Returned second source column, or end of the box
+ * @param wx Returned weight of the second column for bilinear resampling
+ */
+static void resample_columns(int width, int resampled_width, int method,
+                             int x0[], int x1[], float wx[])
+{
+    for (int x = 0; x < resampled_width; x++) {
+        float sx;
+
+        switch(method) {
+        case DEEPLEARN_RESAMPLE_BOX: {
+            x0[x] = x * width / resampled_width;
+            x1[x] = (x + 1) * width / resampled_width;
+            if (x1[x] <= x0[x]) x1[x] = x0[x] + 1;
+            break;
+        }
+        case DEEPLEARN_RESAMPLE_BILINEAR: {
+            /* sample at pixel centres */
+            sx = ((x + 0.5f) * width / resampled_width) - 0.5f;
+            if (sx < 0) sx = 0;
+            if (sx > width - 1) sx = (float)(width - 1);
+            x0[x] = (int)sx;
+            x1[x] = (x0[x] < width - 1) ? x0[x] + 1 : x0[x];
+            wx[x] = sx - x0[x];
+            break;
+        }
+        default: {
+            x0[x] = x * width / resampled_width;
+            break;
+        }
+        }
+    }
+}
+
+/**
+ * @brief Resamples a single row of an image.
+ *        Source rows are combined first, since they are contiguous
+ *        and so vectorise, then columns are gathered.
+ * @param img Original image buffer
+ * @param width Width of the original image in pixels
+ * @param height Height of the original image in pixels
+ * @param depth Bytes per pixel of the original image
+ * @param y Row within the resampled image
+ * @param resampled_width Width of the resampled image in pixels
+ * @param resampled_height Height of the resampled image in pixels
+ * @param method Resampling method DEEPLEARN_RESAMPLE_*
+ * @param x0 First source column for each resampled column
+ * @param x1 Second source column, or end of the box
+ * @param wx Bilinear weight of the second column
+ * @param accum Buffer for a combined source row (width*depth)
+ * @param row Returned resampled row (resampled_width*depth) with
+ *        values in the range 0-255
+ */
+static void resample_row(unsigned char img[],
+                         int width, int height, int depth, int y,
+                         int resampled_width, int resampled_height,
+                         int method,
+                         const int x0[], const int x1[], const float wx[],
+                         float accum[], float row[])
+{
+    int row_size = width*depth;
+
+    switch(method) {
+    case DEEPLEARN_RESAMPLE_BOX: {
+        int ys = y * height / resampled_height;
+        int ye = (y + 1) * height / resampled_height;
+        if (ye <= ys) ye = ys + 1;
+
+        memset((void*)accum, '\0', row_size*sizeof(float));
+        for (int yy = ys; yy < ye; yy++) {
+            unsigned char * src = &img[yy*row_size];
+#pragma omp simd
+            for (int i = 0; i < row_size; i++) {
+                accum[i] += src[i];
+            }
+        }
+
+        for (int x = 0; x < resampled_width; x++) {
+            float scale = 1.0f / ((x1[x] - x0[x]) * (ye - ys));
+            for (int d = 0; d < depth; d++) {
+                float sum = 0;
+                for (int xx = x0[x]; xx < x1[x]; xx++) {
+                    sum += accum[xx*depth + d];
+                }
+                row[x*depth + d] = sum * scale;
+            }
+        }
+        break;
+    }
+    case DEEPLEARN_RESAMPLE_BILINEAR: {
+        float sy = ((y + 0.5f) * height / resampled_height) - 0.5f;
+        int y0, y1;
+        float wy;
+        unsigned char * src0, * src1;
+
+        if (sy < 0) sy = 0;
+        if (sy > height - 1) sy = (float)(height - 1);
+        y0 = (int)sy;
+        y1 = (y0 < height - 1) ? y0 + 1 : y0;
+        wy = sy - y0;
+        src0 = &img[y0*row_size];
+        src1 = &img[y1*row_size];
+
+#pragma omp simd
+        for (int i = 0; i < row_size; i++) {
+            accum[i] = src0[i] + wy*(src1[i] - src0[i]);
+        }
+
+        for (int x = 0; x < resampled_width; x++) {
+            float * a = &accum[x0[x]*depth];
+            float * b = &accum[x1[x]*depth];
+            for (int d = 0; d < depth; d++) {
+                row[x*depth + d] = a[d] + wx[x]*(b[d] - a[d]);
+            }
+        }
+        break;
+    }
+    default: {
+        unsigned char * src = &img[(y * height / resampled_height)*row_size];
+        for (int x = 0; x < resampled_width; x++) {
+            for (int d = 0; d < depth; d++) {
+                row[x*depth + d] = src[x0[x]*depth + d];
+            }
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * @brief Resamples an image to either bytes or normalised floats,
+ *        with rows being processed in parallel
+ * @param img Original image buffer
+ * @param width Width of the original image in pixels
+ * @param height Height of the original image in pixels
+ * @param depth Bytes per pixel of the original image
+ * @param resampled Resampled image buffer, or NULL
+ * @param resampled_flt Resampled float buffer, or NULL
+ * @param resampled_width Width of the resampled image in pixels
+ * @param resampled_height Height of the resampled image in pixels
+ * @param resampled_depth Depth of the resampled image, either the
+ *        same as the original or 1 for mono
+ * @param method Resampling method DEEPLEARN_RESAMPLE_*
+ * @returns zero on success
+ */
+static int resample(unsigned char img[],
+                    int width, int height, int depth,
+                    unsigned char resampled[], float resampled_flt[],
+                    int resampled_width, int resampled_height,
+                    int resampled_depth, int method)
+{
+    int retval = 0;
+    int * x0, * x1;
+    float * wx;
+    int parallel =
+        (resampled_width*resampled_height*depth >=
+         DEEPLEARN_IMAGES_PARALLEL_MIN);
+
+    if ((method < 0) || (method >= DEEPLEARN_RESAMPLE_METHODS)) {
+        return -1;
+    }
+    if ((resampled_depth != depth) && (resampled_depth != 1)) {
+        return -2;
+    }
+    if ((width <= 0) || (height <= 0) || (depth <= 0) ||
+        (resampled_width <= 0) || (resampled_height <= 0)) {
+        return -3;
+    }
+
+    x0 = (int*)malloc(resampled_width*sizeof(int));
+    x1 = (int*)malloc(resampled_width*sizeof(int));
+    wx = (float*)malloc(resampled_width*sizeof(float));
+    if ((!x0) || (!x1) || (!wx)) {
+        free(x0);
+        free(x1);
+        free(wx);
+        return -4;
+    }
+    resample_columns(width, resampled_width, method, x0, x1, wx);
+
+#pragma omp parallel num_threads(threads_count()) reduction(min:retval) if (parallel)
+    {
+        float * accum = (float*)malloc(width*depth*sizeof(float));
+        float * row = (float*)malloc(resampled_width*depth*sizeof(float));
+
+        if ((!accum) || (!row)) {
+            retval = -4;
+        }
+
+#pragma omp for
+        for (int y = 0; y < resampled_height; y++) {
+            int n = y*resampled_width*resampled_depth;
+            if ((!accum) || (!row)) continue;
+
+            resample_row(img, width, height, depth, y,
+                         resampled_width, resampled_height, method,
+                         x0, x1, wx, accum, row);
+
+            /* mono output is the average of the channels */
+            if (resampled_depth != depth) {
+                for (int x = 0; x < resampled_width; x++) {
+                    float sum = 0;
+                    for (int d = 0; d < depth; d++) {
+                        sum += row[x*depth + d];
+                    }
+                    row[x] = sum / depth;
+                }
+            }
+
+            if (resampled_flt) {
+#pragma omp simd
+                for (int i = 0; i < resampled_width*resampled_depth; i++) {
+                    resampled_flt[n + i] = PIXEL_TO_FLOAT(row[i]);
+                }
+            }
+            else {
+#pragma omp simd
+                for (int i = 0; i < resampled_width*resampled_depth; i++) {
+                    resampled[n + i] = (unsigned char)(row[i] + 0.5f);
+                }
+            }
+        }
+
+        free(accum);
+        free(row);
+    }
+
+    free(x0);
+    free(x1);
+    free(wx);
+    return retval;
+}
+
+/**
+ * @brief Resamples an image to a different resolution
+ * @param img Original image buffer
+ * @param width Width of the original image in pixels
+ * @param height Height of the original image in pixels
+ * @param depth Bytes per pixel of the original image
+ * @param resampled Resampled image buffer
+ * @param resampled_width Width of the resampled image in pixels
+ * @param resampled_height Height of the resampled image in pixels
+ * @param resampled_depth Bytes per pixel of the resampled image, either
+ *        the same as the original or 1 for mono
+ * @param method Resampling method DEEPLEARN_RESAMPLE_*
+ * @returns zero on success
+ */
+int deeplearn_resample(unsigned char img[],
+                       int width, int height, int depth,
+                       unsigned char resampled[],
+                       int resampled_width, int resampled_height,
+                       int resampled_depth, int method)
+{
+    return resample(img, width, height, depth, resampled, NULL,
+                    resampled_width, resampled_height,
+                    resampled_depth, method);
+}
+
+/**
+ * @brief Resamples an image directly to normalised floats, as given by
+ *        PIXEL_TO_FLOAT, which can then be passed to conv_img_flt
+ * @param img Original image buffer
+ * @param width Width of the original image in pixels
+ * @param height Height of the original image in pixels
+ * @param depth Bytes per pixel of the original image
+ * @param resampled Resampled float buffer
+ * @param resampled_width Width of the resampled image in pixels
+ * @param resampled_height Height of the resampled image in pixels
+ * @param resampled_depth Depth of the resampled image, either the same
+ *        as the original or 1 for mono
+ * @param method Resampling method DEEPLEARN_RESAMPLE_*
+ * @returns zero on success
+ */
+int deeplearn_resample_to_flt(unsigned char img[],
+                              int width, int height, int depth,
+                              float resampled[],
+                              int resampled_width, int resampled_height,
+                              int resampled_depth, int method)
+{
+    return resample(img, width, height, depth, NULL, resampled,
+                    resampled_width, resampled_height,
+                    resampled_depth, method);
+}
+
+/**
+ * @brief Returns the filenames of the images within the given directory
+ *        having a given extension, in the order in which training images
+ *        are indexed
+ * @param images_directory The directory to search within
+ * @param extension Filename extension (eg. "png")
+ * @param filenames Returned array of filenames including the directory
+ * @return Number of images found, or negative on error
+ */
+static int image_filenames(char * images_directory,
+                           char * extension,
+                           char *** filenames)
+{
+    int ctr,no_of_images = 0;
+    struct dirent **namelist;
+    int n,len,dirlen;
+
+    *filenames = NULL;
+
+    /* how many images are there? */
+    no_of_images = number_of_images(images_directory, extension);
+    if (no_of_images == 0) {
+        return 0;
+    }
+
+    *filenames = (char**)malloc(no_of_images*sizeof(char*));
+    if (!*filenames) {
+        return -1;
+    }
+
+    dirlen = strlen(images_directory);
+    no_of_images = 0;
+    n = scandir(images_directory, &namelist, 0, alphasort);
+    if (n >= 0) {
+        /* for every filename */
+        ctr = n;
+        while (ctr--) {
+            /* is this a png image? */
+            len = strlen(namelist[ctr]->d_name);
+            if ((len > 4) &&
+                (namelist[ctr]->d_name[len-4]=='.') &&
+                (namelist[ctr]->d_name[len-3]==extension[0]) &&
+                (namelist[ctr]->d_name[len-2]==extension[1]) &&
+                (namelist[ctr]->d_name[len-1]==extension[2])) {
+                (*filenames)[no_of_images] =
+                    (char*)malloc((dirlen+len+2)*sizeof(char));
+                if ((*filenames)[no_of_images]) {
+                    sprintf((*filenames)[no_of_images],"%s/%s",
+                            images_directory,namelist[ctr]->d_name);
+                    no_of_images++;
+                }
+            }
+            free(namelist[ctr]);
+        }
+        free(namelist);
+    }
+    return no_of_images;
+}
+
+/**
+ * @brief Frees an array of filenames
+ * @param filenames Array of filenames
+ * @param no_of_filenames The number of filenames in the array
+ */
+static void free_filenames(char ** filenames, int no_of_filenames)
+{
+    for (int i = 0; i < no_of_filenames; i++) {
+        free(filenames[i]);
+    }
+    free(filenames);
+}
+
+/**
+ * @brief Decodes a PNG image and downsamples it to a fixed size mono image
+ * @param filename Filename of the image
+ * @param downsampled Returned image buffer (1 byte per pixel)
+ * @param width Standardised width of the image in pixels
+ * @param height Standardised height of the image in pixels
+ * @return zero on success
+ */
+static int decode_training_image(char * filename,
+                                 unsigned char downsampled[],
+                                 int width, int height)
+{
+    unsigned int im_width=0,im_height=0;
+    unsigned int im_bitsperpixel=0;
+    unsigned char * img;
+
+    if (deeplearn_read_png_file(filename,
+                                &im_width, &im_height,
+                                &im_bitsperpixel, &img) != 0) {
+        return -1;
+    }
+    deeplearn_downsample_colour_to_mono(img, (int)im_width, (int)im_height,
+                                        downsampled, width, height);
+    free(img);
+    return 0;
+}
+
 /**
  * @brief Loads a set of training images and automatically creates
  *        classification descriptions from the filenames and
- *        classification numbers
+ *        classification numbers. Images are decoded in parallel.
  * @param images_directory The directory to search for images
  * @param images Array which will be used to store the images (1 byte per pixel)
  * @param classifications Description of each image, taken from the filename
@@ -252,19 +658,12 @@ int deeplearn_load_training_images(char * images_directory,
                                    int ** classification_number,
                                    int width, int height)
 {
-    int ctr,no_of_images = 0;
-    struct dirent **namelist;
-    int n,len;
-    unsigned int im_width=0,im_height=0;
-    unsigned int im_bitsperpixel=0;
-    unsigned char * img, * downsampled;
-    char * extension = "png";
-    char filename[256];
-    char * classification;
+    int no_of_images;
+    char ** filenames;
 
-    /* how many images are there? */
-    no_of_images = number_of_images(images_directory, extension);
-    if (no_of_images == 0) {
+    no_of_images = image_filenames(images_directory, "png", &filenames);
+    if (no_of_images <= 0) {
+        free(filenames);
         return 0;
     }
 
@@ -280,63 +679,29 @@ int deeplearn_load_training_images(char * images_directory,
     /* allocate memory for the class number assigned to each image */
     *classification_number = (int*)malloc(no_of_images * sizeof(int));
 
-    /* get image filenames */
-    no_of_images = 0;
-    n = scandir(images_directory, &namelist, 0, alphasort);
-    if (n >= 0) {
-        /* for every filename */
-        ctr = n;
-        while (ctr--) {
-            /* is the filename long enough? */
-            len = strlen(namelist[ctr]->d_name);
-            if (len > 4) {
-                sprintf(filename,"%s/%s",
-                        images_directory,namelist[ctr]->d_name);
-                len = strlen(filename);
-                /* is this a png image? */
-                if ((filename[len-4]=='.') &&
-                    (filename[len-3]==extension[0]) &&
-                    (filename[len-2]==extension[1]) &&
-                    (filename[len-1]==extension[2])) {
-
-                    /* obtain an image from the filename */
-                    if (deeplearn_read_png_file(filename,
-                                                &im_width, &im_height,
-                                                &im_bitsperpixel, &img) == 0) {
-                        /* create a fixed size image */
-                        downsampled =
-                            (unsigned char*)malloc(width*height*
-                                                   sizeof(unsigned char));
-                        deeplearn_downsample_colour_to_mono(img, (int)im_width, (int)im_height,
-                                                            downsampled, width, height);
-
-                        (*images)[no_of_images] = downsampled;
-
-                        /* free the original image */
-                        free(img);
-                    }
-                    else {
-                        (*images)[no_of_images] = NULL;
-                    }
-
-                    /* allocate memory for the classification */
-                    classification =
-                        (char*)malloc(256*
-                                      sizeof(char));
-
-                    /* get the name of the classification */
-                    bp_get_classification_from_filename(filename,
-                                                        classification);
-                    (*classifications)[no_of_images] = classification;
-
-                    no_of_images++;
-                }
+    /* decoding dominates, so each image is decoded on its own thread */
+#pragma omp parallel for num_threads(threads_count()) schedule(dynamic)
+    for (int i = 0; i < no_of_images; i++) {
+        /* create a fixed size image */
+        unsigned char * downsampled =
+            (unsigned char*)malloc(width*height*sizeof(unsigned char));
+        if (downsampled) {
+            if (decode_training_image(filenames[i], downsampled,
+                                      width, height) != 0) {
+                free(downsampled);
+                downsampled = NULL;
             }
-            free(namelist[ctr]);
         }
-        free(namelist);
+        (*images)[i] = downsampled;
+
+        /* get the name of the classification */
+        (*classifications)[i] = (char*)malloc(256*sizeof(char));
+        bp_get_classification_from_filename(filenames[i],
+                                            (*classifications)[i]);
     }
 
+    free_filenames(filenames, no_of_images);
+
     /* assign a class number to each image */
     bp_classifications_to_numbers(no_of_images,
                                   *classifications,
@@ -345,6 +710,408 @@ int deeplearn_load_training_images(char * images_directory,
     return no_of_images;
 }
 
+/* round up to the next aligned offset within an image cache */
+#define IMAGE_CACHE_ALIGN(offset) \
+    (((offset) + DEEPLEARN_IMAGE_CACHE_ALIGNMENT - 1) & \
+     ~((uint64_t)DEEPLEARN_IMAGE_CACHE_ALIGNMENT - 1))
+
+/**
+ * @brief Writes zeros to a file until the given offset is reached
+ * @param fp File pointer
+ * @param position Current position within the file, which is updated
+ * @param offset Offset to pad up to
+ * @returns zero on success
+ */
+static int image_cache_pad(FILE * fp, uint64_t * position, uint64_t offset)
+{
+    while (*position < offset) {
+        if (fputc(0, fp) == EOF) {
+            return -1;
+        }
+        (*position)++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the contents of an image cache, decoding the images in
+ *        parallel a chunk at a time
+ * @param fp File pointer
+ * @param header Header of the cache, with section offsets set
+ * @param filenames Filenames of the images
+ * @param classifications Label of each image
+ * @param numbers Class number of each image
+ * @returns zero on success
+ */
+static int image_cache_write(FILE * fp,
+                             deeplearn_image_cache_header * header,
+                             char ** filenames,
+                             char ** classifications,
+                             int * numbers)
+{
+    int no_of_images = header->no_of_images;
+    size_t image_size = (size_t)header->width*header->height;
+    uint64_t position = 0;
+    char label[DEEPLEARN_IMAGE_CACHE_LABEL];
+    unsigned char * valid, * chunk;
+    int32_t number;
+    int retval = 0;
+
+    if (fwrite(header, sizeof(deeplearn_image_cache_header), 1, fp) != 1) {
+        return -1;
+    }
+    position = sizeof(deeplearn_image_cache_header);
+
+    /* class numbers */
+    if (image_cache_pad(fp, &position, header->numbers_offset) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < no_of_images; i++) {
+        number = (int32_t)numbers[i];
+        if (fwrite(&number, sizeof(int32_t), 1, fp) != 1) {
+            return -1;
+        }
+        position += sizeof(int32_t);
+    }
+
+    /* labels */
+    if (image_cache_pad(fp, &position, header->labels_offset) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < no_of_images; i++) {
+        memset(label, '\0', DEEPLEARN_IMAGE_CACHE_LABEL);
+        strncpy(label, classifications[i], DEEPLEARN_IMAGE_CACHE_LABEL-1);
+        if (fwrite(label, 1, DEEPLEARN_IMAGE_CACHE_LABEL, fp) !=
+            DEEPLEARN_IMAGE_CACHE_LABEL) {
+            return -1;
+        }
+        position += DEEPLEARN_IMAGE_CACHE_LABEL;
+    }
+
+    /* images */
+    if (image_cache_pad(fp, &position, header->pixels_offset) != 0) {
+        return -1;
+    }
+    valid = (unsigned char*)malloc(no_of_images*sizeof(unsigned char));
+    chunk = (unsigned char*)malloc(DEEPLEARN_IMAGE_CACHE_CHUNK*image_size);
+    if ((!valid) || (!chunk)) {
+        free(valid);
+        free(chunk);
+        return -2;
+    }
+    for (int start = 0; start < no_of_images;
+         start += DEEPLEARN_IMAGE_CACHE_CHUNK) {
+        int chunk_images = no_of_images - start;
+        if (chunk_images > DEEPLEARN_IMAGE_CACHE_CHUNK) {
+            chunk_images = DEEPLEARN_IMAGE_CACHE_CHUNK;
+        }
+
+#pragma omp parallel for num_threads(threads_count()) schedule(dynamic)
+        for (int i = 0; i < chunk_images; i++) {
+            unsigned char * img = &chunk[i*image_size];
+            valid[start+i] = 1;
+            if (decode_training_image(filenames[start+i], img,
+                                      header->width, header->height) != 0) {
+                memset(img, '\0', image_size);
+                valid[start+i] = 0;
+            }
+        }
+
+        if (fwrite(chunk, image_size, chunk_images, fp) !=
+            (size_t)chunk_images) {
+            retval = -1;
+            break;
+        }
+    }
+
+    /* whether each image could be decoded */
+    if ((retval == 0) &&
+        (fwrite(valid, 1, no_of_images, fp) != (size_t)no_of_images)) {
+        retval = -1;
+    }
+
+    free(valid);
+    free(chunk);
+    return retval;
+}
+
+/**
+ * @brief Decodes a directory of training images into a cache file.
+ *        Images are decoded in parallel a chunk at a time, so the
+ *        memory needed is independent of the size of the data set.
+ * @param images_directory The directory to search for images
+ * @param cache_filename Filename of the cache to be written
+ * @param width Standardised width of the images in pixels
+ * @param height Standardised height of the images in pixels
+ * @return The number of images within the cache, or negative on error
+ */
+int deeplearn_image_cache_create(char * images_directory,
+                                 char * cache_filename,
+                                 int width, int height)
+{
+    int no_of_images, no_of_labels = 0, retval = 0;
+    char ** filenames;
+    char ** classifications;
+    int * numbers;
+    deeplearn_image_cache_header header;
+    FILE * fp;
+
+    if ((width <= 0) || (height <= 0)) {
+        return -1;
+    }
+
+    no_of_images = image_filenames(images_directory, "png", &filenames);
+    if (no_of_images <= 0) {
+        free(filenames);
+        return -2;
+    }
+
+    /* labels are taken from the filenames */
+    classifications = (char**)malloc(no_of_images*sizeof(char*));
+    numbers = (int*)malloc(no_of_images*sizeof(int));
+    if ((!classifications) || (!numbers)) {
+        retval = -3;
+    }
+    for (int i = 0; (i < no_of_images) && (retval == 0); i++) {
+        classifications[i] =
+            (char*)malloc(DEEPLEARN_IMAGE_CACHE_LABEL*sizeof(char));
+        if (!classifications[i]) {
+            retval = -3;
+            break;
+        }
+        no_of_labels++;
+        bp_get_classification_from_filename(filenames[i],
+                                            classifications[i]);
+    }
+    if ((retval == 0) &&
+        (bp_classifications_to_numbers(no_of_images, classifications,
+                                       numbers) != 0)) {
+        retval = -3;
+    }
+
+    if (retval == 0) {
+        memset((void*)&header, '\0', sizeof(header));
+        memcpy(header.magic, DEEPLEARN_IMAGE_CACHE_MAGIC, 8);
+        header.version = DEEPLEARN_IMAGE_CACHE_VERSION;
+        header.width = width;
+        header.height = height;
+        header.no_of_images = no_of_images;
+        header.numbers_offset =
+            IMAGE_CACHE_ALIGN((uint64_t)sizeof(header));
+        header.labels_offset =
+            IMAGE_CACHE_ALIGN(header.numbers_offset +
+                              (uint64_t)no_of_images*sizeof(int32_t));
+        header.pixels_offset =
+            IMAGE_CACHE_ALIGN(header.labels_offset +
+                              (uint64_t)no_of_images*
+                              DEEPLEARN_IMAGE_CACHE_LABEL);
+        header.valid_offset =
+            header.pixels_offset + (uint64_t)no_of_images*width*height;
+
+        fp = fopen(cache_filename, "wb");
+        if (!fp) {
+            retval = -4;
+        }
+        else {
+            if (image_cache_write(fp, &header, filenames,
+                                  classifications, numbers) != 0) {
+                retval = -5;
+            }
+            if (fclose(fp) != 0) {
+                retval = -5;
+            }
+        }
+    }
+
+    if (classifications) {
+        for (int i = 0; i < no_of_labels; i++) {
+            free(classifications[i]);
+        }
+        free(classifications);
+    }
+    free(numbers);
+    free_filenames(filenames, no_of_images);
+
+    if (retval != 0) {
+        return retval;
+    }
+    return no_of_images;
+}
+
+/**
+ * @brief Checks the header of an image cache and sets up pointers to
+ *        the images and labels
+ * @param cache Image cache object whose data has been loaded
+ * @returns zero on success
+ */
+static int image_cache_parse(deeplearn_image_cache * cache)
+{
+    deeplearn_image_cache_header * header;
+    const unsigned char * data = (const unsigned char*)cache->data;
+    const int32_t * numbers;
+    uint64_t image_size;
+
+    if (cache->size < sizeof(deeplearn_image_cache_header)) {
+        return -3;
+    }
+    header = (deeplearn_image_cache_header*)cache->data;
+    if ((memcmp(header->magic, DEEPLEARN_IMAGE_CACHE_MAGIC, 8) != 0) ||
+        (header->version != DEEPLEARN_IMAGE_CACHE_VERSION)) {
+        return -3;
+    }
+    if ((header->width <= 0) || (header->height <= 0) ||
+        (header->no_of_images <= 0)) {
+        return -4;
+    }
+
+    /* check that every section lies within the file */
+    image_size = (uint64_t)header->width*header->height;
+    if ((header->numbers_offset +
+         (uint64_t)header->no_of_images*sizeof(int32_t) >
+         header->labels_offset) ||
+        (header->labels_offset +
+         (uint64_t)header->no_of_images*DEEPLEARN_IMAGE_CACHE_LABEL >
+         header->pixels_offset) ||
+        (header->pixels_offset +
+         (uint64_t)header->no_of_images*image_size !=
+         header->valid_offset) ||
+        (header->valid_offset + (uint64_t)header->no_of_images >
+         (uint64_t)cache->size)) {
+        return -4;
+    }
+
+    cache->width = header->width;
+    cache->height = header->height;
+    cache->no_of_images = header->no_of_images;
+    cache->pixels = data + header->pixels_offset;
+    cache->valid = data + header->valid_offset;
+
+    cache->classification_number =
+        (int*)malloc(cache->no_of_images*sizeof(int));
+    cache->classifications =
+        (char**)malloc(cache->no_of_images*sizeof(char*));
+    if ((!cache->classification_number) || (!cache->classifications)) {
+        return -5;
+    }
+
+    numbers = (const int32_t*)(data + header->numbers_offset);
+    for (int i = 0; i < cache->no_of_images; i++) {
+        char * label =
+            (char*)(data + header->labels_offset +
+                    (uint64_t)i*DEEPLEARN_IMAGE_CACHE_LABEL);
+        if (label[DEEPLEARN_IMAGE_CACHE_LABEL-1] != 0) {
+            return -4;
+        }
+        cache->classification_number[i] = (int)numbers[i];
+        cache->classifications[i] = label;
+    }
+    return 0;
+}
+
+/**
+ * @brief Opens an image cache file. Where possible the file is memory
+ *        mapped, so that images are only paged in when they are used
+ *        and data sets larger than the available memory can be trained on.
+ * @param cache_filename Filename of the image cache
+ * @param cache Returned image cache object
+ * @returns zero on success
+ */
+int deeplearn_image_cache_open(char * cache_filename,
+                               deeplearn_image_cache * cache)
+{
+    int retval;
+
+    memset((void*)cache, '\0', sizeof(deeplearn_image_cache));
+
+#ifdef IMAGE_CACHE_MMAP
+    struct stat st;
+    int fd = open(cache_filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+        close(fd);
+        return -2;
+    }
+    cache->size = (size_t)st.st_size;
+    cache->data = mmap(NULL, cache->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (cache->data == MAP_FAILED) {
+        cache->data = NULL;
+        return -2;
+    }
+    cache->mapped = 1;
+#else
+    long size;
+    FILE * fp = fopen(cache_filename, "rb");
+    if (!fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return -2;
+    }
+    cache->size = (size_t)size;
+    cache->allocation = malloc(cache->size);
+    if (!cache->allocation) {
+        fclose(fp);
+        return -2;
+    }
+    cache->data = cache->allocation;
+    if (fread(cache->data, 1, cache->size, fp) != cache->size) {
+        fclose(fp);
+        deeplearn_image_cache_close(cache);
+        return -2;
+    }
+    fclose(fp);
+#endif
+
+    retval = image_cache_parse(cache);
+    if (retval != 0) {
+        deeplearn_image_cache_close(cache);
+    }
+    return retval;
+}
+
+/**
+ * @brief Returns an image from the cache
+ * @param cache Image cache object
+ * @param index Index number of the image
+ * @returns The image (1 byte per pixel), or NULL if it could not be decoded
+ */
+unsigned char * deeplearn_image_cache_get(deeplearn_image_cache * cache,
+                                          int index)
+{
+    if ((index < 0) || (index >= cache->no_of_images)) {
+        return NULL;
+    }
+    if (cache->valid[index] == 0) {
+        return NULL;
+    }
+    return (unsigned char*)&cache->pixels[(size_t)index*
+                                          cache->width*cache->height];
+}
+
+/**
+ * @brief Closes an image cache, unmapping or freeing its data
+ * @param cache Image cache object
+ */
+void deeplearn_image_cache_close(deeplearn_image_cache * cache)
+{
+#ifdef IMAGE_CACHE_MMAP
+    if ((cache->mapped != 0) && (cache->data)) {
+        munmap(cache->data, cache->size);
+    }
+#endif
+    free(cache->allocation);
+    free(cache->classification_number);
+    free(cache->classifications);
+    memset((void*)cache, '\0', sizeof(deeplearn_image_cache));
+}
+
 /**
  * @brief Plots a number of mono images within a single image
  * @param images Array of images (1 byte per pixel)
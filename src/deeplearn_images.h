@@ -30,7 +30,9 @@
 #ifndef DEEPLEARN_IMAGES_H
 #define DEEPLEARN_IMAGES_H
 
+#ifndef _DEFAULT_SOURCE
 #define _DEFAULT_SOURCE
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,10 +43,68 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "lodepng.h"
 #include "backprop.h"
 
+/* resampling methods */
+#define DEEPLEARN_RESAMPLE_NEAREST  0
+#define DEEPLEARN_RESAMPLE_BOX      1
+#define DEEPLEARN_RESAMPLE_BILINEAR 2
+#define DEEPLEARN_RESAMPLE_METHODS  3
+
+/* minimum number of resampled values before rows are processed
+   in parallel */
+#define DEEPLEARN_IMAGES_PARALLEL_MIN 16384
+
+/* Image cache files hold a set of training images, already decoded and
+   downsampled, as one contiguous block so that they can be memory mapped
+   and paged in on demand rather than held in memory */
+#define DEEPLEARN_IMAGE_CACHE_MAGIC     "LIBDEEPI"
+#define DEEPLEARN_IMAGE_CACHE_VERSION   1
+#define DEEPLEARN_IMAGE_CACHE_ALIGNMENT 64
+
+/* maximum length of a classification label within the cache */
+#define DEEPLEARN_IMAGE_CACHE_LABEL     256
+
+/* number of images decoded in parallel before being written to the cache */
+#define DEEPLEARN_IMAGE_CACHE_CHUNK     1024
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t no_of_images;
+    uint64_t numbers_offset;
+    uint64_t labels_offset;
+    uint64_t pixels_offset;
+    uint64_t valid_offset;
+} deeplearn_image_cache_header;
+
+typedef struct {
+    /* dimensions of every image, 1 byte per pixel */
+    int width;
+    int height;
+    int no_of_images;
+
+    /* class number of each image */
+    int * classification_number;
+
+    /* labels of each image, pointing into the cache */
+    char ** classifications;
+
+    /* images within the cache, and whether each one could be decoded */
+    const unsigned char * pixels;
+    const unsigned char * valid;
+
+    void * data;
+    size_t size;
+    int mapped;
+    void * allocation;
+} deeplearn_image_cache;
+
 int deeplearn_read_png_file(char * filename,
                             unsigned int * width,
                             unsigned int * height,
@@ -59,6 +119,14 @@ int deeplearn_load_training_images(char * images_directory,
                                    char *** classifications,
                                    int ** classification_number,
                                    int width, int height);
+int deeplearn_image_cache_create(char * images_directory,
+                                 char * cache_filename,
+                                 int width, int height);
+int deeplearn_image_cache_open(char * cache_filename,
+                               deeplearn_image_cache * cache);
+unsigned char * deeplearn_image_cache_get(deeplearn_image_cache * cache,
+                                          int index);
+void deeplearn_image_cache_close(deeplearn_image_cache * cache);
 void bp_plot_images(unsigned char **images,
                     int no_of_images,
                     int image_width, int image_height,
@@ -73,6 +141,16 @@ void deeplearn_downsample_colour(unsigned char img[],
                                  unsigned char downsampled[],
                                  int downsampled_width,
                                  int downsampled_height);
+int deeplearn_resample(unsigned char img[],
+                       int width, int height, int depth,
+                       unsigned char resampled[],
+                       int resampled_width, int resampled_height,
+                       int resampled_depth, int method);
+int deeplearn_resample_to_flt(unsigned char img[],
+                              int width, int height, int depth,
+                              float resampled[],
+                              int resampled_width, int resampled_height,
+                              int resampled_depth, int method);
 void deeplearn_float_to_img(float float_img[],
                             int float_img_depth,
                             int img_width,
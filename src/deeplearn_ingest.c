@@ -0,0 +1,581 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <math.h>
+#include "deeplearn_ingest.h"
+
+/* threads, locks and the copy of the network used for inference */
+struct deeplearn_ingest_threads {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t learn_thread;
+    pthread_t infer_thread;
+    int learn_started;
+    int infer_started;
+
+    /* held while the copy of the network is read or updated */
+    pthread_mutex_t net_lock;
+    bp net;
+    int net_valid;
+    bp_inference ctx;
+    float * outputs;
+    unsigned long updates;
+};
+typedef struct deeplearn_ingest_threads deeplearn_ingest_threads;
+
+/**
+ * @brief Returns the input values of a frame within the ring
+ * @param ingest Ingest object
+ * @param index Index of the frame within the ring
+ * @returns Input values
+ */
+static float * ingest_inputs(deeplearn_ingest * ingest, int index)
+{
+    return &ingest->buffer[index*ingest->no_of_inputs];
+}
+
+/**
+ * @brief Returns the frame which is waiting for the given use, being the
+ *        oldest or newest of them.  Should be called with the lock held.
+ * @param ingest Ingest object
+ * @param use DEEPLEARN_INGEST_LEARN or DEEPLEARN_INGEST_INFER
+ * @param newest If non-zero then the newest frame is returned
+ * @returns Index of the frame within the ring, or -1 if none are waiting
+ */
+static int ingest_waiting(deeplearn_ingest * ingest, int use, int newest)
+{
+    int i, index = -1;
+
+    for (i = 0; i < ingest->capacity; i++) {
+        if (((ingest->pending[i] & use) == 0) || (ingest->readers[i] < 0)) {
+            continue;
+        }
+        if ((index == -1) ||
+            ((newest != 0) &&
+             (ingest->sequence[i] > ingest->sequence[index])) ||
+            ((newest == 0) &&
+             (ingest->sequence[i] < ingest->sequence[index]))) {
+            index = i;
+        }
+    }
+    return index;
+}
+
+/**
+ * @brief Returns whether the frame has changed enough from the previous
+ *        frame learned to be worth learning, and remembers it
+ * @param ingest Ingest object
+ * @param inputs Input values of the frame
+ * @returns non-zero if the frame should be learned
+ */
+static int ingest_changed(deeplearn_ingest * ingest, float * inputs)
+{
+    float change = 0;
+    int i;
+
+    if (ingest->min_change <= 0) {
+        return 1;
+    }
+    if (ingest->has_previous != 0) {
+        for (i = 0; i < ingest->no_of_inputs; i++) {
+            change += fabsf(inputs[i] - ingest->previous[i]);
+        }
+        change /= ingest->no_of_inputs;
+    }
+    memcpy(ingest->previous, inputs, ingest->no_of_inputs*sizeof(float));
+    if (ingest->has_previous == 0) {
+        ingest->has_previous = 1;
+        return 1;
+    }
+    return (change >= ingest->min_change);
+}
+
+/**
+ * @brief Thread which learns from frames in the order captured
+ * @param arg Ingest object
+ * @returns NULL
+ */
+static void * ingest_learn(void * arg)
+{
+    deeplearn_ingest * ingest = (deeplearn_ingest*)arg;
+    deeplearn_ingest_threads * t = (deeplearn_ingest_threads*)ingest->threads;
+    deeplearn * learner = ingest->learner;
+    unsigned long frame;
+    float * inputs;
+    int index, i, learn;
+
+    pthread_mutex_lock(&t->lock);
+    for (;;) {
+        while ((ingest->running != 0) &&
+               ((index = ingest_waiting(ingest, DEEPLEARN_INGEST_LEARN, 0)) < 0)) {
+            pthread_cond_wait(&t->changed, &t->lock);
+        }
+        if (ingest->running == 0) {
+            break;
+        }
+        ingest->pending[index] &= ~DEEPLEARN_INGEST_LEARN;
+        ingest->readers[index]++;
+        frame = ingest->sequence[index];
+        pthread_mutex_unlock(&t->lock);
+
+        inputs = ingest_inputs(ingest, index);
+        learn = ingest_changed(ingest, inputs);
+        if (learn != 0) {
+            for (i = 0; i < ingest->no_of_inputs; i++) {
+                deeplearn_set_input(learner, i, inputs[i]);
+            }
+            deeplearn_update_continuous(learner);
+
+            t->updates++;
+            if ((t->net_valid != 0) &&
+                (t->updates % ingest->sync_interval == 0)) {
+                pthread_mutex_lock(&t->net_lock);
+                bp_copy_weights(&t->net, learner->net);
+                pthread_mutex_unlock(&t->net_lock);
+            }
+            if (ingest->learned != NULL) {
+                ingest->learned(ingest->learned_context, learner, frame);
+            }
+        }
+
+        pthread_mutex_lock(&t->lock);
+        ingest->readers[index]--;
+        if (learn != 0) {
+            ingest->learned_frames++;
+        }
+        else {
+            ingest->unchanged_frames++;
+        }
+        pthread_cond_broadcast(&t->changed);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+/**
+ * @brief Thread which evaluates the newest frame with the copy of the
+ *        network, skipping older frames which it has not reached
+ * @param arg Ingest object
+ * @returns NULL
+ */
+static void * ingest_infer(void * arg)
+{
+    deeplearn_ingest * ingest = (deeplearn_ingest*)arg;
+    deeplearn_ingest_threads * t = (deeplearn_ingest_threads*)ingest->threads;
+    unsigned long frame;
+    int index, i;
+
+    pthread_mutex_lock(&t->lock);
+    for (;;) {
+        while ((ingest->running != 0) &&
+               ((index = ingest_waiting(ingest, DEEPLEARN_INGEST_INFER, 1)) < 0)) {
+            pthread_cond_wait(&t->changed, &t->lock);
+        }
+        if (ingest->running == 0) {
+            break;
+        }
+        frame = ingest->sequence[index];
+        for (i = 0; i < ingest->capacity; i++) {
+            if ((ingest->readers[i] >= 0) && (ingest->sequence[i] <= frame)) {
+                ingest->pending[i] &= ~DEEPLEARN_INGEST_INFER;
+            }
+        }
+        ingest->readers[index]++;
+        pthread_mutex_unlock(&t->lock);
+
+        pthread_mutex_lock(&t->net_lock);
+        bp_infer(&t->net, &t->ctx, ingest_inputs(ingest, index),
+                 t->outputs, 1);
+        pthread_mutex_unlock(&t->net_lock);
+        if (ingest->output != NULL) {
+            ingest->output(ingest->output_context, frame,
+                           t->outputs, ingest->no_of_outputs);
+        }
+
+        pthread_mutex_lock(&t->lock);
+        ingest->readers[index]--;
+        ingest->inferred_frames++;
+        pthread_cond_broadcast(&t->changed);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+/**
+ * @brief Creates a ring of frames to be passed from a capture thread to
+ *        the learner.  Callbacks may be set before the threads are
+ *        started with deeplearn_ingest_start.
+ * @param ingest Ingest object
+ * @param learner Deep learner object, which should not be used by other
+ *        threads while the ingest is running
+ * @param capacity The number of frames within the ring, at least three
+ * @param flags DEEPLEARN_INGEST_LEARN and/or DEEPLEARN_INGEST_INFER
+ * @param convert Function which converts a frame into input values
+ * @param context Passed to the convert function
+ * @returns zero on success
+ */
+int deeplearn_ingest_init(deeplearn_ingest * ingest, deeplearn * learner,
+                          int capacity, int flags,
+                          deeplearn_ingest_convert convert, void * context)
+{
+    deeplearn_ingest_threads * t;
+
+    memset((void*)ingest, '\0', sizeof(deeplearn_ingest));
+    if ((learner == NULL) || (capacity < 3) || (convert == NULL) ||
+        ((flags & (DEEPLEARN_INGEST_LEARN | DEEPLEARN_INGEST_INFER)) == 0) ||
+        ((flags & ~(DEEPLEARN_INGEST_LEARN | DEEPLEARN_INGEST_INFER)) != 0)) {
+        return -1;
+    }
+
+    ingest->learner = learner;
+    ingest->capacity = capacity;
+    ingest->no_of_inputs = learner->net->NoOfInputs;
+    ingest->no_of_outputs = learner->net->NoOfOutputs;
+    ingest->flags = flags;
+    ingest->convert = convert;
+    ingest->convert_context = context;
+    ingest->sync_interval = 1;
+
+    ingest->buffer =
+        (float*)malloc(capacity*ingest->no_of_inputs*sizeof(float));
+    ingest->previous = (float*)malloc(ingest->no_of_inputs*sizeof(float));
+    ingest->sequence =
+        (unsigned long*)calloc(capacity, sizeof(unsigned long));
+    ingest->pending = (int*)calloc(capacity, sizeof(int));
+    ingest->readers = (int*)calloc(capacity, sizeof(int));
+    t = (deeplearn_ingest_threads*)calloc(1, sizeof(deeplearn_ingest_threads));
+    ingest->threads = (void*)t;
+    if ((ingest->buffer == NULL) || (ingest->previous == NULL) ||
+        (ingest->sequence == NULL) || (ingest->pending == NULL) ||
+        (ingest->readers == NULL) || (t == NULL)) {
+        deeplearn_ingest_free(ingest);
+        return -2;
+    }
+    if (pthread_mutex_init(&t->lock, NULL) != 0) {
+        deeplearn_ingest_free(ingest);
+        return -3;
+    }
+    if (pthread_mutex_init(&t->net_lock, NULL) != 0) {
+        pthread_mutex_destroy(&t->lock);
+        deeplearn_ingest_free(ingest);
+        return -3;
+    }
+    if (pthread_cond_init(&t->changed, NULL) != 0) {
+        pthread_mutex_destroy(&t->lock);
+        pthread_mutex_destroy(&t->net_lock);
+        deeplearn_ingest_free(ingest);
+        return -3;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets a function to be called on the learning thread after each
+ *        update of the learner
+ * @param ingest Ingest object
+ * @param learned The function, or NULL
+ * @param context Passed to the function
+ */
+void deeplearn_ingest_set_learned(deeplearn_ingest * ingest,
+                                  deeplearn_ingest_learned learned,
+                                  void * context)
+{
+    ingest->learned = learned;
+    ingest->learned_context = context;
+}
+
+/**
+ * @brief Sets a function to be called on the inference thread with the
+ *        outputs of each frame evaluated
+ * @param ingest Ingest object
+ * @param output The function, or NULL
+ * @param context Passed to the function
+ */
+void deeplearn_ingest_set_output(deeplearn_ingest * ingest,
+                                 deeplearn_ingest_output output,
+                                 void * context)
+{
+    ingest->output = output;
+    ingest->output_context = context;
+}
+
+/**
+ * @brief Sets the average change in input values from the previous frame
+ *        learned below which frames are not learned, so that a still
+ *        scene does not swamp the learner.  Zero learns every frame.
+ * @param ingest Ingest object
+ * @param min_change Minimum average change of an input value
+ */
+void deeplearn_ingest_set_min_change(deeplearn_ingest * ingest,
+                                     float min_change)
+{
+    ingest->min_change = min_change;
+}
+
+/**
+ * @brief Sets the number of learning updates between copies of the
+ *        network used by the inference thread
+ * @param ingest Ingest object
+ * @param interval The number of updates, at least one
+ */
+void deeplearn_ingest_set_sync_interval(deeplearn_ingest * ingest,
+                                        int interval)
+{
+    if (interval < 1) {
+        interval = 1;
+    }
+    ingest->sync_interval = interval;
+}
+
+/**
+ * @brief Starts the learning and inference threads
+ * @param ingest Ingest object
+ * @returns zero on success
+ */
+int deeplearn_ingest_start(deeplearn_ingest * ingest)
+{
+    deeplearn_ingest_threads * t = (deeplearn_ingest_threads*)ingest->threads;
+
+    if ((t == NULL) || (ingest->running != 0)) {
+        return -1;
+    }
+
+    if (ingest->flags & DEEPLEARN_INGEST_INFER) {
+        if (bp_clone(&t->net, ingest->learner->net) != 0) {
+            return -2;
+        }
+        t->net_valid = 1;
+        t->outputs = (float*)malloc(ingest->no_of_outputs*sizeof(float));
+        if ((t->outputs == NULL) ||
+            (bp_inference_init(&t->ctx, &t->net, 1) != 0)) {
+            return -2;
+        }
+    }
+
+    ingest->running = 1;
+    if (ingest->flags & DEEPLEARN_INGEST_LEARN) {
+        if (pthread_create(&t->learn_thread, NULL,
+                           ingest_learn, (void*)ingest) != 0) {
+            ingest->running = 0;
+            return -3;
+        }
+        t->learn_started = 1;
+    }
+    if (ingest->flags & DEEPLEARN_INGEST_INFER) {
+        if (pthread_create(&t->infer_thread, NULL,
+                           ingest_infer, (void*)ingest) != 0) {
+            return -3;
+        }
+        t->infer_started = 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts a captured frame into the ring, from where it is
+ *        learned and evaluated by the other threads.  If the ring is
+ *        full then the oldest frame not in use is dropped.  This never
+ *        waits for the learner, so it can be called from a capture loop
+ *        before the capture buffer is returned to the device.
+ * @param ingest Ingest object
+ * @param frame The captured frame, passed to the convert function
+ * @returns zero on success, or one if an earlier frame was dropped
+ */
+int deeplearn_ingest_push(deeplearn_ingest * ingest, const void * frame)
+{
+    deeplearn_ingest_threads * t = (deeplearn_ingest_threads*)ingest->threads;
+    int i, index = -1, dropped = 0, retval;
+
+    if (t == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    for (i = 0; i < ingest->capacity; i++) {
+        if ((ingest->pending[i] == 0) && (ingest->readers[i] == 0)) {
+            index = i;
+            break;
+        }
+    }
+    if (index == -1) {
+        /* drop the oldest frame which is not being read */
+        for (i = 0; i < ingest->capacity; i++) {
+            if ((ingest->readers[i] == 0) &&
+                ((index == -1) ||
+                 (ingest->sequence[i] < ingest->sequence[index]))) {
+                index = i;
+            }
+        }
+        if (index == -1) {
+            pthread_mutex_unlock(&t->lock);
+            return -2;
+        }
+        ingest->dropped++;
+        dropped = 1;
+    }
+    ingest->pending[index] = 0;
+    ingest->readers[index] = -1;
+    pthread_mutex_unlock(&t->lock);
+
+    retval = ingest->convert(ingest->convert_context, frame,
+                             ingest_inputs(ingest, index),
+                             ingest->no_of_inputs);
+
+    pthread_mutex_lock(&t->lock);
+    ingest->readers[index] = 0;
+    if (retval == 0) {
+        ingest->sequence[index] = ++ingest->captured;
+        ingest->pending[index] = ingest->flags;
+        pthread_cond_broadcast(&t->changed);
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    if (retval != 0) {
+        return -3;
+    }
+    return dropped;
+}
+
+/**
+ * @brief Waits until every frame captured so far has been learned,
+ *        evaluated or dropped.  Returns immediately if the threads have
+ *        not been started.
+ * @param ingest Ingest object
+ */
+void deeplearn_ingest_wait(deeplearn_ingest * ingest)
+{
+    deeplearn_ingest_threads * t = (deeplearn_ingest_threads*)ingest->threads;
+    int i, busy;
+
+    if ((t == NULL) || (ingest->running == 0)) {
+        return;
+    }
+
+    pthread_mutex_lock(&t->lock);
+    do {
+        busy = 0;
+        for (i = 0; i < ingest->capacity; i++) {
+            if ((ingest->pending[i] != 0) || (ingest->readers[i] != 0)) {
+                busy = 1;
+                break;
+            }
+        }
+        if (busy != 0) {
+            pthread_cond_wait(&t->changed, &t->lock);
+        }
+    } while (busy != 0);
+    pthread_mutex_unlock(&t->lock);
+}
+
+/**
+ * @brief Stops the threads and frees the ring.  Frames which have not
+ *        yet been learned are discarded.
+ * @param ingest Ingest object
+ */
+void deeplearn_ingest_free(deeplearn_ingest * ingest)
+{
+    deeplearn_ingest_threads * t = (deeplearn_ingest_threads*)ingest->threads;
+
+    if (t != NULL) {
+        if ((t->learn_started != 0) || (t->infer_started != 0)) {
+            pthread_mutex_lock(&t->lock);
+            ingest->running = 0;
+            pthread_cond_broadcast(&t->changed);
+            pthread_mutex_unlock(&t->lock);
+            if (t->learn_started != 0) {
+                pthread_join(t->learn_thread, NULL);
+            }
+            if (t->infer_started != 0) {
+                pthread_join(t->infer_thread, NULL);
+            }
+        }
+        if (ingest->buffer != NULL) {
+            /* the locks were created if the ring was allocated */
+            pthread_cond_destroy(&t->changed);
+            pthread_mutex_destroy(&t->lock);
+            pthread_mutex_destroy(&t->net_lock);
+        }
+        if (t->net_valid != 0) {
+            bp_inference_free(&t->ctx);
+            bp_free(&t->net);
+        }
+        free(t->outputs);
+        free(t);
+    }
+    free(ingest->buffer);
+    free(ingest->previous);
+    free(ingest->sequence);
+    free(ingest->pending);
+    free(ingest->readers);
+    memset((void*)ingest, '\0', sizeof(deeplearn_ingest));
+}
+
+/**
+ * @brief Converts a YUYV frame, as captured from V4L2 devices, into
+ *        network inputs taken from the luminance of every subsampled
+ *        pixel, read straight from the capture buffer
+ * @param context Frame layout, of type deeplearn_ingest_yuyv_format
+ * @param frame The captured frame
+ * @param inputs Returned input values in the range 0.25 to 0.75
+ * @param no_of_inputs The number of input values
+ * @returns zero on success
+ */
+int deeplearn_ingest_yuyv(void * context, const void * frame,
+                          float * inputs, int no_of_inputs)
+{
+    deeplearn_ingest_yuyv_format * format =
+        (deeplearn_ingest_yuyv_format*)context;
+    const unsigned char * pixels = (const unsigned char*)frame;
+    int x, y, w, h, i = 0, sub;
+
+    sub = format->subsampling;
+    if (sub < 1) {
+        sub = 1;
+    }
+    w = format->width / sub;
+    h = format->height / sub;
+    if (w*h < no_of_inputs) {
+        return -1;
+    }
+
+    for (y = 0; y < h; y++) {
+        const unsigned char * row = &pixels[y*sub*format->width*2];
+
+        for (x = 0; x < w; x++, i++) {
+            if (i >= no_of_inputs) {
+                return 0;
+            }
+            inputs[i] = 0.25f + (row[x*sub*2] / (255.0f*2));
+        }
+    }
+    return 0;
+}
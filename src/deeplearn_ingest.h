@@ -0,0 +1,143 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_INGEST_H
+#define DEEPLEARN_INGEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "deeplearn.h"
+
+/* default number of frames held between capture and the learner */
+#define DEEPLEARN_INGEST_CAPACITY 4
+
+/* what is done with each captured frame */
+#define DEEPLEARN_INGEST_LEARN 1
+#define DEEPLEARN_INGEST_INFER 2
+
+/* converts a captured frame, such as a buffer mapped from a camera,
+   into no_of_inputs network input values, returning zero on success */
+typedef int (*deeplearn_ingest_convert)(void * context, const void * frame,
+                                        float * inputs, int no_of_inputs);
+
+/* called on the learning thread after each update of the learner, where
+   it is safe to read the learner, for example to plot its history */
+typedef void (*deeplearn_ingest_learned)(void * context, deeplearn * learner,
+                                         unsigned long frame);
+
+/* called on the inference thread with the outputs for a frame */
+typedef void (*deeplearn_ingest_output)(void * context, unsigned long frame,
+                                        float * outputs, int no_of_outputs);
+
+/* Layout of frames with two bytes per pixel in YUYV order, as captured
+   from V4L2 devices, used with deeplearn_ingest_yuyv */
+struct deeplearn_ingest_yuyv_format {
+    int width;
+    int height;
+    int subsampling;
+};
+typedef struct deeplearn_ingest_yuyv_format deeplearn_ingest_yuyv_format;
+
+/* Frames passing from a capture thread to threads which learn from them
+   and evaluate them. Captured frames are converted straight into a ring
+   of input vectors, so the capture buffer can be returned to the device
+   immediately. If the learner falls behind then the oldest frame which
+   is not in use is overwritten, so capture never waits. The learning
+   thread takes frames in the order captured, while the inference thread
+   always takes the newest frame and evaluates it with a copy of the
+   network which is brought up to date every sync_interval updates. */
+struct deeplearn_ingest {
+    deeplearn * learner;
+    int capacity;
+    int no_of_inputs;
+    int no_of_outputs;
+    int flags;
+
+    /* input values of each frame, followed by its capture sequence
+       number, the uses still pending and the number of threads
+       reading it, or -1 while it is being written */
+    float * buffer;
+    unsigned long * sequence;
+    int * pending;
+    int * readers;
+
+    deeplearn_ingest_convert convert;
+    void * convert_context;
+    deeplearn_ingest_learned learned;
+    void * learned_context;
+    deeplearn_ingest_output output;
+    void * output_context;
+
+    /* frames whose average input change from the previous frame learned
+       is below this value are not learned */
+    float min_change;
+    float * previous;
+    int has_previous;
+
+    /* number of learning updates between copies of the network used
+       for inference */
+    int sync_interval;
+
+    unsigned long captured;
+    unsigned long dropped;
+    unsigned long learned_frames;
+    unsigned long unchanged_frames;
+    unsigned long inferred_frames;
+
+    int running;
+
+    /* threads, locks and the copy of the network used for inference,
+       which are private to deeplearn_ingest.c */
+    void * threads;
+};
+typedef struct deeplearn_ingest deeplearn_ingest;
+
+int deeplearn_ingest_init(deeplearn_ingest * ingest, deeplearn * learner,
+                          int capacity, int flags,
+                          deeplearn_ingest_convert convert, void * context);
+void deeplearn_ingest_set_learned(deeplearn_ingest * ingest,
+                                  deeplearn_ingest_learned learned,
+                                  void * context);
+void deeplearn_ingest_set_output(deeplearn_ingest * ingest,
+                                 deeplearn_ingest_output output,
+                                 void * context);
+void deeplearn_ingest_set_min_change(deeplearn_ingest * ingest,
+                                     float min_change);
+void deeplearn_ingest_set_sync_interval(deeplearn_ingest * ingest,
+                                        int interval);
+int deeplearn_ingest_start(deeplearn_ingest * ingest);
+int deeplearn_ingest_push(deeplearn_ingest * ingest, const void * frame);
+void deeplearn_ingest_wait(deeplearn_ingest * ingest);
+void deeplearn_ingest_free(deeplearn_ingest * ingest);
+int deeplearn_ingest_yuyv(void * context, const void * frame,
+                          float * inputs, int no_of_inputs);
+
+#endif
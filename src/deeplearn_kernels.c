@@ -0,0 +1,1510 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_kernels.h"
+#include "deeplearn_device.h"
+#include "deeplearn_threads.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define KERNEL_ARM
+#include <arm_neon.h>
+#endif
+
+#ifdef DEEPLEARN_CBLAS
+#include <cblas.h>
+#endif
+
+/* the currently selected implementations */
+static int kernel_isa = KERNEL_AUTO;
+static float (*kernel_dot_fn)(const float *, const float *, int);
+static void (*kernel_axpy_fn)(float *, float, const float *, int);
+static void (*kernel_weight_update_fn)(float *, float *, const float *,
+                                       float, float, int,
+                                       float *, float *);
+static void (*kernel_af_vector_fn)(int, float *, int);
+static float (*kernel_dot_f16_fn)(const uint16_t *, const float *, int);
+static float (*kernel_dot_bf16_fn)(const uint16_t *, const float *, int);
+static int32_t (*kernel_dot_u8i8_fn)(const uint8_t *, const int8_t *, int);
+
+/**
+ * @brief Dot product of two vectors
+ * @param a First vector
+ * @param b Second vector
+ * @param n Length of the vectors
+ * @returns The sum of the element-wise products
+ */
+static float kernel_dot_scalar(const float * a, const float * b, int n)
+{
+    int i;
+    float sum = 0;
+
+    for (i = 0; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief Adds a scaled vector to another vector, y = y + a.x
+ * @param y The vector to be updated
+ * @param a Scaling factor
+ * @param x The vector to be added
+ * @param n Length of the vectors
+ */
+static void kernel_axpy_scalar(float * y, float a, const float * x, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+/**
+ * @brief Updates a row of weights using the momentum style rule
+ *        used throughout the library, and tracks the weight range
+ * @param weights The weights to be updated
+ * @param lastWeightChange The previous weight changes
+ * @param x The values feeding into the weights
+ * @param e Learning rate scaled by the number of inputs
+ * @param gradient Error gradient of the unit
+ * @param n Number of weights
+ * @param min_weight Minimum weight, updated if not NULL
+ * @param max_weight Maximum weight, updated if not NULL
+ */
+static void kernel_weight_update_scalar(float * weights,
+                                        float * lastWeightChange,
+                                        const float * x,
+                                        float e, float gradient, int n,
+                                        float * min_weight,
+                                        float * max_weight)
+{
+    int i;
+    float min = 9999, max = -9999;
+
+    for (i = 0; i < n; i++) {
+        lastWeightChange[i] =
+            e * (lastWeightChange[i] + 1) * gradient * x[i];
+        weights[i] += lastWeightChange[i];
+        if (weights[i] < min) min = weights[i];
+        if (weights[i] > max) max = weights[i];
+    }
+
+    if (min_weight) {
+        if (min < *min_weight) *min_weight = min;
+    }
+    if (max_weight) {
+        if (max > *max_weight) *max_weight = max;
+    }
+}
+
+/**
+ * @brief Logistic function approximated using a rational approximation
+ *        of tanh, which is within about 0.01 of the logistic function
+ *        and avoids evaluating an exponential
+ * @param x Input value
+ * @returns Output in the range 0 -> 1
+ */
+static float kernel_fast_logistic(float x)
+{
+    float z = x * 0.5f, z2;
+
+    if (z > 3.0f) z = 3.0f;
+    if (z < -3.0f) z = -3.0f;
+    z2 = z * z;
+    return 0.5f + 0.5f * (z * (27.0f + z2) / (27.0f + 9.0f * z2));
+}
+
+/**
+ * @brief Applies an activation function to every element of a vector
+ * @param function Activation function, such as AF_RELU
+ * @param x The vector, which is updated in place
+ * @param n Length of the vector
+ */
+static void kernel_af_vector_scalar(int function, float * x, int n)
+{
+    int i;
+
+    switch(function) {
+    case AF_FAST_LOGISTIC: {
+        for (i = 0; i < n; i++) {
+            x[i] = kernel_fast_logistic(x[i]);
+        }
+        break;
+    }
+    case AF_TANH: {
+        for (i = 0; i < n; i++) {
+            x[i] = tanhf(x[i]);
+        }
+        break;
+    }
+    case AF_RELU: {
+        for (i = 0; i < n; i++) {
+            x[i] = (x[i] > 0) ? x[i] : 0;
+        }
+        break;
+    }
+    case AF_LEAKY_RELU: {
+        for (i = 0; i < n; i++) {
+            x[i] = (x[i] > 0) ? x[i] : x[i]*AF_LEAKY_RELU_SLOPE;
+        }
+        break;
+    }
+    default: {
+        for (i = 0; i < n; i++) {
+            x[i] = 1.0f / (1.0f + expf(-x[i]));
+        }
+        break;
+    }
+    }
+}
+
+static float kernel_dot_f16_scalar(const uint16_t * a, const float * b, int n)
+{
+    float sum = 0;
+
+    for (int i = 0; i < n; i++) {
+        sum += kernel_half_to_float(a[i]) * b[i];
+    }
+    return sum;
+}
+
+static float kernel_dot_bf16_scalar(const uint16_t * a, const float * b, int n)
+{
+    float sum = 0;
+
+    for (int i = 0; i < n; i++) {
+        sum += kernel_bf16_to_float(a[i]) * b[i];
+    }
+    return sum;
+}
+
+static int32_t kernel_dot_u8i8_scalar(const uint8_t * a, const int8_t * b, int n)
+{
+    int32_t sum = 0;
+
+    for (int i = 0; i < n; i++) {
+        sum += (int32_t)a[i] * (int32_t)b[i];
+    }
+    return sum;
+}
+
+#ifdef KERNEL_X86
+
+__attribute__((target("sse2")))
+static float kernel_hsum_sse(__m128 v)
+{
+    float s[4];
+
+    _mm_storeu_ps(s, v);
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+__attribute__((target("sse2")))
+static float kernel_dot_sse(const float * a, const float * b, int n)
+{
+    int i = 0;
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    float sum;
+
+    for (; i + 8 <= n; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(&a[i]),
+                                           _mm_loadu_ps(&b[i])));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(&a[i+4]),
+                                           _mm_loadu_ps(&b[i+4])));
+    }
+    sum = kernel_hsum_sse(_mm_add_ps(sum0, sum1));
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/* eight bit values are widened to sixteen bits so that pairs of
+   products can be summed into 32 bits without saturating */
+__attribute__((target("sse2")))
+static int32_t kernel_dot_u8i8_sse(const uint8_t * a, const int8_t * b, int n)
+{
+    int i = 0;
+    int32_t s[4];
+    __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)&a[i]);
+        __m128i w = _mm_loadu_si128((const __m128i*)&b[i]);
+        __m128i wlo = _mm_srai_epi16(_mm_unpacklo_epi8(w, w), 8);
+        __m128i whi = _mm_srai_epi16(_mm_unpackhi_epi8(w, w), 8);
+
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(x, zero), wlo));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(x, zero), whi));
+    }
+    _mm_storeu_si128((__m128i*)s, sum);
+    return s[0] + s[1] + s[2] + s[3] +
+        kernel_dot_u8i8_scalar(&a[i], &b[i], n - i);
+}
+
+__attribute__((target("sse2")))
+static void kernel_axpy_sse(float * y, float a, const float * x, int n)
+{
+    int i = 0;
+    __m128 av = _mm_set1_ps(a);
+
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(&y[i],
+                      _mm_add_ps(_mm_loadu_ps(&y[i]),
+                                 _mm_mul_ps(av, _mm_loadu_ps(&x[i]))));
+    }
+    for (; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+__attribute__((target("sse2")))
+static void kernel_weight_update_sse(float * weights,
+                                     float * lastWeightChange,
+                                     const float * x,
+                                     float e, float gradient, int n,
+                                     float * min_weight,
+                                     float * max_weight)
+{
+    int i = 0;
+    float s[4], min = 9999, max = -9999;
+    __m128 ev = _mm_set1_ps(e);
+    __m128 gv = _mm_set1_ps(gradient);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 minv = _mm_set1_ps(9999);
+    __m128 maxv = _mm_set1_ps(-9999);
+    __m128 dw, w;
+
+    for (; i + 4 <= n; i += 4) {
+        dw = _mm_add_ps(_mm_loadu_ps(&lastWeightChange[i]), one);
+        dw = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(ev, dw), gv),
+                        _mm_loadu_ps(&x[i]));
+        w = _mm_add_ps(_mm_loadu_ps(&weights[i]), dw);
+        _mm_storeu_ps(&lastWeightChange[i], dw);
+        _mm_storeu_ps(&weights[i], w);
+        minv = _mm_min_ps(minv, w);
+        maxv = _mm_max_ps(maxv, w);
+    }
+    _mm_storeu_ps(s, minv);
+    for (int j = 0; j < 4; j++) {
+        if (s[j] < min) min = s[j];
+    }
+    _mm_storeu_ps(s, maxv);
+    for (int j = 0; j < 4; j++) {
+        if (s[j] > max) max = s[j];
+    }
+
+    kernel_weight_update_scalar(&weights[i], &lastWeightChange[i], &x[i],
+                                e, gradient, n - i, &min, &max);
+    if (min_weight) {
+        if (min < *min_weight) *min_weight = min;
+    }
+    if (max_weight) {
+        if (max > *max_weight) *max_weight = max;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static float kernel_hsum_avx(__m256 v)
+{
+    return kernel_hsum_sse(_mm_add_ps(_mm256_castps256_ps128(v),
+                                      _mm256_extractf128_ps(v, 1)));
+}
+
+__attribute__((target("avx2,fma")))
+static float kernel_dot_avx2(const float * a, const float * b, int n)
+{
+    int i = 0;
+    __m256 sum0 = _mm256_setzero_ps();
+    __m256 sum1 = _mm256_setzero_ps();
+    float sum;
+
+    for (; i + 16 <= n; i += 16) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i]),
+                               _mm256_loadu_ps(&b[i]), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i+8]),
+                               _mm256_loadu_ps(&b[i+8]), sum1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(&a[i]),
+                               _mm256_loadu_ps(&b[i]), sum0);
+    }
+    sum = kernel_hsum_avx(_mm256_add_ps(sum0, sum1));
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void kernel_axpy_avx2(float * y, float a, const float * x, int n)
+{
+    int i = 0;
+    __m256 av = _mm256_set1_ps(a);
+
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(&y[i],
+                         _mm256_fmadd_ps(av, _mm256_loadu_ps(&x[i]),
+                                         _mm256_loadu_ps(&y[i])));
+    }
+    /* fused multiply-add for the remainder too, so that the result
+       for each element doesn't depend upon where the array starts */
+    for (; i < n; i++) {
+        y[i] = fmaf(a, x[i], y[i]);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void kernel_weight_update_avx2(float * weights,
+                                      float * lastWeightChange,
+                                      const float * x,
+                                      float e, float gradient, int n,
+                                      float * min_weight,
+                                      float * max_weight)
+{
+    int i = 0;
+    float s[8], min = 9999, max = -9999;
+    __m256 eg = _mm256_set1_ps(e * gradient);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 minv = _mm256_set1_ps(9999);
+    __m256 maxv = _mm256_set1_ps(-9999);
+    __m256 dw, w;
+
+    for (; i + 8 <= n; i += 8) {
+        dw = _mm256_add_ps(_mm256_loadu_ps(&lastWeightChange[i]), one);
+        dw = _mm256_mul_ps(_mm256_mul_ps(eg, dw), _mm256_loadu_ps(&x[i]));
+        w = _mm256_add_ps(_mm256_loadu_ps(&weights[i]), dw);
+        _mm256_storeu_ps(&lastWeightChange[i], dw);
+        _mm256_storeu_ps(&weights[i], w);
+        minv = _mm256_min_ps(minv, w);
+        maxv = _mm256_max_ps(maxv, w);
+    }
+    _mm256_storeu_ps(s, minv);
+    for (int j = 0; j < 8; j++) {
+        if (s[j] < min) min = s[j];
+    }
+    _mm256_storeu_ps(s, maxv);
+    for (int j = 0; j < 8; j++) {
+        if (s[j] > max) max = s[j];
+    }
+
+    kernel_weight_update_scalar(&weights[i], &lastWeightChange[i], &x[i],
+                                e, gradient, n - i, &min, &max);
+    if (min_weight) {
+        if (min < *min_weight) *min_weight = min;
+    }
+    if (max_weight) {
+        if (max > *max_weight) *max_weight = max;
+    }
+}
+
+/* The functions which can be evaluated using simple arithmetic are
+   vectorised, giving the same results as kernel_af_vector_scalar.
+   Other functions fall back to the scalar version. */
+__attribute__((target("avx2")))
+static void kernel_af_vector_avx2(int function, float * x, int n)
+{
+    int i = 0;
+    __m256 v, z, z2, zero = _mm256_setzero_ps();
+
+    switch(function) {
+    case AF_FAST_LOGISTIC: {
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 limit = _mm256_set1_ps(3.0f);
+        __m256 neg_limit = _mm256_set1_ps(-3.0f);
+        __m256 c27 = _mm256_set1_ps(27.0f);
+        __m256 c9 = _mm256_set1_ps(9.0f);
+
+        for (; i + 8 <= n; i += 8) {
+            z = _mm256_mul_ps(_mm256_loadu_ps(&x[i]), half);
+            z = _mm256_max_ps(_mm256_min_ps(z, limit), neg_limit);
+            z2 = _mm256_mul_ps(z, z);
+            v = _mm256_div_ps(_mm256_mul_ps(z, _mm256_add_ps(c27, z2)),
+                              _mm256_add_ps(c27, _mm256_mul_ps(c9, z2)));
+            _mm256_storeu_ps(&x[i],
+                             _mm256_add_ps(half, _mm256_mul_ps(half, v)));
+        }
+        break;
+    }
+    case AF_RELU: {
+        for (; i + 8 <= n; i += 8) {
+            _mm256_storeu_ps(&x[i],
+                             _mm256_max_ps(_mm256_loadu_ps(&x[i]), zero));
+        }
+        break;
+    }
+    case AF_LEAKY_RELU: {
+        __m256 slope = _mm256_set1_ps(AF_LEAKY_RELU_SLOPE);
+
+        for (; i + 8 <= n; i += 8) {
+            v = _mm256_loadu_ps(&x[i]);
+            _mm256_storeu_ps(&x[i],
+                             _mm256_blendv_ps(_mm256_mul_ps(v, slope), v,
+                                              _mm256_cmp_ps(v, zero,
+                                                            _CMP_GT_OQ)));
+        }
+        break;
+    }
+    }
+    kernel_af_vector_scalar(function, &x[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static int32_t kernel_hsum_epi32_avx2(__m256i v)
+{
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+static int32_t kernel_dot_u8i8_avx2(const uint8_t * a, const int8_t * b, int n)
+{
+    int i = 0;
+    __m256i sum = _mm256_setzero_si256();
+
+    for (; i + 16 <= n; i += 16) {
+        __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)&a[i]));
+        __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)&b[i]));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, w));
+    }
+    return kernel_hsum_epi32_avx2(sum) +
+        kernel_dot_u8i8_scalar(&a[i], &b[i], n - i);
+}
+
+/* multiplies unsigned by signed bytes and sums groups of four products
+   straight into 32 bits, in a single instruction */
+__attribute__((target("avx2,avxvnni")))
+static int32_t kernel_dot_u8i8_vnni(const uint8_t * a, const int8_t * b, int n)
+{
+    int i = 0;
+    __m256i sum = _mm256_setzero_si256();
+
+    for (; i + 32 <= n; i += 32) {
+        sum = _mm256_dpbusd_avx_epi32(sum,
+                                      _mm256_loadu_si256((const __m256i*)&a[i]),
+                                      _mm256_loadu_si256((const __m256i*)&b[i]));
+    }
+    return kernel_hsum_epi32_avx2(sum) +
+        kernel_dot_u8i8_scalar(&a[i], &b[i], n - i);
+}
+
+__attribute__((target("avx2,fma,f16c")))
+static float kernel_dot_f16_avx2(const uint16_t * a, const float * b, int n)
+{
+    int i = 0;
+    __m256 sum = _mm256_setzero_ps();
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 w = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)&a[i]));
+        sum = _mm256_fmadd_ps(w, _mm256_loadu_ps(&b[i]), sum);
+    }
+    return kernel_hsum_avx(sum) + kernel_dot_f16_scalar(&a[i], &b[i], n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static float kernel_dot_bf16_avx2(const uint16_t * a, const float * b, int n)
+{
+    int i = 0;
+    __m256 sum = _mm256_setzero_ps();
+
+    for (; i + 8 <= n; i += 8) {
+        /* a bfloat16 is the upper half of a float */
+        __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)&a[i]));
+        __m256 w = _mm256_castsi256_ps(_mm256_slli_epi32(v, 16));
+        sum = _mm256_fmadd_ps(w, _mm256_loadu_ps(&b[i]), sum);
+    }
+    return kernel_hsum_avx(sum) + kernel_dot_bf16_scalar(&a[i], &b[i], n - i);
+}
+
+__attribute__((target("avx512f")))
+static float kernel_dot_avx512(const float * a, const float * b, int n)
+{
+    int i = 0;
+    __m512 sum0 = _mm512_setzero_ps();
+    __m512 sum1 = _mm512_setzero_ps();
+    float sum;
+
+    for (; i + 32 <= n; i += 32) {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(&a[i]),
+                               _mm512_loadu_ps(&b[i]), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_loadu_ps(&a[i+16]),
+                               _mm512_loadu_ps(&b[i+16]), sum1);
+    }
+    for (; i + 16 <= n; i += 16) {
+        sum0 = _mm512_fmadd_ps(_mm512_loadu_ps(&a[i]),
+                               _mm512_loadu_ps(&b[i]), sum0);
+    }
+    sum = _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+static void kernel_axpy_avx512(float * y, float a, const float * x, int n)
+{
+    int i = 0;
+    __m512 av = _mm512_set1_ps(a);
+
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(&y[i],
+                         _mm512_fmadd_ps(av, _mm512_loadu_ps(&x[i]),
+                                         _mm512_loadu_ps(&y[i])));
+    }
+    /* fused multiply-add for the remainder too, so that the result
+       for each element doesn't depend upon where the array starts */
+    for (; i < n; i++) {
+        y[i] = fmaf(a, x[i], y[i]);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void kernel_weight_update_avx512(float * weights,
+                                        float * lastWeightChange,
+                                        const float * x,
+                                        float e, float gradient, int n,
+                                        float * min_weight,
+                                        float * max_weight)
+{
+    int i = 0;
+    float min, max;
+    __m512 eg = _mm512_set1_ps(e * gradient);
+    __m512 one = _mm512_set1_ps(1.0f);
+    __m512 minv = _mm512_set1_ps(9999);
+    __m512 maxv = _mm512_set1_ps(-9999);
+    __m512 dw, w;
+
+    for (; i + 16 <= n; i += 16) {
+        dw = _mm512_add_ps(_mm512_loadu_ps(&lastWeightChange[i]), one);
+        dw = _mm512_mul_ps(_mm512_mul_ps(eg, dw), _mm512_loadu_ps(&x[i]));
+        w = _mm512_add_ps(_mm512_loadu_ps(&weights[i]), dw);
+        _mm512_storeu_ps(&lastWeightChange[i], dw);
+        _mm512_storeu_ps(&weights[i], w);
+        minv = _mm512_min_ps(minv, w);
+        maxv = _mm512_max_ps(maxv, w);
+    }
+    min = _mm512_reduce_min_ps(minv);
+    max = _mm512_reduce_max_ps(maxv);
+
+    kernel_weight_update_scalar(&weights[i], &lastWeightChange[i], &x[i],
+                                e, gradient, n - i, &min, &max);
+    if (min_weight) {
+        if (min < *min_weight) *min_weight = min;
+    }
+    if (max_weight) {
+        if (max > *max_weight) *max_weight = max;
+    }
+}
+
+__attribute__((target("avx512f")))
+static float kernel_dot_f16_avx512(const uint16_t * a, const float * b, int n)
+{
+    int i = 0;
+    __m512 sum = _mm512_setzero_ps();
+
+    for (; i + 16 <= n; i += 16) {
+        __m512 w = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)&a[i]));
+        sum = _mm512_fmadd_ps(w, _mm512_loadu_ps(&b[i]), sum);
+    }
+    return _mm512_reduce_add_ps(sum) +
+        kernel_dot_f16_scalar(&a[i], &b[i], n - i);
+}
+
+__attribute__((target("avx512f")))
+static float kernel_dot_bf16_avx512(const uint16_t * a, const float * b, int n)
+{
+    int i = 0;
+    __m512 sum = _mm512_setzero_ps();
+
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)&a[i]));
+        __m512 w = _mm512_castsi512_ps(_mm512_slli_epi32(v, 16));
+        sum = _mm512_fmadd_ps(w, _mm512_loadu_ps(&b[i]), sum);
+    }
+    return _mm512_reduce_add_ps(sum) +
+        kernel_dot_bf16_scalar(&a[i], &b[i], n - i);
+}
+
+#endif
+
+#ifdef KERNEL_ARM
+
+static float kernel_hsum_neon(float32x4_t v)
+{
+    float s[4];
+
+    vst1q_f32(s, v);
+    return (s[0] + s[1]) + (s[2] + s[3]);
+}
+
+static float kernel_dot_neon(const float * a, const float * b, int n)
+{
+    int i = 0;
+    float32x4_t sum0 = vdupq_n_f32(0);
+    float32x4_t sum1 = vdupq_n_f32(0);
+    float sum;
+
+    for (; i + 8 <= n; i += 8) {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(&a[i]), vld1q_f32(&b[i]));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(&a[i+4]), vld1q_f32(&b[i+4]));
+    }
+    sum = kernel_hsum_neon(vaddq_f32(sum0, sum1));
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static int32_t kernel_dot_u8i8_neon(const uint8_t * a, const int8_t * b, int n)
+{
+    int i = 0;
+    int32x4_t sum = vdupq_n_s32(0);
+
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(&a[i])));
+        int16x8_t w = vmovl_s8(vld1_s8(&b[i]));
+        sum = vmlal_s16(sum, vget_low_s16(x), vget_low_s16(w));
+        sum = vmlal_s16(sum, vget_high_s16(x), vget_high_s16(w));
+    }
+    return vgetq_lane_s32(sum, 0) + vgetq_lane_s32(sum, 1) +
+        vgetq_lane_s32(sum, 2) + vgetq_lane_s32(sum, 3) +
+        kernel_dot_u8i8_scalar(&a[i], &b[i], n - i);
+}
+
+static void kernel_axpy_neon(float * y, float a, const float * x, int n)
+{
+    int i = 0;
+    float32x4_t av = vdupq_n_f32(a);
+
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(&y[i], vmlaq_f32(vld1q_f32(&y[i]), av, vld1q_f32(&x[i])));
+    }
+    for (; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+static void kernel_weight_update_neon(float * weights,
+                                      float * lastWeightChange,
+                                      const float * x,
+                                      float e, float gradient, int n,
+                                      float * min_weight,
+                                      float * max_weight)
+{
+    int i = 0;
+    float s[4], min = 9999, max = -9999;
+    float32x4_t eg = vdupq_n_f32(e * gradient);
+    float32x4_t one = vdupq_n_f32(1.0f);
+    float32x4_t minv = vdupq_n_f32(9999);
+    float32x4_t maxv = vdupq_n_f32(-9999);
+    float32x4_t dw, w;
+
+    for (; i + 4 <= n; i += 4) {
+        dw = vaddq_f32(vld1q_f32(&lastWeightChange[i]), one);
+        dw = vmulq_f32(vmulq_f32(eg, dw), vld1q_f32(&x[i]));
+        w = vaddq_f32(vld1q_f32(&weights[i]), dw);
+        vst1q_f32(&lastWeightChange[i], dw);
+        vst1q_f32(&weights[i], w);
+        minv = vminq_f32(minv, w);
+        maxv = vmaxq_f32(maxv, w);
+    }
+    vst1q_f32(s, minv);
+    for (int j = 0; j < 4; j++) {
+        if (s[j] < min) min = s[j];
+    }
+    vst1q_f32(s, maxv);
+    for (int j = 0; j < 4; j++) {
+        if (s[j] > max) max = s[j];
+    }
+
+    kernel_weight_update_scalar(&weights[i], &lastWeightChange[i], &x[i],
+                                e, gradient, n - i, &min, &max);
+    if (min_weight) {
+        if (min < *min_weight) *min_weight = min;
+    }
+    if (max_weight) {
+        if (max > *max_weight) *max_weight = max;
+    }
+}
+
+#endif
+
+/**
+ * @brief Returns a non-zero value if the given instruction set
+ *        can be used on this machine
+ * @param isa Instruction set, such as KERNEL_AVX2
+ * @returns 1 if supported, 0 otherwise
+ */
+int kernel_supported(int isa)
+{
+    switch(isa) {
+    case KERNEL_SCALAR: return 1;
+#ifdef KERNEL_X86
+    case KERNEL_SSE: {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2") ? 1 : 0;
+    }
+    case KERNEL_AVX2: {
+        __builtin_cpu_init();
+        return (__builtin_cpu_supports("avx2") &&
+                __builtin_cpu_supports("fma")) ? 1 : 0;
+    }
+    case KERNEL_AVX512: {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx512f") ? 1 : 0;
+    }
+#endif
+#ifdef KERNEL_ARM
+    case KERNEL_NEON: return 1;
+#endif
+    }
+    return 0;
+}
+
+/**
+ * @brief Selects the instruction set used by the kernels
+ * @param isa Instruction set, or KERNEL_AUTO to pick the best
+ *        one available on this machine
+ * @returns The selected instruction set, or -1 if the requested
+ *          instruction set is not supported
+ */
+int kernel_select(int isa)
+{
+    if (isa == KERNEL_AUTO) {
+        if (kernel_supported(KERNEL_AVX512)) {
+            isa = KERNEL_AVX512;
+        }
+        else if (kernel_supported(KERNEL_AVX2)) {
+            isa = KERNEL_AVX2;
+        }
+        else if (kernel_supported(KERNEL_SSE)) {
+            isa = KERNEL_SSE;
+        }
+        else if (kernel_supported(KERNEL_NEON)) {
+            isa = KERNEL_NEON;
+        }
+        else {
+            isa = KERNEL_SCALAR;
+        }
+    }
+
+    if (!kernel_supported(isa)) {
+        return -1;
+    }
+
+    switch(isa) {
+#ifdef KERNEL_X86
+    case KERNEL_SSE: {
+        kernel_dot_fn = kernel_dot_sse;
+        kernel_axpy_fn = kernel_axpy_sse;
+        kernel_weight_update_fn = kernel_weight_update_sse;
+        kernel_af_vector_fn = kernel_af_vector_scalar;
+        kernel_dot_f16_fn = kernel_dot_f16_scalar;
+        kernel_dot_bf16_fn = kernel_dot_bf16_scalar;
+        kernel_dot_u8i8_fn = kernel_dot_u8i8_sse;
+        break;
+    }
+    case KERNEL_AVX2: {
+        kernel_dot_fn = kernel_dot_avx2;
+        kernel_axpy_fn = kernel_axpy_avx2;
+        kernel_weight_update_fn = kernel_weight_update_avx2;
+        kernel_af_vector_fn = kernel_af_vector_avx2;
+        kernel_dot_f16_fn = __builtin_cpu_supports("f16c") ?
+            kernel_dot_f16_avx2 : kernel_dot_f16_scalar;
+        kernel_dot_bf16_fn = kernel_dot_bf16_avx2;
+        kernel_dot_u8i8_fn = __builtin_cpu_supports("avxvnni") ?
+            kernel_dot_u8i8_vnni : kernel_dot_u8i8_avx2;
+        break;
+    }
+    case KERNEL_AVX512: {
+        kernel_dot_fn = kernel_dot_avx512;
+        kernel_axpy_fn = kernel_axpy_avx512;
+        kernel_weight_update_fn = kernel_weight_update_avx512;
+        kernel_af_vector_fn = kernel_af_vector_avx2;
+        kernel_dot_f16_fn = kernel_dot_f16_avx512;
+        kernel_dot_bf16_fn = kernel_dot_bf16_avx512;
+        kernel_dot_u8i8_fn = __builtin_cpu_supports("avxvnni") ?
+            kernel_dot_u8i8_vnni : kernel_dot_u8i8_avx2;
+        break;
+    }
+#endif
+#ifdef KERNEL_ARM
+    case KERNEL_NEON: {
+        kernel_dot_fn = kernel_dot_neon;
+        kernel_axpy_fn = kernel_axpy_neon;
+        kernel_weight_update_fn = kernel_weight_update_neon;
+        kernel_af_vector_fn = kernel_af_vector_scalar;
+        kernel_dot_f16_fn = kernel_dot_f16_scalar;
+        kernel_dot_bf16_fn = kernel_dot_bf16_scalar;
+        kernel_dot_u8i8_fn = kernel_dot_u8i8_neon;
+        break;
+    }
+#endif
+    default: {
+        kernel_dot_fn = kernel_dot_scalar;
+        kernel_axpy_fn = kernel_axpy_scalar;
+        kernel_weight_update_fn = kernel_weight_update_scalar;
+        kernel_af_vector_fn = kernel_af_vector_scalar;
+        kernel_dot_f16_fn = kernel_dot_f16_scalar;
+        kernel_dot_bf16_fn = kernel_dot_bf16_scalar;
+        kernel_dot_u8i8_fn = kernel_dot_u8i8_scalar;
+        break;
+    }
+    }
+
+    kernel_isa = isa;
+    return isa;
+}
+
+/**
+ * @brief Returns the instruction set currently used by the kernels
+ * @returns Instruction set, such as KERNEL_AVX2
+ */
+int kernel_get_isa(void)
+{
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+    return kernel_isa;
+}
+
+/**
+ * @brief Returns a human readable name for an instruction set
+ * @param isa Instruction set, such as KERNEL_AVX2
+ * @returns Name of the instruction set
+ */
+const char * kernel_isa_name(int isa)
+{
+    switch(isa) {
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_SSE: return "sse";
+    case KERNEL_AVX2: return "avx2";
+    case KERNEL_AVX512: return "avx512";
+    case KERNEL_NEON: return "neon";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Dot product of two vectors
+ * @param a First vector
+ * @param b Second vector
+ * @param n Length of the vectors
+ * @returns The sum of the element-wise products
+ */
+float kernel_dot(const float * a, const float * b, int n)
+{
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+    return kernel_dot_fn(a, b, n);
+}
+
+/**
+ * @brief Adds a scaled vector to another vector, y = y + a.x
+ * @param y The vector to be updated
+ * @param a Scaling factor
+ * @param x The vector to be added
+ * @param n Length of the vectors
+ */
+void kernel_axpy(float * y, float a, const float * x, int n)
+{
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+    kernel_axpy_fn(y, a, x, n);
+}
+
+/**
+ * @brief Updates a row of weights and tracks the weight range.
+ *        Each weight change is e.(last change + 1).gradient.x
+ * @param weights The weights to be updated
+ * @param lastWeightChange The previous weight changes
+ * @param x The values feeding into the weights
+ * @param e Learning rate scaled by the number of inputs
+ * @param gradient Error gradient of the unit
+ * @param n Number of weights
+ * @param min_weight Minimum weight, updated if not NULL
+ * @param max_weight Maximum weight, updated if not NULL
+ */
+void kernel_weight_update(float * weights, float * lastWeightChange,
+                          const float * x, float e, float gradient, int n,
+                          float * min_weight, float * max_weight)
+{
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+    kernel_weight_update_fn(weights, lastWeightChange, x,
+                            e, gradient, n, min_weight, max_weight);
+}
+
+/**
+ * @brief Dot product of a sparse vector with a dense one.  Gathers
+ *        don't vectorise well on most targets, so there is only a
+ *        scalar version
+ * @param values The non-zero values of the sparse vector
+ * @param column Index within the dense vector of each value
+ * @param x The dense vector
+ * @param n Number of non-zero values
+ * @returns The sum of the products
+ */
+float kernel_sparse_dot(const float * values, const int * column,
+                        const float * x, int n)
+{
+    int i;
+    float sum = 0;
+
+    for (i = 0; i < n; i++) {
+        sum += values[i] * x[column[i]];
+    }
+    return sum;
+}
+
+/**
+ * @brief Adds a scaled sparse vector to a dense vector, y = y + a.x
+ * @param y The dense vector to be updated
+ * @param a Scaling factor
+ * @param values The non-zero values of the sparse vector
+ * @param column Index within the dense vector of each value
+ * @param n Number of non-zero values
+ */
+void kernel_sparse_axpy(float * y, float a, const float * values,
+                        const int * column, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        y[column[i]] += a * values[i];
+    }
+}
+
+/**
+ * @brief Updates the live weights of a sparse row in the same way as
+ *        kernel_weight_update.  The dense row of weights is kept in
+ *        step with the packed values
+ * @param values The packed live weights
+ * @param column Index within the dense row of each live weight
+ * @param weights The dense row of weights
+ * @param lastWeightChange The previous weight changes of the dense row
+ * @param x The values feeding into the dense row
+ * @param e Learning rate scaled by the number of inputs
+ * @param gradient Error gradient of the unit
+ * @param n Number of live weights
+ * @param min_weight Minimum weight, updated if not NULL
+ * @param max_weight Maximum weight, updated if not NULL
+ */
+void kernel_sparse_weight_update(float * values, const int * column,
+                                 float * weights, float * lastWeightChange,
+                                 const float * x, float e, float gradient,
+                                 int n, float * min_weight,
+                                 float * max_weight)
+{
+    int i, c;
+    float min = 9999, max = -9999;
+
+    for (i = 0; i < n; i++) {
+        c = column[i];
+        lastWeightChange[c] =
+            e * (lastWeightChange[c] + 1) * gradient * x[c];
+        values[i] += lastWeightChange[c];
+        weights[c] = values[i];
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+
+    if (min_weight) {
+        if (min < *min_weight) *min_weight = min;
+    }
+    if (max_weight) {
+        if (max > *max_weight) *max_weight = max;
+    }
+}
+
+/**
+ * @brief Matrix-vector product, y = A.x, where A is row major.  Rows are
+ *        evaluated in parallel when the matrix is large.
+ *        If compiled with DEEPLEARN_CBLAS then cblas_sgemv is used instead.
+ * @param m Number of rows of A and length of y
+ * @param n Number of columns of A and length of x
+ * @param a Matrix of m x n values
+ * @param x Vector of n values
+ * @param y Returned vector of m values
+ */
+void kernel_gemv(int m, int n, const float * a, const float * x, float * y)
+{
+#ifdef DEEPLEARN_CBLAS
+    cblas_sgemv(CblasRowMajor, CblasNoTrans, m, n, 1.0f, a, n, x, 1,
+                0.0f, y, 1);
+#else
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+
+#pragma omp parallel for num_threads(threads_count()) if ((double)m*n >= KERNEL_GEMM_PARALLEL_MIN)
+    for (int i = 0; i < m; i++) {
+        y[i] = kernel_dot_fn(&a[i*n], x, n);
+    }
+#endif
+}
+
+/**
+ * @brief Matrix multiply with the second matrix transposed, C = A.B^T
+ *        All matrices are row major. A block of rows of A is multiplied
+ *        with a block of rows of B at a time so that both stay in cache,
+ *        and row blocks of C are evaluated in parallel.
+ *        If compiled with DEEPLEARN_CBLAS then cblas_sgemm is used instead.
+ *        Large products are evaluated on the device if one is selected
+ *        with device_select.
+ * @param m Number of rows of A and C
+ * @param n Number of rows of B and columns of C
+ * @param k Number of columns of A and B
+ * @param a First matrix of m x k values
+ * @param b Second matrix of n x k values
+ * @param c Returned matrix of m x n values
+ */
+void kernel_gemm_nt(int m, int n, int k,
+                    const float * a, const float * b, float * c)
+{
+    kernel_gemm_nt_weights(m, n, k, a, b, 0, c);
+}
+
+/**
+ * @brief Matrix multiply with the second matrix transposed, C = A.B^T,
+ *        as kernel_gemm_nt where B is a matrix of weights.  If the
+ *        product is evaluated on a device then the weights are held
+ *        there until their generation changes.
+ * @param m Number of rows of A and C
+ * @param n Number of rows of B and columns of C
+ * @param k Number of columns of A and B
+ * @param a First matrix of m x k values
+ * @param b Second matrix of n x k weights
+ * @param generation Generation of the weights from device_weights_changed
+ * @param c Returned matrix of m x n values
+ */
+void kernel_gemm_nt_weights(int m, int n, int k,
+                            const float * a, const float * b,
+                            unsigned int generation, float * c)
+{
+    if (device_gemm_nt(m, n, k, a, b, generation, c) == 0) {
+        return;
+    }
+
+#ifdef DEEPLEARN_CBLAS
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans,
+                m, n, k, 1.0f, a, k, b, k, 0.0f, c, n);
+#else
+    int row_blocks = (m + KERNEL_GEMM_BLOCK_ROWS - 1) / KERNEL_GEMM_BLOCK_ROWS;
+
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+
+#pragma omp parallel for num_threads(threads_count()) schedule(dynamic) if ((double)m*n*k >= KERNEL_GEMM_PARALLEL_MIN)
+    for (int rb = 0; rb < row_blocks; rb++) {
+        int i0 = rb * KERNEL_GEMM_BLOCK_ROWS;
+        int i1 = i0 + KERNEL_GEMM_BLOCK_ROWS;
+        if (i1 > m) i1 = m;
+
+        for (int j0 = 0; j0 < n; j0 += KERNEL_GEMM_BLOCK_COLS) {
+            int j1 = j0 + KERNEL_GEMM_BLOCK_COLS;
+            if (j1 > n) j1 = n;
+
+            for (int i = i0; i < i1; i++) {
+                const float * row_a = &a[i*k];
+                float * row_c = &c[i*n];
+                for (int j = j0; j < j1; j++) {
+                    row_c[j] = kernel_dot_fn(row_a, &b[j*k], k);
+                }
+            }
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Evaluates an activation function
+ * @param function Activation function, such as AF_LOGISTIC
+ * @param x Input value
+ * @returns Output of the activation function
+ */
+float kernel_af(int function, float x)
+{
+    switch(function) {
+    case AF_FAST_LOGISTIC: return kernel_fast_logistic(x);
+    case AF_TANH: return tanhf(x);
+    case AF_RELU: return (x > 0) ? x : 0;
+    case AF_LEAKY_RELU: return (x > 0) ? x : x*AF_LEAKY_RELU_SLOPE;
+    }
+    return 1.0f / (1.0f + expf(-x));
+}
+
+/**
+ * @brief Derivative of an activation function, expressed in terms of
+ *        its output so that only the output of each unit needs to
+ *        be stored
+ * @param function Activation function, such as AF_LOGISTIC
+ * @param y Output of the activation function
+ * @returns Derivative at the given output value
+ */
+float kernel_af_derivative(int function, float y)
+{
+    switch(function) {
+    case AF_TANH: return 1.0f - (y * y);
+    case AF_RELU: return (y > 0) ? 1.0f : 0.0f;
+    case AF_LEAKY_RELU: return (y > 0) ? 1.0f : AF_LEAKY_RELU_SLOPE;
+    }
+    /* the fast approximation uses the same derivative as the
+       logistic function */
+    return y * (1.0f - y);
+}
+
+/**
+ * @brief Applies an activation function to every element of a vector
+ * @param function Activation function, such as AF_RELU
+ * @param x The vector, which is updated in place
+ * @param n Length of the vector
+ */
+void kernel_af_vector(int function, float * x, int n)
+{
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+    kernel_af_vector_fn(function, x, n);
+}
+
+/**
+ * @brief Returns a human readable name for an activation function
+ * @param function Activation function, such as AF_RELU
+ * @returns Name of the activation function
+ */
+const char * kernel_af_name(int function)
+{
+    switch(function) {
+    case AF_LOGISTIC: return "logistic";
+    case AF_FAST_LOGISTIC: return "fast logistic";
+    case AF_TANH: return "tanh";
+    case AF_RELU: return "relu";
+    case AF_LEAKY_RELU: return "leaky relu";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Converts a float to IEEE half precision, rounding to the
+ *        nearest even value
+ * @param value The value to be converted
+ * @returns Half precision value
+ */
+uint16_t kernel_float_to_half(float value)
+{
+    uint32_t x, mant, remainder, halfway;
+    uint16_t sign, half;
+    int exponent, shift;
+
+    memcpy(&x, &value, sizeof(uint32_t));
+    sign = (uint16_t)((x >> 16) & 0x8000);
+    mant = x & 0x7fffff;
+
+    /* infinity or not a number */
+    if (((x >> 23) & 0xff) == 0xff) {
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+    }
+
+    exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+    if (exponent >= 31) {
+        /* too large, so becomes infinity */
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0) {
+        /* subnormal or zero */
+        if (exponent < -10) return sign;
+        mant |= 0x800000;
+        shift = 14 - exponent;
+        half = (uint16_t)(mant >> shift);
+        remainder = mant & ((1U << shift) - 1);
+        halfway = 1U << (shift - 1);
+        if ((remainder > halfway) ||
+            ((remainder == halfway) && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    half = sign | (uint16_t)(exponent << 10) | (uint16_t)(mant >> 13);
+    remainder = mant & 0x1fff;
+    if ((remainder > 0x1000) || ((remainder == 0x1000) && (half & 1))) {
+        /* a carry into the exponent is still correctly rounded */
+        half++;
+    }
+    return half;
+}
+
+/**
+ * @brief Converts an IEEE half precision value to a float
+ * @param value Half precision value
+ * @returns The value as a float
+ */
+float kernel_half_to_float(uint16_t value)
+{
+    uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mant = value & 0x3ff;
+    uint32_t x;
+    float result;
+
+    if (exponent == 0) {
+        /* zero or subnormal */
+        result = mant * (1.0f / 16777216.0f);
+        return sign ? -result : result;
+    }
+    if (exponent == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    }
+    else {
+        x = sign | ((exponent + 112) << 23) | (mant << 13);
+    }
+    memcpy(&result, &x, sizeof(float));
+    return result;
+}
+
+/**
+ * @brief Converts a float to bfloat16, rounding to the nearest even value
+ * @param value The value to be converted
+ * @returns bfloat16 value
+ */
+uint16_t kernel_float_to_bf16(float value)
+{
+    uint32_t x;
+
+    memcpy(&x, &value, sizeof(uint32_t));
+    if ((x & 0x7fffffff) > 0x7f800000) {
+        /* keep not a number quiet rather than rounding to infinity */
+        return (uint16_t)((x >> 16) | 0x40);
+    }
+    x += 0x7fff + ((x >> 16) & 1);
+    return (uint16_t)(x >> 16);
+}
+
+/**
+ * @brief Converts a bfloat16 value to a float
+ * @param value bfloat16 value
+ * @returns The value as a float
+ */
+float kernel_bf16_to_float(uint16_t value)
+{
+    uint32_t x = (uint32_t)value << 16;
+    float result;
+
+    memcpy(&result, &x, sizeof(float));
+    return result;
+}
+
+/**
+ * @brief Converts an array of floats to a reduced precision
+ * @param precision KERNEL_FP16 or KERNEL_BF16
+ * @param src Values to be converted
+ * @param dest Returned reduced precision values
+ * @param n Number of values
+ */
+void kernel_to_reduced(int precision, const float * src,
+                       uint16_t * dest, int n)
+{
+    if (precision == KERNEL_BF16) {
+        for (int i = 0; i < n; i++) {
+            dest[i] = kernel_float_to_bf16(src[i]);
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        dest[i] = kernel_float_to_half(src[i]);
+    }
+}
+
+/**
+ * @brief Converts an array of reduced precision values to floats
+ * @param precision KERNEL_FP16 or KERNEL_BF16
+ * @param src Reduced precision values
+ * @param dest Returned floats
+ * @param n Number of values
+ */
+void kernel_from_reduced(int precision, const uint16_t * src,
+                         float * dest, int n)
+{
+    if (precision == KERNEL_BF16) {
+        for (int i = 0; i < n; i++) {
+            dest[i] = kernel_bf16_to_float(src[i]);
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        dest[i] = kernel_half_to_float(src[i]);
+    }
+}
+
+/**
+ * @brief Dot product of a reduced precision vector, such as a row of
+ *        weights, with a float vector.  The products are accumulated
+ *        as floats.
+ * @param precision KERNEL_FP16 or KERNEL_BF16
+ * @param a Reduced precision vector
+ * @param b Float vector
+ * @param n Length of the vectors
+ * @returns The sum of the element-wise products
+ */
+float kernel_dot_reduced(int precision, const uint16_t * a,
+                         const float * b, int n)
+{
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+    if (precision == KERNEL_BF16) {
+        return kernel_dot_bf16_fn(a, b, n);
+    }
+    return kernel_dot_f16_fn(a, b, n);
+}
+
+/**
+ * @brief Dot product of unsigned eight bit values, such as quantised
+ *        activations, with signed eight bit values such as quantised
+ *        weights.  The products are accumulated as 32 bit integers,
+ *        using the VNNI instructions if they are available.
+ * @param a Unsigned eight bit vector
+ * @param b Signed eight bit vector
+ * @param n Length of the vectors
+ * @returns The sum of the element-wise products
+ */
+int32_t kernel_dot_u8i8(const uint8_t * a, const int8_t * b, int n)
+{
+    if (kernel_isa == KERNEL_AUTO) {
+        kernel_select(KERNEL_AUTO);
+    }
+    return kernel_dot_u8i8_fn(a, b, n);
+}
+
+/**
+ * @brief Quantises floats to unsigned eight bit values with the given
+ *        scale and zero point, such that a value is approximately
+ *        (quantised - zero)*scale.  Values outside of the range are
+ *        clipped.
+ * @param src Values to be quantised
+ * @param dest Returned quantised values
+ * @param n Number of values
+ * @param scale Size of one quantisation step
+ * @param zero Quantised value which represents zero
+ */
+void kernel_quantise_u8(const float * src, uint8_t * dest, int n,
+                        float scale, int zero)
+{
+    float inverse = (scale > 0) ? 1.0f / scale : 0;
+
+    for (int i = 0; i < n; i++) {
+        int q = (int)floorf(src[i]*inverse + 0.5f) + zero;
+        if (q < 0) q = 0;
+        if (q > 255) q = 255;
+        dest[i] = (uint8_t)q;
+    }
+}
+
+/**
+ * @brief Quantises floats to signed eight bit values in the range
+ *        -127 to 127, such that a value is approximately
+ *        quantised*scale
+ * @param src Values to be quantised
+ * @param dest Returned quantised values
+ * @param n Number of values
+ * @param scale Size of one quantisation step
+ * @returns The sum of the quantised values
+ */
+int32_t kernel_quantise_s8(const float * src, int8_t * dest, int n,
+                           float scale)
+{
+    float inverse = (scale > 0) ? 1.0f / scale : 0;
+    int32_t sum = 0;
+
+    for (int i = 0; i < n; i++) {
+        int q = (int)floorf(src[i]*inverse + 0.5f);
+        if (q < -127) q = -127;
+        if (q > 127) q = 127;
+        dest[i] = (int8_t)q;
+        sum += q;
+    }
+    return sum;
+}
+
+/**
+ * @brief Returns the scale and zero point used to quantise values
+ *        within the given range to unsigned eight bits.  Ranges which
+ *        are never negative use all 256 levels, otherwise zero is
+ *        placed in the middle.
+ * @param minimum Minimum value
+ * @param maximum Maximum value
+ * @param scale Returned size of one quantisation step
+ * @param zero Returned quantised value which represents zero
+ */
+void kernel_quantise_range(float minimum, float maximum,
+                           float * scale, int * zero)
+{
+    if (minimum >= 0) {
+        *zero = 0;
+        *scale = maximum / 255.0f;
+    }
+    else {
+        *zero = 128;
+        *scale = ((-minimum > maximum) ? -minimum : maximum) / 127.0f;
+    }
+    if (*scale <= 0) *scale = 1;
+}
+
+/**
+ * @brief Returns a human readable name for a weight precision
+ * @param precision Precision, such as KERNEL_FP16
+ * @returns Name of the precision
+ */
+const char * kernel_precision_name(int precision)
+{
+    switch(precision) {
+    case KERNEL_FP32: return "fp32";
+    case KERNEL_FP16: return "fp16";
+    case KERNEL_BF16: return "bf16";
+    case KERNEL_INT8: return "int8";
+    }
+    return "unknown";
+}
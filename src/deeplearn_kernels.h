@@ -0,0 +1,120 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_KERNELS_H
+#define DEEPLEARN_KERNELS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
+
+/* instruction sets which the kernels may be dispatched to */
+#define KERNEL_AUTO    -1
+#define KERNEL_SCALAR   0
+#define KERNEL_SSE      1
+#define KERNEL_AVX2     2
+#define KERNEL_AVX512   3
+#define KERNEL_NEON     4
+
+/* tile dimensions used by the matrix multiply */
+#define KERNEL_GEMM_BLOCK_ROWS  64
+#define KERNEL_GEMM_BLOCK_COLS  16
+
+/* minimum number of multiplies before a matrix multiply
+   is evaluated in parallel */
+#define KERNEL_GEMM_PARALLEL_MIN 65536
+
+/* activation functions */
+#define AF_LOGISTIC       0
+#define AF_FAST_LOGISTIC  1
+#define AF_TANH           2
+#define AF_RELU           3
+#define AF_LEAKY_RELU     4
+#define AF_FUNCTIONS      5
+
+/* gradient of the leaky ReLU for negative inputs */
+#define AF_LEAKY_RELU_SLOPE 0.01f
+
+/* storage precision of weights used for inference */
+#define KERNEL_FP32       0
+#define KERNEL_FP16       1
+#define KERNEL_BF16       2
+#define KERNEL_INT8       3
+#define KERNEL_PRECISIONS 4
+
+int kernel_select(int isa);
+int kernel_get_isa(void);
+int kernel_supported(int isa);
+const char * kernel_isa_name(int isa);
+float kernel_dot(const float * a, const float * b, int n);
+void kernel_axpy(float * y, float a, const float * x, int n);
+void kernel_weight_update(float * weights, float * lastWeightChange,
+                          const float * x, float e, float gradient, int n,
+                          float * min_weight, float * max_weight);
+float kernel_sparse_dot(const float * values, const int * column,
+                        const float * x, int n);
+void kernel_sparse_axpy(float * y, float a, const float * values,
+                        const int * column, int n);
+void kernel_sparse_weight_update(float * values, const int * column,
+                                 float * weights, float * lastWeightChange,
+                                 const float * x, float e, float gradient,
+                                 int n, float * min_weight,
+                                 float * max_weight);
+void kernel_gemv(int m, int n, const float * a, const float * x, float * y);
+void kernel_gemm_nt(int m, int n, int k,
+                    const float * a, const float * b, float * c);
+void kernel_gemm_nt_weights(int m, int n, int k,
+                            const float * a, const float * b,
+                            unsigned int generation, float * c);
+float kernel_af(int function, float x);
+float kernel_af_derivative(int function, float y);
+void kernel_af_vector(int function, float * x, int n);
+const char * kernel_af_name(int function);
+uint16_t kernel_float_to_half(float value);
+float kernel_half_to_float(uint16_t value);
+uint16_t kernel_float_to_bf16(float value);
+float kernel_bf16_to_float(uint16_t value);
+void kernel_to_reduced(int precision, const float * src,
+                       uint16_t * dest, int n);
+void kernel_from_reduced(int precision, const uint16_t * src,
+                         float * dest, int n);
+float kernel_dot_reduced(int precision, const uint16_t * a,
+                         const float * b, int n);
+int32_t kernel_dot_u8i8(const uint8_t * a, const int8_t * b, int n);
+void kernel_quantise_u8(const float * src, uint8_t * dest, int n,
+                        float scale, int zero);
+int32_t kernel_quantise_s8(const float * src, int8_t * dest, int n,
+                           float scale);
+void kernel_quantise_range(float minimum, float maximum,
+                           float * scale, int * zero);
+const char * kernel_precision_name(int precision);
+
+#endif
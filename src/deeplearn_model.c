@@ -0,0 +1,1416 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* memory mapping is part of POSIX rather than C99 */
+#define _POSIX_C_SOURCE 200809L
+
+#include "deeplearn_model.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MODEL_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* round up to the next aligned offset */
+#define MODEL_ALIGN(offset) \
+    (((offset) + MODEL_ALIGNMENT - 1) & ~((uint64_t)MODEL_ALIGNMENT - 1))
+
+/**
+ * @brief Writes a blob at the given offset, padding with zeros
+ *        from the current position
+ * @param fp File pointer
+ * @param position Current position within the file, which is updated
+ * @param offset Offset at which the blob begins
+ * @param data The blob
+ * @param size Size of the blob in bytes
+ * @returns zero on success
+ */
+static int model_write_blob(FILE * fp, uint64_t * position,
+                            uint64_t offset, const void * data,
+                            uint64_t size)
+{
+    unsigned char padding[MODEL_ALIGNMENT];
+
+    memset((void*)padding, '\0', MODEL_ALIGNMENT);
+    if (offset - *position > MODEL_ALIGNMENT) {
+        return -1;
+    }
+    if (offset > *position) {
+        if (fwrite(padding, 1, offset - *position, fp) != offset - *position) {
+            return -2;
+        }
+    }
+    if (size > 0) {
+        if (fwrite(data, 1, size, fp) != size) {
+            return -3;
+        }
+    }
+    *position = offset + size;
+    return 0;
+}
+
+/**
+ * @brief Writes a network and optional normalisation ranges to a model file
+ * @param filename Filename to save as
+ * @param net Backprop neural net
+ * @param input_range_min Minimum input field values, or NULL
+ * @param input_range_max Maximum input field values, or NULL
+ * @param output_range_min Minimum output field values, or NULL
+ * @param output_range_max Maximum output field values, or NULL
+ * @param precision Precision at which weights are stored, such as KERNEL_FP16
+ * @returns zero on success
+ */
+static int model_write(char * filename, bp * net,
+                       float * input_range_min, float * input_range_max,
+                       float * output_range_min, float * output_range_max,
+                       int precision)
+{
+    int l, i, s, retval = 0;
+    int no_of_layers = net->HiddenLayers+1;
+    int sections_per_layer = 2;
+    int no_of_sections;
+    uint64_t offset, position;
+    model_header header;
+    model_network network;
+    model_section * sections;
+    float * bias;
+    uint16_t * reduced;
+    uint32_t weights_type = MODEL_SECTION_WEIGHTS;
+    uint64_t weight_size = sizeof(float);
+    FILE * fp;
+
+    if ((precision < 0) || (precision >= KERNEL_PRECISIONS)) {
+        return -1;
+    }
+    if (precision == KERNEL_FP16) {
+        weights_type = MODEL_SECTION_WEIGHTS_FP16;
+        weight_size = sizeof(uint16_t);
+    }
+    if (precision == KERNEL_BF16) {
+        weights_type = MODEL_SECTION_WEIGHTS_BF16;
+        weight_size = sizeof(uint16_t);
+    }
+    if (precision == KERNEL_INT8) {
+        /* the network must already have been quantised */
+        for (l = 0; l < no_of_layers; l++) {
+            if (net->layer[l+1].quant == 0) {
+                return -1;
+            }
+        }
+        weights_type = MODEL_SECTION_WEIGHTS_INT8;
+        weight_size = sizeof(int8_t);
+        sections_per_layer = 4;
+    }
+
+    no_of_sections = 1 + (no_of_layers*sections_per_layer);
+    if (input_range_min) {
+        no_of_sections += 2;
+    }
+
+    sections = (model_section*)malloc(no_of_sections*sizeof(model_section));
+    if (!sections) {
+        return -1;
+    }
+    memset((void*)sections, '\0', no_of_sections*sizeof(model_section));
+
+    memset((void*)&network, '\0', sizeof(model_network));
+    network.NoOfInputs = net->NoOfInputs;
+    network.NoOfHiddens = net->NoOfHiddens;
+    network.NoOfOutputs = net->NoOfOutputs;
+    network.HiddenLayers = net->HiddenLayers;
+    network.learningRate = net->learningRate;
+    network.noise = net->noise;
+    network.DropoutPercent = net->DropoutPercent;
+    network.BPerrorAverage = net->BPerrorAverage;
+    network.itterations = net->itterations;
+    network.activation = net->activation;
+
+    /* lay out the sections after the header and section table */
+    offset = MODEL_ALIGN(sizeof(model_header) +
+                         no_of_sections*sizeof(model_section));
+    s = 0;
+    sections[s].type = MODEL_SECTION_NETWORK;
+    sections[s].rows = 1;
+    sections[s].cols = sizeof(model_network);
+    sections[s].size = sizeof(model_network);
+    sections[s].offset = offset;
+    offset = MODEL_ALIGN(offset + sections[s++].size);
+    for (l = 0; l < no_of_layers; l++) {
+        bp_layer * layer = &net->layer[l+1];
+
+        sections[s].type = weights_type;
+        sections[s].layer = l;
+        sections[s].rows = layer->NoOfUnits;
+        sections[s].cols = layer->NoOfInputs;
+        sections[s].size =
+            (uint64_t)layer->NoOfUnits*layer->NoOfInputs*weight_size;
+        sections[s].offset = offset;
+        offset = MODEL_ALIGN(offset + sections[s++].size);
+
+        if (precision == KERNEL_INT8) {
+            sections[s].type = MODEL_SECTION_WEIGHT_SCALE;
+            sections[s].layer = l;
+            sections[s].rows = 1;
+            sections[s].cols = layer->NoOfUnits;
+            sections[s].size = (uint64_t)layer->NoOfUnits*sizeof(float);
+            sections[s].offset = offset;
+            offset = MODEL_ALIGN(offset + sections[s++].size);
+
+            sections[s].type = MODEL_SECTION_INPUT_QUANT;
+            sections[s].layer = l;
+            sections[s].rows = 1;
+            sections[s].cols = 2;
+            sections[s].size = (uint64_t)2*sizeof(float);
+            sections[s].offset = offset;
+            offset = MODEL_ALIGN(offset + sections[s++].size);
+        }
+
+        sections[s].type = MODEL_SECTION_BIAS;
+        sections[s].layer = l;
+        sections[s].rows = 1;
+        sections[s].cols = layer->NoOfUnits;
+        sections[s].size = (uint64_t)layer->NoOfUnits*sizeof(float);
+        sections[s].offset = offset;
+        offset = MODEL_ALIGN(offset + sections[s++].size);
+    }
+    if (input_range_min) {
+        sections[s].type = MODEL_SECTION_INPUT_RANGE;
+        sections[s].rows = 2;
+        sections[s].cols = net->NoOfInputs;
+        sections[s].size = (uint64_t)2*net->NoOfInputs*sizeof(float);
+        sections[s].offset = offset;
+        offset = MODEL_ALIGN(offset + sections[s++].size);
+
+        sections[s].type = MODEL_SECTION_OUTPUT_RANGE;
+        sections[s].rows = 2;
+        sections[s].cols = net->NoOfOutputs;
+        sections[s].size = (uint64_t)2*net->NoOfOutputs*sizeof(float);
+        sections[s].offset = offset;
+        offset = MODEL_ALIGN(offset + sections[s++].size);
+    }
+
+    memset((void*)&header, '\0', sizeof(model_header));
+    memcpy((void*)header.magic, MODEL_MAGIC, 8);
+    header.version = MODEL_VERSION;
+    header.endian = MODEL_ENDIAN_TAG;
+    header.header_size = sizeof(model_header);
+    header.no_of_sections = no_of_sections;
+    header.file_size = offset;
+
+    fp = fopen(filename, "wb");
+    if (!fp) {
+        free(sections);
+        return -2;
+    }
+
+    if ((fwrite(&header, sizeof(model_header), 1, fp) != 1) ||
+        (fwrite(sections, sizeof(model_section), no_of_sections, fp) !=
+         (size_t)no_of_sections)) {
+        retval = -3;
+    }
+    position = sizeof(model_header) + no_of_sections*sizeof(model_section);
+
+    for (s = 0; (s < no_of_sections) && (retval == 0); s++) {
+        switch(sections[s].type) {
+        case MODEL_SECTION_NETWORK: {
+            if (model_write_blob(fp, &position, sections[s].offset,
+                                 &network, sections[s].size) != 0) {
+                retval = -4;
+            }
+            break;
+        }
+        case MODEL_SECTION_WEIGHTS: {
+            if (model_write_blob(fp, &position, sections[s].offset,
+                                 net->layer[sections[s].layer+1].weights,
+                                 sections[s].size) != 0) {
+                retval = -5;
+            }
+            break;
+        }
+        case MODEL_SECTION_WEIGHTS_FP16:
+        case MODEL_SECTION_WEIGHTS_BF16: {
+            bp_layer * layer = &net->layer[sections[s].layer+1];
+
+            reduced = (uint16_t*)malloc(sections[s].size);
+            if (!reduced) {
+                retval = -5;
+                break;
+            }
+            kernel_to_reduced(precision, layer->weights, reduced,
+                              layer->NoOfUnits*layer->NoOfInputs);
+            if (model_write_blob(fp, &position, sections[s].offset,
+                                 reduced, sections[s].size) != 0) {
+                retval = -5;
+            }
+            free(reduced);
+            break;
+        }
+        case MODEL_SECTION_WEIGHTS_INT8: {
+            if (model_write_blob(fp, &position, sections[s].offset,
+                                 net->layer[sections[s].layer+1].quant->weights,
+                                 sections[s].size) != 0) {
+                retval = -5;
+            }
+            break;
+        }
+        case MODEL_SECTION_WEIGHT_SCALE: {
+            if (model_write_blob(fp, &position, sections[s].offset,
+                                 net->layer[sections[s].layer+1].quant->scale,
+                                 sections[s].size) != 0) {
+                retval = -5;
+            }
+            break;
+        }
+        case MODEL_SECTION_INPUT_QUANT: {
+            bp_quant * quant = net->layer[sections[s].layer+1].quant;
+            float input_quant[2];
+
+            input_quant[0] = quant->input_scale;
+            input_quant[1] = (float)quant->input_zero;
+            if (model_write_blob(fp, &position, sections[s].offset,
+                                 input_quant, sections[s].size) != 0) {
+                retval = -5;
+            }
+            break;
+        }
+        case MODEL_SECTION_BIAS: {
+            bp_layer * layer = &net->layer[sections[s].layer+1];
+
+            bias = (float*)malloc(layer->NoOfUnits*sizeof(float));
+            if (!bias) {
+                retval = -6;
+                break;
+            }
+            for (i = 0; i < layer->NoOfUnits; i++) {
+                bias[i] = layer->units[i].bias;
+            }
+            if (model_write_blob(fp, &position, sections[s].offset,
+                                 bias, sections[s].size) != 0) {
+                retval = -7;
+            }
+            free(bias);
+            break;
+        }
+        case MODEL_SECTION_INPUT_RANGE: {
+            if ((model_write_blob(fp, &position, sections[s].offset,
+                                  input_range_min,
+                                  sections[s].size/2) != 0) ||
+                (model_write_blob(fp, &position, position,
+                                  input_range_max,
+                                  sections[s].size/2) != 0)) {
+                retval = -8;
+            }
+            break;
+        }
+        case MODEL_SECTION_OUTPUT_RANGE: {
+            if ((model_write_blob(fp, &position, sections[s].offset,
+                                  output_range_min,
+                                  sections[s].size/2) != 0) ||
+                (model_write_blob(fp, &position, position,
+                                  output_range_max,
+                                  sections[s].size/2) != 0)) {
+                retval = -8;
+            }
+            break;
+        }
+        }
+    }
+
+    /* pad to the end of the final section */
+    if ((retval == 0) &&
+        (model_write_blob(fp, &position, offset, NULL, 0) != 0)) {
+        retval = -9;
+    }
+
+    fclose(fp);
+    free(sections);
+    return retval;
+}
+
+/**
+ * @brief Saves a backprop neural net as a model file
+ * @param filename Filename to save as
+ * @param net Backprop neural net
+ * @returns zero on success
+ */
+int model_save_bp(char * filename, bp * net)
+{
+    return model_write(filename, net, NULL, NULL, NULL, NULL, KERNEL_FP32);
+}
+
+/**
+ * @brief Saves a backprop neural net as a model file with its weights
+ *        stored at the given precision.  Biases and normalisation
+ *        ranges are always stored as floats.
+ * @param filename Filename to save as
+ * @param net Backprop neural net
+ * @param precision KERNEL_FP32, KERNEL_FP16, KERNEL_BF16, or KERNEL_INT8
+ *        if the network has been quantised with bp_quantise
+ * @returns zero on success
+ */
+int model_save_bp_precision(char * filename, bp * net, int precision)
+{
+    return model_write(filename, net, NULL, NULL, NULL, NULL, precision);
+}
+
+/**
+ * @brief Saves a deep learner as a model file, including the ranges
+ *        used to normalise its input and output fields
+ * @param filename Filename to save as
+ * @param learner Deep learner object
+ * @returns zero on success
+ */
+int model_save_deeplearn(char * filename, deeplearn * learner)
+{
+    return model_write(filename, learner->net,
+                       learner->input_range_min, learner->input_range_max,
+                       learner->output_range_min, learner->output_range_max,
+                       KERNEL_FP32);
+}
+
+/**
+ * @brief Saves a deep learner as a model file with its weights stored
+ *        at the given precision
+ * @param filename Filename to save as
+ * @param learner Deep learner object
+ * @param precision KERNEL_FP32, KERNEL_FP16, KERNEL_BF16, or KERNEL_INT8
+ *        if the network has been quantised
+ * @returns zero on success
+ */
+int model_save_deeplearn_precision(char * filename, deeplearn * learner,
+                                   int precision)
+{
+    return model_write(filename, learner->net,
+                       learner->input_range_min, learner->input_range_max,
+                       learner->output_range_min, learner->output_range_max,
+                       precision);
+}
+
+/**
+ * @brief Allocates the per layer arrays of a model, with every layer
+ *        initially having no weights
+ * @param model Model object with no_of_layers set
+ * @returns zero on success
+ */
+static int model_alloc_layers(deeplearn_model * model)
+{
+    int l;
+
+    model->layer_units = (int*)malloc(model->no_of_layers*sizeof(int));
+    model->layer_inputs = (int*)malloc(model->no_of_layers*sizeof(int));
+    model->weights =
+        (const float**)malloc(model->no_of_layers*sizeof(float*));
+    model->bias =
+        (const float**)malloc(model->no_of_layers*sizeof(float*));
+    model->weights_reduced =
+        (const uint16_t**)malloc(model->no_of_layers*sizeof(uint16_t*));
+    model->weights_int8 =
+        (const int8_t**)malloc(model->no_of_layers*sizeof(int8_t*));
+    model->weight_scale =
+        (const float**)malloc(model->no_of_layers*sizeof(float*));
+    model->input_quant =
+        (const float**)malloc(model->no_of_layers*sizeof(float*));
+    model->row_sum =
+        (int32_t**)malloc(model->no_of_layers*sizeof(int32_t*));
+    if ((!model->layer_units) || (!model->layer_inputs) ||
+        (!model->weights) || (!model->bias) || (!model->weights_reduced) ||
+        (!model->weights_int8) || (!model->weight_scale) ||
+        (!model->input_quant) || (!model->row_sum)) {
+        return -1;
+    }
+    for (l = 0; l < model->no_of_layers; l++) {
+        model->weights[l] = NULL;
+        model->bias[l] = NULL;
+        model->weights_reduced[l] = NULL;
+        model->weights_int8[l] = NULL;
+        model->weight_scale[l] = NULL;
+        model->input_quant[l] = NULL;
+        model->row_sum[l] = NULL;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks the header and section table of a model and sets
+ *        pointers to the weights within it
+ * @param model Model object whose data has been loaded
+ * @returns zero on success
+ */
+static int model_parse(deeplearn_model * model)
+{
+    const unsigned char * data = (const unsigned char*)model->data;
+    const model_header * header = (const model_header*)data;
+    const model_section * sections;
+    const model_network * network;
+    uint32_t s;
+    int l;
+
+    if (model->size < sizeof(model_header)) {
+        return -3;
+    }
+    if (memcmp(header->magic, MODEL_MAGIC, 8) != 0) {
+        return -3;
+    }
+    if (header->endian != MODEL_ENDIAN_TAG) {
+        return -4;
+    }
+    if (header->version != MODEL_VERSION) {
+        return -5;
+    }
+    if ((header->header_size != sizeof(model_header)) ||
+        (header->file_size != model->size) ||
+        (header->no_of_sections >
+         (model->size - sizeof(model_header))/sizeof(model_section))) {
+        return -6;
+    }
+
+    /* check that every section lies within the file */
+    sections = (const model_section*)&data[sizeof(model_header)];
+    for (s = 0; s < header->no_of_sections; s++) {
+        if ((sections[s].offset % MODEL_ALIGNMENT != 0) ||
+            (sections[s].offset > model->size) ||
+            (sections[s].size > model->size - sections[s].offset)) {
+            return -6;
+        }
+        if ((sections[s].type == MODEL_SECTION_WEIGHTS_FP16) ||
+            (sections[s].type == MODEL_SECTION_WEIGHTS_BF16)) {
+            if (sections[s].size !=
+                (uint64_t)sections[s].rows*sections[s].cols*sizeof(uint16_t)) {
+                return -6;
+            }
+        }
+        else if (sections[s].type == MODEL_SECTION_WEIGHTS_INT8) {
+            if (sections[s].size !=
+                (uint64_t)sections[s].rows*sections[s].cols*sizeof(int8_t)) {
+                return -6;
+            }
+        }
+        else if ((sections[s].type != MODEL_SECTION_NETWORK) &&
+                 (sections[s].size !=
+                  (uint64_t)sections[s].rows*sections[s].cols*sizeof(float))) {
+            return -6;
+        }
+    }
+
+    for (s = 0; s < header->no_of_sections; s++) {
+        if (sections[s].type == MODEL_SECTION_NETWORK) {
+            break;
+        }
+    }
+    if ((s == header->no_of_sections) ||
+        (sections[s].size != sizeof(model_network))) {
+        return -7;
+    }
+    network = (const model_network*)&data[sections[s].offset];
+    if ((network->NoOfInputs < 1) || (network->NoOfOutputs < 1) ||
+        (network->HiddenLayers < 1) ||
+        (network->activation < 0) || (network->activation >= AF_FUNCTIONS)) {
+        return -7;
+    }
+
+    model->network = network;
+    model->no_of_layers = network->HiddenLayers+1;
+    if (model_alloc_layers(model) != 0) {
+        return -8;
+    }
+    model->precision = KERNEL_FP32;
+
+    for (s = 0; s < header->no_of_sections; s++) {
+        const float * blob = (const float*)&data[sections[s].offset];
+        l = (int)sections[s].layer;
+
+        switch(sections[s].type) {
+        case MODEL_SECTION_WEIGHTS: {
+            if (l >= model->no_of_layers) {
+                return -9;
+            }
+            model->weights[l] = blob;
+            model->layer_units[l] = (int)sections[s].rows;
+            model->layer_inputs[l] = (int)sections[s].cols;
+            break;
+        }
+        case MODEL_SECTION_WEIGHTS_FP16:
+        case MODEL_SECTION_WEIGHTS_BF16: {
+            int precision =
+                (sections[s].type == MODEL_SECTION_WEIGHTS_FP16) ?
+                KERNEL_FP16 : KERNEL_BF16;
+
+            /* all layers have the same precision */
+            if ((l >= model->no_of_layers) ||
+                ((model->precision != KERNEL_FP32) &&
+                 (model->precision != precision))) {
+                return -9;
+            }
+            model->precision = precision;
+            model->weights_reduced[l] =
+                (const uint16_t*)&data[sections[s].offset];
+            model->layer_units[l] = (int)sections[s].rows;
+            model->layer_inputs[l] = (int)sections[s].cols;
+            break;
+        }
+        case MODEL_SECTION_WEIGHTS_INT8: {
+            if ((l >= model->no_of_layers) ||
+                ((model->precision != KERNEL_FP32) &&
+                 (model->precision != KERNEL_INT8))) {
+                return -9;
+            }
+            model->precision = KERNEL_INT8;
+            model->weights_int8[l] =
+                (const int8_t*)&data[sections[s].offset];
+            model->layer_units[l] = (int)sections[s].rows;
+            model->layer_inputs[l] = (int)sections[s].cols;
+            break;
+        }
+        case MODEL_SECTION_WEIGHT_SCALE: {
+            if (l >= model->no_of_layers) {
+                return -9;
+            }
+            model->weight_scale[l] = blob;
+            break;
+        }
+        case MODEL_SECTION_INPUT_QUANT: {
+            if ((l >= model->no_of_layers) || (sections[s].cols != 2)) {
+                return -9;
+            }
+            model->input_quant[l] = blob;
+            break;
+        }
+        case MODEL_SECTION_BIAS: {
+            if (l >= model->no_of_layers) {
+                return -9;
+            }
+            model->bias[l] = blob;
+            break;
+        }
+        case MODEL_SECTION_INPUT_RANGE: {
+            if ((sections[s].rows != 2) ||
+                (sections[s].cols != (uint32_t)network->NoOfInputs)) {
+                return -9;
+            }
+            model->input_range = blob;
+            break;
+        }
+        case MODEL_SECTION_OUTPUT_RANGE: {
+            if ((sections[s].rows != 2) ||
+                (sections[s].cols != (uint32_t)network->NoOfOutputs)) {
+                return -9;
+            }
+            model->output_range = blob;
+            break;
+        }
+        }
+    }
+
+    /* check that the layers connect together */
+    for (l = 0; l < model->no_of_layers; l++) {
+        const model_section * bias_section = NULL;
+        const model_section * scale_section = NULL;
+
+        if ((!model->bias[l]) ||
+            ((model->precision == KERNEL_FP32) && (!model->weights[l])) ||
+            (((model->precision == KERNEL_FP16) ||
+              (model->precision == KERNEL_BF16)) &&
+             ((!model->weights_reduced[l]) || (model->weights[l]))) ||
+            ((model->precision == KERNEL_INT8) &&
+             ((!model->weights_int8[l]) || (!model->weight_scale[l]) ||
+              (!model->input_quant[l]) || (model->weights[l]) ||
+              (model->weights_reduced[l])))) {
+            return -9;
+        }
+        for (s = 0; s < header->no_of_sections; s++) {
+            if ((int)sections[s].layer != l) continue;
+            if (sections[s].type == MODEL_SECTION_BIAS) {
+                bias_section = &sections[s];
+            }
+            if (sections[s].type == MODEL_SECTION_WEIGHT_SCALE) {
+                scale_section = &sections[s];
+            }
+        }
+        if (bias_section->cols != (uint32_t)model->layer_units[l]) {
+            return -9;
+        }
+        if ((model->precision == KERNEL_INT8) &&
+            (scale_section->cols != (uint32_t)model->layer_units[l])) {
+            return -9;
+        }
+        if (model->layer_inputs[l] !=
+            ((l == 0) ? network->NoOfInputs : model->layer_units[l-1])) {
+            return -9;
+        }
+    }
+    if (model->layer_units[model->no_of_layers-1] != network->NoOfOutputs) {
+        return -9;
+    }
+
+    /* sums of each row of eight bit weights, which remove the zero
+       point of the quantised inputs from the integer dot products */
+    if (model->precision == KERNEL_INT8) {
+        size_t total = 0, offset = 0;
+        int i, j;
+
+        for (l = 0; l < model->no_of_layers; l++) {
+            total += (size_t)model->layer_units[l];
+        }
+        model->row_sum_allocation = (int32_t*)malloc(total*sizeof(int32_t));
+        if (!model->row_sum_allocation) {
+            return -8;
+        }
+        for (l = 0; l < model->no_of_layers; l++) {
+            model->row_sum[l] = &model->row_sum_allocation[offset];
+            for (i = 0; i < model->layer_units[l]; i++) {
+                const int8_t * w =
+                    &model->weights_int8[l][i*model->layer_inputs[l]];
+                model->row_sum[l][i] = 0;
+                for (j = 0; j < model->layer_inputs[l]; j++) {
+                    model->row_sum[l][i] += w[j];
+                }
+            }
+            offset += model->layer_units[l];
+        }
+    }
+    return 0;
+}
+
+#ifdef MODEL_MMAP
+/**
+ * @brief Maps the whole of an open file or shared memory object
+ *        read only, then closes the file descriptor
+ * @param fd File descriptor
+ * @param model Model object which is given the mapping
+ * @returns zero on success
+ */
+static int model_map(int fd, deeplearn_model * model)
+{
+    struct stat st;
+
+    if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+        close(fd);
+        return -1;
+    }
+    model->size = (size_t)st.st_size;
+    model->data = mmap(NULL, model->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (model->data == MAP_FAILED) {
+        model->data = NULL;
+        return -1;
+    }
+    model->mapped = 1;
+    return 0;
+}
+#endif
+
+/**
+ * @brief Opens a model file. Where possible the file is memory mapped
+ *        and the weights are used directly from the mapping.
+ * @param filename Filename of the model
+ * @param model Returned model object
+ * @returns zero on success
+ */
+int model_open(char * filename, deeplearn_model * model)
+{
+    int retval;
+
+    memset((void*)model, '\0', sizeof(deeplearn_model));
+
+#ifdef MODEL_MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (model_map(fd, model) != 0) {
+        return -2;
+    }
+#else
+    long size;
+    FILE * fp = fopen(filename, "rb");
+    if (!fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return -2;
+    }
+    model->size = (size_t)size;
+
+    /* read in a single call into an aligned buffer */
+    model->allocation = malloc(model->size + MODEL_ALIGNMENT);
+    if (!model->allocation) {
+        fclose(fp);
+        return -2;
+    }
+    model->data = (void*)MODEL_ALIGN((uintptr_t)model->allocation);
+    if (fread(model->data, 1, model->size, fp) != model->size) {
+        fclose(fp);
+        model_close(model);
+        return -2;
+    }
+    fclose(fp);
+#endif
+
+    retval = model_parse(model);
+    if (retval != 0) {
+        model_close(model);
+    }
+    return retval;
+}
+
+/**
+ * @brief Attaches to a model which was published into named shared
+ *        memory by shared_publish.  The weights are used directly from
+ *        the shared pages, so many processes serving the same model
+ *        hold a single copy of it.
+ * @param name Name of the shared memory object
+ * @param model Returned model object
+ * @returns zero on success
+ */
+int model_attach(char * name, deeplearn_model * model)
+{
+    int retval;
+
+    memset((void*)model, '\0', sizeof(deeplearn_model));
+
+#ifdef MODEL_MMAP
+    int fd = shared_open(name);
+    if (fd < 0) {
+        return -1;
+    }
+    if (model_map(fd, model) != 0) {
+        return -2;
+    }
+#else
+    return -1;
+#endif
+
+    retval = model_parse(model);
+    if (retval != 0) {
+        model_close(model);
+    }
+    return retval;
+}
+
+/**
+ * @brief Closes a model, unmapping or freeing its data
+ * @param model Model object
+ */
+void model_close(deeplearn_model * model)
+{
+#ifdef MODEL_MMAP
+    if ((model->mapped != 0) && (model->data)) {
+        munmap(model->data, model->size);
+    }
+#endif
+    free(model->allocation);
+    free(model->layer_units);
+    free(model->layer_inputs);
+    free((void*)model->weights);
+    free((void*)model->bias);
+    free((void*)model->weights_reduced);
+    free(model->reduced_allocation);
+    free((void*)model->weights_int8);
+    free((void*)model->weight_scale);
+    free((void*)model->input_quant);
+    free(model->row_sum);
+    free(model->row_sum_allocation);
+    memset((void*)model, '\0', sizeof(deeplearn_model));
+}
+
+/**
+ * @brief Moves forward within a file without reading
+ * @param fp File pointer
+ * @param floats The number of 32 bit values to skip over
+ * @returns zero on success
+ */
+static int model_skip(FILE * fp, long floats)
+{
+    return fseek(fp, floats*(long)sizeof(float), SEEK_CUR);
+}
+
+/**
+ * @brief Skips over the optimiser saved after a network or autocoder,
+ *        together with any second moments
+ * @param fp File pointer
+ * @param parameters The number of weights and biases
+ * @returns zero on success
+ */
+static int model_skip_optimiser(FILE * fp, long parameters)
+{
+    deeplearn_optimiser optimiser;
+
+    if (optimiser_load(fp, &optimiser) != 0) {
+        return -1;
+    }
+    if (optimiser_second_moment(&optimiser)) {
+        return model_skip(fp, parameters);
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads a network saved with bp_save into a model, keeping only
+ *        the weights and biases which feed forward needs.  The weight
+ *        changes used for momentum and the state of the optimiser are
+ *        skipped over rather than loaded.
+ *        Everything is held within a single allocation.
+ * @param fp File pointer
+ * @param model Model object
+ * @param ranges Non-zero if space should also be reserved for the
+ *        input and output ranges of a deep learner
+ * @returns zero on success
+ */
+static int model_read_bp(FILE * fp, deeplearn_model * model, int ranges)
+{
+    model_network network;
+    model_network * stored;
+    bp net;
+    size_t total;
+    float * block;
+    long parameters = 0;
+    int l, i, no_of_inputs, version;
+
+    memset((void*)model, '\0', sizeof(deeplearn_model));
+    memset((void*)&network, '\0', sizeof(model_network));
+    network.activation = AF_LOGISTIC;
+
+    version = bp_format_load(fp, BP_FILE_MAGIC, BP_FILE_VERSION);
+    if (version < 0) {
+        return -1;
+    }
+    if ((fread(&network.itterations, sizeof(uint32_t), 1, fp) == 0) ||
+        (fread(&network.NoOfInputs, sizeof(int32_t), 1, fp) == 0) ||
+        (fread(&network.NoOfHiddens, sizeof(int32_t), 1, fp) == 0) ||
+        (fread(&network.NoOfOutputs, sizeof(int32_t), 1, fp) == 0) ||
+        (fread(&network.HiddenLayers, sizeof(int32_t), 1, fp) == 0) ||
+        (fread(&network.learningRate, sizeof(float), 1, fp) == 0) ||
+        (fread(&network.noise, sizeof(float), 1, fp) == 0) ||
+        (fread(&network.BPerrorAverage, sizeof(float), 1, fp) == 0) ||
+        (fread(&network.DropoutPercent, sizeof(float), 1, fp) == 0) ||
+        ((version > 0) &&
+         (fread(&network.activation, sizeof(int32_t), 1, fp) == 0))) {
+        return -1;
+    }
+    if ((network.NoOfInputs < 1) || (network.NoOfOutputs < 1) ||
+        (network.HiddenLayers < 1) ||
+        (network.activation < 0) || (network.activation >= AF_FUNCTIONS)) {
+        return -2;
+    }
+
+    /* only the dimensions are needed to find the size of each layer */
+    net.NoOfHiddens = network.NoOfHiddens;
+    net.NoOfOutputs = network.NoOfOutputs;
+    net.HiddenLayers = network.HiddenLayers;
+
+    model->no_of_layers = network.HiddenLayers+1;
+    if (model_alloc_layers(model) != 0) {
+        model_close(model);
+        return -3;
+    }
+    total = MODEL_ALIGN(sizeof(model_network))/sizeof(float);
+    no_of_inputs = network.NoOfInputs;
+    for (l = 0; l < model->no_of_layers; l++) {
+        model->layer_inputs[l] = no_of_inputs;
+        model->layer_units[l] = (l < network.HiddenLayers) ?
+            bp_hiddens_in_layer(&net, l) : network.NoOfOutputs;
+        total += (size_t)model->layer_units[l]*(no_of_inputs + 1);
+        no_of_inputs = model->layer_units[l];
+    }
+    if (ranges != 0) {
+        total += 2*(size_t)(network.NoOfInputs + network.NoOfOutputs);
+    }
+
+    model->size = total*sizeof(float);
+    model->allocation = malloc(model->size + MODEL_ALIGNMENT);
+    if (!model->allocation) {
+        model_close(model);
+        return -3;
+    }
+    model->data = (void*)MODEL_ALIGN((uintptr_t)model->allocation);
+    stored = (model_network*)model->data;
+    *stored = network;
+    model->network = stored;
+    model->precision = KERNEL_FP32;
+
+    block = (float*)model->data +
+        MODEL_ALIGN(sizeof(model_network))/sizeof(float);
+    for (l = 0; l < model->no_of_layers; l++) {
+        int units = model->layer_units[l];
+        int inputs = model->layer_inputs[l];
+        float * weights = block;
+        float * bias = &block[units*inputs];
+
+        for (i = 0; i < units; i++) {
+            int32_t unit_inputs = 0;
+
+            /* weights, then momentum, weight range, bias, bias
+               momentum and desired value */
+            if ((fread(&unit_inputs, sizeof(int32_t), 1, fp) == 0) ||
+                (unit_inputs != inputs) ||
+                (fread(&weights[i*inputs], sizeof(float),
+                       inputs, fp) != (size_t)inputs) ||
+                (model_skip(fp, inputs + 2) != 0) ||
+                (fread(&bias[i], sizeof(float), 1, fp) == 0) ||
+                (model_skip(fp, 2) != 0)) {
+                model_close(model);
+                return -4;
+            }
+        }
+        model->weights[l] = weights;
+        model->bias[l] = bias;
+        block += (size_t)units*(inputs + 1);
+        parameters += (long)units*(inputs + 1);
+    }
+    /* skip the optimiser and the flags of frozen layers */
+    if ((version > 0) &&
+        ((model_skip_optimiser(fp, parameters) != 0) ||
+         (fseek(fp, model->no_of_layers, SEEK_CUR) != 0))) {
+        model_close(model);
+        return -5;
+    }
+    if (ranges != 0) {
+        model->input_range = block;
+        model->output_range = &block[2*network.NoOfInputs];
+    }
+    return 0;
+}
+
+/**
+ * @brief Loads a network saved with bp_save for inference only.  Unlike
+ *        bp_load no units or momentum terms are created, so the model
+ *        takes roughly half of the memory.
+ * @param fp File pointer
+ * @param model Returned model object, freed with model_close
+ * @returns zero on success
+ */
+int model_load_bp(FILE * fp, deeplearn_model * model)
+{
+    return model_read_bp(fp, model, 0);
+}
+
+/**
+ * @brief Loads a deep learner saved with deeplearn_save for inference
+ *        only.  The network weights and the normalisation ranges are
+ *        kept, while momentum terms, the pretraining autocoders, error
+ *        thresholds, training history and classifier heads are skipped.
+ *        The file is left positioned at the end of the learner, so that
+ *        anything saved after it can still be read.
+ * @param fp File pointer
+ * @param model Returned model object, freed with model_close
+ * @returns zero on success
+ */
+int model_load_deeplearn(FILE * fp, deeplearn_model * model)
+{
+    int32_t header[5], no_of_input_fields, history[3], no_of_heads = 0;
+    float * input_range, * output_range;
+    int l, no_of_inputs, no_of_outputs, version;
+
+    /* training state and the lengths of text fields */
+    version = bp_format_load(fp, DEEPLEARN_FILE_MAGIC,
+                             DEEPLEARN_FILE_VERSION);
+    if ((version < 0) ||
+        (fread(header, sizeof(int32_t), 5, fp) != 5)) {
+        return -1;
+    }
+    no_of_input_fields = header[4];
+    if ((no_of_input_fields < 0) ||
+        (model_skip(fp, no_of_input_fields) != 0)) {
+        return -1;
+    }
+
+    if (model_read_bp(fp, model, 1) != 0) {
+        return -2;
+    }
+    no_of_inputs = model->network->NoOfInputs;
+    no_of_outputs = model->network->NoOfOutputs;
+
+    /* skip the autocoders used for pretraining */
+    for (l = 0; l < model->network->HiddenLayers; l++) {
+        int32_t dims[2];
+        int version = bp_format_load(fp, AUTOCODER_FILE_MAGIC,
+                                     AUTOCODER_FILE_VERSION);
+
+        /* older files have no activation function or optimiser */
+        if ((version < 0) ||
+            (fread(dims, sizeof(int32_t), 2, fp) != 2) ||
+            (dims[0] < 0) || (dims[1] < 0) ||
+            (model_skip(fp, 2 + 2*(long)dims[0]*dims[1] +
+                        2*(long)dims[1] + ((version > 0) ? 4 : 3)) != 0) ||
+            ((version > 0) &&
+             (model_skip_optimiser(fp, (long)dims[0]*dims[1] +
+                                   dims[1]) != 0))) {
+            model_close(model);
+            return -3;
+        }
+    }
+
+    /* skip the error thresholds */
+    if (model_skip(fp, model->network->HiddenLayers+1) != 0) {
+        model_close(model);
+        return -4;
+    }
+
+    /* ranges, stored as min values followed by max values */
+    input_range = (float*)model->input_range;
+    output_range = (float*)model->output_range;
+    if ((fread(input_range, sizeof(float), 2*no_of_inputs, fp) !=
+         (size_t)(2*no_of_inputs)) ||
+        (fread(output_range, sizeof(float), 2*no_of_outputs, fp) !=
+         (size_t)(2*no_of_outputs))) {
+        model_close(model);
+        return -5;
+    }
+
+    /* skip the training history */
+    if ((fread(history, sizeof(int32_t), 3, fp) != 3) ||
+        (history[0] < 0) ||
+        ((history[0] > 0) && (model_skip(fp, history[0]) != 0))) {
+        model_close(model);
+        return -6;
+    }
+
+    /* skip any classifier heads, each having a row of weights and a
+       bias for every output */
+    if (version > 0) {
+        if ((fread(&no_of_heads, sizeof(int32_t), 1, fp) == 0) ||
+            (no_of_heads < 0) || (no_of_heads >= model->no_of_layers)) {
+            model_close(model);
+            return -7;
+        }
+        if ((no_of_heads > 0) && (model_skip(fp, 1) != 0)) {
+            model_close(model);
+            return -7;
+        }
+        for (l = 0; l < no_of_heads; l++) {
+            if (model_skip(fp, (long)no_of_outputs*
+                           (model->layer_units[l] + 1)) != 0) {
+                model_close(model);
+                return -7;
+            }
+        }
+    }
+
+    /* as with deeplearn_infer, without input fields the inputs are
+       already unit values */
+    if (no_of_input_fields == 0) {
+        model->input_range = NULL;
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts the weights of an opened model to a reduced precision
+ *        for inference.  Weights which are already stored at a reduced
+ *        precision within the file are used as they are.
+ * @param model Model object
+ * @param precision KERNEL_FP16 or KERNEL_BF16
+ * @returns zero on success
+ */
+int model_set_precision(deeplearn_model * model, int precision)
+{
+    size_t total = 0, offset = 0;
+    int l;
+
+    if ((precision != KERNEL_FP16) && (precision != KERNEL_BF16)) {
+        return -1;
+    }
+    if (model->precision == precision) {
+        return 0;
+    }
+    if (model->precision != KERNEL_FP32) {
+        return -2;
+    }
+
+    for (l = 0; l < model->no_of_layers; l++) {
+        total += (size_t)model->layer_units[l]*model->layer_inputs[l];
+    }
+    model->reduced_allocation = (uint16_t*)malloc(total*sizeof(uint16_t));
+    if (!model->reduced_allocation) {
+        return -3;
+    }
+    for (l = 0; l < model->no_of_layers; l++) {
+        int n = model->layer_units[l]*model->layer_inputs[l];
+        kernel_to_reduced(precision, model->weights[l],
+                          &model->reduced_allocation[offset], n);
+        model->weights_reduced[l] = &model->reduced_allocation[offset];
+        offset += n;
+    }
+    model->precision = precision;
+    return 0;
+}
+
+/**
+ * @brief Creates an inference context for use with model_infer.
+ *        Each thread which evaluates the model needs its own context,
+ *        which is freed with bp_inference_free.
+ * @param model Model object
+ * @param ctx Inference context
+ * @param batch_capacity The maximum number of samples evaluated at once
+ * @returns zero on success
+ */
+int model_inference_init(deeplearn_model * model, bp_inference * ctx,
+                         int batch_capacity)
+{
+    int l;
+
+    if (batch_capacity < 1) {
+        return -1;
+    }
+
+    ctx->batch_capacity = batch_capacity;
+
+    /* size of the largest layer */
+    ctx->layer_capacity = model->network->NoOfInputs;
+    for (l = 0; l < model->no_of_layers; l++) {
+        if (model->layer_units[l] > ctx->layer_capacity) {
+            ctx->layer_capacity = model->layer_units[l];
+        }
+    }
+
+    ctx->inputs =
+        (float*)malloc(batch_capacity*model->network->NoOfInputs*sizeof(float));
+    if (!ctx->inputs) {
+        return -2;
+    }
+    ctx->values[0] =
+        (float*)malloc(batch_capacity*ctx->layer_capacity*sizeof(float));
+    if (!ctx->values[0]) {
+        return -3;
+    }
+    ctx->values[1] =
+        (float*)malloc(batch_capacity*ctx->layer_capacity*sizeof(float));
+    if (!ctx->values[1]) {
+        return -4;
+    }
+    ctx->quantised =
+        (uint8_t*)malloc(batch_capacity*ctx->layer_capacity*sizeof(uint8_t));
+    if (!ctx->quantised) {
+        return -5;
+    }
+
+    /* neutral inputs are not folded into the biases of a model */
+    ctx->no_of_changed = 0;
+    ctx->changed = 0;
+    ctx->delta = 0;
+    return 0;
+}
+
+/**
+ * @brief Evaluates a batch of samples using the weights within the model.
+ *        If the model contains normalisation ranges then inputs and
+ *        outputs are field values, as with deeplearn_infer, otherwise
+ *        they are unit values.
+ * @param model Model object
+ * @param ctx Inference context owned by the calling thread
+ * @param inputs Input values, one row per sample
+ * @param outputs Returned output values, one row per sample
+ * @param batch_size The number of samples
+ * @returns zero on success
+ */
+int model_infer(deeplearn_model * model, bp_inference * ctx,
+                float * inputs, float * outputs, int batch_size)
+{
+    int i, b, l, curr = 0;
+    int no_of_inputs = model->network->NoOfInputs;
+    int no_of_outputs = model->network->NoOfOutputs;
+    int prev_units = no_of_inputs;
+    float * in = inputs, * out, value, range;
+    const float * w, * min, * max;
+
+    if ((batch_size < 1) || (batch_size > ctx->batch_capacity)) {
+        return -1;
+    }
+
+    /* normalise into the range 0.25-0.75 */
+    if (model->input_range) {
+        min = model->input_range;
+        max = &model->input_range[no_of_inputs];
+        for (b = 0; b < batch_size; b++) {
+            for (i = 0; i < no_of_inputs; i++) {
+                value = inputs[b*no_of_inputs + i];
+                range = max[i] - min[i];
+                if (range > 0) {
+                    value = (((value - min[i])/range)*0.5) + 0.25;
+                }
+                ctx->inputs[b*no_of_inputs + i] = value;
+            }
+        }
+        in = ctx->inputs;
+    }
+
+    for (l = 0; l < model->no_of_layers; l++) {
+        int units = model->layer_units[l];
+        int layer_inputs = model->layer_inputs[l];
+
+        if (units > ctx->layer_capacity) {
+            return -2;
+        }
+
+        /* the final layer goes straight into the outputs */
+        if (l == model->no_of_layers-1) {
+            out = outputs;
+        }
+        else {
+            out = ctx->values[curr];
+        }
+
+        if (model->precision == KERNEL_FP32) {
+            for (i = 0; i < units; i++) {
+                w = &model->weights[l][i*layer_inputs];
+                for (b = 0; b < batch_size; b++) {
+                    out[b*units + i] = model->bias[l][i] +
+                        kernel_dot(w, &in[b*prev_units], layer_inputs);
+                }
+            }
+        }
+        else if (model->precision == KERNEL_INT8) {
+            /* integer dot products of the quantised inputs */
+            float input_scale = model->input_quant[l][0];
+            int input_zero = (int)model->input_quant[l][1];
+
+            kernel_quantise_u8(in, ctx->quantised, batch_size*prev_units,
+                               input_scale, input_zero);
+            for (i = 0; i < units; i++) {
+                const int8_t * w8 = &model->weights_int8[l][i*layer_inputs];
+                float scale = model->weight_scale[l][i]*input_scale;
+                int32_t offset = input_zero*model->row_sum[l][i];
+                for (b = 0; b < batch_size; b++) {
+                    out[b*units + i] = model->bias[l][i] +
+                        scale*(float)(kernel_dot_u8i8(&ctx->quantised[b*prev_units],
+                                                      w8, layer_inputs) -
+                                      offset);
+                }
+            }
+        }
+        else {
+            /* reduced precision weights, accumulated as floats */
+            for (i = 0; i < units; i++) {
+                const uint16_t * wr =
+                    &model->weights_reduced[l][i*layer_inputs];
+                for (b = 0; b < batch_size; b++) {
+                    out[b*units + i] = model->bias[l][i] +
+                        kernel_dot_reduced(model->precision, wr,
+                                           &in[b*prev_units],
+                                           layer_inputs);
+                }
+            }
+        }
+
+        /* hidden layers use the network's activation function and
+           the output layer is always logistic */
+        kernel_af_vector((l == model->no_of_layers-1) ?
+                         AF_LOGISTIC : model->network->activation,
+                         out, batch_size*units);
+
+        in = out;
+        prev_units = units;
+        curr = 1 - curr;
+    }
+
+    /* return outputs to their normal range */
+    if (model->output_range) {
+        min = model->output_range;
+        max = &model->output_range[no_of_outputs];
+        for (b = 0; b < batch_size; b++) {
+            for (i = 0; i < no_of_outputs; i++) {
+                range = max[i] - min[i];
+                if (range > 0) {
+                    outputs[b*no_of_outputs + i] =
+                        (((outputs[b*no_of_outputs + i] - 0.25f)/0.5f)*range) +
+                        min[i];
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts a neural net saved with bp_save to a model file
+ * @param bp_filename Filename of the existing network
+ * @param model_filename Filename of the model to be saved
+ * @returns zero on success
+ */
+int model_convert_bp(char * bp_filename, char * model_filename)
+{
+    bp net;
+    unsigned int random_seed = 0;
+    int retval;
+    FILE * fp = fopen(bp_filename, "rb");
+
+    if (!fp) {
+        return -1;
+    }
+    if (bp_load(fp, &net, &random_seed) != 0) {
+        fclose(fp);
+        return -2;
+    }
+    fclose(fp);
+
+    retval = model_save_bp(model_filename, &net);
+    bp_free(&net);
+    if (retval != 0) {
+        return -3;
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts a deep learner saved with deeplearn_save to a model file
+ * @param deeplearn_filename Filename of the existing deep learner
+ * @param model_filename Filename of the model to be saved
+ * @returns zero on success
+ */
+int model_convert_deeplearn(char * deeplearn_filename,
+                            char * model_filename)
+{
+    deeplearn learner;
+    unsigned int random_seed = 0;
+    int retval;
+    FILE * fp = fopen(deeplearn_filename, "rb");
+
+    if (!fp) {
+        return -1;
+    }
+    if (deeplearn_load(fp, &learner, &random_seed) != 0) {
+        fclose(fp);
+        return -2;
+    }
+    fclose(fp);
+
+    retval = model_save_deeplearn(model_filename, &learner);
+    deeplearn_free(&learner);
+    if (retval != 0) {
+        return -3;
+    }
+    return 0;
+}
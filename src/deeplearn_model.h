@@ -0,0 +1,168 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_MODEL_H
+#define DEEPLEARN_MODEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "globals.h"
+#include "backprop.h"
+#include "deeplearn.h"
+#include "deeplearn_shared.h"
+
+/* Container format for trained networks.
+   The file begins with a fixed size header, followed by a table of
+   sections.  Each section refers to a blob which starts on a
+   MODEL_ALIGNMENT byte boundary, so that the file can be memory
+   mapped and weight matrices used directly without copying */
+#define MODEL_MAGIC         "LIBDEEPM"
+#define MODEL_VERSION       1
+#define MODEL_ENDIAN_TAG    0x01020304
+#define MODEL_ALIGNMENT     64
+
+/* section types */
+#define MODEL_SECTION_NETWORK       1
+#define MODEL_SECTION_WEIGHTS       2
+#define MODEL_SECTION_BIAS          3
+#define MODEL_SECTION_INPUT_RANGE   4
+#define MODEL_SECTION_OUTPUT_RANGE  5
+
+/* weights stored with reduced precision, two bytes per weight */
+#define MODEL_SECTION_WEIGHTS_FP16  6
+#define MODEL_SECTION_WEIGHTS_BF16  7
+
+/* eight bit weights, followed by sections containing the scale of
+   each unit's weights and the scale and zero point of the layer inputs */
+#define MODEL_SECTION_WEIGHTS_INT8  8
+#define MODEL_SECTION_WEIGHT_SCALE  9
+#define MODEL_SECTION_INPUT_QUANT   10
+
+/* 64 byte file header */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t header_size;
+    uint32_t no_of_sections;
+    uint64_t file_size;
+    uint8_t reserved[32];
+} model_header;
+
+/* 32 byte entry within the section table.
+   Matrices are row major with the given number of rows and columns */
+typedef struct {
+    uint32_t type;
+    uint32_t layer;
+    uint32_t rows;
+    uint32_t cols;
+    uint64_t offset;
+    uint64_t size;
+} model_section;
+
+/* 64 byte blob describing the network architecture */
+typedef struct {
+    int32_t NoOfInputs;
+    int32_t NoOfHiddens;
+    int32_t NoOfOutputs;
+    int32_t HiddenLayers;
+    float learningRate;
+    float noise;
+    float DropoutPercent;
+    float BPerrorAverage;
+    uint32_t itterations;
+    /* hidden unit activation function (AF_*).  Zero in older
+       files, which is the logistic function */
+    int32_t activation;
+    uint32_t reserved[6];
+} model_network;
+
+/* A loaded model.  Weights and biases point directly into the
+   mapped file.  Layer zero is the first hidden layer and the
+   final layer is the output layer */
+typedef struct {
+    void * data;
+    size_t size;
+
+    /* non-zero if the file is memory mapped, otherwise it was read
+       into an allocated buffer */
+    unsigned char mapped;
+    void * allocation;
+
+    const model_network * network;
+    int no_of_layers;
+    int * layer_units;
+    int * layer_inputs;
+    const float ** weights;
+    const float ** bias;
+
+    /* precision of the weights used for inference (KERNEL_FP32,
+       KERNEL_FP16, KERNEL_BF16 or KERNEL_INT8).  Reduced precision
+       weights are either within the file or were converted after it
+       was opened, in which case they are held in reduced_allocation */
+    int precision;
+    const uint16_t ** weights_reduced;
+    uint16_t * reduced_allocation;
+
+    /* eight bit weights, the scale of each unit's weights and the
+       scale and zero point of each layer's inputs.  The sums of each
+       row of weights are calculated when the model is opened */
+    const int8_t ** weights_int8;
+    const float ** weight_scale;
+    const float ** input_quant;
+    int32_t ** row_sum;
+    int32_t * row_sum_allocation;
+
+    /* normalisation ranges, min values followed by max values,
+       or NULL if the inputs and outputs are unit values */
+    const float * input_range;
+    const float * output_range;
+} deeplearn_model;
+
+int model_save_bp(char * filename, bp * net);
+int model_save_deeplearn(char * filename, deeplearn * learner);
+int model_save_bp_precision(char * filename, bp * net, int precision);
+int model_save_deeplearn_precision(char * filename, deeplearn * learner,
+                                   int precision);
+int model_set_precision(deeplearn_model * model, int precision);
+int model_open(char * filename, deeplearn_model * model);
+int model_attach(char * name, deeplearn_model * model);
+void model_close(deeplearn_model * model);
+int model_load_bp(FILE * fp, deeplearn_model * model);
+int model_load_deeplearn(FILE * fp, deeplearn_model * model);
+int model_inference_init(deeplearn_model * model, bp_inference * ctx,
+                         int batch_capacity);
+int model_infer(deeplearn_model * model, bp_inference * ctx,
+                float * inputs, float * outputs, int batch_size);
+int model_convert_bp(char * bp_filename, char * model_filename);
+int model_convert_deeplearn(char * deeplearn_filename,
+                            char * model_filename);
+
+#endif
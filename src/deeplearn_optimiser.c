@@ -0,0 +1,368 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_optimiser.h"
+
+/**
+ * @brief Sets the default update rule and hyperparameters
+ * @param optimiser Optimiser object
+ */
+void optimiser_init(deeplearn_optimiser * optimiser)
+{
+    optimiser->type = OPTIMISER_MOMENTUM;
+    optimiser->momentum = OPTIMISER_DEFAULT_MOMENTUM;
+    optimiser->decay = OPTIMISER_DEFAULT_DECAY;
+    optimiser->epsilon = OPTIMISER_DEFAULT_EPSILON;
+    optimiser->step = 0;
+    optimiser->correction1 = 1;
+    optimiser->correction2 = 1;
+}
+
+/**
+ * @brief Changes the update rule.  The step count is reset, so that
+ *        Adam begins with its bias correction.
+ * @param optimiser Optimiser object
+ * @param type Update rule, such as OPTIMISER_ADAM
+ * @returns zero on success
+ */
+int optimiser_set(deeplearn_optimiser * optimiser, int type)
+{
+    if ((type < 0) || (type >= OPTIMISERS)) {
+        return -1;
+    }
+    optimiser->type = type;
+    optimiser->step = 0;
+    optimiser->correction1 = 1;
+    optimiser->correction2 = 1;
+    return 0;
+}
+
+/**
+ * @brief Returns non-zero if the update rule needs a second moment
+ *        array alongside the weight changes
+ * @param optimiser Optimiser object
+ * @returns Non-zero if a second moment is needed
+ */
+int optimiser_second_moment(deeplearn_optimiser * optimiser)
+{
+    return ((optimiser->type == OPTIMISER_RMSPROP) ||
+            (optimiser->type == OPTIMISER_ADAM));
+}
+
+/**
+ * @brief Advances the step count before each update of the weights,
+ *        and calculates the bias corrections used by Adam.
+ * @param optimiser Optimiser object
+ */
+void optimiser_next_step(deeplearn_optimiser * optimiser)
+{
+    if (optimiser->step < UINT_MAX) {
+        optimiser->step++;
+    }
+    if (optimiser->type == OPTIMISER_ADAM) {
+        optimiser->correction1 =
+            1.0f / (1.0f - powf(optimiser->momentum, (float)optimiser->step));
+        optimiser->correction2 =
+            1.0f / (1.0f - powf(optimiser->decay, (float)optimiser->step));
+    }
+}
+
+/**
+ * @brief Returns the change to a single weight
+ * @param optimiser Optimiser object
+ * @param m The weight change or first moment of the weight
+ * @param v The second moment of the weight, if needed
+ * @param e Learning rate
+ * @param g Gradient of the weight
+ * @returns The change to the weight
+ */
+static inline float optimiser_change(deeplearn_optimiser * optimiser,
+                                     float * m, float * v,
+                                     float e, float g)
+{
+    switch(optimiser->type) {
+    case OPTIMISER_SGD: {
+        *m = optimiser->momentum * *m + g;
+        return e * *m;
+    }
+    case OPTIMISER_NESTEROV: {
+        *m = optimiser->momentum * *m + g;
+        return e * (optimiser->momentum * *m + g);
+    }
+    case OPTIMISER_RMSPROP: {
+        *v = optimiser->decay * *v + (1.0f - optimiser->decay) * g * g;
+        *m = e * g / (sqrtf(*v) + optimiser->epsilon);
+        return *m;
+    }
+    case OPTIMISER_ADAM: {
+        *m = optimiser->momentum * *m + (1.0f - optimiser->momentum) * g;
+        *v = optimiser->decay * *v + (1.0f - optimiser->decay) * g * g;
+        return e * (*m * optimiser->correction1) /
+            (sqrtf(*v * optimiser->correction2) + optimiser->epsilon);
+    }
+    }
+    *m = e * (*m + 1) * g;
+    return *m;
+}
+
+/**
+ * @brief Updates a contiguous array of weights, where the gradient of
+ *        weight i is gradient*x[i].  Each rule is a separate loop over
+ *        the arrays so that it can be vectorised.
+ * @param optimiser Optimiser object
+ * @param weights Array of weights
+ * @param lastWeightChange Weight changes or first moments
+ * @param moment2 Second moments, or NULL if the rule doesn't need them
+ * @param x Array of inputs
+ * @param e Learning rate
+ * @param gradient Gradient which the inputs are multiplied by
+ * @param n Number of weights
+ * @param min_weight Returned minimum weight, or NULL
+ * @param max_weight Returned maximum weight, or NULL
+ */
+void optimiser_update(deeplearn_optimiser * optimiser,
+                      float * weights, float * lastWeightChange,
+                      float * moment2, const float * x,
+                      float e, float gradient, int n,
+                      float * min_weight, float * max_weight)
+{
+    int i;
+    float mu = optimiser->momentum, decay = optimiser->decay;
+    float eps = optimiser->epsilon;
+    float min = 9999, max = -9999;
+
+    switch(optimiser->type) {
+    case OPTIMISER_SGD: {
+        for (i = 0; i < n; i++) {
+            lastWeightChange[i] = mu * lastWeightChange[i] + gradient * x[i];
+            weights[i] += e * lastWeightChange[i];
+        }
+        break;
+    }
+    case OPTIMISER_NESTEROV: {
+        for (i = 0; i < n; i++) {
+            float g = gradient * x[i];
+            lastWeightChange[i] = mu * lastWeightChange[i] + g;
+            weights[i] += e * (mu * lastWeightChange[i] + g);
+        }
+        break;
+    }
+    case OPTIMISER_RMSPROP: {
+        for (i = 0; i < n; i++) {
+            float g = gradient * x[i];
+            moment2[i] = decay * moment2[i] + (1.0f - decay) * g * g;
+            lastWeightChange[i] = e * g / (sqrtf(moment2[i]) + eps);
+            weights[i] += lastWeightChange[i];
+        }
+        break;
+    }
+    case OPTIMISER_ADAM: {
+        float e1 = e * optimiser->correction1;
+        float c2 = optimiser->correction2;
+        for (i = 0; i < n; i++) {
+            float g = gradient * x[i];
+            lastWeightChange[i] = mu * lastWeightChange[i] + (1.0f - mu) * g;
+            moment2[i] = decay * moment2[i] + (1.0f - decay) * g * g;
+            weights[i] += e1 * lastWeightChange[i] /
+                (sqrtf(moment2[i] * c2) + eps);
+        }
+        break;
+    }
+    default: {
+        kernel_weight_update(weights, lastWeightChange, x, e, gradient, n,
+                             min_weight, max_weight);
+        return;
+    }
+    }
+
+    if ((min_weight == NULL) && (max_weight == NULL)) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        if (weights[i] < min) min = weights[i];
+        if (weights[i] > max) max = weights[i];
+    }
+    if (min_weight) {
+        if (min < *min_weight) *min_weight = min;
+    }
+    if (max_weight) {
+        if (max > *max_weight) *max_weight = max;
+    }
+}
+
+/**
+ * @brief Updates the live weights of a pruned row, keeping the dense
+ *        weights in step
+ * @param optimiser Optimiser object
+ * @param values The live weights
+ * @param column Index within the dense row of each live weight
+ * @param weights Dense row of weights
+ * @param lastWeightChange Dense row of weight changes or first moments
+ * @param moment2 Dense row of second moments, or NULL if not needed
+ * @param x Array of inputs
+ * @param e Learning rate
+ * @param gradient Gradient which the inputs are multiplied by
+ * @param n Number of live weights
+ * @param min_weight Returned minimum weight, or NULL
+ * @param max_weight Returned maximum weight, or NULL
+ */
+void optimiser_sparse_update(deeplearn_optimiser * optimiser,
+                             float * values, const int * column,
+                             float * weights, float * lastWeightChange,
+                             float * moment2, const float * x,
+                             float e, float gradient, int n,
+                             float * min_weight, float * max_weight)
+{
+    int i, c;
+    float min = 9999, max = -9999;
+
+    if (optimiser->type == OPTIMISER_MOMENTUM) {
+        kernel_sparse_weight_update(values, column, weights,
+                                    lastWeightChange, x, e, gradient, n,
+                                    min_weight, max_weight);
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        c = column[i];
+        values[i] += optimiser_change(optimiser, &lastWeightChange[c],
+                                      moment2 ? &moment2[c] : NULL,
+                                      e, gradient * x[c]);
+        weights[c] = values[i];
+        if (values[i] < min) min = values[i];
+        if (values[i] > max) max = values[i];
+    }
+
+    if (min_weight) {
+        if (min < *min_weight) *min_weight = min;
+    }
+    if (max_weight) {
+        if (max > *max_weight) *max_weight = max;
+    }
+}
+
+/**
+ * @brief Returns the change to a bias
+ * @param optimiser Optimiser object
+ * @param lastBiasChange Bias change or first moment
+ * @param moment2 Second moment of the bias, or NULL if not needed
+ * @param e Learning rate
+ * @param gradient Gradient of the bias
+ * @returns The change to the bias
+ */
+float optimiser_bias(deeplearn_optimiser * optimiser,
+                     float * lastBiasChange, float * moment2,
+                     float e, float gradient)
+{
+    if (optimiser->type == OPTIMISER_MOMENTUM) {
+        *lastBiasChange = e * (*lastBiasChange + 1.0f) * gradient;
+        return *lastBiasChange;
+    }
+    return optimiser_change(optimiser, lastBiasChange, moment2, e, gradient);
+}
+
+/**
+ * @brief Returns a human readable name for an update rule
+ * @param type Update rule, such as OPTIMISER_ADAM
+ * @returns Name of the update rule
+ */
+const char * optimiser_name(int type)
+{
+    switch(type) {
+    case OPTIMISER_MOMENTUM: return "momentum";
+    case OPTIMISER_SGD: return "sgd";
+    case OPTIMISER_NESTEROV: return "nesterov";
+    case OPTIMISER_RMSPROP: return "rmsprop";
+    case OPTIMISER_ADAM: return "adam";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Saves the update rule and its hyperparameters
+ * @param fp File pointer
+ * @param optimiser Optimiser object
+ * @returns zero on success
+ */
+int optimiser_save(FILE * fp, deeplearn_optimiser * optimiser)
+{
+    if (fwrite(&optimiser->type, sizeof(int), 1, fp) == 0) {
+        return -1;
+    }
+    if (fwrite(&optimiser->momentum, sizeof(float), 1, fp) == 0) {
+        return -2;
+    }
+    if (fwrite(&optimiser->decay, sizeof(float), 1, fp) == 0) {
+        return -3;
+    }
+    if (fwrite(&optimiser->epsilon, sizeof(float), 1, fp) == 0) {
+        return -4;
+    }
+    if (fwrite(&optimiser->step, sizeof(unsigned int), 1, fp) == 0) {
+        return -5;
+    }
+    return 0;
+}
+
+/**
+ * @brief Loads the update rule and its hyperparameters
+ * @param fp File pointer
+ * @param optimiser Optimiser object
+ * @returns zero on success
+ */
+int optimiser_load(FILE * fp, deeplearn_optimiser * optimiser)
+{
+    deeplearn_optimiser loaded;
+
+    optimiser_init(&loaded);
+    if ((fread(&loaded.type, sizeof(int), 1, fp) == 0) ||
+        (loaded.type < 0) || (loaded.type >= OPTIMISERS)) {
+        return -1;
+    }
+    if (fread(&loaded.momentum, sizeof(float), 1, fp) == 0) {
+        return -2;
+    }
+    if (fread(&loaded.decay, sizeof(float), 1, fp) == 0) {
+        return -3;
+    }
+    if (fread(&loaded.epsilon, sizeof(float), 1, fp) == 0) {
+        return -4;
+    }
+    if (fread(&loaded.step, sizeof(unsigned int), 1, fp) == 0) {
+        return -5;
+    }
+    *optimiser = loaded;
+
+    /* corrections for the most recent step */
+    if ((optimiser->type == OPTIMISER_ADAM) && (optimiser->step > 0)) {
+        optimiser->step--;
+        optimiser_next_step(optimiser);
+    }
+    return 0;
+}
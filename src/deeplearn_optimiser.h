@@ -0,0 +1,100 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_OPTIMISER_H
+#define DEEPLEARN_OPTIMISER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include "deeplearn_kernels.h"
+
+/* rules used to update weights from their gradients.  OPTIMISER_MOMENTUM
+   is the original rule, dw = e*(dw + 1)*g */
+#define OPTIMISER_MOMENTUM  0
+#define OPTIMISER_SGD       1
+#define OPTIMISER_NESTEROV  2
+#define OPTIMISER_RMSPROP   3
+#define OPTIMISER_ADAM      4
+#define OPTIMISERS          5
+
+/* default hyperparameters */
+#define OPTIMISER_DEFAULT_MOMENTUM  0.9f
+#define OPTIMISER_DEFAULT_DECAY     0.999f
+#define OPTIMISER_DEFAULT_EPSILON   1.0e-8f
+
+/* Update rule of a network or autocoder.  The first moment of each
+   weight, or its velocity, is kept in lastWeightChange.  RMSProp and
+   Adam also keep a second moment, the running average of the squared
+   gradient, in a separate array of the same size.
+   The learning rate of each rule is the usual learningRate/(1 + inputs) */
+typedef struct {
+    int type;
+
+    /* momentum of SGD and Nesterov, and the first moment decay of Adam */
+    float momentum;
+
+    /* decay of the second moment used by RMSProp and Adam */
+    float decay;
+
+    /* added to the root of the second moment to avoid dividing by zero */
+    float epsilon;
+
+    /* number of updates, used for the bias correction of Adam */
+    unsigned int step;
+
+    /* bias corrections for the current step, which are not saved */
+    float correction1, correction2;
+} deeplearn_optimiser;
+
+void optimiser_init(deeplearn_optimiser * optimiser);
+int optimiser_set(deeplearn_optimiser * optimiser, int type);
+int optimiser_second_moment(deeplearn_optimiser * optimiser);
+void optimiser_next_step(deeplearn_optimiser * optimiser);
+void optimiser_update(deeplearn_optimiser * optimiser,
+                      float * weights, float * lastWeightChange,
+                      float * moment2, const float * x,
+                      float e, float gradient, int n,
+                      float * min_weight, float * max_weight);
+void optimiser_sparse_update(deeplearn_optimiser * optimiser,
+                             float * values, const int * column,
+                             float * weights, float * lastWeightChange,
+                             float * moment2, const float * x,
+                             float e, float gradient, int n,
+                             float * min_weight, float * max_weight);
+float optimiser_bias(deeplearn_optimiser * optimiser,
+                     float * lastBiasChange, float * moment2,
+                     float e, float gradient);
+const char * optimiser_name(int type);
+int optimiser_save(FILE * fp, deeplearn_optimiser * optimiser);
+int optimiser_load(FILE * fp, deeplearn_optimiser * optimiser);
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_parallel.h"
+
+/**
+ * @brief Creates replicas of the network of a learner for synchronous
+ *        data-parallel training.  The learner should not be pruned
+ *        after the replicas have been created.
+ * @param parallel Data-parallel training object
+ * @param learner Deep learner object to be trained
+ * @param no_of_replicas The number of replicas, typically one per thread
+ * @returns zero on success
+ */
+int deeplearn_parallel_init(deeplearn_parallel * parallel,
+                            deeplearn * learner, int no_of_replicas)
+{
+    int r;
+
+    memset(parallel, '\0', sizeof(deeplearn_parallel));
+    if (no_of_replicas < 1) {
+        return -1;
+    }
+
+    parallel->learner = learner;
+    parallel->length = bp_gradients_length(learner->net);
+
+    parallel->replica = (bp*)malloc(no_of_replicas*sizeof(bp));
+    if (!parallel->replica) {
+        return -2;
+    }
+    parallel->gradients = (float**)malloc(no_of_replicas*sizeof(float*));
+    if (!parallel->gradients) {
+        free(parallel->replica);
+        parallel->replica = NULL;
+        return -3;
+    }
+
+    for (r = 0; r < no_of_replicas; r++) {
+        parallel->gradients[r] =
+            (float*)malloc(parallel->length*sizeof(float));
+        if (!parallel->gradients[r]) {
+            deeplearn_parallel_free(parallel);
+            return -4;
+        }
+        if (bp_clone(&parallel->replica[r], learner->net) != 0) {
+            free(parallel->gradients[r]);
+            deeplearn_parallel_free(parallel);
+            return -5;
+        }
+        parallel->no_of_replicas++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Sets a function which sums the gradients of each update across
+ *        processes, such as a wrapper around MPI_Allreduce.  The
+ *        gradients are summed rather than averaged, since they carry
+ *        their own sample count.  Every process should begin with the
+ *        same learner, for example by loading it from the same file.
+ * @param parallel Data-parallel training object
+ * @param allreduce The function used to sum gradients, or NULL
+ * @param data Passed to the function on each call
+ */
+void deeplearn_parallel_set_allreduce(deeplearn_parallel * parallel,
+                                      deeplearn_allreduce allreduce,
+                                      void * data)
+{
+    parallel->allreduce = allreduce;
+    parallel->allreduce_data = data;
+}
+
+/**
+ * @brief Sums the gradients of the replicas into the first of them
+ *        using a tree reduction.  Pairs are always combined in the same
+ *        order, so the result is deterministic.
+ * @param parallel Data-parallel training object
+ */
+static void deeplearn_parallel_reduce(deeplearn_parallel * parallel)
+{
+    int stride;
+
+    for (stride = 1; stride < parallel->no_of_replicas; stride *= 2) {
+        int r;
+
+#pragma omp parallel for num_threads(threads_count()) schedule(static) if (parallel->no_of_replicas > 2)
+        for (r = 0; r < parallel->no_of_replicas - stride; r += 2*stride) {
+            kernel_axpy(parallel->gradients[r], 1.0f,
+                        parallel->gradients[r + stride], parallel->length);
+        }
+    }
+}
+
+/**
+ * @brief Performs one synchronous training step on a mini-batch of
+ *        values which have already been normalised.  The batch is split
+ *        between the replicas, their gradients are summed and a single
+ *        update is applied to the learner.  During pretraining the
+ *        samples are presented to the autocoder one at a time, as with
+ *        deeplearn_update_batch_values, and are not shared between
+ *        processes.
+ * @param parallel Data-parallel training object
+ * @param inputs Input values, one row of NoOfInputs values per sample
+ * @param targets Desired output values, one row of NoOfOutputs values
+ *        per sample
+ * @param batch_size The number of samples
+ * @returns zero on success
+ */
+int deeplearn_parallel_update(deeplearn_parallel * parallel,
+                              float * inputs, float * targets,
+                              int batch_size)
+{
+    deeplearn * learner = parallel->learner;
+    bp * net = learner->net;
+    int r, retval = 0, shard;
+
+    /* only continue if training is not complete */
+    if (learner->training_complete == 1) return 0;
+
+    if (batch_size < 1) {
+        return -1;
+    }
+
+    /* If there is only a single hidden layer */
+    if ((learner->current_hidden_layer == 0) &&
+        (net->HiddenLayers == 1)) {
+        learner->current_hidden_layer = 1;
+    }
+
+    /* autocoders are pretrained one sample at a time */
+    if (learner->current_hidden_layer < net->HiddenLayers) {
+        return deeplearn_update_batch_values(learner, inputs, targets,
+                                             batch_size);
+    }
+
+    shard = (batch_size + parallel->no_of_replicas - 1) /
+        parallel->no_of_replicas;
+
+#pragma omp parallel for schedule(static, 1) reduction(min:retval) num_threads(parallel->no_of_replicas)
+    for (r = 0; r < parallel->no_of_replicas; r++) {
+        bp * replica = &parallel->replica[r];
+        int start = r*shard;
+        int samples = batch_size - start;
+
+        memset(parallel->gradients[r], '\0', parallel->length*sizeof(float));
+        if (samples > shard) samples = shard;
+        if (samples < 1) continue;
+
+        /* begin from the current state of the learner */
+        if (bp_copy_weights(replica, net) != 0) {
+            retval = -2;
+            continue;
+        }
+        if (bp_batch_gradients(replica,
+                               &inputs[start*net->NoOfInputs],
+                               &targets[start*net->NoOfOutputs],
+                               samples, learner->current_hidden_layer,
+                               parallel->gradients[r]) != 0) {
+            retval = -3;
+        }
+    }
+    if (retval != 0) {
+        return retval;
+    }
+
+    deeplearn_parallel_reduce(parallel);
+
+    if (parallel->allreduce != NULL) {
+        if (parallel->allreduce(parallel->gradients[0], parallel->length,
+                                parallel->allreduce_data) != 0) {
+            return -4;
+        }
+    }
+
+    if (deeplearn_apply_gradients(learner, parallel->gradients[0]) != 0) {
+        return -5;
+    }
+    return 0;
+}
+
+/**
+ * @brief Frees the replicas and gradients of a data-parallel training
+ *        object.  The learner itself is not freed.
+ * @param parallel Data-parallel training object
+ */
+void deeplearn_parallel_free(deeplearn_parallel * parallel)
+{
+    int r;
+
+    for (r = 0; r < parallel->no_of_replicas; r++) {
+        bp_free(&parallel->replica[r]);
+        free(parallel->gradients[r]);
+    }
+    free(parallel->replica);
+    free(parallel->gradients);
+    parallel->replica = NULL;
+    parallel->gradients = NULL;
+    parallel->no_of_replicas = 0;
+}
@@ -0,0 +1,73 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_PARALLEL_H
+#define DEEPLEARN_PARALLEL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "backprop.h"
+#include "autocoder.h"
+#include "deeplearn.h"
+
+/* Synchronous data-parallel training of a deep learner.  Each mini-batch
+   is split into shards, one per replica of the network, and the
+   replicas compute their gradients concurrently.  The gradients are
+   then summed by a tree reduction in a fixed order, so the result does
+   not depend upon thread scheduling, and applied to the learner as a
+   single update.  If an allreduce function is set then the summed
+   gradients are also combined with those of other processes, so that
+   every process applies the same update to its own copy of the learner */
+typedef struct {
+    deeplearn * learner;
+    int no_of_replicas;
+    bp * replica;
+
+    /* gradients of each replica, bp_gradients_length values each */
+    float ** gradients;
+    int length;
+
+    /* optional transport used to sum gradients across processes */
+    deeplearn_allreduce allreduce;
+    void * allreduce_data;
+} deeplearn_parallel;
+
+int deeplearn_parallel_init(deeplearn_parallel * parallel,
+                            deeplearn * learner, int no_of_replicas);
+void deeplearn_parallel_set_allreduce(deeplearn_parallel * parallel,
+                                      deeplearn_allreduce allreduce,
+                                      void * data);
+int deeplearn_parallel_update(deeplearn_parallel * parallel,
+                              float * inputs, float * targets,
+                              int batch_size);
+void deeplearn_parallel_free(deeplearn_parallel * parallel);
+
+#endif
@@ -30,7 +30,24 @@
 #include "deeplearn_pooling.h"
 
 /**
- * @brief Pools the first layer into the second (max pooling)
+ * @brief Returns the first unit of the first layer which pools into
+ *        the given unit of the second layer along one axis.  A unit x0
+ *        pools into x0*layer1_units/layer0_units.
+ * @param x1 Position within the second layer
+ * @param layer0_units Number of units along the axis of the first layer
+ * @param layer1_units Number of units along the axis of the second layer
+ * @returns Position within the first layer
+ */
+static int pooling_start(int x1, int layer0_units, int layer1_units)
+{
+    return (x1*layer0_units + layer1_units - 1) / layer1_units;
+}
+
+/**
+ * @brief Pools the first layer into the second (max pooling), visiting
+ *        each unit of the second layer once so that rows can be pooled
+ *        in parallel, and optionally recording which unit of the first
+ *        layer was the maximum
  * @param depth Depth of the two layers
  * @param layer0_across Number of units across the first layer
  * @param layer0_down Number of units down the first layer
@@ -38,16 +55,22 @@
  * @param layer1_across Number of units across the second layer
  * @param layer1_down Number of units down the second layer
  * @param layer1 Array containing the second layer values
+ * @param argmax Returned index within the first layer array of the
+ *        maximum for each second layer value, or -1 if nothing pooled
+ *        into it.  May be NULL.
  * @returns zero on success
  */
-int pooling_from_flt_to_flt(int depth,
-                            int layer0_across,
-                            int layer0_down,
-                            float layer0[],
-                            int layer1_across,
-                            int layer1_down,
-                            float layer1[])
+int pooling_from_flt_to_flt_argmax(int depth,
+                                   int layer0_across,
+                                   int layer0_down,
+                                   float layer0[],
+                                   int layer1_across,
+                                   int layer1_down,
+                                   float layer1[],
+                                   int argmax[])
 {
+    int y1;
+
     /* second layer must be smaller than the first */
     if (layer1_across*layer1_down >
         layer0_across*layer0_down) {
@@ -59,21 +82,64 @@ int pooling_from_flt_to_flt(int depth,
         layer0_across*layer0_down) {
         memcpy((void*)layer1,(void*)layer0,
                layer1_across*layer1_down*depth*sizeof(float));
+        if (argmax != NULL) {
+            for (int i = 0; i < layer1_across*layer1_down*depth; i++) {
+                argmax[i] = i;
+            }
+        }
         return 0;
     }
 
-    memset((void*)layer1,'\0',layer1_across*layer1_down*depth*sizeof(float));
+#pragma omp parallel for num_threads(threads_count()) if (layer0_across*layer0_down*depth >= POOLING_PARALLEL_MIN)
+    for (y1 = 0; y1 < layer1_down; y1++) {
+        int y0_start = pooling_start(y1, layer0_down, layer1_down);
+        int y0_end = pooling_start(y1+1, layer0_down, layer1_down);
 
-    /*#pragma omp parallel for*/
-    for (int y0 = 0; y0 < layer0_down; y0++) {
-        int y1 = y0 * layer1_down / layer0_down;
-        for (int x0 = 0; x0 < layer0_across; x0++) {
-            int x1 = x0 * layer1_across / layer0_across;
-            int n0 = (y0*layer0_across + x0)*depth;
+        for (int x1 = 0; x1 < layer1_across; x1++) {
+            int x0_start = pooling_start(x1, layer0_across, layer1_across);
+            int x0_end = pooling_start(x1+1, layer0_across, layer1_across);
             int n1 = (y1*layer1_across + x1)*depth;
+            float * maximum = &layer1[n1];
+
+            if ((y0_start >= y0_end) || (x0_start >= x0_end)) {
+                memset((void*)maximum, '\0', depth*sizeof(float));
+                if (argmax != NULL) {
+                    for (int d = 0; d < depth; d++) {
+                        argmax[n1+d] = -1;
+                    }
+                }
+                continue;
+            }
+
+            /* the first unit of the window */
+            int n0 = (y0_start*layer0_across + x0_start)*depth;
+            memcpy((void*)maximum, (void*)&layer0[n0], depth*sizeof(float));
+
+            if (argmax == NULL) {
+                for (int y0 = y0_start; y0 < y0_end; y0++) {
+                    for (int x0 = x0_start; x0 < x0_end; x0++) {
+                        float * unit = &layer0[(y0*layer0_across + x0)*depth];
+                        for (int d = 0; d < depth; d++) {
+                            maximum[d] = (unit[d] > maximum[d]) ?
+                                unit[d] : maximum[d];
+                        }
+                    }
+                }
+                continue;
+            }
+
+            int * index = &argmax[n1];
             for (int d = 0; d < depth; d++) {
-                if (layer0[n0+d] > layer1[n1+d]) {
-                    layer1[n1+d] = layer0[n0+d];
+                index[d] = n0 + d;
+            }
+            for (int y0 = y0_start; y0 < y0_end; y0++) {
+                for (int x0 = x0_start; x0 < x0_end; x0++) {
+                    n0 = (y0*layer0_across + x0)*depth;
+                    for (int d = 0; d < depth; d++) {
+                        int larger = (layer0[n0+d] > maximum[d]);
+                        maximum[d] = larger ? layer0[n0+d] : maximum[d];
+                        index[d] = larger ? n0+d : index[d];
+                    }
                 }
             }
         }
@@ -82,6 +148,31 @@ int pooling_from_flt_to_flt(int depth,
     return 0;
 }
 
+/**
+ * @brief Pools the first layer into the second (max pooling)
+ * @param depth Depth of the two layers
+ * @param layer0_across Number of units across the first layer
+ * @param layer0_down Number of units down the first layer
+ * @param layer0 Array containing the first layer values
+ * @param layer1_across Number of units across the second layer
+ * @param layer1_down Number of units down the second layer
+ * @param layer1 Array containing the second layer values
+ * @returns zero on success
+ */
+int pooling_from_flt_to_flt(int depth,
+                            int layer0_across,
+                            int layer0_down,
+                            float layer0[],
+                            int layer1_across,
+                            int layer1_down,
+                            float layer1[])
+{
+    return pooling_from_flt_to_flt_argmax(depth,
+                                          layer0_across, layer0_down, layer0,
+                                          layer1_across, layer1_down, layer1,
+                                          NULL);
+}
+
 /**
  * @brief Unpools the first layer into the second (inverse of max pooling)
  * @param depth Depth of the two layers
@@ -101,6 +192,8 @@ int unpooling_from_flt_to_flt(int depth,
                               int original_layer_down,
                               float original_layer[])
 {
+    int y_original;
+
     /* second layer must be smaller than the first */
     if (original_layer_across*original_layer_down >
         pooled_layer_across*pooled_layer_down) {
@@ -115,8 +208,8 @@ int unpooling_from_flt_to_flt(int depth,
         return 0;
     }
 
-    /*#pragma omp parallel for*/
-    for (int y_original = 0; y_original < original_layer_down; y_original++) {
+#pragma omp parallel for num_threads(threads_count()) if (original_layer_across*original_layer_down*depth >= POOLING_PARALLEL_MIN)
+    for (y_original = 0; y_original < original_layer_down; y_original++) {
         int y_pooled = y_original * pooled_layer_down / original_layer_down;
         for (int x_original = 0; x_original < original_layer_across; x_original++) {
             int x_pooled = x_original * pooled_layer_across / original_layer_across;
@@ -130,3 +223,45 @@ int unpooling_from_flt_to_flt(int depth,
 
     return 0;
 }
+
+/**
+ * @brief Unpools a layer by routing each pooled value back to the unit
+ *        which was the maximum when it was pooled.  All other units of
+ *        the original layer become zero.
+ * @param depth Depth of the two layers
+ * @param pooled_layer_across Number of units across the pooled layer
+ * @param pooled_layer_down Number of units down the pooled layer
+ * @param pooled_layer Array containing the pooled layer values
+ * @param argmax Indexes of the maxima as returned by
+ *        pooling_from_flt_to_flt_argmax
+ * @param original_layer_across Number of units across the original layer
+ * @param original_layer_down Number of units down the original layer
+ * @param original_layer Returned values of the original layer
+ * @returns zero on success
+ */
+int unpooling_argmax_from_flt_to_flt(int depth,
+                                     int pooled_layer_across,
+                                     int pooled_layer_down,
+                                     float pooled_layer[],
+                                     int argmax[],
+                                     int original_layer_across,
+                                     int original_layer_down,
+                                     float original_layer[])
+{
+    int pooled_units = pooled_layer_across*pooled_layer_down*depth;
+    int original_units = original_layer_across*original_layer_down*depth;
+
+    /* the original layer must be larger than the pooled one */
+    if (original_units < pooled_units) {
+        return -1;
+    }
+
+    memset((void*)original_layer, '\0', original_units*sizeof(float));
+    for (int i = 0; i < pooled_units; i++) {
+        if ((argmax[i] >= 0) && (argmax[i] < original_units)) {
+            original_layer[argmax[i]] = pooled_layer[i];
+        }
+    }
+
+    return 0;
+}
@@ -40,6 +40,10 @@
 #include "encoding.h"
 #include "backprop.h"
 
+/* minimum number of first layer values before pooling is done in
+   parallel */
+#define POOLING_PARALLEL_MIN 16384
+
 int pooling_from_flt_to_flt(int depth,
                             int layer0_across,
                             int layer0_down,
@@ -48,6 +52,15 @@ int pooling_from_flt_to_flt(int depth,
                             int layer1_down,
                             float layer1[]);
 
+int pooling_from_flt_to_flt_argmax(int depth,
+                                   int layer0_across,
+                                   int layer0_down,
+                                   float layer0[],
+                                   int layer1_across,
+                                   int layer1_down,
+                                   float layer1[],
+                                   int argmax[]);
+
 int unpooling_from_flt_to_flt(int depth,
                               int layer0_across,
                               int layer0_down,
@@ -56,4 +69,13 @@ int unpooling_from_flt_to_flt(int depth,
                               int layer1_down,
                               float layer1[]);
 
+int unpooling_argmax_from_flt_to_flt(int depth,
+                                     int pooled_layer_across,
+                                     int pooled_layer_down,
+                                     float pooled_layer[],
+                                     int argmax[],
+                                     int original_layer_across,
+                                     int original_layer_down,
+                                     float original_layer[]);
+
 #endif
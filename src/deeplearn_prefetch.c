@@ -0,0 +1,330 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "deeplearn_prefetch.h"
+
+/* The queue is lock free where atomic builtins are available. Otherwise
+   no worker threads are started and samples are prepared when they are
+   taken from the queue. */
+#if defined(__GNUC__)
+#define PREFETCH_ATOMIC
+#define PREFETCH_LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define PREFETCH_STORE(ptr, value) __atomic_store_n(ptr, value, __ATOMIC_RELEASE)
+#define PREFETCH_CAS(ptr, expected, desired)                            \
+    __atomic_compare_exchange_n(ptr, expected, desired, 0,              \
+                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+#define PREFETCH_LOAD(ptr) (*(ptr))
+#define PREFETCH_STORE(ptr, value) (*(ptr) = (value))
+#endif
+
+/* number of times to yield before sleeping while waiting */
+#define PREFETCH_SPIN 64
+
+/**
+ * @brief Waits briefly, yielding at first and then sleeping so that
+ *        idle threads do not compete with the learner for the processor
+ * @param count The number of times which the caller has waited so far
+ */
+static void prefetch_wait(int count)
+{
+    struct timespec delay;
+
+    if (count < PREFETCH_SPIN) {
+        sched_yield();
+        return;
+    }
+    delay.tv_sec = 0;
+    delay.tv_nsec = 50000;
+    nanosleep(&delay, NULL);
+}
+
+#ifdef PREFETCH_ATOMIC
+/**
+ * @brief Worker thread which claims requested slots in order and
+ *        prepares them
+ * @param arg The queue
+ * @returns NULL
+ */
+static void * prefetch_worker(void * arg)
+{
+    deeplearn_prefetch * queue = (deeplearn_prefetch*)arg;
+    int idle = 0;
+
+    while (PREFETCH_LOAD(&queue->running) != 0) {
+        unsigned long claim = PREFETCH_LOAD(&queue->claimed);
+        deeplearn_prefetch_slot * slot;
+
+        if (claim >= PREFETCH_LOAD(&queue->requested)) {
+            prefetch_wait(idle++);
+            continue;
+        }
+        if (!PREFETCH_CAS(&queue->claimed, &claim, claim + 1)) {
+            continue;
+        }
+        idle = 0;
+
+        slot = &queue->slot[claim % queue->capacity];
+        slot->retval = queue->prepare(queue->context, slot);
+        PREFETCH_STORE(&slot->state, DEEPLEARN_PREFETCH_READY);
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Stops and joins the worker threads
+ * @param queue Prefetch queue
+ * @param no_of_threads The number of threads which were started
+ */
+static void prefetch_stop(deeplearn_prefetch * queue, int no_of_threads)
+{
+    pthread_t * threads = (pthread_t*)queue->workers;
+
+    PREFETCH_STORE(&queue->running, 0);
+    for (int i = 0; i < no_of_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    queue->workers = NULL;
+    queue->no_of_threads = 0;
+}
+
+/**
+ * @brief Creates a queue of samples prepared ahead of the learner.
+ *        The prepare function is called on the worker threads, so it
+ *        should only read state which does not change while samples
+ *        are pending.
+ * @param queue Prefetch queue
+ * @param capacity The maximum number of samples pending at once
+ * @param no_of_threads The number of worker threads. If zero then
+ *        samples are prepared when taken from the queue.
+ * @param no_of_inputs The number of input values prepared per sample
+ * @param no_of_outputs The number of target values prepared per sample
+ * @param prepare Function which prepares the sample within a slot
+ * @param context Passed to the prepare function
+ * @returns zero on success
+ */
+int deeplearn_prefetch_init(deeplearn_prefetch * queue, int capacity,
+                            int no_of_threads,
+                            int no_of_inputs, int no_of_outputs,
+                            deeplearn_prefetch_function prepare,
+                            void * context)
+{
+    int i, values = no_of_inputs + no_of_outputs;
+
+    memset((void*)queue, '\0', sizeof(deeplearn_prefetch));
+    if ((capacity < 1) || (no_of_threads < 0) ||
+        (no_of_inputs < 1) || (no_of_outputs < 0) || (prepare == NULL)) {
+        return -1;
+    }
+
+    queue->slot = (deeplearn_prefetch_slot*)
+        calloc(capacity, sizeof(deeplearn_prefetch_slot));
+    queue->buffer = (float*)malloc(capacity*values*sizeof(float));
+    if ((queue->slot == NULL) || (queue->buffer == NULL)) {
+        free(queue->slot);
+        free(queue->buffer);
+        memset((void*)queue, '\0', sizeof(deeplearn_prefetch));
+        return -2;
+    }
+    for (i = 0; i < capacity; i++) {
+        queue->slot[i].inputs = &queue->buffer[i*values];
+        queue->slot[i].targets = &queue->buffer[i*values + no_of_inputs];
+    }
+
+    queue->capacity = capacity;
+    queue->no_of_inputs = no_of_inputs;
+    queue->no_of_outputs = no_of_outputs;
+    queue->prepare = prepare;
+    queue->context = context;
+    queue->running = 1;
+
+#ifdef PREFETCH_ATOMIC
+    if (no_of_threads > 0) {
+        pthread_t * threads =
+            (pthread_t*)malloc(no_of_threads*sizeof(pthread_t));
+        if (threads == NULL) {
+            deeplearn_prefetch_free(queue);
+            return -2;
+        }
+        queue->workers = (void*)threads;
+        for (i = 0; i < no_of_threads; i++) {
+            if (pthread_create(&threads[i], NULL,
+                               prefetch_worker, (void*)queue) != 0) {
+                prefetch_stop(queue, i);
+                deeplearn_prefetch_free(queue);
+                return -3;
+            }
+        }
+        queue->no_of_threads = no_of_threads;
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief Returns a free slot in which the next sample may be requested,
+ *        which is then passed to the workers with deeplearn_prefetch_submit
+ * @param queue Prefetch queue
+ * @returns The slot, or NULL if the queue is full
+ */
+deeplearn_prefetch_slot * deeplearn_prefetch_request(deeplearn_prefetch * queue)
+{
+    if (queue->requested - queue->consumed >= (unsigned long)queue->capacity) {
+        return NULL;
+    }
+    return &queue->slot[queue->requested % queue->capacity];
+}
+
+/**
+ * @brief Passes the slot returned by deeplearn_prefetch_request to the
+ *        workers to be prepared
+ * @param queue Prefetch queue
+ */
+void deeplearn_prefetch_submit(deeplearn_prefetch * queue)
+{
+    queue->slot[queue->requested % queue->capacity].state =
+        DEEPLEARN_PREFETCH_REQUESTED;
+    PREFETCH_STORE(&queue->requested, queue->requested + 1);
+}
+
+/**
+ * @brief Returns the oldest pending sample, waiting until it has been
+ *        prepared. It remains in the queue until deeplearn_prefetch_release
+ *        is called.
+ * @param queue Prefetch queue
+ * @returns The prepared slot, or NULL if no samples are pending
+ */
+deeplearn_prefetch_slot * deeplearn_prefetch_next(deeplearn_prefetch * queue)
+{
+    deeplearn_prefetch_slot * slot;
+    int idle = 0;
+
+    if (queue->consumed == queue->requested) {
+        return NULL;
+    }
+
+    slot = &queue->slot[queue->consumed % queue->capacity];
+    if (queue->no_of_threads == 0) {
+        if (slot->state == DEEPLEARN_PREFETCH_REQUESTED) {
+            slot->retval = queue->prepare(queue->context, slot);
+            slot->state = DEEPLEARN_PREFETCH_READY;
+        }
+        return slot;
+    }
+
+    while (PREFETCH_LOAD(&slot->state) != DEEPLEARN_PREFETCH_READY) {
+        prefetch_wait(idle++);
+    }
+    return slot;
+}
+
+/**
+ * @brief Frees the slot returned by deeplearn_prefetch_next, so that
+ *        another sample may be requested
+ * @param queue Prefetch queue
+ */
+void deeplearn_prefetch_release(deeplearn_prefetch * queue)
+{
+    if (queue->consumed == queue->requested) {
+        return;
+    }
+    queue->slot[queue->consumed % queue->capacity].state =
+        DEEPLEARN_PREFETCH_FREE;
+    queue->consumed++;
+}
+
+/**
+ * @brief Returns the number of samples which have been requested but
+ *        not yet released
+ * @param queue Prefetch queue
+ * @returns The number of pending samples
+ */
+int deeplearn_prefetch_pending(deeplearn_prefetch * queue)
+{
+    return (int)(queue->requested - queue->consumed);
+}
+
+/**
+ * @brief Waits for pending samples to be prepared and discards them.
+ *        Afterwards the workers are idle, so state which they read may
+ *        be changed.
+ * @param queue Prefetch queue
+ */
+void deeplearn_prefetch_drain(deeplearn_prefetch * queue)
+{
+    if (queue->capacity == 0) {
+        return;
+    }
+    while (deeplearn_prefetch_next(queue) != NULL) {
+        deeplearn_prefetch_release(queue);
+    }
+}
+
+/**
+ * @brief Returns the number of bytes allocated for the slots of a queue
+ *        and its worker threads
+ * @param queue Prefetch queue
+ * @returns Allocated bytes, or zero if the queue is not allocated
+ */
+size_t deeplearn_prefetch_allocated(deeplearn_prefetch * queue)
+{
+    size_t values = (size_t)queue->no_of_inputs + queue->no_of_outputs;
+    size_t bytes;
+
+    if (queue->slot == NULL) return 0;
+
+    bytes = (size_t)queue->capacity*
+        (sizeof(deeplearn_prefetch_slot) + values*sizeof(float));
+#ifdef PREFETCH_ATOMIC
+    bytes += (size_t)queue->no_of_threads*sizeof(pthread_t);
+#endif
+    return bytes;
+}
+
+/**
+ * @brief Stops the worker threads and frees the queue
+ * @param queue Prefetch queue
+ */
+void deeplearn_prefetch_free(deeplearn_prefetch * queue)
+{
+    if (queue->capacity == 0) {
+        return;
+    }
+    prefetch_stop(queue, queue->no_of_threads);
+    free(queue->slot);
+    free(queue->buffer);
+    memset((void*)queue, '\0', sizeof(deeplearn_prefetch));
+}
@@ -0,0 +1,119 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_PREFETCH_H
+#define DEEPLEARN_PREFETCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+/* default number of samples prepared ahead of the learner */
+#define DEEPLEARN_PREFETCH_CAPACITY 64
+
+/* states of a slot within the queue */
+#define DEEPLEARN_PREFETCH_FREE      0
+#define DEEPLEARN_PREFETCH_REQUESTED 1
+#define DEEPLEARN_PREFETCH_READY     2
+
+/* A sample which has been requested by the learner and is prepared by
+   a worker. The learner fills in which sample is wanted, and the worker
+   fills in the inputs and targets. */
+struct deeplearn_prefetch_slot {
+    int state;
+
+    /* identifies the training phase for which the sample was requested */
+    int tag;
+
+    /* position of the sample within the set being trained on */
+    int position;
+
+    /* the sample itself, either as an index or as a pointer */
+    int index;
+    void * sample;
+
+    /* prepared network input and target values */
+    float * inputs;
+    float * targets;
+
+    /* returned by the prepare function, zero on success */
+    int retval;
+};
+typedef struct deeplearn_prefetch_slot deeplearn_prefetch_slot;
+
+/* prepares the sample within a slot, returning zero on success */
+typedef int (*deeplearn_prefetch_function)(void * context,
+                                           deeplearn_prefetch_slot * slot);
+
+/* A bounded queue of samples prepared ahead of the learner by worker
+   threads. Slots form a ring which the learner fills with requests,
+   the workers claim requests with an atomic compare and swap and mark
+   them ready, and the learner takes ready slots in the order in which
+   they were requested. Delivery order is therefore the same whatever
+   the number of workers. */
+struct deeplearn_prefetch {
+    int capacity;
+    int no_of_inputs;
+    int no_of_outputs;
+    deeplearn_prefetch_slot * slot;
+    float * buffer;
+
+    deeplearn_prefetch_function prepare;
+    void * context;
+
+    /* sequence numbers of requests made, claimed by workers and
+       consumed. Only claimed is written by the workers. */
+    unsigned long requested;
+    unsigned long claimed;
+    unsigned long consumed;
+
+    int running;
+    int no_of_threads;
+
+    /* thread state, which is private to deeplearn_prefetch.c */
+    void * workers;
+};
+typedef struct deeplearn_prefetch deeplearn_prefetch;
+
+int deeplearn_prefetch_init(deeplearn_prefetch * queue, int capacity,
+                            int no_of_threads,
+                            int no_of_inputs, int no_of_outputs,
+                            deeplearn_prefetch_function prepare,
+                            void * context);
+deeplearn_prefetch_slot * deeplearn_prefetch_request(deeplearn_prefetch * queue);
+void deeplearn_prefetch_submit(deeplearn_prefetch * queue);
+deeplearn_prefetch_slot * deeplearn_prefetch_next(deeplearn_prefetch * queue);
+void deeplearn_prefetch_release(deeplearn_prefetch * queue);
+int deeplearn_prefetch_pending(deeplearn_prefetch * queue);
+void deeplearn_prefetch_drain(deeplearn_prefetch * queue);
+size_t deeplearn_prefetch_allocated(deeplearn_prefetch * queue);
+void deeplearn_prefetch_free(deeplearn_prefetch * queue);
+
+#endif
@@ -59,3 +59,146 @@ float rand_initial_weight(unsigned int * seed)
 {
     return (0.2f*(rand_num(seed)%100000/100000.0f)) - 0.1f;
 }
+
+/**
+ * @brief Derives the seed for one of several independent random
+ *        number streams, such as one stream per thread
+ * @param seed The seed from which the streams are derived
+ * @param stream Index number of the stream
+ * @return Seed for the given stream
+ */
+unsigned int rand_stream_seed(unsigned int seed, int stream)
+{
+    unsigned int v = seed + ((unsigned int)stream * 0x9E3779B9U);
+
+    /* mix the bits so that neighbouring streams are uncorrelated */
+    v ^= v >> 16;
+    v *= 0x85EBCA6BU;
+    v ^= v >> 13;
+    v *= 0xC2B2AE35U;
+    v ^= v >> 16;
+    return v;
+}
+
+/**
+ * @brief Counter based random number generator (Philox2x32-10).
+ *        Each output depends only upon the key and the counter, so
+ *        any element of a stream can be generated independently.
+ *        This allows arrays to be filled in parallel or with SIMD,
+ *        giving the same values whatever the number of threads.
+ * @param key Key which selects the stream, such as a seed
+ * @param counter Position within the stream
+ * @return Pseudo-random number
+ */
+unsigned int rand_counter(unsigned int key, unsigned int counter)
+{
+    unsigned int c0 = counter, c1 = 0;
+
+    for (int r = 0; r < 10; r++) {
+        unsigned long long p = (unsigned long long)0xD256D193U * c0;
+        c0 = (unsigned int)(p >> 32) ^ key ^ c1;
+        c1 = (unsigned int)p;
+        key += 0x9E3779B9U;
+    }
+    return c0;
+}
+
+/**
+ * @brief Returns a uniformly distributed value from a counter based stream
+ * @param key Key which selects the stream, such as a seed
+ * @param counter Position within the stream
+ * @return Value in the range 0.0 <= v < 1.0
+ */
+float rand_uniform(unsigned int key, unsigned int counter)
+{
+    return (rand_counter(key, counter) >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * @brief Fills an array with uniformly distributed values
+ * @param key Key which selects the stream, such as a seed
+ * @param counter Position within the stream of the first value
+ * @param values Array to be filled
+ * @param n Number of values
+ */
+void rand_fill_uniform(unsigned int key, unsigned int counter,
+                       float * values, int n)
+{
+#pragma omp simd
+    for (int i = 0; i < n; i++) {
+        values[i] = rand_uniform(key, counter + (unsigned int)i);
+    }
+}
+
+/**
+ * @brief Blends uniformly distributed noise into an array of values
+ * @param key Key which selects the stream, such as a seed
+ * @param counter Position within the stream of the first value
+ * @param values Array of values
+ * @param n Number of values
+ * @param noise Amount of noise in the range 0.0 - 1.0
+ */
+void rand_add_noise(unsigned int key, unsigned int counter,
+                    float * values, int n, float noise)
+{
+#pragma omp simd
+    for (int i = 0; i < n; i++) {
+        values[i] = ((1.0f - noise) * values[i]) +
+            (noise * rand_uniform(key, counter + (unsigned int)i));
+    }
+}
+
+/**
+ * @brief Randomly selects a fixed percentage of units which drop out.
+ *        Random numbers come from the counter based generator, the
+ *        dropped units are picked with a partial Fisher-Yates shuffle,
+ *        and the active units are then compacted into a list of
+ *        indexes without branching.
+ * @param seed Random number generator seed, advanced once per call
+ * @param percent Percentage of units which drop out, in the range 0-100
+ * @param mask Returned mask of n values, one for active units and
+ *        zero for units which have dropped out
+ * @param active Returned indexes of the active units
+ * @param n The number of units
+ * @return The number of active units
+ */
+int rand_dropouts(unsigned int * seed, float percent,
+                  float * mask, int * active, int n)
+{
+    int i, k, tmp, no_of_dropouts, no_of_active = 0;
+
+    no_of_dropouts = (int)(percent*n/100);
+    if (no_of_dropouts >= n) {
+        /* always keep at least one unit */
+        no_of_dropouts = n-1;
+    }
+
+    for (i = 0; i < n; i++) {
+        mask[i] = 1;
+        active[i] = i;
+    }
+    if (no_of_dropouts <= 0) {
+        return n;
+    }
+
+    /* move the dropped units to the front of the index list */
+    for (i = 0; i < no_of_dropouts; i++) {
+        k = i + (int)(rand_counter(*seed, (unsigned int)i) %
+                      (unsigned int)(n - i));
+        tmp = active[i];
+        active[i] = active[k];
+        active[k] = tmp;
+    }
+    for (i = 0; i < no_of_dropouts; i++) {
+        mask[active[i]] = 0;
+    }
+
+    /* compacted list of the remaining units */
+    for (i = 0; i < n; i++) {
+        active[no_of_active] = i;
+        no_of_active += (mask[i] != 0);
+    }
+
+    rand_num(seed);
+    return no_of_active;
+}
@@ -41,5 +41,14 @@
 
 int rand_num(unsigned int * seed);
 float rand_initial_weight(unsigned int * seed);
+unsigned int rand_stream_seed(unsigned int seed, int stream);
+unsigned int rand_counter(unsigned int key, unsigned int counter);
+float rand_uniform(unsigned int key, unsigned int counter);
+void rand_fill_uniform(unsigned int key, unsigned int counter,
+                       float * values, int n);
+void rand_add_noise(unsigned int key, unsigned int counter,
+                    float * values, int n, float noise);
+int rand_dropouts(unsigned int * seed, float percent,
+                  float * mask, int * active, int n);
 
 #endif
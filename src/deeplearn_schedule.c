@@ -0,0 +1,228 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_schedule.h"
+
+/**
+ * @brief Initialises a schedule which leaves the learning rate alone
+ *        and never stops training
+ * @param schedule Schedule object
+ */
+void schedule_init(deeplearn_schedule * schedule)
+{
+    memset((void*)schedule, '\0', sizeof(deeplearn_schedule));
+    schedule->type = SCHEDULE_CONSTANT;
+    schedule->gamma = 1;
+    schedule->factor = 1;
+    schedule->scale = 1;
+    schedule->best = -1;
+}
+
+/**
+ * @brief Sets how the learning rate changes over successive updates.
+ *        The step count is reset, so the schedule begins again.
+ * @param schedule Schedule object
+ * @param type Schedule type, such as SCHEDULE_COSINE
+ * @param base_rate Learning rate at the start of the schedule
+ * @param min_rate The lowest learning rate allowed
+ * @param period Updates between steps of SCHEDULE_STEP, or the length
+ *        of each cycle of SCHEDULE_COSINE
+ * @param gamma Multiplier applied at each step of SCHEDULE_STEP
+ * @returns zero on success
+ */
+int schedule_set(deeplearn_schedule * schedule, int type,
+                 float base_rate, float min_rate,
+                 unsigned int period, float gamma)
+{
+    if ((type < 0) || (type >= SCHEDULES)) {
+        return -1;
+    }
+    if ((base_rate <= 0) || (min_rate < 0) || (min_rate > base_rate)) {
+        return -2;
+    }
+    if ((type != SCHEDULE_CONSTANT) && (period == 0)) {
+        return -3;
+    }
+
+    schedule->enabled = 1;
+    schedule->type = type;
+    schedule->base_rate = base_rate;
+    schedule->min_rate = min_rate;
+    schedule->period = period;
+    schedule->gamma = gamma;
+    schedule->step = 0;
+    return 0;
+}
+
+/**
+ * @brief Sets the number of updates over which the learning rate rises
+ *        linearly to the base rate of the schedule
+ * @param schedule Schedule object
+ * @param updates Number of warmup updates, or zero for none
+ */
+void schedule_set_warmup(deeplearn_schedule * schedule,
+                         unsigned int updates)
+{
+    schedule->warmup = updates;
+}
+
+/**
+ * @brief Enables detection of a plateau in the training error
+ * @param schedule Schedule object
+ * @param patience Number of history entries without improvement which
+ *        count as a plateau, or zero to disable
+ * @param min_delta The smallest decrease in error which counts as an
+ *        improvement
+ * @param factor Multiplier in the range 0 to 1 applied to the learning
+ *        rate on each plateau
+ * @param max_reductions Number of plateaus after which training stops
+ * @returns zero on success
+ */
+int schedule_set_plateau(deeplearn_schedule * schedule,
+                         unsigned int patience, float min_delta,
+                         float factor, unsigned int max_reductions)
+{
+    if ((factor <= 0) || (factor > 1) || (min_delta < 0)) {
+        return -1;
+    }
+    schedule->patience = patience;
+    schedule->min_delta = min_delta;
+    schedule->factor = factor;
+    schedule->max_reductions = max_reductions;
+    schedule_reset_plateau(schedule);
+    return 0;
+}
+
+/**
+ * @brief Forgets the best error seen so far and any reductions of the
+ *        learning rate, such as when moving on to train a different layer
+ * @param schedule Schedule object
+ */
+void schedule_reset_plateau(deeplearn_schedule * schedule)
+{
+    schedule->best = -1;
+    schedule->stale = 0;
+    schedule->reductions = 0;
+    schedule->scale = 1;
+}
+
+/**
+ * @brief Returns the learning rate for the current step
+ * @param schedule Schedule object
+ * @returns Learning rate
+ */
+float schedule_learning_rate(deeplearn_schedule * schedule)
+{
+    unsigned int step = schedule->step;
+    float rate = schedule->base_rate;
+    float t;
+
+    if (step < schedule->warmup) {
+        rate = schedule->base_rate * (step + 1) / schedule->warmup;
+    }
+    else {
+        step -= schedule->warmup;
+        switch(schedule->type) {
+        case SCHEDULE_STEP: {
+            rate *= powf(schedule->gamma, (float)(step / schedule->period));
+            break;
+        }
+        case SCHEDULE_COSINE: {
+            /* restarts at the beginning of each cycle */
+            t = (float)(step % schedule->period) / schedule->period;
+            rate = schedule->min_rate +
+                (schedule->base_rate - schedule->min_rate) *
+                0.5f * (1.0f + cosf(3.14159265f * t));
+            break;
+        }
+        }
+    }
+
+    rate *= schedule->scale;
+    if (rate < schedule->min_rate) {
+        rate = schedule->min_rate;
+    }
+    return rate;
+}
+
+/**
+ * @brief Advances the step count after each update
+ * @param schedule Schedule object
+ * @returns SCHEDULE_LIMIT if the maximum number of updates has been
+ *          reached, otherwise SCHEDULE_RUNNING
+ */
+int schedule_next_step(deeplearn_schedule * schedule)
+{
+    if (schedule->step < UINT_MAX) {
+        schedule->step++;
+    }
+    if ((schedule->max_updates > 0) &&
+        (schedule->step >= schedule->max_updates)) {
+        schedule->stopped = SCHEDULE_LIMIT;
+        return SCHEDULE_LIMIT;
+    }
+    return SCHEDULE_RUNNING;
+}
+
+/**
+ * @brief Checks for a plateau when an entry is added to the training
+ *        history.  On a plateau the learning rate is reduced, unless
+ *        the allowed number of reductions has been used up.
+ * @param schedule Schedule object
+ * @param error The latest training error
+ * @returns SCHEDULE_PLATEAU if training should stop, otherwise
+ *          SCHEDULE_RUNNING
+ */
+int schedule_plateau(deeplearn_schedule * schedule, float error)
+{
+    if (schedule->patience == 0) {
+        return SCHEDULE_RUNNING;
+    }
+
+    if ((schedule->best < 0) ||
+        (error < schedule->best - schedule->min_delta)) {
+        schedule->best = error;
+        schedule->stale = 0;
+        return SCHEDULE_RUNNING;
+    }
+
+    schedule->stale++;
+    if (schedule->stale < schedule->patience) {
+        return SCHEDULE_RUNNING;
+    }
+
+    schedule->stale = 0;
+    if (schedule->reductions >= schedule->max_reductions) {
+        schedule->stopped = SCHEDULE_PLATEAU;
+        return SCHEDULE_PLATEAU;
+    }
+    schedule->reductions++;
+    schedule->scale *= schedule->factor;
+    return SCHEDULE_RUNNING;
+}
@@ -0,0 +1,119 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_SCHEDULE_H
+#define DEEPLEARN_SCHEDULE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+
+/* how the learning rate changes over successive updates */
+#define SCHEDULE_CONSTANT  0
+#define SCHEDULE_STEP      1
+#define SCHEDULE_COSINE    2
+#define SCHEDULES          3
+
+/* reasons for training having been stopped by the schedule */
+#define SCHEDULE_RUNNING   0
+#define SCHEDULE_PLATEAU   1
+#define SCHEDULE_LIMIT     2
+#define SCHEDULE_CALLBACK  3
+
+/* Learning rate schedule and early stopping of a training run.
+   The rate begins with an optional linear warmup, after which it
+   follows the schedule type.  Separately, the error is checked for a
+   plateau each time an entry is added to the training history, and if
+   it has not improved for a number of entries then the rate is reduced,
+   or training stops once the allowed number of reductions is used up */
+typedef struct {
+    /* non-zero if the schedule sets the learning rate */
+    unsigned char enabled;
+
+    int type;
+
+    /* rate at the start of the schedule and the lowest rate allowed */
+    float base_rate, min_rate;
+
+    /* updates between steps of SCHEDULE_STEP, or the length of each
+       cycle of SCHEDULE_COSINE */
+    unsigned int period;
+
+    /* multiplier applied to the rate at each step of SCHEDULE_STEP */
+    float gamma;
+
+    /* number of updates over which the rate rises to base_rate */
+    unsigned int warmup;
+
+    /* number of updates so far */
+    unsigned int step;
+
+    /* stop after this number of updates, or zero for no limit */
+    unsigned int max_updates;
+
+    /* number of history entries without improvement which count as a
+       plateau, or zero to disable plateau detection */
+    unsigned int patience;
+
+    /* the smallest decrease in error which counts as an improvement */
+    float min_delta;
+
+    /* multiplier applied to the rate on each plateau */
+    float factor;
+
+    /* number of plateaus after which training stops */
+    unsigned int max_reductions;
+
+    /* state of plateau detection */
+    float best;
+    unsigned int stale;
+    unsigned int reductions;
+    float scale;
+
+    /* why training was stopped, or SCHEDULE_RUNNING */
+    int stopped;
+} deeplearn_schedule;
+
+void schedule_init(deeplearn_schedule * schedule);
+int schedule_set(deeplearn_schedule * schedule, int type,
+                 float base_rate, float min_rate,
+                 unsigned int period, float gamma);
+void schedule_set_warmup(deeplearn_schedule * schedule,
+                         unsigned int updates);
+int schedule_set_plateau(deeplearn_schedule * schedule,
+                         unsigned int patience, float min_delta,
+                         float factor, unsigned int max_reductions);
+void schedule_reset_plateau(deeplearn_schedule * schedule);
+float schedule_learning_rate(deeplearn_schedule * schedule);
+int schedule_next_step(deeplearn_schedule * schedule);
+int schedule_plateau(deeplearn_schedule * schedule, float error);
+
+#endif
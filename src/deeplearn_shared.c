@@ -0,0 +1,178 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* shared memory is part of POSIX rather than C99 */
+#define _POSIX_C_SOURCE 200809L
+
+#include "deeplearn_shared.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SHARED_SHM
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef SHARED_SHM
+/**
+ * @brief Returns the name of a shared memory object as used by shm_open,
+ *        which begins with a slash
+ * @param name Name of the shared memory object
+ * @param object_name Returned name
+ * @returns zero on success
+ */
+static int shared_object_name(char * name, char * object_name)
+{
+    int length;
+
+    if ((name == NULL) || (name[0] == 0)) return -1;
+    if (name[0] == '/') name++;
+    length = (int)strlen(name);
+    if ((length == 0) || (length >= SHARED_MAX_NAME) ||
+        (strchr(name, '/') != NULL)) {
+        return -1;
+    }
+    object_name[0] = '/';
+    memcpy(&object_name[1], name, length + 1);
+    return 0;
+}
+#endif
+
+/**
+ * @brief Copies a model file or binary dataset file into a named shared
+ *        memory object, replacing any existing object with the same
+ *        name.  The object remains until shared_unlink is called, so
+ *        it is usually published once before worker processes start.
+ * @param name Name of the shared memory object
+ * @param filename Filename of the model or dataset
+ * @returns zero on success
+ */
+int shared_publish(char * name, char * filename)
+{
+#ifdef SHARED_SHM
+    char object_name[SHARED_MAX_NAME+1];
+    unsigned char * data;
+    long size;
+    int fd;
+    FILE * fp;
+
+    if (shared_object_name(name, object_name) != 0) {
+        return -1;
+    }
+
+    fp = fopen(filename, "rb");
+    if (!fp) {
+        return -2;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return -3;
+    }
+
+    /* a new object, so that processes already attached to an earlier
+       one keep their contents */
+    shm_unlink(object_name);
+    fd = shm_open(object_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        fclose(fp);
+        return -4;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        fclose(fp);
+        shm_unlink(object_name);
+        return -4;
+    }
+    data = (unsigned char*)mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fclose(fp);
+        shm_unlink(object_name);
+        return -4;
+    }
+    if (fread(data, 1, (size_t)size, fp) != (size_t)size) {
+        munmap(data, (size_t)size);
+        fclose(fp);
+        shm_unlink(object_name);
+        return -5;
+    }
+    munmap(data, (size_t)size);
+    fclose(fp);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief Opens a named shared memory object for reading
+ * @param name Name of the shared memory object
+ * @returns File descriptor, or negative on error
+ */
+int shared_open(char * name)
+{
+#ifdef SHARED_SHM
+    char object_name[SHARED_MAX_NAME+1];
+
+    if (shared_object_name(name, object_name) != 0) {
+        return -1;
+    }
+    return shm_open(object_name, O_RDONLY, 0);
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief Removes a named shared memory object.  Processes which are
+ *        attached to it keep their mappings.
+ * @param name Name of the shared memory object
+ * @returns zero on success
+ */
+int shared_unlink(char * name)
+{
+#ifdef SHARED_SHM
+    char object_name[SHARED_MAX_NAME+1];
+
+    if (shared_object_name(name, object_name) != 0) {
+        return -1;
+    }
+    if (shm_unlink(object_name) != 0) {
+        return -2;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
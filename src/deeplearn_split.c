@@ -0,0 +1,306 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_split.h"
+
+/**
+ * @brief Shuffles an array of indexes using Fisher-Yates, for example
+ *        to reorder a training set at the start of each epoch
+ * @param indexes Array of indexes
+ * @param n The number of indexes
+ * @param random_seed Random number seed
+ */
+void deeplearn_split_shuffle(int indexes[], int n,
+                             unsigned int * random_seed)
+{
+    for (int i = n - 1; i > 0; i--) {
+        int j = (int)(rand_num(random_seed) % (i + 1));
+        int swap = indexes[i];
+        indexes[i] = indexes[j];
+        indexes[j] = swap;
+    }
+}
+
+/**
+ * @brief Divides samples into training and test sets in O(n).
+ *        Samples are visited in a random permutation, and the rank of each
+ *        sample within its class decides which set it belongs to, so that
+ *        each class is represented in the same proportions in both sets.
+ * @param n The number of samples
+ * @param classes Class number of each sample, or NULL if the split is not
+ *        stratified. Samples with a negative class are always used for
+ *        training, which suits unlabeled samples.
+ * @param folds The number of folds, or zero to split by percentage
+ * @param fold Index of the fold used as the test set
+ * @param test_percentage Percentage of each class used for testing
+ *        when not splitting into folds
+ * @param random_seed Random number seed
+ * @param training Returned training set indexes, in random order
+ *        (array of at least n)
+ * @param training_samples Returned size of the training set
+ * @param test Returned test set indexes, in random order
+ *        (array of at least n)
+ * @param test_samples Returned size of the test set
+ * @returns zero on success
+ */
+static int split_samples(int n, int classes[], int folds, int fold,
+                         int test_percentage,
+                         unsigned int * random_seed,
+                         int training[], int * training_samples,
+                         int test[], int * test_samples)
+{
+    int no_of_classes = 1;
+    int * count, * rank, * order;
+
+    *training_samples = 0;
+    *test_samples = 0;
+    if (n <= 0) {
+        return -1;
+    }
+
+    if (classes) {
+        for (int i = 0; i < n; i++) {
+            if (classes[i] >= no_of_classes) {
+                no_of_classes = classes[i] + 1;
+            }
+        }
+    }
+
+    order = (int*)malloc(n*sizeof(int));
+    count = (int*)calloc(no_of_classes, sizeof(int));
+    rank = (int*)calloc(no_of_classes, sizeof(int));
+    if ((!order) || (!count) || (!rank)) {
+        free(order);
+        free(count);
+        free(rank);
+        return -2;
+    }
+
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+        if (classes == NULL) {
+            count[0]++;
+        }
+        else if (classes[i] >= 0) {
+            count[classes[i]]++;
+        }
+    }
+    deeplearn_split_shuffle(order, n, random_seed);
+
+    for (int i = 0; i < n; i++) {
+        int index = order[i];
+        int c = (classes == NULL) ? 0 : classes[index];
+        int is_test = 0;
+
+        if (c >= 0) {
+            int r = rank[c]++;
+            if (folds > 0) {
+                is_test = ((int)((long)r * folds / count[c]) == fold);
+            }
+            else {
+                /* the same rounding as a training set of
+                   n*(100-percentage)/100 samples */
+                is_test = (r >= count[c]*(100 - test_percentage)/100);
+            }
+        }
+
+        if (is_test != 0) {
+            test[(*test_samples)++] = index;
+        }
+        else {
+            training[(*training_samples)++] = index;
+        }
+    }
+
+    free(order);
+    free(count);
+    free(rank);
+    return 0;
+}
+
+/**
+ * @brief Divides samples into training and test sets
+ * @param n The number of samples
+ * @param classes Class number of each sample for a stratified split,
+ *        or NULL. Samples with a negative class are always used for training.
+ * @param test_percentage Percentage of samples used for testing
+ * @param random_seed Random number seed
+ * @param training Returned training set indexes (array of at least n)
+ * @param training_samples Returned size of the training set
+ * @param test Returned test set indexes (array of at least n)
+ * @param test_samples Returned size of the test set
+ * @returns zero on success
+ */
+int deeplearn_split(int n, int classes[], int test_percentage,
+                    unsigned int * random_seed,
+                    int training[], int * training_samples,
+                    int test[], int * test_samples)
+{
+    if ((test_percentage < 0) || (test_percentage > 100)) {
+        return -3;
+    }
+    return split_samples(n, classes, 0, 0, test_percentage, random_seed,
+                         training, training_samples,
+                         test, test_samples);
+}
+
+/**
+ * @brief Divides samples into k folds for cross validation, returning the
+ *        given fold as the test set and the remainder as the training set.
+ *        The same random seed should be used for every fold so that the
+ *        folds do not overlap.
+ * @param n The number of samples
+ * @param classes Class number of each sample for stratified folds,
+ *        or NULL. Samples with a negative class are always used for training.
+ * @param folds The number of folds
+ * @param fold Index of the fold to be used for testing
+ * @param random_seed Random number seed
+ * @param training Returned training set indexes (array of at least n)
+ * @param training_samples Returned size of the training set
+ * @param test Returned test set indexes (array of at least n)
+ * @param test_samples Returned size of the test set
+ * @returns zero on success
+ */
+int deeplearn_split_kfold(int n, int classes[], int folds, int fold,
+                          unsigned int random_seed,
+                          int training[], int * training_samples,
+                          int test[], int * test_samples)
+{
+    if ((folds < 2) || (fold < 0) || (fold >= folds)) {
+        return -3;
+    }
+    return split_samples(n, classes, folds, fold, 0, &random_seed,
+                         training, training_samples,
+                         test, test_samples);
+}
+
+/**
+ * @brief Initialises epoch based sampling
+ * @param epoch Epoch state
+ * @param enabled Non-zero if samples are to be taken sequentially in epochs
+ */
+void deeplearn_epoch_init(deeplearn_epoch * epoch, unsigned char enabled)
+{
+    memset((void*)epoch, '\0', sizeof(deeplearn_epoch));
+    epoch->enabled = enabled;
+    epoch->error = DEEPLEARN_UNKNOWN_ERROR;
+}
+
+/**
+ * @brief Called before samples are taken from a training set. If the set
+ *        being iterated has changed then a new epoch begins.
+ * @param epoch Epoch state
+ * @param phase Identifies the set being iterated, for example pretraining
+ *        or training of the whole network
+ * @param set_size The number of samples within the set
+ * @returns Non-zero if a new epoch begins and the set should be shuffled
+ */
+int deeplearn_epoch_start(deeplearn_epoch * epoch, int phase, int set_size)
+{
+    if (phase != epoch->phase) {
+        epoch->phase = phase;
+        epoch->position = 0;
+        epoch->error_sum = 0;
+        epoch->error_samples = 0;
+    }
+    if (epoch->position >= set_size) {
+        epoch->position = 0;
+    }
+    return (epoch->position == 0);
+}
+
+/**
+ * @brief Takes samples from the current epoch. Batches do not cross the
+ *        end of an epoch, so the last batch may be smaller.
+ * @param epoch Epoch state
+ * @param set_size The number of samples within the set
+ * @param samples The number of samples wanted
+ * @returns Position of the first sample within the set. The number of
+ *          samples available is set_size less this position.
+ */
+int deeplearn_epoch_take(deeplearn_epoch * epoch, int set_size,
+                         int samples)
+{
+    int position = epoch->position;
+
+    if (samples > set_size - position) {
+        samples = set_size - position;
+    }
+    epoch->position += samples;
+    return position;
+}
+
+/**
+ * @brief Adds the training error after an update to the error of the
+ *        current epoch
+ * @param epoch Epoch state
+ * @param error Training error after the update
+ * @param samples The number of samples within the update
+ */
+void deeplearn_epoch_record(deeplearn_epoch * epoch, float error,
+                            int samples)
+{
+    if (error != DEEPLEARN_UNKNOWN_ERROR) {
+        epoch->error_sum += error * samples;
+        epoch->error_samples += samples;
+    }
+}
+
+/**
+ * @brief Completes the current epoch, so that its average error becomes
+ *        the epoch error
+ * @param epoch Epoch state
+ */
+void deeplearn_epoch_complete(deeplearn_epoch * epoch)
+{
+    epoch->epochs++;
+    if (epoch->error_samples > 0) {
+        epoch->error = epoch->error_sum / epoch->error_samples;
+    }
+    epoch->error_sum = 0;
+    epoch->error_samples = 0;
+}
+
+/**
+ * @brief Records the training error after an update, completing the
+ *        epoch when every sample in the set has been visited
+ * @param epoch Epoch state
+ * @param error Training error after the update
+ * @param samples The number of samples within the update
+ * @param set_size The number of samples within the set
+ */
+void deeplearn_epoch_update(deeplearn_epoch * epoch, float error,
+                            int samples, int set_size)
+{
+    deeplearn_epoch_record(epoch, error, samples);
+    if (epoch->position >= set_size) {
+        deeplearn_epoch_complete(epoch);
+        epoch->position = 0;
+    }
+}
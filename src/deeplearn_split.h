@@ -0,0 +1,87 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_SPLIT_H
+#define DEEPLEARN_SPLIT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "globals.h"
+#include "deeplearn_random.h"
+
+/* ways in which samples may be divided into training and test sets */
+#define DEEPLEARN_SPLIT_RANDOM      0
+#define DEEPLEARN_SPLIT_STRATIFIED  1
+#define DEEPLEARN_SPLIT_METHODS     2
+
+/* Sequential sampling in epochs. Training samples are taken in order
+   from the training set, which is shuffled at the start of each epoch,
+   so that every sample is visited once per epoch. */
+typedef struct {
+    unsigned char enabled;
+
+    /* the set being iterated, which restarts the epoch if it changes */
+    int phase;
+
+    /* next position within the training set */
+    int position;
+
+    /* number of completed epochs */
+    unsigned int epochs;
+
+    /* error accumulated during the current epoch */
+    float error_sum;
+    int error_samples;
+
+    /* average error over the last completed epoch */
+    float error;
+} deeplearn_epoch;
+
+void deeplearn_epoch_init(deeplearn_epoch * epoch, unsigned char enabled);
+int deeplearn_epoch_start(deeplearn_epoch * epoch, int phase, int set_size);
+int deeplearn_epoch_take(deeplearn_epoch * epoch, int set_size,
+                         int samples);
+void deeplearn_epoch_record(deeplearn_epoch * epoch, float error,
+                            int samples);
+void deeplearn_epoch_complete(deeplearn_epoch * epoch);
+void deeplearn_epoch_update(deeplearn_epoch * epoch, float error,
+                            int samples, int set_size);
+void deeplearn_split_shuffle(int indexes[], int n,
+                             unsigned int * random_seed);
+int deeplearn_split(int n, int classes[], int test_percentage,
+                    unsigned int * random_seed,
+                    int training[], int * training_samples,
+                    int test[], int * test_samples);
+int deeplearn_split_kfold(int n, int classes[], int folds, int fold,
+                          unsigned int random_seed,
+                          int training[], int * training_samples,
+                          int test[], int * test_samples);
+
+#endif
@@ -0,0 +1,250 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <time.h>
+#include "deeplearn_stats.h"
+
+static deeplearn_stats deeplearn_stats_global;
+
+static const char * deeplearn_stats_phase_names[DEEPLEARN_STATS_PHASES] = {
+    "feed_forward", "backprop", "learn", "pretrain",
+    "convolution", "pooling", "update", "update_image"
+};
+
+/* phases for which each layer is reported separately */
+static const unsigned char deeplearn_stats_layered[DEEPLEARN_STATS_PHASES] = {
+    0, 0, 0, 1, 1, 1, 0, 0
+};
+
+/**
+ * @brief Returns a monotonic time in seconds
+ * @return Time in seconds
+ */
+double deeplearn_stats_clock()
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (t.tv_nsec * 1.0e-9);
+}
+
+/**
+ * @brief Records the time taken by one call within a phase.
+ *        This may be called from parallel regions.
+ * @param phase Index of the phase, eg. DEEPLEARN_STATS_FEED_FORWARD
+ * @param layer Layer index, or zero if the phase is not layered
+ * @param seconds Time taken
+ */
+void deeplearn_stats_record(int phase, int layer, double seconds)
+{
+    deeplearn_stats_counter * counter;
+
+    if ((phase < 0) || (phase >= DEEPLEARN_STATS_PHASES)) return;
+    if (layer < 0) layer = 0;
+    if (layer >= DEEPLEARN_STATS_MAX_LAYERS) {
+        layer = DEEPLEARN_STATS_MAX_LAYERS-1;
+    }
+
+    counter = &deeplearn_stats_global.phase[phase][layer];
+#pragma omp atomic
+    counter->calls++;
+#pragma omp atomic
+    counter->seconds += seconds;
+}
+
+/**
+ * @brief Adds to the number of training samples presented
+ * @param samples The number of samples
+ */
+void deeplearn_stats_add_samples(unsigned long long samples)
+{
+#pragma omp atomic
+    deeplearn_stats_global.samples += samples;
+}
+
+/**
+ * @brief Adds to the number of training images presented
+ * @param images The number of images
+ */
+void deeplearn_stats_add_images(unsigned long long images)
+{
+#pragma omp atomic
+    deeplearn_stats_global.images += images;
+}
+
+/**
+ * @brief Records an allocation made while training or evaluating
+ * @param bytes Size of the allocation
+ */
+void deeplearn_stats_add_allocation(unsigned long long bytes)
+{
+#pragma omp atomic
+    deeplearn_stats_global.allocations++;
+#pragma omp atomic
+    deeplearn_stats_global.allocated_bytes += bytes;
+}
+
+/**
+ * @brief Returns a copy of the current counters
+ * @param stats Returned counters
+ */
+void deeplearn_stats_get(deeplearn_stats * stats)
+{
+#pragma omp flush
+    memcpy((void*)stats, (void*)&deeplearn_stats_global,
+           sizeof(deeplearn_stats));
+#ifdef DEEPLEARN_STATS
+    stats->enabled = 1;
+#else
+    stats->enabled = 0;
+#endif
+}
+
+/**
+ * @brief Clears all counters
+ */
+void deeplearn_stats_reset()
+{
+    memset((void*)&deeplearn_stats_global, '\0', sizeof(deeplearn_stats));
+#pragma omp flush
+}
+
+/**
+ * @brief Returns the total calls and time for a phase over all layers
+ * @param stats Counters
+ * @param phase Index of the phase
+ * @return Total for the phase
+ */
+deeplearn_stats_counter deeplearn_stats_total(deeplearn_stats * stats,
+                                              int phase)
+{
+    deeplearn_stats_counter total;
+    int l;
+
+    total.calls = 0;
+    total.seconds = 0;
+    if ((phase < 0) || (phase >= DEEPLEARN_STATS_PHASES)) return total;
+
+    for (l = 0; l < DEEPLEARN_STATS_MAX_LAYERS; l++) {
+        total.calls += stats->phase[phase][l].calls;
+        total.seconds += stats->phase[phase][l].seconds;
+    }
+    return total;
+}
+
+/**
+ * @brief Returns the number of samples trained per second, based upon
+ *        the time spent within deeplearn_update and deeplearn_update_batch
+ * @param stats Counters
+ * @return Samples per second, or zero if nothing has been recorded
+ */
+float deeplearn_stats_samples_per_sec(deeplearn_stats * stats)
+{
+    double seconds = stats->phase[DEEPLEARN_STATS_UPDATE][0].seconds;
+
+    if (seconds <= 0) return 0;
+    return (float)(stats->samples / seconds);
+}
+
+/**
+ * @brief Returns the number of images trained per second, based upon
+ *        the time spent within deepconvnet_update_img
+ * @param stats Counters
+ * @return Images per second, or zero if nothing has been recorded
+ */
+float deeplearn_stats_images_per_sec(deeplearn_stats * stats)
+{
+    double seconds = stats->phase[DEEPLEARN_STATS_UPDATE_IMAGE][0].seconds;
+
+    if (seconds <= 0) return 0;
+    return (float)(stats->images / seconds);
+}
+
+/**
+ * @brief Returns the name of a phase, as used within JSON output
+ * @param phase Index of the phase
+ * @return Name of the phase, or NULL if the index is out of range
+ */
+const char * deeplearn_stats_phase_name(int phase)
+{
+    if ((phase < 0) || (phase >= DEEPLEARN_STATS_PHASES)) return NULL;
+    return deeplearn_stats_phase_names[phase];
+}
+
+/**
+ * @brief Writes the counters as a single line of JSON, so that
+ *        successive snapshots can be appended to a log file
+ * @param fp File pointer
+ * @param stats Counters
+ * @return zero on success
+ */
+int deeplearn_stats_write_json(FILE * fp, deeplearn_stats * stats)
+{
+    int p, l, layers;
+    deeplearn_stats_counter total;
+
+    if (fp == NULL) return -1;
+
+    fprintf(fp, "{\"enabled\":%d,\"samples\":%llu,\"images\":%llu,",
+            stats->enabled, stats->samples, stats->images);
+    fprintf(fp, "\"samples_per_sec\":%.3f,\"images_per_sec\":%.3f,",
+            deeplearn_stats_samples_per_sec(stats),
+            deeplearn_stats_images_per_sec(stats));
+    fprintf(fp, "\"allocations\":%llu,\"allocated_bytes\":%llu,",
+            stats->allocations, stats->allocated_bytes);
+    fprintf(fp, "%s", "\"phases\":{");
+    for (p = 0; p < DEEPLEARN_STATS_PHASES; p++) {
+        total = deeplearn_stats_total(stats, p);
+        fprintf(fp, "%s\"%s\":{\"calls\":%llu,\"seconds\":%.9f",
+                (p > 0) ? "," : "", deeplearn_stats_phase_names[p],
+                total.calls, total.seconds);
+        if (deeplearn_stats_layered[p] != 0) {
+            /* omit unused deeper layers */
+            layers = 0;
+            for (l = 0; l < DEEPLEARN_STATS_MAX_LAYERS; l++) {
+                if (stats->phase[p][l].calls > 0) layers = l+1;
+            }
+            fprintf(fp, "%s", ",\"layers\":[");
+            for (l = 0; l < layers; l++) {
+                fprintf(fp, "%s{\"calls\":%llu,\"seconds\":%.9f}",
+                        (l > 0) ? "," : "",
+                        stats->phase[p][l].calls,
+                        stats->phase[p][l].seconds);
+            }
+            fprintf(fp, "%s", "]");
+        }
+        fprintf(fp, "%s", "}");
+    }
+    fprintf(fp, "%s", "}}\n");
+
+    if (ferror(fp)) return -2;
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_STATS_H
+#define DEEPLEARN_STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* maximum number of layers recorded separately for layered phases.
+   Deeper layers are accumulated into the last entry. */
+#define DEEPLEARN_STATS_MAX_LAYERS 16
+
+/* phases of training which are timed */
+enum {
+    DEEPLEARN_STATS_FEED_FORWARD = 0,
+    DEEPLEARN_STATS_BACKPROP,
+    DEEPLEARN_STATS_LEARN,
+    DEEPLEARN_STATS_PRETRAIN,
+    DEEPLEARN_STATS_CONVOLUTION,
+    DEEPLEARN_STATS_POOLING,
+    DEEPLEARN_STATS_UPDATE,
+    DEEPLEARN_STATS_UPDATE_IMAGE,
+    DEEPLEARN_STATS_PHASES
+};
+
+struct deeplearn_stats_counter {
+    unsigned long long calls;
+    double seconds;
+};
+typedef struct deeplearn_stats_counter deeplearn_stats_counter;
+
+/* Counters recorded when the library is compiled with DEEPLEARN_STATS.
+   Phases which are not layered are recorded within layer zero. */
+struct deeplearn_stats {
+    /* non-zero if the library was compiled with instrumentation */
+    int enabled;
+
+    deeplearn_stats_counter phase[DEEPLEARN_STATS_PHASES][DEEPLEARN_STATS_MAX_LAYERS];
+
+    /* samples presented to deeplearn_update or deeplearn_update_batch */
+    unsigned long long samples;
+
+    /* images presented to deepconvnet_update_img */
+    unsigned long long images;
+
+    /* allocations made while training or evaluating */
+    unsigned long long allocations;
+    unsigned long long allocated_bytes;
+};
+typedef struct deeplearn_stats deeplearn_stats;
+
+#ifdef DEEPLEARN_STATS
+#define DEEPLEARN_STATS_START(t) double t = deeplearn_stats_clock()
+#define DEEPLEARN_STATS_STOP(t, phase, layer) \
+    deeplearn_stats_record((phase), (layer), deeplearn_stats_clock() - (t))
+#define DEEPLEARN_STATS_SAMPLES(n) deeplearn_stats_add_samples(n)
+#define DEEPLEARN_STATS_IMAGES(n) deeplearn_stats_add_images(n)
+#define DEEPLEARN_STATS_ALLOC(bytes) deeplearn_stats_add_allocation(bytes)
+#else
+#define DEEPLEARN_STATS_START(t)
+#define DEEPLEARN_STATS_STOP(t, phase, layer)
+#define DEEPLEARN_STATS_SAMPLES(n)
+#define DEEPLEARN_STATS_IMAGES(n)
+#define DEEPLEARN_STATS_ALLOC(bytes)
+#endif
+
+double deeplearn_stats_clock();
+void deeplearn_stats_record(int phase, int layer, double seconds);
+void deeplearn_stats_add_samples(unsigned long long samples);
+void deeplearn_stats_add_images(unsigned long long images);
+void deeplearn_stats_add_allocation(unsigned long long bytes);
+void deeplearn_stats_get(deeplearn_stats * stats);
+void deeplearn_stats_reset();
+deeplearn_stats_counter deeplearn_stats_total(deeplearn_stats * stats,
+                                              int phase);
+float deeplearn_stats_samples_per_sec(deeplearn_stats * stats);
+float deeplearn_stats_images_per_sec(deeplearn_stats * stats);
+const char * deeplearn_stats_phase_name(int phase);
+int deeplearn_stats_write_json(FILE * fp, deeplearn_stats * stats);
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_stream.h"
+
+/**
+ * @brief Clears the state of a stream before its batch is allocated
+ * @param stream Stream object
+ * @param next_batch Function which reads the next batch from the source
+ * @param reset Function which returns to the start of the source, or
+ *        NULL if it can only be read once
+ * @param data Data passed to the source functions
+ * @param capacity The maximum number of samples within a batch
+ */
+static void deeplearn_stream_clear(deeplearn_stream * stream,
+                                   deeplearn_stream_next_batch next_batch,
+                                   deeplearn_stream_reset reset, void * data,
+                                   int capacity)
+{
+    memset((void*)stream, '\0', sizeof(deeplearn_stream));
+    stream->next_batch = next_batch;
+    stream->reset = reset;
+    stream->data = data;
+    stream->batch.capacity = capacity;
+    stream->current = -1;
+}
+
+/**
+ * @brief Initialises a stream of tabular samples
+ * @param stream Stream object
+ * @param next_batch Function which reads the next batch from the source
+ * @param reset Function which returns to the start of the source, or
+ *        NULL if it can only be read once
+ * @param data Data passed to the source functions
+ * @param no_of_input_fields The number of input fields of each sample
+ * @param no_of_outputs The number of outputs of each sample
+ * @param text Non-zero if the samples contain text fields
+ * @param capacity The maximum number of samples within a batch, or zero
+ *        for the default
+ * @returns zero on success
+ */
+int deeplearn_stream_init(deeplearn_stream * stream,
+                          deeplearn_stream_next_batch next_batch,
+                          deeplearn_stream_reset reset, void * data,
+                          int no_of_input_fields, int no_of_outputs,
+                          int text, int capacity)
+{
+    deeplearn_stream_batch * batch = &stream->batch;
+
+    if (capacity == 0) {
+        capacity = DEEPLEARN_STREAM_CAPACITY;
+    }
+    if ((next_batch == 0) || (capacity < 1) ||
+        (no_of_input_fields < 1) || (no_of_outputs < 1)) {
+        return -1;
+    }
+
+    deeplearn_stream_clear(stream, next_batch, reset, data, capacity);
+    batch->no_of_input_fields = no_of_input_fields;
+    batch->no_of_outputs = no_of_outputs;
+    batch->inputs =
+        (float*)malloc(capacity*no_of_input_fields*sizeof(float));
+    batch->outputs =
+        (float*)malloc(capacity*no_of_outputs*sizeof(float));
+    if (text != 0) {
+        batch->inputs_text =
+            (char**)calloc(capacity*no_of_input_fields, sizeof(char*));
+    }
+    if ((!batch->inputs) || (!batch->outputs) ||
+        ((text != 0) && (!batch->inputs_text))) {
+        deeplearn_stream_free(stream);
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Initialises a stream of images with class numbers
+ * @param stream Stream object
+ * @param next_batch Function which reads the next batch from the source
+ * @param reset Function which returns to the start of the source, or
+ *        NULL if it can only be read once
+ * @param data Data passed to the source functions
+ * @param image_size The number of bytes in each image
+ * @param capacity The maximum number of images within a batch, or zero
+ *        for the default
+ * @returns zero on success
+ */
+int deeplearn_stream_init_images(deeplearn_stream * stream,
+                                 deeplearn_stream_next_batch next_batch,
+                                 deeplearn_stream_reset reset, void * data,
+                                 int image_size, int capacity)
+{
+    deeplearn_stream_batch * batch = &stream->batch;
+
+    if (capacity == 0) {
+        capacity = DEEPLEARN_STREAM_CAPACITY;
+    }
+    if ((next_batch == 0) || (capacity < 1) || (image_size < 1)) {
+        return -1;
+    }
+
+    deeplearn_stream_clear(stream, next_batch, reset, data, capacity);
+    batch->image_size = image_size;
+    batch->images =
+        (unsigned char*)malloc(capacity*image_size*sizeof(unsigned char));
+    batch->classification_number = (int*)malloc(capacity*sizeof(int));
+    if ((!batch->images) || (!batch->classification_number)) {
+        deeplearn_stream_free(stream);
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief Deallocates a stream.  The source itself is not closed.
+ * @param stream Stream object
+ */
+void deeplearn_stream_free(deeplearn_stream * stream)
+{
+    deeplearn_stream_batch * batch = &stream->batch;
+
+    free(batch->inputs);
+    free(batch->inputs_text);
+    free(batch->outputs);
+    free(batch->images);
+    free(batch->classification_number);
+    batch->inputs = 0;
+    batch->inputs_text = 0;
+    batch->outputs = 0;
+    batch->images = 0;
+    batch->classification_number = 0;
+    batch->samples = 0;
+}
+
+/**
+ * @brief Reads the next batch from the source.  At the end of the
+ *        source it is reset, if possible, and read again.
+ * @param stream Stream object
+ * @returns zero on success, -1 at the end of the stream, -2 if the
+ *          source failed or -3 if it could not be reset
+ */
+static int deeplearn_stream_read(deeplearn_stream * stream)
+{
+    deeplearn_stream_batch * batch = &stream->batch;
+
+    batch->samples = 0;
+    if (stream->next_batch(batch, stream->data) != 0) {
+        return -2;
+    }
+    if (batch->samples > 0) {
+        return 0;
+    }
+
+    /* begin another epoch */
+    if (stream->reset == 0) {
+        return -1;
+    }
+    if (stream->reset(stream->data) != 0) {
+        return -3;
+    }
+    stream->epochs++;
+
+    batch->samples = 0;
+    if (stream->next_batch(batch, stream->data) != 0) {
+        return -2;
+    }
+    if (batch->samples < 1) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Moves on to the next sample, which is then indexed by
+ *        stream->current within the batch
+ * @param stream Stream object
+ * @returns 1 if a new batch was read, zero if the sample is within the
+ *          current batch or a negative value at the end of the stream
+ *          or on error
+ */
+int deeplearn_stream_next(deeplearn_stream * stream)
+{
+    int retval = 0;
+
+    if (stream->current + 1 >= stream->batch.samples) {
+        retval = deeplearn_stream_read(stream);
+        if (retval != 0) {
+            stream->current = -1;
+            return retval;
+        }
+        if (stream->batch.samples > stream->batch.capacity) {
+            stream->batch.samples = stream->batch.capacity;
+        }
+        stream->current = -1;
+        retval = 1;
+    }
+
+    stream->current++;
+    if (stream->samples < UINT_MAX) {
+        stream->samples++;
+    }
+    return retval;
+}
+
+/**
+ * @brief Returns the input fields of a sample within the batch
+ * @param stream Stream object
+ * @param index Index of the sample within the batch
+ * @returns Array of input field values
+ */
+float * deeplearn_stream_inputs(deeplearn_stream * stream, int index)
+{
+    return &stream->batch.inputs[index*stream->batch.no_of_input_fields];
+}
+
+/**
+ * @brief Returns the text fields of a sample within the batch
+ * @param stream Stream object
+ * @param index Index of the sample within the batch
+ * @returns Array of strings, or NULL if the samples have no text
+ */
+char ** deeplearn_stream_inputs_text(deeplearn_stream * stream, int index)
+{
+    if (stream->batch.inputs_text == 0) {
+        return 0;
+    }
+    return &stream->batch.inputs_text[index*stream->batch.no_of_input_fields];
+}
+
+/**
+ * @brief Returns the outputs of a sample within the batch
+ * @param stream Stream object
+ * @param index Index of the sample within the batch
+ * @returns Array of output values
+ */
+float * deeplearn_stream_outputs(deeplearn_stream * stream, int index)
+{
+    return &stream->batch.outputs[index*stream->batch.no_of_outputs];
+}
+
+/**
+ * @brief Returns an image within the batch
+ * @param stream Stream object
+ * @param index Index of the image within the batch
+ * @returns Image of batch.image_size bytes
+ */
+unsigned char * deeplearn_stream_image(deeplearn_stream * stream, int index)
+{
+    return &stream->batch.images[index*stream->batch.image_size];
+}
@@ -0,0 +1,108 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_STREAM_H
+#define DEEPLEARN_STREAM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* default number of samples requested from a source at a time */
+#define DEEPLEARN_STREAM_CAPACITY 256
+
+/* Samples returned by a stream source.  Tabular samples have one row
+   of input fields and one row of outputs each, with outputs set to
+   DEEPLEARN_UNKNOWN_VALUE for unlabeled samples.  If the samples
+   contain text then inputs_text has a row of strings for each sample,
+   which belong to the source and only need to remain valid until its
+   next call.  Images have image_size bytes each and a class number. */
+struct deeplearn_stream_batch {
+    int capacity;
+    int samples;
+
+    int no_of_input_fields;
+    int no_of_outputs;
+    float * inputs;
+    char ** inputs_text;
+    float * outputs;
+
+    int image_size;
+    unsigned char * images;
+    int * classification_number;
+};
+typedef struct deeplearn_stream_batch deeplearn_stream_batch;
+
+/* fills the batch with up to batch->capacity samples, setting
+   batch->samples and returning zero on success.  No samples indicates
+   the end of the stream. */
+typedef int (*deeplearn_stream_next_batch)(deeplearn_stream_batch * batch,
+                                           void * data);
+
+/* returns to the start of the stream, returning zero on success */
+typedef int (*deeplearn_stream_reset)(void * data);
+
+/* Training samples pulled a batch at a time from a source such as a
+   file which is larger than memory, or a message queue, rather than
+   held within the data set of a learner.  When the source runs out it
+   is reset if possible, so that training continues over another epoch */
+struct deeplearn_stream {
+    deeplearn_stream_next_batch next_batch;
+    deeplearn_stream_reset reset;
+    void * data;
+
+    deeplearn_stream_batch batch;
+
+    /* index of the current sample within the batch */
+    int current;
+
+    /* number of samples read and times the source has been reset */
+    unsigned int samples;
+    unsigned int epochs;
+};
+typedef struct deeplearn_stream deeplearn_stream;
+
+int deeplearn_stream_init(deeplearn_stream * stream,
+                          deeplearn_stream_next_batch next_batch,
+                          deeplearn_stream_reset reset, void * data,
+                          int no_of_input_fields, int no_of_outputs,
+                          int text, int capacity);
+int deeplearn_stream_init_images(deeplearn_stream * stream,
+                                 deeplearn_stream_next_batch next_batch,
+                                 deeplearn_stream_reset reset, void * data,
+                                 int image_size, int capacity);
+void deeplearn_stream_free(deeplearn_stream * stream);
+int deeplearn_stream_next(deeplearn_stream * stream);
+float * deeplearn_stream_inputs(deeplearn_stream * stream, int index);
+char ** deeplearn_stream_inputs_text(deeplearn_stream * stream, int index);
+float * deeplearn_stream_outputs(deeplearn_stream * stream, int index);
+unsigned char * deeplearn_stream_image(deeplearn_stream * stream, int index);
+
+#endif
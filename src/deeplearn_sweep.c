@@ -0,0 +1,452 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "deeplearn_sweep.h"
+
+/* work given to the threads during one round of a sweep */
+typedef struct {
+    deeplearn_sweep * sweep;
+    int * trial_index;
+    int samples;
+    int * failed;
+} deeplearn_sweep_work;
+
+/**
+ * @brief Encodes a set of samples of the source learner into rows of
+ *        input and target values
+ * @param source Learner holding the samples
+ * @param get Returns a sample of the set given its index
+ * @param samples The number of samples within the set
+ * @param inputs Returned input rows
+ * @param targets Returned target rows
+ * @returns zero on success
+ */
+static int deeplearn_sweep_encode(deeplearn * source,
+                                  deeplearndata * (*get)(deeplearn *, int),
+                                  int samples, float ** inputs,
+                                  float ** targets)
+{
+    int no_of_inputs = source->net->NoOfInputs;
+    int no_of_outputs = source->net->NoOfOutputs;
+
+    *inputs = (float*)malloc(samples*no_of_inputs*sizeof(float));
+    *targets = (float*)malloc(samples*no_of_outputs*sizeof(float));
+    if ((!*inputs) || (!*targets)) {
+        return -1;
+    }
+    for (int s = 0; s < samples; s++) {
+        deeplearndata * sample = (*get)(source, s);
+        if (sample == NULL) {
+            return -2;
+        }
+        deeplearn_encode_inputs(source, sample, &(*inputs)[s*no_of_inputs]);
+        deeplearn_encode_outputs(source, sample,
+                                 &(*targets)[s*no_of_outputs]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Creates the learner of a trial, with the same fields and ranges
+ *        as the source learner
+ * @param trial The trial
+ * @param source Learner holding the samples
+ * @returns zero on success
+ */
+static int deeplearn_sweep_trial_init(deeplearn_sweep_trial * trial,
+                                      deeplearn * source)
+{
+    deeplearn * learner = &trial->learner;
+
+    if (deeplearn_init_like(learner, source, trial->config.no_of_hiddens,
+                            trial->config.hidden_layers,
+                            &trial->random_seed) != 0) {
+        return -1;
+    }
+
+    if (trial->config.learning_rate > 0) {
+        deeplearn_set_learning_rate(learner, trial->config.learning_rate);
+    }
+    deeplearn_set_dropouts(learner, trial->config.dropout_percent);
+    trial->active = 1;
+    return 0;
+}
+
+/**
+ * @brief Creates a sweep over a number of configurations.  The labeled
+ *        training samples and the test samples of the source learner
+ *        are encoded once and shared by every trial, so the source
+ *        should have its training and test sets created beforehand.
+ *        If there is no test set then trials are evaluated on the
+ *        training set.
+ * @param sweep Sweep object
+ * @param source Learner holding the data set
+ * @param configs Array of configurations
+ * @param no_of_configs The number of configurations
+ * @param batch_size The number of samples within each training batch
+ * @param random_seed Random number seed
+ * @returns zero on success
+ */
+int deeplearn_sweep_init(deeplearn_sweep * sweep, deeplearn * source,
+                         deeplearn_sweep_config * configs,
+                         int no_of_configs, int batch_size,
+                         unsigned int * random_seed)
+{
+    memset((void*)sweep, '\0', sizeof(deeplearn_sweep));
+    if ((no_of_configs < 1) || (batch_size < 1)) {
+        return -1;
+    }
+    if (source->training_data_labeled_samples < 1) {
+        return -2;
+    }
+
+    sweep->no_of_inputs = source->net->NoOfInputs;
+    sweep->no_of_outputs = source->net->NoOfOutputs;
+    sweep->batch_size = batch_size;
+    sweep->training_samples = source->training_data_labeled_samples;
+    sweep->test_samples = source->test_data_samples;
+
+    if ((deeplearn_sweep_encode(source, deeplearndata_get_training_labeled,
+                                sweep->training_samples,
+                                &sweep->training_inputs,
+                                &sweep->training_targets) != 0) ||
+        ((sweep->test_samples > 0) &&
+         (deeplearn_sweep_encode(source, deeplearndata_get_test,
+                                 sweep->test_samples,
+                                 &sweep->test_inputs,
+                                 &sweep->test_targets) != 0))) {
+        deeplearn_sweep_free(sweep);
+        return -3;
+    }
+
+    sweep->trial = (deeplearn_sweep_trial*)
+        calloc(no_of_configs, sizeof(deeplearn_sweep_trial));
+    if (!sweep->trial) {
+        deeplearn_sweep_free(sweep);
+        return -4;
+    }
+    for (int t = 0; t < no_of_configs; t++) {
+        deeplearn_sweep_trial * trial = &sweep->trial[t];
+
+        trial->config = configs[t];
+        trial->random_seed = rand_num(random_seed);
+        trial->error = DEEPLEARN_UNKNOWN_ERROR;
+        if (deeplearn_sweep_trial_init(trial, source) != 0) {
+            deeplearn_sweep_free(sweep);
+            return -5;
+        }
+        sweep->no_of_trials++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the error of a trial on the test set, or on the
+ *        training set if there is no test set, as the root mean square
+ *        difference from the targets as a percentage of the output range
+ * @param sweep Sweep object
+ * @param trial The trial
+ * @returns The error, or a negative value on failure
+ */
+static float deeplearn_sweep_evaluate(deeplearn_sweep * sweep,
+                                      deeplearn_sweep_trial * trial)
+{
+    bp * net = trial->learner.net;
+    float * inputs = sweep->test_inputs, * targets = sweep->test_targets;
+    int samples = sweep->test_samples;
+    int no_of_outputs = sweep->no_of_outputs;
+    float * outputs;
+    double total = 0;
+    bp_inference ctx;
+
+    if (samples == 0) {
+        inputs = sweep->training_inputs;
+        targets = sweep->training_targets;
+        samples = sweep->training_samples;
+    }
+    outputs = (float*)malloc(DEEPLEARN_SWEEP_BATCH*no_of_outputs*
+                             sizeof(float));
+    if (!outputs) {
+        return -1;
+    }
+    if (bp_inference_init(&ctx, net, DEEPLEARN_SWEEP_BATCH) != 0) {
+        free(outputs);
+        return -1;
+    }
+
+    for (int start = 0; start < samples; start += DEEPLEARN_SWEEP_BATCH) {
+        int batch_size = samples - start;
+        if (batch_size > DEEPLEARN_SWEEP_BATCH) {
+            batch_size = DEEPLEARN_SWEEP_BATCH;
+        }
+        if (bp_infer(net, &ctx, &inputs[start*sweep->no_of_inputs],
+                     outputs, batch_size) != 0) {
+            bp_inference_free(&ctx);
+            free(outputs);
+            return -1;
+        }
+        for (int i = 0; i < batch_size*no_of_outputs; i++) {
+            double diff = outputs[i] - targets[start*no_of_outputs + i];
+            total += diff*diff;
+        }
+    }
+    bp_inference_free(&ctx);
+    free(outputs);
+
+    /* encoded values span the range 0.25-0.75 */
+    return (float)(sqrt(total / ((double)samples*no_of_outputs)) *
+                   100.0 / 0.5);
+}
+
+/**
+ * @brief Trains one trial on randomly chosen training samples and then
+ *        evaluates it
+ * @param data Work of type deeplearn_sweep_work
+ * @param index Index within the list of active trials
+ * @param worker Index of the worker running the task
+ */
+static void deeplearn_sweep_task(void * data, int index, int worker)
+{
+    deeplearn_sweep_work * work = (deeplearn_sweep_work*)data;
+    deeplearn_sweep * sweep = work->sweep;
+    deeplearn_sweep_trial * trial =
+        &sweep->trial[work->trial_index[index]];
+    int no_of_inputs = sweep->no_of_inputs;
+    int no_of_outputs = sweep->no_of_outputs;
+    float * inputs, * targets;
+
+    (void)worker;
+
+    inputs = (float*)malloc(sweep->batch_size*no_of_inputs*sizeof(float));
+    targets = (float*)malloc(sweep->batch_size*no_of_outputs*sizeof(float));
+    if ((!inputs) || (!targets)) {
+        free(inputs);
+        free(targets);
+        work->failed[index] = 1;
+        return;
+    }
+
+    for (int trained = 0; trained < work->samples;
+         trained += sweep->batch_size) {
+        int batch_size = work->samples - trained;
+        if (batch_size > sweep->batch_size) {
+            batch_size = sweep->batch_size;
+        }
+
+        /* gather a batch of samples from the shared set */
+        for (int b = 0; b < batch_size; b++) {
+            int s = (int)(rand_num(&trial->random_seed) %
+                          sweep->training_samples);
+            memcpy((void*)&inputs[b*no_of_inputs],
+                   (void*)&sweep->training_inputs[s*no_of_inputs],
+                   no_of_inputs*sizeof(float));
+            memcpy((void*)&targets[b*no_of_outputs],
+                   (void*)&sweep->training_targets[s*no_of_outputs],
+                   no_of_outputs*sizeof(float));
+        }
+        if (deeplearn_update_batch_values(&trial->learner, inputs, targets,
+                                          batch_size) != 0) {
+            work->failed[index] = 1;
+            break;
+        }
+    }
+    free(inputs);
+    free(targets);
+
+    trial->error = deeplearn_sweep_evaluate(sweep, trial);
+    if (trial->error < 0) {
+        work->failed[index] = 1;
+    }
+    trial->rounds++;
+}
+
+/**
+ * @brief Returns the number of trials which are still being trained
+ * @param sweep Sweep object
+ * @returns The number of active trials
+ */
+int deeplearn_sweep_active(deeplearn_sweep * sweep)
+{
+    int active = 0;
+
+    for (int t = 0; t < sweep->no_of_trials; t++) {
+        if (sweep->trial[t].active != 0) active++;
+    }
+    return active;
+}
+
+/**
+ * @brief Trains every active trial concurrently on the given number of
+ *        samples, then evaluates each of them
+ * @param sweep Sweep object
+ * @param samples The number of training samples for each trial
+ * @returns zero on success
+ */
+int deeplearn_sweep_round(deeplearn_sweep * sweep, int samples)
+{
+    deeplearn_sweep_work work;
+    int t, active = 0, failed = 0;
+
+    if (samples < 1) {
+        return -1;
+    }
+
+    work.sweep = sweep;
+    work.samples = samples;
+    work.trial_index = (int*)malloc(sweep->no_of_trials*sizeof(int));
+    work.failed = (int*)calloc(sweep->no_of_trials, sizeof(int));
+    if ((!work.trial_index) || (!work.failed)) {
+        free(work.trial_index);
+        free(work.failed);
+        return -2;
+    }
+    for (t = 0; t < sweep->no_of_trials; t++) {
+        if (sweep->trial[t].active != 0) {
+            work.trial_index[active++] = t;
+        }
+    }
+
+    if (threads_run(active, deeplearn_sweep_task, &work) != 0) {
+        failed = 1;
+    }
+    for (t = 0; t < active; t++) {
+        failed += work.failed[t];
+    }
+    free(work.trial_index);
+    free(work.failed);
+
+    sweep->rounds++;
+    return (failed > 0) ? -3 : 0;
+}
+
+/**
+ * @brief Stops training the worst trials, keeping the best of every
+ *        reduction trials and freeing the learners of the others
+ * @param sweep Sweep object
+ * @param reduction The factor by which the number of trials is reduced
+ * @returns The number of trials which remain active
+ */
+int deeplearn_sweep_eliminate(deeplearn_sweep * sweep, int reduction)
+{
+    int t, active = deeplearn_sweep_active(sweep), keep;
+
+    if (reduction < 2) {
+        return -1;
+    }
+
+    keep = (active + reduction - 1) / reduction;
+    while (active > keep) {
+        /* the active trial with the largest error */
+        int worst = -1;
+        for (t = 0; t < sweep->no_of_trials; t++) {
+            if (sweep->trial[t].active == 0) continue;
+            if ((worst == -1) ||
+                (sweep->trial[t].error > sweep->trial[worst].error)) {
+                worst = t;
+            }
+        }
+        deeplearn_free(&sweep->trial[worst].learner);
+        sweep->trial[worst].active = 0;
+        active--;
+    }
+    return active;
+}
+
+/**
+ * @brief Runs successive halving until a single trial remains.  In each
+ *        round the remaining trials are trained and evaluated, then only
+ *        the best of every reduction trials continue, and the number of
+ *        samples per round grows by the same factor so that later rounds
+ *        give the surviving trials a larger budget.
+ * @param sweep Sweep object
+ * @param samples_per_round The number of training samples for each
+ *        trial in the first round
+ * @param reduction The factor by which the number of trials is reduced
+ *        after each round, typically 2 or 3
+ * @returns Index of the best trial, or negative on error
+ */
+int deeplearn_sweep_run(deeplearn_sweep * sweep, int samples_per_round,
+                        int reduction)
+{
+    int samples = samples_per_round;
+
+    if ((samples_per_round < 1) || (reduction < 2)) {
+        return -1;
+    }
+
+    while (deeplearn_sweep_active(sweep) > 0) {
+        if (deeplearn_sweep_round(sweep, samples) != 0) {
+            return -2;
+        }
+        if (deeplearn_sweep_active(sweep) == 1) break;
+        deeplearn_sweep_eliminate(sweep, reduction);
+        if (samples <= INT_MAX / reduction) {
+            samples *= reduction;
+        }
+    }
+    return deeplearn_sweep_best(sweep);
+}
+
+/**
+ * @brief Returns the active trial with the smallest error
+ * @param sweep Sweep object
+ * @returns Index of the trial, or -1 if there are no active trials
+ */
+int deeplearn_sweep_best(deeplearn_sweep * sweep)
+{
+    int best = -1;
+
+    for (int t = 0; t < sweep->no_of_trials; t++) {
+        if (sweep->trial[t].active == 0) continue;
+        if ((best == -1) ||
+            (sweep->trial[t].error < sweep->trial[best].error)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Frees the shared samples and the learners of any active trials
+ * @param sweep Sweep object
+ */
+void deeplearn_sweep_free(deeplearn_sweep * sweep)
+{
+    for (int t = 0; t < sweep->no_of_trials; t++) {
+        if (sweep->trial[t].active != 0) {
+            deeplearn_free(&sweep->trial[t].learner);
+        }
+    }
+    free(sweep->trial);
+    free(sweep->training_inputs);
+    free(sweep->training_targets);
+    free(sweep->test_inputs);
+    free(sweep->test_targets);
+    memset((void*)sweep, '\0', sizeof(deeplearn_sweep));
+}
@@ -0,0 +1,105 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_SWEEP_H
+#define DEEPLEARN_SWEEP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+#include "deeplearn_random.h"
+#include "deeplearn_threads.h"
+#include "deeplearn.h"
+#include "deeplearndata.h"
+
+/* number of samples fed forward together when evaluating a trial */
+#define DEEPLEARN_SWEEP_BATCH 64
+
+/* hyperparameters of one configuration within a sweep */
+typedef struct {
+    int no_of_hiddens;
+    int hidden_layers;
+    float learning_rate;
+    float dropout_percent;
+} deeplearn_sweep_config;
+
+/* a learner trained with one configuration */
+typedef struct {
+    deeplearn_sweep_config config;
+    deeplearn learner;
+    unsigned int random_seed;
+
+    /* non-zero while the trial is still being trained */
+    unsigned char active;
+
+    /* the number of rounds for which the trial was trained */
+    int rounds;
+
+    /* evaluation error at the end of the last round, as a percentage
+       of the output range */
+    float error;
+} deeplearn_sweep_trial;
+
+/* Trains many configurations of a deep learner concurrently using
+   successive halving.  The training and test sets of a source learner
+   are encoded once and shared read only by every trial.  In each round
+   the remaining trials are trained on the same number of samples, on
+   the threads given by threads_run, and then evaluated, after which
+   only the best fraction of them continue to the next round */
+typedef struct {
+    int no_of_inputs, no_of_outputs;
+    int batch_size;
+
+    /* encoded samples shared by every trial */
+    float * training_inputs;
+    float * training_targets;
+    int training_samples;
+    float * test_inputs;
+    float * test_targets;
+    int test_samples;
+
+    int no_of_trials;
+    deeplearn_sweep_trial * trial;
+    int rounds;
+} deeplearn_sweep;
+
+int deeplearn_sweep_init(deeplearn_sweep * sweep, deeplearn * source,
+                         deeplearn_sweep_config * configs,
+                         int no_of_configs, int batch_size,
+                         unsigned int * random_seed);
+int deeplearn_sweep_round(deeplearn_sweep * sweep, int samples);
+int deeplearn_sweep_eliminate(deeplearn_sweep * sweep, int reduction);
+int deeplearn_sweep_run(deeplearn_sweep * sweep, int samples_per_round,
+                        int reduction);
+int deeplearn_sweep_best(deeplearn_sweep * sweep);
+int deeplearn_sweep_active(deeplearn_sweep * sweep);
+void deeplearn_sweep_free(deeplearn_sweep * sweep);
+
+#endif
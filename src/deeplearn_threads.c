@@ -0,0 +1,440 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+
+#include "deeplearn_threads.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* number of threads requested, or zero for the OpenMP default */
+static int threads_requested = 0;
+static int threads_affinity = THREADS_AFFINITY_NONE;
+
+/* thread pool belonging to the caller, used instead of OpenMP */
+static threads_pool_run threads_pool = NULL;
+static void * threads_pool_data = NULL;
+static int threads_pool_workers = 0;
+
+/* CPUs which the process may run on, grouped by NUMA node, and the
+   node of each CPU number, or -1 if the process may not use it */
+static int threads_topology_read = 0;
+static int threads_no_of_cpus = 0;
+static int threads_cpu[THREADS_MAX_CPUS];
+static int threads_no_of_nodes = 1;
+static int threads_node_start[THREADS_MAX_NODES+1];
+static int threads_node_of[THREADS_MAX_CPUS];
+
+#ifdef __linux__
+static cpu_set_t threads_process_mask;
+#endif
+
+/**
+ * @brief Returns the index of the calling thread within an OpenMP team
+ * @returns thread number
+ */
+static int threads_thread_num(void)
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+/**
+ * @brief Reads the CPUs of a NUMA node from sysfs
+ * @param node The node number
+ * @param cpus Returned non-zero for each CPU number within the node
+ * @returns zero if the node exists
+ */
+static int threads_read_node(int node, unsigned char * cpus)
+{
+    char filename[256];
+    FILE * fp;
+    int first, last, c;
+
+    sprintf(filename, "/sys/devices/system/node/node%d/cpulist", node);
+    fp = fopen(filename, "r");
+    if (!fp) return -1;
+
+    memset((void*)cpus, '\0', THREADS_MAX_CPUS);
+
+    /* ranges such as 0-3,8-11 */
+    while (fscanf(fp, "%d", &first) == 1) {
+        last = first;
+        c = fgetc(fp);
+        if (c == '-') {
+            if (fscanf(fp, "%d", &last) != 1) break;
+            c = fgetc(fp);
+        }
+        for (int cpu = first; (cpu <= last) && (cpu < THREADS_MAX_CPUS); cpu++) {
+            if (cpu >= 0) cpus[cpu] = 1;
+        }
+        if (c != ',') break;
+    }
+    fclose(fp);
+    return 0;
+}
+#endif
+
+/**
+ * @brief Finds the CPUs which the process may use and the NUMA node
+ *        of each of them.  If the topology is not known then all
+ *        CPUs are treated as being on one node.
+ */
+static void threads_read_topology(void)
+{
+    if (threads_topology_read != 0) return;
+
+#pragma omp critical (deeplearn_threads)
+    {
+        if (threads_topology_read == 0) {
+#ifdef __linux__
+            unsigned char cpus[THREADS_MAX_CPUS];
+            int node, nodes = 0;
+
+            for (int cpu = 0; cpu < THREADS_MAX_CPUS; cpu++) {
+                threads_node_of[cpu] = -1;
+            }
+            CPU_ZERO(&threads_process_mask);
+            if (sched_getaffinity(0, sizeof(cpu_set_t),
+                                  &threads_process_mask) != 0) {
+                CPU_ZERO(&threads_process_mask);
+            }
+
+            /* allowed CPUs in order of node */
+            threads_no_of_cpus = 0;
+            for (node = 0; node < THREADS_MAX_NODES; node++) {
+                int start = threads_no_of_cpus;
+
+                if (threads_read_node(node, cpus) != 0) continue;
+                for (int cpu = 0; cpu < THREADS_MAX_CPUS; cpu++) {
+                    if ((cpus[cpu] == 0) ||
+                        (!CPU_ISSET(cpu, &threads_process_mask)) ||
+                        (threads_node_of[cpu] != -1)) {
+                        continue;
+                    }
+                    threads_cpu[threads_no_of_cpus++] = cpu;
+                    threads_node_of[cpu] = nodes;
+                }
+                if (threads_no_of_cpus > start) {
+                    threads_node_start[nodes++] = start;
+                }
+            }
+
+            /* allowed CPUs which are not listed within any node */
+            if (nodes == 0) {
+                threads_node_start[nodes++] = 0;
+            }
+            for (int cpu = 0; cpu < THREADS_MAX_CPUS; cpu++) {
+                if ((CPU_ISSET(cpu, &threads_process_mask)) &&
+                    (threads_node_of[cpu] == -1)) {
+                    threads_cpu[threads_no_of_cpus++] = cpu;
+                    threads_node_of[cpu] = nodes-1;
+                }
+            }
+            threads_no_of_nodes = nodes;
+            threads_node_start[nodes] = threads_no_of_cpus;
+#else
+            threads_no_of_cpus = 0;
+            threads_no_of_nodes = 1;
+            threads_node_start[0] = 0;
+            threads_node_start[1] = 0;
+#endif
+            threads_topology_read = 1;
+        }
+    }
+}
+
+#ifdef __linux__
+/**
+ * @brief Returns the CPU on which a worker runs for the current affinity
+ * @param worker Index of the worker thread
+ * @returns CPU number
+ */
+static int threads_worker_cpu(int worker)
+{
+    int node, cpus;
+
+    if (threads_affinity == THREADS_AFFINITY_SCATTER) {
+        /* consecutive workers on different nodes */
+        node = worker % threads_no_of_nodes;
+        cpus = threads_node_start[node+1] - threads_node_start[node];
+        return threads_cpu[threads_node_start[node] +
+                           (worker / threads_no_of_nodes) % cpus];
+    }
+
+    /* consecutive workers on neighbouring CPUs, filling a node first */
+    return threads_cpu[worker % threads_no_of_cpus];
+}
+#endif
+
+/**
+ * @brief Pins each OpenMP thread, including the calling thread, to a
+ *        CPU for the current affinity, or allows them to run on any of
+ *        the CPUs of the process if there is no affinity
+ * @returns zero on success
+ */
+static int threads_apply_affinity(void)
+{
+#ifdef __linux__
+    int failed = 0;
+
+    threads_read_topology();
+    if (threads_no_of_cpus == 0) {
+        return (threads_affinity == THREADS_AFFINITY_NONE) ? 0 : -1;
+    }
+
+#pragma omp parallel num_threads(threads_count()) reduction(+:failed)
+    {
+        cpu_set_t mask;
+
+        if (threads_affinity == THREADS_AFFINITY_NONE) {
+            mask = threads_process_mask;
+        }
+        else {
+            CPU_ZERO(&mask);
+            CPU_SET(threads_worker_cpu(threads_thread_num()), &mask);
+        }
+        if (sched_setaffinity(0, sizeof(cpu_set_t), &mask) != 0) {
+            failed++;
+        }
+    }
+    return (failed > 0) ? -2 : 0;
+#else
+    return (threads_affinity == THREADS_AFFINITY_NONE) ? 0 : -1;
+#endif
+}
+
+/**
+ * @brief Sets the number of threads used by the parallel parts of the
+ *        library.  This should be called before training or inference
+ *        begins, rather than while they are running.
+ * @param no_of_threads The number of threads, or zero to use the
+ *        OpenMP default
+ * @returns zero on success
+ */
+int threads_set_count(int no_of_threads)
+{
+    if (no_of_threads < 0) return -1;
+
+    threads_requested = no_of_threads;
+    if (threads_affinity != THREADS_AFFINITY_NONE) {
+        return threads_apply_affinity();
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the number of threads with which the library's OpenMP
+ *        loops run.  If a thread pool has been given then this is one,
+ *        so that work within tasks on the pool does not start further
+ *        threads.
+ * @returns The number of threads
+ */
+int threads_count(void)
+{
+    if (threads_pool != NULL) return 1;
+    if (threads_requested > 0) return threads_requested;
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+/**
+ * @brief Returns the number of distinct worker indexes which may be
+ *        passed to tasks run by threads_run
+ * @returns The number of workers
+ */
+int threads_workers(void)
+{
+    if (threads_pool != NULL) return threads_pool_workers;
+    return threads_count();
+}
+
+/**
+ * @brief Pins the library's threads to CPUs.  Compact affinity places
+ *        consecutive threads on neighbouring CPUs, filling one NUMA node
+ *        before the next, while scatter affinity places consecutive
+ *        threads on different nodes.  The calling thread is pinned as
+ *        the first thread.
+ * @param mode THREADS_AFFINITY_NONE, THREADS_AFFINITY_COMPACT or
+ *        THREADS_AFFINITY_SCATTER
+ * @returns zero on success
+ */
+int threads_set_affinity(int mode)
+{
+    if ((mode != THREADS_AFFINITY_NONE) &&
+        (mode != THREADS_AFFINITY_COMPACT) &&
+        (mode != THREADS_AFFINITY_SCATTER)) {
+        return -1;
+    }
+    if ((mode == THREADS_AFFINITY_NONE) &&
+        (threads_affinity == THREADS_AFFINITY_NONE)) {
+        return 0;
+    }
+    threads_affinity = mode;
+    return threads_apply_affinity();
+}
+
+/**
+ * @brief Returns the current thread affinity
+ * @returns THREADS_AFFINITY_NONE, THREADS_AFFINITY_COMPACT or
+ *          THREADS_AFFINITY_SCATTER
+ */
+int threads_get_affinity(void)
+{
+    return threads_affinity;
+}
+
+/**
+ * @brief Runs the library's parallel tasks on a thread pool belonging
+ *        to the caller rather than on OpenMP threads, so that the
+ *        library does not add threads to those of the application
+ * @param run Function which runs tasks on the pool, or NULL to return
+ *        to using OpenMP
+ * @param pool Passed to the run function
+ * @param no_of_workers The number of worker indexes used by the pool
+ * @returns zero on success
+ */
+int threads_set_pool(threads_pool_run run, void * pool, int no_of_workers)
+{
+    if ((run != NULL) && (no_of_workers < 1)) return -1;
+
+    threads_pool = run;
+    threads_pool_data = pool;
+    threads_pool_workers = (run != NULL) ? no_of_workers : 0;
+    return 0;
+}
+
+/**
+ * @brief Runs a number of independent tasks in parallel, either on the
+ *        thread pool given by threads_set_pool or on OpenMP threads
+ * @param tasks The number of tasks
+ * @param task Function which runs one task
+ * @param data Passed to the task function
+ * @returns zero on success
+ */
+int threads_run(int tasks, threads_task task, void * data)
+{
+    if (tasks < 1) return 0;
+
+    if (threads_pool != NULL) {
+        return threads_pool(threads_pool_data, tasks, task, data);
+    }
+
+#pragma omp parallel for schedule(dynamic) num_threads(threads_count()) if (tasks > 1)
+    for (int i = 0; i < tasks; i++) {
+        task(data, i, threads_thread_num());
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the number of NUMA nodes on which the process may run
+ * @returns The number of nodes, which is one if the topology is unknown
+ */
+int threads_numa_nodes(void)
+{
+    threads_read_topology();
+    return threads_no_of_nodes;
+}
+
+/**
+ * @brief Returns the NUMA node on which the calling thread is running
+ * @returns Node index in the range 0 to threads_numa_nodes()-1
+ */
+int threads_numa_node(void)
+{
+#ifdef __linux__
+    int cpu;
+
+    threads_read_topology();
+    if (threads_no_of_nodes < 2) return 0;
+
+    cpu = sched_getcpu();
+    if ((cpu < 0) || (cpu >= THREADS_MAX_CPUS) ||
+        (threads_node_of[cpu] < 0)) {
+        return 0;
+    }
+    return threads_node_of[cpu];
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Runs a task on the calling thread while it is restricted to the
+ *        CPUs of a NUMA node, so that memory which the task writes first
+ *        is placed on that node.  The affinity of the thread is restored
+ *        afterwards.
+ * @param node Node index in the range 0 to threads_numa_nodes()-1
+ * @param task Function to run, which is given the node as its index
+ * @param data Passed to the task function
+ * @returns zero on success
+ */
+int threads_on_node(int node, threads_task task, void * data)
+{
+#ifdef __linux__
+    cpu_set_t previous, mask;
+    int restore;
+
+    if ((node < 0) || (node >= threads_numa_nodes())) return -1;
+
+    restore = (sched_getaffinity(0, sizeof(cpu_set_t), &previous) == 0);
+    CPU_ZERO(&mask);
+    for (int i = threads_node_start[node]; i < threads_node_start[node+1]; i++) {
+        CPU_SET(threads_cpu[i], &mask);
+    }
+    if ((threads_node_start[node+1] > threads_node_start[node]) &&
+        (restore != 0)) {
+        sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+    }
+
+    task(data, node, 0);
+
+    if (restore != 0) {
+        sched_setaffinity(0, sizeof(cpu_set_t), &previous);
+    }
+    return 0;
+#else
+    if ((node < 0) || (node >= threads_numa_nodes())) return -1;
+    task(data, node, 0);
+    return 0;
+#endif
+}
@@ -0,0 +1,67 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DEEPLEARN_THREADS_H
+#define DEEPLEARN_THREADS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ways of pinning the library's threads to CPUs */
+#define THREADS_AFFINITY_NONE     0
+#define THREADS_AFFINITY_COMPACT  1
+#define THREADS_AFFINITY_SCATTER  2
+
+/* limits of the CPU topology which is read */
+#define THREADS_MAX_CPUS   1024
+#define THREADS_MAX_NODES  64
+
+/* One item of work run by threads_run.  The worker index lies in the
+   range 0 to threads_workers()-1, and no two tasks run concurrently with
+   the same worker index, so it may select scratch space */
+typedef void (*threads_task)(void * data, int index, int worker);
+
+/* Runs tasks 0 to tasks-1 on a thread pool belonging to the caller,
+   returning once they have all completed.  Returns zero on success */
+typedef int (*threads_pool_run)(void * pool, int tasks,
+                                threads_task task, void * data);
+
+int threads_set_count(int no_of_threads);
+int threads_count(void);
+int threads_workers(void);
+int threads_set_affinity(int mode);
+int threads_get_affinity(void);
+int threads_set_pool(threads_pool_run run, void * pool, int no_of_workers);
+int threads_run(int tasks, threads_task task, void * data);
+int threads_numa_nodes(void);
+int threads_numa_node(void);
+int threads_on_node(int node, threads_task task, void * data);
+
+#endif
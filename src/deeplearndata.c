@@ -29,6 +29,66 @@
 
 #include "deeplearndata.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#define DEEPLEARNDATA_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define DEEPLEARNDATA_FILE_ALIGN(offset) \
+    (((offset) + DEEPLEARNDATA_ARENA_ALIGNMENT - 1) & \
+     ~((uint64_t)DEEPLEARNDATA_ARENA_ALIGNMENT - 1))
+
+/**
+* @brief Updates the data ranges with the given sample
+* @param inputs Input data
+* @param outputs Output data
+* @param no_of_input_fields The number of input fields
+* @param no_of_outputs The number of output fields
+* @param input_range_min Minimum value for each input field
+* @param input_range_max Maximum value for each input field
+* @param output_range_min Minimum value for each output field
+* @param output_range_max Maximum value for each output field
+* @returns 1 if the sample is labeled, otherwise 0
+*/
+static unsigned int deeplearndata_update_ranges(float inputs[],
+                                                float outputs[],
+                                                int no_of_input_fields,
+                                                int no_of_outputs,
+                                                float input_range_min[],
+                                                float input_range_max[],
+                                                float output_range_min[],
+                                                float output_range_max[])
+{
+    int i;
+    unsigned int labeled = 1;
+
+    for (i = 0; i < no_of_input_fields; i++) {
+        if (inputs[i] < input_range_min[i]) {
+            input_range_min[i] = inputs[i];
+        }
+        if (inputs[i] > input_range_max[i]) {
+            input_range_max[i] = inputs[i];
+        }
+    }
+    for (i = 0; i < no_of_outputs; i++) {
+        if ((int)outputs[i] != DEEPLEARN_UNKNOWN_VALUE) {
+            if (outputs[i] < output_range_min[i]) {
+                output_range_min[i] = outputs[i];
+            }
+            if (outputs[i] > output_range_max[i]) {
+                output_range_max[i] = outputs[i];
+            }
+        }
+        else {
+            labeled = 0;
+        }
+    }
+    return labeled;
+}
+
 /**
 * @brief Adds a training or test sample to the data set
 * @param datalist The list to be added to
@@ -93,30 +153,16 @@ int deeplearndata_add(deeplearndata ** datalist,
     memcpy((void*)data->outputs, outputs, no_of_outputs*sizeof(float));
 
     /* update the data range */
-    for (i = 0; i < no_of_input_fields; i++) {
-        if (inputs[i] < input_range_min[i]) {
-            input_range_min[i] = inputs[i];
-        }
-        if (inputs[i] > input_range_max[i]) {
-            input_range_max[i] = inputs[i];
-        }
-    }
-    data->labeled = 1;
-    for (i = 0; i < no_of_outputs; i++) {
-        if ((int)outputs[i] != DEEPLEARN_UNKNOWN_VALUE) {
-            if (outputs[i] < output_range_min[i]) {
-                output_range_min[i] = outputs[i];
-            }
-            if (outputs[i] > output_range_max[i]) {
-                output_range_max[i] = outputs[i];
-            }
-        }
-        else {
-            data->labeled = 0;
-        }
-    }
+    data->labeled =
+        deeplearndata_update_ranges(inputs, outputs,
+                                    no_of_input_fields, no_of_outputs,
+                                    input_range_min, input_range_max,
+                                    output_range_min, output_range_max);
 
     data->flags = 0;
+    data->encoded_inputs = 0;
+    data->encoded_outputs = 0;
+    data->activations = 0;
 
     /* change the current head of the list */
     data->prev = 0;
@@ -131,6 +177,383 @@ int deeplearndata_add(deeplearndata ** datalist,
     return 0;
 }
 
+/**
+* @brief Allocates an aligned array of floats
+* @param length The number of floats
+* @param allocation Returned pointer to be used when freeing the array
+* @returns The aligned array, or NULL on failure
+*/
+static float * deeplearndata_arena_alloc(int length, void ** allocation)
+{
+    *allocation = malloc(length*sizeof(float) + DEEPLEARNDATA_ARENA_ALIGNMENT);
+    if (!*allocation) {
+        return NULL;
+    }
+    return (float*)(((uintptr_t)*allocation + DEEPLEARNDATA_ARENA_ALIGNMENT - 1) &
+                    ~((uintptr_t)DEEPLEARNDATA_ARENA_ALIGNMENT - 1));
+}
+
+/**
+* @brief Points the sample headers at their rows within the arena
+*        and links them in order
+* @param arena Data arena
+*/
+static void deeplearndata_arena_link(deeplearndata_arena * arena)
+{
+    int i;
+
+    for (i = 0; i < arena->samples; i++) {
+        deeplearndata * sample = &arena->sample[i];
+        sample->inputs = &arena->inputs[i*arena->no_of_input_fields];
+        sample->outputs = &arena->outputs[i*arena->no_of_outputs];
+        sample->prev = (i > 0) ? &arena->sample[i-1] : 0;
+        sample->next = (i < arena->samples-1) ? &arena->sample[i+1] : 0;
+    }
+}
+
+/**
+* @brief Ensures that the arena has space for the given number of samples
+* @param arena Data arena
+* @param capacity The number of samples needed
+* @returns zero on success
+*/
+static int deeplearndata_arena_reserve(deeplearndata_arena * arena,
+                                       int capacity)
+{
+    float * inputs, * outputs;
+    void * inputs_allocation, * outputs_allocation;
+    deeplearndata * sample;
+    int grown;
+
+    if (capacity <= arena->capacity) {
+        return 0;
+    }
+    if (arena->capacity > 0) {
+        /* grow geometrically so that appending is cheap */
+        grown = arena->capacity;
+        while (grown < capacity) {
+            grown *= 2;
+        }
+        capacity = grown;
+    }
+
+    inputs = deeplearndata_arena_alloc(capacity*arena->no_of_input_fields,
+                                       &inputs_allocation);
+    if (!inputs) {
+        return -1;
+    }
+    outputs = deeplearndata_arena_alloc(capacity*arena->no_of_outputs,
+                                        &outputs_allocation);
+    if (!outputs) {
+        free(inputs_allocation);
+        return -1;
+    }
+    sample = (deeplearndata*)realloc(arena->sample,
+                                     capacity*sizeof(deeplearndata));
+    if (!sample) {
+        free(inputs_allocation);
+        free(outputs_allocation);
+        return -1;
+    }
+
+    if (arena->samples > 0) {
+        memcpy((void*)inputs, arena->inputs,
+               arena->samples*arena->no_of_input_fields*sizeof(float));
+        memcpy((void*)outputs, arena->outputs,
+               arena->samples*arena->no_of_outputs*sizeof(float));
+    }
+    free(arena->inputs_allocation);
+    free(arena->outputs_allocation);
+
+    arena->inputs = inputs;
+    arena->outputs = outputs;
+    arena->inputs_allocation = inputs_allocation;
+    arena->outputs_allocation = outputs_allocation;
+    arena->sample = sample;
+    arena->capacity = capacity;
+    deeplearndata_arena_link(arena);
+    return 0;
+}
+
+/**
+* @brief Initialises an arena in which data samples are stored contiguously
+* @param arena Data arena
+* @param no_of_input_fields The number of input fields
+* @param no_of_outputs The number of output fields
+* @param capacity Initial number of samples which can be stored before
+*        the arena needs to grow
+* @returns zero on success
+*/
+int deeplearndata_arena_init(deeplearndata_arena * arena,
+                             int no_of_input_fields,
+                             int no_of_outputs,
+                             int capacity)
+{
+    memset((void*)arena, '\0', sizeof(deeplearndata_arena));
+    if ((no_of_input_fields < 1) || (no_of_outputs < 1)) {
+        return -1;
+    }
+    if (capacity < 1) {
+        capacity = DEEPLEARNDATA_ARENA_CAPACITY;
+    }
+    arena->no_of_input_fields = no_of_input_fields;
+    arena->no_of_outputs = no_of_outputs;
+    if (deeplearndata_arena_reserve(arena, capacity) != 0) {
+        return -2;
+    }
+    return 0;
+}
+
+/**
+* @brief Releases the dataset file from which an arena was loaded
+* @param arena Data arena
+*/
+static void deeplearndata_arena_unmap(deeplearndata_arena * arena)
+{
+    if (arena->mapping == 0) {
+        return;
+    }
+#ifdef DEEPLEARNDATA_MMAP
+    if (arena->mapped != 0) {
+        munmap(arena->mapping, arena->mapping_size);
+    }
+    else {
+        free(arena->mapping);
+    }
+#else
+    free(arena->mapping);
+#endif
+    arena->mapping = 0;
+    arena->mapping_size = 0;
+    arena->mapped = 0;
+}
+
+/**
+* @brief Frees memory used by an arena
+* @param arena Data arena
+*/
+void deeplearndata_arena_free(deeplearndata_arena * arena)
+{
+    int i, j;
+
+    for (i = 0; i < arena->samples; i++) {
+        if (arena->text != 0) {
+            break;
+        }
+        if (arena->sample[i].inputs_text != 0) {
+            for (j = 0; j < arena->no_of_input_fields; j++) {
+                free(arena->sample[i].inputs_text[j]);
+            }
+            free(arena->sample[i].inputs_text);
+        }
+    }
+    free(arena->inputs_allocation);
+    free(arena->outputs_allocation);
+    free(arena->sample);
+    if (arena->mapping == 0) {
+        free(arena->text);
+    }
+    free(arena->text_fields);
+    free(arena->training);
+    free(arena->training_labeled);
+    free(arena->test);
+    deeplearndata_arena_unmap(arena);
+    memset((void*)arena, '\0', sizeof(deeplearndata_arena));
+}
+
+/**
+* @brief Appends a training or test sample to an arena
+* @param arena Data arena
+* @param inputs Input data
+* @param inputs_text Text for each input field, or NULL if all numeric
+* @param outputs Output data
+* @param input_range_min Minimum value for each input field
+* @param input_range_max Maximum value for each input field
+* @param output_range_min Minimum value for each output field
+* @param output_range_max Maximum value for each output field
+* @returns 0 on success
+*/
+int deeplearndata_arena_add(deeplearndata_arena * arena,
+                            float inputs[],
+                            char ** inputs_text,
+                            float outputs[],
+                            float input_range_min[],
+                            float input_range_max[],
+                            float output_range_min[],
+                            float output_range_max[])
+{
+    int i;
+    deeplearndata * data;
+
+    if (arena->text != 0) {
+        /* text has already been packed */
+        return -3;
+    }
+    if (deeplearndata_arena_reserve(arena, arena->samples+1) != 0) {
+        return -1;
+    }
+
+    data = &arena->sample[arena->samples];
+    data->inputs = &arena->inputs[arena->samples*arena->no_of_input_fields];
+    data->outputs = &arena->outputs[arena->samples*arena->no_of_outputs];
+    memcpy((void*)data->inputs, inputs,
+           arena->no_of_input_fields*sizeof(float));
+    memcpy((void*)data->outputs, outputs,
+           arena->no_of_outputs*sizeof(float));
+
+    data->inputs_text = 0;
+    if (inputs_text != 0) {
+        data->inputs_text =
+            (char**)malloc(arena->no_of_input_fields*sizeof(char*));
+        if (!data->inputs_text) {
+            return -2;
+        }
+        for (i = 0; i < arena->no_of_input_fields; i++) {
+            data->inputs_text[i] = 0;
+            if (inputs_text[i] != 0) {
+                data->inputs_text[i] =
+                    (char*)malloc((strlen(inputs_text[i])+1)*sizeof(char));
+                if (!data->inputs_text[i]) {
+                    return -2;
+                }
+                strcpy(data->inputs_text[i], inputs_text[i]);
+            }
+        }
+    }
+
+    data->labeled =
+        deeplearndata_update_ranges(inputs, outputs,
+                                    arena->no_of_input_fields,
+                                    arena->no_of_outputs,
+                                    input_range_min, input_range_max,
+                                    output_range_min, output_range_max);
+    data->flags = 0;
+    data->encoded_inputs = 0;
+    data->encoded_outputs = 0;
+    data->activations = 0;
+
+    /* append to the end of the list */
+    data->next = 0;
+    data->prev = 0;
+    if (arena->samples > 0) {
+        data->prev = &arena->sample[arena->samples-1];
+        data->prev->next = data;
+    }
+    arena->samples++;
+    return 0;
+}
+
+/**
+* @brief Moves the text fields of every sample within an arena into a
+*        single block, with a fixed width slot for each text field.
+*        Each character occupies one byte, which is the packed form of
+*        the eight input units it is encoded as. No further samples can
+*        be added to the arena afterwards.
+* @param arena Data arena
+* @param field_length The length of each input field in input units
+*        (bits), with zero indicating a numeric field
+* @returns zero on success
+*/
+int deeplearndata_arena_pack_text(deeplearndata_arena * arena,
+                                  int field_length[])
+{
+    int i, s, row = 0, fields = arena->no_of_input_fields;
+    int * slot, * width;
+    char * text;
+    char ** text_fields;
+
+    if (arena->text != 0) {
+        return 0;
+    }
+
+    slot = (int*)malloc(fields*sizeof(int));
+    width = (int*)malloc(fields*sizeof(int));
+    if ((!slot) || (!width)) {
+        free(slot);
+        free(width);
+        return -1;
+    }
+    for (i = 0; i < fields; i++) {
+        slot[i] = row;
+        width[i] = 0;
+        if (field_length[i] > 0) {
+            width[i] = field_length[i]/CHAR_BITS + 1;
+        }
+        row += width[i];
+    }
+    if (row == 0) {
+        /* all fields are numeric */
+        free(slot);
+        free(width);
+        return 0;
+    }
+
+    text = (char*)calloc(arena->samples*row + 1, sizeof(char));
+    text_fields = (char**)malloc((arena->samples*fields + 1)*sizeof(char*));
+    if ((!text) || (!text_fields)) {
+        free(text);
+        free(text_fields);
+        free(slot);
+        free(width);
+        return -2;
+    }
+
+    for (s = 0; s < arena->samples; s++) {
+        deeplearndata * sample = &arena->sample[s];
+        char ** packed = &text_fields[s*fields];
+
+        for (i = 0; i < fields; i++) {
+            packed[i] = 0;
+            if ((sample->inputs_text == 0) ||
+                (sample->inputs_text[i] == 0)) {
+                continue;
+            }
+            if (width[i] > 0) {
+                packed[i] = &text[s*row + slot[i]];
+                strncpy(packed[i], sample->inputs_text[i], width[i]-1);
+            }
+            free(sample->inputs_text[i]);
+        }
+        if (sample->inputs_text != 0) {
+            free(sample->inputs_text);
+            sample->inputs_text = packed;
+        }
+    }
+
+    arena->text = text;
+    arena->text_fields = text_fields;
+    arena->text_row = row;
+    free(slot);
+    free(width);
+    return 0;
+}
+
+/**
+* @brief Hands the samples within an arena over to a deep learner,
+*        which then becomes responsible for freeing them
+* @param learner Deep learner object
+* @param arena Data arena
+* @returns zero on success
+*/
+int deeplearndata_arena_attach(deeplearn * learner,
+                               deeplearndata_arena * arena)
+{
+    if ((learner->data != 0) || (learner->arena.sample != 0)) {
+        return -1;
+    }
+    if (arena->no_of_outputs != learner->net->NoOfOutputs) {
+        return -2;
+    }
+
+    learner->arena = *arena;
+    memset((void*)arena, '\0', sizeof(deeplearndata_arena));
+
+    learner->data = (learner->arena.samples > 0) ? learner->arena.sample : 0;
+    learner->data_samples = learner->arena.samples;
+    learner->indexed_data_samples = learner->arena.samples;
+    return 0;
+}
+
 /**
 * @brief Indexes data for fast read access
 * @param meta Pointer to the data list
@@ -191,6 +614,9 @@ deeplearndata * deeplearndata_get_training(deeplearn * learner, int index)
     if ((index < 0) || (index >= learner->indexed_training_data_samples)) {
         return 0;
     }
+    if (learner->arena.sample != 0) {
+        return &learner->arena.sample[learner->arena.training[index]];
+    }
 
     deeplearndata_meta * meta = learner->indexed_training_data[index];
     if (meta == 0) {
@@ -209,6 +635,9 @@ deeplearndata * deeplearndata_get_training_labeled(deeplearn * learner, int inde
     if ((index < 0) || (index >= learner->indexed_training_data_labeled_samples)) {
         return 0;
     }
+    if (learner->arena.sample != 0) {
+        return &learner->arena.sample[learner->arena.training_labeled[index]];
+    }
 
     deeplearndata_meta * meta = learner->indexed_training_data_labeled[index];
     if (meta == 0) {
@@ -227,6 +656,9 @@ deeplearndata * deeplearndata_get_test(deeplearn * learner, int index)
     if ((index < 0) || (index >= learner->indexed_test_data_samples)) {
         return 0;
     }
+    if (learner->arena.sample != 0) {
+        return &learner->arena.sample[learner->arena.test[index]];
+    }
 
     deeplearndata_meta * meta = learner->indexed_test_data[index];
     if (meta == 0) {
@@ -247,6 +679,9 @@ deeplearndata * deeplearndata_get(deeplearn * learner, int index)
     if ((index < 0) || (index >= learner->indexed_data_samples)) {
       return 0;
     }
+    if (learner->arena.sample != 0) {
+        return &learner->arena.sample[index];
+    }
 
     deeplearndata * ptr = learner->indexed_data[index];
     return ptr;
@@ -271,6 +706,22 @@ static void deeplearndata_clear_flags(deeplearn * learner)
 */
 static void deeplearndata_free_datasets(deeplearn * learner)
 {
+    /* pending samples belong to the previous sets */
+    if (learner->prefetch.enabled != 0) {
+        deeplearn_prefetch_drain(&learner->prefetch.queue);
+    }
+
+    /* layer outputs are cached for the previous training set */
+    deeplearn_activations_release(learner);
+
+    /* a new epoch begins with the new sets */
+    learner->epoch.position = 0;
+
+    /* index vectors within an arena are reused */
+    learner->arena.training_samples = 0;
+    learner->arena.training_labeled_samples = 0;
+    learner->arena.test_samples = 0;
+
     /* free training samples */
     deeplearndata_meta * training_sample = learner->training_data;
     deeplearndata_meta * prev_training_sample;
@@ -314,6 +765,107 @@ static void deeplearndata_free_datasets(deeplearn * learner)
     learner->indexed_test_data_samples = 0;
 }
 
+/**
+* @brief Returns the memory used by the data samples of a deep learner,
+*        including the training and test sets, the sample cache and
+*        any prefetched samples.  Samples within a memory mapped
+*        dataset file are not counted.
+* @param learner Deep learner object
+* @param usage Returned memory footprint
+*/
+void deeplearndata_memory_usage(deeplearn * learner,
+                                deeplearn_footprint * usage)
+{
+    deeplearndata_arena * arena = &learner->arena;
+    deeplearn_sample_cache * cache = &learner->cache;
+    int fields = learner->no_of_input_fields;
+    size_t bytes = 0;
+    int i;
+
+    deeplearn_footprint_clear(usage);
+
+    if (arena->sample != 0) {
+        bytes += (size_t)arena->capacity*sizeof(deeplearndata);
+        if (arena->inputs_allocation != 0) {
+            bytes += (size_t)arena->capacity*arena->no_of_input_fields*
+                sizeof(float) + DEEPLEARNDATA_ARENA_ALIGNMENT;
+        }
+        if (arena->outputs_allocation != 0) {
+            bytes += (size_t)arena->capacity*arena->no_of_outputs*
+                sizeof(float) + DEEPLEARNDATA_ARENA_ALIGNMENT;
+        }
+        if ((arena->text != 0) && (arena->mapping == 0)) {
+            bytes += (size_t)arena->samples*arena->text_row + 1;
+        }
+        if (arena->text_fields != 0) {
+            bytes += ((size_t)arena->samples*arena->no_of_input_fields + 1)*
+                sizeof(char*);
+        }
+        if (arena->training != 0) {
+            bytes += (size_t)arena->samples*sizeof(int);
+        }
+        if (arena->training_labeled != 0) {
+            bytes += (size_t)arena->samples*sizeof(int);
+        }
+        if (arena->test != 0) {
+            bytes += (size_t)arena->samples*sizeof(int);
+        }
+        if ((arena->mapping != 0) && (arena->mapped == 0)) {
+            /* the dataset file was read into memory */
+            bytes += arena->mapping_size;
+        }
+    }
+    else {
+        deeplearndata * sample = learner->data;
+
+        while (sample != 0) {
+            bytes += sizeof(deeplearndata) +
+                (size_t)(fields + learner->net->NoOfOutputs)*sizeof(float);
+            if (sample->inputs_text != 0) {
+                bytes += (size_t)fields*sizeof(char*);
+                for (i = 0; i < fields; i++) {
+                    if (sample->inputs_text[i] != 0) {
+                        bytes += strlen(sample->inputs_text[i]) + 1;
+                    }
+                }
+            }
+            sample = (deeplearndata*)sample->next;
+        }
+    }
+
+    /* training and test sets */
+    bytes += (size_t)(learner->training_data_samples +
+                      learner->training_data_labeled_samples +
+                      learner->test_data_samples)*sizeof(deeplearndata_meta);
+    bytes += (size_t)learner->indexed_data_samples*sizeof(deeplearndata*);
+    bytes += (size_t)(learner->indexed_training_data_samples +
+                      learner->indexed_training_data_labeled_samples +
+                      learner->indexed_test_data_samples)*
+        sizeof(deeplearndata_meta*);
+    if (learner->field_length != 0) {
+        bytes += (size_t)fields*sizeof(int);
+    }
+
+    /* encoded samples */
+    if (cache->inputs != 0) {
+        bytes += (size_t)cache->samples*
+            (learner->net->NoOfInputs + learner->net->NoOfOutputs)*
+            sizeof(float) +
+            (size_t)(learner->net->NoOfInputs + learner->net->NoOfOutputs) +
+            (size_t)(2*(cache->no_of_input_fields + 1) +
+                     2*learner->net->NoOfOutputs)*sizeof(float);
+    }
+    bytes += deeplearn_prefetch_allocated(&learner->prefetch.queue);
+    if (learner->prefetch.input_set != 0) {
+        bytes += (size_t)(learner->net->NoOfInputs +
+                          learner->net->NoOfOutputs) +
+            (size_t)(2*(fields + 1) +
+                     2*learner->net->NoOfOutputs)*sizeof(float);
+    }
+
+    usage->datasets = bytes;
+}
+
 /**
 * @brief Adds a sample to the training set
 * @param learner Deep learner object
@@ -408,385 +960,2437 @@ int deeplearndata_add_test_sample(deeplearn * learner, deeplearndata * sample)
 }
 
 /**
-* @brief Creates training and test sets from the data samples
+* @brief Assigns training and test sets within an arena from sample indexes
 * @param learner Deep learner object
-* @param test_data_percentage The percentage of samples to be used for testing
+* @param training Indexes of the training samples
+* @param training_samples The number of training samples
+* @param test Indexes of the test samples
+* @param test_samples The number of test samples
 * @returns zero on success
 */
-int deeplearndata_create_datasets(deeplearn * learner, int test_data_percentage)
+static int deeplearndata_arena_assign_datasets(deeplearn * learner,
+                                               int training[],
+                                               int training_samples,
+                                               int test[],
+                                               int test_samples)
 {
-    int training_samples = learner->data_samples * (100-test_data_percentage) / 100;
-    int index, retval;
-    deeplearndata * sample;
+    deeplearndata_arena * arena = &learner->arena;
+    int i, samples = arena->samples;
+    int * arena_training, * training_labeled, * arena_test;
 
-    if (learner->data == 0) {
-        return -1;
+    arena_training = (int*)realloc(arena->training, samples*sizeof(int));
+    if (!arena_training) {
+        return -200;
     }
-    deeplearndata_clear_flags(learner);
-    deeplearndata_free_datasets(learner);
-
+    arena->training = arena_training;
+    training_labeled =
+        (int*)realloc(arena->training_labeled, samples*sizeof(int));
+    if (!training_labeled) {
+        return -300;
+    }
+    arena->training_labeled = training_labeled;
+    arena_test = (int*)realloc(arena->test, samples*sizeof(int));
+    if (!arena_test) {
+        return -400;
+    }
+    arena->test = arena_test;
+
+    for (i = 0; i < training_samples; i++) {
+        arena_training[i] = training[i];
+        arena->sample[training[i]].flags = 1;
+        if (arena->sample[training[i]].labeled != 0) {
+            training_labeled[arena->training_labeled_samples++] = training[i];
+        }
+    }
+    arena->training_samples = training_samples;
+    memcpy((void*)arena_test, (void*)test, test_samples*sizeof(int));
+    arena->test_samples = test_samples;
+
+    learner->training_data_samples = arena->training_samples;
+    learner->indexed_training_data_samples = arena->training_samples;
+    learner->training_data_labeled_samples = arena->training_labeled_samples;
+    learner->indexed_training_data_labeled_samples =
+        arena->training_labeled_samples;
+    learner->test_data_samples = arena->test_samples;
+    learner->indexed_test_data_samples = arena->test_samples;
+    return 0;
+}
+
+/**
+* @brief Assigns training and test sets from sample indexes
+* @param learner Deep learner object
+* @param training Indexes of the training samples
+* @param training_samples The number of training samples
+* @param test Indexes of the test samples
+* @param test_samples The number of test samples
+* @returns zero on success
+*/
+static int deeplearndata_assign_datasets(deeplearn * learner,
+                                         int training[],
+                                         int training_samples,
+                                         int test[],
+                                         int test_samples)
+{
+    int i, retval;
+    deeplearndata * sample;
+
+    if (learner->arena.sample != 0) {
+        return deeplearndata_arena_assign_datasets(learner,
+                                                   training, training_samples,
+                                                   test, test_samples);
+    }
+
     /* create training samples */
-    while (learner->training_data_samples < training_samples) {
-        index = rand_num(&learner->net->random_seed)%learner->data_samples;
-        sample = deeplearndata_get(learner, index);
+    for (i = 0; i < training_samples; i++) {
+        sample = deeplearndata_get(learner, training[i]);
         if (!sample) return -1;
-        if (sample->flags == 0) {
-            sample->flags = 1;
+        sample->flags = 1;
+        retval =
+            deeplearndata_add_training_sample(learner, sample);
+        if (retval != 0) {
+            return -200 + retval;
+        }
+        if (sample->labeled != 0) {
             retval =
-              deeplearndata_add_training_sample(learner, sample);
+                deeplearndata_add_labeled_training_sample(learner, sample);
             if (retval != 0) {
-                return -200 + retval;
+                return -300 + retval;
+            }
+        }
+    }
+
+    /* create test samples */
+    for (i = 0; i < test_samples; i++) {
+        sample = deeplearndata_get(learner, test[i]);
+        if (!sample) return -1;
+        retval =
+            deeplearndata_add_test_sample(learner, sample);
+        if (retval != 0) {
+            return -400 + retval;
+        }
+    }
+
+    /* create the indexed arrays for fast access */
+    deeplearndata_index_meta(learner->training_data, learner->training_data_samples, &learner->indexed_training_data, &learner->indexed_training_data_samples);
+    deeplearndata_index_meta(learner->training_data_labeled, learner->training_data_labeled_samples, &learner->indexed_training_data_labeled, &learner->indexed_training_data_labeled_samples);
+    deeplearndata_index_meta(learner->test_data, learner->test_data_samples, &learner->indexed_test_data, &learner->indexed_test_data_samples);
+    return 0;
+}
+
+/**
+* @brief Returns the classes used to divide the data samples. Unlabeled
+*        samples are given a negative class so that they are only used
+*        for training. If stratified then the class of a labeled sample
+*        is the output with the largest value.
+* @param learner Deep learner object
+* @param method Split method DEEPLEARN_SPLIT_*
+* @param classes Returned class of each sample
+* @returns zero on success
+*/
+static int deeplearndata_split_classes(deeplearn * learner, int method,
+                                       int classes[])
+{
+    for (int i = 0; i < learner->data_samples; i++) {
+        deeplearndata * sample = deeplearndata_get(learner, i);
+        if (!sample) return -1;
+
+        classes[i] = -1;
+        if (sample->labeled == 0) continue;
+
+        classes[i] = 0;
+        if (method == DEEPLEARN_SPLIT_STRATIFIED) {
+            for (int j = 1; j < learner->net->NoOfOutputs; j++) {
+                if (sample->outputs[j] > sample->outputs[classes[i]]) {
+                    classes[i] = j;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+* @brief Divides the data samples into training and test sets,
+*        either by percentage or into folds
+* @param learner Deep learner object
+* @param method Split method DEEPLEARN_SPLIT_*
+* @param test_data_percentage The percentage of labeled samples to be used
+*        for testing, or negative if splitting into folds
+* @param folds The number of folds
+* @param fold Index of the fold used for testing
+* @param random_seed Random number seed used for folds
+* @returns zero on success
+*/
+static int deeplearndata_split_datasets(deeplearn * learner, int method,
+                                        int test_data_percentage,
+                                        int folds, int fold,
+                                        unsigned int random_seed)
+{
+    int n = learner->data_samples;
+    int training_samples = 0, test_samples = 0, retval;
+    int * classes, * training, * test;
+
+    if (learner->data == 0) {
+        return -1;
+    }
+    if ((method < 0) || (method >= DEEPLEARN_SPLIT_METHODS)) {
+        return -2;
+    }
+    deeplearndata_clear_flags(learner);
+    deeplearndata_free_datasets(learner);
+
+    classes = (int*)malloc(n*sizeof(int));
+    training = (int*)malloc(n*sizeof(int));
+    test = (int*)malloc(n*sizeof(int));
+    if ((!classes) || (!training) || (!test)) {
+        free(classes);
+        free(training);
+        free(test);
+        return -3;
+    }
+
+    retval = deeplearndata_split_classes(learner, method, classes);
+    if (retval == 0) {
+        if (test_data_percentage >= 0) {
+            retval = deeplearn_split(n, classes, test_data_percentage,
+                                     &learner->net->random_seed,
+                                     training, &training_samples,
+                                     test, &test_samples);
+        }
+        else {
+            retval = deeplearn_split_kfold(n, classes, folds, fold,
+                                           random_seed,
+                                           training, &training_samples,
+                                           test, &test_samples);
+        }
+        if (retval != 0) {
+            retval = -4;
+        }
+    }
+    if (retval == 0) {
+        retval = deeplearndata_assign_datasets(learner,
+                                               training, training_samples,
+                                               test, test_samples);
+    }
+
+    free(classes);
+    free(training);
+    free(test);
+    return retval;
+}
+
+/**
+* @brief Creates training and test sets from the data samples.
+*        Unlabeled samples are always used for training.
+* @param learner Deep learner object
+* @param test_data_percentage The percentage of labeled samples to be
+*        used for testing
+* @param method Split method DEEPLEARN_SPLIT_*. If stratified then each
+*        class appears in the same proportion within both sets
+* @returns zero on success
+*/
+int deeplearndata_split(deeplearn * learner, int test_data_percentage,
+                        int method)
+{
+    if ((test_data_percentage < 0) || (test_data_percentage > 100)) {
+        return -5;
+    }
+    return deeplearndata_split_datasets(learner, method,
+                                        test_data_percentage, 0, 0, 0);
+}
+
+/**
+* @brief Divides the data samples into folds for cross validation,
+*        with the given fold becoming the test set
+* @param learner Deep learner object
+* @param folds The number of folds
+* @param fold Index of the fold used for testing
+* @param method Split method DEEPLEARN_SPLIT_*
+* @param random_seed Random number seed, which should be the same for
+*        every fold
+* @returns zero on success
+*/
+int deeplearndata_split_kfold(deeplearn * learner, int folds, int fold,
+                              int method, unsigned int random_seed)
+{
+    return deeplearndata_split_datasets(learner, method, -1,
+                                        folds, fold, random_seed);
+}
+
+/**
+* @brief Creates training and test sets from the data samples
+* @param learner Deep learner object
+* @param test_data_percentage The percentage of samples to be used for testing
+* @returns zero on success
+*/
+int deeplearndata_create_datasets(deeplearn * learner, int test_data_percentage)
+{
+    return deeplearndata_split(learner, test_data_percentage,
+                               DEEPLEARN_SPLIT_RANDOM);
+}
+
+/**
+* @brief Shuffles an indexed array of metadata
+* @param indexed_list The indexed metadata
+* @param samples The number of entries
+* @param random_seed Random number seed
+*/
+static void deeplearndata_shuffle_meta(deeplearndata_meta ** indexed_list,
+                                       int samples,
+                                       unsigned int * random_seed)
+{
+    for (int i = samples - 1; i > 0; i--) {
+        int j = (int)(rand_num(random_seed) % (i + 1));
+        deeplearndata_meta * swap = indexed_list[i];
+        indexed_list[i] = indexed_list[j];
+        indexed_list[j] = swap;
+    }
+}
+
+/**
+* @brief Reorders the training set, typically at the start of each epoch
+* @param learner Deep learner object
+*/
+void deeplearndata_shuffle_training(deeplearn * learner)
+{
+    unsigned int * random_seed = &learner->net->random_seed;
+
+    if (learner->arena.sample != 0) {
+        deeplearn_split_shuffle(learner->arena.training,
+                                learner->arena.training_samples,
+                                random_seed);
+        deeplearn_split_shuffle(learner->arena.training_labeled,
+                                learner->arena.training_labeled_samples,
+                                random_seed);
+        return;
+    }
+    deeplearndata_shuffle_meta(learner->indexed_training_data,
+                               learner->indexed_training_data_samples,
+                               random_seed);
+    deeplearndata_shuffle_meta(learner->indexed_training_data_labeled,
+                               learner->indexed_training_data_labeled_samples,
+                               random_seed);
+}
+
+/* state used while streaming a csv file */
+typedef struct {
+    int no_of_outputs;
+    int * output_field_index;
+    int output_classes;
+    int network_outputs;
+
+    /* fields of the first row define the input fields */
+    int no_of_input_fields;
+    int input_capacity;
+    float * inputs;
+    char ** inputs_text;
+    int * field_length;
+    float * input_range_min;
+    float * input_range_max;
+    float * outputs;
+    float * output_range_min;
+    float * output_range_max;
+
+    /* lines split across chunks */
+    char * carry;
+    int carry_length, carry_capacity;
+
+    deeplearndata_arena arena;
+} deeplearndata_csv;
+
+/**
+* @brief Ensures that there is space for the given number of input fields
+*        while the first row is being read
+* @param csv csv reader state
+* @param fields The number of input fields needed
+* @returns zero on success
+*/
+static int deeplearndata_csv_grow_inputs(deeplearndata_csv * csv, int fields)
+{
+    int i, capacity = csv->input_capacity;
+
+    if (fields <= capacity) {
+        return 0;
+    }
+    while (capacity < fields) {
+        capacity = (capacity == 0) ? 64 : capacity*2;
+    }
+
+    csv->inputs = (float*)realloc(csv->inputs, capacity*sizeof(float));
+    csv->inputs_text = (char**)realloc(csv->inputs_text, capacity*sizeof(char*));
+    csv->field_length = (int*)realloc(csv->field_length, capacity*sizeof(int));
+    csv->input_range_min =
+        (float*)realloc(csv->input_range_min, capacity*sizeof(float));
+    csv->input_range_max =
+        (float*)realloc(csv->input_range_max, capacity*sizeof(float));
+    if ((!csv->inputs) || (!csv->inputs_text) || (!csv->field_length) ||
+        (!csv->input_range_min) || (!csv->input_range_max)) {
+        return -1;
+    }
+    for (i = csv->input_capacity; i < capacity; i++) {
+        csv->inputs[i] = 0;
+        csv->inputs_text[i] = 0;
+        csv->field_length[i] = 0;
+        csv->input_range_min[i] = 9999;
+        csv->input_range_max[i] = -9999;
+    }
+    csv->input_capacity = capacity;
+    return 0;
+}
+
+/**
+* @brief Parses a single line of a csv file and adds it as a data sample.
+*        The line is modified in place.
+* @param csv csv reader state
+* @param line The line, which need not be zero terminated
+* @param length Length of the line, excluding any line ending
+* @returns zero on success
+*/
+static int deeplearndata_csv_parse_line(deeplearndata_csv * csv,
+                                        char * line, int length)
+{
+    int i, j, k, field_number = 0, input_index = 0, end;
+    int first_row = (csv->arena.sample == 0);
+    float value;
+    char * field = line;
+    int is_text;
+
+    if ((length > 0) && (line[length-1] == '\r')) {
+        length--;
+    }
+    if ((length == 0) || (line[0] == '"') || (line[0] == '#')) {
+        return 0;
+    }
+
+    for (i = 0; i <= length; i++) {
+        if ((i < length) && (line[i] != ',') && (line[i] != ';')) {
+            continue;
+        }
+
+        /* terminate the field, truncating long text */
+        end = i;
+        if (end - (int)(field - line) > DEEPLEARN_MAX_FIELD_LENGTH_CHARS-1) {
+            end = (int)(field - line) + DEEPLEARN_MAX_FIELD_LENGTH_CHARS-1;
+        }
+        line[end] = 0;
+
+        /* get the value from the string */
+        value = 0;
+        is_text = 0;
+        if ((field[0] != '?') && (field[0] != 0)) {
+            if (((field[0] >= '0') && (field[0] <= '9')) ||
+                ((field[0] == '-') && (field[1] >= '0') && (field[1] <= '9'))) {
+                value = (float)strtod(field, NULL);
+            }
+            else {
+                is_text = 1;
+            }
+        }
+
+        for (j = 0; j < csv->no_of_outputs; j++) {
+            if (field_number == csv->output_field_index[j]) {
+                if (csv->output_classes <= 0) {
+                    csv->outputs[j] = value;
+                }
+                else {
+                    /* for a class number */
+                    for (k = 0; k < csv->network_outputs; k++) {
+                        csv->outputs[k] = (k != (int)value) ? 0.25f : 0.75f;
+                    }
+                }
+                break;
+            }
+        }
+
+        if (j == csv->no_of_outputs) {
+            if (first_row != 0) {
+                if (deeplearndata_csv_grow_inputs(csv, input_index+1) != 0) {
+                    return -1;
+                }
             }
-            if (sample->labeled != 0) {
-                retval =
-                    deeplearndata_add_labeled_training_sample(learner, sample);
-                if (retval != 0) {
-                    return -300 + retval;
+            if ((input_index < csv->no_of_input_fields) || (first_row != 0)) {
+                csv->inputs_text[input_index] = 0;
+                if (is_text != 0) {
+                    csv->inputs_text[input_index] = field;
+                    if (end - (int)(field - line) > 0) {
+                        int bits = (end - (int)(field - line))*CHAR_BITS;
+                        if (bits > csv->field_length[input_index]) {
+                            csv->field_length[input_index] = bits;
+                        }
+                    }
                 }
+                csv->inputs[input_index++] = value;
+            }
+        }
+
+        field_number++;
+        field = &line[i+1];
+    }
+
+    if (first_row != 0) {
+        csv->no_of_input_fields = input_index;
+    }
+
+    /* missing fields at the end of the row */
+    for (i = input_index; i < csv->no_of_input_fields; i++) {
+        csv->inputs[i] = 0;
+        csv->inputs_text[i] = 0;
+    }
+
+    if (first_row != 0) {
+        if (deeplearndata_arena_init(&csv->arena,
+                                     csv->no_of_input_fields,
+                                     csv->network_outputs, 0) != 0) {
+            return -2;
+        }
+    }
+
+    /* add a data sample, which also updates the field ranges */
+    if (deeplearndata_arena_add(&csv->arena,
+                                csv->inputs, csv->inputs_text, csv->outputs,
+                                csv->input_range_min, csv->input_range_max,
+                                csv->output_range_min,
+                                csv->output_range_max) != 0) {
+        return -2;
+    }
+
+    for (i = 0; i < csv->network_outputs; i++) {
+        csv->outputs[i] = DEEPLEARN_UNKNOWN_VALUE;
+    }
+    return 0;
+}
+
+/**
+* @brief Appends text to the line carried over between chunks
+* @param csv csv reader state
+* @param text The text to be appended
+* @param length Length of the text
+* @returns zero on success
+*/
+static int deeplearndata_csv_carry(deeplearndata_csv * csv,
+                                   char * text, int length)
+{
+    if (csv->carry_length + length + 1 > csv->carry_capacity) {
+        csv->carry_capacity = (csv->carry_length + length + 1)*2;
+        csv->carry = (char*)realloc(csv->carry, csv->carry_capacity);
+        if (!csv->carry) {
+            return -1;
+        }
+    }
+    memcpy((void*)&csv->carry[csv->carry_length], text, length);
+    csv->carry_length += length;
+    return 0;
+}
+
+/**
+* @brief Parses all complete lines within a chunk of a csv file.
+*        Any incomplete line at the end of the chunk is carried over.
+* @param csv csv reader state
+* @param chunk The chunk of the file
+* @param length Length of the chunk
+* @returns zero on success
+*/
+static int deeplearndata_csv_parse_chunk(deeplearndata_csv * csv,
+                                         char * chunk, int length)
+{
+    char * line = chunk, * end = chunk + length, * eol;
+
+    while ((eol = (char*)memchr(line, '\n', end - line)) != NULL) {
+        if (csv->carry_length > 0) {
+            /* complete the line from the previous chunk */
+            if (deeplearndata_csv_carry(csv, line, (int)(eol - line)) != 0) {
+                return -1;
+            }
+            if (deeplearndata_csv_parse_line(csv, csv->carry,
+                                             csv->carry_length) != 0) {
+                return -2;
+            }
+            csv->carry_length = 0;
+        }
+        else {
+            if (deeplearndata_csv_parse_line(csv, line,
+                                             (int)(eol - line)) != 0) {
+                return -2;
+            }
+        }
+        line = eol + 1;
+    }
+
+    if (line < end) {
+        if (deeplearndata_csv_carry(csv, line, (int)(end - line)) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+* @brief Frees memory used by the csv reader
+* @param csv csv reader state
+*/
+static void deeplearndata_csv_free(deeplearndata_csv * csv)
+{
+    free(csv->inputs);
+    free(csv->inputs_text);
+    free(csv->field_length);
+    free(csv->input_range_min);
+    free(csv->input_range_max);
+    free(csv->outputs);
+    free(csv->output_range_min);
+    free(csv->output_range_max);
+    free(csv->carry);
+    deeplearndata_arena_free(&csv->arena);
+}
+
+/**
+* @brief Loads a data set from a csv file and creates a deep learner.
+*        The file is read in chunks, optionally with the next chunk being
+*        read on a background thread while the current one is parsed.
+*        Field ranges and text field lengths are updated as each row is
+*        added, so the data is only passed over once.
+* @param filename csv filename
+* @param learner Deep learner object
+* @param no_of_hiddens The number of hidden units per layer
+* @param hidden layers The number of hidden layers
+* @param no_of_outputs The number of outputs
+* @param output_field_index Field numbers for the outputs within the csv file
+* @param output_classes The number of output classes if the output in the
+*        data set is a single integer value
+* @param error_threshold Training error thresholds for each hidden layer
+* @param random_seed Random number seed
+* @param chunk_size Number of bytes read from the file at a time
+* @param background Non-zero if chunks are read on a background thread
+* @returns The number of data samples loaded
+*/
+int deeplearndata_read_csv_chunked(char * filename,
+                                   deeplearn * learner,
+                                   int no_of_hiddens, int hidden_layers,
+                                   int no_of_outputs, int * output_field_index,
+                                   int output_classes,
+                                   float error_threshold[],
+                                   unsigned int * random_seed,
+                                   int chunk_size,
+                                   unsigned char background)
+{
+    int i, cur = 0, retval = 0, no_of_inputs = 0;
+    size_t length, next_length;
+    char * chunk[2];
+    deeplearndata_csv csv;
+    FILE * fp;
+
+    if (chunk_size < 1) {
+        return -4;
+    }
+
+    memset((void*)&csv, '\0', sizeof(deeplearndata_csv));
+    csv.no_of_outputs = no_of_outputs;
+    csv.output_field_index = output_field_index;
+    csv.output_classes = output_classes;
+    csv.network_outputs = no_of_outputs;
+    if (output_classes > 0) {
+        csv.network_outputs = output_classes;
+    }
+    csv.outputs = (float*)malloc(csv.network_outputs*sizeof(float));
+    csv.output_range_min = (float*)malloc(csv.network_outputs*sizeof(float));
+    csv.output_range_max = (float*)malloc(csv.network_outputs*sizeof(float));
+    if ((!csv.outputs) || (!csv.output_range_min) || (!csv.output_range_max)) {
+        deeplearndata_csv_free(&csv);
+        return -5;
+    }
+    for (i = 0; i < csv.network_outputs; i++) {
+        csv.outputs[i] = DEEPLEARN_UNKNOWN_VALUE;
+        csv.output_range_min[i] = 9999;
+        csv.output_range_max[i] = -9999;
+    }
+
+    fp = fopen(filename,"r");
+    if (!fp) {
+        deeplearndata_csv_free(&csv);
+        return -1;
+    }
+
+    chunk[0] = (char*)malloc(chunk_size);
+    chunk[1] = (char*)malloc(chunk_size);
+    if ((!chunk[0]) || (!chunk[1])) {
+        free(chunk[0]);
+        free(chunk[1]);
+        fclose(fp);
+        deeplearndata_csv_free(&csv);
+        return -5;
+    }
+
+    /* read the next chunk while the current one is parsed */
+    length = fread(chunk[cur], 1, chunk_size, fp);
+    while ((length > 0) && (retval == 0)) {
+        next_length = 0;
+#pragma omp parallel sections if (background != 0) num_threads(2)
+        {
+#pragma omp section
+            {
+                next_length = fread(chunk[1-cur], 1, chunk_size, fp);
+            }
+#pragma omp section
+            {
+                retval = deeplearndata_csv_parse_chunk(&csv, chunk[cur],
+                                                       (int)length);
             }
         }
+        cur = 1 - cur;
+        length = next_length;
+    }
+
+    /* final line without a line ending */
+    if ((retval == 0) && (csv.carry_length > 0)) {
+        retval = deeplearndata_csv_parse_line(&csv, csv.carry,
+                                              csv.carry_length);
+    }
+
+    free(chunk[0]);
+    free(chunk[1]);
+    fclose(fp);
+
+    if (retval != 0) {
+        deeplearndata_csv_free(&csv);
+        return -2;
+    }
+
+    /* calculate the number of input units from the field lengths */
+    for (i = 0; i < csv.no_of_input_fields; i++) {
+        no_of_inputs += (csv.field_length[i] < 1) ? 1 : csv.field_length[i];
+    }
+
+    /* create the deep learner */
+    if (deeplearn_init(learner,
+                       no_of_inputs, no_of_hiddens,
+                       hidden_layers, csv.network_outputs,
+                       error_threshold, random_seed) != 0) {
+        deeplearndata_csv_free(&csv);
+        return -5;
+    }
+
+    /* set the input fields */
+    learner->no_of_input_fields = csv.no_of_input_fields;
+    learner->field_length =
+        (int*)malloc(csv.no_of_input_fields*sizeof(int));
+    for (i = 0; i < csv.no_of_input_fields; i++) {
+        learner->field_length[i] = csv.field_length[i];
+        if (csv.field_length[i] > 0) {
+            csv.input_range_min[i] = 0.25f;
+            csv.input_range_max[i] = 0.75f;
+        }
+    }
+
+    /* attach the data samples, with text packed now that the
+       field lengths are known */
+    if ((deeplearndata_arena_pack_text(&csv.arena, csv.field_length) != 0) ||
+        (deeplearndata_arena_attach(learner, &csv.arena) != 0)) {
+        deeplearndata_csv_free(&csv);
+        return -5;
+    }
+
+    /* set the field ranges */
+    for (i = 0; i < csv.no_of_input_fields; i++) {
+        learner->input_range_min[i] = csv.input_range_min[i];
+        learner->input_range_max[i] = csv.input_range_max[i];
+    }
+    for (i = 0; i < csv.network_outputs; i++) {
+        learner->output_range_min[i] = csv.output_range_min[i];
+        learner->output_range_max[i] = csv.output_range_max[i];
+    }
+    deeplearndata_csv_free(&csv);
+
+    /* create training and test data sets */
+    if (deeplearndata_create_datasets(learner, 20) != 0) {
+        return -3;
+    }
+
+    return learner->data_samples;
+}
+
+/**
+* @brief Returns a sample in the order in which it is saved, which is
+*        the training set followed by the test set, or every sample if
+*        the sets have not been created
+* @param learner Deep learner object
+* @param index Position of the sample within the file
+* @returns The sample, or NULL if it could not be found
+*/
+static deeplearndata * deeplearndata_file_sample(deeplearn * learner,
+                                                 int index)
+{
+    if (learner->training_data_samples + learner->test_data_samples == 0) {
+        return deeplearndata_get(learner, index);
+    }
+    if (index < learner->training_data_samples) {
+        return deeplearndata_get_training(learner, index);
+    }
+    return deeplearndata_get_test(learner,
+                                  index - learner->training_data_samples);
+}
+
+/**
+* @brief Writes zeros until the given file offset is reached
+* @param fp File pointer
+* @param position Current offset, which is updated
+* @param offset The offset to be reached
+* @returns zero on success
+*/
+static int deeplearndata_file_pad(FILE * fp, uint64_t * position,
+                                  uint64_t offset)
+{
+    while (*position < offset) {
+        if (fputc(0, fp) == EOF) {
+            return -1;
+        }
+        (*position)++;
+    }
+    return 0;
+}
+
+/**
+* @brief Writes the samples within a file, one section at a time
+* @param fp File pointer
+* @param learner Deep learner object
+* @param header Header of the file
+* @param width Width in bytes of each text field, zero if numeric
+* @returns zero on success
+*/
+static int deeplearndata_file_write(FILE * fp, deeplearn * learner,
+                                    deeplearndata_file_header * header,
+                                    int * width)
+{
+    int i, s, slot, fields = header->no_of_input_fields;
+    int outputs = header->no_of_outputs;
+    uint64_t position = sizeof(deeplearndata_file_header);
+    int32_t length;
+    char * row;
+
+    if (fwrite(header, sizeof(deeplearndata_file_header), 1, fp) != 1) {
+        return -1;
+    }
+
+    /* field lengths and ranges */
+    if (deeplearndata_file_pad(fp, &position, header->fields_offset) != 0) {
+        return -1;
+    }
+    for (i = 0; i < fields; i++) {
+        length = (int32_t)learner->field_length[i];
+        if (fwrite(&length, sizeof(int32_t), 1, fp) != 1) {
+            return -1;
+        }
+    }
+    if ((fwrite(learner->input_range_min, sizeof(float), fields, fp) !=
+         (size_t)fields) ||
+        (fwrite(learner->input_range_max, sizeof(float), fields, fp) !=
+         (size_t)fields) ||
+        (fwrite(learner->output_range_min, sizeof(float), outputs, fp) !=
+         (size_t)outputs) ||
+        (fwrite(learner->output_range_max, sizeof(float), outputs, fp) !=
+         (size_t)outputs)) {
+        return -1;
+    }
+    position += fields*sizeof(int32_t) + 2*(fields + outputs)*sizeof(float);
+
+    /* inputs */
+    if (deeplearndata_file_pad(fp, &position, header->inputs_offset) != 0) {
+        return -1;
+    }
+    for (s = 0; s < header->samples; s++) {
+        deeplearndata * sample = deeplearndata_file_sample(learner, s);
+        if (fwrite(sample->inputs, sizeof(float), fields, fp) !=
+            (size_t)fields) {
+            return -1;
+        }
+    }
+    position += (uint64_t)header->samples*fields*sizeof(float);
+
+    /* outputs */
+    if (deeplearndata_file_pad(fp, &position, header->outputs_offset) != 0) {
+        return -1;
+    }
+    for (s = 0; s < header->samples; s++) {
+        deeplearndata * sample = deeplearndata_file_sample(learner, s);
+        if (fwrite(sample->outputs, sizeof(float), outputs, fp) !=
+            (size_t)outputs) {
+            return -1;
+        }
+    }
+    position += (uint64_t)header->samples*outputs*sizeof(float);
+
+    /* text packed into fixed width slots */
+    if (header->text_row == 0) {
+        return 0;
+    }
+    if (deeplearndata_file_pad(fp, &position, header->text_offset) != 0) {
+        return -1;
+    }
+    row = (char*)malloc(header->text_row*sizeof(char));
+    if (!row) {
+        return -2;
+    }
+    for (s = 0; s < header->samples; s++) {
+        deeplearndata * sample = deeplearndata_file_sample(learner, s);
+        memset(row, '\0', header->text_row);
+        for (i = 0, slot = 0; i < fields; slot += width[i], i++) {
+            if ((width[i] == 0) || (sample->inputs_text == 0) ||
+                (sample->inputs_text[i] == 0)) {
+                continue;
+            }
+            strncpy(&row[slot], sample->inputs_text[i], width[i]-1);
+        }
+        if (fwrite(row, 1, header->text_row, fp) !=
+            (size_t)header->text_row) {
+            free(row);
+            return -1;
+        }
+    }
+    free(row);
+    return 0;
+}
+
+/**
+* @brief Saves the data samples of a learner as a binary dataset file,
+*        together with the field lengths, data ranges and the training
+*        and test sets, so that it can later be loaded without parsing
+*        using deeplearndata_load_mmap. Samples which are within neither
+*        the training nor the test set are not saved.
+* @param learner Deep learner object
+* @param filename Filename of the dataset file to be written
+* @returns The number of samples saved, or negative on error
+*/
+int deeplearndata_save(deeplearn * learner, char * filename)
+{
+    deeplearndata_file_header header;
+    int i, retval, fields = learner->no_of_input_fields;
+    int outputs = learner->net->NoOfOutputs;
+    int * width;
+    FILE * fp;
+
+    if ((learner->data_samples == 0) || (learner->field_length == 0)) {
+        return -1;
+    }
+
+    memset((void*)&header, '\0', sizeof(header));
+    memcpy(header.magic, DEEPLEARNDATA_FILE_MAGIC, 8);
+    header.version = DEEPLEARNDATA_FILE_VERSION;
+    header.no_of_input_fields = fields;
+    header.no_of_outputs = outputs;
+    header.training_samples = learner->training_data_samples;
+    header.test_samples = learner->test_data_samples;
+    header.samples = header.training_samples + header.test_samples;
+    if (header.samples == 0) {
+        header.samples = learner->data_samples;
+    }
+    for (i = 0; i < header.samples; i++) {
+        if (deeplearndata_file_sample(learner, i) == 0) {
+            return -2;
+        }
+    }
+
+    /* slots wide enough for the text of each field */
+    width = (int*)malloc(fields*sizeof(int));
+    if (!width) {
+        return -3;
+    }
+    for (i = 0; i < fields; i++) {
+        width[i] = 0;
+        if (learner->field_length[i] > 0) {
+            width[i] = learner->field_length[i]/CHAR_BITS + 1;
+        }
+        header.text_row += width[i];
+    }
+
+    header.fields_offset =
+        DEEPLEARNDATA_FILE_ALIGN((uint64_t)sizeof(header));
+    header.inputs_offset =
+        DEEPLEARNDATA_FILE_ALIGN(header.fields_offset +
+                                 fields*sizeof(int32_t) +
+                                 2*(fields + outputs)*sizeof(float));
+    header.outputs_offset =
+        DEEPLEARNDATA_FILE_ALIGN(header.inputs_offset +
+                                 (uint64_t)header.samples*fields*
+                                 sizeof(float));
+    header.text_offset =
+        DEEPLEARNDATA_FILE_ALIGN(header.outputs_offset +
+                                 (uint64_t)header.samples*outputs*
+                                 sizeof(float));
+    header.size = header.text_offset +
+        (uint64_t)header.samples*header.text_row;
+    if (header.text_row == 0) {
+        header.size = header.outputs_offset +
+            (uint64_t)header.samples*outputs*sizeof(float);
+    }
+
+    fp = fopen(filename, "wb");
+    if (!fp) {
+        free(width);
+        return -4;
+    }
+    retval = deeplearndata_file_write(fp, learner, &header, width);
+    if (fclose(fp) != 0) {
+        retval = -1;
+    }
+    free(width);
+    if (retval != 0) {
+        return -5;
+    }
+    return header.samples;
+}
+
+#ifdef DEEPLEARNDATA_MMAP
+/**
+* @brief Maps the whole of an open dataset file or shared memory object,
+*        then closes the file descriptor
+* @param fd File descriptor
+* @param arena Arena which is given the mapping
+* @returns zero on success
+*/
+static int deeplearndata_file_map(int fd, deeplearndata_arena * arena)
+{
+    struct stat st;
+    void * data;
+
+    if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+        close(fd);
+        return -1;
+    }
+    /* private pages, so that samples may be changed in memory without
+       changing the file, while unchanged pages remain shared with
+       other processes mapping the same file */
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    arena->mapping = data;
+    arena->mapping_size = (size_t)st.st_size;
+    arena->mapped = 1;
+    return 0;
+}
+#endif
+
+/**
+* @brief Maps a dataset file into memory, or reads it where mapping is
+*        not available
+* @param filename Filename of the dataset file
+* @param arena Arena which is given the mapping
+* @returns zero on success
+*/
+static int deeplearndata_file_open(char * filename,
+                                   deeplearndata_arena * arena)
+{
+#ifdef DEEPLEARNDATA_MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    if (deeplearndata_file_map(fd, arena) != 0) {
+        return -2;
+    }
+#else
+    long size;
+    FILE * fp = fopen(filename, "rb");
+    if (!fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        fclose(fp);
+        return -2;
+    }
+    arena->mapping = malloc((size_t)size);
+    if (!arena->mapping) {
+        fclose(fp);
+        return -2;
+    }
+    arena->mapping_size = (size_t)size;
+    if (fread(arena->mapping, 1, arena->mapping_size, fp) !=
+        arena->mapping_size) {
+        fclose(fp);
+        deeplearndata_arena_unmap(arena);
+        return -2;
+    }
+    fclose(fp);
+#endif
+    return 0;
+}
+
+/**
+* @brief Checks the header of a mapped dataset file
+* @param arena Arena holding the mapping
+* @returns The header, or NULL if the file is not valid
+*/
+static deeplearndata_file_header *
+deeplearndata_file_check(deeplearndata_arena * arena)
+{
+    deeplearndata_file_header * header =
+        (deeplearndata_file_header*)arena->mapping;
+    uint64_t fields, outputs, samples;
+
+    if (arena->mapping_size < sizeof(deeplearndata_file_header)) {
+        return NULL;
+    }
+    if ((memcmp(header->magic, DEEPLEARNDATA_FILE_MAGIC, 8) != 0) ||
+        (header->version != DEEPLEARNDATA_FILE_VERSION)) {
+        return NULL;
+    }
+    if ((header->samples <= 0) || (header->no_of_input_fields <= 0) ||
+        (header->no_of_outputs <= 0) || (header->text_row < 0) ||
+        (header->training_samples < 0) || (header->test_samples < 0) ||
+        (header->training_samples + header->test_samples >
+         header->samples)) {
+        return NULL;
+    }
+
+    /* check that every section lies within the file */
+    fields = (uint64_t)header->no_of_input_fields;
+    outputs = (uint64_t)header->no_of_outputs;
+    samples = (uint64_t)header->samples;
+    if ((header->fields_offset < sizeof(deeplearndata_file_header)) ||
+        (header->fields_offset + fields*sizeof(int32_t) +
+         2*(fields + outputs)*sizeof(float) > header->inputs_offset) ||
+        (header->inputs_offset + samples*fields*sizeof(float) >
+         header->outputs_offset) ||
+        (header->outputs_offset + samples*outputs*sizeof(float) >
+         header->size) ||
+        ((header->text_row > 0) &&
+         (header->text_offset + samples*header->text_row !=
+          header->size)) ||
+        (header->size > (uint64_t)arena->mapping_size)) {
+        return NULL;
+    }
+    return header;
+}
+
+/**
+* @brief Creates a deep learner from a mapped binary dataset file. The
+*        arena is released on error and otherwise owned by the learner.
+* @param arena Arena holding the mapping
+* @param learner Deep learner object
+* @param no_of_hiddens The number of hidden units per layer
+* @param hidden_layers The number of hidden layers
+* @param error_threshold Training error thresholds for each hidden layer
+* @param random_seed Random number seed
+* @returns The number of data samples loaded, or negative on error
+*/
+static int deeplearndata_load_mapping(deeplearndata_arena * arena,
+                                      deeplearn * learner,
+                                      int no_of_hiddens, int hidden_layers,
+                                      float error_threshold[],
+                                      unsigned int * random_seed)
+{
+    deeplearndata_file_header * header;
+    unsigned char * data;
+    const int32_t * field_length;
+    const float * ranges;
+    int i, s, slot, fields, outputs, no_of_inputs = 0;
+    int * index;
+
+    header = deeplearndata_file_check(arena);
+    if (header == NULL) {
+        deeplearndata_arena_unmap(arena);
+        return -2;
+    }
+    data = (unsigned char*)arena->mapping;
+    fields = header->no_of_input_fields;
+    outputs = header->no_of_outputs;
+    field_length = (const int32_t*)(data + header->fields_offset);
+    ranges = (const float*)(field_length + fields);
+
+    /* arena within the mapping */
+    arena->capacity = header->samples;
+    arena->samples = header->samples;
+    arena->no_of_input_fields = fields;
+    arena->no_of_outputs = outputs;
+    arena->inputs = (float*)(data + header->inputs_offset);
+    arena->outputs = (float*)(data + header->outputs_offset);
+    arena->sample =
+        (deeplearndata*)calloc(arena->samples, sizeof(deeplearndata));
+    index = (int*)malloc(arena->samples*sizeof(int));
+    if ((!arena->sample) || (!index)) {
+        free(index);
+        deeplearndata_arena_free(arena);
+        return -3;
+    }
+    if (header->text_row > 0) {
+        arena->text = (char*)(data + header->text_offset);
+        arena->text_row = (int)header->text_row;
+        arena->text_fields =
+            (char**)calloc(arena->samples*fields + 1, sizeof(char*));
+        if (!arena->text_fields) {
+            free(index);
+            deeplearndata_arena_free(arena);
+            return -3;
+        }
+    }
+    deeplearndata_arena_link(arena);
+
+    for (s = 0; s < arena->samples; s++) {
+        deeplearndata * sample = &arena->sample[s];
+
+        index[s] = s;
+        sample->labeled = 1;
+        for (i = 0; i < outputs; i++) {
+            if ((int)sample->outputs[i] == DEEPLEARN_UNKNOWN_VALUE) {
+                sample->labeled = 0;
+            }
+        }
+        if (arena->text == 0) {
+            continue;
+        }
+        sample->inputs_text = &arena->text_fields[s*fields];
+        for (i = 0, slot = 0; i < fields; i++) {
+            if (field_length[i] > 0) {
+                char * text = &arena->text[(size_t)s*header->text_row + slot];
+                slot += field_length[i]/CHAR_BITS + 1;
+                if ((slot > header->text_row) || (text[field_length[i]/CHAR_BITS] != 0)) {
+                    free(index);
+                    deeplearndata_arena_free(arena);
+                    return -2;
+                }
+                sample->inputs_text[i] = text;
+            }
+        }
+    }
+
+    /* create the deep learner */
+    for (i = 0; i < fields; i++) {
+        no_of_inputs += (field_length[i] < 1) ? 1 : field_length[i];
+    }
+    if (deeplearn_init(learner,
+                       no_of_inputs, no_of_hiddens,
+                       hidden_layers, outputs,
+                       error_threshold, random_seed) != 0) {
+        free(index);
+        deeplearndata_arena_free(arena);
+        return -4;
+    }
+
+    learner->no_of_input_fields = fields;
+    learner->field_length = (int*)malloc(fields*sizeof(int));
+    if (!learner->field_length) {
+        free(index);
+        deeplearndata_arena_free(arena);
+        return -3;
+    }
+    for (i = 0; i < fields; i++) {
+        learner->field_length[i] = (int)field_length[i];
+        learner->input_range_min[i] = ranges[i];
+        learner->input_range_max[i] = ranges[fields + i];
+    }
+    for (i = 0; i < outputs; i++) {
+        learner->output_range_min[i] = ranges[2*fields + i];
+        learner->output_range_max[i] = ranges[2*fields + outputs + i];
+    }
+
+    if (deeplearndata_arena_attach(learner, arena) != 0) {
+        free(index);
+        deeplearndata_arena_free(arena);
+        return -4;
+    }
+
+    /* the saved training and test sets */
+    if ((header->training_samples + header->test_samples > 0) &&
+        (deeplearndata_assign_datasets(learner,
+                                       index, header->training_samples,
+                                       &index[header->training_samples],
+                                       header->test_samples) != 0)) {
+        free(index);
+        return -5;
+    }
+    free(index);
+    return learner->data_samples;
+}
+
+/**
+* @brief Creates a deep learner from a binary dataset file written by
+*        deeplearndata_save. Where possible the file is memory mapped,
+*        so the samples are not copied or parsed, and the training and
+*        test sets are those which were saved.
+* @param filename Filename of the dataset file
+* @param learner Deep learner object
+* @param no_of_hiddens The number of hidden units per layer
+* @param hidden_layers The number of hidden layers
+* @param error_threshold Training error thresholds for each hidden layer
+* @param random_seed Random number seed
+* @returns The number of data samples loaded, or negative on error
+*/
+int deeplearndata_load_mmap(char * filename,
+                            deeplearn * learner,
+                            int no_of_hiddens, int hidden_layers,
+                            float error_threshold[],
+                            unsigned int * random_seed)
+{
+    deeplearndata_arena arena;
+
+    memset((void*)&arena, '\0', sizeof(deeplearndata_arena));
+    if (deeplearndata_file_open(filename, &arena) != 0) {
+        return -1;
+    }
+    return deeplearndata_load_mapping(&arena, learner,
+                                      no_of_hiddens, hidden_layers,
+                                      error_threshold, random_seed);
+}
+
+/**
+* @brief Creates a deep learner from a binary dataset which was published
+*        into named shared memory by shared_publish. The samples are used
+*        directly from the shared pages, so many worker processes using
+*        the same dataset hold a single copy of it.
+* @param name Name of the shared memory object
+* @param learner Deep learner object
+* @param no_of_hiddens The number of hidden units per layer
+* @param hidden_layers The number of hidden layers
+* @param error_threshold Training error thresholds for each hidden layer
+* @param random_seed Random number seed
+* @returns The number of data samples loaded, or negative on error
+*/
+int deeplearndata_attach(char * name,
+                         deeplearn * learner,
+                         int no_of_hiddens, int hidden_layers,
+                         float error_threshold[],
+                         unsigned int * random_seed)
+{
+#ifdef DEEPLEARNDATA_MMAP
+    deeplearndata_arena arena;
+    int fd;
+
+    memset((void*)&arena, '\0', sizeof(deeplearndata_arena));
+    fd = shared_open(name);
+    if (fd < 0) {
+        return -1;
+    }
+    if (deeplearndata_file_map(fd, &arena) != 0) {
+        return -1;
+    }
+    return deeplearndata_load_mapping(&arena, learner,
+                                      no_of_hiddens, hidden_layers,
+                                      error_threshold, random_seed);
+#else
+    return -1;
+#endif
+}
+
+/**
+* @brief Loads a data set from a csv file and creates a deep learner
+* @param filename csv filename
+* @param learner Deep learner object
+* @param no_of_hiddens The number of hidden units per layer
+* @param hidden layers The number of hidden layers
+* @param no_of_outputs The number of outputs
+* @param output_field_index Field numbers for the outputs within the csv file
+* @param output_classes The number of output classes if the output in the
+*        data set is a single integer value
+* @param error_threshold Training error thresholds for each hidden layer
+* @param random_seed Random number seed
+* @returns The number of data samples loaded
+*/
+int deeplearndata_read_csv(char * filename,
+                           deeplearn * learner,
+                           int no_of_hiddens, int hidden_layers,
+                           int no_of_outputs, int * output_field_index,
+                           int output_classes,
+                           float error_threshold[],
+                           unsigned int * random_seed)
+{
+    return deeplearndata_read_csv_chunked(filename, learner,
+                                          no_of_hiddens, hidden_layers,
+                                          no_of_outputs, output_field_index,
+                                          output_classes, error_threshold,
+                                          random_seed,
+                                          DEEPLEARNDATA_CSV_CHUNK_SIZE, 1);
+}
+
+/**
+* @brief Enables or disables epoch based training. When enabled, training
+*        steps take samples in order from the training set, which is
+*        shuffled at the start of each epoch, rather than picking samples
+*        at random.
+* @param learner Deep learner object
+* @param enabled Non-zero to train in epochs
+*/
+void deeplearndata_set_epochs(deeplearn * learner, unsigned char enabled)
+{
+    deeplearn_epoch_init(&learner->epoch, enabled);
+}
+
+/**
+* @brief Returns the number of completed training epochs
+* @param learner Deep learner object
+* @returns The number of epochs
+*/
+unsigned int deeplearndata_get_epochs(deeplearn * learner)
+{
+    return learner->epoch.epochs;
+}
+
+/**
+* @brief Returns the average training error over the last completed epoch
+* @param learner Deep learner object
+* @returns Training error, or DEEPLEARN_UNKNOWN_ERROR if no epoch has
+*          been completed
+*/
+float deeplearndata_get_epoch_error(deeplearn * learner)
+{
+    return learner->epoch.error;
+}
+
+/**
+* @brief Returns the index of the next training sample, which is either
+*        random or the next within the current epoch
+* @param learner Deep learner object
+* @param samples The number of samples wanted, returned as the number
+*        available, which may be less at the end of an epoch
+* @param set_size The number of samples within the set being trained on
+* @returns Index of the sample within the set. Within an epoch the
+*          samples which follow are consecutive.
+*/
+static int deeplearndata_next_index(deeplearn * learner, int * samples,
+                                    int set_size)
+{
+    int index;
+
+    if (learner->epoch.enabled == 0) {
+        return rand_num(&learner->net->random_seed)%set_size;
+    }
+
+    /* the set differs for each layer during pretraining */
+    if (deeplearn_epoch_start(&learner->epoch,
+                              learner->current_hidden_layer + 1,
+                              set_size) != 0) {
+        deeplearndata_shuffle_training(learner);
+    }
+    index = deeplearn_epoch_take(&learner->epoch, set_size, *samples);
+    if (*samples > set_size - index) {
+        *samples = set_size - index;
+    }
+    return index;
+}
+
+/**
+* @brief Records the training error within the current epoch
+* @param learner Deep learner object
+* @param samples The number of samples within the update
+* @param set_size The number of samples within the set being trained on
+*/
+static void deeplearndata_epoch_update(deeplearn * learner, int samples,
+                                       int set_size)
+{
+    if (learner->epoch.enabled != 0) {
+        deeplearn_epoch_update(&learner->epoch, learner->BPerror,
+                               samples, set_size);
+    }
+}
+
+/**
+* @brief Computes the outputs of the hidden layer below the one now
+*        being pretrained for every training sample. That layer is
+*        frozen, so its outputs only need to be computed once. If the
+*        outputs of the layer below it are cached then they are used as
+*        its inputs, otherwise each sample is encoded through all of the
+*        trained layers. The outputs are computed without dropouts or
+*        noise, as they are when the network is fed forward.
+* @param learner Deep learner object
+* @returns zero on success
+*/
+static int deeplearndata_activations_build(deeplearn * learner)
+{
+    deeplearn_activation_cache * cache = &learner->activations;
+    bp * net = learner->net;
+    int layer = learner->current_hidden_layer - 1;
+    int samples = learner->training_data_samples;
+    int i, width, buffer_size = net->NoOfInputs, failed = 0;
+    int previous = ((layer > 0) && (cache->layer == layer - 1));
+    float * values;
+
+    if ((layer < 0) || (layer >= net->HiddenLayers - 1) || (samples < 1)) {
+        deeplearn_activations_release(learner);
+        return 0;
+    }
+
+    width = learner->autocoder[layer]->NoOfHiddens;
+    for (i = 0; i < layer; i++) {
+        if (learner->autocoder[i]->NoOfHiddens > buffer_size) {
+            buffer_size = learner->autocoder[i]->NoOfHiddens;
+        }
+    }
+
+    values = (float*)malloc((size_t)samples*width*sizeof(float));
+    if (!values) {
+        return -1;
+    }
+    DEEPLEARN_STATS_ALLOC((size_t)samples*width*sizeof(float));
+
+#pragma omp parallel num_threads(threads_count()) if (samples > 1) reduction(+:failed)
+    {
+        float * buffer = (float*)malloc(2*buffer_size*sizeof(float));
+
+#pragma omp for schedule(static)
+        for (int s = 0; s < samples; s++) {
+            deeplearndata * sample = deeplearndata_get_training(learner, s);
+            const float * layer_inputs;
+            int l = 0, b = 0;
+
+            if ((buffer == 0) || (sample == 0)) {
+                failed++;
+                continue;
+            }
+            if (previous != 0) {
+                layer_inputs = sample->activations;
+                l = layer;
+            }
+            else {
+                deeplearn_encode_inputs(learner, sample, buffer);
+                layer_inputs = buffer;
+            }
+
+            /* through the trained layers below */
+            for (; l < layer; l++) {
+                b = 1 - b;
+                autocoder_encode_inputs(learner->autocoder[l], layer_inputs,
+                                        &buffer[b*buffer_size]);
+                layer_inputs = &buffer[b*buffer_size];
+            }
+            autocoder_encode_inputs(learner->autocoder[layer], layer_inputs,
+                                    &values[(size_t)s*width]);
+        }
+        free(buffer);
+    }
+
+    if (failed > 0) {
+        free(values);
+        return -2;
+    }
+
+    deeplearn_activations_release(learner);
+    cache->values = values;
+    cache->layer = layer;
+    cache->samples = samples;
+    cache->width = width;
+    for (i = 0; i < samples; i++) {
+        deeplearndata_get_training(learner, i)->activations =
+            &values[(size_t)i*width];
+    }
+    return 0;
+}
+
+/**
+* @brief Updates the activation cache after pretraining, if the hidden
+*        layer being pretrained has moved on
+* @param learner Deep learner object
+* @param layer The hidden layer being pretrained before the update
+* @returns zero on success
+*/
+static int deeplearndata_activations_update(deeplearn * learner, int layer)
+{
+    if ((learner->activations.enabled == 0) ||
+        (learner->current_hidden_layer == layer)) {
+        return 0;
+    }
+    return deeplearndata_activations_build(learner);
+}
+
+/**
+* @brief Performs a single training step using a sample encoded by the
+*        prefetch workers. The queue is kept full of requests for the
+*        samples which follow, picked in the same way as without
+*        prefetching. Samples requested for a different training phase
+*        are discarded.
+* @param learner Deep learner object
+* @param labeled Non-zero if training on the labeled training set
+* @param set_size The number of samples within the set being trained on
+* @returns zero on success
+*/
+static int deeplearndata_prefetch_training(deeplearn * learner,
+                                           int labeled, int set_size)
+{
+    deeplearn_sample_prefetch * prefetch = &learner->prefetch;
+    deeplearn_prefetch_slot * slot;
+    bp * net = learner->net;
+    int i, phase = learner->current_hidden_layer + 1;
+
+    if (set_size < 1) {
+        return -1;
+    }
+    deeplearn_update_prefetch(learner);
+
+    do {
+        /* request the samples which follow */
+        while ((slot = deeplearn_prefetch_request(&prefetch->queue)) != 0) {
+            int samples = 1;
+            slot->position =
+                deeplearndata_next_index(learner, &samples, set_size);
+            if (labeled != 0) {
+                slot->sample =
+                    deeplearndata_get_training_labeled(learner,
+                                                       slot->position);
+            }
+            else {
+                slot->sample =
+                    deeplearndata_get_training(learner, slot->position);
+            }
+            slot->tag = phase;
+            deeplearn_prefetch_submit(&prefetch->queue);
+        }
+
+        slot = deeplearn_prefetch_next(&prefetch->queue);
+        if (slot == 0) {
+            return -2;
+        }
+        if (slot->retval != 0) {
+            deeplearn_prefetch_release(&prefetch->queue);
+            return -3;
+        }
+        if (slot->tag != phase) {
+            deeplearn_prefetch_release(&prefetch->queue);
+            slot = 0;
+        }
+    } while (slot == 0);
+
+    for (i = 0; i < net->NoOfInputs; i++) {
+        if (prefetch->input_set[i] != 0) {
+            net->inputs[i]->value = slot->inputs[i];
+        }
+    }
+    if (labeled != 0) {
+        for (i = 0; i < net->NoOfOutputs; i++) {
+            if (prefetch->output_set[i] != 0) {
+                net->outputs[i]->desiredValue = slot->targets[i];
+            }
+        }
+    }
+    deeplearn_update(learner);
+
+    /* the epoch position runs ahead by the samples which are pending */
+    if (learner->epoch.enabled != 0) {
+        deeplearn_epoch_record(&learner->epoch, learner->BPerror, 1);
+        if (slot->position == set_size - 1) {
+            deeplearn_epoch_complete(&learner->epoch);
+        }
+    }
+    deeplearn_prefetch_release(&prefetch->queue);
+    return 0;
+}
+
+/**
+* @brief Performs a single training step on the next sample from a stream.
+*        The data ranges are widened as each sample arrives.  Unlabeled
+*        samples are skipped once pretraining is complete.
+* @param learner Deep learner object
+* @returns 1=pretraining,2=final training,0=training complete,
+*          -5=the stream ended or failed
+*/
+static int deeplearndata_stream_training(deeplearn * learner)
+{
+    deeplearn_stream * stream = learner->stream;
+    int layer = learner->current_hidden_layer;
+    int pretraining = ((learner->net->HiddenLayers > 1) &&
+                       (layer < learner->net->HiddenLayers));
+    deeplearndata sample;
+
+    if ((pretraining == 0) && (learner->training_complete != 0)) {
+        return 0;
+    }
+    if (deeplearn_stream_next(stream) < 0) {
+        return -5;
+    }
+
+    memset((void*)&sample, '\0', sizeof(deeplearndata));
+    sample.inputs = deeplearn_stream_inputs(stream, stream->current);
+    sample.inputs_text = deeplearn_stream_inputs_text(stream, stream->current);
+    sample.outputs = deeplearn_stream_outputs(stream, stream->current);
+    sample.labeled =
+        deeplearndata_update_ranges(sample.inputs, sample.outputs,
+                                    learner->no_of_input_fields,
+                                    learner->net->NoOfOutputs,
+                                    learner->input_range_min,
+                                    learner->input_range_max,
+                                    learner->output_range_min,
+                                    learner->output_range_max);
+
+    deeplearn_set_inputs(learner, &sample);
+    if (pretraining != 0) {
+        deeplearn_update(learner);
+        return 1;
+    }
+    if (sample.labeled != 0) {
+        deeplearn_set_outputs(learner, &sample);
+        deeplearn_update(learner);
+    }
+    return 2;
+}
+
+/**
+* @brief Trains from a stream of samples, such as a file which is too
+*        large to be held in memory, rather than from the data set of the
+*        learner.  Performance is still measured on any test samples.
+* @param learner Deep learner object
+* @param stream Stream of samples, or NULL to train on the data set
+* @returns zero on success
+*/
+int deeplearndata_set_stream(deeplearn * learner, deeplearn_stream * stream)
+{
+    if ((stream != 0) &&
+        ((stream->batch.inputs == 0) ||
+         (stream->batch.no_of_input_fields != learner->no_of_input_fields) ||
+         (stream->batch.no_of_outputs != learner->net->NoOfOutputs))) {
+        return -1;
+    }
+    learner->stream = stream;
+    return 0;
+}
+
+/**
+* @brief Creates a deep learner which trains from a stream of samples.
+*        The first batch is read in order to find the field lengths and
+*        data ranges, and is then used for training.  Text longer than
+*        the field lengths found from the first batch is truncated.
+* @param stream Stream of samples
+* @param learner Deep learner object
+* @param no_of_hiddens The number of hidden units per layer
+* @param hidden_layers The number of hidden layers
+* @param error_threshold Training error thresholds for each hidden layer
+* @param random_seed Random number seed
+* @returns The number of samples within the first batch, or a negative
+*          value on error
+*/
+int deeplearndata_read_stream(deeplearn_stream * stream,
+                              deeplearn * learner,
+                              int no_of_hiddens, int hidden_layers,
+                              float error_threshold[],
+                              unsigned int * random_seed)
+{
+    deeplearn_stream_batch * batch = &stream->batch;
+    int i, b, no_of_inputs = 0;
+    int fields = batch->no_of_input_fields;
+    int * field_length;
+
+    if (batch->inputs == 0) {
+        return -1;
+    }
+    if (deeplearn_stream_next(stream) < 0) {
+        return -2;
+    }
+
+    field_length = (int*)calloc(fields, sizeof(int));
+    if (!field_length) {
+        return -3;
+    }
+    for (b = 0; b < batch->samples; b++) {
+        no_of_inputs =
+            deeplearndata_grow_field_lengths(fields, field_length,
+                                             deeplearn_stream_inputs_text(stream, b));
+    }
+
+    if (deeplearn_init(learner,
+                       no_of_inputs, no_of_hiddens,
+                       hidden_layers, batch->no_of_outputs,
+                       error_threshold, random_seed) != 0) {
+        free(field_length);
+        return -4;
+    }
+    learner->no_of_input_fields = fields;
+    learner->field_length = field_length;
+
+    for (b = 0; b < batch->samples; b++) {
+        deeplearndata_update_ranges(deeplearn_stream_inputs(stream, b),
+                                    deeplearn_stream_outputs(stream, b),
+                                    fields, batch->no_of_outputs,
+                                    learner->input_range_min,
+                                    learner->input_range_max,
+                                    learner->output_range_min,
+                                    learner->output_range_max);
+    }
+    for (i = 0; i < fields; i++) {
+        if (field_length[i] > 0) {
+            learner->input_range_min[i] = 0.25f;
+            learner->input_range_max[i] = 0.75f;
+        }
+    }
+
+    /* train from the start of the first batch */
+    stream->current = -1;
+    stream->samples = 0;
+    learner->stream = stream;
+    return batch->samples;
+}
+
+/**
+* @brief Performs a single training step
+* @param learner Deep learner object
+* @returns 1=pretraining,2=final training,0=training complete,-1=no training data,
+*          -2=the sample cache could not be built,-3=prefetch failed,
+*          -4=the activation cache could not be built,
+*          -5=the stream of samples ended or failed
+*/
+int deeplearndata_training(deeplearn * learner)
+{
+    int samples = 1;
+
+    if ((learner->training_data_samples == 0) && (learner->stream == 0)) {
+        return -1;
+    }
+
+    /* encode the samples again if the ranges have changed */
+    if (deeplearn_cache_update(learner) != 0) {
+        return -2;
+    }
+
+    /* plot a graph showing training progress */
+    if (learner->training_ctr > learner->history_plot_interval) {
+        if (strlen(learner->history_plot_filename) > 0) {
+            deeplearn_plot_training_history(learner, 1024, 480);
+        }
+        learner->training_ctr = 0;
+    }
+    learner->training_ctr++;
+
+    if (learner->stream != 0) {
+        return deeplearndata_stream_training(learner);
+    }
+
+    int layer = learner->current_hidden_layer;
+    int pretraining = ((learner->net->HiddenLayers > 1) &&
+                       (layer < learner->net->HiddenLayers));
+
+    /* cached layer outputs take the place of prefetched inputs */
+    if ((learner->prefetch.enabled != 0) &&
+        ((pretraining == 0) || (deeplearn_activations_current(learner) == 0))) {
+        if (pretraining != 0) {
+            if (deeplearndata_prefetch_training(learner, 0,
+                                                learner->training_data_samples) != 0) {
+                return -3;
+            }
+            if (deeplearndata_activations_update(learner, layer) != 0) {
+                return -4;
+            }
+            return 1;
+        }
+        if (learner->training_complete == 0) {
+            if (deeplearndata_prefetch_training(learner, 1,
+                                                learner->training_data_labeled_samples) != 0) {
+                return -3;
+            }
+            return 2;
+        }
+        return 0;
+    }
+
+    if (pretraining != 0) {
+        /* index number of the next training sample */
+        int index =
+            deeplearndata_next_index(learner, &samples,
+                                     learner->training_data_samples);
+        /* get the sample */
+        deeplearndata * sample = deeplearndata_get_training(learner, index);
+        if ((sample->activations != 0) &&
+            (deeplearn_activations_current(learner) != 0)) {
+            deeplearn_update_activations(learner, sample->activations);
+        }
+        else {
+            deeplearn_set_inputs(learner, sample);
+            deeplearn_update(learner);
+        }
+        deeplearndata_epoch_update(learner, samples,
+                                   learner->training_data_samples);
+        if (deeplearndata_activations_update(learner, layer) != 0) {
+            return -4;
+        }
+        return 1;
+    }
+    if (learner->training_complete == 0) {
+        /* index number of the next labeled training sample */
+        int index =
+            deeplearndata_next_index(learner, &samples,
+                                     learner->training_data_labeled_samples);
+        /* get the sample */
+        deeplearndata * sample = deeplearndata_get_training_labeled(learner, index);
+        deeplearn_set_inputs(learner, sample);
+        deeplearn_set_outputs(learner, sample);
+        deeplearn_update(learner);
+        deeplearndata_epoch_update(learner, samples,
+                                   learner->training_data_labeled_samples);
+        return 2;
+    }
+    return 0;
+}
+
+/**
+* @brief Performs training using a mini-batch of samples, selected at
+*        random or taken in order when training in epochs
+* @param learner Deep learner object
+* @param batch_size The number of samples within each batch
+* @returns Zero if training is complete, 1 if pretraining, 2 if training
+*          the whole network or a negative value on error
+*/
+int deeplearndata_training_batch(deeplearn * learner, int batch_size)
+{
+    int b, index, retval, set_size;
+    int layer = learner->current_hidden_layer;
+    deeplearndata ** batch;
+
+    if (learner->training_data_samples == 0) {
+        return -1;
+    }
+    if (batch_size < 1) {
+        return -2;
+    }
+    if (deeplearn_cache_update(learner) != 0) {
+        return -6;
+    }
+
+    /* plot a graph showing training progress */
+    if (learner->training_ctr > learner->history_plot_interval) {
+        if (strlen(learner->history_plot_filename) > 0) {
+            deeplearn_plot_training_history(learner, 1024, 480);
+        }
+        learner->training_ctr = 0;
     }
+    learner->training_ctr += batch_size;
 
-    /* create the indexed array for fast access */
-    deeplearndata_index_meta(learner->training_data, learner->training_data_samples, &learner->indexed_training_data, &learner->indexed_training_data_samples);
-    deeplearndata_index_meta(learner->training_data_labeled, learner->training_data_labeled_samples, &learner->indexed_training_data_labeled, &learner->indexed_training_data_labeled_samples);
+    if ((learner->net->HiddenLayers > 1) &&
+        (learner->current_hidden_layer < learner->net->HiddenLayers)) {
+        retval = 1;
+    }
+    else if (learner->training_complete == 0) {
+        retval = 2;
+        if (learner->training_data_labeled_samples == 0) {
+            return -3;
+        }
+    }
+    else {
+        return 0;
+    }
 
-    /* create test samples */
-    sample = learner->data;
-    while (sample != 0) {
-        if (sample->flags == 0) {
-            if (sample->labeled != 0) {
-                retval =
-                    deeplearndata_add_test_sample(learner, sample);
-                if (retval != 0) {
-                    return -400 + retval;
-                }
+    batch = (deeplearndata**)malloc(batch_size*sizeof(deeplearndata*));
+    if (!batch) {
+        return -4;
+    }
+    DEEPLEARN_STATS_ALLOC(batch_size*sizeof(deeplearndata*));
+
+    set_size = learner->training_data_labeled_samples;
+    if (retval == 1) {
+        set_size = learner->training_data_samples;
+    }
+
+    if (learner->epoch.enabled != 0) {
+        /* consecutive samples within the current epoch */
+        index = deeplearndata_next_index(learner, &batch_size, set_size);
+        for (b = 0; b < batch_size; b++) {
+            if (retval == 1) {
+                batch[b] = deeplearndata_get_training(learner, index + b);
             }
             else {
-                retval =
-                    deeplearndata_add_training_sample(learner, sample);
-                if (retval != 0) {
-                    return -500 + retval;
-                }
+                batch[b] = deeplearndata_get_training_labeled(learner, index + b);
+            }
+        }
+    }
+    else {
+        /* pick random samples for the batch */
+        for (b = 0; b < batch_size; b++) {
+            if (retval == 1) {
+                index = rand_num(&learner->net->random_seed)%learner->training_data_samples;
+                batch[b] = deeplearndata_get_training(learner, index);
+            }
+            else {
+                index = rand_num(&learner->net->random_seed)%learner->training_data_labeled_samples;
+                batch[b] = deeplearndata_get_training_labeled(learner, index);
             }
         }
-        sample = (deeplearndata*)sample->next;
     }
 
-    /* create the indexed array for fast access */
-    deeplearndata_index_meta(learner->test_data, learner->test_data_samples, &learner->indexed_test_data, &learner->indexed_test_data_samples);
-
-    return 0;
+    if (deeplearn_update_batch(learner, batch, batch_size) != 0) {
+        retval = -5;
+    }
+    else {
+        deeplearndata_epoch_update(learner, batch_size, set_size);
+        if ((retval == 1) &&
+            (deeplearndata_activations_update(learner, layer) != 0)) {
+            retval = -7;
+        }
+    }
+    free(batch);
+    return retval;
 }
 
 /**
-* @brief Loads a data set from a csv file and creates a deep learner
-* @param filename csv filename
+* @brief Performs training on a number of samples using several threads
+*        which update the shared weights without locks (Hogwild).
+*        Samples are selected at random, or taken in order when training
+*        in epochs, and encoded in parallel. Pretraining of autocoders
+*        is sequential, so is done as with deeplearndata_training_batch.
+*        As with deeplearn_update_hogwild this is not available while
+*        classifier heads are enabled.
 * @param learner Deep learner object
-* @param no_of_hiddens The number of hidden units per layer
-* @param hidden layers The number of hidden layers
-* @param no_of_outputs The number of outputs
-* @param output_field_index Field numbers for the outputs within the csv file
-* @param output_classes The number of output classes if the output in the
-*        data set is a single integer value
-* @param error_threshold Training error thresholds for each hidden layer
-* @param random_seed Random number seed
-* @returns The number of data samples loaded
+* @param no_of_samples The number of samples to train on
+* @param no_of_threads The number of threads, or zero to use the
+*        number given by threads_count
+* @returns Zero if training is complete, 1 if pretraining, 2 if training
+*          the whole network or a negative value on error
 */
-int deeplearndata_read_csv(char * filename,
-                           deeplearn * learner,
-                           int no_of_hiddens, int hidden_layers,
-                           int no_of_outputs, int * output_field_index,
-                           int output_classes,
-                           float error_threshold[],
-                           unsigned int * random_seed)
+int deeplearndata_training_hogwild(deeplearn * learner, int no_of_samples,
+                                   int no_of_threads)
 {
-    int i, j, k, field_number, input_index, ctr, samples_loaded = 0;
-    FILE * fp;
-    char line[2000],valuestr[DEEPLEARN_MAX_FIELD_LENGTH_CHARS],*retval;
-    float value;
-    int data_set_index = 0;
-    int no_of_inputs = 0;
-    int no_of_input_fields = 0;
-    float inputs[DEEPLEARN_MAX_CSV_INPUTS];
-    char* inputs_text[DEEPLEARN_MAX_CSV_INPUTS];
-    float outputs[DEEPLEARN_MAX_CSV_OUTPUTS];
-    int fields_per_example = 0;
-    int network_outputs = no_of_outputs;
-    int is_text;
-    deeplearndata * data = 0;
-    int data_samples = 0;
-    float input_range_min[DEEPLEARN_MAX_CSV_INPUTS];
-    float input_range_max[DEEPLEARN_MAX_CSV_INPUTS];
-    float output_range_min[DEEPLEARN_MAX_CSV_OUTPUTS];
-    float output_range_max[DEEPLEARN_MAX_CSV_OUTPUTS];
-    int field_length[DEEPLEARN_MAX_CSV_INPUTS];
+    int s, index, set_size, cached, retval = 2;
+    int no_of_inputs = learner->net->NoOfInputs;
+    int no_of_outputs = learner->net->NoOfOutputs;
+    int * indexes;
+    float * inputs, * targets;
 
-    for (i = 0; i < DEEPLEARN_MAX_CSV_INPUTS; i++) {
-        input_range_min[i] = 9999;
-        input_range_max[i] = -9999;
-        inputs_text[i] = 0;
+    if (learner->training_data_samples == 0) {
+        return -1;
     }
-    for (i = 0; i < DEEPLEARN_MAX_CSV_OUTPUTS; i++) {
-        output_range_min[i] = 9999;
-        output_range_max[i] = -9999;
+    if ((no_of_samples < 1) || (no_of_threads < 0)) {
+        return -2;
     }
-
-    if (output_classes > 0) {
-        network_outputs = output_classes;
+    if (learner->exits.no_of_heads > 0) {
+        return -6;
+    }
+    if ((learner->net->HiddenLayers > 1) &&
+        (learner->current_hidden_layer < learner->net->HiddenLayers)) {
+        return deeplearndata_training_batch(learner, no_of_samples);
+    }
+    if (learner->training_complete != 0) {
+        return 0;
     }
-    for (i = 0; i < network_outputs; i++) {
-        outputs[i] = DEEPLEARN_UNKNOWN_VALUE;
+    set_size = learner->training_data_labeled_samples;
+    if (set_size == 0) {
+        return -3;
     }
 
-    fp = fopen(filename,"r");
-    if (!fp) return -1;
-
-    while (!feof(fp)) {
-        retval = fgets(line,1999,fp);
-        if (retval) {
-            if (strlen(line)>0) {
-                if ((line[0]!='"') && (line[0]!='#')) {
-                    field_number = 0;
-                    input_index = 0;
-                    ctr = 0;
-                    for (i = 0; i < strlen(line); i++) {
-                        if ((line[i]==',') || (line[i]==';') ||
-                            (i==strlen(line)-1)) {
-                            if (i==strlen(line)-1) {
-                                if (ctr < DEEPLEARN_MAX_FIELD_LENGTH_CHARS-1) {
-                                    valuestr[ctr++]=line[i];
-                                }
-                            }
-                            valuestr[ctr]=0;
-                            ctr=0;
-
-                            /* get the value from the string */
-                            value = 0;
-                            is_text = 0;
-                            if ((valuestr[0]!='?') && (valuestr[0]!=10)) {
-                                /* positive numbers*/
-                                if (((valuestr[0]>='0') &&
-                                     (valuestr[0]<='9')) ||
-                                    /* negative numbers*/
-                                    ((valuestr[0]=='-') &&
-                                     (valuestr[1]>='0') &&
-                                     (valuestr[1]<='9'))) {
-                                    value = atof(valuestr);
-                                }
-                                else {
-                                    is_text = 1;
-                                }
-                            }
-
-                            for (j = 0; j < no_of_outputs; j++) {
-                                if (field_number == output_field_index[j]) {
-                                    if (j < DEEPLEARN_MAX_CSV_OUTPUTS-1) {
-                                        if (output_classes <= 0) {
-                                            outputs[j] = value;
-                                        }
-                                        else {
-                                            /* for a class number */
-                                            for (k = 0; k < network_outputs; k++) {
-                                                if (k != (int)value) {
-                                                    outputs[k] = 0.25f;
-                                                }
-                                                else {
-                                                    outputs[k] = 0.75f;
-                                                }
-                                            }
-                                        }
-                                        break;
-                                    }
-                                }
-                            }
-                            if ((j == no_of_outputs) && (input_index < DEEPLEARN_MAX_CSV_INPUTS-1)) {
-                                inputs_text[input_index] = 0;
-                                if (is_text != 0) {
-                                    /* allocate some memory for the string */
-                                    inputs_text[input_index] =
-                                        (char*)malloc((strlen(valuestr)+1)*sizeof(char));
-                                    /* copy it */
-                                    strcpy(inputs_text[input_index],(char*)valuestr);
-                                }
-                                inputs[input_index++] = value;
-                            }
-
-                            field_number++;
-                            data_set_index++;
-                        }
-                        else {
-                            /* update the value string */
-                            if (ctr < DEEPLEARN_MAX_FIELD_LENGTH_CHARS-1) {
-                                valuestr[ctr++] = line[i];
-                            }
-                        }
-                    }
-                    if (fields_per_example == 0) {
-                        fields_per_example = field_number;
-                    }
-                    if (samples_loaded == 0) {
-                        no_of_input_fields = input_index;
-                    }
-                    /* add a data sample */
-                    if (deeplearndata_add(&data,
-                                          &data_samples,
-                                          inputs, inputs_text,
-                                          outputs,
-                                          no_of_input_fields,
-                                          network_outputs,
-                                          input_range_min,
-                                          input_range_max,
-                                          output_range_min,
-                                          output_range_max) != 0) {
-                        fclose(fp);
-                        return -2;
-                    }
-                    /* free memory for any text strings */
-                    for (i = 0; i < no_of_input_fields; i++) {
-                        if (inputs_text[i] != 0) {
-                            free(inputs_text[i]);
-                            inputs_text[i] = 0;
-                        }
-                    }
-                    for (i = 0; i < network_outputs; i++) {
-                        outputs[i] = DEEPLEARN_UNKNOWN_VALUE;
-                    }
-                    samples_loaded++;
+    /* encodings within the cache are only used if they are current */
+    cached = ((deeplearn_cache_update(learner) == 0) &&
+              (learner->cache.enabled != 0) && (learner->cache.valid != 0));
+
+    /* plot a graph showing training progress */
+    if (learner->training_ctr > learner->history_plot_interval) {
+        if (strlen(learner->history_plot_filename) > 0) {
+            deeplearn_plot_training_history(learner, 1024, 480);
+        }
+        learner->training_ctr = 0;
+    }
+
+    indexes = (int*)malloc(no_of_samples*sizeof(int));
+    if (!indexes) {
+        return -4;
+    }
+    inputs = (float*)malloc((size_t)no_of_samples*no_of_inputs*sizeof(float));
+    if (!inputs) {
+        free(indexes);
+        return -4;
+    }
+    targets = (float*)malloc((size_t)no_of_samples*no_of_outputs*sizeof(float));
+    if (!targets) {
+        free(indexes);
+        free(inputs);
+        return -4;
+    }
+    DEEPLEARN_STATS_ALLOC(no_of_samples*sizeof(int));
+    DEEPLEARN_STATS_ALLOC((size_t)no_of_samples*no_of_inputs*sizeof(float));
+    DEEPLEARN_STATS_ALLOC((size_t)no_of_samples*no_of_outputs*sizeof(float));
+
+    if (learner->epoch.enabled != 0) {
+        /* consecutive samples within the current epoch */
+        index = deeplearndata_next_index(learner, &no_of_samples, set_size);
+        for (s = 0; s < no_of_samples; s++) {
+            indexes[s] = index + s;
+        }
+    }
+    else {
+        for (s = 0; s < no_of_samples; s++) {
+            indexes[s] = rand_num(&learner->net->random_seed)%set_size;
+        }
+    }
+    learner->training_ctr += no_of_samples;
+
+#pragma omp parallel for num_threads(threads_count()) schedule(static) if (no_of_samples > 1)
+    for (s = 0; s < no_of_samples; s++) {
+        deeplearndata * sample =
+            deeplearndata_get_training_labeled(learner, indexes[s]);
+        float * encoded = &inputs[(size_t)s*no_of_inputs];
+        float * desired = &targets[(size_t)s*no_of_outputs];
+        int i;
+
+        deeplearn_encode_inputs(learner, sample, encoded);
+        deeplearn_encode_outputs(learner, sample, desired);
+        if (cached == 0) continue;
+        if (sample->encoded_inputs != 0) {
+            for (i = 0; i < no_of_inputs; i++) {
+                if (learner->cache.input_set[i] != 0) {
+                    encoded[i] = sample->encoded_inputs[i];
+                }
+            }
+        }
+        if (sample->encoded_outputs != 0) {
+            for (i = 0; i < no_of_outputs; i++) {
+                if (learner->cache.output_set[i] != 0) {
+                    desired[i] = sample->encoded_outputs[i];
                 }
             }
         }
     }
 
-    fclose(fp);
+    if (deeplearn_update_hogwild(learner, inputs, targets,
+                                 no_of_samples, no_of_threads) != 0) {
+        retval = -5;
+    }
+    else {
+        deeplearndata_epoch_update(learner, no_of_samples, set_size);
+    }
+    free(indexes);
+    free(inputs);
+    free(targets);
+    return retval;
+}
 
-    /* calculate field lengths */
-    no_of_inputs =
-        deeplearndata_update_field_lengths(no_of_input_fields,
-                                           field_length, data);
+/**
+* @brief Feeds forward a batch of test samples using the given inference
+*        context, returning outputs within their normal range
+* @param learner Deep learner object
+* @param ctx Inference context owned by the calling thread
+* @param sample Test samples within the batch
+* @param batch_size The number of samples within the batch
+* @param cached Non-zero if encoded inputs may be taken from the cache
+* @param inputs Scratch buffer for the encoded inputs of the batch
+* @param outputs Returned outputs, NoOfOutputs values per sample
+* @returns zero on success
+*/
+static int deeplearndata_performance_batch(deeplearn * learner,
+                                           bp_inference * ctx,
+                                           deeplearndata ** sample,
+                                           int batch_size,
+                                           int cached,
+                                           float * inputs,
+                                           float * outputs)
+{
+    int b, i, no_of_inputs = learner->net->NoOfInputs;
+    int no_of_outputs = learner->net->NoOfOutputs;
+    float range;
+
+    for (b = 0; b < batch_size; b++) {
+        float * encoded = &inputs[b*no_of_inputs];
+        if ((cached != 0) && (sample[b]->encoded_inputs != 0)) {
+            for (i = 0; i < no_of_inputs; i++) {
+                encoded[i] = (learner->cache.input_set[i] != 0) ?
+                    sample[b]->encoded_inputs[i] :
+                    learner->net->inputs[i]->value;
+            }
+        }
+        else {
+            deeplearn_encode_inputs(learner, sample[b], encoded);
+        }
+    }
 
-    /* create the deep learner */
-    deeplearn_init(learner,
-                   no_of_inputs, no_of_hiddens,
-                   hidden_layers, network_outputs,
-                   error_threshold, random_seed);
+    if (bp_infer(bp_replicas_local(&learner->replicas, learner->net),
+                 ctx, inputs, outputs, batch_size) != 0) {
+        return -1;
+    }
 
-    /* set the input fields */
-    learner->no_of_input_fields = no_of_input_fields;
-    learner->field_length = (int*)malloc(no_of_input_fields*sizeof(int));
-    for (i = 0; i < no_of_input_fields; i++) {
-        learner->field_length[i] = field_length[i];
-        if (field_length[i] > 0) {
-            input_range_min[i] = 0.25f;
-            input_range_max[i] = 0.75f;
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_outputs; i++) {
+            range = learner->output_range_max[i] - learner->output_range_min[i];
+            if (range > 0) {
+                outputs[b*no_of_outputs + i] =
+                    (((outputs[b*no_of_outputs + i] - 0.25f)/0.5f)*range) +
+                    learner->output_range_min[i];
+            }
         }
     }
+    return 0;
+}
 
-    /* attach the data samples */
-    learner->data = data;
-    learner->data_samples = data_samples;
-
-    /* create the indexed array for fast access */
-    deeplearndata_index_data(learner->data, learner->data_samples, &learner->indexed_data, &learner->indexed_data_samples);
+/* state shared by the tasks which evaluate batches of test samples,
+   with an inference context and input buffer for each worker */
+typedef struct {
+    deeplearn * learner;
+    deeplearndata ** sample;
+    int samples, cached;
+    float * outputs;
+    bp_inference * ctx;
+    float ** inputs;
+    int * ready;
+    int * failed;
+} deeplearndata_performance_state;
 
-    /* set the field ranges */
-    for (i = 0; i < no_of_input_fields; i++) {
-        learner->input_range_min[i] = input_range_min[i];
-        learner->input_range_max[i] = input_range_max[i];
-    }
-    for (i = 0; i < network_outputs; i++) {
-        learner->output_range_min[i] = output_range_min[i];
-        learner->output_range_max[i] = output_range_max[i];
+/**
+* @brief Evaluates one batch of test samples.  The inference context of
+*        the worker is created on first use, so that its memory is
+*        allocated by the thread which uses it.
+* @param data Shared state of type deeplearndata_performance_state
+* @param index Index of the batch
+* @param worker Index of the worker running the task
+*/
+static void deeplearndata_performance_task(void * data, int index, int worker)
+{
+    deeplearndata_performance_state * state =
+        (deeplearndata_performance_state*)data;
+    deeplearn * learner = state->learner;
+    int no_of_outputs = learner->net->NoOfOutputs;
+    int start = index*DEEPLEARNDATA_PERFORMANCE_BATCH;
+    int batch_size = state->samples - start;
+
+    if (batch_size > DEEPLEARNDATA_PERFORMANCE_BATCH) {
+        batch_size = DEEPLEARNDATA_PERFORMANCE_BATCH;
     }
 
-    /* create training and test data sets */
-    if (deeplearndata_create_datasets(learner, 20) != 0) {
-        return -3;
+    if (state->ready[worker] == 0) {
+        state->inputs[worker] =
+            (float*)malloc(DEEPLEARNDATA_PERFORMANCE_BATCH*
+                           learner->net->NoOfInputs*sizeof(float));
+        if ((state->inputs[worker] != 0) &&
+            (bp_inference_init(&state->ctx[worker], learner->net,
+                               DEEPLEARNDATA_PERFORMANCE_BATCH) == 0)) {
+            state->ready[worker] = 1;
+        }
+        else {
+            state->ready[worker] = -1;
+        }
     }
 
-    return samples_loaded;
+    if ((state->ready[worker] != 1) ||
+        (deeplearndata_performance_batch(learner, &state->ctx[worker],
+                                         &state->sample[start],
+                                         batch_size, state->cached,
+                                         state->inputs[worker],
+                                         &state->outputs[start*no_of_outputs]) != 0)) {
+        state->failed[worker]++;
+    }
 }
 
 /**
-* @brief Performs a single training step
+* @brief Returns the performance on the given test samples as a
+*        percentage value. Batches of samples are evaluated in parallel
+*        by threads_run, each worker having its own inference context,
+*        and the errors are then summed in sample order so that the
+*        result does not depend upon the number of threads.
 * @param learner Deep learner object
-* @returns 1=pretraining,2=final training,0=training complete,-1=no training data
+* @param sample Array of test samples
+* @param samples The number of test samples
+* @return Performance in the range 0 to 100%, or -1 on error
 */
-int deeplearndata_training(deeplearn * learner)
+static float deeplearndata_performance(deeplearn * learner,
+                                       deeplearndata ** sample,
+                                       int samples)
 {
-    if (learner->training_data_samples == 0) {
-        return -1;
+    int index, i, hits = 0, failed = 0;
+    int no_of_outputs = learner->net->NoOfOutputs;
+    int batches = (samples + DEEPLEARNDATA_PERFORMANCE_BATCH - 1) /
+        DEEPLEARNDATA_PERFORMANCE_BATCH;
+    int workers = threads_workers();
+    float error_percent, total_error = 0, average_error;
+    float * outputs;
+    deeplearndata_performance_state state;
+
+    if (samples < 1) {
+        return 0;
     }
 
-    /* plot a graph showing training progress */
-    if (learner->training_ctr > learner->history_plot_interval) {
-        if (strlen(learner->history_plot_filename) > 0) {
-            deeplearn_plot_history(learner,
-                                   learner->history_plot_filename,
-                                   learner->history_plot_title,
-                                   1024, 480);
+    /* encodings within the cache are only used if they are current */
+    state.cached = ((deeplearn_cache_update(learner) == 0) &&
+                    (learner->cache.enabled != 0) &&
+                    (learner->cache.valid != 0));
+
+    outputs = (float*)malloc(samples*no_of_outputs*sizeof(float));
+    if (!outputs) {
+        return -1;
+    }
+    DEEPLEARN_STATS_ALLOC(samples*no_of_outputs*sizeof(float));
+
+    state.learner = learner;
+    state.sample = sample;
+    state.samples = samples;
+    state.outputs = outputs;
+    state.ctx = (bp_inference*)calloc(workers, sizeof(bp_inference));
+    state.inputs = (float**)calloc(workers, sizeof(float*));
+    state.ready = (int*)calloc(workers, sizeof(int));
+    state.failed = (int*)calloc(workers, sizeof(int));
+
+    if ((!state.ctx) || (!state.inputs) ||
+        (!state.ready) || (!state.failed)) {
+        failed = 1;
+    }
+    else {
+        if (threads_run(batches, deeplearndata_performance_task,
+                        &state) != 0) {
+            failed = 1;
+        }
+        for (i = 0; i < workers; i++) {
+            failed += state.failed[i];
+            if (state.ready[i] == 1) {
+                bp_inference_free(&state.ctx[i]);
+            }
+            free(state.inputs[i]);
         }
-        learner->training_ctr = 0;
     }
-    learner->training_ctr++;
+    free(state.ctx);
+    free(state.inputs);
+    free(state.ready);
+    free(state.failed);
 
-    if ((learner->net->HiddenLayers > 1) &&
-        (learner->current_hidden_layer < learner->net->HiddenLayers)) {
-        /* index number of a random training sample */
-        int index = rand_num(&learner->net->random_seed)%learner->training_data_samples;
-        /* get the sample */
-        deeplearndata * sample = deeplearndata_get_training(learner, index);
-        deeplearn_set_inputs(learner, sample);
-        deeplearn_update(learner);
-        return 1;
+    if (failed > 0) {
+        free(outputs);
+        return -1;
     }
-    if (learner->training_complete == 0) {
-        /* index number of a random training sample */
-        int index = rand_num(&learner->net->random_seed)%learner->training_data_labeled_samples;
-        /* get the sample */
-        deeplearndata * sample = deeplearndata_get_training_labeled(learner, index);
-        deeplearn_set_inputs(learner, sample);
-        deeplearn_set_outputs(learner, sample);
-        deeplearn_update(learner);
-        return 2;
+
+    for (index = 0; index < samples; index++) {
+        for (i = 0; i < no_of_outputs; i++) {
+            if (sample[index]->outputs[i] != 0) {
+                error_percent =
+                    (sample[index]->outputs[i] - outputs[index*no_of_outputs + i]) /
+                    sample[index]->outputs[i];
+                total_error += error_percent*error_percent;
+                hits++;
+            }
+        }
+    }
+    free(outputs);
+
+    if (hits > 0) {
+        average_error = (float)sqrt(total_error / hits) * 100;
+        if (average_error > 100) average_error = 100;
+        return 100 - average_error;
     }
     return 0;
 }
 
+/**
+* @brief Returns the performance on a random subset of the test data set
+*        as a percentage value. This gives a cheaper estimate for use
+*        while training is in progress.
+* @param learner Deep learner object
+* @param subset_size The number of test samples to evaluate. If this is
+*        zero or not less than the size of the test set then all test
+*        samples are used
+* @param random_seed Random number seed used to pick the subset, so that
+*        the training sequence of the learner is not altered
+* @return Performance in the range 0 to 100%, or -1 on error
+*/
+float deeplearndata_get_performance_subset(deeplearn * learner,
+                                           int subset_size,
+                                           unsigned int * random_seed)
+{
+    int i, j, samples = learner->test_data_samples;
+    deeplearndata ** sample, * swap;
+    float performance;
+
+    if (samples < 1) {
+        return 0;
+    }
+    if ((subset_size <= 0) || (subset_size > samples)) {
+        subset_size = samples;
+    }
+
+    sample = (deeplearndata**)malloc(samples*sizeof(deeplearndata*));
+    if (!sample) {
+        return -1;
+    }
+    for (i = 0; i < samples; i++) {
+        sample[i] = deeplearndata_get_test(learner, i);
+        if (!sample[i]) {
+            free(sample);
+            return -1;
+        }
+    }
+
+    /* partial shuffle to pick the subset */
+    if (subset_size < samples) {
+        for (i = 0; i < subset_size; i++) {
+            j = i + (int)(rand_num(random_seed)%(samples - i));
+            swap = sample[i];
+            sample[i] = sample[j];
+            sample[j] = swap;
+        }
+    }
+
+    performance = deeplearndata_performance(learner, sample, subset_size);
+    free(sample);
+    return performance;
+}
+
 /**
 * @brief Returns the performance on the test data set as a percentage value
 * @param learner Deep learner object
-* @param data_set An array containing all the data
-* @param data_set_size The number of entries in the data set
-* @return Training or test performance on the given data, in the range 0 to 100%
+* @return Test performance, in the range 0 to 100%, or -1 on error
 */
 float deeplearndata_get_performance(deeplearn * learner)
 {
-    int index,i,hits=0;
-    float error_percent, total_error=0, average_error;
-    float * outputs = (float*)malloc(learner->net->NoOfOutputs*sizeof(float));
+    return deeplearndata_get_performance_subset(learner, 0, NULL);
+}
 
-    for (index = 0; index < learner->test_data_samples; index++) {
-        deeplearndata * sample = deeplearndata_get_test(learner, index);
-        deeplearn_set_inputs(learner, sample);
-        deeplearn_feed_forward(learner);
-        deeplearn_get_outputs(learner, outputs);
+/**
+* @brief Quantises the network of a deep learner to eight bit weights
+*        after training, so that the test performance and subsequent
+*        inference use integer dot products.  The quantisation range
+*        of each layer is calibrated from the test samples.
+* @param learner Deep learner object
+* @param granularity BP_QUANT_PER_LAYER or BP_QUANT_PER_UNIT
+* @param calibration_samples The maximum number of test samples used
+*        for calibration, or zero to use all of them
+* @returns zero on success
+*/
+int deeplearndata_quantise(deeplearn * learner, int granularity,
+                           int calibration_samples)
+{
+    int i, retval, no_of_inputs = learner->net->NoOfInputs;
+    float * inputs;
+    deeplearndata * sample;
 
-        for (i = 0; i < learner->net->NoOfOutputs; i++) {
-            if (sample->outputs[i] != 0) {
-                error_percent = (sample->outputs[i] - outputs[i]) / sample->outputs[i];
-                total_error += error_percent*error_percent;
-                hits++;
-            }
+    if ((calibration_samples <= 0) ||
+        (calibration_samples > learner->test_data_samples)) {
+        calibration_samples = learner->test_data_samples;
+    }
+    if (calibration_samples < 1) {
+        return -1;
+    }
+
+    inputs = (float*)malloc(calibration_samples*no_of_inputs*sizeof(float));
+    if (!inputs) {
+        return -2;
+    }
+    for (i = 0; i < calibration_samples; i++) {
+        sample = deeplearndata_get_test(learner, i);
+        if (!sample) {
+            free(inputs);
+            return -3;
         }
+        deeplearn_encode_inputs(learner, sample, &inputs[i*no_of_inputs]);
     }
-    if (hits > 0) {
-        average_error = (float)sqrt(total_error / hits) * 100;
-        if (average_error > 100) average_error = 100;
-        free(outputs);
-        return 100 - average_error;
+
+    retval = bp_quantise(learner->net, granularity, inputs,
+                         calibration_samples);
+    free(inputs);
+    if (retval != 0) {
+        return -4;
     }
-    free(outputs);
+    return 0;
+}
+
+/**
+* @brief Returns the loss of test performance caused by quantisation,
+*        being the float performance minus the quantised performance
+* @param learner Deep learner object which has been quantised
+* @param loss Returned loss in percent
+* @returns zero on success
+*/
+int deeplearndata_get_quantisation_loss(deeplearn * learner, float * loss)
+{
+    float float_performance, int8_performance;
+
+    if (bp_set_inference_precision(learner->net, KERNEL_FP32) != 0) {
+        return -1;
+    }
+    float_performance = deeplearndata_get_performance(learner);
+    if (bp_set_inference_precision(learner->net, KERNEL_INT8) != 0) {
+        return -2;
+    }
+    int8_performance = deeplearndata_get_performance(learner);
+    if ((float_performance < 0) || (int8_performance < 0)) {
+        return -3;
+    }
+    *loss = float_performance - int8_performance;
     return 0;
 }
 
@@ -814,6 +3418,34 @@ int deeplearndata_get_field_length(deeplearndata * data, int field_index)
     return max;
 }
 
+/**
+* @brief Increases the field lengths (input neurons per field) to fit the
+*        text of a sample, so that lengths can be found incrementally as
+*        samples arrive
+* @param no_of_input_fields The number of input fields
+* @param field_length Array storing the field lengths in input neurons (bits)
+* @param inputs_text Text of each field of the sample, or NULL if it has
+*        no text fields
+* @returns The total number of input neurons needed
+*/
+int deeplearndata_grow_field_lengths(int no_of_input_fields,
+                                     int field_length[],
+                                     char ** inputs_text)
+{
+    int i, no_of_inputs = 0, length;
+
+    for (i = 0; i < no_of_input_fields; i++) {
+        if ((inputs_text != 0) && (inputs_text[i] != 0)) {
+            length = strlen(inputs_text[i])*CHAR_BITS;
+            if (length > field_length[i]) {
+                field_length[i] = length;
+            }
+        }
+        no_of_inputs += (field_length[i] < 1) ? 1 : field_length[i];
+    }
+    return no_of_inputs;
+}
+
 /**
 * @brief Calculates the field lengths (input neurons per field)
 *        Note that a zero field length indicates a numeric value
@@ -826,13 +3458,16 @@ int deeplearndata_update_field_lengths(int no_of_input_fields,
                                        int field_length[],
                                        deeplearndata * data)
 {
-    int i, no_of_inputs = 0, length;
+    int i;
 
     for (i = 0; i < no_of_input_fields; i++) {
-        length = deeplearndata_get_field_length(data, i);
-        field_length[i] = length;
-        if (length < 1) length = 1;
-        no_of_inputs += length;
+        field_length[i] = 0;
     }
-    return no_of_inputs;
+    while (data != 0) {
+        deeplearndata_grow_field_lengths(no_of_input_fields, field_length,
+                                         data->inputs_text);
+        data = (deeplearndata *)data->next;
+    }
+    return deeplearndata_grow_field_lengths(no_of_input_fields,
+                                            field_length, 0);
 }
@@ -34,11 +34,53 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
 #include <dirent.h>
 #include "globals.h"
 #include "deeplearn.h"
 #include "deepconvnet.h"
 #include "deeplearn_images.h"
+#include "deeplearn_split.h"
+#include "deeplearn_shared.h"
+
+/* number of bytes read at a time when loading csv files */
+#define DEEPLEARNDATA_CSV_CHUNK_SIZE (1024*1024)
+
+/* number of test samples fed forward together when evaluating */
+#define DEEPLEARNDATA_PERFORMANCE_BATCH 64
+
+/* alignment in bytes of the input and output arrays within an arena */
+#define DEEPLEARNDATA_ARENA_ALIGNMENT 64
+
+/* default number of samples for which space is initially reserved */
+#define DEEPLEARNDATA_ARENA_CAPACITY  256
+
+/* Binary dataset file holding parsed samples together with the field
+   lengths, data ranges and training and test sets, so that it can be
+   memory mapped and trained on without parsing.  Samples are stored in
+   the order of the training set followed by the test set. */
+#define DEEPLEARNDATA_FILE_MAGIC     "LIBDEEPD"
+#define DEEPLEARNDATA_FILE_VERSION   1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    int32_t samples;
+    int32_t no_of_input_fields;
+    int32_t no_of_outputs;
+    int32_t training_samples;
+    int32_t test_samples;
+
+    /* bytes of packed text for each sample */
+    int32_t text_row;
+
+    /* field lengths, then input ranges, then output ranges */
+    uint64_t fields_offset;
+    uint64_t inputs_offset;
+    uint64_t outputs_offset;
+    uint64_t text_offset;
+    uint64_t size;
+} deeplearndata_file_header;
 
 int deeplearndata_add(deeplearndata ** datalist,
                       int data_samples[],
@@ -51,6 +93,23 @@ int deeplearndata_add(deeplearndata ** datalist,
                       float input_range_max[],
                       float output_range_min[],
                       float output_range_max[]);
+int deeplearndata_arena_init(deeplearndata_arena * arena,
+                             int no_of_input_fields,
+                             int no_of_outputs,
+                             int capacity);
+void deeplearndata_arena_free(deeplearndata_arena * arena);
+int deeplearndata_arena_add(deeplearndata_arena * arena,
+                            float inputs[],
+                            char ** inputs_text,
+                            float outputs[],
+                            float input_range_min[],
+                            float input_range_max[],
+                            float output_range_min[],
+                            float output_range_max[]);
+int deeplearndata_arena_pack_text(deeplearndata_arena * arena,
+                                  int field_length[]);
+int deeplearndata_arena_attach(deeplearn * learner,
+                               deeplearndata_arena * arena);
 int deeplearndata_index_data(
         deeplearndata * list,
         int samples,
@@ -69,12 +128,51 @@ int deeplearndata_add_training_sample(deeplearn * learner, deeplearndata * sampl
 int deeplearndata_add_labeled_training_sample(deeplearn * learner, deeplearndata * sample);
 int deeplearndata_add_test_sample(deeplearn * learner, deeplearndata * sample);
 int deeplearndata_create_datasets(deeplearn * learner, int test_data_percentage);
+int deeplearndata_split(deeplearn * learner, int test_data_percentage,
+                        int method);
+int deeplearndata_split_kfold(deeplearn * learner, int folds, int fold,
+                              int method, unsigned int random_seed);
+void deeplearndata_shuffle_training(deeplearn * learner);
+void deeplearndata_set_epochs(deeplearn * learner, unsigned char enabled);
+unsigned int deeplearndata_get_epochs(deeplearn * learner);
+float deeplearndata_get_epoch_error(deeplearn * learner);
 int deeplearndata_training(deeplearn * learner);
+int deeplearndata_training_batch(deeplearn * learner, int batch_size);
+int deeplearndata_training_hogwild(deeplearn * learner, int no_of_samples,
+                                   int no_of_threads);
 float deeplearndata_get_performance(deeplearn * learner);
+int deeplearndata_quantise(deeplearn * learner, int granularity,
+                           int calibration_samples);
+int deeplearndata_get_quantisation_loss(deeplearn * learner, float * loss);
+float deeplearndata_get_performance_subset(deeplearn * learner,
+                                           int subset_size,
+                                           unsigned int * random_seed);
 int deeplearndata_get_field_length(deeplearndata * data, int field_index);
+void deeplearndata_memory_usage(deeplearn * learner,
+                                deeplearn_footprint * usage);
+int deeplearndata_grow_field_lengths(int no_of_input_fields,
+                                     int field_length[],
+                                     char ** inputs_text);
 int deeplearndata_update_field_lengths(int no_of_input_fields,
                                        int field_length[],
                                        deeplearndata * data);
+int deeplearndata_set_stream(deeplearn * learner, deeplearn_stream * stream);
+int deeplearndata_read_stream(deeplearn_stream * stream,
+                              deeplearn * learner,
+                              int no_of_hiddens, int hidden_layers,
+                              float error_threshold[],
+                              unsigned int * random_seed);
+int deeplearndata_save(deeplearn * learner, char * filename);
+int deeplearndata_load_mmap(char * filename,
+                            deeplearn * learner,
+                            int no_of_hiddens, int hidden_layers,
+                            float error_threshold[],
+                            unsigned int * random_seed);
+int deeplearndata_attach(char * name,
+                         deeplearn * learner,
+                         int no_of_hiddens, int hidden_layers,
+                         float error_threshold[],
+                         unsigned int * random_seed);
 int deeplearndata_read_csv(char * filename,
                            deeplearn * learner,
                            int no_of_hiddens, int hidden_layers,
@@ -82,4 +180,13 @@ int deeplearndata_read_csv(char * filename,
                            int output_classes,
                            float error_threshold[],
                            unsigned int * random_seed);
+int deeplearndata_read_csv_chunked(char * filename,
+                                   deeplearn * learner,
+                                   int no_of_hiddens, int hidden_layers,
+                                   int no_of_outputs, int * output_field_index,
+                                   int output_classes,
+                                   float error_threshold[],
+                                   unsigned int * random_seed,
+                                   int chunk_size,
+                                   unsigned char background);
 #endif
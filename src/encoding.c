@@ -29,6 +29,93 @@
 
 #include "encoding.h"
 
+/* the input values for each bit of a byte, least significant bit first */
+#define ENC_BIT(c,b) ((((c)>>(b))&1) ? 0.75f : 0.25f)
+#define ENC_BYTE(c) \
+    { ENC_BIT(c,0), ENC_BIT(c,1), ENC_BIT(c,2), ENC_BIT(c,3), \
+      ENC_BIT(c,4), ENC_BIT(c,5), ENC_BIT(c,6), ENC_BIT(c,7) }
+#define ENC_BYTES4(c) \
+    ENC_BYTE(c), ENC_BYTE((c)+1), ENC_BYTE((c)+2), ENC_BYTE((c)+3)
+#define ENC_BYTES16(c) \
+    ENC_BYTES4(c), ENC_BYTES4((c)+4), ENC_BYTES4((c)+8), ENC_BYTES4((c)+12)
+#define ENC_BYTES64(c) \
+    ENC_BYTES16(c), ENC_BYTES16((c)+16), ENC_BYTES16((c)+32), \
+    ENC_BYTES16((c)+48)
+
+/* lookup table expanding a byte into eight input values */
+static const float enc_byte_lut[256][ENC_BITS_PER_CHAR] = {
+    ENC_BYTES64(0), ENC_BYTES64(64), ENC_BYTES64(128), ENC_BYTES64(192)
+};
+
+/* input values for padding beyond the end of the text */
+static const float enc_neutral[ENC_BITS_PER_CHAR] = {
+    ENC_NEUTRAL, ENC_NEUTRAL, ENC_NEUTRAL, ENC_NEUTRAL,
+    ENC_NEUTRAL, ENC_NEUTRAL, ENC_NEUTRAL, ENC_NEUTRAL
+};
+
+/**
+* @brief Returns the number of characters of a text field which fit
+*        within the inputs
+* @param text The text string to be encoded
+* @param no_of_inputs The number of inputs
+* @param offset The index of the input at which the text begins
+* @param max_field_length_chars The maximum length of a text field in characters
+* @returns The number of characters to be encoded
+*/
+static int enc_text_chars(const char * text, int no_of_inputs, int offset,
+                          int max_field_length_chars)
+{
+    int max_chars = strlen(text);
+
+    if (max_chars > (no_of_inputs-offset)/ENC_BITS_PER_CHAR) {
+        max_chars = (no_of_inputs-offset)/ENC_BITS_PER_CHAR;
+    }
+    if (max_chars > max_field_length_chars) {
+        max_chars = max_field_length_chars;
+    }
+    return max_chars;
+}
+
+/**
+* @brief Encodes text into a contiguous vector of input values.
+*        Each character is expanded to eight values via a lookup table,
+*        so that the copy can be vectorised.
+* @param text The text string to be encoded
+* @param inputs Array of input values
+* @param no_of_inputs The number of input values
+* @param offset The index of the input value to begin inserting the text
+* @param max_field_length_chars The maximum length of a text field in characters
+* @returns current inputs index
+*/
+int enc_text_to_floats(const char * text,
+                       float * inputs, int no_of_inputs,
+                       int offset,
+                       int max_field_length_chars)
+{
+    int pos = offset, i;
+    int max_chars = enc_text_chars(text, no_of_inputs, offset,
+                                   max_field_length_chars);
+
+    for (i = 0; i < max_chars; i++, pos += ENC_BITS_PER_CHAR) {
+        memcpy((void*)&inputs[pos], enc_byte_lut[(unsigned char)text[i]],
+               ENC_BITS_PER_CHAR*sizeof(float));
+    }
+
+    /* set the remaining inputs within the field to neutral */
+    for (; i < max_field_length_chars; i++) {
+        if (pos + ENC_BITS_PER_CHAR > no_of_inputs) {
+            while (pos < no_of_inputs) {
+                inputs[pos++] = ENC_NEUTRAL;
+            }
+            break;
+        }
+        memcpy((void*)&inputs[pos], enc_neutral,
+               ENC_BITS_PER_CHAR*sizeof(float));
+        pos += ENC_BITS_PER_CHAR;
+    }
+    return pos;
+}
+
 /**
 * @brief Encodes text into binary input values
 * @param text The text string to be encoded
@@ -43,35 +130,26 @@ int enc_text_to_binary(char * text,
                        int offset,
                        int max_field_length_chars)
 {
-    int pos = offset, i, bit, max_chars = strlen(text);
-
-    if (max_chars > (no_of_inputs-offset)/CHAR_BITS) {
-        max_chars = ((no_of_inputs-offset)/CHAR_BITS);
-    }
-    if (max_chars > max_field_length_chars) {
-        max_chars = max_field_length_chars;
-    }
+    int pos = offset, i, bit;
+    int max_chars = enc_text_chars(text, no_of_inputs, offset,
+                                   max_field_length_chars);
 
     /* for each character in the string */
     for (i = 0; i < max_chars; i++) {
         /* set the bits for this character */
-        for (bit = 0; bit < CHAR_BITS; bit++, pos++) {
-            if (text[i] & (1<<bit)) {
-                inputs[pos]->value = 0.75f;
-            }
-            else {
-                inputs[pos]->value = 0.25f;
-            }
+        const float * bits = enc_byte_lut[(unsigned char)text[i]];
+        for (bit = 0; bit < ENC_BITS_PER_CHAR; bit++, pos++) {
+            inputs[pos]->value = bits[bit];
         }
     }
     /* set the remaining inputs within the field to neutral */
     while (i < max_field_length_chars) {
-        for (bit = 0; bit < CHAR_BITS; bit++) {
+        for (bit = 0; bit < ENC_BITS_PER_CHAR; bit++) {
             if (pos >= no_of_inputs) {
                 i = max_field_length_chars;
                 break;
             }
-            inputs[pos++]->value = 0.5f;
+            inputs[pos++]->value = ENC_NEUTRAL;
         }
         i++;
     }
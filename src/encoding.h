@@ -32,9 +32,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "globals.h"
 #include "backprop_neuron.h"
 
+/* number of input values used to encode each character */
+#define ENC_BITS_PER_CHAR 8
+
+/* input value for padding beyond the end of a text field */
+#define ENC_NEUTRAL 0.5f
+
+int enc_text_to_floats(const char * text,
+                       float * inputs, int no_of_inputs,
+                       int offset,
+                       int max_field_length_chars);
 int enc_text_to_binary(char * text,
                        bp_neuron ** inputs, int no_of_inputs,
                        int offset,
@@ -42,17 +42,43 @@
 #include "tests_deepconvnet.h"
 #include "tests_autocoder.h"
 #include "tests_dnc.h"
+#include "tests_kernels.h"
+#include "tests_model.h"
+#include "tests_stats.h"
+#include "tests_split.h"
+#include "tests_prefetch.h"
+#include "tests_checkpoint.h"
+#include "tests_parallel.h"
+#include "tests_ingest.h"
+#include "tests_device.h"
+#include "tests_threads.h"
+#include "tests_shared.h"
+#include "tests_sweep.h"
+#include "tests_distill.h"
 
 int main(int argc, char* argv[])
 {
     system("rm training.png");
 
+    run_tests_kernels();
     run_tests_dnc();
     run_tests_autocoder();
     run_tests_backprop();
     run_tests_images();
     run_tests_random();
+    run_tests_stats();
+    run_tests_split();
+    run_tests_prefetch();
+    run_tests_ingest();
+    run_tests_device();
+    run_tests_threads();
+    run_tests_shared();
+    run_tests_sweep();
+    run_tests_distill();
     run_tests_deeplearn();
+    run_tests_checkpoint();
+    run_tests_parallel();
+    run_tests_model();
     run_tests_data();
     run_tests_encoding();
     run_tests_pooling();
@@ -51,6 +51,9 @@ static void test_autocoder_init()
         assert(autocoder.bias[h] < 0.3f);
     }
 
+    /* all arrays come from one exactly sized arena */
+    assert(autocoder.arena.used == autocoder.arena.size);
+
     autocoder_free(&autocoder);
 
     printf("Ok\n");
@@ -155,6 +158,101 @@ static void test_autocoder_update()
     printf("Ok\n");
 }
 
+static void test_autocoder_update_single_pass()
+{
+    ac autocoder0, autocoder1;
+    int no_of_inputs = 2500;
+    int no_of_hiddens = 40;
+    unsigned int random_seed = 912;
+
+    printf("test_autocoder_update_single_pass...");
+
+    /* large enough for tiled and parallel decoding */
+    assert(autocoder_init(&autocoder0, no_of_inputs, no_of_hiddens,
+                          random_seed) == 0);
+    assert(autocoder_init(&autocoder1, no_of_inputs, no_of_hiddens,
+                          random_seed) == 0);
+    autocoder0.DropoutPercent = autocoder1.DropoutPercent = 0.2f;
+    autocoder0.noise = autocoder1.noise = 0;
+    for (int i = 0; i < no_of_inputs; i++) {
+        float value = 0.25f + ((i%17)/17.0f)*0.5f;
+        autocoder_set_input(&autocoder0, i, value);
+        autocoder_set_input(&autocoder1, i, value);
+    }
+
+    /* the combined update matches separate back propogation and
+       learning passes */
+    for (int t = 0; t < 5; t++) {
+        autocoder_update(&autocoder0);
+        autocoder_feed_forward(&autocoder1);
+        autocoder_backprop(&autocoder1);
+        autocoder_learn(&autocoder1);
+        assert(autocoder0.BPerror == autocoder1.BPerror);
+    }
+    assert(autocoder_compare(&autocoder0, &autocoder1) == 0);
+
+    autocoder_free(&autocoder0);
+    autocoder_free(&autocoder1);
+
+    printf("Ok\n");
+}
+
+static void test_autocoder_gradients()
+{
+    ac autocoder0, autocoder1;
+    int no_of_inputs = 30;
+    int no_of_hiddens = 10;
+    int batch_size = 12;
+    unsigned int random_seed = 582, seed;
+    float inputs[12*30], * gradients;
+    int length;
+
+    printf("test_autocoder_gradients...");
+
+    for (int i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + (((i*7)%13)/13.0f)*0.5f;
+    }
+
+    assert(autocoder_init(&autocoder0, no_of_inputs, no_of_hiddens,
+                          random_seed) == 0);
+    autocoder0.DropoutPercent = 0.2f;
+    autocoder0.noise = 0.1f;
+    assert(autocoder_clone(&autocoder1, &autocoder0) == 0);
+
+    length = autocoder_gradients_length(&autocoder0);
+    assert(length == 2*no_of_hiddens*no_of_inputs + 2*no_of_hiddens + 2);
+    gradients = (float*)malloc(length*sizeof(float));
+    assert(gradients);
+
+    /* summing a batch in two parts and then applying the gradients
+       is the same as a single batch update */
+    for (int t = 0; t < 5; t++) {
+        assert(autocoder_update_batch(&autocoder0, inputs, batch_size) == 0);
+
+        memset(gradients, '\0', length*sizeof(float));
+        seed = autocoder1.random_seed;
+        assert(autocoder_batch_gradients(&autocoder1, inputs, 5,
+                                         0, gradients) == 0);
+        assert(autocoder_batch_gradients(&autocoder1, &inputs[5*no_of_inputs],
+                                         batch_size - 5, 5, gradients) == 0);
+        assert(autocoder1.random_seed == seed);
+        assert(autocoder_apply_gradients(&autocoder1, gradients) == 0);
+        assert(autocoder0.BPerror == autocoder1.BPerror);
+    }
+    assert(autocoder_compare(&autocoder0, &autocoder1) == 0);
+    assert(memcmp(autocoder0.weights, autocoder1.weights,
+                  no_of_hiddens*no_of_inputs*sizeof(float)) == 0);
+    assert(autocoder0.random_seed == autocoder1.random_seed);
+    assert(autocoder0.itterations == autocoder1.itterations);
+    assert(autocoder0.itterations == 5*batch_size);
+
+    free(gradients);
+    autocoder_free(&autocoder0);
+    autocoder_free(&autocoder1);
+
+    printf("Ok\n");
+}
+
 int run_tests_autocoder()
 {
     printf("\nRunning autocoder tests\n");
@@ -162,6 +260,8 @@ int run_tests_autocoder()
     test_autocoder_init();
     test_autocoder_save_load();
     test_autocoder_update();
+    test_autocoder_update_single_pass();
+    test_autocoder_gradients();
 
     printf("All autocoder tests completed\n");
     return 1;
@@ -145,6 +145,190 @@ static void test_backprop_init()
     printf("Ok\n");
 }
 
+static void test_backprop_packed_layers()
+{
+    bp net;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=4;
+    int i,l;
+    float value;
+    unsigned int random_seed = 123;
+    bp_neuron * n;
+
+    printf("test_backprop_packed_layers...");
+
+    bp_init(&net,
+            no_of_inputs, no_of_hiddens,
+            hidden_layers,
+            no_of_outputs, &random_seed);
+
+    /* the weights of each unit should be a row within
+       the weight matrix of its layer */
+    for (l = 0; l < hidden_layers; l++) {
+        assert((&net)->layer[l+1].NoOfUnits == bp_hiddens_in_layer(&net,l));
+        for (i = 0; i < bp_hiddens_in_layer(&net,l); i++) {
+            n = (&net)->hiddens[l][i];
+            assert(n->weights ==
+                   &(&net)->layer[l+1].weights[i*n->NoOfInputs]);
+        }
+    }
+    for (i = 0; i < no_of_outputs; i++) {
+        n = (&net)->outputs[i];
+        assert(n->NoOfInputs == bp_hiddens_in_layer(&net,hidden_layers-1));
+        assert(n->weights ==
+               &(&net)->layer[hidden_layers+1].weights[i*n->NoOfInputs]);
+    }
+
+    /* set some inputs directly on the input units */
+    for (i = 0; i < no_of_inputs; i++) {
+        (&net)->inputs[i]->value = i/(float)no_of_inputs;
+    }
+    bp_feed_forward(&net);
+
+    /* the packed feed forward should give the same result as
+       evaluating each unit through its connections */
+    for (l = 0; l < hidden_layers; l++) {
+        for (i = 0; i < bp_hiddens_in_layer(&net,l); i++) {
+            n = (&net)->hiddens[l][i];
+            value = n->value;
+            assert(value == (&net)->layer[l+1].values[i]);
+            bp_neuron_feedForward(n, 0, &random_seed);
+            assert(fabs(n->value - value) < 0.00001f);
+        }
+    }
+    for (i = 0; i < no_of_outputs; i++) {
+        n = (&net)->outputs[i];
+        value = n->value;
+        bp_neuron_feedForward(n, 0, &random_seed);
+        assert(fabs(n->value - value) < 0.00001f);
+    }
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_arena()
+{
+    bp net;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=4;
+    int i,l;
+    unsigned int random_seed = 123;
+    char * start, * end;
+
+    printf("test_backprop_arena...");
+
+    assert(bp_init(&net,
+                   no_of_inputs, no_of_hiddens,
+                   hidden_layers,
+                   no_of_outputs, &random_seed) == 0);
+
+    /* the arena should have been sized exactly */
+    assert(net.arena.used == net.arena.size);
+
+    /* everything belonging to the layers should be within the arena */
+    start = net.arena.block;
+    end = net.arena.block + net.arena.size;
+    assert(((char*)net.layer >= start) && ((char*)net.layer < end));
+    for (l = 0; l < hidden_layers+2; l++) {
+        bp_layer * layer = &net.layer[l];
+        assert(((char*)layer->weights >= start) &&
+               ((char*)layer->weights < end));
+        assert((((uintptr_t)layer->weights) %
+                DEEPLEARN_ARENA_ALIGNMENT) == 0);
+        for (i = 0; i < layer->NoOfUnits; i++) {
+            assert(((char*)layer->units[i].inputs >= start) &&
+                   ((char*)layer->units[i].inputs < end));
+        }
+    }
+    for (i = 0; i < no_of_outputs; i++) {
+        assert(net.outputs[i]->inputs[0] == &net.layer[hidden_layers].units[0]);
+    }
+
+    /* creating and freeing many networks should work repeatedly */
+    bp_free(&net);
+    assert(net.arena.block == 0);
+    for (i = 0; i < 50; i++) {
+        assert(bp_init(&net, no_of_inputs, no_of_hiddens,
+                       1 + (i % 4), no_of_outputs, &random_seed) == 0);
+        assert(net.arena.used == net.arena.size);
+        bp_feed_forward(&net);
+        bp_free(&net);
+    }
+
+    printf("Ok\n");
+}
+
+static void test_backprop_clone()
+{
+    bp net, copy;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=2;
+    int no_of_outputs=4;
+    int i,l;
+    unsigned int random_seed = 123;
+    float inputs[10*4];
+
+    printf("test_backprop_clone...");
+
+    assert(bp_init(&net,
+                   no_of_inputs, no_of_hiddens,
+                   hidden_layers,
+                   no_of_outputs, &random_seed) == 0);
+    for (i = 0; i < no_of_inputs*4; i++) {
+        inputs[i] = 0.25f + (i % 7)/14.0f;
+    }
+    assert(bp_prune(&net, 0.5f) == 0);
+    assert(bp_quantise(&net, BP_QUANT_PER_UNIT, inputs, 4) == 0);
+
+    assert(bp_clone(&copy, &net) == 0);
+    assert(bp_compare(&net, &copy) == 1);
+    assert(copy.arena.block != net.arena.block);
+
+    /* every pointer of the copy refers to its own arena */
+    for (l = 0; l < hidden_layers+2; l++) {
+        bp_layer * layer = &copy.layer[l];
+        assert(layer->units != net.layer[l].units);
+        for (i = 0; i < layer->NoOfUnits; i++) {
+            assert(layer->units[i].weights ==
+                   &layer->weights[i*layer->NoOfInputs]);
+            if (l > 0) {
+                assert(layer->units[i].inputs[0] == &copy.layer[l-1].units[0]);
+            }
+        }
+        if (l > 0) {
+            assert(layer->sparse != 0);
+            assert(layer->sparse != net.layer[l].sparse);
+            assert(layer->sparse->nonzero == net.layer[l].sparse->nonzero);
+            assert(layer->quant != 0);
+            assert(layer->quant->weights[0] == net.layer[l].quant->weights[0]);
+        }
+    }
+    assert(copy.outputs[0] == &copy.layer[hidden_layers+1].units[0]);
+
+    /* both produce the same outputs */
+    for (i = 0; i < no_of_inputs; i++) {
+        bp_set_input(&net, i, inputs[i]);
+        bp_set_input(&copy, i, inputs[i]);
+    }
+    bp_feed_forward(&net);
+    bp_free(&net);
+    bp_feed_forward(&copy);
+    for (i = 0; i < no_of_outputs; i++) {
+        assert(copy.layer[hidden_layers+1].values[i] ==
+               bp_get_output(&copy, i));
+    }
+    bp_free(&copy);
+
+    printf("Ok\n");
+}
+
 static void test_backprop_feed_forward()
 {
     bp net;
@@ -337,6 +521,913 @@ static void test_backprop_update()
     printf("Ok\n");
 }
 
+static void test_backprop_update_batch()
+{
+    bp net1, net2;
+    int no_of_inputs=2;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs=1;
+    int itt,example,i,l;
+    bp net3;
+    unsigned int random_seed = 123;
+    float inputs[8], targets[4];
+
+    printf("test_backprop_update_batch...");
+
+    /* the output follows the first input */
+    for (example = 0; example < 4; example++) {
+        inputs[example*2] = 0.2f + ((example&1)*0.6f);
+        inputs[example*2+1] = 0.2f + (((example>>1)&1)*0.6f);
+        targets[example] = inputs[example*2];
+    }
+
+    /* a batch of one sample should behave like a normal update */
+    bp_init(&net1, no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs, &random_seed);
+    random_seed = 123;
+    bp_init(&net2, no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs, &random_seed);
+    net1.DropoutPercent = 0;
+    net2.DropoutPercent = 0;
+
+    for (itt = 0; itt < 100; itt++) {
+        example = itt%4;
+        bp_set_input(&net1, 0, inputs[example*2]);
+        bp_set_input(&net1, 1, inputs[example*2+1]);
+        bp_set_output(&net1, 0, targets[example]);
+        bp_update(&net1, 0);
+        assert(bp_update_batch(&net2, &inputs[example*2],
+                               &targets[example], 1, 0) == 0);
+    }
+    assert(net1.itterations == net2.itterations);
+    assert(fabs(net1.BPerrorAverage - net2.BPerrorAverage) < 0.0001f);
+    for (l = 0; l < hidden_layers; l++) {
+        for (i = 0; i < bp_hiddens_in_layer(&net1,l); i++) {
+            assert(fabs(net1.hiddens[l][i]->bias -
+                        net2.hiddens[l][i]->bias) < 0.0001f);
+            assert(fabs(net1.hiddens[l][i]->weights[0] -
+                        net2.hiddens[l][i]->weights[0]) < 0.0001f);
+        }
+    }
+    assert(fabs(bp_get_output(&net1,0) - bp_get_output(&net2,0)) < 0.0001f);
+    bp_free(&net1);
+
+    /* the network state reflects the last sample in the batch */
+    assert(bp_update_batch(&net2, inputs, targets, 4, 0) == 0);
+    assert(net2.itterations == 104);
+    assert(net2.inputs[0]->value == inputs[6]);
+    assert(net2.outputs[0]->desiredValue == targets[3]);
+    bp_free(&net2);
+
+    /* train using all of the examples as the batch */
+    bp_init(&net3, no_of_inputs, no_of_hiddens,
+            1, no_of_outputs, &random_seed);
+    net3.DropoutPercent = 0;
+    net3.learningRate = 1.0f;
+    for (itt = 0; itt < 20000; itt++) {
+        assert(bp_update_batch(&net3, inputs, targets, 4, 0) == 0);
+    }
+    assert(net3.BPerrorPercent < 5);
+    for (example = 0; example < 4; example++) {
+        bp_set_input(&net3, 0, inputs[example*2]);
+        bp_set_input(&net3, 1, inputs[example*2+1]);
+        bp_feed_forward(&net3);
+        assert(fabs(bp_get_output(&net3, 0) - targets[example]) < 0.05f);
+    }
+    bp_free(&net3);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_update_hogwild()
+{
+    bp net1, net2;
+    int no_of_inputs=2;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs=1;
+    int itt,example,i,l;
+    unsigned int random_seed = 123;
+    float inputs[8*64], targets[4*64];
+
+    printf("test_backprop_update_hogwild...");
+
+    /* the output follows the first input */
+    for (example = 0; example < 4*64; example++) {
+        inputs[example*2] = 0.2f + ((example&1)*0.6f);
+        inputs[example*2+1] = 0.2f + (((example>>1)&1)*0.6f);
+        targets[example] = inputs[example*2];
+    }
+
+    assert(bp_init(&net1, no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs, &random_seed) == 0);
+    net1.DropoutPercent = 0;
+    net1.noise = 0;
+    assert(bp_clone(&net2, &net1) == 0);
+    assert(bp_update_hogwild(&net2, inputs, targets, 0, 1) == -1);
+
+    /* a single thread behaves like a sequence of normal updates */
+    for (itt = 0; itt < 100; itt++) {
+        example = itt%4;
+        bp_set_input(&net1, 0, inputs[example*2]);
+        bp_set_input(&net1, 1, inputs[example*2+1]);
+        bp_set_output(&net1, 0, targets[example]);
+        bp_update(&net1, 0);
+    }
+    assert(bp_update_hogwild(&net2, inputs, targets, 100, 1) == 0);
+    assert(net1.itterations == net2.itterations);
+    for (l = 0; l < hidden_layers; l++) {
+        for (i = 0; i < bp_hiddens_in_layer(&net1,l); i++) {
+            assert(net1.hiddens[l][i]->bias == net2.hiddens[l][i]->bias);
+            assert(net1.hiddens[l][i]->weights[0] ==
+                   net2.hiddens[l][i]->weights[0]);
+        }
+    }
+    assert(net1.outputs[0]->bias == net2.outputs[0]->bias);
+    bp_free(&net1);
+    bp_free(&net2);
+
+    /* several threads with dropouts still learn */
+    assert(bp_init(&net1, no_of_inputs, no_of_hiddens,
+                   1, no_of_outputs, &random_seed) == 0);
+    net1.DropoutPercent = 1;
+    net1.learningRate = 1.0f;
+    for (itt = 0; itt < 400; itt++) {
+        assert(bp_update_hogwild(&net1, inputs, targets, 4*64, 4) == 0);
+    }
+    assert(net1.BPerrorPercent < 10);
+    net1.DropoutPercent = 0;
+    for (example = 0; example < 4; example++) {
+        bp_set_input(&net1, 0, inputs[example*2]);
+        bp_set_input(&net1, 1, inputs[example*2+1]);
+        bp_feed_forward(&net1);
+        assert(fabs(bp_get_output(&net1, 0) - targets[example]) < 0.1f);
+    }
+    bp_free(&net1);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_freeze()
+{
+    bp net1, net2;
+    int no_of_inputs=4;
+    int no_of_hiddens=6;
+    int hidden_layers=3;
+    int no_of_outputs=2;
+    int itt,example,i,l,units;
+    unsigned int random_seed = 123;
+    float inputs[4*8], targets[2*8];
+    float * weights[5], bias[5][6];
+    char filename[256];
+    FILE * fp;
+
+    printf("test_backprop_freeze...");
+
+    for (example = 0; example < 8; example++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            inputs[example*no_of_inputs + i] =
+                0.2f + (((example >> (i&1)) & 1)*0.6f);
+        }
+        targets[example*2] = 0.25f + ((example&1)*0.5f);
+        targets[example*2+1] = 0.75f - ((example&1)*0.5f);
+    }
+
+    assert(bp_init(&net1, no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs, &random_seed) == 0);
+    net1.DropoutPercent = 0;
+    net1.noise = 0;
+    assert(bp_frozen_layers(&net1) == 0);
+    assert(bp_freeze_layer(&net1, -1, 1) == -1);
+    assert(bp_freeze_layer(&net1, hidden_layers, 1) == -1);
+
+    /* freezing the second hidden layer also freezes the first */
+    assert(bp_freeze_layer(&net1, 1, 1) == 0);
+    assert(bp_frozen_layers(&net1) == 2);
+
+    for (l = 1; l < hidden_layers+2; l++) {
+        units = net1.layer[l].NoOfUnits;
+        weights[l] = (float*)malloc(units*net1.layer[l].NoOfInputs*
+                                    sizeof(float));
+        assert(weights[l] != 0);
+        memcpy(weights[l], net1.layer[l].weights,
+               units*net1.layer[l].NoOfInputs*sizeof(float));
+        for (i = 0; i < units; i++) {
+            bias[l][i] = net1.layer[l].units[i].bias;
+        }
+    }
+
+    /* train in each of the ways which update the weights */
+    for (itt = 0; itt < 20; itt++) {
+        example = itt%8;
+        for (i = 0; i < no_of_inputs; i++) {
+            bp_set_input(&net1, i, inputs[example*no_of_inputs + i]);
+        }
+        for (i = 0; i < no_of_outputs; i++) {
+            bp_set_output(&net1, i, targets[example*2 + i]);
+        }
+        bp_update(&net1, 0);
+    }
+    assert(bp_update_batch(&net1, inputs, targets, 8, 0) == 0);
+    assert(bp_update_hogwild(&net1, inputs, targets, 8, 1) == 0);
+
+    /* only the layers above the frozen ones have changed */
+    for (l = 1; l < hidden_layers+2; l++) {
+        int changed = 0;
+
+        units = net1.layer[l].NoOfUnits;
+        if (memcmp(weights[l], net1.layer[l].weights,
+                   units*net1.layer[l].NoOfInputs*sizeof(float)) != 0) {
+            changed = 1;
+        }
+        for (i = 0; i < units; i++) {
+            if (bias[l][i] != net1.layer[l].units[i].bias) {
+                changed = 1;
+            }
+        }
+        assert(changed == (l > 2));
+    }
+
+    /* the frozen layers are saved with the network */
+    sprintf(filename,"%stemp_deep.dat",DEEPLEARN_TEMP_DIRECTORY);
+    fp = fopen(filename,"wb");
+    assert(fp!=0);
+    assert(bp_save(fp, &net1) == 0);
+    fclose(fp);
+    fp = fopen(filename,"rb");
+    assert(fp!=0);
+    assert(bp_load(fp, &net2, &random_seed) == 0);
+    fclose(fp);
+    assert(bp_compare(&net1, &net2) == 1);
+    assert(bp_frozen_layers(&net2) == 2);
+    assert(net2.layer[1].frozen == 0);
+    assert(net2.layer[2].frozen != 0);
+
+    /* once unfrozen the whole network trains again */
+    assert(bp_freeze_layer(&net2, 1, 0) == 0);
+    assert(bp_frozen_layers(&net2) == 0);
+    assert(bp_compare(&net1, &net2) == -12);
+    assert(bp_update_batch(&net2, inputs, targets, 8, 0) == 0);
+    assert(memcmp(weights[1], net2.layer[1].weights,
+                  net2.layer[1].NoOfUnits*net2.layer[1].NoOfInputs*
+                  sizeof(float)) != 0);
+
+    for (l = 1; l < hidden_layers+2; l++) {
+        free(weights[l]);
+    }
+    bp_free(&net1);
+    bp_free(&net2);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_gradients()
+{
+    bp net1, net2;
+    int no_of_inputs=2;
+    int no_of_hiddens=8;
+    int hidden_layers=2;
+    int no_of_outputs=1;
+    int itt,example,l,length;
+    unsigned int random_seed = 123, seed;
+    float inputs[2*16], targets[16], * gradients;
+
+    printf("test_backprop_gradients...");
+
+    for (example = 0; example < 16; example++) {
+        inputs[example*2] = 0.2f + ((example&1)*0.6f);
+        inputs[example*2+1] = 0.2f + (((example>>1)&1)*0.6f);
+        targets[example] = inputs[example*2];
+    }
+
+    assert(bp_init(&net1, no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs, &random_seed) == 0);
+    net1.DropoutPercent = 20;
+    net1.noise = 0;
+    assert(bp_clone(&net2, &net1) == 0);
+
+    length = bp_gradients_length(&net1);
+    assert(length == bp_hiddens_in_layer(&net1,0)*(no_of_inputs+1) +
+           bp_hiddens_in_layer(&net1,1)*(bp_hiddens_in_layer(&net1,0)+1) +
+           no_of_outputs*(bp_hiddens_in_layer(&net1,1)+1) +
+           BP_GRADIENT_STATS);
+    gradients = (float*)malloc(length*sizeof(float));
+    assert(gradients);
+
+    /* nothing to apply until gradients have been summed */
+    memset(gradients, '\0', length*sizeof(float));
+    assert(bp_apply_gradients(&net2, gradients, 2) == -1);
+    assert(bp_batch_gradients(&net2, inputs, targets, 0, 2, gradients) == -1);
+
+    /* summing in two parts and then applying gives the same
+       weights as a single batch update */
+    for (itt = 0; itt < 20; itt++) {
+        assert(bp_update_batch(&net1, inputs, targets, 16, 2) == 0);
+
+        memset(gradients, '\0', length*sizeof(float));
+        seed = net2.random_seed;
+        assert(bp_batch_gradients(&net2, inputs, targets,
+                                  10, 2, gradients) == 0);
+        assert(bp_batch_gradients(&net2, &inputs[10*2], &targets[10],
+                                  6, 2, gradients) == 0);
+        assert(net2.random_seed == seed);
+        assert(gradients[length-1] == 16);
+        assert(bp_apply_gradients(&net2, gradients, 2) == 0);
+    }
+    assert(net1.itterations == net2.itterations);
+    assert(net1.random_seed == net2.random_seed);
+    for (l = 1; l < hidden_layers+2; l++) {
+        bp_layer * layer1 = &net1.layer[l];
+        bp_layer * layer2 = &net2.layer[l];
+
+        assert(memcmp(layer1->weights, layer2->weights,
+                      layer1->NoOfUnits*layer1->NoOfInputs*
+                      sizeof(float)) == 0);
+        assert(layer1->units[0].bias == layer2->units[0].bias);
+    }
+    assert(fabs(net1.BPerrorPercent - net2.BPerrorPercent) < 1.0f);
+
+    /* copying the weights makes the networks behave identically */
+    bp_free(&net2);
+    assert(bp_init(&net2, no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs, &random_seed) == 0);
+    assert(bp_copy_weights(&net2, &net1) == 0);
+    assert(net2.random_seed == net1.random_seed);
+    for (example = 0; example < 4; example++) {
+        bp_set_input(&net1, 0, inputs[example*2]);
+        bp_set_input(&net1, 1, inputs[example*2+1]);
+        bp_set_input(&net2, 0, inputs[example*2]);
+        bp_set_input(&net2, 1, inputs[example*2+1]);
+        bp_feed_forward(&net1);
+        bp_feed_forward(&net2);
+        assert(bp_get_output(&net1, 0) == bp_get_output(&net2, 0));
+    }
+
+    free(gradients);
+    bp_free(&net1);
+    bp_free(&net2);
+
+    printf("Ok\n");
+}
+
+static int train_first_input(bp * net, int max_itterations)
+{
+    int itt, example, e;
+    float inputs[] = { 0.25f,0.25f, 0.75f,0.25f, 0.25f,0.75f, 0.75f,0.75f };
+    float error;
+
+    for (itt = 0; itt < max_itterations; itt++) {
+        example = itt%4;
+        bp_set_input(net, 0, inputs[example*2]);
+        bp_set_input(net, 1, inputs[example*2+1]);
+        bp_set_output(net, 0, inputs[example*2]);
+        bp_update(net, 0);
+
+        if (example < 3) continue;
+        error = 0;
+        for (e = 0; e < 4; e++) {
+            bp_set_input(net, 0, inputs[e*2]);
+            bp_set_input(net, 1, inputs[e*2+1]);
+            bp_feed_forward(net);
+            error += fabs(bp_get_output(net, 0) - inputs[e*2]);
+        }
+        if (error/4 < 0.05f) return itt;
+    }
+    return -1;
+}
+
+static void test_backprop_optimisers()
+{
+    bp net, net2;
+    int type, l, itterations, momentum_itterations;
+    unsigned int random_seed;
+    char filename[256];
+    FILE * fp;
+
+    printf("test_backprop_optimisers...");
+
+    random_seed = 123;
+    assert(bp_init(&net, 2, 4, 1, 1, &random_seed) == 0);
+    assert(bp_set_optimiser(&net, -1) == -1);
+    assert(bp_set_optimiser(&net, OPTIMISERS) == -1);
+    assert(net.optimiser.type == OPTIMISER_MOMENTUM);
+    net.DropoutPercent = 0;
+    net.learningRate = 1.0f;
+    momentum_itterations = train_first_input(&net, 20000);
+    assert(momentum_itterations > 0);
+    bp_free(&net);
+
+    /* each of the other rules converges in fewer updates */
+    for (type = OPTIMISER_SGD; type < OPTIMISERS; type++) {
+        random_seed = 123;
+        assert(bp_init(&net, 2, 4, 1, 1, &random_seed) == 0);
+        assert(bp_set_optimiser(&net, type) == 0);
+        assert((net.layer[1].moment2 != 0) ==
+               ((type == OPTIMISER_RMSPROP) || (type == OPTIMISER_ADAM)));
+        net.DropoutPercent = 0;
+        net.learningRate = (type == OPTIMISER_RMSPROP) ? 0.2f : 1.0f;
+        itterations = train_first_input(&net, momentum_itterations);
+        assert(itterations > 0);
+        assert(itterations < momentum_itterations);
+        assert(net.optimiser.step == (unsigned int)itterations+1);
+        bp_free(&net);
+    }
+
+    /* the optimiser and its moments are saved with the network */
+    random_seed = 123;
+    assert(bp_init(&net, 2, 4, 2, 1, &random_seed) == 0);
+    assert(bp_set_optimiser(&net, OPTIMISER_ADAM) == 0);
+    net.DropoutPercent = 0;
+    train_first_input(&net, 40);
+
+    sprintf(filename,"%stemp_optimiser.dat",DEEPLEARN_TEMP_DIRECTORY);
+    fp = fopen(filename,"wb");
+    assert(fp!=0);
+    assert(bp_save(fp, &net) == 0);
+    fclose(fp);
+    fp = fopen(filename,"rb");
+    assert(fp!=0);
+    assert(bp_load(fp, &net2, &random_seed) == 0);
+    fclose(fp);
+    assert(net2.optimiser.type == OPTIMISER_ADAM);
+    assert(net2.optimiser.step == net.optimiser.step);
+    assert(net2.optimiser.correction1 == net.optimiser.correction1);
+    for (l = 1; l < net.HiddenLayers+2; l++) {
+        bp_layer * layer1 = &net.layer[l];
+        bp_layer * layer2 = &net2.layer[l];
+
+        assert(memcmp(layer1->moment2, layer2->moment2,
+                      layer1->NoOfUnits*layer1->NoOfInputs*
+                      sizeof(float)) == 0);
+        assert(memcmp(layer1->bias_moment2, layer2->bias_moment2,
+                      layer1->NoOfUnits*sizeof(float)) == 0);
+    }
+
+    /* so training continues where it left off */
+    net2.DropoutPercent = 0;
+    train_first_input(&net, 8);
+    train_first_input(&net2, 8);
+    assert(memcmp(net.layer[1].weights, net2.layer[1].weights,
+                  net.layer[1].NoOfUnits*net.layer[1].NoOfInputs*
+                  sizeof(float)) == 0);
+
+    bp_free(&net);
+    bp_free(&net2);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_prune()
+{
+    bp net;
+    bp_inference ctx;
+    int no_of_inputs=20;
+    int no_of_hiddens=16;
+    int hidden_layers=2;
+    int no_of_outputs=4;
+    int itt,i,l,b,zeros=0,zeros_trained;
+    unsigned int random_seed = 123;
+    float inputs[4*20], targets[4*4], sparse_outputs[4*4], dense_outputs[4*4];
+    float sparsity;
+
+    printf("test_backprop_prune...");
+
+    for (b = 0; b < 4; b++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            inputs[b*no_of_inputs + i] = 0.25f + (((b + i) % 3) * 0.25f);
+        }
+        for (i = 0; i < no_of_outputs; i++) {
+            targets[b*no_of_outputs + i] = (i == b) ? 0.75f : 0.25f;
+        }
+    }
+
+    bp_init(&net, no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs, &random_seed);
+    net.DropoutPercent = 0;
+    assert(bp_sparsity(&net) == 0);
+    assert(bp_prune(&net, -0.1f) == -1);
+    assert(bp_prune(&net, 1.0f) == -1);
+
+    assert(bp_prune(&net, 0.8f) == 0);
+    sparsity = bp_sparsity(&net);
+    assert(sparsity > 0.75f);
+    assert(sparsity <= 0.81f);
+    for (l = 1; l < hidden_layers+2; l++) {
+        bp_layer * layer = &net.layer[l];
+        assert(layer->sparse != 0);
+        for (i = 0; i < layer->NoOfUnits*layer->NoOfInputs; i++) {
+            if (layer->weights[i] == 0) zeros++;
+        }
+    }
+
+    /* pruned connections stay pruned during training */
+    for (itt = 0; itt < 100; itt++) {
+        b = itt % 4;
+        for (i = 0; i < no_of_inputs; i++) {
+            bp_set_input(&net, i, inputs[b*no_of_inputs + i]);
+        }
+        for (i = 0; i < no_of_outputs; i++) {
+            bp_set_output(&net, i, targets[b*no_of_outputs + i]);
+        }
+        bp_update(&net, 0);
+    }
+    assert(bp_update_batch(&net, inputs, targets, 4, 0) == 0);
+    zeros_trained = 0;
+    for (l = 1; l < hidden_layers+2; l++) {
+        bp_layer * layer = &net.layer[l];
+        bp_sparse * sparse = layer->sparse;
+        for (i = 0; i < layer->NoOfUnits*layer->NoOfInputs; i++) {
+            if (layer->weights[i] == 0) zeros_trained++;
+        }
+        /* the dense weights are kept in step */
+        for (i = 0; i < layer->NoOfUnits; i++) {
+            for (b = sparse->row_start[i]; b < sparse->row_start[i+1]; b++) {
+                assert(sparse->values[b] ==
+                       layer->weights[i*layer->NoOfInputs +
+                                      sparse->column[b]]);
+            }
+        }
+    }
+    assert(zeros_trained == zeros);
+
+    /* sparse evaluation gives the same result as the dense weights */
+    assert(bp_inference_init(&ctx, &net, 4) == 0);
+    assert(bp_infer(&net, &ctx, inputs, sparse_outputs, 4) == 0);
+    bp_sparse_free(&net);
+    assert(bp_sparsity(&net) == 0);
+    assert(bp_infer(&net, &ctx, inputs, dense_outputs, 4) == 0);
+    for (i = 0; i < 4*no_of_outputs; i++) {
+        assert(fabs(sparse_outputs[i] - dense_outputs[i]) < 0.0001f);
+    }
+    bp_inference_free(&ctx);
+
+    /* zero weights are treated as pruned */
+    assert(bp_prune(&net, 0) == 0);
+    assert(fabs(bp_sparsity(&net) - sparsity) < 0.0001f);
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_parallel()
+{
+    bp net1, net2;
+    int no_of_inputs=200;
+    int no_of_hiddens=64;
+    int hidden_layers=2;
+    int no_of_outputs=8;
+    int i,l,itt;
+    unsigned int random_seed = 123;
+
+    printf("test_backprop_parallel...");
+
+    /* large enough to be evaluated in parallel */
+    assert(no_of_inputs*no_of_hiddens >= BP_PARALLEL_MIN_WEIGHTS);
+
+    bp_init(&net1, no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs, &random_seed);
+    random_seed = 123;
+    bp_init(&net2, no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs, &random_seed);
+    net1.DropoutPercent = 10;
+    net2.DropoutPercent = 10;
+
+    /* noise comes from a counter based generator, so it
+       shouldn't depend upon the number of threads either */
+    net1.noise = 0.05f;
+    net2.noise = 0.05f;
+
+    for (i = 0; i < no_of_inputs; i++) {
+        bp_set_input(&net1, i, 0.25f + ((i%7)*0.5f/7.0f));
+        bp_set_input(&net2, i, 0.25f + ((i%7)*0.5f/7.0f));
+    }
+    for (i = 0; i < no_of_outputs; i++) {
+        bp_set_output(&net1, i, 0.25f + ((i%3)*0.25f));
+        bp_set_output(&net2, i, 0.25f + ((i%3)*0.25f));
+    }
+
+    /* the results should not depend upon the number of threads */
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+#endif
+    for (itt = 0; itt < 10; itt++) {
+#ifdef _OPENMP
+        omp_set_num_threads(1);
+#endif
+        bp_update(&net1, 0);
+#ifdef _OPENMP
+        omp_set_num_threads(4);
+#endif
+        bp_update(&net2, 0);
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+
+    for (l = 0; l < hidden_layers+2; l++) {
+        for (i = 0; i < net1.layer[l].NoOfUnits; i++) {
+            assert(net1.layer[l].units[i].BPerror ==
+                   net2.layer[l].units[i].BPerror);
+        }
+    }
+    assert(bp_compare(&net1, &net2) == 1);
+
+    bp_free(&net1);
+    bp_free(&net2);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_infer()
+{
+    bp net;
+    bp_inference ctx;
+    int no_of_inputs=200;
+    int no_of_hiddens=64;
+    int hidden_layers=2;
+    int no_of_outputs=8;
+    int batch_size=5;
+    int i,b,errors=0;
+    unsigned int random_seed = 123;
+    float * inputs, * outputs, * expected;
+
+    printf("test_backprop_infer...");
+
+    bp_init(&net, no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs, &random_seed);
+    net.DropoutPercent = 0;
+
+    inputs = (float*)malloc(batch_size*no_of_inputs*sizeof(float));
+    outputs = (float*)malloc(batch_size*no_of_outputs*sizeof(float));
+    expected = (float*)malloc(batch_size*no_of_outputs*sizeof(float));
+    assert(inputs);
+    assert(outputs);
+    assert(expected);
+
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            inputs[b*no_of_inputs + i] = 0.25f + (((i+b)%7)*0.5f/7.0f);
+        }
+    }
+
+    /* results from the training state */
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            bp_set_input(&net, i, inputs[b*no_of_inputs + i]);
+        }
+        bp_feed_forward(&net);
+        for (i = 0; i < no_of_outputs; i++) {
+            expected[b*no_of_outputs + i] = bp_get_output(&net, i);
+        }
+    }
+
+    assert(bp_inference_init(&ctx, &net, 0) != 0);
+    assert(bp_inference_init(&ctx, &net, batch_size) == 0);
+    assert(bp_infer(&net, &ctx, inputs, outputs, batch_size+1) != 0);
+    assert(bp_infer(&net, &ctx, inputs, outputs, batch_size) == 0);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(fabs(outputs[i] - expected[i]) < 0.0001f);
+    }
+    bp_inference_free(&ctx);
+
+    /* concurrent evaluation, each thread having its own context */
+#pragma omp parallel for private(i) reduction(+:errors)
+    for (b = 0; b < 16; b++) {
+        bp_inference thread_ctx;
+        float thread_outputs[8];
+        int s = b % batch_size;
+
+        if (bp_inference_init(&thread_ctx, &net, 1) != 0) {
+            errors++;
+            continue;
+        }
+        if (bp_infer(&net, &thread_ctx, &inputs[s*no_of_inputs],
+                     thread_outputs, 1) != 0) {
+            errors++;
+        }
+        for (i = 0; i < no_of_outputs; i++) {
+            if (fabs(thread_outputs[i] -
+                     expected[s*no_of_outputs + i]) >= 0.0001f) {
+                errors++;
+            }
+        }
+        bp_inference_free(&thread_ctx);
+    }
+    assert(errors == 0);
+
+    free(inputs);
+    free(outputs);
+    free(expected);
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_neutral_inputs()
+{
+    bp net, dense;
+    bp_inference ctx;
+    int no_of_inputs=256;
+    int no_of_hiddens=32;
+    int hidden_layers=2;
+    int no_of_outputs=4;
+    int batch_size=3;
+    int i,b;
+    unsigned int random_seed = 5672;
+    float * inputs, outputs[12], expected[12];
+    float error_threshold[] = { 0.1f, 0.1f, 0.1f };
+    deeplearn learner;
+
+    printf("test_backprop_neutral_inputs...");
+
+    bp_init(&net, no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs, &random_seed);
+    net.DropoutPercent = 0;
+
+    /* mostly padding, as with short text within a long field */
+    inputs = (float*)malloc(batch_size*no_of_inputs*sizeof(float));
+    assert(inputs);
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            if (i < 16*(b+1)) {
+                inputs[b*no_of_inputs + i] = ((i+b) % 3 == 0) ? 0.75f : 0.25f;
+            }
+            else {
+                inputs[b*no_of_inputs + i] = ENC_NEUTRAL;
+            }
+        }
+    }
+
+    /* the folded biases give the same results as all of the inputs */
+    assert(bp_clone(&dense, &net) == 0);
+    assert(bp_set_neutral_inputs(&net, 1) == 0);
+    assert(net.layer[1].neutral != 0);
+    assert(net.layer[2].neutral == 0);
+
+    /* other models coming and going leave the biases up to date */
+    assert(deeplearn_init(&learner, no_of_inputs, no_of_hiddens,
+                          hidden_layers, no_of_outputs,
+                          error_threshold, &random_seed) == 0);
+    deeplearn_free(&learner);
+    assert(net.layer[1].neutral->generation == net.generation);
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            bp_set_input(&net, i, inputs[b*no_of_inputs + i]);
+            bp_set_input(&dense, i, inputs[b*no_of_inputs + i]);
+        }
+        bp_feed_forward(&net);
+        bp_feed_forward(&dense);
+        for (i = 0; i < no_of_outputs; i++) {
+            expected[b*no_of_outputs + i] = bp_get_output(&dense, i);
+            assert(fabs(bp_get_output(&net, i) -
+                        expected[b*no_of_outputs + i]) < 0.0001f);
+        }
+    }
+    assert(net.layer[1].neutral->generation == net.generation);
+
+    assert(bp_inference_init(&ctx, &net, batch_size) == 0);
+    assert(ctx.changed != 0);
+    ctx.no_of_changed[0] = -1;
+    assert(bp_infer(&net, &ctx, inputs, outputs, batch_size) == 0);
+    assert(ctx.no_of_changed[0] == 16);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(fabs(outputs[i] - expected[i]) < 0.0001f);
+    }
+
+    /* while training, feed forward only folds the biases again once
+       the weights have stayed the same since the previous one */
+    for (i = 0; i < no_of_outputs; i++) {
+        bp_set_output(&net, i, 0.75f);
+    }
+    bp_update(&net, 0);
+    assert(net.layer[1].neutral->generation != net.generation);
+    bp_feed_forward(&net);
+    assert(net.layer[1].neutral->generation != net.generation);
+    bp_feed_forward(&net);
+    assert(net.layer[1].neutral->generation == net.generation);
+
+    /* whereas inference folds them again straight away */
+    bp_update(&net, 0);
+    assert(bp_copy_weights(&dense, &net) == 0);
+    assert(net.layer[1].neutral->generation != net.generation);
+    ctx.no_of_changed[0] = -1;
+    assert(bp_infer(&net, &ctx, inputs, outputs, batch_size) == 0);
+    assert(ctx.no_of_changed[0] == 16);
+    assert(net.layer[1].neutral->generation == net.generation);
+    assert(bp_infer(&dense, &ctx, inputs, expected, batch_size) == 0);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(fabs(outputs[i] - expected[i]) < 0.0001f);
+    }
+    bp_inference_free(&ctx);
+
+    /* clones keep folding neutral inputs */
+    bp_free(&dense);
+    assert(bp_clone(&dense, &net) == 0);
+    assert(dense.layer[1].neutral != 0);
+    assert(bp_set_neutral_inputs(&dense, 0) == 0);
+    assert(dense.layer[1].neutral == 0);
+
+    bp_free(&dense);
+    bp_free(&net);
+    free(inputs);
+
+    printf("Ok\n");
+}
+
+static void test_backprop_quantise()
+{
+    bp net;
+    bp_inference ctx;
+    int no_of_inputs=200;
+    int no_of_hiddens=64;
+    int hidden_layers=2;
+    int no_of_outputs=8;
+    int samples=16;
+    int i,b,a,granularity;
+    int activation[2] = { AF_LOGISTIC, AF_TANH };
+    unsigned int random_seed = 123;
+    float * inputs, * outputs, * expected, tolerance;
+
+    printf("test_backprop_quantise...");
+
+    inputs = (float*)malloc(samples*no_of_inputs*sizeof(float));
+    outputs = (float*)malloc(samples*no_of_outputs*sizeof(float));
+    expected = (float*)malloc(samples*no_of_outputs*sizeof(float));
+    assert(inputs);
+    assert(outputs);
+    assert(expected);
+
+    for (i = 0; i < samples*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((rand_num(&random_seed)%10000)/20000.0f);
+    }
+
+    /* tanh hidden units have negative inputs to the next layer,
+       which use a zero point in the middle of the range */
+    for (a = 0; a < 2; a++) {
+        bp_init(&net, no_of_inputs, no_of_hiddens,
+                hidden_layers, no_of_outputs, &random_seed);
+        net.DropoutPercent = 0;
+        assert(bp_set_activation(&net, activation[a]) == 0);
+        assert(bp_inference_init(&ctx, &net, samples) == 0);
+
+        assert(bp_infer(&net, &ctx, inputs, expected, samples) == 0);
+        assert(net.inference_precision == KERNEL_FP32);
+        assert(bp_set_inference_precision(&net, KERNEL_INT8) != 0);
+        assert(bp_quantise(&net, 2, inputs, samples) != 0);
+        assert(bp_quantise(&net, BP_QUANT_PER_UNIT, inputs, 0) != 0);
+
+        for (granularity = BP_QUANT_PER_LAYER;
+             granularity <= BP_QUANT_PER_UNIT; granularity++) {
+            tolerance = (granularity == BP_QUANT_PER_UNIT) ? 0.01f : 0.02f;
+            assert(bp_quantise(&net, granularity, inputs, samples) == 0);
+            assert(net.inference_precision == KERNEL_INT8);
+            for (i = 1; i < hidden_layers+2; i++) {
+                assert(net.layer[i].quant != 0);
+            }
+
+            assert(bp_infer(&net, &ctx, inputs, outputs, samples) == 0);
+            for (i = 0; i < samples*no_of_outputs; i++) {
+                assert(fabs(outputs[i] - expected[i]) < tolerance);
+            }
+
+            /* the float weights are still available */
+            assert(bp_set_inference_precision(&net, KERNEL_FP32) == 0);
+            assert(bp_infer(&net, &ctx, inputs, outputs, samples) == 0);
+            for (i = 0; i < samples*no_of_outputs; i++) {
+                assert(fabs(outputs[i] - expected[i]) < 0.00001f);
+            }
+            assert(bp_set_inference_precision(&net, KERNEL_INT8) == 0);
+        }
+
+        /* single samples give the same results as the batch */
+        for (b = 0; b < samples; b++) {
+            float single[8];
+            assert(bp_infer(&net, &ctx, &inputs[b*no_of_inputs],
+                            single, 1) == 0);
+            assert(bp_infer(&net, &ctx, inputs, outputs, samples) == 0);
+            for (i = 0; i < no_of_outputs; i++) {
+                assert(single[i] == outputs[b*no_of_outputs + i]);
+            }
+        }
+
+        bp_quant_free(&net);
+        assert(net.inference_precision == KERNEL_FP32);
+        assert(net.layer[1].quant == 0);
+        assert(bp_set_inference_precision(&net, KERNEL_INT8) != 0);
+
+        bp_inference_free(&ctx);
+        bp_free(&net);
+    }
+
+    free(inputs);
+    free(outputs);
+    free(expected);
+
+    printf("Ok\n");
+}
+
 static void test_backprop_training()
 {
     bp * net;
@@ -435,6 +1526,72 @@ static void test_backprop_training()
     printf("Ok\n");
 }
 
+static void test_backprop_activation()
+{
+    bp net;
+    int itt, example, af;
+    unsigned int random_seed = 123;
+    float state_TRUE = 0.8f;
+    float state_FALSE = 0.2f;
+    float inputs[4][2] = {
+        {0.2f, 0.2f}, {0.8f, 0.2f}, {0.2f, 0.8f}, {0.8f, 0.8f}
+    };
+    float targets[4] = {0.2f, 0.2f, 0.2f, 0.8f};
+    float initial_error, final_error;
+
+    printf("test_backprop_activation...");
+
+    for (af = 0; af < AF_FUNCTIONS; af++) {
+        random_seed = 123;
+        assert(bp_init(&net, 2, 4, 1, 1, &random_seed) == 0);
+        assert(net.activation == AF_LOGISTIC);
+        assert(bp_set_activation(&net, -1) == -1);
+        assert(bp_set_activation(&net, AF_FUNCTIONS) == -1);
+        assert(bp_set_activation(&net, af) == 0);
+        assert(net.activation == af);
+
+        /* learn logical AND */
+        initial_error = 0;
+        for (example = 0; example < 4; example++) {
+            bp_set_input(&net, 0, inputs[example][0]);
+            bp_set_input(&net, 1, inputs[example][1]);
+            bp_feed_forward(&net);
+            initial_error += fabs(bp_get_output(&net, 0) - targets[example]);
+        }
+        example = 0;
+        for (itt = 0; itt < 20000; itt++, example++) {
+            if (example >= 4) example = 0;
+            bp_set_input(&net, 0, inputs[example][0]);
+            bp_set_input(&net, 1, inputs[example][1]);
+            bp_set_output(&net, 0, targets[example]);
+            bp_update(&net, 0);
+        }
+        final_error = 0;
+        for (example = 0; example < 4; example++) {
+            bp_set_input(&net, 0, inputs[example][0]);
+            bp_set_input(&net, 1, inputs[example][1]);
+            bp_feed_forward(&net);
+            final_error += fabs(bp_get_output(&net, 0) - targets[example]);
+        }
+        if (final_error >= initial_error*0.6f) {
+            printf("\n%s %.5f %.5f\n", kernel_af_name(af),
+                   initial_error, final_error);
+        }
+        assert(final_error < initial_error*0.6f);
+
+        /* the output layer is always logistic */
+        bp_set_input(&net, 0, state_TRUE);
+        bp_set_input(&net, 1, state_FALSE);
+        bp_feed_forward(&net);
+        assert(bp_get_output(&net, 0) > 0);
+        assert(bp_get_output(&net, 0) < 1);
+
+        bp_free(&net);
+    }
+
+    printf("Ok\n");
+}
+
 static void test_backprop_autocoder()
 {
     bp autocoder;
@@ -542,6 +1699,7 @@ static void test_backprop_save_load()
             no_of_inputs, no_of_hiddens,
             hidden_layers, no_of_outputs,
             &random_seed);
+    assert(bp_set_activation(&net1, AF_LEAKY_RELU) == 0);
 
     sprintf(filename,"%stemp_deep.dat",DEEPLEARN_TEMP_DIRECTORY);
 
@@ -563,6 +1721,7 @@ static void test_backprop_save_load()
         printf("\nretval = %d\n",retval);
     }
     assert(retval==1);
+    assert(net2.activation == AF_LEAKY_RELU);
 
     /* free memory */
     bp_free(&net1);
@@ -571,6 +1730,69 @@ static void test_backprop_save_load()
     printf("Ok\n");
 }
 
+static void test_backprop_load_unversioned()
+{
+    bp net1, net2;
+    int no_of_inputs=10;
+    int no_of_hiddens=4;
+    int no_of_outputs=3;
+    int hidden_layers=2;
+    int i, l;
+    unsigned int random_seed = 123;
+    char filename[256];
+    FILE * fp;
+
+    printf("test_backprop_load_unversioned...");
+
+    bp_init(&net1,
+            no_of_inputs, no_of_hiddens,
+            hidden_layers, no_of_outputs,
+            &random_seed);
+    assert(bp_freeze_layer(&net1, 0, 1) == 0);
+
+    sprintf(filename,"%stemp_deep.dat",DEEPLEARN_TEMP_DIRECTORY);
+
+    /* a network saved before the format had a version, without the
+       activation function, optimiser or frozen layers */
+    fp = fopen(filename,"wb");
+    assert(fp!=0);
+    assert(fwrite(&net1.itterations, sizeof(unsigned int), 1, fp) == 1);
+    assert(fwrite(&net1.NoOfInputs, sizeof(int), 1, fp) == 1);
+    assert(fwrite(&net1.NoOfHiddens, sizeof(int), 1, fp) == 1);
+    assert(fwrite(&net1.NoOfOutputs, sizeof(int), 1, fp) == 1);
+    assert(fwrite(&net1.HiddenLayers, sizeof(int), 1, fp) == 1);
+    assert(fwrite(&net1.learningRate, sizeof(float), 1, fp) == 1);
+    assert(fwrite(&net1.noise, sizeof(float), 1, fp) == 1);
+    assert(fwrite(&net1.BPerrorAverage, sizeof(float), 1, fp) == 1);
+    assert(fwrite(&net1.DropoutPercent, sizeof(float), 1, fp) == 1);
+    for (l = 0; l < hidden_layers; l++) {
+        for (i = 0; i < bp_hiddens_in_layer(&net1,l); i++) {
+            assert(bp_neuron_save(fp, net1.hiddens[l][i]) == 0);
+        }
+    }
+    for (i = 0; i < no_of_outputs; i++) {
+        assert(bp_neuron_save(fp, net1.outputs[i]) == 0);
+    }
+    fclose(fp);
+
+    fp = fopen(filename,"rb");
+    assert(fp!=0);
+    assert(bp_load(fp, &net2, &random_seed) == 0);
+    fclose(fp);
+
+    /* the weights are loaded and everything else takes its default */
+    assert(net2.activation == AF_LOGISTIC);
+    assert(net2.optimiser.type == net1.optimiser.type);
+    assert(bp_frozen_layers(&net2) == 0);
+    assert(bp_freeze_layer(&net1, 0, 0) == 0);
+    assert(bp_compare(&net1, &net2) == 1);
+
+    bp_free(&net1);
+    bp_free(&net2);
+
+    printf("Ok\n");
+}
+
 static void test_backprop_classification_from_filename()
 {
     char classification[256];
@@ -612,13 +1834,28 @@ int run_tests_backprop()
     test_backprop_neuron_init();
     test_backprop_neuron_copy();
     test_backprop_init();
+    test_backprop_packed_layers();
+    test_backprop_arena();
+    test_backprop_clone();
     test_backprop_feed_forward();
     test_backprop1();
     test_backprop2();
     test_backprop_update();
+    test_backprop_update_batch();
+    test_backprop_update_hogwild();
+    test_backprop_freeze();
+    test_backprop_gradients();
+    test_backprop_optimisers();
+    test_backprop_prune();
+    test_backprop_parallel();
+    test_backprop_infer();
+    test_backprop_neutral_inputs();
+    test_backprop_quantise();
     test_backprop_training();
+    test_backprop_activation();
     test_backprop_neuron_save_load();
     test_backprop_save_load();
+    test_backprop_load_unversioned();
     test_backprop_inputs_from_image();
     test_backprop_autocoder();
     test_backprop_classification_from_filename();
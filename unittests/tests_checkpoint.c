@@ -0,0 +1,184 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_checkpoint.h"
+
+static long file_size(char * filename)
+{
+    long size;
+    FILE * fp = fopen(filename, "rb");
+
+    assert(fp);
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+static void test_checkpoint_learner()
+{
+    deeplearn learner, loaded;
+    deeplearn_checkpointer checkpointer;
+    int no_of_inputs=10, no_of_hiddens=8, hidden_layers=3, no_of_outputs=2;
+    float error_threshold[] = { 0.1f, 0.1f, 0.1f, 0.1f };
+    unsigned int random_seed = 123;
+    char * plain_filename = "/tmp/libdeep_checkpoint_plain.ckpt";
+    char * compressed_filename = "/tmp/libdeep_checkpoint.ckpt";
+    float inputs[10], expected[2], weight;
+    int i;
+    FILE * fp;
+
+    printf("test_checkpoint_learner...");
+
+    assert(deeplearn_init(&learner, no_of_inputs, no_of_hiddens,
+                          hidden_layers, no_of_outputs,
+                          error_threshold, &random_seed) == 0);
+    remove(plain_filename);
+    remove(compressed_filename);
+
+    /* uncompressed */
+    assert(deeplearn_checkpointer_init(&checkpointer, 0) == 0);
+    assert(deeplearn_checkpointer_post(&checkpointer, &learner,
+                                       plain_filename) >= 0);
+    deeplearn_checkpointer_flush(&checkpointer);
+    assert(checkpointer.written == 1);
+    assert(checkpointer.failed == 0);
+    assert(checkpointer.stored_size == checkpointer.raw_size);
+    deeplearn_checkpointer_free(&checkpointer);
+
+    /* compressed, with the learner changing after it was posted */
+    assert(deeplearn_checkpointer_init(&checkpointer,
+                                       DEEPLEARN_CHECKPOINT_COMPRESS) == 0);
+    assert(deeplearn_checkpointer_post(&checkpointer, &learner,
+                                       compressed_filename) >= 0);
+    for (i = 0; i < no_of_inputs; i++) {
+        inputs[i] = 0.25f + (i*0.05f);
+        deeplearn_set_input(&learner, i, inputs[i]);
+    }
+    deeplearn_feed_forward(&learner);
+    for (i = 0; i < no_of_outputs; i++) {
+        expected[i] = deeplearn_get_output(&learner, i);
+    }
+    weight = learner.net->layer[1].weights[0];
+    learner.net->layer[1].weights[0] = weight + 1.0f;
+
+    /* the file is only replaced once complete */
+    deeplearn_checkpointer_free(&checkpointer);
+    assert(checkpointer.written == 1);
+    assert(checkpointer.stored_size < checkpointer.raw_size);
+    assert(file_size(compressed_filename) < file_size(plain_filename));
+    fp = fopen("/tmp/libdeep_checkpoint.ckpt.tmp", "rb");
+    assert(fp == NULL);
+
+    assert(deeplearn_checkpoint_load(compressed_filename, &loaded,
+                                     &random_seed) == 0);
+    assert(loaded.net->layer[1].weights[0] == weight);
+    for (i = 0; i < no_of_inputs; i++) {
+        deeplearn_set_input(&loaded, i, inputs[i]);
+    }
+    deeplearn_feed_forward(&loaded);
+    for (i = 0; i < no_of_outputs; i++) {
+        assert(deeplearn_get_output(&loaded, i) == expected[i]);
+    }
+    deeplearn_free(&loaded);
+
+    /* the uncompressed checkpoint loads in the same way */
+    assert(deeplearn_checkpoint_load(plain_filename, &loaded,
+                                     &random_seed) == 0);
+    learner.net->layer[1].weights[0] = weight;
+    assert(deeplearn_compare(&loaded, &learner) == 1);
+    deeplearn_free(&loaded);
+
+    /* a learner checkpoint is not a convnet */
+    assert(deepconvnet_checkpoint_load(plain_filename, NULL,
+                                       &random_seed) != 0);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_checkpoint_convnet()
+{
+    deepconvnet convnet, loaded;
+    deeplearn_checkpointer checkpointer;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 7423;
+    char * filename = "/tmp/libdeep_checkpoint_convnet.ckpt";
+    int i, posted = 0;
+
+    printf("test_checkpoint_convnet...");
+
+    assert(deepconvnet_init(2, 2, 32, 32, 3, 8, 2, 4,
+                            &convnet, error_threshold,
+                            &random_seed) == 0);
+    assert(deepconvnet_init(2, 2, 32, 32, 3, 8, 2, 4,
+                            &loaded, error_threshold,
+                            &random_seed) == 0);
+
+    /* posting more often than the worker can write replaces
+       pending snapshots */
+    assert(deeplearn_checkpointer_init(&checkpointer,
+                                       DEEPLEARN_CHECKPOINT_COMPRESS) == 0);
+    for (i = 0; i < 8; i++) {
+        assert(deeplearn_checkpointer_post_convnet(&checkpointer, &convnet,
+                                                   filename) >= 0);
+        posted++;
+    }
+    deeplearn_checkpointer_flush(&checkpointer);
+    assert(checkpointer.written + checkpointer.dropped == posted);
+    assert(checkpointer.failed == 0);
+    deeplearn_checkpointer_free(&checkpointer);
+
+    deeplearn_free(loaded.learner);
+    conv_free(loaded.convolution);
+    assert(deepconvnet_checkpoint_load(filename, &loaded,
+                                       &random_seed) == 0);
+    for (i = 0; i < convnet.convolution->no_of_layers; i++) {
+        assert(autocoder_compare(loaded.convolution->layer[i].autocoder,
+                                 convnet.convolution->layer[i].autocoder) == 0);
+    }
+    assert(deeplearn_compare(loaded.learner, convnet.learner) == 1);
+
+    deepconvnet_free(&loaded);
+    deepconvnet_free(&convnet);
+
+    printf("Ok\n");
+}
+
+int run_tests_checkpoint()
+{
+    printf("\nRunning checkpoint tests\n");
+
+    test_checkpoint_learner();
+    test_checkpoint_convnet();
+
+    printf("All checkpoint tests completed\n");
+    return 1;
+}
@@ -49,7 +49,11 @@ static void test_conv_init()
                      reduction_factor, pooling_factor,
                      &conv, error_threshold,
                      &random_seed) == 0);
+
+    /* the layer arrays should fill the arena exactly */
+    assert(conv.arena.used == conv.arena.size);
     conv_free(&conv);
+    assert(conv.arena.block == 0);
 
     printf("Ok\n");
 }
@@ -164,6 +168,134 @@ static void test_conv_image()
     printf("Ok\n");
 }
 
+static void test_conv_gemm_backend()
+{
+    printf("test_conv_gemm_backend...");
+
+    unsigned int img_width = 128;
+    unsigned int img_height = 128;
+    int no_of_layers = 3;
+    int max_features = 20;
+    int reduction_factor = 6;
+    int pooling_factor = 2;
+    float error_threshold[] = {0.0, 0.0, 0.0};
+    unsigned int random_seed = 648326;
+    unsigned char * img;
+    float * expected[3];
+    deeplearn_conv conv;
+    int i, j, layer_size;
+
+    img = (unsigned char*)malloc(img_width*img_height*sizeof(unsigned char));
+    assert(img);
+    for (i = 0; i < img_width*img_height; i++) {
+        img[i] = (unsigned char)(rand_num(&random_seed)%256);
+    }
+
+    assert(conv_init(no_of_layers,
+                     img_width, img_height,
+                     1, max_features,
+                     reduction_factor, pooling_factor,
+                     &conv, error_threshold,
+                     &random_seed) == 0);
+    assert(conv_set_backend(&conv, 99) != 0);
+
+    /* no learning, so that all layers are convolved */
+    conv.training_complete = 1;
+
+    assert(conv_img(img, &conv, 0) == 0);
+    for (i = 0; i < no_of_layers; i++) {
+        layer_size = convolution_layer_units(i, &conv);
+        expected[i] = (float*)malloc(layer_size*sizeof(float));
+        assert(expected[i]);
+        memcpy(expected[i], conv.layer[i].convolution,
+               layer_size*sizeof(float));
+    }
+
+    assert(conv_set_backend(&conv, CONV_BACKEND_GEMM) == 0);
+    assert(conv_img(img, &conv, 0) == 0);
+    for (i = 0; i < no_of_layers; i++) {
+        layer_size = convolution_layer_units(i, &conv);
+        for (j = 0; j < layer_size; j++) {
+            assert(fabs(conv.layer[i].convolution[j] -
+                        expected[i][j]) < 0.0001f);
+        }
+        free(expected[i]);
+    }
+
+    conv_free(&conv);
+    free(img);
+
+    printf("Ok\n");
+}
+
+static void test_conv_img_flt()
+{
+    printf("test_conv_img_flt...");
+
+    int img_width = 64;
+    int img_height = 64;
+    int no_of_layers = 2;
+    int max_features = 10;
+    int reduction_factor = 4;
+    int pooling_factor = 2;
+    float error_threshold[] = {0.0, 0.0};
+    unsigned int random_seed = 7352;
+    unsigned char * img;
+    float * img_flt, * expected[2];
+    deeplearn_conv conv;
+    int i, j, layer_size;
+
+    img = (unsigned char*)malloc(img_width*img_height*3*sizeof(unsigned char));
+    img_flt = (float*)malloc(img_width*img_height*3*sizeof(float));
+    assert(img);
+    assert(img_flt);
+    for (i = 0; i < img_width*img_height*3; i++) {
+        img[i] = (unsigned char)(rand_num(&random_seed)%256);
+    }
+
+    /* same resolution, so the float plane holds the normalised pixels */
+    assert(deeplearn_resample_to_flt(img, img_width, img_height, 3,
+                                     img_flt, img_width, img_height, 3,
+                                     DEEPLEARN_RESAMPLE_NEAREST) == 0);
+    for (i = 0; i < img_width*img_height*3; i++) {
+        assert(img_flt[i] == PIXEL_TO_FLOAT(img[i]));
+    }
+
+    assert(conv_init(no_of_layers,
+                     img_width, img_height,
+                     3, max_features,
+                     reduction_factor, pooling_factor,
+                     &conv, error_threshold,
+                     &random_seed) == 0);
+    conv.training_complete = 1;
+
+    assert(conv_img(img, &conv, 0) == 0);
+    for (i = 0; i < no_of_layers; i++) {
+        layer_size = convolution_layer_units(i, &conv);
+        expected[i] = (float*)malloc(layer_size*sizeof(float));
+        assert(expected[i]);
+        memcpy(expected[i], conv.layer[i].convolution,
+               layer_size*sizeof(float));
+    }
+
+    /* convolving the float plane should give the same result */
+    assert(conv_img_flt(img_flt, &conv, 0) == 0);
+    for (i = 0; i < no_of_layers; i++) {
+        layer_size = convolution_layer_units(i, &conv);
+        for (j = 0; j < layer_size; j++) {
+            assert(fabs(conv.layer[i].convolution[j] -
+                        expected[i][j]) < 0.0001f);
+        }
+        free(expected[i]);
+    }
+
+    conv_free(&conv);
+    free(img);
+    free(img_flt);
+
+    printf("Ok\n");
+}
+
 static void test_conv_save_load()
 {
     printf("test_conv_save_load...");
@@ -408,14 +540,74 @@ static void test_deconv_image()
 	printf("Ok\n");
 }
 
+static void test_deconv_layers()
+{
+    printf("test_deconv_layers...");
+
+    int img_width = 64;
+    int img_height = 64;
+    int no_of_layers = 2;
+    float error_threshold[] = {0.0, 0.0};
+    unsigned int random_seed = 7261;
+    unsigned char * img, * img2, * img3;
+    deeplearn_conv conv;
+    float * pooling[2];
+
+    img = (unsigned char*)malloc(img_width*img_height*3);
+    img2 = (unsigned char*)malloc(img_width*img_height*3);
+    img3 = (unsigned char*)malloc(img_width*img_height*3);
+    assert(img && img2 && img3);
+    for (int i = 0; i < img_width*img_height*3; i++) {
+        img[i] = (unsigned char)(rand_num(&random_seed)%256);
+    }
+
+    assert(conv_init(no_of_layers, img_width, img_height, 3, 16,
+                     4, 2, &conv, error_threshold, &random_seed) == 0);
+    conv.training_complete = 1;
+    assert(conv_img(img, &conv, 0) == 0);
+
+    for (int l = 0; l < no_of_layers; l++) {
+        int units = conv_layer_width(l, &conv, 1) *
+            conv_layer_height(l, &conv, 1) *
+            conv_layer_features(&conv, l);
+        pooling[l] = (float*)malloc(units*sizeof(float));
+        memcpy((void*)pooling[l], (void*)conv.layer[l].pooling,
+               units*sizeof(float));
+    }
+
+    /* deconvolution from each layer, which doesn't alter the layers */
+    assert(deconv_img(1, &conv, img2) == 0);
+    assert(deconv_img(0, &conv, img3) == 0);
+    assert(deconv_img(1, &conv, img3) == 0);
+    assert(memcmp(img2, img3, img_width*img_height*3) == 0);
+    for (int l = 0; l < no_of_layers; l++) {
+        int units = conv_layer_width(l, &conv, 1) *
+            conv_layer_height(l, &conv, 1) *
+            conv_layer_features(&conv, l);
+        assert(memcmp(pooling[l], conv.layer[l].pooling,
+                      units*sizeof(float)) == 0);
+        free(pooling[l]);
+    }
+
+    conv_free(&conv);
+    free(img);
+    free(img2);
+    free(img3);
+
+    printf("Ok\n");
+}
+
 int run_tests_conv()
 {
 	printf("\nRunning convolution tests\n");
 
 	test_conv_init();
 	test_conv_image();
+	test_conv_gemm_backend();
+	test_conv_img_flt();
 	test_conv_save_load();
 	test_deconv_image();
+	test_deconv_layers();
 
 	printf("All convolution tests completed\n");
 	return 1;
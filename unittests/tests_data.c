@@ -215,6 +215,227 @@ static void test_data_training_test()
         assert(test_sample->outputs[j] == j);
     }
 
+    /* every labeled sample is tested within exactly one fold */
+    int tested[100];
+    memset((void*)tested, '\0', 100*sizeof(int));
+    for (int fold = 0; fold < 5; fold++) {
+        assert(deeplearndata_split_kfold(&learner, 5, fold,
+                                         DEEPLEARN_SPLIT_STRATIFIED,
+                                         5326) == 0);
+        assert(learner.training_data_samples +
+               learner.test_data_samples == 100);
+        assert(learner.test_data_samples >= 19);
+        assert(learner.test_data_samples <= 20);
+        for (int i = 0; i < learner.test_data_samples; i++) {
+            test_sample = deeplearndata_get_test(&learner, i);
+            assert(test_sample->labeled == 1);
+            tested[(int)test_sample->inputs[0]]++;
+        }
+    }
+    for (int i = 0; i < 100; i++) {
+        assert(tested[i] == ((i != 54) && (i != 79) && (i != 23)));
+    }
+
+    /* reshuffling keeps the same training samples */
+    deeplearndata_shuffle_training(&learner);
+    assert(learner.indexed_training_data_samples == 81);
+    memset((void*)tested, '\0', 100*sizeof(int));
+    for (int i = 0; i < learner.indexed_training_data_samples; i++) {
+        tested[(int)deeplearndata_get_training(&learner, i)->inputs[0]]++;
+    }
+    for (int i = 0; i < learner.test_data_samples; i++) {
+        tested[(int)deeplearndata_get_test(&learner, i)->inputs[0]]++;
+    }
+    for (int i = 0; i < 100; i++) {
+        assert(tested[i] == 1);
+    }
+
+    /* free memory */
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_data_epochs()
+{
+    deeplearn learner;
+    int no_of_inputs=10;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.0f, 0.0f, 0.0f };
+    unsigned int random_seed = 5621;
+    char ** inputs_text = 0;
+    float inputs[10], outputs[2];
+
+    printf("test_data_epochs...");
+
+    deeplearn_init(&learner,
+                   no_of_inputs, no_of_hiddens,
+                   hidden_layers,
+                   no_of_outputs,
+                   error_threshold,
+                   &random_seed);
+
+    for (int i = 0; i < 100; i++) {
+        for (int j = 0; j < no_of_inputs; j++) {
+            inputs[j] = (float)((i*(j+1))%10);
+        }
+        for (int j = 0; j < no_of_outputs; j++) {
+            outputs[j] = (float)((i+j)%2);
+        }
+        assert(deeplearndata_add(&learner.data,
+                                 &learner.data_samples,
+                                 inputs, inputs_text, outputs,
+                                 no_of_inputs, no_of_outputs,
+                                 learner.input_range_min,
+                                 learner.input_range_max,
+                                 learner.output_range_min,
+                                 learner.output_range_max) == 0);
+    }
+    assert(deeplearndata_index_data(learner.data, learner.data_samples,
+                                    &learner.indexed_data,
+                                    &learner.indexed_data_samples) == 0);
+    assert(deeplearndata_create_datasets(&learner, 20) == 0);
+    assert(learner.training_data_samples == 80);
+
+    deeplearndata_set_epochs(&learner, 1);
+    assert(deeplearndata_get_epochs(&learner) == 0);
+    assert(deeplearndata_get_epoch_error(&learner) == DEEPLEARN_UNKNOWN_ERROR);
+
+    /* an epoch is complete once every training sample has been visited */
+    for (int i = 0; i < 79; i++) {
+        assert(deeplearndata_training(&learner) == 1);
+        assert(learner.epoch.position == i + 1);
+    }
+    assert(deeplearndata_get_epochs(&learner) == 0);
+    assert(deeplearndata_training(&learner) == 1);
+    assert(deeplearndata_get_epochs(&learner) == 1);
+    assert(learner.epoch.position == 0);
+    assert(deeplearndata_get_epoch_error(&learner) >= 0);
+    assert(deeplearndata_get_epoch_error(&learner) != DEEPLEARN_UNKNOWN_ERROR);
+
+    /* batches do not cross the end of an epoch */
+    assert(deeplearndata_training_batch(&learner, 30) == 1);
+    assert(learner.epoch.position == 30);
+    assert(deeplearndata_training_batch(&learner, 30) == 1);
+    assert(learner.epoch.position == 60);
+    assert(deeplearndata_training_batch(&learner, 30) == 1);
+    assert(learner.epoch.position == 0);
+    assert(deeplearndata_get_epochs(&learner) == 2);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_data_arena()
+{
+    deeplearn learner;
+    deeplearndata_arena arena;
+    int no_of_inputs=10;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    float inputs[10], outputs[2];
+    int used[100];
+    char ** inputs_text = 0;
+    deeplearndata * sample;
+
+    printf("test_data_arena...");
+
+    /* create the learner */
+    deeplearn_init(&learner,
+                   no_of_inputs, no_of_hiddens,
+                   hidden_layers,
+                   no_of_outputs,
+                   error_threshold,
+                   &random_seed);
+
+    /* a small initial capacity so that the arena has to grow */
+    assert(deeplearndata_arena_init(&arena, no_of_inputs,
+                                    no_of_outputs, 8) == 0);
+    for (int i = 0; i < 100; i++) {
+        for (int j = 0; j < no_of_inputs; j++) {
+            inputs[j] = i;
+        }
+        for (int j = 0; j < no_of_outputs; j++) {
+            outputs[j] = j;
+            if ((i == 54) || (i == 79) || (i == 23)) {
+                outputs[j] = DEEPLEARN_UNKNOWN_VALUE;
+            }
+        }
+        assert(deeplearndata_arena_add(&arena,
+                                       inputs, inputs_text, outputs,
+                                       learner.input_range_min,
+                                       learner.input_range_max,
+                                       learner.output_range_min,
+                                       learner.output_range_max) == 0);
+    }
+    assert(arena.samples == 100);
+    assert(arena.capacity >= 100);
+    assert((uintptr_t)arena.inputs % DEEPLEARNDATA_ARENA_ALIGNMENT == 0);
+    assert((uintptr_t)arena.outputs % DEEPLEARNDATA_ARENA_ALIGNMENT == 0);
+
+    assert(deeplearndata_arena_attach(&learner, &arena) == 0);
+    assert(arena.sample == 0);
+    assert(learner.data_samples == 100);
+
+    /* samples are stored in order, within contiguous arrays */
+    sample = learner.data;
+    for (int i = 0; i < 100; i++) {
+        assert(sample != 0);
+        assert(sample == deeplearndata_get(&learner, i));
+        assert(sample->inputs == &learner.arena.inputs[i*no_of_inputs]);
+        assert(sample->outputs == &learner.arena.outputs[i*no_of_outputs]);
+        assert((int)sample->inputs[no_of_inputs-1] == i);
+        assert(sample->labeled == ((i != 54) && (i != 79) && (i != 23)));
+        sample = sample->next;
+    }
+    assert(sample == 0);
+
+    assert(deeplearndata_create_datasets(&learner, 20) == 0);
+    assert(learner.training_data_samples + learner.test_data_samples == 100);
+    assert(learner.training_data_labeled_samples +
+           learner.test_data_samples == 97);
+    assert(learner.test_data_samples <= 20);
+    assert(learner.indexed_training_data_samples ==
+           learner.training_data_samples);
+    assert(learner.indexed_training_data_labeled_samples ==
+           learner.training_data_labeled_samples);
+    assert(learner.indexed_test_data_samples == learner.test_data_samples);
+
+    /* every sample is either within the training or the test set */
+    memset((void*)used, '\0', 100*sizeof(int));
+    for (int i = 0; i < learner.training_data_samples; i++) {
+        sample = deeplearndata_get_training(&learner, i);
+        assert(sample != 0);
+        used[(int)sample->inputs[0]]++;
+    }
+    for (int i = 0; i < learner.test_data_samples; i++) {
+        sample = deeplearndata_get_test(&learner, i);
+        assert(sample != 0);
+        assert(sample->labeled == 1);
+        used[(int)sample->inputs[0]]++;
+    }
+    for (int i = 0; i < 100; i++) {
+        assert(used[i] == 1);
+    }
+    for (int i = 0; i < learner.training_data_labeled_samples; i++) {
+        sample = deeplearndata_get_training_labeled(&learner, i);
+        assert(sample != 0);
+        assert(sample->labeled == 1);
+        assert(sample->flags == 1);
+    }
+    assert(deeplearndata_get_training(&learner,
+                                      learner.training_data_samples) == 0);
+
+    /* recreating the data sets reuses the index vectors */
+    assert(deeplearndata_create_datasets(&learner, 50) == 0);
+    assert(learner.training_data_samples + learner.test_data_samples == 100);
+
     /* free memory */
     deeplearn_free(&learner);
 
@@ -253,12 +474,213 @@ static void test_read_images()
     printf("Ok\n");
 }
 
+static void test_data_activations()
+{
+    deeplearn learner;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=2;
+    float error_threshold[] = { 100.0f, 100.0f, 100.0f, 0.0f };
+    unsigned int random_seed = 6713;
+    char ** inputs_text = 0;
+    float inputs[10], outputs[2];
+    int i, steps = 0;
+
+    printf("test_data_activations...");
+
+    deeplearn_init(&learner,
+                   no_of_inputs, no_of_hiddens,
+                   hidden_layers,
+                   no_of_outputs,
+                   error_threshold,
+                   &random_seed);
+
+    for (i = 0; i < 50; i++) {
+        for (int j = 0; j < no_of_inputs; j++) {
+            inputs[j] = (float)((i*(j+1))%10);
+        }
+        for (int j = 0; j < no_of_outputs; j++) {
+            outputs[j] = (float)((i+j)%2);
+        }
+        assert(deeplearndata_add(&learner.data,
+                                 &learner.data_samples,
+                                 inputs, inputs_text, outputs,
+                                 no_of_inputs, no_of_outputs,
+                                 learner.input_range_min,
+                                 learner.input_range_max,
+                                 learner.output_range_min,
+                                 learner.output_range_max) == 0);
+    }
+    assert(deeplearndata_index_data(learner.data, learner.data_samples,
+                                    &learner.indexed_data,
+                                    &learner.indexed_data_samples) == 0);
+    assert(deeplearndata_create_datasets(&learner, 20) == 0);
+    assert(learner.training_data_samples == 40);
+
+    deeplearn_activations_enable(&learner);
+    assert(deeplearn_activations_current(&learner) == 0);
+
+    for (int layer = 1; layer < hidden_layers; layer++) {
+        while (learner.current_hidden_layer < layer) {
+            assert(deeplearndata_training(&learner) == 1);
+            assert(steps++ < 10000);
+        }
+
+        /* the outputs of the frozen layer are cached for each sample */
+        assert(deeplearn_activations_current(&learner) != 0);
+        assert(learner.activations.layer == layer - 1);
+        assert(learner.activations.samples == 40);
+        for (i = 0; i < learner.training_data_samples; i++) {
+            deeplearndata * sample = deeplearndata_get_training(&learner, i);
+            assert(sample->activations != 0);
+            deeplearn_set_inputs(&learner, sample);
+            bp_feed_forward_layers(learner.net, layer);
+            for (int h = 0; h < bp_hiddens_in_layer(learner.net, layer - 1); h++) {
+                float diff = sample->activations[h] -
+                    bp_get_hidden(learner.net, layer - 1, h);
+                assert(diff > -0.0001f);
+                assert(diff < 0.0001f);
+            }
+        }
+    }
+
+    /* pretraining on the cached outputs */
+    unsigned int itterations = learner.autocoder[2]->itterations;
+    assert(deeplearndata_training(&learner) == 1);
+    assert(learner.autocoder[2]->itterations == itterations + 1);
+
+    /* the cache is no longer needed once the whole network is trained */
+    while (learner.current_hidden_layer < hidden_layers) {
+        assert(deeplearndata_training(&learner) == 1);
+        assert(steps++ < 10000);
+    }
+    assert(deeplearn_activations_current(&learner) == 0);
+    assert(learner.activations.values == 0);
+    assert(deeplearndata_get_training(&learner, 0)->activations == 0);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+/* source of samples generated on demand, as if read from a file
+   which is too large to be held in memory */
+struct test_stream_source {
+    int position, length;
+    char text[32][8];
+};
+
+static int test_stream_next_batch(deeplearn_stream_batch * batch, void * data)
+{
+    struct test_stream_source * source = (struct test_stream_source*)data;
+    int b;
+
+    for (b = 0; b < batch->capacity; b++) {
+        int i = source->position;
+        float * inputs = &batch->inputs[b*batch->no_of_input_fields];
+        float * outputs = &batch->outputs[b*batch->no_of_outputs];
+
+        if (i >= source->length) break;
+        inputs[0] = (float)(i % 7);
+        inputs[1] = (float)(i % 3) * 10;
+        outputs[0] = (i % 5 == 0) ? DEEPLEARN_UNKNOWN_VALUE : (float)(i % 2);
+        if (batch->inputs_text != 0) {
+            sprintf(source->text[b], "%d", i);
+            batch->inputs_text[b*batch->no_of_input_fields] = 0;
+            batch->inputs_text[b*batch->no_of_input_fields + 1] = 0;
+            batch->inputs_text[b*batch->no_of_input_fields + 2] =
+                source->text[b];
+        }
+        source->position++;
+    }
+    batch->samples = b;
+    return 0;
+}
+
+static int test_stream_reset(void * data)
+{
+    ((struct test_stream_source*)data)->position = 0;
+    return 0;
+}
+
+static void test_data_stream()
+{
+    deeplearn learner;
+    deeplearn_stream stream;
+    struct test_stream_source source;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    int itt, retval;
+
+    printf("test_data_stream...");
+
+    /* numeric fields, read over several epochs */
+    source.position = 0;
+    source.length = 50;
+    assert(deeplearn_stream_init(&stream, test_stream_next_batch,
+                                 test_stream_reset, &source,
+                                 2, 1, 0, 16) == 0);
+    assert(deeplearndata_read_stream(&stream, &learner, 4, 2,
+                                     error_threshold, &random_seed) == 16);
+    assert(learner.net->NoOfInputs == 2);
+    assert(learner.data_samples == 0);
+    assert(learner.input_range_max[1] == 20);
+    for (itt = 0; itt < 210; itt++) {
+        retval = deeplearndata_training(&learner);
+        assert((retval == 1) || (retval == 2));
+    }
+    assert(stream.samples == 210);
+    assert(stream.epochs == 4);
+    assert(learner.input_range_min[0] == 0);
+    assert(learner.input_range_max[0] == 6);
+    assert(learner.output_range_max[0] == 1);
+
+    /* a source which can't be reset ends */
+    deeplearndata_set_stream(&learner, 0);
+    assert(deeplearndata_training(&learner) == -1);
+    stream.reset = 0;
+    assert(deeplearndata_set_stream(&learner, &stream) == 0);
+    for (itt = 0; itt < 100; itt++) {
+        retval = deeplearndata_training(&learner);
+        if (retval < 0) break;
+    }
+    assert(retval == -5);
+    assert(itt == 40);
+    deeplearn_free(&learner);
+    deeplearn_stream_free(&stream);
+
+    /* field lengths are found from text within the first batch */
+    source.position = 0;
+    source.length = 20;
+    assert(deeplearn_stream_init(&stream, test_stream_next_batch,
+                                 test_stream_reset, &source,
+                                 3, 1, 1, 16) == 0);
+    assert(deeplearndata_read_stream(&stream, &learner, 4, 2,
+                                     error_threshold, &random_seed) == 16);
+    assert(learner.field_length[0] == 0);
+    assert(learner.field_length[2] == 2*CHAR_BITS);
+    assert(learner.net->NoOfInputs == 2 + 2*CHAR_BITS);
+    for (itt = 0; itt < 40; itt++) {
+        retval = deeplearndata_training(&learner);
+        assert((retval == 1) || (retval == 2));
+    }
+    deeplearn_free(&learner);
+    deeplearn_stream_free(&stream);
+
+    printf("Ok\n");
+}
+
 int run_tests_data()
 {
     printf("\nRunning data tests\n");
 
     test_data_add();
     test_data_training_test();
+    test_data_epochs();
+    test_data_activations();
+    test_data_arena();
+    test_data_stream();
     test_read_images();
 
     printf("All data tests completed\n");
@@ -61,6 +61,114 @@ static void test_init()
     printf("Ok\n");
 }
 
+static void test_clone()
+{
+    int no_of_convolutions = 2;
+    int no_of_deep_layers = 2;
+    int inputs_across = 64;
+    int inputs_down = 64;
+    int inputs_depth = 3;
+    int max_features = 8;
+    int reduction_factor = 2;
+    int no_of_outputs = 4;
+    deepconvnet convnet, replica;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 7423;
+
+    printf("test_clone...");
+
+    assert(deepconvnet_init(no_of_convolutions,
+                            no_of_deep_layers,
+                            inputs_across,
+                            inputs_down,
+                            inputs_depth,
+                            max_features,
+                            reduction_factor,
+                            no_of_outputs,
+                            &convnet,
+                            error_threshold,
+                            &random_seed) == 0);
+
+    assert(deepconvnet_clone(&replica, &convnet) == 0);
+    assert(replica.convolution != convnet.convolution);
+    assert(replica.learner != convnet.learner);
+    for (int i = 0; i < no_of_convolutions; i++) {
+        assert(replica.convolution->layer[i].autocoder !=
+               convnet.convolution->layer[i].autocoder);
+        assert(autocoder_compare(replica.convolution->layer[i].autocoder,
+                                 convnet.convolution->layer[i].autocoder) == 0);
+    }
+    assert(deeplearn_compare(replica.learner, convnet.learner) == 1);
+
+    /* the replica is independent of the source */
+    deepconvnet_free(&convnet);
+    deepconvnet_free(&replica);
+
+    printf("Ok\n");
+}
+
+static void test_model_load()
+{
+    int no_of_convolutions = 2;
+    int no_of_deep_layers = 2;
+    int inputs_across = 32;
+    int inputs_down = 32;
+    int inputs_depth = 3;
+    int max_features = 8;
+    int reduction_factor = 2;
+    int no_of_outputs = 4;
+    deepconvnet convnet;
+    deepconvnet_model frozen;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 7423;
+    unsigned char img[32*32*3];
+    char * filename = "/tmp/libdeep_convnet_model.net";
+    FILE * fp;
+
+    printf("test_model_load...");
+
+    assert(deepconvnet_init(no_of_convolutions,
+                            no_of_deep_layers,
+                            inputs_across,
+                            inputs_down,
+                            inputs_depth,
+                            max_features,
+                            reduction_factor,
+                            no_of_outputs,
+                            &convnet,
+                            error_threshold,
+                            &random_seed) == 0);
+    for (int i = 0; i < inputs_across*inputs_down*inputs_depth; i++) {
+        img[i] = (unsigned char)(rand_num(&random_seed)%256);
+    }
+
+    fp = fopen(filename, "wb");
+    assert(fp);
+    assert(deepconvnet_save(fp, &convnet) == 0);
+    fclose(fp);
+
+    fp = fopen(filename, "rb");
+    assert(fp);
+    assert(deepconvnet_model_load(fp, &frozen) == 0);
+    fclose(fp);
+    assert(frozen.model.no_of_layers == no_of_deep_layers+1);
+
+    /* same outputs as the trainable convnet */
+    assert(deepconvnet_test_img(&convnet, img) == 0);
+    assert(deepconvnet_model_test_img(&frozen, img) == 0);
+    for (int i = 0; i < no_of_outputs; i++) {
+        assert(fabs(deepconvnet_model_get_output(&frozen, i) -
+                    bp_get_output(convnet.learner->net, i)) < 0.0001f);
+    }
+    assert(deepconvnet_model_get_class(&frozen) ==
+           deepconvnet_get_class(&convnet));
+
+    deepconvnet_model_free(&frozen);
+    deepconvnet_free(&convnet);
+
+    printf("Ok\n");
+}
+
 static void set_pattern(unsigned char img[],
                         int img_width, int img_height,
                         int depth,
@@ -327,6 +435,43 @@ static void test_learn_test_patterns()
     }
     assert(score > 0);
 
+    /* performance on a test set of the same patterns */
+    convnet.no_of_images = 25;
+    convnet.images =
+        (unsigned char**)malloc(convnet.no_of_images*sizeof(unsigned char*));
+    convnet.classifications =
+        (char**)malloc(convnet.no_of_images*sizeof(char*));
+    convnet.classification_number =
+        (int*)malloc(convnet.no_of_images*sizeof(int));
+    convnet.test_set_index = (int*)malloc(no_of_outputs*sizeof(int));
+    convnet.test_images = no_of_outputs;
+    assert(convnet.images);
+    assert(convnet.classifications);
+    assert(convnet.classification_number);
+    assert(convnet.test_set_index);
+    for (i = 0; i < convnet.no_of_images; i++) {
+        convnet.images[i] =
+            (unsigned char*)malloc(inputs_across*inputs_down*
+                                   inputs_depth*sizeof(unsigned char));
+        assert(convnet.images[i]);
+        set_test_pattern(convnet.images[i], inputs_across, inputs_down,
+                         inputs_depth, i%no_of_outputs);
+        convnet.classifications[i] = (char*)malloc(2*sizeof(char));
+        assert(convnet.classifications[i]);
+        convnet.classifications[i][0] = (char)('0' + i%no_of_outputs);
+        convnet.classifications[i][1] = 0;
+        convnet.classification_number[i] = i%no_of_outputs;
+        if (i < no_of_outputs) {
+            convnet.test_set_index[i] = i;
+        }
+    }
+    assert(fabs(deepconvnet_get_performance(&convnet) -
+                (score*100.0f/no_of_outputs)) < 0.01f);
+    float subset_performance =
+        deepconvnet_get_performance_subset(&convnet, 2, &random_seed);
+    assert((subset_performance == 0) || (subset_performance == 50) ||
+           (subset_performance == 100));
+
     deepconvnet_free(&convnet);
     free(img);
 
@@ -338,12 +483,490 @@ static void test_learn_test_patterns()
     }
 }
 
+static void test_scan_img()
+{
+    int no_of_convolutions = 2;
+    int no_of_deep_layers = 2;
+    int inputs_across = 16;
+    int inputs_down = 16;
+    int inputs_depth = 3;
+    int max_features = 4;
+    int reduction_factor = 2;
+    int no_of_outputs = 4;
+    int img_width = 41, img_height = 29, stride = 3;
+    int map_width, map_height, x, y;
+    deepconvnet convnet;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 8326;
+    unsigned char * img, * window;
+    int * class_map;
+
+    printf("test_scan_img...");
+
+    assert(deepconvnet_init(no_of_convolutions,
+                            no_of_deep_layers,
+                            inputs_across,
+                            inputs_down,
+                            inputs_depth,
+                            max_features,
+                            reduction_factor,
+                            no_of_outputs,
+                            &convnet,
+                            error_threshold,
+                            &random_seed) == 0);
+
+    img = (unsigned char*)malloc(img_width*img_height*inputs_depth);
+    window = (unsigned char*)malloc(inputs_across*inputs_down*inputs_depth);
+    assert(img);
+    assert(window);
+    for (x = 0; x < img_width*img_height*inputs_depth; x++) {
+        img[x] = (unsigned char)(rand_num(&random_seed) % 256);
+    }
+
+    assert(deepconvnet_scan_size(&convnet, img_width, img_height, stride,
+                                 &map_width, &map_height) == 0);
+    assert(map_width == 9);
+    assert(map_height == 5);
+    assert(deepconvnet_scan_size(&convnet, inputs_across-1, img_height,
+                                 stride, &map_width, &map_height) != 0);
+    assert(deepconvnet_scan_size(&convnet, img_width, img_height, 0,
+                                 &map_width, &map_height) != 0);
+
+    class_map = (int*)malloc(map_width*map_height*sizeof(int));
+    assert(class_map);
+
+    /* the convolution layers must be trained first */
+    assert(deepconvnet_scan_img(&convnet, img, img_width, img_height,
+                                stride, class_map) != 0);
+    convnet.convolution->training_complete = 1;
+    assert(deepconvnet_scan_img(&convnet, img, img_width, img_height,
+                                stride, class_map) == 0);
+
+    /* each window is classified as if it were a separate image */
+    for (y = 0; y < map_height; y++) {
+        for (x = 0; x < map_width; x++) {
+            for (int wy = 0; wy < inputs_down; wy++) {
+                memcpy(&window[wy*inputs_across*inputs_depth],
+                       &img[((y*stride+wy)*img_width + x*stride)*inputs_depth],
+                       inputs_across*inputs_depth);
+            }
+            assert(deepconvnet_test_img(&convnet, window) == 0);
+            assert(class_map[y*map_width + x] ==
+                   deepconvnet_get_class(&convnet));
+        }
+    }
+
+    deepconvnet_free(&convnet);
+    free(class_map);
+    free(window);
+    free(img);
+
+    printf("Ok\n");
+}
+
+static void test_classify_batch()
+{
+    int no_of_convolutions = 3;
+    int no_of_deep_layers = 2;
+    int inputs_across = 16;
+    int inputs_down = 16;
+    int inputs_depth = 3;
+    int max_features = 4;
+    int reduction_factor = 2;
+    int no_of_outputs = 4;
+    int no_of_images = 300, img_size, i;
+    deepconvnet convnet;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 5217;
+    unsigned char ** images;
+    int * classes;
+
+    printf("test_classify_batch...");
+
+    assert(deepconvnet_init(no_of_convolutions,
+                            no_of_deep_layers,
+                            inputs_across,
+                            inputs_down,
+                            inputs_depth,
+                            max_features,
+                            reduction_factor,
+                            no_of_outputs,
+                            &convnet,
+                            error_threshold,
+                            &random_seed) == 0);
+
+    img_size = inputs_across*inputs_down*inputs_depth;
+    images = (unsigned char**)malloc(no_of_images*sizeof(unsigned char*));
+    classes = (int*)malloc(no_of_images*sizeof(int));
+    assert(images);
+    assert(classes);
+    for (i = 0; i < no_of_images; i++) {
+        images[i] = (unsigned char*)malloc(img_size);
+        assert(images[i]);
+        for (int j = 0; j < img_size; j++) {
+            images[i][j] = (unsigned char)(rand_num(&random_seed) % 256);
+        }
+    }
+
+    /* the convolution layers must be trained first */
+    assert(deepconvnet_classify_batch(&convnet, images, no_of_images,
+                                      classes) != 0);
+    convnet.convolution->training_complete = 1;
+    assert(deepconvnet_classify_batch(&convnet, images, 0, classes) == 0);
+    assert(deepconvnet_classify_batch(&convnet, images, no_of_images,
+                                      classes) == 0);
+
+    /* the same classes as for images tested one at a time */
+    for (i = 0; i < no_of_images; i++) {
+        assert(deepconvnet_test_img(&convnet, images[i]) == 0);
+        assert(classes[i] == deepconvnet_get_class(&convnet));
+    }
+
+    deepconvnet_free(&convnet);
+    for (i = 0; i < no_of_images; i++) {
+        free(images[i]);
+    }
+    free(images);
+    free(classes);
+
+    printf("Ok\n");
+}
+
+static void test_heads()
+{
+    int no_of_convolutions = 2;
+    int no_of_deep_layers = 2;
+    int inputs_across = 16;
+    int inputs_down = 16;
+    int inputs_depth = 3;
+    int max_features = 4;
+    int reduction_factor = 2;
+    int no_of_outputs = 4;
+    int i, j, class_number[2];
+    deepconvnet convnet, other, mismatched;
+    deepconvnet_heads heads;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 5382;
+    unsigned char * img;
+
+    printf("test_heads...");
+
+    assert(deepconvnet_init(no_of_convolutions, no_of_deep_layers,
+                            inputs_across, inputs_down, inputs_depth,
+                            max_features, reduction_factor, no_of_outputs,
+                            &convnet, error_threshold, &random_seed) == 0);
+    assert(deepconvnet_init(no_of_convolutions, no_of_deep_layers,
+                            inputs_across+4, inputs_down, inputs_depth,
+                            max_features, reduction_factor, no_of_outputs,
+                            &mismatched, error_threshold, &random_seed) == 0);
+    convnet.convolution->training_complete = 1;
+
+    assert(deepconvnet_heads_init(&heads, &convnet) == 0);
+    assert(heads.no_of_heads == 1);
+    assert(deepconvnet_heads_add(&heads, &mismatched) < 0);
+    assert(heads.no_of_heads == 1);
+    assert(deepconvnet_heads_add_learner(&heads, no_of_deep_layers,
+                                         no_of_outputs+1,
+                                         &error_threshold[no_of_convolutions],
+                                         &random_seed) == 1);
+    assert(heads.no_of_heads == 2);
+
+    /* a convnet with the same trunk as the second head */
+    assert(deepconvnet_clone(&other, &convnet) == 0);
+    deeplearn_free(other.learner);
+    assert(deeplearn_clone(other.learner, heads.head[1]) == 0);
+
+    img = (unsigned char*)malloc(inputs_across*inputs_down*inputs_depth);
+    assert(img);
+    for (i = 0; i < inputs_across*inputs_down*inputs_depth; i++) {
+        img[i] = (unsigned char)(rand_num(&random_seed) % 256);
+    }
+
+    /* each head gives the same outputs as a separate convnet */
+    assert(deepconvnet_heads_test_img(&heads, img) == 0);
+    assert(deepconvnet_test_img(&convnet, img) == 0);
+    assert(deepconvnet_test_img(&other, img) == 0);
+    for (j = 0; j < no_of_outputs; j++) {
+        assert(deepconvnet_heads_get_output(&heads, 0, j) ==
+               deepconvnet_get_output(&convnet, j));
+    }
+    for (j = 0; j < no_of_outputs+1; j++) {
+        assert(deepconvnet_heads_get_output(&heads, 1, j) ==
+               deepconvnet_get_output(&other, j));
+    }
+    assert(deepconvnet_heads_get_class(&heads, 0) ==
+           deepconvnet_get_class(&convnet));
+    assert(deepconvnet_heads_get_class(&heads, 1) ==
+           deepconvnet_get_class(&other));
+
+    /* heads learn independently from the same convolution */
+    class_number[0] = 1;
+    class_number[1] = -1;
+    for (i = 0; i < 10; i++) {
+        assert(deepconvnet_heads_update_img(&heads, img, class_number) == 0);
+    }
+    assert(heads.head[0]->BPerror != DEEPLEARN_UNKNOWN_ERROR);
+    assert(heads.head[1]->BPerror == DEEPLEARN_UNKNOWN_ERROR);
+
+    deepconvnet_heads_free(&heads);
+    assert(heads.no_of_heads == 0);
+    deepconvnet_free(&other);
+    deepconvnet_free(&mismatched);
+    deepconvnet_free(&convnet);
+    free(img);
+
+    printf("Ok\n");
+}
+
+static void add_test_images(deepconvnet * convnet, int no_of_images,
+                            int no_of_classes)
+{
+    deeplearn_conv * conv = convnet->convolution;
+    int size = conv->inputs_across*conv->inputs_down*conv->inputs_depth;
+
+    convnet->no_of_images = no_of_images;
+    convnet->images =
+        (unsigned char**)malloc(no_of_images*sizeof(unsigned char*));
+    convnet->classifications = (char**)malloc(no_of_images*sizeof(char*));
+    convnet->classification_number = (int*)malloc(no_of_images*sizeof(int));
+    for (int i = 0; i < no_of_images; i++) {
+        convnet->images[i] = (unsigned char*)malloc(size);
+        set_test_pattern(convnet->images[i], conv->inputs_across,
+                         conv->inputs_down, conv->inputs_depth, i);
+        convnet->classifications[i] = (char*)malloc(8);
+        sprintf(convnet->classifications[i], "%d", i%no_of_classes);
+        convnet->classification_number[i] = i%no_of_classes;
+    }
+    assert(deepconvnet_split(convnet, 20, DEEPLEARN_SPLIT_RANDOM) == 0);
+}
+
+static void test_prefetch()
+{
+    int i, no_of_convolutions = 2;
+    int no_of_deep_layers = 2;
+    int inputs_across = 64;
+    int inputs_down = 64;
+    int inputs_depth = 1;
+    int max_features = 8;
+    int reduction_factor = 2;
+    int no_of_outputs = 5;
+    int no_of_images = 10;
+    deepconvnet convnet;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 3261;
+
+    printf("test_prefetch...");
+
+    assert(deepconvnet_init(no_of_convolutions,
+                            no_of_deep_layers,
+                            inputs_across,
+                            inputs_down,
+                            inputs_depth,
+                            max_features,
+                            reduction_factor,
+                            no_of_outputs,
+                            &convnet,
+                            error_threshold,
+                            &random_seed) == 0);
+
+    add_test_images(&convnet, no_of_images, no_of_outputs);
+    assert(convnet.training_images == 8);
+
+    /* while the convolution layers are training images are not
+       prefetched */
+    assert(deepconvnet_set_prefetch(&convnet, 4) == 0);
+    assert(deepconvnet_training(&convnet) == 0);
+    assert(deeplearn_prefetch_pending(&convnet.prefetch) == 0);
+
+    convnet.convolution->training_complete = 1;
+    deepconvnet_set_epochs(&convnet, 1);
+    for (i = 0; i < 24; i++) {
+        assert(deepconvnet_training(&convnet) == 0);
+        assert(deeplearn_prefetch_pending(&convnet.prefetch) == 3);
+    }
+    assert(deepconvnet_get_epochs(&convnet) == 3);
+    assert(convnet.learner->BPerror != DEEPLEARN_UNKNOWN_ERROR);
+
+    /* the convolution is free again once the queue has been drained */
+    assert(deepconvnet_get_performance(&convnet) >= 0);
+    assert(deeplearn_prefetch_pending(&convnet.prefetch) == 0);
+    assert(deepconvnet_training(&convnet) == 0);
+
+    deepconvnet_free(&convnet);
+
+    printf("Ok\n");
+}
+
+static void test_conv_cache()
+{
+    int i, j, no_of_convolutions = 2;
+    int no_of_deep_layers = 2;
+    int inputs_across = 64;
+    int inputs_down = 64;
+    int inputs_depth = 1;
+    int max_features = 8;
+    int reduction_factor = 2;
+    int no_of_outputs = 5;
+    int no_of_images = 10;
+    deepconvnet convnet;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 5128;
+    char filename[] = "/tmp/libdeep_conv_cache.bin";
+    float performance, * outputs;
+
+    printf("test_conv_cache...");
+
+    assert(deepconvnet_init(no_of_convolutions,
+                            no_of_deep_layers,
+                            inputs_across,
+                            inputs_down,
+                            inputs_depth,
+                            max_features,
+                            reduction_factor,
+                            no_of_outputs,
+                            &convnet,
+                            error_threshold,
+                            &random_seed) == 0);
+    add_test_images(&convnet, no_of_images, no_of_outputs);
+    int n = convnet.learner->net->NoOfInputs;
+    outputs = (float*)malloc(no_of_images*n*sizeof(float));
+
+    /* nothing is cached until the convolution layers are trained */
+    assert(deepconvnet_set_conv_cache(&convnet, 1, NULL) == 0);
+    assert(deepconvnet_conv_cache_build(&convnet) != 0);
+    assert(deepconvnet_training(&convnet) == 0);
+    assert(convnet.conv_cache.valid == 0);
+
+    convnet.convolution->training_complete = 1;
+    assert(deepconvnet_training(&convnet) == 0);
+    assert(convnet.conv_cache.valid == 1);
+    assert(convnet.conv_cache.no_of_images == no_of_images);
+    assert(convnet.conv_cache.mapped == 0);
+
+    /* the cached outputs are those of the convolution layers */
+    for (i = 0; i < no_of_images; i++) {
+        assert(deepconvnet_test_img(&convnet, convnet.images[i]) == 0);
+        for (j = 0; j < n; j++) {
+            outputs[i*n + j] =
+                convnet.convolution->layer[no_of_convolutions-1].pooling[j];
+            assert(convnet.conv_cache.outputs[i*n + j] == outputs[i*n + j]);
+        }
+    }
+    performance = deepconvnet_get_performance(&convnet);
+    assert(performance >= 0);
+
+    /* the same outputs within a file */
+    assert(deepconvnet_set_conv_cache(&convnet, 1, filename) == 0);
+    assert(convnet.conv_cache.valid == 0);
+    assert(deepconvnet_get_performance(&convnet) == performance);
+    assert(deepconvnet_training(&convnet) == 0);
+    assert(convnet.conv_cache.valid == 1);
+    assert(memcmp(convnet.conv_cache.outputs, outputs,
+                  no_of_images*n*sizeof(float)) == 0);
+    assert(deepconvnet_get_performance(&convnet) == performance);
+
+    deepconvnet_set_epochs(&convnet, 1);
+    for (i = 0; i < 16; i++) {
+        assert(deepconvnet_training(&convnet) == 0);
+    }
+    assert(deepconvnet_get_epochs(&convnet) == 2);
+
+    assert(deepconvnet_set_conv_cache(&convnet, 0, NULL) == 0);
+    assert(convnet.conv_cache.enabled == 0);
+    assert(convnet.conv_cache.outputs == NULL);
+
+    deepconvnet_free(&convnet);
+    free(outputs);
+    remove(filename);
+
+    printf("Ok\n");
+}
+
+static int test_stream_images(deeplearn_stream_batch * batch, void * data)
+{
+    int * position = (int*)data;
+    int b;
+
+    for (b = 0; b < batch->capacity; b++) {
+        memset(&batch->images[b*batch->image_size],
+               (*position * 37) & 255, batch->image_size);
+        batch->classification_number[b] = *position % 4;
+        (*position)++;
+    }
+    batch->samples = b;
+    return 0;
+}
+
+static void test_stream()
+{
+    int no_of_convolutions = 2;
+    int no_of_deep_layers = 2;
+    int inputs_across = 32;
+    int inputs_down = 32;
+    int inputs_depth = 1;
+    int max_features = 4;
+    int reduction_factor = 2;
+    int no_of_outputs = 4;
+    int itt, position = 0;
+    deepconvnet convnet;
+    deeplearn_stream stream;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 7423;
+
+    printf("test_stream...");
+
+    assert(deepconvnet_init(no_of_convolutions,
+                            no_of_deep_layers,
+                            inputs_across,
+                            inputs_down,
+                            inputs_depth,
+                            max_features,
+                            reduction_factor,
+                            no_of_outputs,
+                            &convnet,
+                            error_threshold,
+                            &random_seed) == 0);
+
+    /* images must be the size of the input layer */
+    assert(deeplearn_stream_init_images(&stream, test_stream_images, NULL,
+                                        &position, 16*16, 4) == 0);
+    assert(deepconvnet_set_stream(&convnet, &stream) == -1);
+    deeplearn_stream_free(&stream);
+
+    assert(deeplearn_stream_init_images(&stream, test_stream_images, NULL,
+                                        &position,
+                                        inputs_across*inputs_down*inputs_depth,
+                                        4) == 0);
+    assert(deepconvnet_set_stream(&convnet, &stream) == 0);
+
+    /* no images are loaded, so they come from the stream */
+    for (itt = 0; itt < 10; itt++) {
+        assert(deepconvnet_training(&convnet) == 0);
+    }
+    assert(stream.samples == 10);
+    assert(position == 12);
+    assert(convnet.convolution->itterations > 0);
+
+    deepconvnet_free(&convnet);
+    deeplearn_stream_free(&stream);
+
+    printf("Ok\n");
+}
+
 int run_tests_deepconvnet()
 {
 	printf("\nRunning deepconvnet tests\n");
 
 	test_init();
+	test_clone();
+	test_model_load();
 	test_update_img();
+	test_prefetch();
+	test_conv_cache();
+	test_stream();
+	test_scan_img();
+	test_classify_batch();
+	test_heads();
 	test_learn_test_patterns();
 
 	printf("All deepconvnet tests completed\n");
@@ -246,6 +246,79 @@ static void test_deeplearn_save_load()
     printf("Ok\n");
 }
 
+static void test_deeplearn_clone()
+{
+    deeplearn learner, replica;
+    int no_of_inputs=10;
+    int no_of_hiddens=6;
+    int no_of_outputs=3;
+    int hidden_layers=2;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    float outputs1[3], outputs2[3];
+    int i, j;
+
+    printf("test_deeplearn_clone...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers, no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    /* train for a while so that the clone is not just the initial state */
+    for (i = 0; i < 50; i++) {
+        for (j = 0; j < no_of_inputs; j++) {
+            deeplearn_set_input(&learner, j, (((i+j) % 3) + 1)/4.0f);
+        }
+        for (j = 0; j < no_of_outputs; j++) {
+            deeplearn_set_output(&learner, j, ((i+j) % 2) ? 0.75f : 0.25f);
+        }
+        deeplearn_update(&learner);
+    }
+
+    assert(deeplearn_clone(&replica, &learner) == 0);
+    assert(deeplearn_compare(&learner, &replica) == 1);
+
+    /* the copy has its own storage */
+    assert(replica.net != learner.net);
+    assert(replica.net->layer[1].weights != learner.net->layer[1].weights);
+    assert(replica.net->hiddens[0][0]->inputs[0] ==
+           replica.net->inputs[0]);
+    assert(replica.autocoder[0]->weights == replica.net->layer[1].weights);
+
+    /* both give the same outputs */
+    for (j = 0; j < no_of_inputs; j++) {
+        deeplearn_set_input(&learner, j, j/(float)no_of_inputs);
+        deeplearn_set_input(&replica, j, j/(float)no_of_inputs);
+    }
+    deeplearn_feed_forward(&learner);
+    deeplearn_feed_forward(&replica);
+    for (j = 0; j < no_of_outputs; j++) {
+        outputs1[j] = deeplearn_get_output(&learner, j);
+        outputs2[j] = deeplearn_get_output(&replica, j);
+        assert(outputs1[j] == outputs2[j]);
+    }
+
+    /* training the source does not change the copy */
+    for (i = 0; i < 10; i++) {
+        deeplearn_update(&learner);
+    }
+    assert(deeplearn_compare(&learner, &replica) != 1);
+
+    /* the copy remains usable after the source has gone */
+    deeplearn_free(&learner);
+    deeplearn_feed_forward(&replica);
+    for (j = 0; j < no_of_outputs; j++) {
+        outputs1[j] = deeplearn_get_output(&replica, j);
+        assert(outputs1[j] == outputs2[j]);
+    }
+    deeplearn_update(&replica);
+    deeplearn_free(&replica);
+
+    printf("Ok\n");
+}
+
 static void test_deeplearn_export()
 {
     char * filename1 = "/tmp/libdeep_export.c";
@@ -257,6 +330,8 @@ static void test_deeplearn_export()
     int no_of_outputs=2;
     float error_threshold[] = { 0.01f, 0.01f, 0.01f };
     unsigned int random_seed = 123;
+    char line[256];
+    int numpy_arrays = 0;
     FILE * fp;
 
     printf("test_deeplearn_export...");
@@ -280,7 +355,15 @@ static void test_deeplearn_export()
     assert(deeplearn_export(&learner, filename2) == 0);
     fp = fopen(filename2,"r");
     assert(fp);
+
+    /* weights are exported as NumPy arrays */
+    while (fgets(line, 255, fp)) {
+        if (strstr(line, "layer_0_weights = np.array(") != NULL) {
+            numpy_arrays++;
+        }
+    }
     fclose(fp);
+    assert(numpy_arrays == 1);
 
     /* free memory */
     deeplearn_free(&learner);
@@ -288,6 +371,86 @@ static void test_deeplearn_export()
     printf("Ok\n");
 }
 
+static void test_deeplearn_export_library()
+{
+    char * filename = "/tmp/libdeep_export_library.c";
+    char * driver_filename = "/tmp/libdeep_export_driver.c";
+    char * results_filename = "/tmp/libdeep_export_driver.txt";
+    deeplearn learner;
+    bp_inference ctx;
+    int no_of_inputs=20;
+    int no_of_hiddens=12;
+    int hidden_layers=3;
+    int no_of_outputs=3;
+    int batch_size=11;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    float inputs[11*20], expected[11*3], value;
+    int i, retval;
+    FILE * fp;
+
+    printf("test_deeplearn_export_library...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+    assert(deeplearn_set_activation(&learner, AF_TANH) == 0);
+
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((rand_num(&random_seed)%10000)/20000.0f);
+    }
+    assert(deeplearn_inference_init(&learner, &ctx, batch_size) == 0);
+    assert(deeplearn_infer(&learner, &ctx, inputs, expected,
+                           batch_size) == 0);
+    bp_inference_free(&ctx);
+
+    assert(deeplearn_export_library(&learner, filename) == 0);
+
+    /* a program which evaluates the exported network both one sample
+       at a time and as a batch */
+    fp = fopen(driver_filename, "w");
+    assert(fp);
+    fprintf(fp, "#include <stdio.h>\n#include \"%s\"\n\n", filename);
+    fprintf(fp, "static const float inputs[%d] = {", batch_size*no_of_inputs);
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        fprintf(fp, "%.9ef%s", inputs[i],
+                (i < batch_size*no_of_inputs-1) ? "," : "");
+    }
+    fprintf(fp, "};\n\nint main(void)\n{\n");
+    fprintf(fp, "  float single[%d], batch[%d];\n  int b, i;\n",
+            batch_size*no_of_outputs, batch_size*no_of_outputs);
+    fprintf(fp, "  for (b = 0; b < %d; b++) {\n", batch_size);
+    fprintf(fp, "    predict(&inputs[b*PREDICT_INPUTS], &single[b*PREDICT_OUTPUTS]);\n");
+    fprintf(fp, "  }\n  predict_batch(inputs, batch, %d);\n", batch_size);
+    fprintf(fp, "  for (i = 0; i < %d; i++) {\n", batch_size*no_of_outputs);
+    fprintf(fp, "    if (single[i] != batch[i]) return 1;\n");
+    fprintf(fp, "    printf(\"%%.9e\\n\", batch[i]);\n  }\n  return 0;\n}\n");
+    fclose(fp);
+
+    /* the exported code only needs a C99 compiler */
+    retval = system("gcc -std=c99 -pedantic -Wall -Werror -O2 "
+                    "-o /tmp/libdeep_export_driver "
+                    "/tmp/libdeep_export_driver.c -lm && "
+                    "/tmp/libdeep_export_driver > "
+                    "/tmp/libdeep_export_driver.txt");
+    assert(retval == 0);
+
+    fp = fopen(results_filename, "r");
+    assert(fp);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(fscanf(fp, "%f", &value) == 1);
+        assert(fabs(value - expected[i]) < 0.0001f);
+    }
+    fclose(fp);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
 static void test_deeplearn_csv_with_text()
 {
     deeplearn learner;
@@ -340,6 +503,14 @@ static void test_deeplearn_csv_with_text()
     assert(learner.field_length[1] == 5*CHAR_BITS);
     assert(learner.field_length[2] == 0);
 
+    /* text is packed within the data arena */
+    assert(learner.arena.text != 0);
+    assert(strcmp(deeplearndata_get(&learner, 2)->inputs_text[1],
+                  "three") == 0);
+    assert(deeplearndata_get(&learner, 2)->inputs_text[0] == 0);
+    assert(deeplearndata_get(&learner, 3)->inputs_text[1] ==
+           deeplearndata_get(&learner, 2)->inputs_text[1] + 6);
+
     assert(deeplearn_export(&learner, export_filename1) == 0);
     fp = fopen(export_filename1,"r");
     assert(fp);
@@ -412,30 +583,305 @@ static void test_deeplearn_csv_numeric()
     printf("Ok\n");
 }
 
-static void test_deeplearn_set_input_field_text()
+static void test_deeplearn_csv_chunked()
+{
+    deeplearn learner1, learner2;
+    int no_of_hiddens=16;
+    int hidden_layers=3;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 2 };
+    float error_threshold_percent[] = { 1.6f, 1.6f, 3.0f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_chunked.csv";
+    int i, s;
+    FILE * fp;
+
+    printf("test_deeplearn_csv_chunked...");
+
+    /* windows line endings, a comment and no final line ending */
+    fp = fopen(csv_filename,"wb");
+    assert(fp);
+    fprintf(fp,"# comment line\r\n");
+    fprintf(fp,"%f,%s,%f,%f\r\n",4.2,"one",62.1,1.0);
+    fprintf(fp,"%f,%s,%f,%f\r\n",8.1,"two",57.6,2.0);
+    fprintf(fp,"%f,%s,%f,%f\r\n",9.4,"three",63.2,3.0);
+    fprintf(fp,"%f,%s,%f,%f\r\n",1.7,"four",68.3,4.0);
+    fprintf(fp,"%f,%s,%f,%f\r\n",5.4,"five",91.9,5.0);
+    fprintf(fp,"%f,%s,%f,%f\r\n",7.5,"six",88.7,6.0);
+    fprintf(fp,"%f,%s,%f,%f\r\n",8.6,"seven",83.1,7.0);
+    fprintf(fp,"%f,%s,%f,%f",-6.9,"eight",77.4,8.0);
+    fclose(fp);
+
+    /* lines are split across many small chunks */
+    assert(deeplearndata_read_csv_chunked(csv_filename, &learner1,
+                                          no_of_hiddens, hidden_layers,
+                                          no_of_outputs,
+                                          output_field_index, 0,
+                                          error_threshold_percent,
+                                          &random_seed, 7, 1) == 8);
+    random_seed = 123;
+    assert(deeplearndata_read_csv_chunked(csv_filename, &learner2,
+                                          no_of_hiddens, hidden_layers,
+                                          no_of_outputs,
+                                          output_field_index, 0,
+                                          error_threshold_percent,
+                                          &random_seed,
+                                          DEEPLEARNDATA_CSV_CHUNK_SIZE, 0) == 8);
+
+    assert(learner1.no_of_input_fields == 3);
+    assert(learner1.field_length[0] == 0);
+    assert(learner1.field_length[1] == 5*CHAR_BITS);
+    assert(learner1.field_length[2] == 0);
+    assert(learner1.net->NoOfInputs == 2 + (5*CHAR_BITS));
+    assert(fabs(learner1.input_range_min[0] - -6.9f) < 0.001f);
+    assert(fabs(learner1.input_range_max[0] - 9.4f) < 0.001f);
+    assert(fabs(learner1.output_range_min[0] - 57.6f) < 0.001f);
+    assert(fabs(learner1.output_range_max[0] - 91.9f) < 0.001f);
+
+    for (s = 0; s < 8; s++) {
+        deeplearndata * sample1 = deeplearndata_get(&learner1, s);
+        deeplearndata * sample2 = deeplearndata_get(&learner2, s);
+        assert(sample1);
+        assert(sample2);
+        for (i = 0; i < 3; i++) {
+            assert(sample1->inputs[i] == sample2->inputs[i]);
+        }
+        assert(sample1->outputs[0] == sample2->outputs[0]);
+        assert(strcmp(sample1->inputs_text[1], sample2->inputs_text[1]) == 0);
+    }
+    /* samples are held in the order in which they appear in the file */
+    assert(strcmp(deeplearndata_get(&learner1, 0)->inputs_text[1],
+                  "one") == 0);
+    assert(strcmp(deeplearndata_get(&learner1, 7)->inputs_text[1],
+                  "eight") == 0);
+
+    deeplearn_free(&learner1);
+    deeplearn_free(&learner2);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_sample_cache()
 {
     deeplearn learner;
-    int i, retval, no_of_hiddens=5;
-    int hidden_layers=1;
+    int no_of_hiddens=8;
+    int hidden_layers=2;
     int no_of_outputs = 1;
     int output_field_index[] = { 2 };
-    float error_threshold_percent[] = { 0.07f, 0.07f };
+    float error_threshold_percent[] = { 1.6f, 1.6f, 3.0f };
     unsigned int random_seed = 123;
-    char * csv_filename = "/tmp/libdeep.csv";
+    char * csv_filename = "/tmp/libdeep_cache.csv";
+    float * expected, performance;
+    int i, s, no_of_inputs;
     FILE * fp;
-    char * expected_inputs = "111101100111011010100110--------";
 
-    printf("test_deeplearn_set_input_field_text...");
+    printf("test_deeplearn_sample_cache...");
 
-    /* create a csv file */
     fp = fopen(csv_filename,"w");
     assert(fp);
-    for (i = 0; i < 10; i++) {
-        fprintf(fp,"%s,%s,%f\n","zero","zero",0.0);
-        fprintf(fp,"%s,%s,%f\n","zero","one",1.0);
-        fprintf(fp,"%s,%s,%f\n","one","zero",1.0);
-        fprintf(fp,"%s,%s,%f\n","one","one",0.0);
+    fprintf(fp,"%f,%s,%f,%f\n",4.2,"one",62.1,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",8.1,"two",57.6,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",9.4,"three",63.2,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",1.7,"four",68.3,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",5.4,"five",91.9,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",7.5,"six",88.7,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",8.6,"seven",83.1,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",6.9,"eight",77.4,1.0);
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename,
+                                  &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  no_of_outputs,
+                                  output_field_index, 0,
+                                  error_threshold_percent,
+                                  &random_seed) == 8);
+    learner.history_plot_interval = 999999;
+    no_of_inputs = learner.net->NoOfInputs;
+
+    /* encode each sample without the cache */
+    expected = (float*)malloc(8*(no_of_inputs+1)*sizeof(float));
+    assert(expected);
+    for (s = 0; s < 8; s++) {
+        deeplearndata * sample = deeplearndata_get(&learner, s);
+        assert(sample->encoded_inputs == 0);
+        deeplearn_set_inputs(&learner, sample);
+        deeplearn_set_outputs(&learner, sample);
+        for (i = 0; i < no_of_inputs; i++) {
+            expected[s*(no_of_inputs+1) + i] = learner.net->inputs[i]->value;
+        }
+        expected[s*(no_of_inputs+1) + no_of_inputs] =
+            learner.net->outputs[0]->desiredValue;
+    }
+    performance = deeplearndata_get_performance(&learner);
+
+    /* the cached encodings are the same */
+    assert(deeplearn_cache_enable(&learner) == 0);
+    assert(learner.cache.valid == 1);
+    assert(learner.cache.samples == 8);
+    assert(learner.cache.input_set[0] == 1);
+    assert(learner.cache.input_set[no_of_inputs-1] == 0);
+    assert(deeplearndata_get_performance(&learner) == performance);
+    for (s = 0; s < 8; s++) {
+        deeplearndata * sample = deeplearndata_get(&learner, s);
+        assert(sample->encoded_inputs != 0);
+        assert(sample->encoded_outputs != 0);
+        for (i = 0; i < no_of_inputs; i++) {
+            learner.net->inputs[i]->value = -1;
+        }
+        deeplearn_set_inputs(&learner, sample);
+        deeplearn_set_outputs(&learner, sample);
+        for (i = 0; i < no_of_inputs; i++) {
+            if (learner.cache.input_set[i] == 0) {
+                /* fields without a range are not set */
+                assert(learner.net->inputs[i]->value == -1);
+                continue;
+            }
+            assert(learner.net->inputs[i]->value ==
+                   expected[s*(no_of_inputs+1) + i]);
+        }
+        assert(learner.net->outputs[0]->desiredValue ==
+               expected[s*(no_of_inputs+1) + no_of_inputs]);
+    }
+
+    /* a change of range is detected and the sample encoded directly */
+    learner.input_range_max[0] += 10.0f;
+    deeplearn_set_inputs(&learner, deeplearndata_get(&learner, 0));
+    assert(learner.cache.valid == 0);
+    assert(learner.net->inputs[0]->value != expected[0]);
+    assert(learner.net->inputs[0]->value ==
+           (float)((((deeplearndata_get(&learner, 0)->inputs[0] -
+                      learner.input_range_min[0]) /
+                     (learner.input_range_max[0] -
+                      learner.input_range_min[0]))*0.5) + 0.25));
+
+    /* training rebuilds the cache */
+    assert(deeplearndata_training(&learner) > 0);
+    assert(learner.cache.valid == 1);
+
+    deeplearn_cache_disable(&learner);
+    assert(learner.cache.enabled == 0);
+    assert(deeplearndata_get(&learner, 0)->encoded_inputs == 0);
+
+    free(expected);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_dataset_file()
+{
+    deeplearn learner, learner2;
+    int i, s, no_of_hiddens = 8, hidden_layers = 2;
+    int output_field_index[] = { 2 };
+    float error_threshold[] = { 1.6f, 1.6f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_dataset.csv";
+    char filename[256];
+    deeplearndata * sample, * sample2;
+    FILE * fp;
+
+    printf("test_deeplearn_dataset_file...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%s,%f,%f\n",4.2,"one",62.1,1.0);
+    fprintf(fp,"%f,%s,%f,%f\n",8.1,"two",57.6,2.0);
+    fprintf(fp,"%f,%s,%f,%f\n",9.4,"three",63.2,3.0);
+    fprintf(fp,"%f,%s,%f,%f\n",1.7,"four",68.3,4.0);
+    fprintf(fp,"%f,%s,%f,%f\n",5.4,"five",91.9,5.0);
+    fprintf(fp,"%f,%s,%f,%f\n",7.5,"six",88.7,6.0);
+    fprintf(fp,"%f,%s,%f,%f\n",8.6,"seven",83.1,7.0);
+    fprintf(fp,"%f,%s,%f,%f\n",6.9,"eight",77.4,8.0);
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename, &learner,
+                                  no_of_hiddens, hidden_layers, 1,
+                                  output_field_index, 0,
+                                  error_threshold, &random_seed) == 8);
+
+    sprintf(filename, "%slibdeep_dataset.bin", DEEPLEARN_TEMP_DIRECTORY);
+    assert(deeplearndata_save(&learner, filename) == 8);
+
+    /* the samples, field lengths, ranges and sets are loaded as saved */
+    assert(deeplearndata_load_mmap(filename, &learner2,
+                                   no_of_hiddens, hidden_layers,
+                                   error_threshold, &random_seed) == 8);
+    assert(learner2.net->NoOfInputs == learner.net->NoOfInputs);
+    assert(learner2.net->NoOfOutputs == learner.net->NoOfOutputs);
+    assert(learner2.no_of_input_fields == 3);
+    assert(learner2.training_data_samples == 6);
+    assert(learner2.training_data_labeled_samples == 6);
+    assert(learner2.test_data_samples == 2);
+    for (i = 0; i < 3; i++) {
+        assert(learner2.field_length[i] == learner.field_length[i]);
+        assert(learner2.input_range_min[i] == learner.input_range_min[i]);
+        assert(learner2.input_range_max[i] == learner.input_range_max[i]);
+    }
+    assert(learner2.output_range_min[0] == learner.output_range_min[0]);
+    assert(learner2.output_range_max[0] == learner.output_range_max[0]);
+    for (s = 0; s < 8; s++) {
+        if (s < 6) {
+            sample = deeplearndata_get_training(&learner, s);
+            sample2 = deeplearndata_get_training(&learner2, s);
+        }
+        else {
+            sample = deeplearndata_get_test(&learner, s - 6);
+            sample2 = deeplearndata_get_test(&learner2, s - 6);
+        }
+        assert(memcmp(sample->inputs, sample2->inputs, 3*sizeof(float)) == 0);
+        assert(sample->outputs[0] == sample2->outputs[0]);
+        assert(sample2->inputs_text[0] == 0);
+        assert(strcmp(sample->inputs_text[1], sample2->inputs_text[1]) == 0);
     }
+
+    /* and can be trained on */
+    for (i = 0; i < 20; i++) {
+        assert(deeplearndata_training(&learner2) > 0);
+    }
+    deeplearn_free(&learner2);
+
+    /* files which are not datasets are rejected */
+    fp = fopen(filename, "r+b");
+    assert(fp);
+    fputc('X', fp);
+    fclose(fp);
+    assert(deeplearndata_load_mmap(filename, &learner2,
+                                   no_of_hiddens, hidden_layers,
+                                   error_threshold, &random_seed) == -2);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_update_batch()
+{
+    deeplearn learner;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 3 };
+    float error_threshold_percent[] = { 10.0f, 10.0f, 0.01f };
+    unsigned int random_seed = 123;
+    unsigned int itterations;
+    char * csv_filename = "/tmp/libdeep_batch.csv";
+    int itt, retval, pretraining=0, training=0;
+    FILE * fp;
+
+    printf("test_deeplearn_update_batch...");
+
+    /* create a csv file */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%f,%f,%f\n",4.2,6.8,62.1,1.0);
+    fprintf(fp,"%f,%f,%f,%f\n",8.1,7.2,57.6,2.0);
+    fprintf(fp,"%f,%f,%f,%f\n",9.4,8.24,63.2,3.0);
+    fprintf(fp,"%f,%f,%f,%f\n",1.7,3.83,68.3,4.0);
+    fprintf(fp,"%f,%f,%f,%f\n",5.4,2.63,91.9,5.0);
+    fprintf(fp,"%f,%f,%f,%f\n",7.5,8.24,88.7,6.0);
+    fprintf(fp,"%f,%f,%f,%f\n",8.6,7.13,83.1,7.0);
+    fprintf(fp,"%f,%f,%f,%f\n",6.9,72.7,77.4,8.0);
     fclose(fp);
 
     /* load the data */
@@ -446,49 +892,91 @@ static void test_deeplearn_set_input_field_text()
                            output_field_index, 0,
                            error_threshold_percent,
                            &random_seed);
+    learner.history_plot_interval = 999999;
+
+    assert(deeplearndata_training_batch(&learner, 0) < 0);
+
+    for (itt = 0; itt < 5000; itt++) {
+        itterations = learner.net->itterations;
+        retval = deeplearndata_training_batch(&learner, 8);
+        assert(retval >= 0);
+        if (retval == 1) pretraining++;
+        if (retval == 2) {
+            training++;
+            /* each sample in the batch counts as an itteration */
+            assert(learner.net->itterations - itterations == 16);
+        }
+    }
+    assert(pretraining > 0);
+    assert(training > 0);
+    assert(learner.current_hidden_layer == hidden_layers);
+    assert(learner.BPerror != DEEPLEARN_UNKNOWN_ERROR);
 
-    assert(learner.net->NoOfInputs == 2*4*CHAR_BITS);
-    assert(learner.no_of_input_fields == 2);
+    /* free memory */
+    deeplearn_free(&learner);
 
-    assert(learner.field_length != 0);
-    assert(learner.field_length[0] == 4*CHAR_BITS);
-    assert(learner.field_length[1] == 4*CHAR_BITS);
+    printf("Ok\n");
+}
 
-    /* clear the inputs */
-    for (i = 0; i < learner.net->NoOfInputs; i++) {
-        deeplearn_set_input(&learner, i, 0.0f);
-    }
+static void test_deeplearn_update_hogwild()
+{
+    deeplearn learner;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 3 };
+    float error_threshold_percent[] = { 10.0f, 10.0f, 0.01f };
+    unsigned int random_seed = 123;
+    unsigned int itterations;
+    char * csv_filename = "/tmp/libdeep_hogwild.csv";
+    int itt, retval, pretraining=0, training=0;
+    FILE * fp;
 
-    retval = deeplearn_set_input_field_text(&learner, 0, "one");
-    assert(retval==0);
-    for (i = 0; i < 4*(int)CHAR_BITS; i++) {
-        if (learner.net->inputs[i]->value > 0.6f) {
-            assert(expected_inputs[i] == '1');
-        }
-        if (learner.net->inputs[i]->value < 0.4f) {
-            assert(expected_inputs[i] == '0');
-        }
-        if ((learner.net->inputs[i]->value > 0.4f) &&
-            (learner.net->inputs[i]->value < 0.6f)) {
-            assert(expected_inputs[i] == '-');
-        }
-    }
-    /*
-    printf("\n");
-    for (i = 0; i < learner.net->NoOfInputs; i++) {
-        if (learner.net->inputs[i]->value > 0.6f) {
-            printf("1");
-        }
-        if (learner.net->inputs[i]->value < 0.4f) {
-            printf("0");
-        }
-        if ((learner.net->inputs[i]->value > 0.4f) &&
-            (learner.net->inputs[i]->value < 0.6f)) {
-            printf("-");
+    printf("test_deeplearn_update_hogwild...");
+
+    /* create a csv file */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%f,%f,%f\n",4.2,6.8,62.1,1.0);
+    fprintf(fp,"%f,%f,%f,%f\n",8.1,7.2,57.6,2.0);
+    fprintf(fp,"%f,%f,%f,%f\n",9.4,8.24,63.2,3.0);
+    fprintf(fp,"%f,%f,%f,%f\n",1.7,3.83,68.3,4.0);
+    fprintf(fp,"%f,%f,%f,%f\n",5.4,2.63,91.9,5.0);
+    fprintf(fp,"%f,%f,%f,%f\n",7.5,8.24,88.7,6.0);
+    fprintf(fp,"%f,%f,%f,%f\n",8.6,7.13,83.1,7.0);
+    fprintf(fp,"%f,%f,%f,%f\n",6.9,72.7,77.4,8.0);
+    fclose(fp);
+
+    /* load the data */
+    deeplearndata_read_csv(csv_filename,
+                           &learner,
+                           no_of_hiddens, hidden_layers,
+                           no_of_outputs,
+                           output_field_index, 0,
+                           error_threshold_percent,
+                           &random_seed);
+    learner.history_plot_interval = 999999;
+
+    assert(deeplearndata_training_hogwild(&learner, 0, 0) < 0);
+    assert(deeplearndata_training_hogwild(&learner, 8, -1) < 0);
+
+    for (itt = 0; itt < 5000; itt++) {
+        itterations = learner.net->itterations;
+        retval = deeplearndata_training_hogwild(&learner, 32, 4);
+        assert(retval >= 0);
+        if (retval == 1) pretraining++;
+        if (retval == 2) {
+            training++;
+            /* each sample counts as an itteration */
+            assert(learner.net->itterations - itterations == 64);
         }
+        if (retval == 0) break;
     }
-    printf("\n");
-    */
+    assert(pretraining > 0);
+    assert(training > 0);
+    assert(learner.current_hidden_layer == hidden_layers);
+    assert(learner.BPerror != DEEPLEARN_UNKNOWN_ERROR);
+    assert(learner.BPerror < 50);
 
     /* free memory */
     deeplearn_free(&learner);
@@ -496,17 +984,920 @@ static void test_deeplearn_set_input_field_text()
     printf("Ok\n");
 }
 
+static void test_deeplearn_performance()
+{
+    deeplearn learner;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 3 };
+    float error_threshold_percent[] = { 10.0f, 10.0f, 0.01f };
+    unsigned int random_seed = 123, subset_seed = 456;
+    char * csv_filename = "/tmp/libdeep_performance.csv";
+    float outputs[1], error, total_error = 0, expected, performance;
+    int i, hits = 0;
+    FILE * fp;
+
+    printf("test_deeplearn_performance...");
+
+    /* enough test samples for several batches */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (i = 0; i < 1000; i++) {
+        fprintf(fp,"%f,%f,%f,%f\n",
+                (i%17)*0.3f, (i%5)*1.7f, (i%11)*0.9f, 10.0f + (i%7));
+    }
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename,
+                                  &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  no_of_outputs,
+                                  output_field_index, 0,
+                                  error_threshold_percent,
+                                  &random_seed) == 1000);
+    assert(learner.test_data_samples > 2*DEEPLEARNDATA_PERFORMANCE_BATCH);
+
+    /* evaluate serially on the learner itself */
+    for (i = 0; i < learner.test_data_samples; i++) {
+        deeplearndata * sample = deeplearndata_get_test(&learner, i);
+        deeplearn_set_inputs(&learner, sample);
+        deeplearn_feed_forward(&learner);
+        deeplearn_get_outputs(&learner, outputs);
+        error = (sample->outputs[0] - outputs[0]) / sample->outputs[0];
+        total_error += error*error;
+        hits++;
+    }
+    expected = 100 - (float)sqrt(total_error / hits) * 100;
+
+    performance = deeplearndata_get_performance(&learner);
+    assert(fabs(performance - expected) < 0.01f);
+
+    /* the result does not depend upon the number of threads */
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    assert(deeplearndata_get_performance(&learner) == performance);
+    omp_set_num_threads(threads);
+#endif
+
+    /* subsets */
+    assert(deeplearndata_get_performance_subset(&learner,
+                                                learner.test_data_samples,
+                                                &subset_seed) == performance);
+    assert(subset_seed == 456);
+    float subset = deeplearndata_get_performance_subset(&learner, 10,
+                                                        &subset_seed);
+    assert(subset_seed != 456);
+    assert((subset >= 0) && (subset <= 100));
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_quantise()
+{
+    deeplearn learner;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 3 };
+    float error_threshold_percent[] = { 10.0f, 10.0f, 0.01f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_quantise.csv";
+    float performance, loss = 0;
+    int i;
+    FILE * fp;
+
+    printf("test_deeplearn_quantise...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (i = 0; i < 500; i++) {
+        fprintf(fp,"%f,%f,%f,%f\n",
+                (i%17)*0.3f, (i%5)*1.7f, (i%11)*0.9f, 10.0f + (i%7));
+    }
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename,
+                                  &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  no_of_outputs,
+                                  output_field_index, 0,
+                                  error_threshold_percent,
+                                  &random_seed) == 500);
+
+    for (i = 0; i < 2000; i++) {
+        assert(deeplearndata_training(&learner) >= 0);
+    }
+    performance = deeplearndata_get_performance(&learner);
+
+    /* the loss can only be measured once quantised */
+    assert(deeplearndata_get_quantisation_loss(&learner, &loss) != 0);
+    assert(learner.net->inference_precision == KERNEL_FP32);
+
+    assert(deeplearndata_quantise(&learner, BP_QUANT_PER_UNIT, 50) == 0);
+    assert(learner.net->inference_precision == KERNEL_INT8);
+    assert(deeplearndata_get_quantisation_loss(&learner, &loss) == 0);
+    assert(fabs(loss) < 1.0f);
+    assert(fabs(deeplearndata_get_performance(&learner) -
+                (performance - loss)) < 0.001f);
+
+    /* calibrating on all test samples */
+    assert(deeplearndata_quantise(&learner, BP_QUANT_PER_LAYER, 0) == 0);
+    assert(deeplearndata_get_quantisation_loss(&learner, &loss) == 0);
+    assert(fabs(loss) < 2.0f);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+typedef struct {
+    int snapshots;
+    int last_history_index;
+    char filename[256];
+} history_render_count;
+
+static int count_history_snapshots(deeplearn_history_snapshot * snapshot,
+                                   void * data)
+{
+    history_render_count * count = (history_render_count*)data;
+
+    count->snapshots++;
+    count->last_history_index = snapshot->history_index;
+    sprintf(count->filename, "%s", snapshot->filename);
+    return 0;
+}
+
+static void test_deeplearn_history_plotter()
+{
+    deeplearn learner;
+    deeplearn_history_plotter plotter;
+    history_render_count count;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 3 };
+    float error_threshold_percent[] = { 10.0f, 10.0f, 0.01f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_history.csv";
+    float history[DEEPLEARN_HISTORY_SIZE];
+    int i, retval;
+    FILE * fp;
+
+    printf("test_deeplearn_history_plotter...");
+
+    memset((void*)&count, '\0', sizeof(history_render_count));
+    assert(deeplearn_history_plotter_init(&plotter,
+                                          count_history_snapshots,
+                                          &count) == 0);
+
+    /* every posted snapshot is either rendered or replaced */
+    for (i = 0; i < DEEPLEARN_HISTORY_SIZE; i++) {
+        history[i] = i;
+    }
+    for (i = 0; i < 20; i++) {
+        retval = deeplearn_history_plotter_post(&plotter, history, i+1, 1,
+                                                "history.png", "History",
+                                                640, 480);
+        assert((retval == 0) || (retval == 1));
+    }
+    assert(deeplearn_history_plotter_post(&plotter, history,
+                                          DEEPLEARN_HISTORY_SIZE+1, 1,
+                                          "history.png", "History",
+                                          640, 480) == -2);
+    deeplearn_history_plotter_flush(&plotter);
+    assert(plotter.pending == 0);
+    assert(plotter.rendered + plotter.dropped == 20);
+    assert(count.snapshots == (int)plotter.rendered);
+    /* the most recent snapshot is never dropped */
+    assert(count.last_history_index == 20);
+
+    /* plot from within training */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (i = 0; i < 20; i++) {
+        fprintf(fp,"%f,%f,%f,%f\n",
+                (i%7)*0.5f, (i%3)*1.2f, (i%5)*2.1f, 1.0f + (i%4));
+    }
+    fclose(fp);
+    assert(deeplearndata_read_csv(csv_filename,
+                                  &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  no_of_outputs,
+                                  output_field_index, 0,
+                                  error_threshold_percent,
+                                  &random_seed) == 20);
+    sprintf(learner.history_plot_filename, "%s", "/tmp/libdeep_history.png");
+    learner.history_plot_interval = 10;
+    deeplearn_set_history_plotter(&learner, &plotter);
+
+    count.snapshots = 0;
+    for (i = 0; i < 200; i++) {
+        assert(deeplearndata_training(&learner) >= 0);
+    }
+    deeplearn_history_plotter_flush(&plotter);
+    assert(count.snapshots > 0);
+    assert(strcmp(count.filename, "/tmp/libdeep_history.png") == 0);
+
+    deeplearn_free(&learner);
+    deeplearn_history_plotter_free(&plotter);
+    assert(plotter.worker == NULL);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_infer()
+{
+    deeplearn learner;
+    bp_inference ctx;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 3 };
+    float error_threshold_percent[] = { 10.0f, 10.0f, 0.01f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_infer.csv";
+    float inputs[8*3], outputs[8], expected;
+    int i, s;
+    FILE * fp;
+
+    printf("test_deeplearn_infer...");
+
+    /* create a csv file */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%f,%f,%f\n",4.2,6.8,62.1,1.0);
+    fprintf(fp,"%f,%f,%f,%f\n",8.1,7.2,57.6,2.0);
+    fprintf(fp,"%f,%f,%f,%f\n",9.4,8.24,63.2,3.0);
+    fprintf(fp,"%f,%f,%f,%f\n",1.7,3.83,68.3,4.0);
+    fprintf(fp,"%f,%f,%f,%f\n",5.4,2.63,91.9,5.0);
+    fprintf(fp,"%f,%f,%f,%f\n",7.5,8.24,88.7,6.0);
+    fprintf(fp,"%f,%f,%f,%f\n",8.6,7.13,83.1,7.0);
+    fprintf(fp,"%f,%f,%f,%f\n",6.9,72.7,77.4,8.0);
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename,
+                                  &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  no_of_outputs,
+                                  output_field_index, 0,
+                                  error_threshold_percent,
+                                  &random_seed) == 8);
+    learner.net->DropoutPercent = 0;
+
+    for (s = 0; s < 8; s++) {
+        deeplearndata * sample = deeplearndata_get(&learner, s);
+        assert(sample);
+        for (i = 0; i < 3; i++) {
+            inputs[s*3 + i] = sample->inputs[i];
+        }
+    }
+
+    assert(deeplearn_inference_init(&learner, &ctx, 8) == 0);
+    assert(deeplearn_infer(&learner, &ctx, inputs, outputs, 9) != 0);
+    assert(deeplearn_infer(&learner, &ctx, inputs, outputs, 8) == 0);
+
+    /* compare against the results from the training state */
+    for (s = 0; s < 8; s++) {
+        deeplearn_set_inputs(&learner, deeplearndata_get(&learner, s));
+        deeplearn_feed_forward(&learner);
+        deeplearn_get_outputs(&learner, &expected);
+        assert(fabs(outputs[s] - expected) < 0.001f);
+    }
+
+    bp_inference_free(&ctx);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_set_input_field_text()
+{
+    deeplearn learner;
+    int i, retval, no_of_hiddens=5;
+    int hidden_layers=1;
+    int no_of_outputs = 1;
+    int output_field_index[] = { 2 };
+    float error_threshold_percent[] = { 0.07f, 0.07f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep.csv";
+    FILE * fp;
+    char * expected_inputs = "111101100111011010100110--------";
+
+    printf("test_deeplearn_set_input_field_text...");
+
+    /* create a csv file */
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (i = 0; i < 10; i++) {
+        fprintf(fp,"%s,%s,%f\n","zero","zero",0.0);
+        fprintf(fp,"%s,%s,%f\n","zero","one",1.0);
+        fprintf(fp,"%s,%s,%f\n","one","zero",1.0);
+        fprintf(fp,"%s,%s,%f\n","one","one",0.0);
+    }
+    fclose(fp);
+
+    /* load the data */
+    deeplearndata_read_csv(csv_filename,
+                           &learner,
+                           no_of_hiddens, hidden_layers,
+                           no_of_outputs,
+                           output_field_index, 0,
+                           error_threshold_percent,
+                           &random_seed);
+
+    assert(learner.net->NoOfInputs == 2*4*CHAR_BITS);
+    assert(learner.no_of_input_fields == 2);
+
+    assert(learner.field_length != 0);
+    assert(learner.field_length[0] == 4*CHAR_BITS);
+    assert(learner.field_length[1] == 4*CHAR_BITS);
+
+    /* clear the inputs */
+    for (i = 0; i < learner.net->NoOfInputs; i++) {
+        deeplearn_set_input(&learner, i, 0.0f);
+    }
+
+    retval = deeplearn_set_input_field_text(&learner, 0, "one");
+    assert(retval==0);
+    for (i = 0; i < 4*(int)CHAR_BITS; i++) {
+        if (learner.net->inputs[i]->value > 0.6f) {
+            assert(expected_inputs[i] == '1');
+        }
+        if (learner.net->inputs[i]->value < 0.4f) {
+            assert(expected_inputs[i] == '0');
+        }
+        if ((learner.net->inputs[i]->value > 0.4f) &&
+            (learner.net->inputs[i]->value < 0.6f)) {
+            assert(expected_inputs[i] == '-');
+        }
+    }
+    /*
+    printf("\n");
+    for (i = 0; i < learner.net->NoOfInputs; i++) {
+        if (learner.net->inputs[i]->value > 0.6f) {
+            printf("1");
+        }
+        if (learner.net->inputs[i]->value < 0.4f) {
+            printf("0");
+        }
+        if ((learner.net->inputs[i]->value > 0.4f) &&
+            (learner.net->inputs[i]->value < 0.6f)) {
+            printf("-");
+        }
+    }
+    printf("\n");
+    */
+
+    /* free memory */
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void set_schedule_sample(deeplearn * learner)
+{
+    int i;
+
+    for (i = 0; i < learner->net->NoOfInputs; i++) {
+        deeplearn_set_input(learner, i, 0.25f + (i*0.5f/10.0f));
+    }
+    deeplearn_set_output(learner, 0, 0.3f);
+    deeplearn_set_output(learner, 1, 0.7f);
+}
+
+static int stop_after_updates(deeplearn * learner, void * data)
+{
+    return learner->schedule.step >= *((unsigned int*)data);
+}
+
+static void test_deeplearn_schedule()
+{
+    deeplearn learner;
+    float error_threshold[] = { 0.0f, 0.0f, 0.0f };
+    unsigned int random_seed = 123;
+    unsigned int stop_step = 30;
+    int itt;
+
+    printf("test_deeplearn_schedule...");
+
+    assert(deeplearn_init(&learner, 10, 4, 2, 2,
+                          error_threshold, &random_seed) == 0);
+    assert(learner.schedule.enabled == 0);
+    assert(deeplearn_set_schedule(&learner, SCHEDULES, 1, 0, 10, 1) != 0);
+    assert(deeplearn_set_schedule(&learner, SCHEDULE_STEP, 1, 0, 0, 1) != 0);
+
+    /* step schedule halves the rate every ten updates */
+    assert(deeplearn_set_schedule(&learner, SCHEDULE_STEP,
+                                  0.5f, 0.01f, 10, 0.5f) == 0);
+    assert(learner.net->learningRate == 0.5f);
+    for (itt = 0; itt < 10; itt++) {
+        set_schedule_sample(&learner);
+        deeplearn_update(&learner);
+    }
+    assert(learner.net->learningRate == 0.25f);
+    assert(learner.autocoder[0]->learningRate == 0.25f);
+
+    /* cosine schedule with a warmup */
+    assert(deeplearn_set_schedule(&learner, SCHEDULE_COSINE,
+                                  0.4f, 0.1f, 20, 1) == 0);
+    deeplearn_set_warmup(&learner, 4);
+    assert(learner.net->learningRate == 0.1f);
+    learner.schedule.step = 3;
+    assert(schedule_learning_rate(&learner.schedule) == 0.4f);
+    learner.schedule.step = 4 + 10;
+    assert(fabs(schedule_learning_rate(&learner.schedule) - 0.25f) < 0.0001f);
+    learner.schedule.step = 4 + 20;
+    assert(schedule_learning_rate(&learner.schedule) == 0.4f);
+    deeplearn_free(&learner);
+
+    /* training stops after a limited number of updates even though
+       the error thresholds can never be reached */
+    random_seed = 123;
+    assert(deeplearn_init(&learner, 10, 4, 2, 2,
+                          error_threshold, &random_seed) == 0);
+    deeplearn_set_max_updates(&learner, 50);
+    for (itt = 0; itt < 1000; itt++) {
+        if (learner.training_complete != 0) break;
+        set_schedule_sample(&learner);
+        deeplearn_update(&learner);
+    }
+    assert(itt == 50);
+    assert(learner.schedule.stopped == SCHEDULE_LIMIT);
+    deeplearn_free(&learner);
+
+    /* when the error stops improving the rate is reduced, then each
+       layer in turn is considered trained */
+    random_seed = 123;
+    assert(deeplearn_init(&learner, 10, 4, 2, 2,
+                          error_threshold, &random_seed) == 0);
+    assert(deeplearn_set_plateau(&learner, 3, 1000, 0.5f, 1) == 0);
+    assert(learner.schedule.enabled != 0);
+    for (itt = 0; itt < 10000; itt++) {
+        if (learner.training_complete != 0) break;
+        if (learner.schedule.reductions > 0) {
+            assert(learner.net->learningRate ==
+                   learner.schedule.base_rate*0.5f);
+        }
+        set_schedule_sample(&learner);
+        deeplearn_update(&learner);
+    }
+    assert(learner.training_complete != 0);
+    assert(learner.current_hidden_layer == 2);
+    assert(learner.schedule.stopped == SCHEDULE_PLATEAU);
+    deeplearn_free(&learner);
+
+    /* training stops when the callback says so */
+    random_seed = 123;
+    assert(deeplearn_init(&learner, 10, 4, 2, 2,
+                          error_threshold, &random_seed) == 0);
+    deeplearn_set_early_stop(&learner, stop_after_updates, &stop_step);
+    for (itt = 0; itt < 1000; itt++) {
+        if (learner.training_complete != 0) break;
+        set_schedule_sample(&learner);
+        deeplearn_update(&learner);
+    }
+    assert(learner.schedule.stopped == SCHEDULE_CALLBACK);
+    assert(learner.schedule.step >= stop_step);
+    assert(itt < 1000);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_shared_weights()
+{
+    deeplearn learner, learner2;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.2f, 0.2f, 0.2f, 0.2f };
+    unsigned int random_seed = 123;
+    char filename[256];
+    FILE * fp;
+    int itt,i,k;
+
+    printf("test_deeplearn_shared_weights...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    /* the autocoders train the hidden layer weights in place */
+    for (k = 0; k < hidden_layers; k++) {
+        assert(learner.autocoder[k]->shared_weights == 1);
+        assert(learner.autocoder[k]->weights ==
+               learner.net->layer[k+1].weights);
+    }
+
+    for (itt = 0; itt < 50; itt++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            deeplearn_set_input(&learner, i,
+                                0.25f + (((itt * i) % 3) * 0.25f));
+        }
+        deeplearn_update(&learner);
+    }
+    for (k = 0; k < hidden_layers; k++) {
+        assert(learner.autocoder[k]->weights ==
+               learner.net->layer[k+1].weights);
+    }
+
+    /* the loaded learner shares its weights in the same way */
+    sprintf(filename, "%stemp_deep.dat", DEEPLEARN_TEMP_DIRECTORY);
+    fp = fopen(filename, "wb");
+    assert(fp != 0);
+    assert(deeplearn_save(fp, &learner) == 0);
+    fclose(fp);
+
+    fp = fopen(filename, "rb");
+    assert(fp != 0);
+    assert(deeplearn_load(fp, &learner2, &random_seed) == 0);
+    fclose(fp);
+
+    for (k = 0; k < hidden_layers; k++) {
+        bp_layer * layer = &learner2.net->layer[k+1];
+        assert(learner2.autocoder[k]->weights == layer->weights);
+        for (i = 0; i < layer->NoOfUnits*layer->NoOfInputs; i++) {
+            assert(layer->weights[i] ==
+                   learner.net->layer[k+1].weights[i]);
+        }
+    }
+
+    deeplearn_free(&learner);
+    deeplearn_free(&learner2);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_update_pipelined()
+{
+    deeplearn learner;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.2f, 0.2f, 0.2f, 0.2f };
+    unsigned int random_seed = 123;
+    int itt,i,j,k;
+
+    printf("test_deeplearn_update_pipelined...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    assert(deeplearn_set_pipelined(&learner, 1) == 0);
+    assert(learner.pipeline.enabled == 1);
+
+    for (itt = 0; itt < 200; itt++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            deeplearn_set_input(&learner, i,
+                                0.25f + (((itt + i) % 3) * 0.25f));
+        }
+        deeplearn_update_continuous(&learner);
+
+        if (itt < hidden_layers) {
+            /* layers only begin to train once the layer below
+               has produced some encodings */
+            for (k = 0; k < hidden_layers; k++) {
+                if (k <= itt) {
+                    assert(learner.autocoder[k]->itterations ==
+                           (unsigned int)(itt - k + 1));
+                }
+                else {
+                    assert(learner.autocoder[k]->itterations == 0);
+                }
+            }
+        }
+        assert(learner.BPerror == learner.BPerror);
+        assert(learner.BPerror >= 0);
+    }
+
+    /* biases are copied to the hidden layers after each update */
+    for (k = 0; k < hidden_layers; k++) {
+        for (j = 0; j < bp_hiddens_in_layer(learner.net, k); j++) {
+            assert(learner.net->hiddens[k][j]->bias ==
+                   learner.autocoder[k]->bias[j]);
+        }
+    }
+
+    assert(deeplearn_set_pipelined(&learner, 0) == 0);
+    assert(learner.pipeline.enabled == 0);
+    assert(learner.pipeline.encodings == 0);
+
+    /* freeing while pipelined releases the encodings */
+    assert(deeplearn_set_pipelined(&learner, 1) == 0);
+    deeplearn_update_continuous(&learner);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_memory_usage()
+{
+    deeplearn learner;
+    deeplearn_footprint usage, trimmed;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=2;
+    int no_of_outputs=3;
+    int batch_size=16;
+    float error_threshold[] = { 0.2f, 0.2f, 0.0f };
+    float inputs[16*10], targets[16*3];
+    unsigned int random_seed = 123;
+    size_t weights;
+    int i;
+
+    printf("test_deeplearn_memory_usage...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    deeplearn_memory_usage(&learner, &usage);
+
+    /* at least the weights of the network and autocoders */
+    weights = (no_of_inputs*no_of_hiddens + no_of_hiddens*no_of_hiddens +
+               no_of_hiddens*no_of_outputs)*sizeof(float);
+    assert(usage.weights > weights);
+    assert(usage.optimiser > weights);
+    assert(usage.activations > 0);
+    assert(usage.datasets == 0);
+    assert(usage.history >= sizeof(learner.history));
+    assert(deeplearn_footprint_total(&usage) ==
+           usage.weights + usage.optimiser + usage.activations +
+           usage.datasets + usage.history + usage.other);
+    assert(deeplearn_footprint_total(&usage) >
+           deeplearn_arena_allocated(&learner.model_arena));
+
+    /* mini-batch arrays and gradient sums are allocated when needed */
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((i % 3) * 0.25f);
+    }
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        targets[i] = 0.25f + ((i % 2) * 0.5f);
+    }
+    learner.current_hidden_layer = hidden_layers;
+    assert(deeplearn_update_batch_values(&learner, inputs, targets,
+                                         batch_size) == 0);
+    deeplearn_memory_usage(&learner, &trimmed);
+    assert(trimmed.activations >= usage.activations +
+           2*batch_size*no_of_outputs*sizeof(float));
+    assert(trimmed.optimiser > usage.optimiser);
+    assert(trimmed.weights == usage.weights);
+
+    /* trimming returns to the footprint before the update */
+    deeplearn_trim_memory(&learner);
+    deeplearn_memory_usage(&learner, &trimmed);
+    assert(trimmed.activations == usage.activations);
+    assert(trimmed.optimiser == usage.optimiser);
+    assert(deeplearn_footprint_total(&trimmed) ==
+           deeplearn_footprint_total(&usage));
+
+    /* and training continues afterwards */
+    assert(deeplearn_update_batch_values(&learner, inputs, targets,
+                                         batch_size) == 0);
+    assert(learner.net->layer[1].batch_capacity == batch_size);
+
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_freeze_layers()
+{
+    deeplearn learner;
+    int no_of_inputs=10;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=3;
+    int batch_size=16;
+    float error_threshold[] = { 0.2f, 0.2f, 0.2f, 0.0f };
+    float inputs[16*10], targets[16*3], * weights;
+    unsigned int random_seed = 123;
+    size_t bytes;
+    int i;
+
+    printf("test_deeplearn_freeze_layers...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+    assert(deeplearn_freeze_layers(&learner, -1) == -1);
+    assert(deeplearn_freeze_layers(&learner, hidden_layers+1) == -1);
+
+    /* frozen layers are not pretrained */
+    assert(deeplearn_freeze_layers(&learner, 2) == 0);
+    assert(bp_frozen_layers(learner.net) == 2);
+    assert(learner.current_hidden_layer == 2);
+
+    /* fine tuning leaves the frozen layers unchanged */
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((i % 3) * 0.25f);
+    }
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        targets[i] = 0.25f + ((i % 2) * 0.5f);
+    }
+    learner.current_hidden_layer = hidden_layers;
+    bytes = learner.net->layer[2].NoOfUnits*learner.net->layer[2].NoOfInputs*
+        sizeof(float);
+    weights = (float*)malloc(bytes);
+    assert(weights != 0);
+    memcpy(weights, learner.net->layer[2].weights, bytes);
+    assert(deeplearn_update_batch_values(&learner, inputs, targets,
+                                         batch_size) == 0);
+    assert(memcmp(weights, learner.net->layer[2].weights, bytes) == 0);
+
+    /* unfreezing trains the whole network */
+    assert(deeplearn_freeze_layers(&learner, 0) == 0);
+    assert(bp_frozen_layers(learner.net) == 0);
+    assert(deeplearn_update_batch_values(&learner, inputs, targets,
+                                         batch_size) == 0);
+    assert(memcmp(weights, learner.net->layer[2].weights, bytes) != 0);
+
+    free(weights);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_deeplearn_feed_forward_exit()
+{
+    deeplearn learner, copy;
+    deeplearn_footprint usage, with_heads;
+    int no_of_inputs=4;
+    int no_of_hiddens=8;
+    int hidden_layers=3;
+    int no_of_outputs=2;
+    int batch_size=16;
+    float error_threshold[] = { 10.0f, 10.0f, 10.0f, 0.0f };
+    float inputs[16*4], targets[16*2], outputs[2];
+    unsigned int random_seed = 123, total;
+    int i, b, itt, layer, class;
+    char filename[256];
+    FILE * fp;
+
+    printf("test_deeplearn_feed_forward_exit...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+    learner.net->DropoutPercent = 0;
+    learner.net->noise = 0;
+    deeplearn_set_learning_rate(&learner, 1.0f);
+    deeplearn_memory_usage(&learner, &usage);
+
+    /* without heads the whole network is evaluated */
+    assert(deeplearn_feed_forward_exit(&learner) == hidden_layers);
+    assert(deeplearn_exits_enable(&learner, 0) == -1);
+    assert(deeplearn_exits_enable(&learner, 0.5f) == 0);
+    assert(learner.exits.no_of_heads == hidden_layers-1);
+    deeplearn_memory_usage(&learner, &with_heads);
+    assert(deeplearn_footprint_total(&with_heads) >
+           deeplearn_footprint_total(&usage));
+
+    /* the class follows the first input */
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            inputs[b*no_of_inputs + i] = 0.25f + (((b >> i) & 1)*0.5f);
+        }
+        targets[b*2] = 0.25f + ((b & 1)*0.5f);
+        targets[b*2+1] = 0.75f - ((b & 1)*0.5f);
+    }
+
+    /* pretrain, then train the heads alongside the output layer */
+    for (itt = 0; itt < 10000; itt++) {
+        assert(deeplearn_update_batch_values(&learner, inputs, targets,
+                                             batch_size) == 0);
+        if (learner.current_hidden_layer == hidden_layers) break;
+    }
+    assert(learner.current_hidden_layer == hidden_layers);
+    for (itt = 0; itt < 500; itt++) {
+        assert(deeplearn_update_batch_values(&learner, inputs, targets,
+                                             batch_size) == 0);
+        learner.training_complete = 0;
+    }
+
+    /* easy samples exit early with the right class */
+    exits_reset(&learner.exits);
+    for (b = 0; b < batch_size; b++) {
+        for (i = 0; i < no_of_inputs; i++) {
+            bp_set_input(learner.net, i, inputs[b*no_of_inputs + i]);
+        }
+        layer = deeplearn_feed_forward_exit(&learner);
+        assert((layer >= 0) && (layer <= hidden_layers));
+        assert(learner.exits.last_exit == layer);
+        assert(deeplearn_get_class(&learner) == 1 - (b & 1));
+    }
+    total = 0;
+    for (i = 0; i <= learner.exits.no_of_heads; i++) {
+        total += learner.exits.exits[i];
+    }
+    assert(total == (unsigned int)batch_size);
+    assert(learner.exits.exits[learner.exits.no_of_heads] <
+           (unsigned int)batch_size);
+
+    /* a threshold which can't be reached evaluates the whole network */
+    learner.exits.threshold = 10;
+    for (i = 0; i < no_of_inputs; i++) {
+        bp_set_input(learner.net, i, inputs[i]);
+    }
+    assert(deeplearn_feed_forward_exit(&learner) == hidden_layers);
+    class = deeplearn_get_class(&learner);
+    outputs[0] = deeplearn_get_output(&learner, 0);
+    outputs[1] = deeplearn_get_output(&learner, 1);
+    deeplearn_feed_forward(&learner);
+    assert(deeplearn_get_class(&learner) == class);
+    assert(deeplearn_get_output(&learner, 0) == outputs[0]);
+    assert(deeplearn_get_output(&learner, 1) == outputs[1]);
+
+    /* heads are copied with the learner */
+    assert(deeplearn_clone(&copy, &learner) == 0);
+    assert(copy.exits.no_of_heads == learner.exits.no_of_heads);
+    assert(copy.exits.weights[0] != learner.exits.weights[0]);
+    assert(memcmp(copy.exits.weights[1], learner.exits.weights[1],
+                  no_of_outputs*no_of_hiddens*sizeof(float)) == 0);
+    deeplearn_free(&copy);
+
+    /* and saved with it */
+    sprintf(filename, "%stemp_deep.dat", DEEPLEARN_TEMP_DIRECTORY);
+    fp = fopen(filename, "wb");
+    assert(fp != 0);
+    assert(deeplearn_save(fp, &learner) == 0);
+    fclose(fp);
+    fp = fopen(filename, "rb");
+    assert(fp != 0);
+    assert(deeplearn_load(fp, &copy, &random_seed) == 0);
+    fclose(fp);
+    assert(copy.exits.no_of_heads == learner.exits.no_of_heads);
+    assert(copy.exits.threshold == learner.exits.threshold);
+    for (i = 0; i < learner.exits.no_of_heads; i++) {
+        assert(memcmp(copy.exits.weights[i], learner.exits.weights[i],
+                      no_of_outputs*no_of_hiddens*sizeof(float)) == 0);
+        assert(memcmp(copy.exits.bias[i], learner.exits.bias[i],
+                      no_of_outputs*sizeof(float)) == 0);
+    }
+    deeplearn_free(&copy);
+
+    /* hogwild threads do not keep the values which heads learn from */
+    assert(deeplearn_update_hogwild(&learner, inputs, targets,
+                                    batch_size, 2) == -3);
+
+    deeplearn_exits_disable(&learner);
+    assert(learner.exits.no_of_heads == 0);
+    assert(deeplearn_feed_forward_exit(&learner) == hidden_layers);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
 int run_tests_deeplearn()
 {
     printf("\nRunning deeplearn tests\n");
 
     test_deeplearn_init();
     test_deeplearn_save_load();
+    test_deeplearn_clone();
     test_deeplearn_update();
+    test_deeplearn_schedule();
+    test_deeplearn_shared_weights();
+    test_deeplearn_update_pipelined();
     test_deeplearn_export();
+    test_deeplearn_export_library();
     test_deeplearn_csv_with_text();
     test_deeplearn_csv_numeric();
+    test_deeplearn_csv_chunked();
+    test_deeplearn_dataset_file();
+    test_deeplearn_update_batch();
+    test_deeplearn_update_hogwild();
+    test_deeplearn_sample_cache();
+    test_deeplearn_performance();
+    test_deeplearn_quantise();
+    test_deeplearn_history_plotter();
+    test_deeplearn_infer();
     test_deeplearn_set_input_field_text();
+    test_deeplearn_memory_usage();
+    test_deeplearn_freeze_layers();
+    test_deeplearn_feed_forward_exit();
 
     printf("All deeplearn tests completed\n");
     return 1;
@@ -0,0 +1,207 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_device.h"
+
+static void test_device_select()
+{
+    printf("test_device_select...");
+
+    assert(device_get_type() == DEVICE_NONE);
+    assert(device_available(DEVICE_NONE) != 0);
+    assert(device_available(DEVICE_HOST) != 0);
+    assert(device_select(DEVICE_HOST) == 0);
+    assert(device_get_type() == DEVICE_HOST);
+    assert(strcmp(device_name(device_get_type()), "host") == 0);
+    assert(device_select(99) != 0);
+    assert(device_get_type() == DEVICE_NONE);
+
+    /* OpenCL can only be selected if it is present */
+    if (device_available(DEVICE_OPENCL) == 0) {
+        assert(device_select(DEVICE_OPENCL) != 0);
+        assert(device_get_type() == DEVICE_NONE);
+    }
+    device_release();
+    assert(device_get_type() == DEVICE_NONE);
+
+    printf("Ok\n");
+}
+
+static void test_device_gemm()
+{
+    int i, m = 37, n = 19, k = 53;
+    unsigned int random_seed = 4723, uploads, generation;
+    float * a = (float*)malloc(m*k*sizeof(float));
+    float * b = (float*)malloc(n*k*sizeof(float));
+    float * c = (float*)malloc(m*n*sizeof(float));
+    float * expected = (float*)malloc(m*n*sizeof(float));
+
+    printf("test_device_gemm...");
+
+    assert(a && b && c && expected);
+    for (i = 0; i < m*k; i++) {
+        a[i] = (rand_num(&random_seed) % 10000) / 5000.0f - 1.0f;
+    }
+    for (i = 0; i < n*k; i++) {
+        b[i] = (rand_num(&random_seed) % 10000) / 5000.0f - 1.0f;
+    }
+    kernel_gemm_nt(m, n, k, a, b, expected);
+
+    assert(device_select(DEVICE_HOST) == 0);
+
+    /* small products stay on the CPU */
+    uploads = device_weight_uploads();
+    kernel_gemm_nt(m, n, k, a, b, c);
+    assert(device_weight_uploads() == uploads);
+
+    /* untracked matrices are copied for each product */
+    device_set_gemm_min(0);
+    kernel_gemm_nt(m, n, k, a, b, c);
+    assert(device_weight_uploads() == uploads + 1);
+    assert(device_resident_bytes() == 0);
+    for (i = 0; i < m*n; i++) {
+        assert(fabs(c[i] - expected[i]) < 0.001f);
+    }
+
+    /* weights stay on the device */
+    generation = device_weights_changed();
+    assert(generation != 0);
+    kernel_gemm_nt_weights(m, n, k, a, b, generation, c);
+    assert(device_weight_uploads() == uploads + 2);
+    assert(device_resident_bytes() == n*k*sizeof(float));
+    for (i = 0; i < m*n; i++) {
+        assert(fabs(c[i] - expected[i]) < 0.001f);
+    }
+    kernel_gemm_nt_weights(m, n, k, a, b, generation, c);
+    assert(device_weight_uploads() == uploads + 2);
+
+    /* when other weights change */
+    assert(device_weights_changed() != generation);
+    kernel_gemm_nt_weights(m, n, k, a, b, generation, c);
+    assert(device_weight_uploads() == uploads + 2);
+
+    /* until they change themselves */
+    b[0] += 1.0f;
+    generation = device_weights_changed();
+    kernel_gemm_nt_weights(m, n, k, a, b, generation, c);
+    assert(device_weight_uploads() == uploads + 3);
+    assert(device_resident_bytes() == n*k*sizeof(float));
+    for (i = 0; i < m; i++) {
+        assert(fabs(c[i*n] - (expected[i*n] + a[i*k])) < 0.001f);
+    }
+
+    device_release();
+    device_set_gemm_min(DEVICE_GEMM_MIN);
+    assert(device_resident_bytes() == 0);
+    free(a);
+    free(b);
+    free(c);
+    free(expected);
+
+    printf("Ok\n");
+}
+
+static void test_device_backprop()
+{
+    int i, no_of_inputs = 40, no_of_outputs = 4, batch_size = 16;
+    unsigned int random_seed = 6381, uploads;
+    bp net, other;
+    bp_inference ctx;
+    float * inputs = (float*)malloc(batch_size*no_of_inputs*sizeof(float));
+    float * targets = (float*)malloc(batch_size*no_of_outputs*sizeof(float));
+    float * outputs = (float*)malloc(batch_size*no_of_outputs*sizeof(float));
+    float * expected = (float*)malloc(batch_size*no_of_outputs*sizeof(float));
+
+    printf("test_device_backprop...");
+
+    assert(inputs && targets && outputs && expected);
+    assert(bp_init(&net, no_of_inputs, 32, 1, no_of_outputs,
+                   &random_seed) == 0);
+    assert(bp_inference_init(&ctx, &net, batch_size) == 0);
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = (rand_num(&random_seed) % 10000) / 10000.0f;
+    }
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        targets[i] = 0.25f + (i % no_of_outputs) * 0.15f;
+    }
+
+    device_set_gemm_min(0);
+    assert(device_select(DEVICE_HOST) == 0);
+    uploads = device_weight_uploads();
+    for (int itt = 0; itt < 3; itt++) {
+        /* inference on the device gives the same outputs as the CPU */
+        assert(device_select(DEVICE_NONE) == 0);
+        assert(bp_infer(&net, &ctx, inputs, expected, batch_size) == 0);
+        assert(device_select(DEVICE_HOST) == 0);
+        assert(bp_infer(&net, &ctx, inputs, outputs, batch_size) == 0);
+        for (i = 0; i < batch_size*no_of_outputs; i++) {
+            assert(fabs(outputs[i] - expected[i]) < 0.0001f);
+        }
+
+        /* training changes the weights held on the device */
+        assert(bp_update_batch(&net, inputs, targets, batch_size, 0) == 0);
+    }
+    assert(device_weight_uploads() > uploads);
+
+    /* training another network leaves these weights on the device */
+    assert(bp_infer(&net, &ctx, inputs, expected, batch_size) == 0);
+    assert(bp_init(&other, no_of_inputs, 32, 1, no_of_outputs,
+                   &random_seed) == 0);
+    assert(bp_update_batch(&other, inputs, targets, batch_size, 0) == 0);
+    bp_free(&other);
+    uploads = device_weight_uploads();
+    assert(bp_infer(&net, &ctx, inputs, outputs, batch_size) == 0);
+    assert(device_weight_uploads() == uploads);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(outputs[i] == expected[i]);
+    }
+
+    device_release();
+    device_set_gemm_min(DEVICE_GEMM_MIN);
+    bp_inference_free(&ctx);
+    bp_free(&net);
+    free(inputs);
+    free(targets);
+    free(outputs);
+    free(expected);
+
+    printf("Ok\n");
+}
+
+int run_tests_device()
+{
+    printf("\nRunning device tests\n");
+
+    test_device_select();
+    test_device_gemm();
+    test_device_backprop();
+
+    printf("All device tests completed\n");
+    return 1;
+}
@@ -0,0 +1,235 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_distill.h"
+
+static void test_distill_learner()
+{
+    deeplearn teacher, student;
+    deeplearn_distill distill, labels;
+    int output_field_index[] = { 2 };
+    float error_threshold[] = { 5.0f, 5.0f, 0.01f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_distill.csv";
+    float * inputs, * targets, initial_error, error, label[1];
+    int i, s, no_of_inputs, batch = 8;
+    FILE * fp;
+
+    printf("test_distill_learner...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (i = 0; i < 40; i++) {
+        float x = (i % 10)*1.1f, y = (i / 10)*2.3f;
+        fprintf(fp,"%f,%f,%f\n", x, y, x + y);
+    }
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename, &teacher,
+                                  8, 2, 1, output_field_index, 0,
+                                  error_threshold, &random_seed) == 40);
+    no_of_inputs = teacher.net->NoOfInputs;
+
+    /* give the teacher something to teach */
+    inputs = (float*)malloc(batch*no_of_inputs*sizeof(float));
+    targets = (float*)malloc(batch*sizeof(float));
+    assert(inputs);
+    assert(targets);
+    for (i = 0; i < 400; i++) {
+        for (s = 0; s < batch; s++) {
+            deeplearndata * sample =
+                deeplearndata_get_training_labeled(&teacher,
+                    rand_num(&random_seed) %
+                    teacher.training_data_labeled_samples);
+            deeplearn_encode_inputs(&teacher, sample,
+                                    &inputs[s*no_of_inputs]);
+            deeplearn_encode_outputs(&teacher, sample, &targets[s]);
+        }
+        assert(deeplearn_update_batch_values(&teacher, inputs, targets,
+                                             batch) == 0);
+    }
+    free(inputs);
+    free(targets);
+
+    assert(deeplearn_distill_init(&distill, &teacher, 1.5f) != 0);
+    assert(deeplearn_distill_init(&distill, &teacher, 0.0f) == 0);
+    assert(distill.samples == teacher.indexed_training_data_samples);
+    assert(distill.labeled == teacher.training_data_labeled_samples);
+    assert(distill.no_of_inputs == no_of_inputs);
+    assert(distill.no_of_outputs == 1);
+
+    /* with no weight on the labels the targets are the teacher's
+       own outputs */
+    for (s = 0; s < distill.samples; s++) {
+        deeplearn_set_inputs(&teacher, deeplearndata_get_training(&teacher, s));
+        deeplearn_feed_forward(&teacher);
+        assert(fabs(distill.targets[s] -
+                    deeplearn_get_output(&teacher, 0)) < 0.0001f);
+    }
+
+    /* with all weight on the labels the targets are the labels */
+    assert(deeplearn_distill_init(&labels, &teacher, 1.0f) == 0);
+    for (s = 0; s < labels.samples; s++) {
+        deeplearn_encode_outputs(&teacher,
+                                 deeplearndata_get_training(&teacher, s),
+                                 label);
+        assert(fabs(labels.targets[s] - label[0]) < 0.0001f);
+    }
+    deeplearn_distill_free(&labels);
+
+    /* a smaller student follows the teacher */
+    assert(deeplearn_init_like(&student, &teacher, 4, 1,
+                               &random_seed) == 0);
+    assert(student.net->HiddenLayers == 1);
+    assert(student.net->NoOfInputs == no_of_inputs);
+    initial_error = deeplearn_distill_error(&distill, &student);
+    assert(initial_error >= 0);
+    assert(deeplearn_distill_train(&distill, &student, 0, 8,
+                                   &random_seed) != 0);
+    assert(deeplearn_distill_train(&distill, &student, 8000, 8,
+                                   &random_seed) == 0);
+    error = deeplearn_distill_error(&distill, &student);
+    assert(error >= 0);
+    assert(error < initial_error);
+
+    deeplearn_distill_free(&distill);
+    assert(distill.inputs == NULL);
+    deeplearn_free(&student);
+    deeplearn_free(&teacher);
+
+    printf("Ok\n");
+}
+
+static void test_distill_convnet()
+{
+    int no_of_convolutions = 2;
+    int no_of_deep_layers = 2;
+    int inputs_across = 16;
+    int inputs_down = 16;
+    int inputs_depth = 3;
+    int max_features = 4;
+    int reduction_factor = 2;
+    int no_of_outputs = 4;
+    int no_of_images = 20, img_size, i, s;
+    deepconvnet teacher, student;
+    deeplearn learner;
+    deeplearn_distill distill;
+    float error_threshold[] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+    unsigned int random_seed = 5217;
+
+    printf("test_distill_convnet...");
+
+    assert(deepconvnet_init(no_of_convolutions,
+                            no_of_deep_layers,
+                            inputs_across,
+                            inputs_down,
+                            inputs_depth,
+                            max_features,
+                            reduction_factor,
+                            no_of_outputs,
+                            &teacher,
+                            error_threshold,
+                            &random_seed) == 0);
+
+    img_size = inputs_across*inputs_down*inputs_depth;
+    teacher.no_of_images = no_of_images;
+    teacher.images =
+        (unsigned char**)malloc(no_of_images*sizeof(unsigned char*));
+    teacher.classifications = (char**)malloc(no_of_images*sizeof(char*));
+    teacher.classification_number = (int*)malloc(no_of_images*sizeof(int));
+    assert(teacher.images);
+    assert(teacher.classifications);
+    assert(teacher.classification_number);
+    for (i = 0; i < no_of_images; i++) {
+        teacher.images[i] = (unsigned char*)malloc(img_size);
+        teacher.classifications[i] = (char*)malloc(2);
+        assert(teacher.images[i]);
+        assert(teacher.classifications[i]);
+        for (int j = 0; j < img_size; j++) {
+            teacher.images[i][j] = (unsigned char)(rand_num(&random_seed) % 256);
+        }
+        teacher.classification_number[i] = i % no_of_outputs;
+        sprintf(teacher.classifications[i], "%d", i % no_of_outputs);
+    }
+    assert(deepconvnet_create_training_test_sets(&teacher) == 0);
+
+    /* the convolution layers must be trained first */
+    assert(deeplearn_distill_init_convnet(&distill, &teacher, 0.5f) != 0);
+    teacher.convolution->training_complete = 1;
+    assert(deeplearn_distill_init_convnet(&distill, &teacher, 0.5f) == 0);
+    assert(distill.samples == teacher.training_images);
+    assert(distill.labeled == distill.samples);
+    assert(distill.no_of_inputs == teacher.learner->net->NoOfInputs);
+    assert(distill.no_of_outputs == no_of_outputs);
+
+    /* half of each target comes from the class of the image */
+    for (s = 0; s < distill.samples; s++) {
+        int class_number =
+            teacher.classification_number[teacher.training_set_index[s]];
+        for (i = 0; i < no_of_outputs; i++) {
+            float target = distill.targets[s*no_of_outputs + i];
+            if (i == class_number) {
+                assert(target >= 0.375f);
+            }
+            else {
+                assert(target <= 0.625f);
+            }
+        }
+    }
+
+    /* a smaller deep learner takes the place of the teacher's */
+    assert(deeplearn_init_like(&learner, teacher.learner, 4, 1,
+                               &random_seed) == 0);
+    assert(deeplearn_distill_train(&distill, &learner, 200, 8,
+                                   &random_seed) == 0);
+    assert(deeplearn_distill_convnet(&student, &teacher, &learner) == 0);
+    assert(student.learner->net->HiddenLayers == 1);
+    assert(student.learner->net->NoOfHiddens == 4);
+    assert(student.images == NULL);
+    assert(deepconvnet_test_img(&student, teacher.images[0]) == 0);
+    assert(deeplearn_get_class(student.learner) >= 0);
+
+    deeplearn_distill_free(&distill);
+    deeplearn_free(&learner);
+    deepconvnet_free(&student);
+    deepconvnet_free(&teacher);
+
+    printf("Ok\n");
+}
+
+int run_tests_distill()
+{
+    printf("\nRunning distill tests\n");
+
+    test_distill_learner();
+    test_distill_convnet();
+
+    printf("All distill tests completed\n");
+    return 1;
+}
@@ -52,11 +52,333 @@ static void test_dnc_init() {
     deeplearn_dnc_free(&learner);
 }
 
+static void test_dnc_content_addressing()
+{
+    deeplearn_dnc learner;
+    int memory_size = 4096;
+    int memory_width = 16;
+    float error_threshold[] = {0.1f, 0.1f, 0.1f};
+    unsigned int random_seed = 3672;
+    float * weighting, write[16], erase[16], read[16], key[16];
+    float total;
+    int i, j, best;
+
+    printf("test_dnc_content_addressing...");
+
+    assert(deeplearn_dnc_init(&learner, memory_size, memory_width,
+                              4, 8, 2, 3, error_threshold,
+                              &random_seed) == 0);
+    weighting = (float*)malloc(memory_size*sizeof(float));
+    assert(weighting);
+
+    /* fill each address with a different vector */
+    for (i = 0; i < memory_size; i++) {
+        memset((void*)weighting, '\0', memory_size*sizeof(float));
+        weighting[i] = 1;
+        for (j = 0; j < memory_width; j++) {
+            write[j] = (rand_num(&random_seed)%10000)/5000.0f - 1.0f;
+            erase[j] = 1;
+        }
+        deeplearn_dnc_write_memory(&learner, weighting, write, erase);
+        assert(learner.memory.inverse_length[i] > 0);
+        if (i == 1234) {
+            memcpy((void*)key, (void*)write, memory_width*sizeof(float));
+        }
+    }
+
+    /* lengths of keys don't change the weighting */
+    for (j = 0; j < memory_width; j++) {
+        key[j] *= 3;
+    }
+    deeplearn_dnc_content_weighting(&learner, key, 50, weighting);
+    best = 0;
+    total = 0;
+    for (i = 0; i < memory_size; i++) {
+        assert(weighting[i] >= 0);
+        total += weighting[i];
+        if (weighting[i] > weighting[best]) best = i;
+    }
+    assert(best == 1234);
+    assert(fabs(total - 1) < 0.001f);
+
+    /* reading with a one-hot weighting returns the address */
+    memset((void*)weighting, '\0', memory_size*sizeof(float));
+    weighting[1234] = 1;
+    deeplearn_dnc_read_memory(&learner, weighting, read);
+    for (j = 0; j < memory_width; j++) {
+        assert(fabs(read[j] - key[j]/3) < 0.0001f);
+    }
+
+    /* half erasing an address */
+    weighting[1234] = 0.5f;
+    memset((void*)write, '\0', memory_width*sizeof(float));
+    deeplearn_dnc_write_memory(&learner, weighting, write, erase);
+    weighting[1234] = 1;
+    deeplearn_dnc_read_memory(&learner, weighting, read);
+    for (j = 0; j < memory_width; j++) {
+        assert(fabs(read[j] - key[j]/6) < 0.0001f);
+    }
+
+    /* the heads read into the controller inputs */
+    for (i = 0; i < 4; i++) {
+        deeplearn_dnc_set_input(&learner, i, 0.25f + i*0.1f);
+    }
+    deeplearn_dnc_feed_forward(&learner);
+    for (i = 4; i < 4 + memory_width*DEEPLEARNDNC_READ_HEADS; i++) {
+        assert(learner.controller->net->inputs[i]->value >= 0.25f);
+        assert(learner.controller->net->inputs[i]->value <= 0.75f);
+    }
+
+    deeplearn_dnc_clear_memory(&learner);
+    for (i = 0; i < memory_size; i++) {
+        assert(learner.memory.inverse_length[i] == 0);
+    }
+
+    free(weighting);
+    deeplearn_dnc_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_dnc_sparse()
+{
+    deeplearn_dnc learner;
+    int memory_size = 4096;
+    int memory_width = 16;
+    int k = 8;
+    float error_threshold[] = {0.1f, 0.1f, 0.1f};
+    unsigned int random_seed = 7823;
+    float write[16], erase[16], read[16], key[16], weighting[8], one = 1;
+    int index[8], i, j, n, blocks;
+
+    printf("test_dnc_sparse...");
+
+    assert(deeplearn_dnc_init(&learner, memory_size, memory_width,
+                              4, 8, 2, 3, error_threshold,
+                              &random_seed) == 0);
+    assert(deeplearn_dnc_set_sparse(&learner, memory_size + 1) != 0);
+    assert(deeplearn_dnc_set_sparse(&learner, k) == 0);
+    assert(learner.sparse_k == k);
+
+    /* nothing has been written, so nothing matches */
+    for (j = 0; j < memory_width; j++) {
+        key[j] = 1;
+    }
+    assert(deeplearn_dnc_content_weighting_sparse(&learner, key, 10,
+                                                  index, weighting) == 0);
+
+    /* fill each address with a different vector */
+    for (i = 0; i < memory_size; i++) {
+        for (j = 0; j < memory_width; j++) {
+            write[j] = (rand_num(&random_seed)%10000)/5000.0f - 1.0f;
+            erase[j] = 1;
+        }
+        deeplearn_dnc_write_memory_sparse(&learner, 1, &i, &one, write, erase);
+        if (i == 1234) {
+            memcpy((void*)key, (void*)write, memory_width*sizeof(float));
+        }
+    }
+
+    /* the nearest neighbour is found within the index */
+    n = deeplearn_dnc_content_weighting_sparse(&learner, key, 50,
+                                               index, weighting);
+    assert(n == k);
+    assert(index[0] == 1234);
+    for (i = 1; i < n; i++) {
+        assert(weighting[i] <= weighting[i-1]);
+        assert(index[i] != 1234);
+    }
+    deeplearn_dnc_read_memory_sparse(&learner, 1, index, &one, read);
+    for (j = 0; j < memory_width; j++) {
+        assert(fabs(read[j] - key[j]) < 0.0001f);
+    }
+
+    /* rebuilding the index from existing content */
+    assert(deeplearn_dnc_set_sparse(&learner, 0) == 0);
+    assert(learner.read_head[0].sparse_index == NULL);
+    assert(deeplearn_dnc_set_sparse(&learner, k) == 0);
+    n = deeplearn_dnc_content_weighting_sparse(&learner, key, 50,
+                                               index, weighting);
+    assert(index[0] == 1234);
+
+    /* each step only touches a few addresses, and links the blocks
+       which were written one after another */
+    deeplearn_dnc_clear_memory(&learner);
+    for (i = 0; i < 20; i++) {
+        for (j = 0; j < 4; j++) {
+            deeplearn_dnc_set_input(&learner, j,
+                                    (rand_num(&random_seed)%10000)/10000.0f);
+        }
+        deeplearn_dnc_feed_forward(&learner);
+        assert(learner.write_head[0].sparse_count > 0);
+        assert(learner.write_head[0].sparse_count <= k + 1);
+        assert(learner.read_head[0].sparse_count <= k +
+               2*DEEPLEARNDNC_LINKS*DEEPLEARNDNC_USAGE_BLOCK_SIZE);
+    }
+    blocks = memory_size / DEEPLEARNDNC_USAGE_BLOCK_SIZE;
+    for (i = 0; i < blocks*DEEPLEARNDNC_LINKS; i++) {
+        deeplearn_dnc_links * temporal =
+            &learner.memory.usage_temporal[DEEPLEARNDNC_READ_HEADS];
+        assert(temporal->next[i] < blocks);
+        assert(temporal->prev[i] < blocks);
+        if (temporal->next[i] >= 0) {
+            assert(temporal->next_strength[i] > 0);
+            assert(temporal->next_strength[i] <= 1);
+        }
+    }
+
+    deeplearn_dnc_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_dnc_usage()
+{
+    deeplearn_dnc learner;
+    int memory_size = 1000;
+    int memory_width = 8;
+    float error_threshold[] = {0.1f, 0.1f, 0.1f};
+    unsigned int random_seed = 5217;
+    float write[8], erase[8], weight, minimum;
+    int i, j, address;
+
+    printf("test_dnc_usage...");
+
+    assert(deeplearn_dnc_init(&learner, memory_size, memory_width,
+                              4, 8, 2, 3, error_threshold,
+                              &random_seed) == 0);
+    for (j = 0; j < memory_width; j++) {
+        write[j] = 0.5f;
+        erase[j] = 1;
+    }
+
+    /* fill all but one address */
+    weight = 1;
+    for (i = 0; i < memory_size; i++) {
+        if (i == 777) continue;
+        deeplearn_dnc_write_memory_sparse(&learner, 1, &i, &weight,
+                                          write, erase);
+    }
+    assert(deeplearn_dnc_least_used(&learner) == 777);
+
+    /* partly fill it, then release another address by reading it */
+    i = 777;
+    weight = 0.5f;
+    deeplearn_dnc_write_memory_sparse(&learner, 1, &i, &weight, write, erase);
+    assert(fabs(learner.memory.usage[777] - 0.5f) < 0.0001f);
+    for (i = 0; i < 10; i++) {
+        deeplearn_dnc_free_usage(&learner, 999, 1);
+    }
+    assert(learner.memory.usage[999] < 0.5f);
+    assert(deeplearn_dnc_least_used(&learner) == 999);
+
+    /* the least used address agrees with a search of all addresses */
+    for (i = 0; i < 500; i++) {
+        address = rand_num(&random_seed)%memory_size;
+        weight = (rand_num(&random_seed)%10000)/10000.0f;
+        if (i%2 == 0) {
+            deeplearn_dnc_write_memory_sparse(&learner, 1, &address, &weight,
+                                              write, erase);
+        }
+        else {
+            deeplearn_dnc_free_usage(&learner, address, weight);
+        }
+        minimum = learner.memory.usage[0];
+        for (j = 1; j < memory_size; j++) {
+            if (learner.memory.usage[j] < minimum) {
+                minimum = learner.memory.usage[j];
+            }
+        }
+        assert(learner.memory.usage[deeplearn_dnc_least_used(&learner)] ==
+               minimum);
+    }
+
+    deeplearn_dnc_clear_memory(&learner);
+    assert(learner.memory.usage[deeplearn_dnc_least_used(&learner)] == 0);
+
+    deeplearn_dnc_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_dnc_update_sequences()
+{
+    deeplearn_dnc learner;
+    int memory_size = 64;
+    int memory_width = 4;
+    int no_of_inputs = 3;
+    int no_of_outputs = 2;
+    int no_of_sequences = 4;
+    int sequence_length = 6;
+    float error_threshold[] = {0.1f, 0.1f, 0.1f};
+    unsigned int random_seed = 8126;
+    float inputs[4*6*3], targets[4*6*2], weighting[64], write[4], erase[4];
+    float read[4];
+    unsigned int itterations;
+    int i, j;
+
+    printf("test_dnc_update_sequences...");
+
+    assert(deeplearn_dnc_init(&learner, memory_size, memory_width,
+                              no_of_inputs, 6, 1, no_of_outputs,
+                              error_threshold, &random_seed) == 0);
+
+    /* something stored within the memory of the DNC object */
+    memset((void*)weighting, '\0', memory_size*sizeof(float));
+    weighting[10] = 1;
+    for (j = 0; j < memory_width; j++) {
+        write[j] = 0.1f*(j+1);
+        erase[j] = 1;
+    }
+    deeplearn_dnc_write_memory(&learner, weighting, write, erase);
+
+    /* each sequence repeats its first input at the end */
+    for (i = 0; i < no_of_sequences*sequence_length; i++) {
+        for (j = 0; j < no_of_inputs; j++) {
+            inputs[i*no_of_inputs + j] =
+                (rand_num(&random_seed)%10000)/10000.0f;
+        }
+        targets[i*no_of_outputs] = inputs[(i - i%sequence_length)*no_of_inputs];
+        targets[i*no_of_outputs + 1] = 0.5f;
+    }
+
+    assert(deeplearn_dnc_update_sequences(&learner, inputs, targets,
+                                          0, sequence_length) != 0);
+    assert(deeplearn_dnc_update_sequences(&learner, inputs, targets,
+                                          no_of_sequences,
+                                          sequence_length) == 0);
+    itterations = learner.controller->net->itterations;
+    assert(itterations >= (unsigned int)(no_of_sequences*sequence_length));
+
+    /* sparse mode */
+    assert(deeplearn_dnc_set_sparse(&learner, 4) == 0);
+    assert(deeplearn_dnc_update_sequences(&learner, inputs, targets,
+                                          no_of_sequences,
+                                          sequence_length) == 0);
+    assert(learner.controller->net->itterations >= itterations +
+           (unsigned int)(no_of_sequences*sequence_length));
+    assert(learner.sparse_k == 4);
+
+    /* the memory of the DNC object is unchanged */
+    deeplearn_dnc_read_memory(&learner, weighting, read);
+    for (j = 0; j < memory_width; j++) {
+        assert(fabs(read[j] - write[j]) < 0.0001f);
+    }
+
+    deeplearn_dnc_free(&learner);
+
+    printf("Ok\n");
+}
+
 int run_tests_dnc()
 {
     printf("\nRunning dnc tests\n");
 
     test_dnc_init();
+    test_dnc_content_addressing();
+    test_dnc_sparse();
+    test_dnc_usage();
+    test_dnc_update_sequences();
 
     printf("All dnc tests completed\n");
     return 1;
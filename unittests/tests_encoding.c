@@ -123,11 +123,76 @@ static void test_encode_text()
     printf("Ok\n");
 }
 
+static void test_encode_text_to_floats()
+{
+    printf("test_encode_text_to_floats...");
+
+    char text[257];
+    bp_neuron ** inputs;
+    float * values;
+    int max_field_length_chars = 260;
+    int no_of_inputs = CHAR_BITS*max_field_length_chars;
+    int i, offset;
+
+    /* every possible byte value */
+    for (i = 0; i < 256; i++) {
+        text[i] = (char)(255 - i);
+    }
+    text[255] = 'x';
+    text[256] = 0;
+
+    inputs = (bp_neuron**)malloc(no_of_inputs*sizeof(bp_neuron*));
+    values = (float*)malloc(no_of_inputs*sizeof(float));
+    assert(inputs);
+    assert(values);
+    for (i = 0; i < no_of_inputs; i++) {
+        inputs[i] = (bp_neuron*)malloc(sizeof(bp_neuron));
+        assert(inputs[i]);
+        inputs[i]->value = -1;
+        values[i] = -1;
+    }
+
+    /* the same values as when encoding into neurons, including
+       padding at the end of the field */
+    offset = enc_text_to_binary(text, inputs, no_of_inputs, 0,
+                                max_field_length_chars);
+    assert(enc_text_to_floats(text, values, no_of_inputs, 0,
+                              max_field_length_chars) == offset);
+    for (i = 0; i < no_of_inputs; i++) {
+        assert(values[i] == inputs[i]->value);
+    }
+    assert(values[no_of_inputs-1] == 0.5f);
+
+    /* bits are least significant first */
+    assert(enc_text_to_floats("A", values, no_of_inputs, 4, 1) ==
+           4 + CHAR_BITS);
+    assert(values[4] == 0.75f);
+    assert(values[5] == 0.25f);
+    assert(values[10] == 0.75f);
+    assert(values[11] == 0.25f);
+
+    /* text truncated at the end of the inputs */
+    offset = no_of_inputs - 12;
+    assert(enc_text_to_floats("abcdef", values, no_of_inputs, offset, 6) ==
+           no_of_inputs);
+    assert(values[no_of_inputs-1] == 0.5f);
+
+    /* free memory */
+    for (i = 0; i < no_of_inputs; i++) {
+        free(inputs[i]);
+    }
+    free(inputs);
+    free(values);
+
+    printf("Ok\n");
+}
+
 int run_tests_encoding()
 {
     printf("\nRunning encoding tests\n");
 
     test_encode_text();
+    test_encode_text_to_floats();
 
     printf("All encoding tests completed\n");
     return 1;
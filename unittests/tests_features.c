@@ -260,6 +260,342 @@ static void test_features_conv_img_to_flt()
     printf("Ok\n");
 }
 
+static void test_features_conv_parallel()
+{
+    int patch_radius = 4;
+    int img_width = 320;
+    int img_height = 240;
+    int samples_across = img_width/patch_radius;
+    int samples_down = img_height/patch_radius;
+    int img_depth=3;
+    unsigned char * img =
+        (unsigned char*)malloc(img_width*img_height*img_depth*sizeof(unsigned char));
+    int max_features = 20;
+    int layer0_units = samples_across*samples_down*max_features;
+    float * layer0 = (float*)malloc(layer0_units*sizeof(float));
+    float * layer1 = (float*)malloc(layer0_units*sizeof(float));
+    float expected[20];
+    ac feature_autocoder;
+    int no_of_inputs = patch_radius*patch_radius*4*img_depth;
+    int no_of_hiddens = max_features;
+    unsigned int random_seed = 2389;
+    int i, x, y, d, n, fx = 7, fy = 5;
+    int tx=0, ty=0, bx=0, by=0;
+
+    printf("test_features_conv_parallel...");
+
+    assert(img);
+    assert(layer0);
+    assert(layer1);
+    assert(autocoder_init(&feature_autocoder,
+                          no_of_inputs, no_of_hiddens,
+                          random_seed) == 0);
+
+    for (i = 0; i < img_width*img_height*img_depth; i++) {
+        img[i] = (unsigned char)(rand_num(&random_seed)%256);
+    }
+
+    /* the result should not depend upon the number of threads */
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+    omp_set_num_threads(1);
+#endif
+    assert(features_conv_img_to_flt(samples_across, samples_down,
+                                    patch_radius,
+                                    img_width, img_height, img_depth,
+                                    img, layer0_units, layer0,
+                                    &feature_autocoder, 0) == 0);
+#ifdef _OPENMP
+    omp_set_num_threads(4);
+#endif
+    assert(features_conv_img_to_flt(samples_across, samples_down,
+                                    patch_radius,
+                                    img_width, img_height, img_depth,
+                                    img, layer0_units, layer1,
+                                    &feature_autocoder, 0) == 0);
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+    for (i = 0; i < layer0_units; i++) {
+        assert(layer0[i] == layer1[i]);
+    }
+
+    /* compare a patch against encoding with the autocoder */
+    assert(features_patch_coords(fx, fy, samples_across, samples_down,
+                                 patch_radius, img_width, img_height,
+                                 &tx, &ty, &bx, &by) == 0);
+    n = 0;
+    for (y = ty; y < by; y++) {
+        for (x = tx; x < bx; x++) {
+            for (d = 0; d < img_depth; d++) {
+                autocoder_set_input(&feature_autocoder, n++,
+                                    PIXEL_TO_FLOAT(img[((y*img_width)+x)*img_depth + d]));
+            }
+        }
+    }
+    autocoder_encode(&feature_autocoder, expected, 0);
+    for (i = 0; i < max_features; i++) {
+        assert(fabs(layer0[((fy*samples_across)+fx)*max_features + i] -
+                    expected[i]) < 0.00001f);
+    }
+
+    autocoder_free(&feature_autocoder);
+    free(img);
+    free(layer0);
+    free(layer1);
+
+    printf("Ok\n");
+}
+
+static void test_features_scan_geometries()
+{
+    int img_width = 40;
+    int img_height = 30;
+    int samples_across = 10;
+    int samples_down = 8;
+    int no_of_features = 3;
+    int depths[] = { 1, 3, 5 };
+    int layer_units = samples_across*samples_down*no_of_features;
+    unsigned char * img = (unsigned char*)malloc(img_width*img_height*5);
+    float * flt = (float*)malloc(img_width*img_height*5*sizeof(float));
+    float * layer_img = (float*)malloc(layer_units*sizeof(float));
+    float * layer_flt = (float*)malloc(layer_units*sizeof(float));
+    float expected[3];
+    unsigned int random_seed = 8129;
+    int i, x, y, d, n, fx, fy, radius, depth;
+    int tx=0, ty=0, bx=0, by=0;
+    ac feature_autocoder;
+
+    printf("test_features_scan_geometries...");
+
+    assert(img);
+    assert(flt);
+    assert(layer_img);
+    assert(layer_flt);
+    for (i = 0; i < img_width*img_height*5; i++) {
+        img[i] = (unsigned char)(rand_num(&random_seed)%256);
+        flt[i] = PIXEL_TO_FLOAT(img[i]);
+    }
+
+    /* specialised and generic scanners give the same patches */
+    for (radius = 1; radius <= FEATURES_SCAN_MAX_RADIUS+1; radius++) {
+        for (d = 0; d < 3; d++) {
+            depth = depths[d];
+            assert(autocoder_init(&feature_autocoder,
+                                  radius*radius*4*depth, no_of_features,
+                                  random_seed) == 0);
+            assert(features_conv_img_to_flt(samples_across, samples_down,
+                                            radius, img_width, img_height,
+                                            depth, img, layer_units,
+                                            layer_img, &feature_autocoder,
+                                            0) == 0);
+            assert(features_conv_flt_to_flt(samples_across, samples_down,
+                                            radius, img_width, img_height,
+                                            depth, flt, layer_units,
+                                            layer_flt, &feature_autocoder,
+                                            0) == 0);
+
+            for (fy = 0; fy < samples_down; fy++) {
+                for (fx = 0; fx < samples_across; fx++) {
+                    if (features_patch_coords(fx, fy,
+                                              samples_across, samples_down,
+                                              radius, img_width, img_height,
+                                              &tx, &ty, &bx, &by) != 0) {
+                        continue;
+                    }
+                    n = 0;
+                    for (y = ty; y < by; y++) {
+                        for (x = tx; x < bx; x++) {
+                            for (i = 0; i < depth; i++) {
+                                autocoder_set_input(&feature_autocoder, n++,
+                                                    flt[((y*img_width)+x)*depth + i]);
+                            }
+                        }
+                    }
+                    autocoder_encode(&feature_autocoder, expected, 0);
+                    for (i = 0; i < no_of_features; i++) {
+                        n = ((fy*samples_across)+fx)*no_of_features + i;
+                        assert(fabs(layer_img[n] - expected[i]) < 0.00001f);
+                        assert(fabs(layer_flt[n] - expected[i]) < 0.00001f);
+                    }
+                }
+            }
+            autocoder_free(&feature_autocoder);
+        }
+    }
+
+    free(img);
+    free(flt);
+    free(layer_img);
+    free(layer_flt);
+
+    printf("Ok\n");
+}
+
+static void test_learn_patch_batch()
+{
+    int patch_radius = 4;
+    int img_width = 128;
+    int img_height = 128;
+    int img_depth = 1;
+    int samples_across = img_width/patch_radius;
+    int samples_down = img_height/patch_radius;
+    int no_of_features = 16;
+    int layer0_units = samples_across*samples_down*no_of_features;
+    float * flt = (float*)malloc(img_width*img_height*img_depth*sizeof(float));
+    float BPerror = 0, error_start = 0, error_end = 0;
+    ac net1, net2;
+    unsigned int random_seed = 567;
+    int i, x, y;
+
+    printf("test_learn_patch_batch...");
+
+    assert(flt);
+    for (y = 0; y < img_height; y++) {
+        for (x = 0; x < img_width; x++) {
+            flt[y*img_width + x] =
+                0.25f + (((x/8 + y/8) % 2)*0.5f);
+        }
+    }
+
+    assert(autocoder_init(&net1, patch_radius*patch_radius*4*img_depth,
+                          no_of_features, random_seed) == 0);
+    assert(autocoder_init(&net2, patch_radius*patch_radius*4*img_depth,
+                          no_of_features, random_seed) == 0);
+    net1.patch_batch = 1;
+    net2.patch_batch = 1;
+    net1.learningRate = 4.0f;
+    net2.learningRate = 4.0f;
+
+#ifdef _OPENMP
+    int threads = omp_get_max_threads();
+#endif
+    for (i = 0; i < 20; i++) {
+#ifdef _OPENMP
+        omp_set_num_threads(1);
+#endif
+        assert(features_learn_from_flt(samples_across, samples_down,
+                                       patch_radius,
+                                       img_width, img_height, img_depth,
+                                       flt, layer0_units,
+                                       &net1, &BPerror) == 0);
+        if (i < 5) error_start += BPerror;
+        if (i >= 15) error_end += BPerror;
+#ifdef _OPENMP
+        omp_set_num_threads(4);
+#endif
+        assert(features_learn_from_flt(samples_across, samples_down,
+                                       patch_radius,
+                                       img_width, img_height, img_depth,
+                                       flt, layer0_units,
+                                       &net2, &BPerror) == 0);
+    }
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+
+    /* check that the training error reduced */
+    assert(error_end < error_start);
+
+    /* the result should not depend upon the number of threads */
+    assert(autocoder_compare(&net1, &net2) == 0);
+    assert(net1.itterations == net2.itterations);
+    assert(net1.itterations > 0);
+
+    autocoder_free(&net1);
+    autocoder_free(&net2);
+    free(flt);
+
+    printf("Ok\n");
+}
+
+static void test_features_deconv()
+{
+    int patch_radius = 3;
+    int img_width = 61;
+    int img_height = 47;
+    int img_depth = 2;
+    int samples_across = 15;
+    int samples_down = 11;
+    int no_of_hiddens = 12;
+    int no_of_inputs = patch_radius*patch_radius*4*img_depth;
+    int layer_units = samples_across*samples_down*no_of_hiddens;
+    float * layer = (float*)malloc(layer_units*sizeof(float));
+    float * img = (float*)malloc(img_width*img_height*img_depth*sizeof(float));
+    float * expected = (float*)malloc(img_width*img_height*img_depth*sizeof(float));
+    int * overlapping = (int*)malloc(img_width*img_height*sizeof(int));
+    unsigned int random_seed = 6126;
+    ac feature_autocoder;
+
+    printf("test_features_deconv...");
+
+    assert(layer && img && expected && overlapping);
+    assert(autocoder_init(&feature_autocoder, no_of_inputs, no_of_hiddens,
+                          random_seed) == 0);
+    for (int i = 0; i < layer_units; i++) {
+        /* some responses are zero */
+        layer[i] = (i%5 == 0) ? 0 : (rand_num(&random_seed)%10000)/10000.0f;
+    }
+
+    /* scatter each patch, then average */
+    memset((void*)expected, '\0', img_width*img_height*img_depth*sizeof(float));
+    memset((void*)overlapping, '\0', img_width*img_height*sizeof(int));
+    for (int fy = 0; fy < samples_down; fy++) {
+        for (int fx = 0; fx < samples_across; fx++) {
+            int tx, ty, bx, by;
+            if (features_patch_coords(fx, fy, samples_across, samples_down,
+                                      patch_radius, img_width, img_height,
+                                      &tx, &ty, &bx, &by) != 0) {
+                continue;
+            }
+            for (int y = ty; y < by; y++) {
+                for (int x = tx; x < bx; x++) {
+                    overlapping[y*img_width + x]++;
+                    for (int d = 0; d < img_depth; d++) {
+                        int n = ((y-ty)*(bx-tx) + (x-tx))*img_depth + d;
+                        for (int h = 0; h < no_of_hiddens; h++) {
+                            expected[(y*img_width + x)*img_depth + d] +=
+                                layer[(fy*samples_across + fx)*no_of_hiddens + h] *
+                                feature_autocoder.weights[h*no_of_inputs + n];
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for (int i = 0; i < img_width*img_height; i++) {
+        for (int d = 0; d < img_depth; d++) {
+            if (overlapping[i] > 0) {
+                expected[i*img_depth + d] /= overlapping[i];
+            }
+        }
+    }
+
+    assert(features_deconv_flt_to_flt(samples_across, samples_down,
+                                      patch_radius,
+                                      img_width, img_height, img_depth,
+                                      img, layer_units, layer,
+                                      &feature_autocoder) == 0);
+    for (int i = 0; i < img_width*img_height*img_depth; i++) {
+        assert(fabs(img[i] - expected[i]) < 0.0001f);
+    }
+
+    /* mismatched layer size */
+    assert(features_deconv_flt_to_flt(samples_across, samples_down,
+                                      patch_radius,
+                                      img_width, img_height, img_depth,
+                                      img, layer_units-1, layer,
+                                      &feature_autocoder) != 0);
+
+    autocoder_free(&feature_autocoder);
+    free(layer);
+    free(img);
+    free(expected);
+    free(overlapping);
+
+    printf("Ok\n");
+}
+
 int run_tests_features()
 {
     printf("\nRunning feature learning tests\n");
@@ -267,6 +603,10 @@ int run_tests_features()
     test_learn_from_image();
     test_learn_from_flt();
     test_features_conv_img_to_flt();
+    test_features_conv_parallel();
+    test_features_scan_geometries();
+    test_learn_patch_batch();
+    test_features_deconv();
 
     printf("All feature learning tests completed\n");
     return 1;
@@ -116,6 +116,93 @@ static void test_load_image()
     printf("Ok\n");
 }
 
+static void test_resample()
+{
+    int width = 64, height = 48;
+    unsigned char img[64*48*3], expected[32*24*3], resampled[32*24*3];
+    float resampled_flt[32*24*3];
+    int x, y, d, i;
+
+    printf("test_resample...");
+
+    /* horizontal gradient in the first channel, vertical in the second
+       and constant in the third */
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            i = ((y*width) + x)*3;
+            img[i] = (unsigned char)(x*4);
+            img[i+1] = (unsigned char)(y*4);
+            img[i+2] = 100;
+        }
+    }
+
+    assert(deeplearn_resample(img, width, height, 3, resampled,
+                              32, 24, 3, DEEPLEARN_RESAMPLE_METHODS) == -1);
+    assert(deeplearn_resample(img, width, height, 3, resampled,
+                              32, 24, 2, DEEPLEARN_RESAMPLE_BOX) == -2);
+
+    /* nearest neighbour is the same as the existing downsampling */
+    deeplearn_downsample_colour(img, width, height, expected, 32, 24);
+    assert(deeplearn_resample(img, width, height, 3, resampled,
+                              32, 24, 3, DEEPLEARN_RESAMPLE_NEAREST) == 0);
+    assert(memcmp(resampled, expected, 32*24*3) == 0);
+
+    /* box filtering at half resolution averages pairs of pixels */
+    assert(deeplearn_resample(img, width, height, 3, resampled,
+                              32, 24, 3, DEEPLEARN_RESAMPLE_BOX) == 0);
+    for (y = 0; y < 24; y++) {
+        for (x = 0; x < 32; x++) {
+            i = ((y*32) + x)*3;
+            assert(resampled[i] == x*8 + 2);
+            assert(resampled[i+1] == y*8 + 2);
+            assert(resampled[i+2] == 100);
+        }
+    }
+
+    /* at half resolution bilinear samples lie between pairs of pixels */
+    assert(deeplearn_resample(img, width, height, 3, resampled,
+                              32, 24, 3, DEEPLEARN_RESAMPLE_BILINEAR) == 0);
+    for (y = 0; y < 24; y++) {
+        for (x = 0; x < 32; x++) {
+            i = ((y*32) + x)*3;
+            assert(resampled[i] == x*8 + 2);
+            assert(resampled[i+1] == y*8 + 2);
+            assert(resampled[i+2] == 100);
+        }
+    }
+
+    /* mono output is the average of the channels */
+    assert(deeplearn_resample(img, width, height, 3, resampled,
+                              32, 24, 1, DEEPLEARN_RESAMPLE_BOX) == 0);
+    for (y = 0; y < 24; y++) {
+        for (x = 0; x < 32; x++) {
+            float mono = ((x*8 + 2) + (y*8 + 2) + 100) / 3.0f;
+            assert(abs((int)resampled[(y*32) + x] - (int)(mono + 0.5f)) <= 1);
+        }
+    }
+
+    /* float output is normalised */
+    assert(deeplearn_resample(img, width, height, 3, resampled,
+                              32, 24, 3, DEEPLEARN_RESAMPLE_BOX) == 0);
+    assert(deeplearn_resample_to_flt(img, width, height, 3, resampled_flt,
+                                     32, 24, 3, DEEPLEARN_RESAMPLE_BOX) == 0);
+    for (i = 0; i < 32*24*3; i++) {
+        assert(fabs(resampled_flt[i] - PIXEL_TO_FLOAT(resampled[i])) <
+               1.0f/255);
+        assert(resampled_flt[i] >= 0.25f);
+        assert(resampled_flt[i] <= 0.75f);
+    }
+
+    /* upsampling */
+    for (d = DEEPLEARN_RESAMPLE_NEAREST; d < DEEPLEARN_RESAMPLE_METHODS; d++) {
+        unsigned char upsampled[128*96];
+        assert(deeplearn_resample(img, width, height, 3, upsampled,
+                                  128, 96, 1, d) == 0);
+    }
+
+    printf("Ok\n");
+}
+
 static void test_load_training_images()
 {
     char filename[256];
@@ -172,13 +259,103 @@ static void test_load_training_images()
     printf("Ok\n");
 }
 
+static void test_image_cache()
+{
+    char filename[256], cache_filename[256];
+    unsigned char ** images=NULL;
+    char ** classifications=NULL;
+    int * numbers;
+    int im;
+    int no_of_images = 5;
+    int width=40,height=40;
+    char commandstr[512],str[256];
+    deeplearn_image_cache cache;
+    FILE * fp;
+
+    printf("test_image_cache...");
+
+    /* create a directory for the images */
+    sprintf(commandstr,"mkdir %sdeeplearn_test_cache_images",
+            DEEPLEARN_TEMP_DIRECTORY);
+    system(commandstr);
+
+    /* save test images, the last of which can't be decoded */
+    for (im = 0; im < no_of_images-1; im++) {
+        sprintf(filename,"%sdeeplearn_test_cache_images/img%d.%d.png",
+                DEEPLEARN_TEMP_DIRECTORY, im%2, im);
+        save_image(filename);
+    }
+    sprintf(filename,"%sdeeplearn_test_cache_images/broken.png",
+            DEEPLEARN_TEMP_DIRECTORY);
+    fp = fopen(filename,"wb");
+    assert(fp);
+    fprintf(fp,"not an image");
+    fclose(fp);
+
+    sprintf(str,"%sdeeplearn_test_cache_images",
+            DEEPLEARN_TEMP_DIRECTORY);
+    sprintf(cache_filename,"%sdeeplearn_test_images.cache",
+            DEEPLEARN_TEMP_DIRECTORY);
+
+    assert(deeplearn_image_cache_create(str, cache_filename,
+                                        width, height) == no_of_images);
+    assert(deeplearn_load_training_images(str,
+                                          &images,
+                                          &classifications,
+                                          &numbers,
+                                          width, height) == no_of_images);
+
+    /* the cache should match the images loaded directly */
+    assert(deeplearn_image_cache_open(cache_filename, &cache) == 0);
+    assert(cache.width == width);
+    assert(cache.height == height);
+    assert(cache.no_of_images == no_of_images);
+    for (im = 0; im < no_of_images; im++) {
+        unsigned char * img = deeplearn_image_cache_get(&cache, im);
+        if (images[im] == NULL) {
+            assert(img == NULL);
+        }
+        else {
+            assert(img != NULL);
+            assert(memcmp(img, images[im], width*height) == 0);
+        }
+        assert(strcmp(cache.classifications[im], classifications[im]) == 0);
+        assert(cache.classification_number[im] == numbers[im]);
+    }
+    assert(deeplearn_image_cache_get(&cache, no_of_images) == NULL);
+    deeplearn_image_cache_close(&cache);
+
+    /* a truncated cache should be rejected */
+    sprintf(commandstr,"truncate -s 100 %s", cache_filename);
+    system(commandstr);
+    assert(deeplearn_image_cache_open(cache_filename, &cache) != 0);
+
+    /* free memory */
+    for (im = 0; im < no_of_images; im++) {
+        free(images[im]);
+        free(classifications[im]);
+    }
+    free(images);
+    free(classifications);
+    free(numbers);
+
+    /* remove the images */
+    sprintf(commandstr,"rm -rf %sdeeplearn_test_cache_images %s",
+            DEEPLEARN_TEMP_DIRECTORY, cache_filename);
+    system(commandstr);
+
+    printf("Ok\n");
+}
+
 int run_tests_images()
 {
     printf("\nRunning images tests\n");
 
     test_save_image();
     test_load_image();
+    test_resample();
     test_load_training_images();
+    test_image_cache();
 
     printf("All images tests completed\n");
     return 1;
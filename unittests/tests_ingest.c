@@ -0,0 +1,285 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_ingest.h"
+
+#define INGEST_WIDTH 16
+#define INGEST_HEIGHT 8
+#define INGEST_SUBSAMPLING 2
+#define INGEST_INPUTS ((INGEST_WIDTH/INGEST_SUBSAMPLING)*(INGEST_HEIGHT/INGEST_SUBSAMPLING))
+
+/* frames seen by the callbacks */
+struct ingest_test_log {
+    int learned;
+    unsigned long last_learned;
+    int inferred;
+    unsigned long last_inferred;
+    float outputs[2];
+};
+
+static void ingest_test_learned(void * context, deeplearn * learner,
+                                unsigned long frame)
+{
+    struct ingest_test_log * log = (struct ingest_test_log*)context;
+
+    /* frames are learned in the order captured */
+    assert(frame > log->last_learned);
+    assert(learner != NULL);
+    log->last_learned = frame;
+    log->learned++;
+}
+
+static void ingest_test_output(void * context, unsigned long frame,
+                               float * outputs, int no_of_outputs)
+{
+    struct ingest_test_log * log = (struct ingest_test_log*)context;
+
+    assert(no_of_outputs == 2);
+    assert(frame > log->last_inferred);
+    log->last_inferred = frame;
+    log->inferred++;
+    memcpy(log->outputs, outputs, no_of_outputs*sizeof(float));
+}
+
+static void ingest_test_frame(unsigned char * frame, int seed)
+{
+    for (int i = 0; i < INGEST_WIDTH*INGEST_HEIGHT*2; i++) {
+        frame[i] = (unsigned char)((i*7 + seed*31) & 255);
+    }
+}
+
+static void ingest_test_learner(deeplearn * learner)
+{
+    unsigned int random_seed = 9724;
+    float error_threshold[] = { 0.0f, 0.0f, 0.0f };
+
+    deeplearn_init(learner, INGEST_INPUTS, 8, 2, 2,
+                   error_threshold, &random_seed);
+}
+
+static void test_ingest_yuyv()
+{
+    deeplearn_ingest_yuyv_format format;
+    unsigned char frame[INGEST_WIDTH*INGEST_HEIGHT*2];
+    float inputs[INGEST_INPUTS];
+    int x, y, i = 0;
+
+    printf("test_ingest_yuyv...");
+
+    ingest_test_frame(frame, 3);
+    format.width = INGEST_WIDTH;
+    format.height = INGEST_HEIGHT;
+    format.subsampling = INGEST_SUBSAMPLING;
+    assert(deeplearn_ingest_yuyv(&format, frame, inputs, INGEST_INPUTS) == 0);
+
+    for (y = 0; y < INGEST_HEIGHT; y += INGEST_SUBSAMPLING) {
+        for (x = 0; x < INGEST_WIDTH; x += INGEST_SUBSAMPLING, i++) {
+            float luma = frame[(y*INGEST_WIDTH + x)*2];
+            assert(inputs[i] == 0.25f + (luma / (255.0f*2)));
+        }
+    }
+
+    /* too many inputs for the frame */
+    assert(deeplearn_ingest_yuyv(&format, frame, inputs,
+                                 INGEST_INPUTS+1) == -1);
+
+    printf("Ok\n");
+}
+
+static void test_ingest_drop_oldest()
+{
+    deeplearn learner;
+    deeplearn_ingest ingest;
+    deeplearn_ingest_yuyv_format format;
+    struct ingest_test_log log;
+    unsigned char frame[INGEST_WIDTH*INGEST_HEIGHT*2];
+    int i;
+
+    printf("test_ingest_drop_oldest...");
+
+    ingest_test_learner(&learner);
+    format.width = INGEST_WIDTH;
+    format.height = INGEST_HEIGHT;
+    format.subsampling = INGEST_SUBSAMPLING;
+    memset(&log, '\0', sizeof(log));
+
+    assert(deeplearn_ingest_init(&ingest, &learner, 2,
+                                 DEEPLEARN_INGEST_LEARN,
+                                 deeplearn_ingest_yuyv, &format) == -1);
+    assert(deeplearn_ingest_init(&ingest, &learner, 3, 0,
+                                 deeplearn_ingest_yuyv, &format) == -1);
+    assert(deeplearn_ingest_init(&ingest, &learner, 3,
+                                 DEEPLEARN_INGEST_LEARN |
+                                 DEEPLEARN_INGEST_INFER,
+                                 deeplearn_ingest_yuyv, &format) == 0);
+    deeplearn_ingest_set_learned(&ingest, ingest_test_learned, &log);
+    deeplearn_ingest_set_output(&ingest, ingest_test_output, &log);
+
+    /* before the threads start the ring fills and the oldest frames
+       are dropped */
+    for (i = 0; i < 5; i++) {
+        ingest_test_frame(frame, i);
+        assert(deeplearn_ingest_push(&ingest, frame) == ((i < 3) ? 0 : 1));
+    }
+    assert(ingest.captured == 5);
+    assert(ingest.dropped == 2);
+
+    assert(deeplearn_ingest_start(&ingest) == 0);
+    deeplearn_ingest_wait(&ingest);
+    assert(log.learned == 3);
+    assert(ingest.learned_frames == 3);
+    assert(log.last_learned == 5);
+
+    /* the newest frame is always evaluated */
+    assert(log.inferred >= 1);
+    assert(log.last_inferred == 5);
+
+    /* capture does not wait for the learner */
+    for (i = 0; i < 50; i++) {
+        ingest_test_frame(frame, i+5);
+        assert(deeplearn_ingest_push(&ingest, frame) >= 0);
+    }
+    deeplearn_ingest_wait(&ingest);
+    assert(ingest.captured == 55);
+    assert(ingest.learned_frames + ingest.dropped >= 55);
+    assert(ingest.learned_frames <= 55);
+    assert(log.learned == (int)ingest.learned_frames);
+    assert(log.last_learned <= 55);
+    assert(log.last_inferred == 55);
+    assert(log.inferred == (int)ingest.inferred_frames);
+
+    deeplearn_ingest_free(&ingest);
+    assert(ingest.buffer == NULL);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_ingest_inference()
+{
+    deeplearn learner;
+    deeplearn_ingest ingest;
+    deeplearn_ingest_yuyv_format format;
+    bp_inference ctx;
+    struct ingest_test_log log;
+    unsigned char frame[INGEST_WIDTH*INGEST_HEIGHT*2];
+    float inputs[INGEST_INPUTS], outputs[2];
+
+    printf("test_ingest_inference...");
+
+    ingest_test_learner(&learner);
+    format.width = INGEST_WIDTH;
+    format.height = INGEST_HEIGHT;
+    format.subsampling = INGEST_SUBSAMPLING;
+    memset(&log, '\0', sizeof(log));
+
+    assert(deeplearn_ingest_init(&ingest, &learner, 4,
+                                 DEEPLEARN_INGEST_INFER,
+                                 deeplearn_ingest_yuyv, &format) == 0);
+    deeplearn_ingest_set_output(&ingest, ingest_test_output, &log);
+    assert(deeplearn_ingest_start(&ingest) == 0);
+    assert(deeplearn_ingest_start(&ingest) == -1);
+
+    ingest_test_frame(frame, 11);
+    assert(deeplearn_ingest_push(&ingest, frame) == 0);
+    deeplearn_ingest_wait(&ingest);
+    assert(log.inferred == 1);
+    assert(ingest.learned_frames == 0);
+
+    /* without learning the outputs are those of the learner */
+    assert(deeplearn_ingest_yuyv(&format, frame, inputs, INGEST_INPUTS) == 0);
+    assert(bp_inference_init(&ctx, learner.net, 1) == 0);
+    assert(bp_infer(learner.net, &ctx, inputs, outputs, 1) == 0);
+    assert(log.outputs[0] == outputs[0]);
+    assert(log.outputs[1] == outputs[1]);
+    bp_inference_free(&ctx);
+
+    deeplearn_ingest_free(&ingest);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_ingest_min_change()
+{
+    deeplearn learner;
+    deeplearn_ingest ingest;
+    deeplearn_ingest_yuyv_format format;
+    struct ingest_test_log log;
+    unsigned char frame[INGEST_WIDTH*INGEST_HEIGHT*2];
+    int i;
+
+    printf("test_ingest_min_change...");
+
+    ingest_test_learner(&learner);
+    format.width = INGEST_WIDTH;
+    format.height = INGEST_HEIGHT;
+    format.subsampling = INGEST_SUBSAMPLING;
+    memset(&log, '\0', sizeof(log));
+
+    assert(deeplearn_ingest_init(&ingest, &learner, 3,
+                                 DEEPLEARN_INGEST_LEARN,
+                                 deeplearn_ingest_yuyv, &format) == 0);
+    deeplearn_ingest_set_learned(&ingest, ingest_test_learned, &log);
+    deeplearn_ingest_set_min_change(&ingest, 0.01f);
+    assert(deeplearn_ingest_start(&ingest) == 0);
+
+    /* a still scene is only learned once */
+    ingest_test_frame(frame, 1);
+    for (i = 0; i < 3; i++) {
+        assert(deeplearn_ingest_push(&ingest, frame) == 0);
+        deeplearn_ingest_wait(&ingest);
+    }
+    assert(ingest.learned_frames == 1);
+    assert(ingest.unchanged_frames == 2);
+
+    ingest_test_frame(frame, 2);
+    assert(deeplearn_ingest_push(&ingest, frame) == 0);
+    deeplearn_ingest_wait(&ingest);
+    assert(ingest.learned_frames == 2);
+    assert(log.learned == 2);
+
+    deeplearn_ingest_free(&ingest);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_ingest()
+{
+    printf("\nRunning ingest tests\n");
+
+    test_ingest_yuyv();
+    test_ingest_drop_oldest();
+    test_ingest_inference();
+    test_ingest_min_change();
+
+    printf("All ingest tests completed\n");
+    return 1;
+}
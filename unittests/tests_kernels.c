@@ -0,0 +1,378 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_kernels.h"
+
+#define TEST_KERNEL_LENGTH 77
+
+/* long enough to use the full width of the widest integer kernels */
+#define TEST_KERNEL_INT8_LENGTH 133
+
+static void test_kernel_select()
+{
+    int isa;
+
+    printf("test_kernel_select...");
+
+    /* scalar kernels are always available */
+    assert(kernel_supported(KERNEL_SCALAR) == 1);
+    assert(kernel_select(KERNEL_SCALAR) == KERNEL_SCALAR);
+    assert(kernel_get_isa() == KERNEL_SCALAR);
+
+    /* automatic selection picks something which is supported */
+    isa = kernel_select(KERNEL_AUTO);
+    assert(isa >= KERNEL_SCALAR);
+    assert(kernel_supported(isa) == 1);
+    assert(kernel_get_isa() == isa);
+
+    printf("Ok (%s)\n", kernel_isa_name(isa));
+}
+
+static void test_kernel_isa_matches_scalar(int isa)
+{
+    float a[TEST_KERNEL_LENGTH], b[TEST_KERNEL_LENGTH];
+    float y0[TEST_KERNEL_LENGTH], y1[TEST_KERNEL_LENGTH];
+    float w0[TEST_KERNEL_LENGTH], w1[TEST_KERNEL_LENGTH];
+    float dw0[TEST_KERNEL_LENGTH], dw1[TEST_KERNEL_LENGTH];
+    float dot0, dot1, min0, max0, min1, max1;
+    unsigned int random_seed = 123;
+    int i, n;
+
+    for (i = 0; i < TEST_KERNEL_LENGTH; i++) {
+        a[i] = (rand_num(&random_seed)%10000)/10000.0f - 0.5f;
+        b[i] = (rand_num(&random_seed)%10000)/10000.0f;
+    }
+
+    /* check a range of lengths so that the scalar tails get tested */
+    for (n = 0; n <= TEST_KERNEL_LENGTH; n++) {
+        assert(kernel_select(KERNEL_SCALAR) == KERNEL_SCALAR);
+        dot0 = kernel_dot(a, b, n);
+        memcpy(y0, b, n*sizeof(float));
+        kernel_axpy(y0, 0.3f, a, n);
+        memcpy(w0, a, n*sizeof(float));
+        memcpy(dw0, b, n*sizeof(float));
+        min0 = 9999;
+        max0 = -9999;
+        kernel_weight_update(w0, dw0, b, 0.01f, 0.2f, n, &min0, &max0);
+
+        assert(kernel_select(isa) == isa);
+        dot1 = kernel_dot(a, b, n);
+        memcpy(y1, b, n*sizeof(float));
+        kernel_axpy(y1, 0.3f, a, n);
+        memcpy(w1, a, n*sizeof(float));
+        memcpy(dw1, b, n*sizeof(float));
+        min1 = 9999;
+        max1 = -9999;
+        kernel_weight_update(w1, dw1, b, 0.01f, 0.2f, n, &min1, &max1);
+
+        assert(fabs(dot0 - dot1) < 0.0001f);
+        for (i = 0; i < n; i++) {
+            assert(fabs(y0[i] - y1[i]) < 0.00001f);
+            assert(fabs(w0[i] - w1[i]) < 0.00001f);
+            assert(fabs(dw0[i] - dw1[i]) < 0.00001f);
+        }
+        assert(fabs(min0 - min1) < 0.00001f);
+        assert(fabs(max0 - max1) < 0.00001f);
+    }
+}
+
+static void test_kernels_match_scalar()
+{
+    int isa;
+
+    printf("test_kernels_match_scalar...");
+
+    for (isa = KERNEL_SSE; isa <= KERNEL_NEON; isa++) {
+        if (kernel_supported(isa)) {
+            test_kernel_isa_matches_scalar(isa);
+        }
+        else {
+            assert(kernel_select(isa) == -1);
+        }
+    }
+
+    kernel_select(KERNEL_AUTO);
+
+    printf("Ok\n");
+}
+
+static void test_kernel_gemm()
+{
+    int m = 150, n = 37, k = 83;
+    float * a, * b, * c;
+    unsigned int random_seed = 123;
+    int i, j, l;
+
+    printf("test_kernel_gemm...");
+
+    a = (float*)malloc(m*k*sizeof(float));
+    b = (float*)malloc(n*k*sizeof(float));
+    c = (float*)malloc(m*n*sizeof(float));
+    assert(a);
+    assert(b);
+    assert(c);
+
+    for (i = 0; i < m*k; i++) {
+        a[i] = (rand_num(&random_seed)%10000)/10000.0f - 0.5f;
+    }
+    for (i = 0; i < n*k; i++) {
+        b[i] = (rand_num(&random_seed)%10000)/10000.0f - 0.5f;
+    }
+
+    /* dimensions which are not multiples of the tile size */
+    kernel_gemm_nt(m, n, k, a, b, c);
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < n; j++) {
+            float sum = 0;
+            for (l = 0; l < k; l++) {
+                sum += a[i*k + l] * b[j*k + l];
+            }
+            assert(fabs(c[i*n + j] - sum) < 0.0001f);
+        }
+    }
+
+    /* matrix-vector product */
+    kernel_gemv(m, k, a, b, c);
+    for (i = 0; i < m; i++) {
+        float sum = 0;
+        for (l = 0; l < k; l++) {
+            sum += a[i*k + l] * b[l];
+        }
+        assert(fabs(c[i] - sum) < 0.0001f);
+    }
+
+    free(a);
+    free(b);
+    free(c);
+
+    printf("Ok\n");
+}
+
+static void test_kernel_activation()
+{
+    float x[TEST_KERNEL_LENGTH], y0[TEST_KERNEL_LENGTH], y1[TEST_KERNEL_LENGTH];
+    unsigned int random_seed = 123;
+    int af, isa, i;
+    float v;
+
+    printf("test_kernel_activation...");
+
+    assert(fabs(kernel_af(AF_LOGISTIC, 0) - 0.5f) < 0.00001f);
+    assert(fabs(kernel_af(AF_LOGISTIC, 2) - 0.8807971f) < 0.00001f);
+    assert(fabs(kernel_af(AF_TANH, 1) - 0.7615942f) < 0.00001f);
+    assert(kernel_af(AF_RELU, -2) == 0);
+    assert(kernel_af(AF_RELU, 3) == 3);
+    assert(fabs(kernel_af(AF_LEAKY_RELU, -2) +
+                2*AF_LEAKY_RELU_SLOPE) < 0.00001f);
+
+    /* the fast approximation should stay close to the logistic function */
+    for (v = -10; v <= 10; v += 0.1f) {
+        assert(fabs(kernel_af(AF_FAST_LOGISTIC, v) -
+                    kernel_af(AF_LOGISTIC, v)) < 0.03f);
+        assert(kernel_af(AF_FAST_LOGISTIC, v) >= 0);
+        assert(kernel_af(AF_FAST_LOGISTIC, v) <= 1);
+    }
+
+    /* derivatives in terms of the output */
+    assert(fabs(kernel_af_derivative(AF_LOGISTIC, 0.5f) - 0.25f) < 0.00001f);
+    assert(fabs(kernel_af_derivative(AF_TANH, 0.5f) - 0.75f) < 0.00001f);
+    assert(kernel_af_derivative(AF_RELU, 0) == 0);
+    assert(kernel_af_derivative(AF_RELU, 2) == 1);
+    assert(kernel_af_derivative(AF_LEAKY_RELU, -0.1f) == AF_LEAKY_RELU_SLOPE);
+
+    for (i = 0; i < AF_FUNCTIONS; i++) {
+        assert(kernel_af_name(i) != NULL);
+    }
+
+    /* the vector form gives the same result as the scalar form
+       on every instruction set */
+    for (i = 0; i < TEST_KERNEL_LENGTH; i++) {
+        x[i] = ((rand_num(&random_seed)%10000)/10000.0f - 0.5f) * 16;
+    }
+    for (isa = KERNEL_SCALAR; isa <= KERNEL_NEON; isa++) {
+        if (!kernel_supported(isa)) continue;
+        assert(kernel_select(isa) == isa);
+        for (af = 0; af < AF_FUNCTIONS; af++) {
+            memcpy(y1, x, TEST_KERNEL_LENGTH*sizeof(float));
+            kernel_af_vector(af, y1, TEST_KERNEL_LENGTH);
+            for (i = 0; i < TEST_KERNEL_LENGTH; i++) {
+                y0[i] = kernel_af(af, x[i]);
+                assert(fabs(y0[i] - y1[i]) < 0.00001f);
+            }
+        }
+    }
+    kernel_select(KERNEL_AUTO);
+
+    printf("Ok\n");
+}
+
+static void test_kernel_reduced_precision()
+{
+    float a[TEST_KERNEL_LENGTH], b[TEST_KERNEL_LENGTH];
+    uint16_t r[TEST_KERNEL_LENGTH];
+    float dot0, dot1, exact;
+    unsigned int random_seed = 123;
+    int precision, isa, i, n;
+
+    printf("test_kernel_reduced_precision...");
+
+    /* known half precision encodings */
+    assert(kernel_float_to_half(0) == 0);
+    assert(kernel_float_to_half(1) == 0x3c00);
+    assert(kernel_float_to_half(-2) == 0xc000);
+    assert(kernel_float_to_half(65504) == 0x7bff);
+    assert(kernel_float_to_half(1e6f) == 0x7c00);
+    assert(kernel_float_to_half(5.9604645e-8f) == 0x0001);
+    assert(kernel_half_to_float(0x3555) == 0.33325195f);
+    assert(kernel_half_to_float(0x0001) == 5.9604645e-8f);
+    assert(kernel_half_to_float(0xc000) == -2);
+
+    /* known bfloat16 encodings */
+    assert(kernel_float_to_bf16(1) == 0x3f80);
+    assert(kernel_float_to_bf16(-2) == 0xc000);
+    assert(kernel_bf16_to_float(0x3f80) == 1);
+    assert(kernel_bf16_to_float(kernel_float_to_bf16(1.00390625f)) == 1);
+
+    for (i = 0; i < TEST_KERNEL_LENGTH; i++) {
+        a[i] = (rand_num(&random_seed)%10000)/10000.0f - 0.5f;
+        b[i] = (rand_num(&random_seed)%10000)/10000.0f;
+    }
+
+    for (precision = KERNEL_FP16; precision <= KERNEL_BF16; precision++) {
+        float tolerance = (precision == KERNEL_FP16) ? 0.001f : 0.004f;
+        float values[TEST_KERNEL_LENGTH];
+
+        /* round trip is within the precision of the format */
+        kernel_to_reduced(precision, a, r, TEST_KERNEL_LENGTH);
+        kernel_from_reduced(precision, r, values, TEST_KERNEL_LENGTH);
+        for (i = 0; i < TEST_KERNEL_LENGTH; i++) {
+            assert(fabs(values[i] - a[i]) < tolerance);
+        }
+
+        /* every instruction set gives the same result as the scalar
+           version, for lengths which test the tails */
+        for (n = 0; n <= TEST_KERNEL_LENGTH; n++) {
+            assert(kernel_select(KERNEL_SCALAR) == KERNEL_SCALAR);
+            dot0 = kernel_dot_reduced(precision, r, b, n);
+            exact = 0;
+            for (i = 0; i < n; i++) {
+                exact += values[i] * b[i];
+            }
+            assert(fabs(dot0 - exact) < 0.0001f);
+            for (isa = KERNEL_SSE; isa <= KERNEL_NEON; isa++) {
+                if (!kernel_supported(isa)) continue;
+                assert(kernel_select(isa) == isa);
+                dot1 = kernel_dot_reduced(precision, r, b, n);
+                assert(fabs(dot0 - dot1) < 0.0001f);
+            }
+        }
+    }
+    kernel_select(KERNEL_AUTO);
+    assert(strcmp(kernel_precision_name(KERNEL_BF16), "bf16") == 0);
+
+    printf("Ok\n");
+}
+
+static void test_kernel_int8()
+{
+    uint8_t a[TEST_KERNEL_INT8_LENGTH];
+    int8_t b[TEST_KERNEL_INT8_LENGTH];
+    float values[TEST_KERNEL_INT8_LENGTH];
+    int32_t dot0, dot1, exact, sum;
+    unsigned int random_seed = 123;
+    int isa, i, n, zero;
+    float scale;
+
+    printf("test_kernel_int8...");
+
+    /* extremes of both ranges, which would saturate sixteen bit
+       intermediate products */
+    for (i = 0; i < TEST_KERNEL_INT8_LENGTH; i++) {
+        a[i] = (i < 8) ? 255 : (uint8_t)(rand_num(&random_seed)%256);
+        b[i] = (i < 8) ? -127 : (int8_t)((int)(rand_num(&random_seed)%255) - 127);
+    }
+
+    for (n = 0; n <= TEST_KERNEL_INT8_LENGTH; n++) {
+        exact = 0;
+        for (i = 0; i < n; i++) {
+            exact += (int32_t)a[i] * (int32_t)b[i];
+        }
+        assert(kernel_select(KERNEL_SCALAR) == KERNEL_SCALAR);
+        dot0 = kernel_dot_u8i8(a, b, n);
+        assert(dot0 == exact);
+        for (isa = KERNEL_SSE; isa <= KERNEL_NEON; isa++) {
+            if (!kernel_supported(isa)) continue;
+            assert(kernel_select(isa) == isa);
+            dot1 = kernel_dot_u8i8(a, b, n);
+            assert(dot1 == exact);
+        }
+    }
+    kernel_select(KERNEL_AUTO);
+
+    /* quantisation ranges */
+    kernel_quantise_range(0, 2.55f, &scale, &zero);
+    assert(zero == 0);
+    assert(fabs(scale - 0.01f) < 0.00001f);
+    kernel_quantise_range(-2, 1.27f, &scale, &zero);
+    assert(zero == 128);
+    assert(fabs(scale - 2/127.0f) < 0.00001f);
+
+    /* round trip of signed and unsigned quantisation */
+    for (i = 0; i < TEST_KERNEL_INT8_LENGTH; i++) {
+        values[i] = (rand_num(&random_seed)%10000)/10000.0f - 0.5f;
+    }
+    kernel_quantise_range(-0.5f, 0.5f, &scale, &zero);
+    kernel_quantise_u8(values, a, TEST_KERNEL_INT8_LENGTH, scale, zero);
+    sum = kernel_quantise_s8(values, b, TEST_KERNEL_INT8_LENGTH, scale);
+    exact = 0;
+    for (i = 0; i < TEST_KERNEL_INT8_LENGTH; i++) {
+        assert(fabs(((int)a[i] - zero)*scale - values[i]) <= scale*0.5f + 0.00001f);
+        assert(fabs(b[i]*scale - values[i]) <= scale*0.5f + 0.00001f);
+        exact += b[i];
+    }
+    assert(sum == exact);
+    assert(strcmp(kernel_precision_name(KERNEL_INT8), "int8") == 0);
+
+    printf("Ok\n");
+}
+
+int run_tests_kernels()
+{
+    printf("\nRunning kernel tests\n");
+
+    test_kernel_select();
+    test_kernels_match_scalar();
+    test_kernel_gemm();
+    test_kernel_activation();
+    test_kernel_reduced_precision();
+    test_kernel_int8();
+
+    printf("All kernel tests completed\n");
+    return 1;
+}
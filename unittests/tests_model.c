@@ -0,0 +1,396 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_model.h"
+
+static void test_model_save_open()
+{
+    bp net;
+    bp_inference net_ctx, model_ctx;
+    deeplearn_model model;
+    int no_of_inputs=20, no_of_hiddens=13, hidden_layers=3;
+    int no_of_outputs=5, batch_size=4;
+    unsigned int random_seed = 123;
+    float inputs[4*20], outputs[4*5], expected[4*5];
+    char * filename = "/tmp/libdeep_model.bin";
+    int i, l;
+    FILE * fp;
+
+    printf("test_model_save_open...");
+
+    assert(bp_init(&net, no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs, &random_seed) == 0);
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((rand_num(&random_seed)%10000)/20000.0f);
+    }
+
+    assert(model_save_bp(filename, &net) == 0);
+    assert(model_open(filename, &model) == 0);
+    assert(model.network->NoOfInputs == no_of_inputs);
+    assert(model.network->HiddenLayers == hidden_layers);
+    assert(model.no_of_layers == hidden_layers+1);
+    assert(model.input_range == NULL);
+
+    /* weights are aligned and used in place */
+    for (l = 0; l < model.no_of_layers; l++) {
+        assert(((uintptr_t)model.weights[l]) % MODEL_ALIGNMENT == 0);
+        assert((const char*)model.weights[l] > (const char*)model.data);
+        assert((const char*)model.weights[l] <
+               (const char*)model.data + model.size);
+        assert(memcmp(model.weights[l], net.layer[l+1].weights,
+                      model.layer_units[l]*model.layer_inputs[l]*
+                      sizeof(float)) == 0);
+    }
+
+    /* same results as the network */
+    assert(bp_inference_init(&net_ctx, &net, batch_size) == 0);
+    assert(model_inference_init(&model, &model_ctx, batch_size) == 0);
+    assert(bp_infer(&net, &net_ctx, inputs, expected, batch_size) == 0);
+    assert(model_infer(&model, &model_ctx, inputs, outputs, batch_size) == 0);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(outputs[i] == expected[i]);
+    }
+    bp_inference_free(&net_ctx);
+    bp_inference_free(&model_ctx);
+    model_close(&model);
+
+    /* corrupt the magic number */
+    fp = fopen(filename, "r+b");
+    assert(fp);
+    fputc('X', fp);
+    fclose(fp);
+    assert(model_open(filename, &model) != 0);
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_model_precision()
+{
+    bp net;
+    bp_inference net_ctx, model_ctx;
+    deeplearn_model model, model32;
+    int no_of_inputs=37, no_of_hiddens=21, hidden_layers=2;
+    int no_of_outputs=5, batch_size=3;
+    unsigned int random_seed = 123;
+    float inputs[3*37], outputs[3*5], expected[3*5];
+    char * filename = "/tmp/libdeep_model_reduced.bin";
+    char * filename32 = "/tmp/libdeep_model_fp32.bin";
+    int i, precision;
+
+    printf("test_model_precision...");
+
+    assert(bp_init(&net, no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs, &random_seed) == 0);
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((rand_num(&random_seed)%10000)/20000.0f);
+    }
+    assert(bp_inference_init(&net_ctx, &net, batch_size) == 0);
+    assert(bp_infer(&net, &net_ctx, inputs, expected, batch_size) == 0);
+    bp_inference_free(&net_ctx);
+
+    assert(model_save_bp_precision(filename, &net, -1) != 0);
+    assert(model_save_bp(filename32, &net) == 0);
+
+    for (precision = KERNEL_FP16; precision <= KERNEL_BF16; precision++) {
+        /* weights stored within the file at reduced precision */
+        assert(model_save_bp_precision(filename, &net, precision) == 0);
+        assert(model_open(filename, &model) == 0);
+        assert(model.precision == precision);
+        assert(model.weights[0] == NULL);
+        assert(model.weights_reduced[0] != NULL);
+
+        assert(model_inference_init(&model, &model_ctx, batch_size) == 0);
+        assert(model_infer(&model, &model_ctx, inputs, outputs,
+                           batch_size) == 0);
+        for (i = 0; i < batch_size*no_of_outputs; i++) {
+            assert(fabs(outputs[i] - expected[i]) < 0.01f);
+        }
+        bp_inference_free(&model_ctx);
+
+        /* weights converted after opening give the same results */
+        assert(model_open(filename32, &model32) == 0);
+        assert(model.size < model32.size);
+        assert(model_set_precision(&model32, KERNEL_FP32) != 0);
+        assert(model_set_precision(&model32, precision) == 0);
+        assert(model32.precision == precision);
+        assert(model_inference_init(&model32, &model_ctx, batch_size) == 0);
+        assert(model_infer(&model32, &model_ctx, inputs, expected,
+                           batch_size) == 0);
+        for (i = 0; i < batch_size*no_of_outputs; i++) {
+            assert(outputs[i] == expected[i]);
+        }
+        bp_inference_free(&model_ctx);
+        model_close(&model32);
+
+        /* the stored precision can't be changed */
+        assert(model_set_precision(&model, precision) == 0);
+        assert(model_set_precision(&model,
+                                   (precision == KERNEL_FP16) ?
+                                   KERNEL_BF16 : KERNEL_FP16) != 0);
+        model_close(&model);
+
+        /* restore the float results for the next precision */
+        assert(bp_inference_init(&net_ctx, &net, batch_size) == 0);
+        assert(bp_infer(&net, &net_ctx, inputs, expected, batch_size) == 0);
+        bp_inference_free(&net_ctx);
+    }
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_model_int8()
+{
+    bp net;
+    bp_inference net_ctx, model_ctx;
+    deeplearn_model model, model32;
+    int no_of_inputs=200, no_of_hiddens=64, hidden_layers=2;
+    int no_of_outputs=5, batch_size=8;
+    unsigned int random_seed = 123;
+    float inputs[8*200], outputs[8*5], expected[8*5];
+    char * filename = "/tmp/libdeep_model_int8.bin";
+    char * filename32 = "/tmp/libdeep_model_fp32.bin";
+    int i;
+
+    printf("test_model_int8...");
+
+    assert(bp_init(&net, no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs, &random_seed) == 0);
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((rand_num(&random_seed)%10000)/20000.0f);
+    }
+    assert(model_save_bp(filename32, &net) == 0);
+
+    /* the network must be quantised before it can be saved as int8 */
+    assert(model_save_bp_precision(filename, &net, KERNEL_INT8) != 0);
+    assert(bp_quantise(&net, BP_QUANT_PER_UNIT, inputs, batch_size) == 0);
+    assert(model_save_bp_precision(filename, &net, KERNEL_INT8) == 0);
+
+    assert(bp_inference_init(&net_ctx, &net, batch_size) == 0);
+    assert(bp_infer(&net, &net_ctx, inputs, expected, batch_size) == 0);
+    bp_inference_free(&net_ctx);
+
+    assert(model_open(filename, &model) == 0);
+    assert(model.precision == KERNEL_INT8);
+    assert(model.weights[0] == NULL);
+    assert(model.weights_int8[0] != NULL);
+    assert(model_set_precision(&model, KERNEL_FP16) != 0);
+
+    /* about a quarter of the size of the float model */
+    assert(model_open(filename32, &model32) == 0);
+    assert(model.size*3 < model32.size);
+    model_close(&model32);
+
+    /* same results as the quantised network */
+    assert(model_inference_init(&model, &model_ctx, batch_size) == 0);
+    assert(model_infer(&model, &model_ctx, inputs, outputs,
+                       batch_size) == 0);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(outputs[i] == expected[i]);
+    }
+    bp_inference_free(&model_ctx);
+    model_close(&model);
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_model_convert()
+{
+    deeplearn learner;
+    bp_inference learner_ctx, model_ctx;
+    deeplearn_model model;
+    int no_of_hiddens=4, hidden_layers=2, no_of_outputs=1;
+    int output_field_index[] = { 3 };
+    float error_threshold_percent[] = { 10.0f, 10.0f, 0.01f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_model.csv";
+    char * legacy_filename = "/tmp/libdeep_model_legacy.net";
+    char * model_filename = "/tmp/libdeep_model_converted.bin";
+    float inputs[8*3], outputs[8], expected[8];
+    int i, s;
+    FILE * fp;
+
+    printf("test_model_convert...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    fprintf(fp,"%f,%f,%f,%f\n",4.2,6.8,62.1,1.0);
+    fprintf(fp,"%f,%f,%f,%f\n",8.1,7.2,57.6,2.0);
+    fprintf(fp,"%f,%f,%f,%f\n",9.4,8.24,63.2,3.0);
+    fprintf(fp,"%f,%f,%f,%f\n",1.7,3.83,68.3,4.0);
+    fprintf(fp,"%f,%f,%f,%f\n",5.4,2.63,91.9,5.0);
+    fprintf(fp,"%f,%f,%f,%f\n",7.5,8.24,88.7,6.0);
+    fprintf(fp,"%f,%f,%f,%f\n",8.6,7.13,83.1,7.0);
+    fprintf(fp,"%f,%f,%f,%f\n",6.9,72.7,77.4,8.0);
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename, &learner,
+                                  no_of_hiddens, hidden_layers,
+                                  no_of_outputs, output_field_index, 0,
+                                  error_threshold_percent,
+                                  &random_seed) == 8);
+    for (s = 0; s < 8; s++) {
+        deeplearndata * sample = deeplearndata_get(&learner, s);
+        assert(sample);
+        for (i = 0; i < 3; i++) {
+            inputs[s*3 + i] = sample->inputs[i];
+        }
+    }
+
+    /* save in the existing format and convert */
+    fp = fopen(legacy_filename, "wb");
+    assert(fp);
+    assert(deeplearn_save(fp, &learner) == 0);
+    fclose(fp);
+    assert(model_convert_deeplearn(legacy_filename, model_filename) == 0);
+
+    assert(model_open(model_filename, &model) == 0);
+    assert(model.input_range != NULL);
+    assert(model.output_range != NULL);
+
+    assert(deeplearn_inference_init(&learner, &learner_ctx, 8) == 0);
+    assert(model_inference_init(&model, &model_ctx, 8) == 0);
+    assert(deeplearn_infer(&learner, &learner_ctx, inputs, expected, 8) == 0);
+    assert(model_infer(&model, &model_ctx, inputs, outputs, 8) == 0);
+    for (i = 0; i < 8; i++) {
+        assert(fabs(outputs[i] - expected[i]) < 0.0001f);
+    }
+
+    bp_inference_free(&learner_ctx);
+    bp_inference_free(&model_ctx);
+    model_close(&model);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+static void test_model_load_deeplearn()
+{
+    deeplearn learner;
+    bp_inference learner_ctx, model_ctx;
+    deeplearn_model model, other;
+    int no_of_inputs=6, no_of_hiddens=5, hidden_layers=2;
+    int no_of_outputs=3, batch_size=4;
+    float error_threshold[] = { 10.0f, 10.0f, 1.0f };
+    unsigned int random_seed = 123;
+    char * filename = "/tmp/libdeep_model_inference.net";
+    float inputs[4*6], outputs[4*3], expected[4*3];
+    int i, l, marker = 0;
+    FILE * fp;
+
+    printf("test_model_load_deeplearn...");
+
+    assert(deeplearn_init(&learner, no_of_inputs, no_of_hiddens,
+                          hidden_layers, no_of_outputs,
+                          error_threshold, &random_seed) == 0);
+    for (i = 0; i < no_of_outputs; i++) {
+        learner.output_range_min[i] = 0.0f;
+        learner.output_range_max[i] = 10.0f + i;
+    }
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((rand_num(&random_seed)%10000)/20000.0f);
+    }
+
+    /* something saved after the learner */
+    fp = fopen(filename, "wb");
+    assert(fp);
+    assert(deeplearn_save(fp, &learner) == 0);
+    marker = 1234;
+    assert(fwrite(&marker, sizeof(int), 1, fp) == 1);
+    fclose(fp);
+
+    fp = fopen(filename, "rb");
+    assert(fp);
+    assert(model_load_deeplearn(fp, &model) == 0);
+    marker = 0;
+    assert(fread(&marker, sizeof(int), 1, fp) == 1);
+    assert(marker == 1234);
+    fclose(fp);
+
+    assert(model.no_of_layers == hidden_layers+1);
+    assert(model.network->NoOfInputs == no_of_inputs);
+    assert(model.network->NoOfOutputs == no_of_outputs);
+    assert(model.input_range == NULL);
+    assert(model.output_range[no_of_outputs+2] == 12.0f);
+
+    /* only weights, biases and ranges are held */
+    assert(model.size < sizeof(model_network) + MODEL_ALIGNMENT +
+           (4*(no_of_inputs*no_of_hiddens + no_of_hiddens*no_of_hiddens +
+               no_of_hiddens*no_of_outputs) +
+            4*(2*no_of_hiddens + no_of_outputs) +
+            8*(no_of_inputs + no_of_outputs)));
+    for (l = 0; l < model.no_of_layers; l++) {
+        assert(memcmp(model.weights[l], learner.net->layer[l+1].weights,
+                      model.layer_units[l]*model.layer_inputs[l]*
+                      sizeof(float)) == 0);
+    }
+
+    assert(deeplearn_inference_init(&learner, &learner_ctx,
+                                    batch_size) == 0);
+    assert(model_inference_init(&model, &model_ctx, batch_size) == 0);
+    assert(deeplearn_infer(&learner, &learner_ctx, inputs, expected,
+                           batch_size) == 0);
+    assert(model_infer(&model, &model_ctx, inputs, outputs,
+                       batch_size) == 0);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(fabs(outputs[i] - expected[i]) < 0.0001f);
+    }
+
+    /* a learner is not a plain network */
+    fp = fopen(filename, "rb");
+    assert(fp);
+    assert(model_load_bp(fp, &other) != 0);
+    fclose(fp);
+
+    bp_inference_free(&learner_ctx);
+    bp_inference_free(&model_ctx);
+    model_close(&model);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_model()
+{
+    printf("\nRunning model tests\n");
+
+    test_model_save_open();
+    test_model_precision();
+    test_model_int8();
+    test_model_convert();
+    test_model_load_deeplearn();
+
+    printf("All model tests completed\n");
+    return 1;
+}
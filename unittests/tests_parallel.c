@@ -0,0 +1,223 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_parallel.h"
+
+/* number of calls to the allreduce functions */
+static int allreduce_calls = 0;
+
+/* behaves as if another process had summed identical gradients */
+static int allreduce_double(float * values, int length, void * data)
+{
+    int i;
+
+    assert(data == (void*)&allreduce_calls);
+    for (i = 0; i < length; i++) {
+        values[i] *= 2;
+    }
+    allreduce_calls++;
+    return 0;
+}
+
+static int same_weights(bp * net1, bp * net2)
+{
+    int i, l;
+
+    for (l = 1; l < net1->HiddenLayers+2; l++) {
+        bp_layer * layer1 = &net1->layer[l];
+        bp_layer * layer2 = &net2->layer[l];
+
+        if (memcmp(layer1->weights, layer2->weights,
+                   layer1->NoOfUnits*layer1->NoOfInputs*sizeof(float)) != 0) {
+            return 0;
+        }
+        for (i = 0; i < layer1->NoOfUnits; i++) {
+            if (layer1->units[i].bias != layer2->units[i].bias) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static void create_samples(float * inputs, float * targets,
+                           int no_of_samples)
+{
+    int s;
+
+    /* the output follows the first input */
+    for (s = 0; s < no_of_samples; s++) {
+        inputs[s*2] = 0.25f + ((s&1)*0.5f);
+        inputs[s*2+1] = 0.25f + (((s>>1)&1)*0.5f);
+        targets[s] = inputs[s*2];
+    }
+}
+
+static void test_parallel_update()
+{
+    deeplearn learner1, learner2, learner3;
+    deeplearn_parallel parallel1, parallel2;
+    int no_of_inputs=2, no_of_hiddens=8, hidden_layers=1, no_of_outputs=1;
+    float error_threshold[] = { 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    float inputs[2*64], targets[64];
+    int itt;
+
+    printf("test_parallel_update...");
+
+    create_samples(inputs, targets, 64);
+
+    assert(deeplearn_init(&learner1, no_of_inputs, no_of_hiddens,
+                          hidden_layers, no_of_outputs,
+                          error_threshold, &random_seed) == 0);
+    learner1.net->DropoutPercent = 10;
+    learner1.net->noise = 0;
+    learner1.history_plot_interval = 999999;
+    assert(deeplearn_clone(&learner2, &learner1) == 0);
+    assert(deeplearn_clone(&learner3, &learner1) == 0);
+
+    assert(deeplearn_parallel_init(&parallel1, &learner1, 0) != 0);
+
+    /* a single replica gives the same weights as a batch update */
+    assert(deeplearn_parallel_init(&parallel1, &learner1, 1) == 0);
+    assert(deeplearn_parallel_update(&parallel1, inputs, targets, 0) == -1);
+    learner2.current_hidden_layer = 1;
+    for (itt = 0; itt < 10; itt++) {
+        assert(deeplearn_parallel_update(&parallel1, inputs,
+                                         targets, 64) == 0);
+        assert(bp_update_batch(learner2.net, inputs, targets, 64, 1) == 0);
+    }
+    assert(same_weights(learner1.net, learner2.net));
+    assert(learner1.net->random_seed == learner2.net->random_seed);
+    deeplearn_parallel_free(&parallel1);
+    deeplearn_free(&learner1);
+    deeplearn_free(&learner2);
+
+    /* several replicas give the same result on every run */
+    assert(deeplearn_clone(&learner1, &learner3) == 0);
+    assert(deeplearn_clone(&learner2, &learner3) == 0);
+    assert(deeplearn_parallel_init(&parallel1, &learner1, 3) == 0);
+    assert(deeplearn_parallel_init(&parallel2, &learner2, 3) == 0);
+    for (itt = 0; itt < 10; itt++) {
+        assert(deeplearn_parallel_update(&parallel1, inputs,
+                                         targets, 64) == 0);
+        assert(deeplearn_parallel_update(&parallel2, inputs,
+                                         targets, 64) == 0);
+    }
+    assert(same_weights(learner1.net, learner2.net));
+    assert(learner1.net->itterations == learner2.net->itterations);
+    assert(learner1.BPerror == learner2.BPerror);
+    assert(learner1.BPerror != DEEPLEARN_UNKNOWN_ERROR);
+
+    deeplearn_parallel_free(&parallel1);
+    deeplearn_parallel_free(&parallel2);
+    deeplearn_free(&learner1);
+    deeplearn_free(&learner2);
+    deeplearn_free(&learner3);
+
+    printf("Ok\n");
+}
+
+static void test_parallel_allreduce()
+{
+    deeplearn learner1, learner2;
+    deeplearn_parallel parallel1, parallel2;
+    ac autocoder1, autocoder2;
+    int no_of_inputs=2, no_of_hiddens=8, hidden_layers=1, no_of_outputs=1;
+    float error_threshold[] = { 0.01f, 0.01f };
+    unsigned int random_seed = 456;
+    float inputs[2*64], targets[64], patches[16*20];
+    int itt, i;
+
+    printf("test_parallel_allreduce...");
+
+    create_samples(inputs, targets, 64);
+
+    assert(deeplearn_init(&learner1, no_of_inputs, no_of_hiddens,
+                          hidden_layers, no_of_outputs,
+                          error_threshold, &random_seed) == 0);
+    learner1.history_plot_interval = 999999;
+    assert(deeplearn_clone(&learner2, &learner1) == 0);
+    assert(deeplearn_parallel_init(&parallel1, &learner1, 4) == 0);
+    assert(deeplearn_parallel_init(&parallel2, &learner2, 4) == 0);
+
+    /* gradients summed with an identical process give the same
+       update, with twice as many samples */
+    allreduce_calls = 0;
+    deeplearn_parallel_set_allreduce(&parallel1, allreduce_double,
+                                     &allreduce_calls);
+    for (itt = 0; itt < 5; itt++) {
+        assert(deeplearn_parallel_update(&parallel1, inputs,
+                                         targets, 64) == 0);
+        assert(deeplearn_parallel_update(&parallel2, inputs,
+                                         targets, 64) == 0);
+    }
+    assert(allreduce_calls == 5);
+    assert(same_weights(learner1.net, learner2.net));
+    assert(learner1.net->itterations == 2*learner2.net->itterations);
+
+    deeplearn_parallel_free(&parallel1);
+    deeplearn_parallel_free(&parallel2);
+    deeplearn_free(&learner1);
+    deeplearn_free(&learner2);
+
+    /* the same applies to the batch updates of an autocoder,
+       such as those used to learn convolution features */
+    for (i = 0; i < 16*20; i++) {
+        patches[i] = 0.25f + ((i%9)/9.0f)*0.5f;
+    }
+    assert(autocoder_init(&autocoder1, 20, 6, random_seed) == 0);
+    assert(autocoder_clone(&autocoder2, &autocoder1) == 0);
+    autocoder1.allreduce = allreduce_double;
+    autocoder1.allreduce_data = &allreduce_calls;
+    allreduce_calls = 0;
+    for (itt = 0; itt < 5; itt++) {
+        assert(autocoder_update_batch(&autocoder1, patches, 16) == 0);
+        assert(autocoder_update_batch(&autocoder2, patches, 16) == 0);
+    }
+    assert(allreduce_calls == 5);
+    assert(memcmp(autocoder1.weights, autocoder2.weights,
+                  20*6*sizeof(float)) == 0);
+    assert(autocoder1.itterations == 2*autocoder2.itterations);
+    autocoder_free(&autocoder1);
+    autocoder_free(&autocoder2);
+
+    printf("Ok\n");
+}
+
+int run_tests_parallel()
+{
+    printf("\nRunning data-parallel training tests\n");
+
+    test_parallel_update();
+    test_parallel_allreduce();
+
+    printf("All data-parallel training tests completed\n");
+    return 1;
+}
@@ -70,11 +70,72 @@ static void test_pooling_from_floats_to_floats()
     printf("Ok\n");
 }
 
+static void test_pooling_argmax()
+{
+    printf("test_pooling_argmax...");
+
+    int depth = 5;
+    int layer0_across = 23;
+    int layer0_down = 17;
+    int layer1_across = 6;
+    int layer1_down = 4;
+    float layer0[23*17*5], layer1[6*4*5], unpooled[23*17*5];
+    int argmax[6*4*5];
+    unsigned int random_seed = 2372;
+
+    for (int i = 0; i < layer0_across*layer0_down*depth; i++) {
+        layer0[i] = (rand_num(&random_seed)%10000)/10000.0f;
+    }
+
+    assert(pooling_from_flt_to_flt_argmax(depth,
+                                          layer0_across, layer0_down, layer0,
+                                          layer1_across, layer1_down, layer1,
+                                          argmax)==0);
+
+    /* compare against the maximum found for each first layer unit */
+    for (int i = 0; i < layer1_across*layer1_down*depth; i++) {
+        assert(layer0[argmax[i]] == layer1[i]);
+        assert(argmax[i]%depth == i%depth);
+    }
+    for (int y0 = 0; y0 < layer0_down; y0++) {
+        int y1 = y0 * layer1_down / layer0_down;
+        for (int x0 = 0; x0 < layer0_across; x0++) {
+            int x1 = x0 * layer1_across / layer0_across;
+            for (int d = 0; d < depth; d++) {
+                int n0 = (y0*layer0_across + x0)*depth + d;
+                int n1 = (y1*layer1_across + x1)*depth + d;
+                assert(layer0[n0] <= layer1[n1]);
+                if (argmax[n1] == n0) {
+                    assert(layer0[n0] == layer1[n1]);
+                }
+            }
+        }
+    }
+
+    /* unpooling routes each value back to its maximum */
+    assert(unpooling_argmax_from_flt_to_flt(depth,
+                                            layer1_across, layer1_down,
+                                            layer1, argmax,
+                                            layer0_across, layer0_down,
+                                            unpooled)==0);
+    int nonzero = 0;
+    for (int i = 0; i < layer0_across*layer0_down*depth; i++) {
+        if (unpooled[i] != 0) {
+            assert(unpooled[i] == layer0[i]);
+            nonzero++;
+        }
+    }
+    assert(nonzero == layer1_across*layer1_down*depth);
+
+    printf("Ok\n");
+}
+
 int run_tests_pooling()
 {
     printf("\nRunning pooling tests\n");
 
     test_pooling_from_floats_to_floats();
+    test_pooling_argmax();
 
     printf("All pooling tests completed\n");
     return 1;
@@ -0,0 +1,189 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_prefetch.h"
+
+static int prepare_test_slot(void * context, deeplearn_prefetch_slot * slot)
+{
+    int * prepared = (int*)context;
+
+    slot->inputs[0] = slot->index * 2.0f;
+    slot->inputs[1] = slot->index * 3.0f;
+    slot->targets[0] = -slot->index;
+    __atomic_add_fetch(prepared, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void test_prefetch_queue()
+{
+    deeplearn_prefetch queue;
+    int threads, requested, consumed, prepared;
+    deeplearn_prefetch_slot * slot;
+
+    printf("test_prefetch_queue...");
+
+    assert(deeplearn_prefetch_init(&queue, 0, 1, 2, 1,
+                                   prepare_test_slot, NULL) == -1);
+    assert(queue.capacity == 0);
+
+    for (threads = 0; threads <= 3; threads++) {
+        prepared = 0;
+        assert(deeplearn_prefetch_init(&queue, 8, threads, 2, 1,
+                                       prepare_test_slot,
+                                       (void*)&prepared) == 0);
+        assert(deeplearn_prefetch_next(&queue) == NULL);
+
+        requested = 0;
+        consumed = 0;
+        while (consumed < 500) {
+            while ((slot = deeplearn_prefetch_request(&queue)) != NULL) {
+                slot->index = requested++;
+                deeplearn_prefetch_submit(&queue);
+            }
+            assert(deeplearn_prefetch_pending(&queue) == 8);
+
+            /* samples arrive in the order requested */
+            slot = deeplearn_prefetch_next(&queue);
+            assert(slot != NULL);
+            assert(slot->retval == 0);
+            assert(slot->index == consumed);
+            assert(slot->inputs[0] == consumed * 2.0f);
+            assert(slot->inputs[1] == consumed * 3.0f);
+            assert(slot->targets[0] == -consumed);
+            deeplearn_prefetch_release(&queue);
+            consumed++;
+        }
+
+        deeplearn_prefetch_drain(&queue);
+        assert(deeplearn_prefetch_pending(&queue) == 0);
+        assert(prepared == requested);
+        deeplearn_prefetch_free(&queue);
+        assert(queue.capacity == 0);
+    }
+
+    printf("Ok\n");
+}
+
+static void prefetch_learner(deeplearn * learner, unsigned int random_seed)
+{
+    int no_of_inputs=10;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.0f, 0.0f, 0.0f };
+    char ** inputs_text = 0;
+    float inputs[10], outputs[2];
+
+    deeplearn_init(learner,
+                   no_of_inputs, no_of_hiddens,
+                   hidden_layers,
+                   no_of_outputs,
+                   error_threshold,
+                   &random_seed);
+
+    for (int i = 0; i < 100; i++) {
+        for (int j = 0; j < no_of_inputs; j++) {
+            inputs[j] = (float)((i*(j+1))%10);
+        }
+        for (int j = 0; j < no_of_outputs; j++) {
+            outputs[j] = (float)((i+j)%2);
+        }
+        assert(deeplearndata_add(&learner->data,
+                                 &learner->data_samples,
+                                 inputs, inputs_text, outputs,
+                                 no_of_inputs, no_of_outputs,
+                                 learner->input_range_min,
+                                 learner->input_range_max,
+                                 learner->output_range_min,
+                                 learner->output_range_max) == 0);
+    }
+    assert(deeplearndata_index_data(learner->data, learner->data_samples,
+                                    &learner->indexed_data,
+                                    &learner->indexed_data_samples) == 0);
+    assert(deeplearndata_create_datasets(learner, 20) == 0);
+    assert(learner->training_data_samples == 80);
+}
+
+static void test_prefetch_training()
+{
+    deeplearn learner1, learner2;
+    unsigned int random_seed = 2384;
+
+    printf("test_prefetch_training...");
+
+    /* the same training whether samples are encoded on worker threads
+       or when they are taken from the queue */
+    prefetch_learner(&learner1, random_seed);
+    prefetch_learner(&learner2, random_seed);
+    assert(deeplearn_set_prefetch(&learner1, 16, 0) == 0);
+    assert(deeplearn_set_prefetch(&learner2, 16, 3) == 0);
+    assert(learner2.prefetch.queue.no_of_threads == 3);
+    deeplearndata_set_epochs(&learner1, 1);
+    deeplearndata_set_epochs(&learner2, 1);
+
+    for (int i = 0; i < 400; i++) {
+        assert(deeplearndata_training(&learner1) == 1);
+        assert(deeplearndata_training(&learner2) == 1);
+    }
+    assert(deeplearn_compare(&learner1, &learner2) > 0);
+    assert(learner1.net->inputs[3]->value == learner2.net->inputs[3]->value);
+
+    /* epochs are counted as samples are trained upon rather than as
+       they are requested */
+    assert(deeplearndata_get_epochs(&learner1) == 5);
+    assert(deeplearndata_get_epochs(&learner2) == 5);
+    assert(deeplearndata_get_epoch_error(&learner1) ==
+           deeplearndata_get_epoch_error(&learner2));
+
+    /* pending samples are discarded when the training sets change */
+    assert(deeplearn_prefetch_pending(&learner2.prefetch.queue) > 0);
+    assert(deeplearndata_create_datasets(&learner2, 20) == 0);
+    assert(deeplearn_prefetch_pending(&learner2.prefetch.queue) == 0);
+    assert(deeplearndata_training(&learner2) == 1);
+
+    assert(deeplearn_set_prefetch(&learner2, 0, 0) == 0);
+    assert(learner2.prefetch.enabled == 0);
+    assert(deeplearndata_training(&learner2) == 1);
+
+    deeplearn_free(&learner1);
+    deeplearn_free(&learner2);
+
+    printf("Ok\n");
+}
+
+int run_tests_prefetch()
+{
+    printf("\nRunning prefetch tests\n");
+
+    test_prefetch_queue();
+    test_prefetch_training();
+
+    printf("All prefetch tests completed\n");
+    return 1;
+}
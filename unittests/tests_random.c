@@ -93,11 +93,98 @@ static void test_rand_num()
     printf("Ok\n");
 }
 
+static void test_rand_dropouts()
+{
+    unsigned int random_seed = 123, seed0;
+    int n = 101, i, j, no_of_active, dropped;
+    float mask[101], mask2[101];
+    int active[101], active2[101];
+
+    printf("test_rand_dropouts...");
+
+    /* no dropouts */
+    no_of_active = rand_dropouts(&random_seed, 0, mask, active, n);
+    assert(no_of_active == n);
+    for (i = 0; i < n; i++) {
+        assert(mask[i] == 1);
+        assert(active[i] == i);
+    }
+
+    for (j = 0; j < 10; j++) {
+        seed0 = random_seed;
+        no_of_active = rand_dropouts(&random_seed, 20, mask, active, n);
+        assert(random_seed != seed0);
+        assert(no_of_active == n - 20);
+
+        /* the active list is in order and agrees with the mask */
+        dropped = 0;
+        for (i = 0; i < n; i++) {
+            assert((mask[i] == 0) || (mask[i] == 1));
+            if (mask[i] == 0) dropped++;
+        }
+        assert(dropped == 20);
+        for (i = 0; i < no_of_active; i++) {
+            assert(mask[active[i]] == 1);
+            if (i > 0) assert(active[i] > active[i-1]);
+        }
+
+        /* the same seed gives the same dropouts */
+        assert(rand_dropouts(&seed0, 20, mask2, active2, n) == no_of_active);
+        assert(seed0 == random_seed);
+        assert(memcmp(mask, mask2, n*sizeof(float)) == 0);
+    }
+
+    /* at least one unit always remains */
+    assert(rand_dropouts(&random_seed, 100, mask, active, n) == 1);
+    assert(mask[active[0]] == 1);
+
+    printf("Ok\n");
+}
+
+static void test_rand_counter()
+{
+    float values[1000], values2[1000], total = 0;
+    int i;
+
+    printf("test_rand_counter...");
+
+    /* known answer for Philox2x32-10 */
+    assert(rand_counter(0, 0) == 0xff1dae59U);
+
+    /* outputs depend only upon the key and counter */
+    assert(rand_counter(123, 45) == rand_counter(123, 45));
+    assert(rand_counter(123, 45) != rand_counter(123, 46));
+    assert(rand_counter(123, 45) != rand_counter(124, 45));
+
+    /* filling in bulk gives the same values as individual calls */
+    rand_fill_uniform(123, 10, values, 1000);
+    for (i = 0; i < 1000; i++) {
+        assert(values[i] == rand_uniform(123, 10 + i));
+        assert(values[i] >= 0);
+        assert(values[i] < 1);
+        total += values[i];
+    }
+    assert(fabs(total/1000 - 0.5f) < 0.05f);
+
+    /* blended noise */
+    for (i = 0; i < 1000; i++) {
+        values2[i] = 0.5f;
+    }
+    rand_add_noise(123, 10, values2, 1000, 0.2f);
+    for (i = 0; i < 1000; i++) {
+        assert(fabs(values2[i] - (0.4f + (0.2f * values[i]))) < 0.00001f);
+    }
+
+    printf("Ok\n");
+}
+
 int run_tests_random()
 {
     printf("\nRunning random number generator tests\n");
 
     test_rand_num();
+    test_rand_counter();
+    test_rand_dropouts();
 
     printf("All random number generator tests completed\n");
     return 1;
@@ -0,0 +1,171 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_shared.h"
+
+static void test_shared_model()
+{
+    bp net;
+    bp_inference net_ctx, model_ctx;
+    deeplearn_model model, model2;
+    int no_of_inputs=10, no_of_hiddens=7, hidden_layers=2;
+    int no_of_outputs=3, batch_size=2;
+    unsigned int random_seed = 123;
+    float inputs[2*10], outputs[2*3], expected[2*3];
+    char * filename = "/tmp/libdeep_shared_model.bin";
+    char * name = "libdeep_test_model";
+    int i;
+
+    printf("test_shared_model...");
+
+    assert(bp_init(&net, no_of_inputs, no_of_hiddens,
+                   hidden_layers, no_of_outputs, &random_seed) == 0);
+    for (i = 0; i < batch_size*no_of_inputs; i++) {
+        inputs[i] = 0.25f + ((rand_num(&random_seed)%10000)/20000.0f);
+    }
+    assert(model_save_bp(filename, &net) == 0);
+
+    /* invalid names */
+    assert(shared_publish("", filename) != 0);
+    assert(shared_publish("a/b", filename) != 0);
+
+    assert(shared_publish(name, filename) == 0);
+    assert(model_attach(name, &model) == 0);
+    assert(model_attach(name, &model2) == 0);
+    assert(model.mapped == 1);
+    assert(model.network->NoOfInputs == no_of_inputs);
+
+    /* weights are used in place from the shared object */
+    assert((const char*)model.weights[0] > (const char*)model.data);
+    assert((const char*)model.weights[0] <
+           (const char*)model.data + model.size);
+
+    /* removing the name leaves existing mappings intact */
+    assert(shared_unlink(name) == 0);
+    assert(shared_unlink(name) != 0);
+    assert(model_attach(name, &model2) != 0);
+
+    assert(bp_inference_init(&net_ctx, &net, batch_size) == 0);
+    assert(model_inference_init(&model, &model_ctx, batch_size) == 0);
+    assert(bp_infer(&net, &net_ctx, inputs, expected, batch_size) == 0);
+    assert(model_infer(&model, &model_ctx, inputs, outputs, batch_size) == 0);
+    for (i = 0; i < batch_size*no_of_outputs; i++) {
+        assert(outputs[i] == expected[i]);
+    }
+    bp_inference_free(&net_ctx);
+    bp_inference_free(&model_ctx);
+    model_close(&model);
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+static void test_shared_dataset()
+{
+    deeplearn learner, learner2, learner3;
+    int i, s, no_of_hiddens = 8, hidden_layers = 2;
+    int output_field_index[] = { 2 };
+    float error_threshold[] = { 1.6f, 1.6f, 3.0f };
+    unsigned int random_seed = 123;
+    char * csv_filename = "/tmp/libdeep_shared.csv";
+    char * filename = "/tmp/libdeep_shared.bin";
+    char * name = "/libdeep_test_dataset";
+    deeplearndata * sample, * sample2;
+    FILE * fp;
+
+    printf("test_shared_dataset...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (i = 0; i < 10; i++) {
+        fprintf(fp,"%f,%s,%f,%f\n",i*1.3,(i%2==0)?"odd":"even",
+                50.0+i*2.1,(float)(i%3));
+    }
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename, &learner,
+                                  no_of_hiddens, hidden_layers, 1,
+                                  output_field_index, 0,
+                                  error_threshold, &random_seed) == 10);
+    assert(deeplearndata_save(&learner, filename) == 10);
+
+    assert(deeplearndata_attach(name, &learner2,
+                                no_of_hiddens, hidden_layers,
+                                error_threshold, &random_seed) == -1);
+    assert(shared_publish(name, filename) == 0);
+
+    /* several learners attach to the same samples */
+    assert(deeplearndata_attach(name, &learner2,
+                                no_of_hiddens, hidden_layers,
+                                error_threshold, &random_seed) == 10);
+    assert(deeplearndata_attach(name, &learner3,
+                                no_of_hiddens, hidden_layers,
+                                error_threshold, &random_seed) == 10);
+    assert(shared_unlink(name) == 0);
+
+    assert(learner2.net->NoOfInputs == learner.net->NoOfInputs);
+    assert(learner2.training_data_samples == learner.training_data_samples);
+    assert(learner2.test_data_samples == learner.test_data_samples);
+    for (s = 0; s < learner.training_data_samples; s++) {
+        sample = deeplearndata_get_training(&learner, s);
+        sample2 = deeplearndata_get_training(&learner2, s);
+        assert(memcmp(sample->inputs, sample2->inputs, 3*sizeof(float)) == 0);
+        assert(sample->outputs[0] == sample2->outputs[0]);
+        assert(strcmp(sample->inputs_text[1], sample2->inputs_text[1]) == 0);
+        assert(deeplearndata_get_training(&learner3, s)->outputs[0] ==
+               sample->outputs[0]);
+    }
+
+    /* training one learner does not change the samples of another */
+    for (i = 0; i < 20; i++) {
+        assert(deeplearndata_training(&learner2) > 0);
+    }
+    for (s = 0; s < learner.training_data_samples; s++) {
+        sample = deeplearndata_get_training(&learner, s);
+        sample2 = deeplearndata_get_training(&learner3, s);
+        assert(memcmp(sample->inputs, sample2->inputs, 3*sizeof(float)) == 0);
+    }
+
+    deeplearn_free(&learner3);
+    deeplearn_free(&learner2);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_shared()
+{
+    printf("\nRunning shared tests\n");
+
+    test_shared_model();
+    test_shared_dataset();
+
+    printf("All shared tests completed\n");
+    return 1;
+}
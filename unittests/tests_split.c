@@ -0,0 +1,172 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_split.h"
+
+static void test_split_shuffle()
+{
+    int indexes[100], used[100];
+    unsigned int random_seed = 4726;
+    int i, moved = 0;
+
+    printf("test_split_shuffle...");
+
+    for (i = 0; i < 100; i++) {
+        indexes[i] = i;
+    }
+    deeplearn_split_shuffle(indexes, 100, &random_seed);
+
+    /* the result is a permutation */
+    memset((void*)used, '\0', 100*sizeof(int));
+    for (i = 0; i < 100; i++) {
+        assert((indexes[i] >= 0) && (indexes[i] < 100));
+        used[indexes[i]]++;
+        if (indexes[i] != i) moved++;
+    }
+    for (i = 0; i < 100; i++) {
+        assert(used[i] == 1);
+    }
+    assert(moved > 50);
+
+    printf("Ok\n");
+}
+
+static void test_split_random()
+{
+    int n = 1000;
+    int training[1000], test[1000], used[1000];
+    int training_samples = 0, test_samples = 0, i;
+    unsigned int random_seed = 823;
+
+    printf("test_split_random...");
+
+    assert(deeplearn_split(n, NULL, 101, &random_seed,
+                           training, &training_samples,
+                           test, &test_samples) != 0);
+    assert(deeplearn_split(n, NULL, 20, &random_seed,
+                           training, &training_samples,
+                           test, &test_samples) == 0);
+    assert(training_samples == 800);
+    assert(test_samples == 200);
+
+    memset((void*)used, '\0', n*sizeof(int));
+    for (i = 0; i < training_samples; i++) {
+        used[training[i]]++;
+    }
+    for (i = 0; i < test_samples; i++) {
+        used[test[i]]++;
+    }
+    for (i = 0; i < n; i++) {
+        assert(used[i] == 1);
+    }
+
+    printf("Ok\n");
+}
+
+static void test_split_stratified()
+{
+    int n = 1010;
+    int classes[1010], training[1010], test[1010];
+    int training_samples = 0, test_samples = 0, i;
+    int test_classes[2];
+    unsigned int random_seed = 9126;
+
+    printf("test_split_stratified...");
+
+    /* an imbalanced data set with some unlabeled samples */
+    for (i = 0; i < n; i++) {
+        classes[i] = (i % 10 == 3) ? 1 : 0;
+        if (i >= 1000) classes[i] = -1;
+    }
+
+    assert(deeplearn_split(n, classes, 20, &random_seed,
+                           training, &training_samples,
+                           test, &test_samples) == 0);
+    assert(training_samples + test_samples == n);
+
+    /* each class is represented in proportion */
+    test_classes[0] = test_classes[1] = 0;
+    for (i = 0; i < test_samples; i++) {
+        assert(classes[test[i]] >= 0);
+        test_classes[classes[test[i]]]++;
+    }
+    assert(test_classes[0] == 180);
+    assert(test_classes[1] == 20);
+
+    printf("Ok\n");
+}
+
+static void test_split_kfold()
+{
+    int n = 103, folds = 5;
+    int classes[103], training[103], test[103], tested[103];
+    int training_samples = 0, test_samples = 0, i, fold;
+
+    printf("test_split_kfold...");
+
+    for (i = 0; i < n; i++) {
+        classes[i] = i % 3;
+    }
+
+    assert(deeplearn_split_kfold(n, classes, folds, folds, 1,
+                                 training, &training_samples,
+                                 test, &test_samples) != 0);
+
+    /* every sample is tested within exactly one fold */
+    memset((void*)tested, '\0', n*sizeof(int));
+    for (fold = 0; fold < folds; fold++) {
+        assert(deeplearn_split_kfold(n, classes, folds, fold, 6241,
+                                     training, &training_samples,
+                                     test, &test_samples) == 0);
+        assert(training_samples + test_samples == n);
+        assert(test_samples >= n/folds - 2);
+        assert(test_samples <= n/folds + 2);
+        for (i = 0; i < test_samples; i++) {
+            tested[test[i]]++;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        assert(tested[i] == 1);
+    }
+
+    printf("Ok\n");
+}
+
+int run_tests_split()
+{
+    printf("\nRunning split tests\n");
+
+    test_split_shuffle();
+    test_split_random();
+    test_split_stratified();
+    test_split_kfold();
+
+    printf("All split tests completed\n");
+    return 1;
+}
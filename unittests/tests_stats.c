@@ -0,0 +1,186 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_stats.h"
+
+static void test_stats_counters()
+{
+    deeplearn_stats stats;
+    deeplearn_stats_counter total;
+
+    printf("test_stats_counters...");
+
+    deeplearn_stats_reset();
+    deeplearn_stats_record(DEEPLEARN_STATS_PRETRAIN, 0, 0.5);
+    deeplearn_stats_record(DEEPLEARN_STATS_PRETRAIN, 1, 0.25);
+    deeplearn_stats_record(DEEPLEARN_STATS_PRETRAIN, 1, 0.25);
+    /* deep layers are accumulated within the last entry */
+    deeplearn_stats_record(DEEPLEARN_STATS_PRETRAIN,
+                           DEEPLEARN_STATS_MAX_LAYERS+5, 1.0);
+    /* out of range phases are ignored */
+    deeplearn_stats_record(DEEPLEARN_STATS_PHASES, 0, 1.0);
+    deeplearn_stats_record(DEEPLEARN_STATS_UPDATE, 0, 2.0);
+    deeplearn_stats_add_samples(10);
+    deeplearn_stats_add_allocation(100);
+    deeplearn_stats_add_allocation(28);
+    deeplearn_stats_get(&stats);
+
+    assert(stats.phase[DEEPLEARN_STATS_PRETRAIN][0].calls == 1);
+    assert(stats.phase[DEEPLEARN_STATS_PRETRAIN][1].calls == 2);
+    assert(stats.phase[DEEPLEARN_STATS_PRETRAIN][DEEPLEARN_STATS_MAX_LAYERS-1].calls == 1);
+    total = deeplearn_stats_total(&stats, DEEPLEARN_STATS_PRETRAIN);
+    assert(total.calls == 4);
+    assert(fabs(total.seconds - 2.0) < 0.0001);
+    total = deeplearn_stats_total(&stats, DEEPLEARN_STATS_PHASES);
+    assert(total.calls == 0);
+
+    assert(stats.samples == 10);
+    assert(fabs(deeplearn_stats_samples_per_sec(&stats) - 5.0f) < 0.0001f);
+    assert(deeplearn_stats_images_per_sec(&stats) == 0);
+    assert(stats.allocations == 2);
+    assert(stats.allocated_bytes == 128);
+
+    assert(strcmp(deeplearn_stats_phase_name(DEEPLEARN_STATS_FEED_FORWARD),
+                  "feed_forward") == 0);
+    assert(deeplearn_stats_phase_name(-1) == NULL);
+
+    deeplearn_stats_reset();
+    deeplearn_stats_get(&stats);
+    assert(stats.samples == 0);
+    assert(stats.allocations == 0);
+
+    printf("Ok\n");
+}
+
+static void test_stats_json()
+{
+    deeplearn_stats stats;
+    char * filename = "/tmp/libdeep_stats.json";
+    char line[4096];
+    FILE * fp;
+
+    printf("test_stats_json...");
+
+    deeplearn_stats_reset();
+    deeplearn_stats_record(DEEPLEARN_STATS_CONVOLUTION, 1, 0.5);
+    deeplearn_stats_add_images(3);
+    deeplearn_stats_get(&stats);
+
+    fp = fopen(filename, "w");
+    assert(fp);
+    assert(deeplearn_stats_write_json(fp, &stats) == 0);
+    assert(deeplearn_stats_write_json(fp, &stats) == 0);
+    fclose(fp);
+    assert(deeplearn_stats_write_json(NULL, &stats) != 0);
+
+    /* one object per line */
+    fp = fopen(filename, "r");
+    assert(fp);
+    assert(fgets(line, sizeof(line), fp) != NULL);
+    assert(line[0] == '{');
+    assert(line[strlen(line)-1] == '\n');
+    assert(line[strlen(line)-2] == '}');
+    assert(strstr(line, "\"images\":3,") != NULL);
+    assert(strstr(line, "\"convolution\":{\"calls\":1,") != NULL);
+    /* unused layers before the last recorded one are still listed */
+    assert(strstr(line, "\"layers\":[{\"calls\":0,") != NULL);
+    assert(strstr(line, "\"pooling\":{\"calls\":0,\"seconds\":0.000000000,\"layers\":[]}") != NULL);
+    assert(fgets(line, sizeof(line), fp) != NULL);
+    assert(line[0] == '{');
+    assert(fgets(line, sizeof(line), fp) == NULL);
+    fclose(fp);
+
+    deeplearn_stats_reset();
+
+    printf("Ok\n");
+}
+
+static void test_stats_training()
+{
+    deeplearn learner;
+    deeplearn_stats stats;
+    deeplearn_stats_counter total;
+    int no_of_inputs=6;
+    int no_of_hiddens=4;
+    int hidden_layers=2;
+    int no_of_outputs=2;
+    float error_threshold[] = { 0.01f, 0.01f, 0.01f };
+    unsigned int random_seed = 123;
+    int i, j;
+
+    printf("test_stats_training...");
+
+    assert(deeplearn_init(&learner,
+                          no_of_inputs, no_of_hiddens,
+                          hidden_layers,
+                          no_of_outputs,
+                          error_threshold,
+                          &random_seed) == 0);
+
+    deeplearn_stats_reset();
+    for (i = 0; i < 20; i++) {
+        for (j = 0; j < no_of_inputs; j++) {
+            deeplearn_set_input(&learner, j, (i+j)%2);
+        }
+        deeplearn_update(&learner);
+    }
+    deeplearn_stats_get(&stats);
+
+#ifdef DEEPLEARN_STATS
+    assert(stats.enabled == 1);
+    assert(stats.samples == 20);
+    assert(stats.phase[DEEPLEARN_STATS_UPDATE][0].calls == 20);
+    /* the first layer is pretrained */
+    assert(stats.phase[DEEPLEARN_STATS_PRETRAIN][0].calls == 20);
+    assert(deeplearn_stats_samples_per_sec(&stats) > 0);
+#else
+    /* nothing is recorded when instrumentation is compiled out */
+    assert(stats.enabled == 0);
+    assert(stats.samples == 0);
+#endif
+    total = deeplearn_stats_total(&stats, DEEPLEARN_STATS_PRETRAIN);
+    assert(total.calls == stats.phase[DEEPLEARN_STATS_PRETRAIN][0].calls);
+
+    deeplearn_free(&learner);
+    deeplearn_stats_reset();
+
+    printf("Ok\n");
+}
+
+int run_tests_stats()
+{
+    printf("\nRunning instrumentation tests\n");
+
+    test_stats_counters();
+    test_stats_json();
+    test_stats_training();
+
+    printf("All instrumentation tests completed\n");
+    return 1;
+}
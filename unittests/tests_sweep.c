@@ -0,0 +1,124 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tests_sweep.h"
+
+static void test_sweep_run()
+{
+    deeplearn learner;
+    deeplearn_sweep sweep, sweep2;
+    deeplearn_sweep_config configs[] = {
+        { 6, 2, 0.2f, 0.0f },
+        { 10, 1, 0.5f, 0.0f },
+        { 4, 3, 0.1f, 5.0f },
+        { 8, 2, 0.3f, 0.0f }
+    };
+    int output_field_index[] = { 2 };
+    float error_threshold[] = { 5.0f, 5.0f, 0.01f };
+    unsigned int random_seed = 123, sweep_seed = 42;
+    char * csv_filename = "/tmp/libdeep_sweep.csv";
+    int i, t, best;
+    FILE * fp;
+
+    printf("test_sweep_run...");
+
+    fp = fopen(csv_filename,"w");
+    assert(fp);
+    for (i = 0; i < 40; i++) {
+        float x = (i % 10)*1.1f, y = (i / 10)*2.3f;
+        fprintf(fp,"%f,%f,%f\n", x, y, x + y);
+    }
+    fclose(fp);
+
+    assert(deeplearndata_read_csv(csv_filename, &learner,
+                                  4, 2, 1, output_field_index, 0,
+                                  error_threshold, &random_seed) == 40);
+    assert(learner.training_data_labeled_samples > 0);
+    assert(learner.test_data_samples > 0);
+
+    assert(deeplearn_sweep_init(&sweep, &learner, configs, 0, 8,
+                                &sweep_seed) != 0);
+    assert(deeplearn_sweep_init(&sweep, &learner, configs, 4, 8,
+                                &sweep_seed) == 0);
+    assert(sweep.no_of_trials == 4);
+    assert(sweep.training_samples == learner.training_data_labeled_samples);
+    assert(sweep.test_samples == learner.test_data_samples);
+    assert(deeplearn_sweep_active(&sweep) == 4);
+    for (t = 0; t < 4; t++) {
+        assert(sweep.trial[t].learner.net->HiddenLayers ==
+               configs[t].hidden_layers);
+        assert(sweep.trial[t].learner.input_range_max[0] ==
+               learner.input_range_max[0]);
+    }
+
+    assert(deeplearn_sweep_run(&sweep, 40, 1) < 0);
+    best = deeplearn_sweep_run(&sweep, 40, 2);
+    assert(best >= 0);
+    assert(best < 4);
+
+    /* four trials are halved twice, with the survivor trained for
+       one more round */
+    assert(sweep.rounds == 3);
+    assert(deeplearn_sweep_active(&sweep) == 1);
+    assert(sweep.trial[best].active == 1);
+    assert(sweep.trial[best].rounds == 3);
+    assert(sweep.trial[best].error >= 0);
+    assert(sweep.trial[best].error < DEEPLEARN_UNKNOWN_ERROR);
+    for (t = 0; t < 4; t++) {
+        if (t == best) continue;
+        assert(sweep.trial[t].active == 0);
+        assert(sweep.trial[t].rounds < 3);
+    }
+
+    /* each trial has its own random seed, so the result does not
+       depend upon how the trials were scheduled */
+    sweep_seed = 42;
+    threads_set_count(1);
+    assert(deeplearn_sweep_init(&sweep2, &learner, configs, 4, 8,
+                                &sweep_seed) == 0);
+    assert(deeplearn_sweep_run(&sweep2, 40, 2) == best);
+    assert(sweep2.trial[best].error == sweep.trial[best].error);
+    threads_set_count(0);
+
+    deeplearn_sweep_free(&sweep2);
+    deeplearn_sweep_free(&sweep);
+    deeplearn_free(&learner);
+
+    printf("Ok\n");
+}
+
+int run_tests_sweep()
+{
+    printf("\nRunning sweep tests\n");
+
+    test_sweep_run();
+
+    printf("All sweep tests completed\n");
+    return 1;
+}
@@ -0,0 +1,283 @@
+/*
+ libdeep - a library for deep learning
+ Copyright (C) 2013  Bob Mottram <bob@robotics.uk.to>
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions
+ are met:
+ 1. Redistributions of source code must retain the above copyright
+    notice, this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of the University nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+ .
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE HOLDERS OR
+ CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(_OPENMP) && \
+    defined(__linux__)
+/* libgomp starts every parallel region with GOMP_parallel, so defining it
+   here lets the tests see the size of each team the library creates */
+#define TESTS_THREADS_TEAM
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <omp.h>
+#endif
+
+#include "tests_threads.h"
+
+#ifdef TESTS_THREADS_TEAM
+typedef void (*gomp_parallel_fn)(void (*)(void *), void *,
+                                 unsigned int, unsigned int);
+
+/* largest team of the regions started since it was last cleared */
+static int largest_team = 0;
+
+typedef struct {
+    void (*fn)(void *);
+    void * data;
+} team_region;
+
+static void team_region_run(void * data)
+{
+    team_region * region = (team_region*)data;
+
+    if (omp_get_thread_num() == 0) {
+        if (omp_get_num_threads() > largest_team) {
+            largest_team = omp_get_num_threads();
+        }
+    }
+    region->fn(region->data);
+}
+
+void GOMP_parallel(void (*fn)(void *), void * data,
+                   unsigned int num_threads, unsigned int flags)
+{
+    static gomp_parallel_fn next = NULL;
+    team_region region;
+
+    if (next == NULL) {
+        void * symbol = dlsym(RTLD_NEXT, "GOMP_parallel");
+        assert(symbol != NULL);
+        memcpy(&next, &symbol, sizeof(next));
+    }
+    region.fn = fn;
+    region.data = data;
+    next(team_region_run, &region, num_threads, flags);
+}
+#endif
+
+static void mark_task(void * data, int index, int worker)
+{
+    int * marked = (int*)data;
+
+    assert(worker >= 0);
+    assert(worker < threads_workers());
+    __atomic_add_fetch(&marked[index], 1, __ATOMIC_RELAXED);
+}
+
+/* a pool belonging to the caller, which runs tasks on its own thread */
+static int test_pool_run(void * pool, int tasks,
+                         threads_task task, void * data)
+{
+    int * calls = (int*)pool;
+
+    (*calls)++;
+    for (int i = 0; i < tasks; i++) {
+        task(data, i, i % 2);
+    }
+    return 0;
+}
+
+static void test_threads_count()
+{
+    int previous = threads_count();
+
+    printf("test_threads_count...");
+
+    assert(previous > 0);
+    assert(threads_set_count(-1) != 0);
+    assert(threads_set_count(3) == 0);
+    assert(threads_count() == 3);
+    assert(threads_workers() == 3);
+
+    /* zero restores the default */
+    assert(threads_set_count(0) == 0);
+    assert(threads_count() == previous);
+
+    printf("Ok\n");
+}
+
+static void test_threads_run()
+{
+    int marked[100], calls = 0;
+
+    printf("test_threads_run...");
+
+    memset(marked, 0, sizeof(marked));
+    assert(threads_run(100, mark_task, marked) == 0);
+    for (int i = 0; i < 100; i++) {
+        assert(marked[i] == 1);
+    }
+
+    /* while the caller's pool is set the library's own loops are serial
+       and tasks are given to the pool */
+    assert(threads_set_pool(test_pool_run, &calls, 0) != 0);
+    assert(threads_set_pool(test_pool_run, &calls, 2) == 0);
+    assert(threads_count() == 1);
+    assert(threads_workers() == 2);
+    assert(threads_run(100, mark_task, marked) == 0);
+    assert(calls == 1);
+    for (int i = 0; i < 100; i++) {
+        assert(marked[i] == 2);
+    }
+
+    assert(threads_set_pool(NULL, NULL, 0) == 0);
+    assert(threads_count() > 0);
+    assert(threads_run(100, mark_task, marked) == 0);
+    assert(calls == 1);
+    for (int i = 0; i < 100; i++) {
+        assert(marked[i] == 3);
+    }
+
+    printf("Ok\n");
+}
+
+static void test_threads_affinity()
+{
+    printf("test_threads_affinity...");
+
+    assert(threads_numa_nodes() >= 1);
+    assert(threads_numa_node() >= 0);
+    assert(threads_numa_node() < threads_numa_nodes());
+
+    assert(threads_set_affinity(99) != 0);
+#ifdef __linux__
+    assert(threads_set_affinity(THREADS_AFFINITY_COMPACT) == 0);
+    assert(threads_get_affinity() == THREADS_AFFINITY_COMPACT);
+#endif
+    assert(threads_set_affinity(THREADS_AFFINITY_NONE) == 0);
+    assert(threads_get_affinity() == THREADS_AFFINITY_NONE);
+
+    printf("Ok\n");
+}
+
+static void test_threads_replicas()
+{
+    bp net;
+    bp_replicas replicas;
+    unsigned int random_seed = 123;
+
+    printf("test_threads_replicas...");
+
+    bp_init(&net, 4, 5, 2, 2, &random_seed);
+
+    memset((void*)&replicas, '\0', sizeof(bp_replicas));
+    assert(bp_replicas_local(&replicas, &net) == &net);
+
+    assert(bp_replicas_init(&replicas, &net) == 0);
+    if (threads_numa_nodes() < 2) {
+        /* no copies are needed on a single node */
+        assert(replicas.no_of_replicas == 0);
+        assert(bp_replicas_local(&replicas, &net) == &net);
+    }
+    else {
+        assert(replicas.no_of_replicas == threads_numa_nodes());
+        assert(bp_replicas_local(&replicas, &net) != &net);
+    }
+    bp_replicas_free(&replicas);
+    assert(replicas.no_of_replicas == 0);
+
+    bp_free(&net);
+
+    printf("Ok\n");
+}
+
+#ifdef TESTS_THREADS_TEAM
+/* runs kernels which are large enough to be evaluated in parallel,
+   returning the largest team which any of their regions ran with */
+static int team_of_kernels()
+{
+    int m = 256, n = 256, k = 256, across = 64, depth = 8;
+    float * a = (float*)malloc(m*k*sizeof(float));
+    float * b = (float*)malloc(n*k*sizeof(float));
+    float * c = (float*)malloc(m*n*sizeof(float));
+    float * layer0 = (float*)malloc(across*across*depth*sizeof(float));
+    float * layer1 = (float*)malloc((across/2)*(across/2)*depth*
+                                    sizeof(float));
+
+    assert(a && b && c && layer0 && layer1);
+    for (int i = 0; i < m*k; i++) a[i] = (float)(i % 7);
+    for (int i = 0; i < n*k; i++) b[i] = (float)(i % 5);
+    for (int i = 0; i < across*across*depth; i++) layer0[i] = (float)i;
+
+    largest_team = 0;
+    kernel_gemm_nt(m, n, k, a, b, c);
+    kernel_gemv(m, k, a, b, c);
+    assert(pooling_from_flt_to_flt(depth, across, across, layer0,
+                                   across/2, across/2, layer1) == 0);
+
+    free(a);
+    free(b);
+    free(c);
+    free(layer0);
+    free(layer1);
+    return largest_team;
+}
+#endif
+
+static void test_threads_team()
+{
+    printf("test_threads_team...");
+
+#ifdef TESTS_THREADS_TEAM
+    int previous = omp_get_max_threads();
+    int calls = 0;
+
+    /* without a library setting the OpenMP default applies */
+    omp_set_num_threads(4);
+    assert(team_of_kernels() == 4);
+
+    assert(threads_set_count(1) == 0);
+    assert(team_of_kernels() == 1);
+    assert(threads_set_count(2) == 0);
+    assert(team_of_kernels() == 2);
+    assert(threads_set_count(0) == 0);
+
+    /* the caller's pool does the work, so regions run on one thread */
+    assert(threads_set_pool(test_pool_run, &calls, 2) == 0);
+    assert(team_of_kernels() == 1);
+    assert(threads_set_pool(NULL, NULL, 0) == 0);
+
+    omp_set_num_threads(previous);
+#endif
+
+    printf("Ok\n");
+}
+
+int run_tests_threads()
+{
+    printf("\nRunning threads tests\n");
+
+    test_threads_count();
+    test_threads_run();
+    test_threads_affinity();
+    test_threads_replicas();
+    test_threads_team();
+
+    printf("All threads tests completed\n");
+    return 1;
+}